@@ -21,6 +21,7 @@
     files.
  *******************************************************************************/
 
+#include <stdio.h>
 #include "app.h"
 #include "app_wifi_prov.h"
 #ifdef AZURE_CLOUD_DEMO
@@ -32,36 +33,107 @@
 #include "app_commands.h"
 #include "app_common.h"
 #include "app_oled.h"
+#include "app_dns_cache.h"
+#include "app_roam.h"
+#include "app_ps.h"
+#include "app_usb_msd.h"
+#include "app_config_store.h"
+#include "app_boot_timeline.h"
+#include "app_trace.h"
+#include "app_time.h"
+#include "app_dhcp_lease.h"
+#include "iot_network_wolfssl.h"
+#include "wolfssl/wolfcrypt/pwdbased.h"
 #include "tcpip/tcpip_manager.h"
 
 // *****************************************************************************
 
+/* Cloud connection events, forwarded to the binary trace */
+static void traceSocketOpen(int socket, uint32_t address)
+{
+    APP_TRACE_Event(APP_TRACE_EV_SOCKET_OPEN, socket, address);
+}
+
+static void traceSocketConnected(int socket, uint16_t port)
+{
+    APP_TRACE_Event(APP_TRACE_EV_SOCKET_CONNECTED, socket, port);
+}
+
+static void traceTlsStart(int socket)
+{
+    APP_TRACE_Event(APP_TRACE_EV_TLS_START, socket, 0);
+}
+
+static void traceTlsDone(int socket, bool secure)
+{
+    APP_TRACE_Event(APP_TRACE_EV_TLS_DONE, socket, secure);
+}
+
+static void traceSocketClose(int socket)
+{
+    APP_TRACE_Event(APP_TRACE_EV_SOCKET_CLOSE, socket, 0);
+}
+
+static void traceSent(const uint8_t *pMessage, int bytesSent)
+{
+    APP_TRACE_Event(APP_TRACE_EV_MQTT_TX, pMessage[0], bytesSent);
+}
+
+static const IotNetworkEventHooks_t appTraceNetworkHooks = {
+    .socketOpen = traceSocketOpen,
+    .socketConnected = traceSocketConnected,
+    .tlsStart = traceTlsStart,
+    .tlsDone = traceTlsDone,
+    .socketClose = traceSocketClose,
+    .sent = traceSent,
+};
+
+/* A connect using the cached BSS did not go through: scan on the next attempt */
+static void wlanFastConnectFailed(void)
+{
+    if (appData.fastConnectTried) {
+        APP_PRNT("Cached BSS not reachable, falling back to a scan\r\n");
+        appData.fastConnectValid = false;
+        appData.fastConnectTried = false;
+    }
+}
+
 /* Wi-Fi connect callback */
 static void wifiConnectCallback(DRV_HANDLE handle, WDRV_PIC32MZW_ASSOC_HANDLE assocHandle, WDRV_PIC32MZW_CONN_STATE currentState)
 {
     switch (currentState) {
         case WDRV_PIC32MZW_CONN_STATE_DISCONNECTED:
+            if (appData.roaming) {
+                /* Left the old BSS on purpose, join the new one */
+                appData.assocHandle = (uintptr_t)NULL;
+                WIFI_DISCONNECTED;
+                appData.wlanTaskState = APP_WLAN_ROAM_CONNECT;
+                break;
+            }
             APP_PRNT("WiFi Reconnecting\r\n");
+            if (!WIFI_IS_CONNECTED)
+                wlanFastConnectFailed();
             appData.assocHandle = (uintptr_t)NULL;
             WIFI_DISCONNECTED;
             APP_OLEDNotify(APP_OLED_PARAM_WIFI, false);
             appData.wlanTaskState = APP_WLAN_RECONNECT;
             break;
         case WDRV_PIC32MZW_CONN_STATE_CONNECTED:
-            APP_PRNT("WiFi Connected\r\n");
+            APP_PRNT("WiFi Connected (%s, connect %lu ms, radio on %lu ms)\r\n",
+                    appData.fastConnectTried ? "cached BSS" : "scan",
+                    (unsigned long) APP_MsSince(appData.connectTimeStamp),
+                    (unsigned long) APP_MsSince(appData.radioOnTimeStamp));
             appData.assocHandle = assocHandle;
+            appData.fastConnectUpdate = true;
+            appData.roaming = false;
             APP_OLEDNotify(APP_OLED_PARAM_WIFI, true);
             WIFI_CONNECTED;
-
-            WDRV_PIC32MZW_PowerSaveBroadcastTrackingSet(appData.wdrvHandle,true);
-            WDRV_PIC32MZW_PowerSaveModeSet(appData.wdrvHandle,
-                    WDRV_PIC32MZW_POWERSAVE_WSM_MODE,
-                    WDRV_PIC32MZW_POWERSAVE_PIC_ASYNC_MODE,
-                    NULL);
-
+            /* Power-save mode is set by APP_PS_Governor_Tasks */
             break;
         case WDRV_PIC32MZW_CONN_STATE_FAILED:
             APP_PRNT("WiFi connection failed\r\n");
+            wlanFastConnectFailed();
+            appData.roaming = false;
             appData.assocHandle = (uintptr_t)NULL;
             WIFI_DISCONNECTED;
             APP_OLEDNotify(APP_OLED_PARAM_WIFI, false);
@@ -81,7 +153,11 @@ static void tcpipStackEventHandler(TCPIP_NET_HANDLE hNet, TCPIP_EVENT event, con
         if(appData.appMode == APP_MODE_STA)   //STA
         {
             APP_manageLed(LED_BLUE, LED_ON, BLINK_MODE_INVALID);
-            if(TCPIP_DHCP_IsEnabled(hNet) == false)
+            if(APP_DHCP_LeaseStart(hNet))
+            {
+                APP_DBG(SYS_ERROR_INFO, "DHCP Client restarted on the cached lease\r\n");
+            }
+            else if(TCPIP_DHCP_IsEnabled(hNet) == false)
             {
                 APP_DBG(SYS_ERROR_INFO, "Start DHCP Client\r\n");
                 if(TCPIP_DHCPS_IsEnabled(hNet))
@@ -109,7 +185,11 @@ static void tcpipStackEventHandler(TCPIP_NET_HANDLE hNet, TCPIP_EVENT event, con
     {
         APP_DBG(SYS_ERROR_DEBUG, "%s - TCPIP_EV_CONN_LOST\r\n", __func__);
         APP_manageLed(LED_BLUE, LED_OFF, BLINK_MODE_INVALID);
-        if(appData.appMode == APP_MODE_STA)   //STA
+        if(appData.roaming)
+        {
+            /* Keep the DHCP lease across the BSS change */
+        }
+        else if(appData.appMode == APP_MODE_STA)   //STA
         {
             APP_DBG(SYS_ERROR_INFO, "Stop DHCP Client\r\n");
             TCPIP_DHCP_Disable(hNet);
@@ -133,6 +213,7 @@ static void tcpipStackEventHandler(TCPIP_NET_HANDLE hNet, TCPIP_EVENT event, con
 /* DHCP event callback */
 void tcpipDhcpEventHandler(TCPIP_NET_HANDLE hNet, TCPIP_DHCP_EVENT_TYPE evType, const void* param)
 {
+    APP_DHCP_LeaseEvent(hNet, evType);
     switch(evType)
     {
         case DHCP_EVENT_BOUND:
@@ -279,10 +360,143 @@ bool APP_WifiConfig(char *ssid, char *pass, WIFI_AUTH auth, uint8_t channel)
 
 // *****************************************************************************
 
+static uint32_t wlanKeyHash(void)
+{
+    return APP_CONFIG_STORE_Hash(wifi.key, strnlen((const char*)wifi.key, sizeof(wifi.key)));
+}
+
+/* WPA2 PMK = PBKDF2-SHA1(passphrase, SSID, 4096, 32). Deriving it once here
+ * saves the 8192 HMAC rounds on every following connect */
+static bool wlanDerivePsk(char *psk)
+{
+    uint8_t pmk[WDRV_PIC32MZW_PSK_LEN / 2];
+    size_t i;
+
+    if (0 != wc_PBKDF2(pmk, wifi.key, strnlen((const char*)wifi.key, sizeof(wifi.key)),
+                        wifi.ssid, strnlen((const char*)wifi.ssid, sizeof(wifi.ssid)),
+                        4096, sizeof(pmk), WC_SHA)) {
+        return false;
+    }
+    for (i = 0; i < sizeof(pmk); i++) {
+        sprintf(&psk[2 * i], "%02x", pmk[i]);
+    }
+    return true;
+}
+
+/* Pick up the record of the last association. Called once the credentials are known */
+void APP_WlanFastConnectLoad(void)
+{
+    APP_WLAN_FAST_CONNECT_RECORD *pRec = &appData.fastConnect;
+
+    appData.fastConnectValid = false;
+    if (0 != APP_CONFIG_STORE_SlotRead(APP_CONFIG_STORE_SLOT_WLAN, pRec, sizeof(*pRec)))
+        return;
+
+    if (pRec->magic == APP_WLAN_FAST_CONNECT_MAGIC
+            && 0 == strncmp((const char*)pRec->ssid, (const char*)wifi.ssid, sizeof(pRec->ssid))
+            && pRec->auth == wifi.auth
+            && pRec->keyHash == wlanKeyHash()) {
+        pRec->psk[WDRV_PIC32MZW_PSK_LEN] = '\0';
+        appData.fastConnectValid = true;
+        APP_DBG(SYS_ERROR_INFO, "Cached BSS %02x:%02x:%02x:%02x:%02x:%02x on channel %d\r\n",
+                pRec->bssid[0], pRec->bssid[1], pRec->bssid[2],
+                pRec->bssid[3], pRec->bssid[4], pRec->bssid[5], pRec->channel);
+    }
+}
+
+/* Capture the BSSID and channel of the current association, and keep them
+ * in the configuration store */
+static void wlanFastConnectTasks(void)
+{
+    APP_WLAN_FAST_CONNECT_RECORD *pRec = &appData.fastConnect;
+    WDRV_PIC32MZW_MAC_ADDR bssid;
+    WDRV_PIC32MZW_CHANNEL_ID channel;
+    WDRV_PIC32MZW_STATUS status;
+
+    if (appData.fastConnectUpdate && WIFI_IS_CONNECTED) {
+        status = WDRV_PIC32MZW_AssocPeerAddressGet((WDRV_PIC32MZW_ASSOC_HANDLE)appData.assocHandle, &bssid);
+        if (WDRV_PIC32MZW_STATUS_RETRY_REQUEST == status)
+            return;
+        appData.fastConnectUpdate = false;
+        if (WDRV_PIC32MZW_STATUS_OK != status || !bssid.valid
+                || WDRV_PIC32MZW_STATUS_OK != WDRV_PIC32MZW_InfoOpChanGet(appData.wdrvHandle, &channel))
+            return;
+
+        if (!appData.fastConnectValid) {
+            /* New record for the current credentials */
+            memset(pRec, 0, sizeof(*pRec));
+            pRec->magic = APP_WLAN_FAST_CONNECT_MAGIC;
+            memcpy(pRec->ssid, wifi.ssid, sizeof(pRec->ssid));
+            pRec->auth = wifi.auth;
+            pRec->keyHash = wlanKeyHash();
+            if (WPAWPA2MIXED == wifi.auth && !wlanDerivePsk(pRec->psk))
+                pRec->psk[0] = '\0';
+            appData.fastConnectDirty = true;
+        }
+        if (memcmp(pRec->bssid, bssid.addr, sizeof(pRec->bssid)) || pRec->channel != channel) {
+            memcpy(pRec->bssid, bssid.addr, sizeof(pRec->bssid));
+            pRec->channel = channel;
+            appData.fastConnectDirty = true;
+        }
+        appData.fastConnectValid = true;
+    }
+
+    if (appData.fastConnectDirty) {
+        appData.fastConnectDirty = false;
+        APP_CONFIG_STORE_SlotWrite(APP_CONFIG_STORE_SLOT_WLAN, pRec, sizeof(*pRec));
+    }
+}
+
+/* Set up the BSS and auth contexts and start the association. A NULL bssid
+ * lets the driver pick any BSS of the SSID on 'channel' */
+static bool wlanBSSConnect(const uint8_t *bssid, WDRV_PIC32MZW_CHANNEL_ID channel)
+{
+    WDRV_PIC32MZW_BSSCtxSetDefaults(&g_wifiConfig.bssCtx);
+    if (!APP_WifiConfig((char*)wifi.ssid, 
+                        (appData.fastConnectValid && appData.fastConnect.psk[0]) ? 
+                            appData.fastConnect.psk : (char*)wifi.key, 
+                        (WIFI_AUTH)wifi.auth, 
+                        channel))
+        return false;
+    if (bssid && WDRV_PIC32MZW_STATUS_OK != WDRV_PIC32MZW_BSSCtxSetBSSID(&g_wifiConfig.bssCtx, (uint8_t*)bssid))
+        return false;
+
+    APP_PS_GovernorConnect(appData.wdrvHandle);
+    appData.connectTimeStamp = SYS_TIME_Counter64Get();
+    return (WDRV_PIC32MZW_STATUS_OK == WDRV_PIC32MZW_BSSConnect(appData.wdrvHandle, 
+                                                               &g_wifiConfig.bssCtx, 
+                                                               &g_wifiConfig.authCtx, 
+                                                               wifiConnectCallback));
+}
+
+/* Move the association to another BSS of the current SSID */
+bool APP_WlanRoam(const uint8_t *bssid, WDRV_PIC32MZW_CHANNEL_ID channel)
+{
+    if (APP_MODE_STA != appData.appMode || !WIFI_IS_CONNECTED || appData.roaming
+            || (APP_WLAN_IDLE != appData.wlanTaskState && APP_WLAN_WAIT_FOR_SNTP_INIT != appData.wlanTaskState))
+        return false;
+
+    memcpy(appData.roamBssid, bssid, WDRV_PIC32MZW_MAC_ADDR_LEN);
+    appData.roamChannel = channel;
+    appData.roaming = true;
+    appData.wlanTaskState = APP_WLAN_ROAM;
+    return true;
+}
+
 void APP_Initialize ( void )
 {    
+    APP_LOG_Initialize();
+    APP_TRACE_Initialize();
+    IotNetworkWolfSSL_SetEventHooks(&appTraceNetworkHooks);
+    APP_BOOT_TimelineInitialize();
+    APP_BOOT_TimelineEvent(APP_BOOT_EV_APP_INIT);
     APP_InitializeWifiProv();
     APP_InitializeWlan();
+    APP_TIME_Initialize();
+    APP_DHCP_Lease_Initialize();
+    APP_DNS_Cache_Initialize();
+    APP_ROAM_Initialize();
+    APP_PS_Governor_Initialize();
     APP_Commands_Init();
 }
 
@@ -294,6 +508,7 @@ void APP_InitializeWlan ( void )
     appData.wOnRequested = false;
     WIFI_DISCONNECTED;
     NTP_NOT_DONE;
+    CLOUD_CONFIG_NOT_DONE;
     IP_ADDR_LOST;
     appData.appMode = APP_MODE_STA; //STA
     SW1_PRESSED(false);
@@ -304,6 +519,11 @@ void APP_InitializeWlan ( void )
          SW2_PRESSED(true);
     WDRV_PIC32MZW_BSSCtxSetDefaults(&g_wifiConfig.bssCtx);  
     SET_WIFI_CREDENTIALS(CREDENTIALS_UNINITIALIZED);
+    appData.fastConnectValid = false;
+    appData.fastConnectTried = false;
+    appData.fastConnectUpdate = false;
+    appData.fastConnectDirty = false;
+    appData.roaming = false;
     
     /* PIC power save related code */
     psInit();
@@ -364,6 +584,7 @@ void APP_TaskWlan(void)
                     
             if (SYS_STATUS_READY == WDRV_PIC32MZW_Status(sysObj.drvWifiPIC32MZW1)) {
                 APP_DBG(SYS_ERROR_INFO, "WiFi driver opened!\r\n");
+                appData.radioOnTimeStamp = SYS_TIME_Counter64Get();
                 appData.wlanTaskState = APP_WLAN_WDRV_INIT_READY;
             }
             break;
@@ -428,21 +649,15 @@ void APP_TaskWlan(void)
         {
             APP_PRNT("Connecting to Wi-Fi (%s)\r\n",wifi.ssid);
             APP_manageLed(LED_BLUE, LED_F_BLINK, BLINK_MODE_PERIODIC);
-            if (APP_WifiConfig((char*)wifi.ssid, 
-                                (char*)wifi.key, 
-                                (WIFI_AUTH)wifi.auth, 
-                                WDRV_PIC32MZW_CID_ANY)) 
+            
+            /* Go straight to the last BSS if we know it, scan otherwise */
+            appData.fastConnectTried = appData.fastConnectValid;
+            appData.appMode = APP_MODE_STA;
+            if (wlanBSSConnect(appData.fastConnectTried ? appData.fastConnect.bssid : NULL,
+                                appData.fastConnectTried ? appData.fastConnect.channel : WDRV_PIC32MZW_CID_ANY)) 
             {
-                appData.appMode = APP_MODE_STA;
-                if (WDRV_PIC32MZW_STATUS_OK == WDRV_PIC32MZW_BSSConnect(appData.wdrvHandle, 
-                                                                        &g_wifiConfig.bssCtx, 
-                                                                        &g_wifiConfig.authCtx, 
-                                                                        wifiConnectCallback)) 
-                {
-                    appData.wlanTaskState = APP_WLAN_WAIT_FOR_SNTP_INIT;
-                    break;
-                }
-        
+                appData.wlanTaskState = APP_WLAN_WAIT_FOR_SNTP_INIT;
+                break;
             }
             APP_DBG(SYS_ERROR_ERROR, "Failed connecting to Wi-Fi\r\n");
             appData.wlanTaskState = APP_WLAN_ERROR;
@@ -459,12 +674,15 @@ void APP_TaskWlan(void)
                 NTP_DONE;
                 appData.wlanTaskState = APP_WLAN_IDLE;
             }
+            wlanFastConnectTasks();
             break;
         }
         
         /* Idle */
         case APP_WLAN_IDLE:
         {
+            if (APP_MODE_STA == appData.appMode)
+                wlanFastConnectTasks();
             break;
         }
         
@@ -488,6 +706,37 @@ void APP_TaskWlan(void)
             break;
         }  
         
+        /* Roam: leave the current BSS, the disconnect callback moves on */
+        case APP_WLAN_ROAM:
+        {
+            appData.wlanTaskState = APP_WLAN_ROAM_WAIT_DISCONNECT;
+            if (WDRV_PIC32MZW_STATUS_OK != WDRV_PIC32MZW_BSSDisconnect(appData.wdrvHandle)) {
+                APP_DBG(SYS_ERROR_ERROR, "Roam: disconnect failed\r\n");
+                appData.roaming = false;
+                appData.wlanTaskState = APP_WLAN_IDLE;
+            }
+            break;
+        }
+
+        case APP_WLAN_ROAM_WAIT_DISCONNECT:
+        {
+            break;
+        }
+
+        /* Roam: join the chosen BSS directly on its channel */
+        case APP_WLAN_ROAM_CONNECT:
+        {
+            appData.fastConnectTried = false;
+            if (wlanBSSConnect(appData.roamBssid, appData.roamChannel)) {
+                appData.wlanTaskState = NTP_IS_DONE ? APP_WLAN_IDLE : APP_WLAN_WAIT_FOR_SNTP_INIT;
+            } else {
+                APP_DBG(SYS_ERROR_ERROR, "Roam: connect failed\r\n");
+                appData.roaming = false;
+                appData.wlanTaskState = APP_WLAN_RECONNECT;
+            }
+            break;
+        }
+
         /* WLAN De-init */
         case APP_WLAN_DEINIT:
         {
@@ -505,6 +754,8 @@ void APP_TaskWlan(void)
             break;
         }
     }
+    APP_BOOT_TimelineStateTrack(APP_BOOT_MOD_WLAN, appData.wlanTaskState);
+    APP_TRACE_StateTrack(APP_TRACE_EV_WLAN_STATE, appData.wlanTaskState);
 }
 
 
@@ -522,6 +773,13 @@ void APP_Tasks ( void )
     APP_TaskWlan();
     APP_TaskWifiProv();
     APP_TaskTcpServer();
+    APP_DNS_Cache_Tasks();
+    APP_ROAM_Tasks();
+    APP_PS_Governor_Tasks();
+    APP_TIME_Tasks();
+    APP_DHCP_Lease_Tasks();
+    APP_BOOT_TimelineTasks();
+    APP_TRACE_Tasks();
 }
 
 
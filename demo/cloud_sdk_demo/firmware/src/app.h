@@ -35,6 +35,7 @@
 #include "definitions.h"
 #include "FreeRTOS.h"
 #include "task.h"
+#include "app_log.h"
 // DOM-IGNORE-BEGIN
 #ifdef __cplusplus  // Provide C++ Compatibility
 
@@ -45,8 +46,8 @@ extern "C" {
 
 // *****************************************************************************
 
-#define APP_DBG(level,fmt,...) SYS_DEBUG_PRINT(level,"[APP] "fmt,##__VA_ARGS__)
-#define APP_PRNT(fmt,...) SYS_CONSOLE_PRINT("[APP] "fmt, ##__VA_ARGS__)
+#define APP_DBG(level,fmt,...) APP_LOG_DBG(APP_LOG_MODULE_APP,level,"[APP] "fmt,##__VA_ARGS__)
+#define APP_PRNT(fmt,...) APP_LOG_PRNT(APP_LOG_MODULE_APP,"[APP] "fmt, ##__VA_ARGS__)
 
 // *****************************************************************************
 
@@ -62,6 +63,9 @@ typedef enum
     APP_WLAN_WAIT_FOR_SNTP_INIT,    
     APP_WLAN_IDLE,
     APP_WLAN_RECONNECT,
+    APP_WLAN_ROAM,
+    APP_WLAN_ROAM_WAIT_DISCONNECT,
+    APP_WLAN_ROAM_CONNECT,
     APP_WLAN_DEINIT,
     APP_WLAN_ERROR,
 } APP_TASK_WLAN_STATES;
@@ -87,6 +91,30 @@ typedef enum
 #define DEVICE_CHANNEL WDRV_PIC32MZW_CID_2_4G_CH1
 #define WLAN_SSID_VISIBLE
 
+// *****************************************************************************
+/* Fast reconnect
+
+  Summary:
+     Parameters of the last successful association, reused to skip the
+     all-channel scan (and the passphrase hashing for WPA2) on the next connect.
+     Kept in the WLAN slot of the configuration store.
+*/
+
+#define APP_WLAN_FAST_CONNECT_MAGIC         0x574C4E01      /* "WLN" + record version */
+
+typedef struct
+{
+    uint32_t magic;
+    /* Credentials the record was taken with; any change invalidates it */
+    uint8_t ssid[WDRV_PIC32MZW_MAX_SSID_LEN];
+    uint8_t auth;
+    uint32_t keyHash;
+    uint8_t bssid[WDRV_PIC32MZW_MAC_ADDR_LEN];
+    uint8_t channel;
+    /* WPA2 PMK derived from the passphrase, as 64 hex digits. Empty for other auth types */
+    char psk[WDRV_PIC32MZW_PSK_LEN + 1];
+} APP_WLAN_FAST_CONNECT_RECORD;
+
 // *****************************************************************************
 /* Application Data
 
@@ -112,6 +140,8 @@ typedef struct
     volatile bool isConnected;
     volatile bool isIPObtained;
     volatile bool isNTPDone;
+    volatile bool isCloudConfigDone;
+    volatile bool isTimeTrusted;
     volatile bool sw1Pressed;
     volatile bool sw2Pressed;
     APP_MODE appMode;
@@ -123,6 +153,22 @@ typedef struct
     bool wOffRequested;
     bool wOnRequested;
 
+    APP_WLAN_FAST_CONNECT_RECORD fastConnect;
+    /* fastConnect matches the current credentials */
+    bool fastConnectValid;
+    /* The ongoing attempt uses fastConnect */
+    bool fastConnectTried;
+    /* Association parameters to be captured into fastConnect */
+    bool fastConnectUpdate;
+    bool fastConnectDirty;
+    uint64_t radioOnTimeStamp;
+    uint64_t connectTimeStamp;
+
+    /* Moving to another BSS of the same SSID; the IP configuration is kept */
+    volatile bool roaming;
+    uint8_t roamBssid[WDRV_PIC32MZW_MAC_ADDR_LEN];
+    WDRV_PIC32MZW_CHANNEL_ID roamChannel;
+
 } APP_DATA;
 APP_DATA appData;
 
@@ -141,6 +187,8 @@ void *APP_Calloc(size_t num, size_t size);
 // *****************************************************************************
 // *****************************************************************************
 void APP_InitializeWlan ( void );
+void APP_WlanFastConnectLoad ( void );
+bool APP_WlanRoam ( const uint8_t *bssid, WDRV_PIC32MZW_CHANNEL_ID channel );
 /*******************************************************************************
   Function:
     void APP_Initialize ( void )
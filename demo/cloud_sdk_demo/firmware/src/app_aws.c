@@ -25,12 +25,20 @@
 
 #ifdef AWS_CLOUD_DEMO
 
+#include <string.h>
 #include "iot_config.h"
 #include "app_common.h"
 #include "app_aws.h"
+#include "app_config_store.h"
 #include "app_oled.h"
-#include "cJSON.h"
+#include "app_ps.h"
+#include "app_boot_timeline.h"
+#include "app_trace.h"
+#include "app_shadow.h"
+#include "app_ota.h"
+#include "app_defender.h"
 #include "iot_network_wolfssl.h"
+#include "wolfssl/wolfcrypt/port/atmel/atmel.h"
 
 // *****************************************************************************
 
@@ -64,6 +72,20 @@ static void operationCompleteCallback( void * param1,
         APP_AWS_DBG(SYS_ERROR_INFO, "MQTT %s successfully sent \r\n",
                     IotMqtt_OperationType( pOperation->u.operation.type ));
         APP_manageLed(LED_YELLOW, LED_F_BLINK, BLINK_MODE_SINGLE);
+        if (IOT_MQTT_PUBLISH_TO_SERVER == pOperation->u.operation.type) {
+            IotMqttPublishStats_t stats;
+
+            IotMqtt_GetPublishStats(pOperation->mqttConnection, &stats);
+            APP_AWS_DBG(SYS_ERROR_DEBUG, "PUBACK RTT %lu ms (var %lu), retry after %lu ms, %lu/%lu in flight \r\n",
+                    (unsigned long) stats.srttMs, (unsigned long) stats.rttVarMs, (unsigned long) stats.retryMs,
+                    (unsigned long) stats.inFlight, (unsigned long) stats.window);
+            APP_BOOT_TimelineFirstPuback();
+            if (0 != appAwsData.connectTimeStamp) {
+                APP_AWS_PRNT("First PUBACK %lu ms after MQTT connect \r\n",
+                        (unsigned long) APP_MsSince(appAwsData.connectTimeStamp));
+                appAwsData.connectTimeStamp = 0;
+            }
+        }
     }
     else
     {
@@ -73,69 +95,76 @@ static void operationCompleteCallback( void * param1,
     }
 }
 
-/* Publish message is received */
-static void MqttCallback( void * param1,
-                                       IotMqttCallbackParam_t * const pPublish )
+// *****************************************************************************
+
+static uint32_t ssidHash(void)
 {
-    const char * pPayload = pPublish->u.message.info.pPayload;
-    
-    if (NULL != strstr(pPublish->u.message.info.pTopicName, "/shadow/update/delta")) {
-        /* Print information about the incoming PUBLISH message. */
-        APP_AWS_DBG(SYS_ERROR_DEBUG,  "Incoming PUBLISH received:\r\n"
-                    "Subscription topic filter: %.*s\r\n"
-                    "Publish topic name: %.*s\r\n"
-                    "Publish retain flag: %d\r\n"
-                    "Publish QoS: %d\r\n"
-                    "Publish payload: %.*s \r\n",
-                    pPublish->u.message.topicFilterLength,
-                    pPublish->u.message.pTopicFilter,
-                    pPublish->u.message.info.topicNameLength,
-                    pPublish->u.message.info.pTopicName,
-                    pPublish->u.message.info.retain,
-                    pPublish->u.message.info.qos,
-                    pPublish->u.message.info.payloadLength,
-                    pPayload );
-        
-        APP_AWS_DBG(SYS_ERROR_DEBUG, "%.*s \r\n",pPublish->u.message.info.payloadLength, pPayload);
-    
-        cJSON *messageJson = cJSON_Parse(pPayload);
-        if (messageJson == NULL) {
-            const char *error_ptr = cJSON_GetErrorPtr();
-            if (error_ptr != NULL) {
-                APP_AWS_DBG(SYS_ERROR_ERROR, "Message JSON parse Error. Error before: %s \r\n", error_ptr);
-            }
-            cJSON_Delete(messageJson);
-            return;
-        }
+    return APP_CONFIG_STORE_Hash(wifi.ssid, strnlen((const char*)wifi.ssid, sizeof(wifi.ssid)));
+}
 
-        //Get the desired state
-        cJSON *state = cJSON_GetObjectItem(messageJson, "state");
-        if (!state) {
-            cJSON_Delete(messageJson);
-            return;
-        }
-        
-        //Get the toggle state
-        cJSON *toggle = cJSON_GetObjectItem(state, "toggle");
-        if (!toggle) {
-            cJSON_Delete(messageJson);
-            return;
-        }
+/* Start from the keep-alive learned on this network by an earlier connection */
+static void keepAliveLoad(void)
+{
+    APP_AWS_KEEP_ALIVE_RECORD rec;
+    uint32_t hash = ssidHash();
+
+    if (APP_AWS_KEEP_ALIVE_MAGIC == appAwsData.keepAliveStored.magic && hash == appAwsData.keepAliveStored.ssidHash)
+        return;
+    if (0 != APP_CONFIG_STORE_SlotRead(APP_CONFIG_STORE_SLOT_MQTT, &rec, sizeof(rec))
+            || rec.magic != APP_AWS_KEEP_ALIVE_MAGIC
+            || rec.ssidHash != hash) {
+        memset(&rec, 0, sizeof(rec));
+        rec.magic = APP_AWS_KEEP_ALIVE_MAGIC;
+        rec.ssidHash = hash;
+    }
+    memset(&appAwsData.keepAlive, 0, sizeof(appAwsData.keepAlive));
+    appAwsData.pingreqsSeen = 0;
+    appAwsData.keepAlive.intervalMs = rec.intervalMs;
+    appAwsData.keepAlive.limitMs = rec.limitMs;
+    appAwsData.keepAlive.limitAge = rec.limitAge;
+    appAwsData.keepAlive.limitHold = rec.limitHold;
+    appAwsData.keepAlive.raisedFromMs = rec.raisedFromMs;
+    appAwsData.keepAliveStored = rec;
+    APP_AWS_DBG(SYS_ERROR_INFO, "Keep-alive %lu ms, limit %lu ms \r\n",
+                (unsigned long) rec.intervalMs, (unsigned long) rec.limitMs);
+}
 
-        bool desiredState = (bool)toggle->valueint;
-        if (desiredState) {
-            APP_AWS_PRNT("LED ON \r\n");
-            APP_manageLed(LED_YELLOW, LED_S_BLINK_STARTING_ON, BLINK_MODE_SINGLE);
-        } else {
-            APP_AWS_PRNT("LED OFF \r\n");
-            APP_manageLed(LED_YELLOW, LED_S_BLINK_STARTING_OFF, BLINK_MODE_SINGLE);
-        }
-        cJSON_Delete(messageJson);
-        
-        /* Publish LED state to shadow/update/ */
-        appAwsData.shadowUpdate = true;
-        appAwsData.publishToCloud = true;
+/* The interval grows with every PINGRESP, so while connected it is written
+ * once in a while; a connection lost writes the limit it may have learned */
+static void keepAliveStore(bool force)
+{
+    APP_AWS_KEEP_ALIVE_RECORD rec = appAwsData.keepAliveStored;
+    uint64_t now = SYS_TIME_Counter64Get();
+
+    rec.intervalMs = appAwsData.keepAlive.intervalMs;
+    rec.limitMs = appAwsData.keepAlive.limitMs;
+    rec.limitAge = appAwsData.keepAlive.limitAge;
+    rec.limitHold = appAwsData.keepAlive.limitHold;
+    rec.raisedFromMs = appAwsData.keepAlive.raisedFromMs;
+    if (0 == memcmp(&rec, &appAwsData.keepAliveStored, sizeof(rec)))
+        return;
+    if (!force && now - appAwsData.keepAliveStoreTimeStamp <
+            (uint64_t) SYS_TIME_FrequencyGet() * APP_AWS_KEEP_ALIVE_STORE_MS / 1000)
+        return;
+    if (0 == APP_CONFIG_STORE_SlotWrite(APP_CONFIG_STORE_SLOT_MQTT, &rec, sizeof(rec))) {
+        appAwsData.keepAliveStored = rec;
+        appAwsData.keepAliveStoreTimeStamp = now;
     }
+    APP_PS_GovernorConfigure(PUBLISH_FREQUENCY_MS, rec.intervalMs);
+}
+
+/* The connection was lost; its unacknowledged publishes move to the session
+ * and go out again, with the same packet identifiers, after the reconnect */
+static void mqttConnectionRelease(void)
+{
+    APP_SHADOW_Stop();
+    APP_OTA_Stop();
+    APP_DEFENDER_Stop();
+    IotMqtt_Disconnect(appAwsData.mqttConnection, IOT_MQTT_FLAG_CLEANUP_ONLY);
+    keepAliveStore(true);
+    appAwsData.mqttConnection = IOT_MQTT_CONNECTION_INITIALIZER;
+    APP_AWS_DBG(SYS_ERROR_INFO, "%lu publishes kept for the next connection \r\n",
+                (unsigned long) appAwsData.mqttSession.pending);
 }
 
 // *****************************************************************************
@@ -154,10 +183,7 @@ static int publishMessage()
         pubTopic,
     };
     
-    if(appAwsData.shadowUpdate)
-        snprintf(pPublishTopics[0], APP_AWS_TOPIC_NAME_MAX_LEN, APP_AWS_SHADOW_UPDATE_TOPIC_TEMPLATE, g_Aws_ClientID);
-    else
-        snprintf(pPublishTopics[0], APP_AWS_TOPIC_NAME_MAX_LEN, "%s/sensors", g_Aws_ClientID);
+    snprintf(pPublishTopics[0], APP_AWS_TOPIC_NAME_MAX_LEN, "%s/sensors", g_Aws_ClientID);
 
     publishComplete.function = operationCompleteCallback;
     publishComplete.pCallbackContext = NULL;
@@ -166,18 +192,13 @@ static int publishMessage()
     publishInfo.qos = IOT_MQTT_QOS_1;
     publishInfo.topicNameLength = strlen(pPublishTopics[0]);
     publishInfo.pPayload = pPublishPayload;
-    publishInfo.retryMs = PUBLISH_RETRY_MS;
+    publishInfo.retryMs = IOT_MQTT_RETRY_MS_ADAPTIVE;
     publishInfo.retryLimit = PUBLISH_RETRY_LIMIT;
     publishInfo.pTopicName = pPublishTopics[0];
     
     APP_AWS_DBG(SYS_ERROR_INFO, "Publishing message\r\n");
 
     /* Generate the payload for the PUBLISH. */
-    if(appAwsData.shadowUpdate){
-        status = snprintf( pPublishPayload, APP_AWS_MAX_MSG_LLENGTH, APP_AWS_SHADOW_MSG_TEMPLATE, !LED_YELLOW_Get());
-        appAwsData.shadowUpdate = false;
-    }
-    else
 #if 1
         status = snprintf( pPublishPayload, APP_AWS_MAX_MSG_LLENGTH,
                 APP_AWS_TELEMETRY_MSG_TEMPLATE, 
@@ -215,7 +236,9 @@ static int publishMessage()
         APP_AWS_DBG(SYS_ERROR_ERROR, "MQTT PUBLISH returned error %s \r\n", IotMqtt_strerror( publishStatus ) );
         status = 0;
     }
-    appAwsData.pendingMessages++;
+    else
+        appAwsData.pendingMessages++;
+    APP_PS_GovernorNotify(APP_PS_EV_PUBLISH);
 
     return status;
 }
@@ -229,10 +252,16 @@ void APP_AWS_Initialize( void )
     memset(g_Aws_ClientID, 0, CLIENT_IDENTIFIER_MAX_LENGTH);
     memset(g_Cloud_Endpoint, 0, 100);
     MQTT_DISCONNECTED;
-    appAwsData.shadowUpdate = true;
     appAwsData.pubTimerHandle = SYS_TIME_HANDLE_INVALID;
     appAwsData.publishToCloud = false;
     appAwsData.pendingMessages = 0;
+    appAwsData.connectTimeStamp = 0;
+    appAwsData.keepAliveStored.magic = 0;
+    appAwsData.keepAliveStoreTimeStamp = 0;
+    APP_PS_GovernorConfigure(PUBLISH_FREQUENCY_MS, IOT_MQTT_KEEP_ALIVE_MIN_MS);
+    APP_SHADOW_Initialize();
+    APP_OTA_Initialize();
+    APP_DEFENDER_Initialize();
 }
 
 // *****************************************************************************
@@ -261,7 +290,15 @@ void APP_AWS_Tasks ( void )
 		        /* Failed to initialize MQTT library. */
 		        APP_AWS_DBG(SYS_ERROR_ERROR, "Error occurred while MQTT init \r\n" );
                 appAwsData.awsCloudTaskState = APP_AWS_CLOUD_ERROR;
+                break;
 		    }
+
+            /* Lives as long as the device; every connection resumes it */
+            if( IotMqtt_InitSession(&appAwsData.mqttSession) != IOT_MQTT_SUCCESS ){
+                APP_AWS_DBG(SYS_ERROR_ERROR, "Error occurred while MQTT session init \r\n" );
+                appAwsData.awsCloudTaskState = APP_AWS_CLOUD_ERROR;
+                break;
+            }
                        
             appAwsData.awsCloudTaskState = APP_AWS_CLOUD_PENDING;
             break;
@@ -270,7 +307,12 @@ void APP_AWS_Tasks ( void )
         /* AWS cloud task pending for WLAN task trigger */
         case APP_AWS_CLOUD_PENDING:
         {
-            if(WIFI_IS_CONNECTED && IP_ADDR_IS_OBTAINED && NTP_IS_DONE){
+            /* The USB MSD task reads the ECC608 while Wi-Fi comes up; once it
+             * is done, prefetch randoms for the handshake while DHCP/SNTP finish */
+            if(WIFI_IS_CONNECTED && CLOUD_CONFIG_IS_DONE && atmel_rng_pool_low())
+                atmel_rng_pool_refill();
+            /* The time may come from the RTCC, SNTP refines it meanwhile */
+            if(WIFI_IS_CONNECTED && IP_ADDR_IS_OBTAINED && TIME_IS_TRUSTED && CLOUD_CONFIG_IS_DONE){
                 appAwsData.awsCloudTaskState = APP_AWS_CLOUD_MQTT_CONNECT;
             }
             break;
@@ -279,13 +321,14 @@ void APP_AWS_Tasks ( void )
         /* MQTT connect */
         case APP_AWS_CLOUD_MQTT_CONNECT:
         {
-            if(WIFI_IS_CONNECTED && IP_ADDR_IS_OBTAINED && NTP_IS_DONE){
+            if(WIFI_IS_CONNECTED && IP_ADDR_IS_OBTAINED && TIME_IS_TRUSTED){
                 IotMqttError_t connectStatus = IOT_MQTT_STATUS_PENDING;
                 int status = 0;
                 struct IotNetworkServerInfo serverInfo = {0};
                 IotMqttNetworkInfo_t networkInfo = IOT_MQTT_NETWORK_INFO_INITIALIZER;
                 IotMqttConnectInfo_t connectInfo = IOT_MQTT_CONNECT_INFO_INITIALIZER;
                 char pClientIdentifierBuffer[ CLIENT_IDENTIFIER_MAX_LENGTH ] = { 0 };
+                uint32_t resent = appAwsData.mqttSession.resent;
 
                 if (g_Cloud_Endpoint[0] != NULL)
                     serverInfo.pHostName = g_Cloud_Endpoint;
@@ -308,8 +351,21 @@ void APP_AWS_Tasks ( void )
 
                 /* Set the members of the connection info not set by the initializer. */
                 connectInfo.awsIotMqttMode = true;
-                connectInfo.cleanSession = true;
                 connectInfo.keepAliveSeconds = KEEP_ALIVE_SECONDS;
+                connectInfo.publishWindow = PUBLISH_WINDOW;
+
+                /* PINGREQ only after the connection idled for the interval
+                 * learned on this network, which NAT and AP timeouts cap */
+                keepAliveLoad();
+                connectInfo.pKeepAlive = &appAwsData.keepAlive;
+                APP_PS_GovernorConfigure(PUBLISH_FREQUENCY_MS, appAwsData.keepAlive.intervalMs ?
+                                         appAwsData.keepAlive.intervalMs : IOT_MQTT_KEEP_ALIVE_MIN_MS);
+
+                /* Persistent session under the thing name, for the publishes
+                 * awaiting a PUBACK; the Shadow library registers its
+                 * subscriptions with each connection */
+                connectInfo.cleanSession = false;
+                connectInfo.pSession = &appAwsData.mqttSession;
 
                 /* AWS mqtt doesn't use username or password */
                 connectInfo.pUserName = NULL;
@@ -341,22 +397,33 @@ void APP_AWS_Tasks ( void )
                             connectInfo.clientIdentifierLength );
                 
                 APP_manageLed(LED_GREEN, LED_F_BLINK, BLINK_MODE_PERIODIC);
+                /* Run mode for the TCP/TLS/MQTT handshakes */
+                APP_PS_GovernorNotify(APP_PS_EV_TLS_START);
+                appAwsData.connectTimeStamp = SYS_TIME_Counter64Get();
                 connectStatus = IotMqtt_Connect( &networkInfo,
                                                  &connectInfo,
                                                  MQTT_TIMEOUT_MS,
                                                  &appAwsData.mqttConnection );
+                APP_PS_GovernorNotify(APP_PS_EV_TLS_END);
 
                 /* Back-off for 1 second before retry MQTT connection */
                 if( connectStatus != IOT_MQTT_SUCCESS ){
                     APP_AWS_DBG(SYS_ERROR_ERROR, "MQTT CONNECT returned error %s \r\n",
                                  IotMqtt_strerror( connectStatus ) );
                     APP_manageLed(LED_GREEN, LED_OFF, BLINK_MODE_INVALID);
+                    appAwsData.connectTimeStamp = 0;
                     vTaskDelay(1000 / portTICK_PERIOD_MS);
                 }
                 else{
-                    APP_AWS_PRNT("MQTT connected \r\n");
+                    resent = appAwsData.mqttSession.resent - resent;
                     APP_manageLed(LED_GREEN, LED_ON, BLINK_MODE_INVALID);
                     APP_OLEDNotify(APP_OLED_PARAM_CLOUD, true);
+                    if(IotMqtt_SessionPresent(appAwsData.mqttConnection)){
+                        APP_AWS_PRNT("MQTT connected, session resumed, %lu publishes resent \r\n", (unsigned long) resent);
+                    }
+                    else{
+                        APP_AWS_PRNT("MQTT connected, new session, %lu publishes resent \r\n", (unsigned long) resent);
+                    }
                     appAwsData.awsCloudTaskState = APP_AWS_CLOUD_MQTT_SUBSCRIBE_TO_TOPIC;
                     MQTT_CONNECTED;
                 }
@@ -372,39 +439,26 @@ void APP_AWS_Tasks ( void )
         /* Subscribe */
         case APP_AWS_CLOUD_MQTT_SUBSCRIBE_TO_TOPIC:
         {
-			uint8_t i = 0;
-		    IotMqttError_t subscriptionStatus = IOT_MQTT_STATUS_PENDING;
-		    IotMqttSubscription_t pSubscriptions[ SUBSCRIBE_TOPIC_COUNT ] = { IOT_MQTT_SUBSCRIPTION_INITIALIZER };
-            char subTopic[APP_AWS_TOPIC_NAME_MAX_LEN];
-            char * pSubscribeTopics[ SUBSCRIBE_TOPIC_COUNT ] =
-            {
-                subTopic,
-            };
-            snprintf(subTopic, APP_AWS_TOPIC_NAME_MAX_LEN, APP_AWS_SHADOW_DELTA_TOPIC_TEMPLATE, g_Aws_ClientID);
-            
-		    /* Set the members of the subscription list */
-		    for( i = 0; i < SUBSCRIBE_TOPIC_COUNT; i++ ){
-		        pSubscriptions[i].qos = IOT_MQTT_QOS_1;
-		        pSubscriptions[i].pTopicFilter = pSubscribeTopics[i];
-		        pSubscriptions[i].topicFilterLength = strlen(pSubscribeTopics[i]);
-		        pSubscriptions[i].callback.pCallbackContext = NULL;
-		        pSubscriptions[i].callback.function = MqttCallback;
-		    }
-            
             if (MQTT_IS_CONNECTED){
-                subscriptionStatus = IotMqtt_SubscribeSync( appAwsData.mqttConnection,
-                                                        pSubscriptions,
-                                                        SUBSCRIBE_TOPIC_COUNT,
-                                                        0,
-                                                        MQTT_TIMEOUT_MS );
-                if ( subscriptionStatus == IOT_MQTT_SUCCESS){
+                /* Subscribes to the shadow delta and reads the shadow; the
+                 * update and get answers are subscribed with the first of
+                 * each and kept for the connection. A resumed session keeps
+                 * the delta and get subscriptions, which are then only
+                 * registered again, without SUBSCRIBE */
+                if (APP_SHADOW_Start(appAwsData.mqttConnection)){
+                    /* Firmware jobs are optional, the demo runs without them */
+                    APP_OTA_Start(appAwsData.mqttConnection);
+                    /* Metrics reports go out from the system task pool */
+                    APP_DEFENDER_Start(appAwsData.mqttConnection);
                     APP_AWS_PRNT("MQTT subscriptions accepted \r\n" );
                     appAwsData.awsCloudTaskState = APP_AWS_CLOUD_MQTT_PUBLISH_TO_TOPIC;
                 }
             }
-            else
+            else{
                 /* MQTT disconnected */
+                mqttConnectionRelease();
                 appAwsData.awsCloudTaskState = APP_AWS_CLOUD_PENDING;
+            }
 
             break;
         }
@@ -422,7 +476,28 @@ void APP_AWS_Tasks ( void )
             }
             
             if (MQTT_IS_CONNECTED){
-                if(appAwsData.publishToCloud == true){
+                /* Handshake is done; top up randoms used by the next one */
+                if(atmel_rng_pool_low())
+                    atmel_rng_pool_refill();
+                keepAliveStore(false);
+                /* PINGREQs go out from the MQTT task pool; the governor sees
+                 * them here, a tick late at most */
+                if(appAwsData.keepAlive.pingreqs != appAwsData.pingreqsSeen){
+                    appAwsData.pingreqsSeen = appAwsData.keepAlive.pingreqs;
+                    APP_PS_GovernorNotify(APP_PS_EV_KEEPALIVE);
+                }
+                /* Only the fields changed since the service last accepted
+                 * them, right away rather than with the next telemetry */
+                if(APP_SHADOW_ReportPending() &&
+                        IotMqtt_WaitPublishCredit(appAwsData.mqttConnection, 0))
+                    APP_SHADOW_Report();
+                APP_OTA_Tasks();
+                APP_DEFENDER_Tasks();
+                /* With PUBLISH_WINDOW publishes still awaiting a PUBACK, hold
+                 * back; the pending request is served at a later tick with
+                 * fresh sensor values */
+                if(appAwsData.publishToCloud == true &&
+                        IotMqtt_WaitPublishCredit(appAwsData.mqttConnection, 0)){
                     int status = 0;
 
                     /* Publish messages. */
@@ -435,11 +510,12 @@ void APP_AWS_Tasks ( void )
                     appAwsData.publishToCloud = false;
                 }
             }
-            else
-                /* MQTT disconnected; try to re-connect only if ALL older messages are done */
-                /* in context of a callback is received whether success or failure */
-                if(appAwsData.pendingMessages == 0)
-                    appAwsData.awsCloudTaskState = APP_AWS_CLOUD_PENDING;
+            else{
+                /* MQTT disconnected; the messages still awaiting a PUBACK are
+                 * kept in the session, so re-connect right away */
+                mqttConnectionRelease();
+                appAwsData.awsCloudTaskState = APP_AWS_CLOUD_PENDING;
+            }
             
             break;
         }
@@ -463,6 +539,8 @@ void APP_AWS_Tasks ( void )
             break;
         }
     }
+    APP_BOOT_TimelineStateTrack(APP_BOOT_MOD_CLOUD, appAwsData.awsCloudTaskState);
+    APP_TRACE_StateTrack(APP_TRACE_EV_AWS_STATE, appAwsData.awsCloudTaskState);
 }
 #endif /* AWS_CLOUD_DEMO */
 
@@ -28,6 +28,7 @@
 #include "iot_platform_types_pic32mzw1.h"
 #include "iot_mqtt.h"
 #include "configuration.h"
+#include "app_log.h"
 
 // DOM-IGNORE-BEGIN
 #ifdef __cplusplus  // Provide C++ Compatibility
@@ -39,18 +40,18 @@ extern "C" {
 
 // *****************************************************************************
     
-#define APP_AWS_DBG(level,fmt,...) SYS_DEBUG_PRINT(level,"[APP_AWS] "fmt,##__VA_ARGS__)
-#define APP_AWS_PRNT(fmt,...) SYS_CONSOLE_PRINT("[APP_AWS] "fmt, ##__VA_ARGS__)
+#define APP_AWS_DBG(level,fmt,...) APP_LOG_DBG(APP_LOG_MODULE_AWS,level,"[APP_AWS] "fmt,##__VA_ARGS__)
+#define APP_AWS_PRNT(fmt,...) APP_LOG_PRNT(APP_LOG_MODULE_AWS,"[APP_AWS] "fmt, ##__VA_ARGS__)
     
 #define APP_USE_X509_CERT   
 #define APP_AWS_TOPIC_NAME_MAX_LEN            128
 #define APP_AWS_TELEMETRY_MSG_TEMPLATE "{\"Temperature (C)\": %d,\"Light (lux)\":%d}"
 #define APP_AWS_TELEMETRY_MSG_GRAD_TEMPLATE "{\"Temperature (C)\": %d,\"Light (lux)\":%d,\"Switch 1\":%d}"
-#define APP_AWS_SHADOW_MSG_TEMPLATE "{\"state\":{\"reported\":{\"toggle\": %d}}}"
 #define APP_AWS_MAX_MSG_LLENGTH 64
-#define APP_AWS_SHADOW_UPDATE_TOPIC_TEMPLATE "$aws/things/%s/shadow/update"
-#define APP_AWS_SHADOW_DELTA_TOPIC_TEMPLATE "$aws/things/%s/shadow/update/#"
 #define PUBLISH_FREQUENCY_MS       1000
+#define APP_AWS_KEEP_ALIVE_MAGIC   0x4B414C02      /* "KAL" + record version */
+/* The keep-alive learned while connected is written at most this often */
+#define APP_AWS_KEEP_ALIVE_STORE_MS 600000
 
 // *****************************************************************************
 
@@ -66,6 +67,19 @@ typedef enum
     APP_AWS_CLOUD_ERROR
 } APP_TASK_AWS_CLOUD_STATES;
 
+/* Keep-alive learned on a network, kept in APP_CONFIG_STORE_SLOT_MQTT */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t ssidHash;
+    uint32_t intervalMs;
+    uint32_t limitMs;
+    /* How far the limit is from being raised again, see IotMqttKeepAlive_t */
+    uint32_t limitAge;
+    uint32_t limitHold;
+    uint32_t raisedFromMs;
+} APP_AWS_KEEP_ALIVE_RECORD;
+
 // *****************************************************************************
 
 typedef struct
@@ -76,16 +90,28 @@ typedef struct
     IotMqttConnection_t mqttConnection;
     /* MQTT connection status */
     bool mqttConnected;
-    /* shadow update */
-    bool shadowUpdate;
     /* Timer to take care of publishing to cloud */
     SYS_TIME_HANDLE pubTimerHandle;
     bool publishToCloud;
     /* Track number of messages sent without getting a callback for */
     uint8_t pendingMessages;
+    /* Persistent session: keeps the publishes awaiting a PUBACK across reconnects */
+    IotMqttSession_t mqttSession;
+    /* Start of the last MQTT connect, cleared at the first PUBACK after it */
+    uint64_t connectTimeStamp;
+    /* PINGREQ interval learned from the NAT and AP idle timeouts */
+    IotMqttKeepAlive_t keepAlive;
+    /* PINGREQs already reported to the power-save governor */
+    uint32_t pingreqsSeen;
+    /* Last written to the configuration store, and when */
+    APP_AWS_KEEP_ALIVE_RECORD keepAliveStored;
+    uint64_t keepAliveStoreTimeStamp;
 } APP_AWS_DATA;
 APP_AWS_DATA appAwsData;
 
+/* MQTT client identifier, also the thing name */
+extern char g_Aws_ClientID[];
+
 // *****************************************************************************
 
 void APP_AWS_Initialize( void );
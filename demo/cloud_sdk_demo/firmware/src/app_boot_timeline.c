@@ -0,0 +1,148 @@
+/*******************************************************************************
+  MPLAB Harmony Application Source File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_boot_timeline.c
+
+  Summary:
+    This file contains the source code for the boot timeline.
+
+  Description:
+    Time to the first published message is spread over several tasks that
+    wait on each other: the configuration store and the FS mount, the ECC608
+    reads, the Wi-Fi bring-up, DHCP, SNTP, the TLS handshake. Each task
+    reports its state here once per pass, and a change is recorded with a
+    microsecond timestamp; the status flags the tasks wait on are sampled from
+    APP_Tasks. Recording stops at the first PUBACK, whose delay is printed, so
+    the timeline that is left shows where a boot spent its time.
+ *******************************************************************************/
+#include <string.h>
+#include "app.h"
+#include "app_common.h"
+#include "app_boot_timeline.h"
+#include "system/console/sys_console.h"
+#ifdef AWS_CLOUD_DEMO
+    #include "app_aws.h"
+#endif
+
+// *****************************************************************************
+
+static const char* const moduleNames[APP_BOOT_NUM_MODULES] = {
+    "EVENT", "CFG", "USB_MSD", "WLAN", "CLOUD"
+};
+
+static const char* const eventNames[APP_BOOT_NUM_EVENTS] = {
+    "app init", "credentials", "Wi-Fi connected", "IP address", "NTP",
+    "time trusted", "cloud config", "MQTT connected", "first PUBACK"
+};
+
+static uint32_t usSinceBoot(void)
+{
+    return (uint32_t)(SYS_TIME_Counter64Get() / (SYS_TIME_FrequencyGet() / 1000000));
+}
+
+static void timelineRecord(APP_BOOT_MODULE module, int16_t state)
+{
+    uint32_t timeUs = usSinceBoot();
+
+    taskENTER_CRITICAL();
+    if (!appBootTimelineData.frozen)
+    {
+        if (appBootTimelineData.nEntries < APP_BOOT_TIMELINE_MAX_ENTRIES)
+        {
+            APP_BOOT_TIMELINE_ENTRY *pEntry = &appBootTimelineData.entry[appBootTimelineData.nEntries++];
+
+            pEntry->timeUs = timeUs;
+            pEntry->module = module;
+            pEntry->state = state;
+        }
+        else
+            appBootTimelineData.nDropped++;
+    }
+    taskEXIT_CRITICAL();
+}
+
+// *****************************************************************************
+
+void APP_BOOT_TimelineInitialize(void)
+{
+    int i;
+
+    memset(&appBootTimelineData, 0, sizeof(appBootTimelineData));
+    for (i = 0; i < APP_BOOT_NUM_MODULES; i++)
+        appBootTimelineData.lastState[i] = -1;
+}
+
+/* Called by each task once per pass; the task owns its module's entry */
+void APP_BOOT_TimelineStateTrack(APP_BOOT_MODULE module, int16_t state)
+{
+    if (appBootTimelineData.frozen || state == appBootTimelineData.lastState[module])
+        return;
+    appBootTimelineData.lastState[module] = state;
+    timelineRecord(module, state);
+}
+
+/* Recorded the first time only */
+void APP_BOOT_TimelineEvent(APP_BOOT_EVENT event)
+{
+    uint16_t mask = 1 << event;
+    bool seen;
+
+    taskENTER_CRITICAL();
+    seen = (appBootTimelineData.eventsSeen & mask) != 0;
+    appBootTimelineData.eventsSeen |= mask;
+    taskEXIT_CRITICAL();
+    if (!seen)
+        timelineRecord(APP_BOOT_MOD_EVENT, event);
+}
+
+void APP_BOOT_TimelineFirstPuback(void)
+{
+    uint32_t timeUs = usSinceBoot();
+
+    if (appBootTimelineData.frozen)
+        return;
+    APP_BOOT_TimelineEvent(APP_BOOT_EV_FIRST_PUBACK);
+    appBootTimelineData.frozen = true;
+    APP_BOOT_PRNT("First PUBACK %lu ms after boot\r\n", (unsigned long) (timeUs / 1000));
+}
+
+/* The flags below are set from callbacks; they are sampled every APP_Tasks pass */
+void APP_BOOT_TimelineTasks(void)
+{
+    if (appBootTimelineData.frozen)
+        return;
+    if (CHECK_WIFI_CREDENTIALS() == CREDENTIALS_VALID)
+        APP_BOOT_TimelineEvent(APP_BOOT_EV_CREDENTIALS);
+    if (WIFI_IS_CONNECTED)
+        APP_BOOT_TimelineEvent(APP_BOOT_EV_WIFI_CONNECTED);
+    if (IP_ADDR_IS_OBTAINED)
+        APP_BOOT_TimelineEvent(APP_BOOT_EV_IP_ADDR);
+    if (NTP_IS_DONE)
+        APP_BOOT_TimelineEvent(APP_BOOT_EV_NTP);
+    if (TIME_IS_TRUSTED)
+        APP_BOOT_TimelineEvent(APP_BOOT_EV_TIME_TRUSTED);
+    if (CLOUD_CONFIG_IS_DONE)
+        APP_BOOT_TimelineEvent(APP_BOOT_EV_CLOUD_CONFIG);
+#ifdef AWS_CLOUD_DEMO
+    if (MQTT_IS_CONNECTED)
+        APP_BOOT_TimelineEvent(APP_BOOT_EV_MQTT_CONNECTED);
+#endif
+}
+
+const char* APP_BOOT_TimelineModuleName(uint8_t module)
+{
+    return (module < APP_BOOT_NUM_MODULES) ? moduleNames[module] : "?";
+}
+
+const char* APP_BOOT_TimelineEventName(uint8_t event)
+{
+    return (event < APP_BOOT_NUM_EVENTS) ? eventNames[event] : "?";
+}
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,114 @@
+/*******************************************************************************
+  MPLAB Harmony Application Header File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_boot_timeline.h
+
+  Summary:
+    This header file provides prototypes and definitions for the application.
+
+  Description:
+    This header file provides function prototypes and data type definitions for
+    the boot timeline. The application tasks report their state machine
+    transitions and the connection milestones are sampled; each is recorded
+    with a microsecond timestamp until the first PUBACK is received. The
+    timeline is printed with the "boot" console command.
+*******************************************************************************/
+
+#ifndef _APP_BOOT_TIMELINE_H
+#define _APP_BOOT_TIMELINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include "configuration.h"
+#include "app_log.h"
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+/* Debug wrappers */
+#define APP_BOOT_DBG(level,fmt,...) APP_LOG_DBG(APP_LOG_MODULE_BOOT,level,"[APP_BOOT] "fmt,##__VA_ARGS__)
+#define APP_BOOT_PRNT(fmt,...) APP_LOG_PRNT(APP_LOG_MODULE_BOOT,"[APP_BOOT] "fmt, ##__VA_ARGS__)
+
+// *****************************************************************************
+
+#define APP_BOOT_TIMELINE_MAX_ENTRIES   96
+
+// *****************************************************************************
+
+typedef enum
+{
+    APP_BOOT_MOD_EVENT=0,
+    APP_BOOT_MOD_CFG,
+    APP_BOOT_MOD_USB_MSD,
+    APP_BOOT_MOD_WLAN,
+    APP_BOOT_MOD_CLOUD,
+    APP_BOOT_NUM_MODULES
+} APP_BOOT_MODULE;
+
+/* States of APP_BOOT_MOD_EVENT, each recorded once */
+typedef enum
+{
+    APP_BOOT_EV_APP_INIT=0,
+    APP_BOOT_EV_CREDENTIALS,
+    APP_BOOT_EV_WIFI_CONNECTED,
+    APP_BOOT_EV_IP_ADDR,
+    APP_BOOT_EV_NTP,
+    APP_BOOT_EV_TIME_TRUSTED,
+    APP_BOOT_EV_CLOUD_CONFIG,
+    APP_BOOT_EV_MQTT_CONNECTED,
+    APP_BOOT_EV_FIRST_PUBACK,
+    APP_BOOT_NUM_EVENTS
+} APP_BOOT_EVENT;
+
+typedef struct
+{
+    uint32_t timeUs;
+    uint8_t module;
+    uint8_t state;
+} APP_BOOT_TIMELINE_ENTRY;
+
+typedef struct
+{
+    APP_BOOT_TIMELINE_ENTRY entry[APP_BOOT_TIMELINE_MAX_ENTRIES];
+    volatile uint16_t nEntries;
+    uint16_t nDropped;
+    /* Last recorded state of each module, -1 before the first */
+    int16_t lastState[APP_BOOT_NUM_MODULES];
+    uint16_t eventsSeen;
+    /* Nothing more is recorded after the first PUBACK */
+    volatile bool frozen;
+} APP_BOOT_TIMELINE_DATA;
+APP_BOOT_TIMELINE_DATA appBootTimelineData;
+
+// *****************************************************************************
+
+void APP_BOOT_TimelineInitialize( void );
+void APP_BOOT_TimelineTasks( void );
+void APP_BOOT_TimelineStateTrack( APP_BOOT_MODULE module, int16_t state );
+void APP_BOOT_TimelineEvent( APP_BOOT_EVENT event );
+void APP_BOOT_TimelineFirstPuback( void );
+const char* APP_BOOT_TimelineModuleName( uint8_t module );
+const char* APP_BOOT_TimelineEventName( uint8_t event );
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _APP_BOOT_TIMELINE_H */
+
+/*******************************************************************************
+ End of File
+ */
@@ -45,6 +45,18 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 #include "app_usb_msd.h"
 #include "app_oled.h"
 #include "app_ps.h"
+#include "app_roam.h"
+#include "app_boot_timeline.h"
+#include "app_time.h"
+#include "app_dhcp_lease.h"
+#include "app_log.h"
+#include "app_trace.h"
+#ifdef AWS_CLOUD_DEMO
+    #include "app_shadow.h"
+    #include "app_ota.h"
+    #include "app_defender.h"
+    #include "platform/iot_metrics.h"
+#endif
 #include "config.h"
 #include <wolfssl/ssl.h>
 #include "task.h"
@@ -53,6 +65,7 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 #include "wdrv_pic32mzw_common.h"
 #include "wdrv_pic32mzw_assoc.h"
 #include "system/debug/sys_debug.h"
+#include "net_pres/pres/net_pres_enc_glue.h"
 
 //******************************************************************************
 
@@ -66,18 +79,40 @@ static void _APP_Commands_SelfTester(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char
 static void _APP_Commands_SetDebugLevel(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv);
 static void _APP_Commands_SetPowerMode(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv);
 static void _APP_Commands_Reboot(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv);
+static void _APP_Commands_GetTlsMem(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv);
+static void _APP_Commands_GetRoam(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv);
+static void _APP_Commands_GetBootTimeline(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv);
+static void _APP_Commands_GetDhcpLease(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv);
+static void _APP_Commands_Log(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv);
+static void _APP_Commands_Trace(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv);
+#ifdef AWS_CLOUD_DEMO
+static void _APP_Commands_GetShadow(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv);
+static void _APP_Commands_GetOta(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv);
+static void _APP_Commands_Defender(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv);
+#endif
 
 //******************************************************************************
 
 static const SYS_CMD_DESCRIPTOR appCmdTbl[] = {
     {"unixtime", _APP_Commands_GetUnixTime, ": Unix Time"},
     {"rssi", _APP_Commands_GetRSSI, ": Get current RSSI"},
-    {"rtcc", _APP_Commands_GetRTCC, ": Get uptime"},
+    {"rtcc", _APP_Commands_GetRTCC, ": Get RTCC time"},
     {"rtcc_freq", _APP_Commands_SetRTCCFreq, ": Set RTCC frequency"},
     {"power_mode", _APP_Commands_SetPowerMode, ": Set power mode"},
     {"self_tester", _APP_Commands_SelfTester, ": Show board self tester status"},
     {"debug", _APP_Commands_SetDebugLevel, ": Set debug level"},
     {"reboot", _APP_Commands_Reboot, ": System reboot"},
+    {"tls_mem", _APP_Commands_GetTlsMem, ": Show TLS memory usage"},
+    {"roam", _APP_Commands_GetRoam, ": Show link quality and roaming status"},
+    {"boot", _APP_Commands_GetBootTimeline, ": Show boot timeline"},
+    {"lease", _APP_Commands_GetDhcpLease, ": Show cached DHCP lease"},
+    {"log", _APP_Commands_Log, ": Show log statistics, set module log levels"},
+    {"trace", _APP_Commands_Trace, ": Show, dump or clear the event trace"},
+#ifdef AWS_CLOUD_DEMO
+    {"shadow", _APP_Commands_GetShadow, ": Show shadow version and reported state"},
+    {"ota", _APP_Commands_GetOta, ": Show firmware update progress"},
+    {"defender", _APP_Commands_Defender, ": Show Device Defender reports, set the period"},
+#endif
 };
 
 //******************************************************************************
@@ -185,6 +220,9 @@ void _APP_Commands_GetUnixTime(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** arg
     const void* cmdIoParam = pCmdIO->cmdIoParam;
     uint32_t sec = TCPIP_SNTP_UTCSecondsGet();
     APP_CMD_PRNT("Time from SNTP: %d\r\n", sec);
+    APP_CMD_PRNT("Time: %lu (%s)\r\n", (unsigned long) APP_TIME_UTCSecondsGet(),
+            (APP_TIME_SOURCE_SNTP == appTimeData.source) ? "SNTP" :
+            (APP_TIME_SOURCE_RTCC == appTimeData.source) ? "RTCC estimate" : "unknown");
     APP_CMD_PRNT("Low Rez Timer: %d\r\n", SYS_TIME_CounterGet() /
             SYS_TIME_FrequencyGet());
 }
@@ -207,5 +245,232 @@ void _APP_Commands_SelfTester(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv
         APP_CMD_PRNT("%s: %s\r\n", testStream[i].a, testStream[i].b);
 }
 
+void _APP_Commands_GetTlsMem(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv) {
+    const void* cmdIoParam = pCmdIO->cmdIoParam;
+    NET_PRES_EncProviderMemStats stats;
+    if (!NET_PRES_EncProviderMemStatsGet0(&stats)) {
+        APP_CMD_PRNT("TLS static memory not available\r\n");
+        return;
+    }
+    APP_CMD_PRNT("TLS arena: %u bytes\r\n", stats.arenaSize);
+    APP_CMD_PRNT("In use: %u bytes (peak %u)\r\n", stats.inUse, stats.peakInUse);
+    APP_CMD_PRNT("Connection peak: %u bytes\r\n", stats.connPeak);
+    APP_CMD_PRNT("Allocs: %u Frees: %u Failures: %u\r\n", stats.totalAlloc, stats.totalFree, stats.allocFailures);
+}
+
+void _APP_Commands_GetRoam(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv) {
+    const void* cmdIoParam = pCmdIO->cmdIoParam;
+    APP_CMD_PRNT("RSSI: %d dBm (avg %d), tx backlog avg %d\r\n", appRoamData.rssiLast,
+            appRoamData.rssiAvg / APP_ROAM_AVG_SCALE, appRoamData.txBacklogAvg / APP_ROAM_AVG_SCALE);
+    APP_CMD_PRNT("Scans: %lu (next after %lu s) Roams: %lu\r\n", (unsigned long) appRoamData.nScans,
+            (unsigned long) appRoamData.scanInterval, (unsigned long) appRoamData.nRoams);
+    APP_CMD_PRNT("Last roam: link %lu ms, traffic %lu ms\r\n", (unsigned long) appRoamData.lastLinkMs,
+            (unsigned long) appRoamData.lastRecoverMs);
+}
+
+void _APP_Commands_GetBootTimeline(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv) {
+    const void* cmdIoParam = pCmdIO->cmdIoParam;
+    uint32_t lastUs[APP_BOOT_NUM_MODULES] = {0};
+    uint16_t i, nEntries = appBootTimelineData.nEntries;
+
+    /* Time since the previous entry of the same module, i.e. spent in its previous state */
+    APP_CMD_PRNT("      time(us)    in prev(us) module  state\r\n");
+    for (i = 0; i < nEntries; i++) {
+        APP_BOOT_TIMELINE_ENTRY *pEntry = &appBootTimelineData.entry[i];
+
+        if (APP_BOOT_MOD_EVENT == pEntry->module)
+            APP_CMD_PRNT("%14lu %14s %-7s %s\r\n", (unsigned long) pEntry->timeUs, "",
+                    APP_BOOT_TimelineModuleName(pEntry->module), APP_BOOT_TimelineEventName(pEntry->state));
+        else
+            APP_CMD_PRNT("%14lu %14lu %-7s %u\r\n", (unsigned long) pEntry->timeUs,
+                    (unsigned long) (pEntry->timeUs - lastUs[pEntry->module]),
+                    APP_BOOT_TimelineModuleName(pEntry->module), pEntry->state);
+        lastUs[pEntry->module] = pEntry->timeUs;
+    }
+    if (appBootTimelineData.nDropped)
+        APP_CMD_PRNT("%u entries dropped\r\n", appBootTimelineData.nDropped);
+    if (!appBootTimelineData.frozen)
+        APP_CMD_PRNT("Still recording, no PUBACK yet\r\n");
+}
+
+void _APP_Commands_GetDhcpLease(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv) {
+    const void* cmdIoParam = pCmdIO->cmdIoParam;
+    APP_DHCP_LEASE_RECORD *pRec = &appDhcpLeaseData.record;
+
+    if (appDhcpLeaseData.valid) {
+        APP_CMD_PRNT("Lease: %d.%d.%d.%d from %d.%d.%d.%d, %lu s, expires %lu\r\n",
+                pRec->address.v[0], pRec->address.v[1], pRec->address.v[2], pRec->address.v[3],
+                pRec->server.v[0], pRec->server.v[1], pRec->server.v[2], pRec->server.v[3],
+                (unsigned long) pRec->leaseDuration, (unsigned long) pRec->expiry);
+        APP_CMD_PRNT("BSS: %02x:%02x:%02x:%02x:%02x:%02x\r\n", pRec->bssid[0], pRec->bssid[1],
+                pRec->bssid[2], pRec->bssid[3], pRec->bssid[4], pRec->bssid[5]);
+    } else
+        APP_CMD_PRNT("No cached lease\r\n");
+    APP_CMD_PRNT("Last link: %s, IP after %lu ms, ACK after %lu ms\r\n",
+            APP_DHCP_LeasePathName(appDhcpLeaseData.path),
+            (unsigned long) appDhcpLeaseData.timeToIpMs, (unsigned long) appDhcpLeaseData.timeToBoundMs);
+    APP_CMD_PRNT("INIT-REBOOT: %lu Cached: %lu NAK: %lu\r\n", (unsigned long) appDhcpLeaseData.nInitReboot,
+            (unsigned long) appDhcpLeaseData.nCached, (unsigned long) appDhcpLeaseData.nNak);
+}
+
+void _APP_Commands_Log(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv) {
+    const void* cmdIoParam = pCmdIO->cmdIoParam;
+    uint32_t nWritten = appLogData.nWritten;
+    int module, level;
+
+    if (argc == 2 && !strcmp(argv[1], "reset")) {
+        APP_LOG_StatsReset();
+        return;
+    }
+    if (argc == 3) {
+        if (!strcmp(argv[2], "g"))
+            level = APP_LOG_LEVEL_GLOBAL;
+        else {
+            level = atoi(argv[2]);
+            if (level < SYS_ERROR_FATAL || level > SYS_ERROR_DEBUG)
+                level = -1;
+        }
+        for (module = 0; module < APP_LOG_MODULE_MAX && level >= 0; module++) {
+            if (!strcmp(argv[1], "all") || !strcmp(argv[1], APP_LOG_ModuleName(module)))
+                APP_LOG_LevelSet(module, level);
+        }
+        if (level >= 0)
+            return;
+    }
+    if (argc != 1) {
+        APP_CMD_PRNT("log [reset | <module|all> <level|g>]\r\n");
+        return;
+    }
+
+    /* Core timer ticks at half the CPU clock */
+    APP_CMD_PRNT("Logged: %lu Dropped: %lu Truncated: %lu Ring: %lu/%d (max %lu)\r\n",
+            (unsigned long) nWritten, (unsigned long) appLogData.nDropped, (unsigned long) appLogData.nTruncated,
+            (unsigned long) APP_LOG_Pending(), APP_LOG_RING_SLOTS, (unsigned long) appLogData.maxUsed);
+    APP_CMD_PRNT("Call cost: avg %lu ns, max %lu ns\r\n",
+            (unsigned long) (nWritten ? (uint64_t) appLogData.callCycles * 2000 / (SYS_TIME_CPU_CLOCK_FREQUENCY / 1000000) / nWritten : 0),
+            (unsigned long) ((uint64_t) appLogData.callCyclesMax * 2000 / (SYS_TIME_CPU_CLOCK_FREQUENCY / 1000000)));
+    for (module = 0; module < APP_LOG_MODULE_MAX; module++) {
+        if (APP_LOG_LEVEL_GLOBAL == appLogData.level[module])
+            APP_CMD_PRNT("%-7s level g (%d) dropped %lu\r\n", APP_LOG_ModuleName(module),
+                    SYS_DEBUG_ErrorLevelGet(), (unsigned long) appLogData.nDroppedModule[module]);
+        else
+            APP_CMD_PRNT("%-7s level %d dropped %lu\r\n", APP_LOG_ModuleName(module),
+                    appLogData.level[module], (unsigned long) appLogData.nDroppedModule[module]);
+    }
+}
+
+/* "dump" prints one "@T" line per record for tools/trace_decode.py. Tracing
+ * is paused meanwhile so that the ring does not move under the reader */
+void _APP_Commands_Trace(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv) {
+    const void* cmdIoParam = pCmdIO->cmdIoParam;
+    SYS_CONSOLE_HANDLE handle = SYS_CONSOLE_HandleGet(SYS_CONSOLE_INDEX_0);
+    uint32_t head = appTraceBuffer.head;
+    uint32_t i, n = (head < APP_TRACE_RECORDS) ? head : APP_TRACE_RECORDS;
+    APP_TRACE_RECORD *pRec;
+    bool enabled;
+
+    if (argc == 2 && !strcmp(argv[1], "on")) {
+        appTraceData.enabled = true;
+        return;
+    }
+    if (argc == 2 && !strcmp(argv[1], "off")) {
+        appTraceData.enabled = false;
+        return;
+    }
+    if (argc == 2 && !strcmp(argv[1], "clear")) {
+        APP_TRACE_Clear();
+        return;
+    }
+    if (argc == 2 && !strcmp(argv[1], "dump")) {
+        enabled = appTraceData.enabled;
+        appTraceData.enabled = false;
+        head = appTraceBuffer.head;
+        n = (head < APP_TRACE_RECORDS) ? head : APP_TRACE_RECORDS;
+        APP_CMD_PRNT("@TRACE %u %lu %lu %lu %lu\r\n", APP_TRACE_FILE_VERSION,
+                (unsigned long) (SYS_TIME_CPU_CLOCK_FREQUENCY / 2), (unsigned long) head,
+                (unsigned long) n, (unsigned long) appTraceBuffer.bootCount);
+        for (i = 0; i < n; i++) {
+            pRec = &appTraceBuffer.ring[(head - n + i) & (APP_TRACE_RECORDS - 1)];
+            /* The console drops what does not fit in its queue */
+            while (SYS_CONSOLE_WriteFreeBufferCountGet(handle) < 64)
+                vTaskDelay(1);
+            APP_CMD_PRNT("@T %04x %08lx %04x %08lx %08lx\r\n", pRec->seq, (unsigned long) pRec->ts,
+                    pRec->event, (unsigned long) pRec->arg0, (unsigned long) pRec->arg1);
+        }
+        APP_CMD_PRNT("@END\r\n");
+        appTraceData.enabled = enabled;
+        return;
+    }
+    if (argc != 1) {
+        APP_CMD_PRNT("trace [on | off | dump | clear]\r\n");
+        return;
+    }
+
+    APP_CMD_PRNT("Trace: %s, %lu events, %lu in the ring of %d, boot %lu\r\n",
+            appTraceData.enabled ? "on" : "off", (unsigned long) head, (unsigned long) n,
+            APP_TRACE_RECORDS, (unsigned long) appTraceBuffer.bootCount);
+    if (appTraceData.lastFaultCause || appTraceData.lastFaultAddress)
+        APP_CMD_PRNT("Last fault: cause %lu at 0x%08lx, %s\r\n", (unsigned long) appTraceData.lastFaultCause,
+                (unsigned long) appTraceData.lastFaultAddress,
+                appTraceData.lastFaultSaved ? "saved to " APP_TRACE_FILE_NAME : "not saved");
+}
+
+#ifdef AWS_CLOUD_DEMO
+void _APP_Commands_GetShadow(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv) {
+    const void* cmdIoParam = pCmdIO->cmdIoParam;
+    APP_SHADOW_CACHE_ENTRY *pField = &appShadowData.field[APP_SHADOW_FIELD_TOGGLE];
+
+    APP_CMD_PRNT("Shadow: %s, version %lu, update %s\r\n",
+            !appShadowData.started ? "stopped" : appShadowData.synced ? "synced" : "reading",
+            (unsigned long) appShadowData.version, appShadowData.token ? "in flight" : "idle");
+    APP_CMD_PRNT("toggle: %ld, reported %s%ld\r\n", (long) pField->value,
+            pField->known ? "" : "unknown ", (long) pField->reported);
+    APP_CMD_PRNT("Deltas: %lu (stale %lu) Updates: %lu (%lu fields)\r\n",
+            (unsigned long) appShadowData.nDeltas, (unsigned long) appShadowData.nStale,
+            (unsigned long) appShadowData.nUpdates, (unsigned long) appShadowData.nFieldsSent);
+}
+
+void _APP_Commands_GetOta(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv) {
+    const void* cmdIoParam = pCmdIO->cmdIoParam;
+    static const char* const stateNames[] = { "idle", "job", "download", "verify", "report" };
+    const APP_OTA_AGENT* pAgent = &appOtaData.agent;
+
+    APP_CMD_PRNT("OTA: %s, %s\r\n", !appOtaData.started ? "stopped" : stateNames[pAgent->state],
+            pAgent->job.jobId[0] ? pAgent->job.jobId : "no job");
+    if (APP_OTA_PROGRESS_MAGIC == pAgent->progress.magic)
+        APP_CMD_PRNT("Image: %lu of %lu bytes in the slot%s\r\n", (unsigned long) pAgent->progress.committed,
+                (unsigned long) pAgent->progress.size,
+                APP_OTA_PROGRESS_STAGED == pAgent->progress.state ? ", staged" : "");
+    APP_CMD_PRNT("Requests: %lu Blocks: %lu (dropped %lu)\r\n", (unsigned long) pAgent->nRequests,
+            (unsigned long) pAgent->nBlocks, (unsigned long) pAgent->nDropped);
+}
+
+void _APP_Commands_Defender(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv) {
+    const void* cmdIoParam = pCmdIO->cmdIoParam;
+    IotMetricsNetworkStats_t stats;
+
+    if (argc == 3 && !strcmp(argv[1], "period")) {
+        if (APP_DEFENDER_PeriodSet(strtoul(argv[2], NULL, 10)))
+            APP_CMD_PRNT("Period set to %s s\r\n", argv[2]);
+        else
+            APP_CMD_PRNT("Period must be %u to %u s\r\n", APP_DEFENDER_PERIOD_MIN_S, APP_DEFENDER_PERIOD_MAX_S);
+        return;
+    }
+    if (argc != 1) {
+        APP_CMD_PRNT("defender [period <seconds>]\r\n");
+        return;
+    }
+    IotMetrics_GetNetworkStats(&stats);
+    APP_CMD_PRNT("Defender: %s, every %lu s, last report %lu bytes\r\n",
+            appDefenderData.started ? "started" : "stopped", (unsigned long) appDefenderData.periodS,
+            (unsigned long) appDefenderData.lastReportLength);
+    APP_CMD_PRNT("Accepted: %lu Rejected: %lu Failures: %lu\r\n", (unsigned long) appDefenderData.nAccepted,
+            (unsigned long) appDefenderData.nRejected, (unsigned long) appDefenderData.nFailures);
+    APP_CMD_PRNT("In: %lu bytes %lu packets Out: %lu bytes %lu packets\r\n",
+            (unsigned long) stats.bytesIn, (unsigned long) stats.packetsIn,
+            (unsigned long) stats.bytesOut, (unsigned long) stats.packetsOut);
+}
+#endif
+
 
 #endif
@@ -33,6 +33,7 @@
 #include "wdrv_pic32mzw_bssctx.h"
 #include "wdrv_pic32mzw_bssfind.h"
 #include "wdrv_pic32mzw_common.h"
+#include "system/time/sys_time.h"
 #include "app_ctrl.h"
 // DOM-IGNORE-BEGIN
 #ifdef __cplusplus  // Provide C++ Compatibility
@@ -95,6 +96,17 @@ wifiCred wifi;
 #define NTP_NOT_DONE        appData.isNTPDone = false
 #define NTP_IS_DONE         (appData.isNTPDone)
 
+/* Wall-clock status: from SNTP, or estimated from the RTCC, see app_time.h */
+#define TIME_TRUSTED            appData.isTimeTrusted = true
+#define TIME_NOT_TRUSTED        appData.isTimeTrusted = false
+#define TIME_IS_TRUSTED         (appData.isTimeTrusted)
+
+/* Cloud configuration status: the endpoint is known and the USB MSD task is
+ * done with the ECC608 */
+#define CLOUD_CONFIG_DONE       appData.isCloudConfigDone = true
+#define CLOUD_CONFIG_NOT_DONE   appData.isCloudConfigDone = false
+#define CLOUD_CONFIG_IS_DONE    (appData.isCloudConfigDone)
+
 /* AP connection status */
 #define AP_CONNECTED        appWifiProvData.apReady = true
 #define AP_DISCONNECTED     appWifiProvData.apReady = false
@@ -113,6 +125,20 @@ wifiCred wifi;
                     
 // *****************************************************************************
 
+/* Milliseconds in 'count' ticks of the 64-bit system time counter */
+static inline uint32_t APP_CounterToMs(uint64_t count)
+{
+    return (uint32_t)(count / (SYS_TIME_FrequencyGet() / 1000));
+}
+
+/* Milliseconds since 'timeStamp', a value of SYS_TIME_Counter64Get() */
+static inline uint32_t APP_MsSince(uint64_t timeStamp)
+{
+    return APP_CounterToMs(SYS_TIME_Counter64Get() - timeStamp);
+}
+
+// *****************************************************************************
+
 bool APP_WifiConfig(char *ssid, char *pass, WIFI_AUTH auth, uint8_t channel);
 
 #endif /* _APP_COMMON_H */
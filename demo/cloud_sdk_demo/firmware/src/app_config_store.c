@@ -0,0 +1,483 @@
+/*******************************************************************************
+  MPLAB Harmony Application Source File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_config_store.c
+
+  Summary:
+    This file contains the source code for the binary configuration store.
+
+  Description:
+    Getting the credentials used to take a FAT mount, a stat and a read of
+    WIFI.CFG and cloud.json, plus the strtok and JSON parsing, before the STA
+    could start connecting. This module keeps the parsed values in a record
+    in the last two erase sectors of the SST26, written alternately so that
+    the previous record survives a power loss during a write. The drive is
+    formatted with a partition that ends before them. The record is read
+    through a client of its own of the memory driver as soon as the driver
+    is up. The files stay the user interface: app_usb_msd.c stamps each of
+    them with its size, modification time and a hash of its contents, and
+    only parses a file again once the stamp no longer matches. The image slot
+    of the update agent is left out of the partition the same way, when the
+    FAT volume leaves room for it.
+ *******************************************************************************/
+#include <string.h>
+#include "definitions.h"
+#include "app_config_store.h"
+#include "app_common.h"
+#include "app_boot_timeline.h"
+#include "system/console/sys_console.h"
+
+// *****************************************************************************
+
+#define APP_CONFIG_STORE_IO_SIZE    ((sizeof(APP_CONFIG_STORE_RECORD) + DRV_SST26_PAGE_SIZE - 1) & ~(DRV_SST26_PAGE_SIZE - 1))
+
+static uint8_t CACHE_ALIGN storeBuffer[APP_CONFIG_STORE_IO_SIZE];
+
+/* Geometry of the whole device, as seen by the memory driver */
+static SYS_MEDIA_GEOMETRY *pMemGeometry = NULL;
+
+// *****************************************************************************
+
+static uint32_t crc32(const void* buffer, size_t nbyte)
+{
+    const uint8_t* p = (const uint8_t*) buffer;
+    uint32_t crc = 0xFFFFFFFF;
+    int bit;
+
+    while (nbyte--) {
+        crc ^= *p++;
+        for (bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t le32(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint32_t blockSize(uint8_t entry)
+{
+    return pMemGeometry->geometryTable[entry].blockSize;
+}
+
+/* Byte offset of one of the store sectors */
+static uint32_t sectorOffset(uint8_t sector)
+{
+    return appConfigStoreData.storeOffset + sector * DRV_SST26_ERASE_BUFFER_SIZE;
+}
+
+/* Sequence numbers wrap */
+static bool seqNewer(uint32_t seq, uint32_t than)
+{
+    return (int32_t)(seq - than) > 0;
+}
+
+/* Last FAT sector used by the volume in sector 0, either a partitioned or a
+ * super-floppy layout. 0 if there is no volume */
+static uint32_t volumeEnd(const uint8_t* sector)
+{
+    uint32_t end = 0, partEnd;
+    const uint8_t* part;
+    int ix;
+
+    if (sector[510] != 0x55 || sector[511] != 0xAA)
+        return 0;
+    /* Boot sector of an unpartitioned volume: jump instruction and BPB */
+    if ((sector[0] == 0xEB || sector[0] == 0xE9)
+            && (sector[11] | (sector[12] << 8)) == APP_CONFIG_STORE_FAT_SECTOR_SIZE) {
+        end = sector[19] | (sector[20] << 8);
+        return end ? end : le32(&sector[32]);
+    }
+    /* Master boot record */
+    for (ix = 0; ix < 4; ix++) {
+        part = &sector[446 + 16 * ix];
+        if (0 == part[4])
+            continue;
+        partEnd = le32(&part[8]) + le32(&part[12]);
+        if (partEnd > end)
+            end = partEnd;
+    }
+    return end;
+}
+
+static bool recordValid(const APP_CONFIG_STORE_RECORD* pRec)
+{
+    return pRec->magic == APP_CONFIG_STORE_MAGIC
+            && pRec->length == sizeof(*pRec)
+            && pRec->crc == crc32(pRec, offsetof(APP_CONFIG_STORE_RECORD, crc));
+}
+
+/* Called from the memory driver task */
+static void transferHandler(SYS_MEDIA_BLOCK_EVENT event, SYS_MEDIA_BLOCK_COMMAND_HANDLE commandHandle, uintptr_t context)
+{
+    if (commandHandle != appConfigStoreData.cmdHandle)
+        return;
+    appConfigStoreData.xferStatus = (SYS_MEDIA_EVENT_BLOCK_COMMAND_COMPLETE == event) ?
+            DRV_MEMORY_COMMAND_COMPLETED : DRV_MEMORY_COMMAND_ERROR_UNKNOWN;
+}
+
+static void recordChanged(void)
+{
+    appConfigStoreData.changeTimeStamp = SYS_TIME_Counter64Get();
+    appConfigStoreData.dirty = true;
+}
+
+// *****************************************************************************
+
+void APP_CONFIG_STORE_Initialize(void)
+{
+    memset(&appConfigStoreData, 0, sizeof(appConfigStoreData));
+    appConfigStoreData.state = APP_CONFIG_STORE_STATE_INIT;
+    appConfigStoreData.memHandle = DRV_HANDLE_INVALID;
+    appConfigStoreData.initTimeStamp = SYS_TIME_Counter64Get();
+}
+
+void APP_CONFIG_STORE_Tasks(void)
+{
+    APP_CONFIG_STORE_RECORD *pRec = &appConfigStoreData.record;
+    SYS_MEDIA_GEOMETRY *pGeometry;
+    DRV_MEMORY_COMMAND_STATUS status;
+    uint32_t end, reserved;
+
+    switch (appConfigStoreData.state) {
+        /* Open a client of our own once the memory driver is ready */
+        case APP_CONFIG_STORE_STATE_INIT:
+        {
+            appConfigStoreData.memHandle = DRV_MEMORY_Open(DRV_MEMORY_INDEX_0, DRV_IO_INTENT_READWRITE);
+            if (DRV_HANDLE_INVALID == appConfigStoreData.memHandle) {
+                if (APP_MsSince(appConfigStoreData.initTimeStamp) >= APP_CONFIG_STORE_OPEN_TMO_MS) {
+                    /* Boot the way it was done before the store */
+                    APP_CONFIG_STORE_DBG(SYS_ERROR_ERROR, "Memory driver not available\r\n");
+                    appConfigStoreData.loaded = true;
+                    appConfigStoreData.state = APP_CONFIG_STORE_STATE_IDLE;
+                }
+                break;
+            }
+            DRV_MEMORY_TransferHandlerSet(appConfigStoreData.memHandle, transferHandler, (uintptr_t) NULL);
+            pGeometry = DRV_MEMORY_GeometryGet(appConfigStoreData.memHandle);
+            if (NULL == pGeometry) {
+                appConfigStoreData.loaded = true;
+                appConfigStoreData.state = APP_CONFIG_STORE_STATE_IDLE;
+                break;
+            }
+            pMemGeometry = pGeometry;
+            appConfigStoreData.storeOffset = pGeometry->geometryTable[SYS_MEDIA_GEOMETRY_TABLE_ERASE_ENTRY].numBlocks
+                    * blockSize(SYS_MEDIA_GEOMETRY_TABLE_ERASE_ENTRY) - APP_CONFIG_STORE_RESERVED_SIZE;
+            appConfigStoreData.nWriteBlocks = sizeof(storeBuffer) / blockSize(SYS_MEDIA_GEOMETRY_TABLE_WRITE_ENTRY);
+            /* The first write goes to sector 0 if neither holds a record */
+            appConfigStoreData.sector = APP_CONFIG_STORE_NUM_SECTORS - 1;
+            appConfigStoreData.readSector = 0;
+            appConfigStoreData.state = APP_CONFIG_STORE_STATE_READ;
+            /* Fall through */
+        }
+
+        case APP_CONFIG_STORE_STATE_READ:
+        {
+            /* The driver queue may be taken by the FS or the USB host; retry */
+            appConfigStoreData.xferStatus = DRV_MEMORY_COMMAND_QUEUED;
+            DRV_MEMORY_AsyncRead(appConfigStoreData.memHandle, &appConfigStoreData.cmdHandle, storeBuffer,
+                    sectorOffset(appConfigStoreData.readSector) / blockSize(SYS_MEDIA_GEOMETRY_TABLE_READ_ENTRY),
+                    sizeof(storeBuffer) / blockSize(SYS_MEDIA_GEOMETRY_TABLE_READ_ENTRY));
+            if (DRV_MEMORY_COMMAND_HANDLE_INVALID != appConfigStoreData.cmdHandle)
+                appConfigStoreData.state = APP_CONFIG_STORE_STATE_WAIT_READ;
+            break;
+        }
+
+        /* Keep the newest valid record of the two sectors */
+        case APP_CONFIG_STORE_STATE_WAIT_READ:
+        {
+            status = appConfigStoreData.xferStatus;
+            if (DRV_MEMORY_COMMAND_QUEUED == status)
+                break;
+            if (DRV_MEMORY_COMMAND_COMPLETED == status
+                    && recordValid((const APP_CONFIG_STORE_RECORD*) storeBuffer)
+                    && (!appConfigStoreData.valid || seqNewer(((const APP_CONFIG_STORE_RECORD*) storeBuffer)->seq, pRec->seq))) {
+                memcpy(pRec, storeBuffer, sizeof(*pRec));
+                appConfigStoreData.valid = true;
+                appConfigStoreData.sector = appConfigStoreData.readSector;
+            }
+            if (++appConfigStoreData.readSector < APP_CONFIG_STORE_NUM_SECTORS) {
+                appConfigStoreData.state = APP_CONFIG_STORE_STATE_READ;
+                break;
+            }
+            if (!appConfigStoreData.valid) {
+                memset(pRec, 0, sizeof(*pRec));
+                APP_CONFIG_STORE_DBG(SYS_ERROR_INFO, "No stored configuration\r\n");
+            }
+            appConfigStoreData.state = APP_CONFIG_STORE_STATE_READ_VOLUME;
+            /* Fall through */
+        }
+
+        /* Check that the FAT volume ends before the reserved sectors */
+        case APP_CONFIG_STORE_STATE_READ_VOLUME:
+        {
+            appConfigStoreData.xferStatus = DRV_MEMORY_COMMAND_QUEUED;
+            DRV_MEMORY_AsyncRead(appConfigStoreData.memHandle, &appConfigStoreData.cmdHandle, storeBuffer,
+                    0, APP_CONFIG_STORE_FAT_SECTOR_SIZE);
+            if (DRV_MEMORY_COMMAND_HANDLE_INVALID != appConfigStoreData.cmdHandle)
+                appConfigStoreData.state = APP_CONFIG_STORE_STATE_WAIT_READ_VOLUME;
+            break;
+        }
+
+        case APP_CONFIG_STORE_STATE_WAIT_READ_VOLUME:
+        {
+            status = appConfigStoreData.xferStatus;
+            if (DRV_MEMORY_COMMAND_QUEUED == status)
+                break;
+            end = (DRV_MEMORY_COMMAND_COMPLETED == status) ? volumeEnd(storeBuffer) : 0;
+            reserved = appConfigStoreData.storeOffset;
+            appConfigStoreData.legacyVolume = end > reserved / APP_CONFIG_STORE_FAT_SECTOR_SIZE;
+            if (appConfigStoreData.legacyVolume) {
+                /* Leave the media as it is; a factory reset (SW1+SW2 at boot) reformats it */
+                APP_CONFIG_STORE_PRNT("Drive covers the configuration sectors, store disabled\r\n");
+                appConfigStoreData.valid = false;
+            }
+            /* Half of the flash at least stays with the drive */
+            if (reserved >= 2 * APP_CONFIG_STORE_IMAGE_SLOT_SIZE) {
+                appConfigStoreData.imageSlotOffset = reserved - APP_CONFIG_STORE_IMAGE_SLOT_SIZE;
+                appConfigStoreData.imageSlot = !appConfigStoreData.legacyVolume
+                        && end <= appConfigStoreData.imageSlotOffset / APP_CONFIG_STORE_FAT_SECTOR_SIZE;
+                if (!appConfigStoreData.imageSlot)
+                    APP_CONFIG_STORE_PRNT("Drive covers the image slot, firmware update disabled\r\n");
+            }
+            appConfigStoreData.loaded = true;
+            appConfigStoreData.state = APP_CONFIG_STORE_STATE_IDLE;
+            break;
+        }
+
+        /* Write the record back once changes have settled */
+        case APP_CONFIG_STORE_STATE_IDLE:
+        {
+            if (!appConfigStoreData.dirty || appConfigStoreData.legacyVolume
+                    || DRV_HANDLE_INVALID == appConfigStoreData.memHandle
+                    || APP_MsSince(appConfigStoreData.changeTimeStamp) < APP_CONFIG_STORE_WRITE_DELAY_MS)
+                break;
+
+            taskENTER_CRITICAL();
+            pRec->magic = APP_CONFIG_STORE_MAGIC;
+            pRec->length = sizeof(*pRec);
+            pRec->seq++;
+            pRec->crc = crc32(pRec, offsetof(APP_CONFIG_STORE_RECORD, crc));
+            memset(storeBuffer, 0xFF, sizeof(storeBuffer));
+            memcpy(storeBuffer, pRec, sizeof(*pRec));
+            appConfigStoreData.dirty = false;
+            taskEXIT_CRITICAL();
+
+            /* Into the other sector: the current record stays intact until
+             * the new one is complete */
+            appConfigStoreData.xferStatus = DRV_MEMORY_COMMAND_QUEUED;
+            DRV_MEMORY_AsyncEraseWrite(appConfigStoreData.memHandle, &appConfigStoreData.cmdHandle, storeBuffer,
+                    sectorOffset(appConfigStoreData.sector ^ 1) / blockSize(SYS_MEDIA_GEOMETRY_TABLE_WRITE_ENTRY),
+                    appConfigStoreData.nWriteBlocks);
+            if (DRV_MEMORY_COMMAND_HANDLE_INVALID == appConfigStoreData.cmdHandle) {
+                appConfigStoreData.dirty = true;
+                break;
+            }
+            appConfigStoreData.state = APP_CONFIG_STORE_STATE_WAIT_WRITE;
+            break;
+        }
+
+        case APP_CONFIG_STORE_STATE_WAIT_WRITE:
+        {
+            status = appConfigStoreData.xferStatus;
+            if (DRV_MEMORY_COMMAND_QUEUED == status)
+                break;
+            if (DRV_MEMORY_COMMAND_COMPLETED == status) {
+                appConfigStoreData.sector ^= 1;
+                appConfigStoreData.nWrites++;
+                APP_CONFIG_STORE_DBG(SYS_ERROR_DEBUG, "Configuration stored (seq %lu)\r\n", (unsigned long) pRec->seq);
+            } else {
+                /* Not retried; the record is written again on the next change */
+                APP_CONFIG_STORE_DBG(SYS_ERROR_ERROR, "Configuration write failed\r\n");
+            }
+            appConfigStoreData.state = APP_CONFIG_STORE_STATE_IDLE;
+            break;
+        }
+
+        default:
+            break;
+    }
+    APP_BOOT_TimelineStateTrack(APP_BOOT_MOD_CFG, appConfigStoreData.state);
+}
+
+bool APP_CONFIG_STORE_Loaded(void)
+{
+    return appConfigStoreData.loaded;
+}
+
+/* The record holds the contents of both configuration files */
+bool APP_CONFIG_STORE_Valid(void)
+{
+    return appConfigStoreData.valid
+            && appConfigStoreData.record.stamp[APP_CONFIG_STORE_FILE_WIFI].valid
+            && appConfigStoreData.record.stamp[APP_CONFIG_STORE_FILE_CLOUD].valid;
+}
+
+/* Nothing left to write */
+bool APP_CONFIG_STORE_Idle(void)
+{
+    return !appConfigStoreData.loaded || appConfigStoreData.legacyVolume
+            || DRV_HANDLE_INVALID == appConfigStoreData.memHandle
+            || (!appConfigStoreData.dirty && APP_CONFIG_STORE_STATE_IDLE == appConfigStoreData.state);
+}
+
+/* FNV-1a */
+uint32_t APP_CONFIG_STORE_Hash(const void* buffer, size_t nbyte)
+{
+    const uint8_t* p = (const uint8_t*) buffer;
+    uint32_t hash = 0x811C9DC5;
+
+    while (nbyte--) {
+        hash ^= *p++;
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+/* Size and modification time are those the record was generated from */
+bool APP_CONFIG_STORE_StampMatches(APP_CONFIG_STORE_FILE file, const SYS_FS_FSTAT* pStat)
+{
+    const APP_CONFIG_STORE_STAMP *pStamp = &appConfigStoreData.record.stamp[file];
+
+    return appConfigStoreData.valid && pStamp->valid
+            && pStamp->size == pStat->fsize
+            && pStamp->fdate == pStat->fdate
+            && pStamp->ftime == pStat->ftime;
+}
+
+/* The file was touched or copied over, but its contents did not change */
+bool APP_CONFIG_STORE_HashMatches(APP_CONFIG_STORE_FILE file, uint32_t hash)
+{
+    const APP_CONFIG_STORE_STAMP *pStamp = &appConfigStoreData.record.stamp[file];
+
+    return appConfigStoreData.valid && pStamp->valid && pStamp->hash == hash;
+}
+
+void APP_CONFIG_STORE_StampSet(APP_CONFIG_STORE_FILE file, const SYS_FS_FSTAT* pStat, uint32_t hash)
+{
+    APP_CONFIG_STORE_STAMP *pStamp = &appConfigStoreData.record.stamp[file];
+
+    if (pStamp->valid && pStamp->size == pStat->fsize && pStamp->fdate == pStat->fdate
+            && pStamp->ftime == pStat->ftime && pStamp->hash == hash)
+        return;
+    pStamp->size = pStat->fsize;
+    pStamp->fdate = pStat->fdate;
+    pStamp->ftime = pStat->ftime;
+    pStamp->hash = hash;
+    pStamp->valid = true;
+    recordChanged();
+}
+
+/* Returns true if the stored credentials were different */
+bool APP_CONFIG_STORE_WifiSet(const uint8_t* ssid, const uint8_t* key, uint8_t auth)
+{
+    APP_CONFIG_STORE_RECORD *pRec = &appConfigStoreData.record;
+
+    if (0 == strncmp((const char*)pRec->ssid, (const char*)ssid, sizeof(pRec->ssid))
+            && 0 == strncmp((const char*)pRec->key, (const char*)key, sizeof(pRec->key))
+            && pRec->auth == auth)
+        return false;
+    memcpy(pRec->ssid, ssid, sizeof(pRec->ssid));
+    memcpy(pRec->key, key, sizeof(pRec->key));
+    pRec->auth = auth;
+    recordChanged();
+    return true;
+}
+
+/* Returns true if the stored cloud settings were different */
+bool APP_CONFIG_STORE_CloudSet(const char* endpoint, const char* clientID)
+{
+    APP_CONFIG_STORE_RECORD *pRec = &appConfigStoreData.record;
+
+    if (0 == strncmp(pRec->endpoint, endpoint, sizeof(pRec->endpoint) - 1)
+            && 0 == strncmp(pRec->clientID, clientID, sizeof(pRec->clientID) - 1))
+        return false;
+    memset(pRec->endpoint, 0, sizeof(pRec->endpoint));
+    memset(pRec->clientID, 0, sizeof(pRec->clientID));
+    strncpy(pRec->endpoint, endpoint, sizeof(pRec->endpoint) - 1);
+    strncpy(pRec->clientID, clientID, sizeof(pRec->clientID) - 1);
+    recordChanged();
+    return true;
+}
+
+/* Copy out a private record. Fails if the slot is empty or of another size */
+int8_t APP_CONFIG_STORE_SlotRead(APP_CONFIG_STORE_SLOT slot, void* buffer, size_t nbyte)
+{
+    if (!appConfigStoreData.valid || appConfigStoreData.record.slotLen[slot] != nbyte)
+        return -1;
+    taskENTER_CRITICAL();
+    memcpy(buffer, appConfigStoreData.record.slot[slot], nbyte);
+    taskEXIT_CRITICAL();
+    return 0;
+}
+
+/* Update a private record; the flash is only written if it changed */
+int8_t APP_CONFIG_STORE_SlotWrite(APP_CONFIG_STORE_SLOT slot, const void* buffer, size_t nbyte)
+{
+    APP_CONFIG_STORE_RECORD *pRec = &appConfigStoreData.record;
+
+    if (nbyte > APP_CONFIG_STORE_SLOT_SIZE || !appConfigStoreData.loaded)
+        return -1;
+    if (appConfigStoreData.legacyVolume)
+        return -2;
+    taskENTER_CRITICAL();
+    if (pRec->slotLen[slot] != nbyte || 0 != memcmp(pRec->slot[slot], buffer, nbyte)) {
+        memcpy(pRec->slot[slot], buffer, nbyte);
+        pRec->slotLen[slot] = nbyte;
+        recordChanged();
+    }
+    taskEXIT_CRITICAL();
+    return 0;
+}
+
+/* Forget the stored configuration and the private records */
+void APP_CONFIG_STORE_Clear(void)
+{
+    taskENTER_CRITICAL();
+    memset(&appConfigStoreData.record, 0, sizeof(appConfigStoreData.record));
+    appConfigStoreData.valid = false;
+    recordChanged();
+    taskEXIT_CRITICAL();
+}
+
+/* The drive is about to be formatted. Returns the FAT sectors the partition
+ * may span so that it ends before the reserved sectors, or 0 to use the whole
+ * drive when the store is not available */
+uint32_t APP_CONFIG_STORE_VolumeFormat(void)
+{
+    bool imageSlot = appConfigStoreData.imageSlotOffset != 0;
+    uint32_t end;
+
+    if (!appConfigStoreData.loaded || NULL == pMemGeometry)
+        return 0;
+    if (appConfigStoreData.legacyVolume)
+        APP_CONFIG_STORE_PRNT("Configuration store enabled\r\n");
+    if (imageSlot && !appConfigStoreData.imageSlot)
+        APP_CONFIG_STORE_PRNT("Firmware update enabled\r\n");
+    appConfigStoreData.legacyVolume = false;
+    appConfigStoreData.imageSlot = imageSlot;
+    end = imageSlot ? appConfigStoreData.imageSlotOffset : appConfigStoreData.storeOffset;
+    return end / APP_CONFIG_STORE_FAT_SECTOR_SIZE;
+}
+
+/* Where the update agent may write an image, through a memory driver client
+ * of its own. False until the volume check is done, or if the drive covers it */
+bool APP_CONFIG_STORE_ImageSlotGet(uint32_t* pOffset, uint32_t* pSize)
+{
+    if (!appConfigStoreData.loaded || !appConfigStoreData.imageSlot)
+        return false;
+    *pOffset = appConfigStoreData.imageSlotOffset;
+    *pSize = APP_CONFIG_STORE_IMAGE_SLOT_SIZE;
+    return true;
+}
+
+/*******************************************************************************
+ End of File
+ */
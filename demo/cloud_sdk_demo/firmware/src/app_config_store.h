@@ -0,0 +1,190 @@
+/*******************************************************************************
+  MPLAB Harmony Application Header File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_config_store.h
+
+  Summary:
+    This header file provides prototypes and definitions for the application.
+
+  Description:
+    This header file provides function prototypes and data type definitions for
+    the binary configuration store. The store keeps the parsed contents of
+    WIFI.CFG and cloud.json, along with the cached network parameters, in one
+    CRC protected record in the last erase sector of the SST26. At boot the
+    record is available before the FAT volume is mounted. The sectors before
+    it hold a firmware image slot, written by the update agent.
+*******************************************************************************/
+
+#ifndef _APP_CONFIG_STORE_H
+#define _APP_CONFIG_STORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include "configuration.h"
+#include "driver/memory/drv_memory.h"
+#include "system/fs/sys_fs.h"
+#include "wdrv_pic32mzw_common.h"
+#include "app_log.h"
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+/* Debug wrappers */
+#define APP_CONFIG_STORE_DBG(level,fmt,...) APP_LOG_DBG(APP_LOG_MODULE_CFG,level,"[APP_CFG] "fmt,##__VA_ARGS__)
+#define APP_CONFIG_STORE_PRNT(fmt,...) APP_LOG_PRNT(APP_LOG_MODULE_CFG,"[APP_CFG] "fmt, ##__VA_ARGS__)
+
+// *****************************************************************************
+
+#define APP_CONFIG_STORE_MAGIC              0x43464706      /* "CFG" + record version */
+/* Tail of the flash kept out of the FAT partition: two sectors written in turn */
+#define APP_CONFIG_STORE_NUM_SECTORS        2
+#define APP_CONFIG_STORE_RESERVED_SIZE      (APP_CONFIG_STORE_NUM_SECTORS * DRV_SST26_ERASE_BUFFER_SIZE)
+/* Firmware image slot right before it, as large as the program flash */
+#define APP_CONFIG_STORE_IMAGE_SLOT_SIZE    0x100000
+#define APP_CONFIG_STORE_SLOT_SIZE          256
+#define APP_CONFIG_STORE_ENDPOINT_LEN       100
+#define APP_CONFIG_STORE_CLIENTID_LEN       256
+/* Changes are written this long after the last one, so that a boot writes once */
+#define APP_CONFIG_STORE_WRITE_DELAY_MS     2000
+/* Give up on the store if the memory driver cannot be opened by then */
+#define APP_CONFIG_STORE_OPEN_TMO_MS        1000
+/* FAT sector size, see FF_MAX_SS */
+#define APP_CONFIG_STORE_FAT_SECTOR_SIZE    512
+
+// *****************************************************************************
+
+typedef enum
+{
+    APP_CONFIG_STORE_STATE_INIT=0,
+    APP_CONFIG_STORE_STATE_READ,
+    APP_CONFIG_STORE_STATE_WAIT_READ,
+    APP_CONFIG_STORE_STATE_READ_VOLUME,
+    APP_CONFIG_STORE_STATE_WAIT_READ_VOLUME,
+    APP_CONFIG_STORE_STATE_IDLE,
+    APP_CONFIG_STORE_STATE_WAIT_WRITE
+} APP_CONFIG_STORE_STATES;
+
+/* User-visible files the record was generated from */
+typedef enum
+{
+    APP_CONFIG_STORE_FILE_WIFI=0,
+    APP_CONFIG_STORE_FILE_CLOUD,
+    APP_CONFIG_STORE_NUM_FILES
+} APP_CONFIG_STORE_FILE;
+
+/* Private records of other modules */
+typedef enum
+{
+    APP_CONFIG_STORE_SLOT_WLAN=0,
+    APP_CONFIG_STORE_SLOT_DNS,
+    APP_CONFIG_STORE_SLOT_TIME,
+    APP_CONFIG_STORE_SLOT_DHCP,
+    APP_CONFIG_STORE_SLOT_MQTT,
+    APP_CONFIG_STORE_SLOT_OTA,
+    APP_CONFIG_STORE_SLOT_DEFENDER,
+    APP_CONFIG_STORE_NUM_SLOTS
+} APP_CONFIG_STORE_SLOT;
+
+/* Identifies the version of a file the fields were parsed from */
+typedef struct
+{
+    uint32_t size;
+    uint16_t fdate;
+    uint16_t ftime;
+    /* APP_CONFIG_STORE_Hash of the contents */
+    uint32_t hash;
+    bool valid;
+} APP_CONFIG_STORE_STAMP;
+
+/* On-flash record. The CRC covers everything before it */
+typedef struct
+{
+    uint32_t magic;
+    uint16_t length;
+    uint16_t reserved;
+    uint32_t seq;
+    APP_CONFIG_STORE_STAMP stamp[APP_CONFIG_STORE_NUM_FILES];
+    /* From WIFI.CFG */
+    uint8_t ssid[WDRV_PIC32MZW_MAX_SSID_LEN];
+    uint8_t key[WDRV_PIC32MZW_MAX_PSK_PASSWORD_LEN];
+    uint8_t auth;
+    /* From cloud.json */
+    char endpoint[APP_CONFIG_STORE_ENDPOINT_LEN];
+    char clientID[APP_CONFIG_STORE_CLIENTID_LEN];
+    uint16_t slotLen[APP_CONFIG_STORE_NUM_SLOTS];
+    uint8_t slot[APP_CONFIG_STORE_NUM_SLOTS][APP_CONFIG_STORE_SLOT_SIZE];
+    uint32_t crc;
+} APP_CONFIG_STORE_RECORD;
+
+typedef struct
+{
+    APP_CONFIG_STORE_STATES state;
+    DRV_HANDLE memHandle;
+    DRV_MEMORY_COMMAND_HANDLE cmdHandle;
+    /* Set by the transfer handler */
+    volatile DRV_MEMORY_COMMAND_STATUS xferStatus;
+    uint64_t initTimeStamp;
+    /* Offset of the reserved sectors in the memory driver's bytes */
+    uint32_t storeOffset;
+    uint32_t nWriteBlocks;
+    /* Sector holding the current record; the next write goes to the other */
+    uint8_t sector;
+    /* Sector being read at boot */
+    uint8_t readSector;
+    APP_CONFIG_STORE_RECORD record;
+    bool valid;
+    /* The record and the volume check are done */
+    volatile bool loaded;
+    /* A FAT volume from older firmware covers the reserved sectors */
+    bool legacyVolume;
+    /* The FAT volume ends before the image slot */
+    bool imageSlot;
+    /* Offset of the image slot in the memory driver's bytes */
+    uint32_t imageSlotOffset;
+    volatile bool dirty;
+    uint64_t changeTimeStamp;
+    uint32_t nWrites;
+} APP_CONFIG_STORE_DATA;
+APP_CONFIG_STORE_DATA appConfigStoreData;
+
+// *****************************************************************************
+
+void APP_CONFIG_STORE_Initialize( void );
+void APP_CONFIG_STORE_Tasks( void );
+bool APP_CONFIG_STORE_Loaded( void );
+bool APP_CONFIG_STORE_Valid( void );
+bool APP_CONFIG_STORE_Idle( void );
+uint32_t APP_CONFIG_STORE_Hash( const void* buffer, size_t nbyte );
+bool APP_CONFIG_STORE_StampMatches( APP_CONFIG_STORE_FILE file, const SYS_FS_FSTAT* pStat );
+bool APP_CONFIG_STORE_HashMatches( APP_CONFIG_STORE_FILE file, uint32_t hash );
+void APP_CONFIG_STORE_StampSet( APP_CONFIG_STORE_FILE file, const SYS_FS_FSTAT* pStat, uint32_t hash );
+bool APP_CONFIG_STORE_WifiSet( const uint8_t* ssid, const uint8_t* key, uint8_t auth );
+bool APP_CONFIG_STORE_CloudSet( const char* endpoint, const char* clientID );
+int8_t APP_CONFIG_STORE_SlotRead( APP_CONFIG_STORE_SLOT slot, void* buffer, size_t nbyte );
+int8_t APP_CONFIG_STORE_SlotWrite( APP_CONFIG_STORE_SLOT slot, const void* buffer, size_t nbyte );
+void APP_CONFIG_STORE_Clear( void );
+uint32_t APP_CONFIG_STORE_VolumeFormat( void );
+bool APP_CONFIG_STORE_ImageSlotGet( uint32_t* pOffset, uint32_t* pSize );
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _APP_CONFIG_STORE_H */
+
+/*******************************************************************************
+ End of File
+ */
@@ -23,6 +23,7 @@
 
 #include "app_common.h"
 #include "app_ctrl.h"
+#include "app_time.h"
 #include <math.h>
 
 // *****************************************************************************
@@ -372,7 +373,8 @@ static void setup_rtcc(void) {
 
     RTCC_CallbackRegister(rtcc_callback, (uintptr_t) NULL);
 
-    if (RTCC_TimeSet(&sys_time) == false) {
+    /* Keep the UTC time of a previous run, see app_time.c */
+    if (!APP_TIME_RtccIsSet() && RTCC_TimeSet(&sys_time) == false) {
         APP_CTRL_DBG(SYS_ERROR_ERROR, "Error setting time\r\n");
         return;
     }
@@ -26,6 +26,7 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include "definitions.h"
+#include "app_log.h"
 // DOM-IGNORE-BEGIN
 #ifdef __cplusplus  // Provide C++ Compatibility
 
@@ -36,8 +37,8 @@ extern "C" {
 
 // *****************************************************************************
 
-#define APP_CTRL_DBG(level,fmt,...) SYS_DEBUG_PRINT(level,"[APP_CTRL] "fmt, ##__VA_ARGS__)
-#define APP_CTRL_PRNT(fmt,...) SYS_CONSOLE_PRINT("[APP_CTRL] "fmt, ##__VA_ARGS__)
+#define APP_CTRL_DBG(level,fmt,...) APP_LOG_DBG(APP_LOG_MODULE_CTRL,level,"[APP_CTRL] "fmt, ##__VA_ARGS__)
+#define APP_CTRL_PRNT(fmt,...) APP_LOG_PRNT(APP_LOG_MODULE_CTRL,"[APP_CTRL] "fmt, ##__VA_ARGS__)
 #define NUM_OF_LEDS                     4
 
 // *****************************************************************************
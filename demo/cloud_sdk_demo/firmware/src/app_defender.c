@@ -0,0 +1,172 @@
+/*******************************************************************************
+  MPLAB Harmony Application Source File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_defender.c
+
+  Summary:
+    This file contains the source code for the Device Defender agent.
+
+  Description:
+    The Defender library builds and publishes the reports from its job in the
+    system task pool, so the telemetry loop of app_aws never waits for them.
+    The metrics come from the TCP/IP stack through the platform metrics port
+    (iot_metrics_pic32mzw1.c); the traffic counters are fed by the WiFi driver.
+    A report that fails to go out stops the library's job, so the agent is
+    started again one period later.
+ *******************************************************************************/
+
+// *****************************************************************************
+
+#ifdef AWS_CLOUD_DEMO
+
+#include <string.h>
+#include "definitions.h"
+#include "iot_config.h"
+#include "app_aws.h"
+#include "app_defender.h"
+#include "app_config_store.h"
+#include "aws_iot_defender.h"
+#include "platform/iot_metrics.h"
+
+// *****************************************************************************
+
+static IotMqttConnection_t mqttConnection = IOT_MQTT_CONNECTION_INITIALIZER;
+static volatile bool failed;
+static uint64_t failTimeStamp;
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Local Functions
+// *****************************************************************************
+// *****************************************************************************
+
+static void configLoad(void)
+{
+    APP_DEFENDER_CONFIG rec;
+
+    if (appDefenderData.configLoaded)
+        return;
+    appDefenderData.configLoaded = true;
+    if (0 == APP_CONFIG_STORE_SlotRead(APP_CONFIG_STORE_SLOT_DEFENDER, &rec, sizeof(rec))
+            && APP_DEFENDER_CONFIG_MAGIC == rec.magic
+            && rec.periodS >= APP_DEFENDER_PERIOD_MIN_S && rec.periodS <= APP_DEFENDER_PERIOD_MAX_S)
+        appDefenderData.periodS = rec.periodS;
+}
+
+/* Runs in the task pool, with the publish job holding the library's lock */
+static void defenderCallback(void* pCallbackContext, AwsIotDefenderCallbackInfo_t* const pCallbackInfo)
+{
+    switch (pCallbackInfo->eventType) {
+        case AWS_IOT_DEFENDER_METRICS_ACCEPTED:
+            appDefenderData.nAccepted++;
+            appDefenderData.lastReportLength = pCallbackInfo->metricsReportLength;
+            APP_DEFENDER_DBG(SYS_ERROR_DEBUG, "Report accepted, %u bytes \r\n",
+                    (unsigned) pCallbackInfo->metricsReportLength);
+            break;
+        case AWS_IOT_DEFENDER_METRICS_REJECTED:
+            appDefenderData.nRejected++;
+            APP_DEFENDER_DBG(SYS_ERROR_WARNING, "Report rejected: %.*s \r\n",
+                    (int) pCallbackInfo->payloadLength, (const char*) pCallbackInfo->pPayload);
+            break;
+        default:
+            appDefenderData.nFailures++;
+            failTimeStamp = SYS_TIME_Counter64Get();
+            failed = true;
+            APP_DEFENDER_DBG(SYS_ERROR_ERROR, "Report not published (event %d) \r\n",
+                    (int) pCallbackInfo->eventType);
+            break;
+    }
+}
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Application Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+
+void APP_DEFENDER_Initialize(void)
+{
+    memset(&appDefenderData, 0, sizeof(appDefenderData));
+    appDefenderData.periodS = APP_DEFENDER_PERIOD_MIN_S;
+    mqttConnection = IOT_MQTT_CONNECTION_INITIALIZER;
+    failed = false;
+    IotMetrics_Init();
+}
+
+bool APP_DEFENDER_Start(IotMqttConnection_t connection)
+{
+    AwsIotDefenderStartInfo_t startInfo = AWS_IOT_DEFENDER_START_INFO_INITIALIZER;
+    AwsIotDefenderError_t status;
+
+    configLoad();
+    /* Stopping the library clears the metrics and the period */
+    AwsIotDefender_SetMetrics(AWS_IOT_DEFENDER_METRICS_TCP_CONNECTIONS, AWS_IOT_DEFENDER_METRICS_ALL);
+    AwsIotDefender_SetMetrics(AWS_IOT_DEFENDER_METRICS_LISTENING_TCP_PORTS, AWS_IOT_DEFENDER_METRICS_ALL);
+    AwsIotDefender_SetMetrics(AWS_IOT_DEFENDER_METRICS_LISTENING_UDP_PORTS, AWS_IOT_DEFENDER_METRICS_ALL);
+    AwsIotDefender_SetMetrics(AWS_IOT_DEFENDER_METRICS_NETWORK_STATS, AWS_IOT_DEFENDER_METRICS_ALL);
+    AwsIotDefender_SetPeriod(appDefenderData.periodS);
+
+    startInfo.mqttConnection = connection;
+    startInfo.pClientIdentifier = g_Aws_ClientID;
+    startInfo.clientIdentifierLength = (uint16_t) strlen(g_Aws_ClientID);
+    startInfo.callback.function = defenderCallback;
+
+    failed = false;
+    status = AwsIotDefender_Start(&startInfo);
+    if (AWS_IOT_DEFENDER_SUCCESS != status) {
+        APP_DEFENDER_DBG(SYS_ERROR_ERROR, "Start failed: %s \r\n", AwsIotDefender_strerror(status));
+        return false;
+    }
+    appDefenderData.started = true;
+    mqttConnection = connection;
+    APP_DEFENDER_DBG(SYS_ERROR_INFO, "Started, reports every %lu s \r\n", (unsigned long) appDefenderData.periodS);
+    return true;
+}
+
+void APP_DEFENDER_Stop(void)
+{
+    if (!appDefenderData.started)
+        return;
+    AwsIotDefender_Stop();
+    appDefenderData.started = false;
+    mqttConnection = IOT_MQTT_CONNECTION_INITIALIZER;
+}
+
+void APP_DEFENDER_Tasks(void)
+{
+    IotMqttConnection_t connection = mqttConnection;
+
+    if (!appDefenderData.started || !failed)
+        return;
+    if (SYS_TIME_Counter64Get() - failTimeStamp <
+            (uint64_t) SYS_TIME_FrequencyGet() * appDefenderData.periodS)
+        return;
+    APP_DEFENDER_Stop();
+    APP_DEFENDER_Start(connection);
+}
+
+bool APP_DEFENDER_PeriodSet(uint32_t periodS)
+{
+    APP_DEFENDER_CONFIG rec;
+
+    if (periodS < APP_DEFENDER_PERIOD_MIN_S || periodS > APP_DEFENDER_PERIOD_MAX_S)
+        return false;
+    configLoad();
+    appDefenderData.periodS = periodS;
+    if (appDefenderData.started)
+        AwsIotDefender_SetPeriod(periodS);
+    rec.magic = APP_DEFENDER_CONFIG_MAGIC;
+    rec.periodS = periodS;
+    APP_CONFIG_STORE_SlotWrite(APP_CONFIG_STORE_SLOT_DEFENDER, &rec, sizeof(rec));
+    return true;
+}
+
+#endif /* AWS_CLOUD_DEMO */
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,96 @@
+/*******************************************************************************
+  MPLAB Harmony Application Header File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_defender.h
+
+  Summary:
+    This header file provides prototypes and definitions for Device Defender.
+
+  Description:
+    This header file provides function prototypes and data type definitions for
+    the Device Defender agent. While connected, a metrics report with the TCP
+    connections, the listening TCP and UDP ports and the traffic since the last
+    report is published once per period, from the system task pool.
+*******************************************************************************/
+
+#ifndef _APP_DEFENDER_H
+#define _APP_DEFENDER_H
+
+#ifdef AWS_CLOUD_DEMO
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "iot_mqtt.h"
+#include "app_log.h"
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+/* Debug wrappers */
+#define APP_DEFENDER_DBG(level,fmt,...) APP_LOG_DBG(APP_LOG_MODULE_DEFENDER,level,"[APP_DEFENDER] "fmt,##__VA_ARGS__)
+#define APP_DEFENDER_PRNT(fmt,...) APP_LOG_PRNT(APP_LOG_MODULE_DEFENDER,"[APP_DEFENDER] "fmt, ##__VA_ARGS__)
+
+// *****************************************************************************
+
+/* Shortest period the service takes, and the default one */
+#define APP_DEFENDER_PERIOD_MIN_S       300
+#define APP_DEFENDER_PERIOD_MAX_S       (48 * 3600)
+#define APP_DEFENDER_CONFIG_MAGIC       0x44464e01      /* "DFN" + record version */
+
+// *****************************************************************************
+
+/* Private record in the configuration store */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t periodS;
+} APP_DEFENDER_CONFIG;
+
+typedef struct
+{
+    /* The agent lives as long as one MQTT connection */
+    bool started;
+    uint32_t periodS;
+    /* The store is read at the first connection */
+    bool configLoaded;
+    /* Statistics, written from the task pool */
+    volatile uint32_t nAccepted;
+    volatile uint32_t nRejected;
+    volatile uint32_t nFailures;
+    volatile uint32_t lastReportLength;
+} APP_DEFENDER_DATA;
+APP_DEFENDER_DATA appDefenderData;
+
+// *****************************************************************************
+
+void APP_DEFENDER_Initialize(void);
+/* Publish metrics reports on a new MQTT connection */
+bool APP_DEFENDER_Start(IotMqttConnection_t mqttConnection);
+/* The MQTT connection is gone; waits for a report being published */
+void APP_DEFENDER_Stop(void);
+/* Starts the agent again after a report that did not go out */
+void APP_DEFENDER_Tasks(void);
+/* Takes effect from the next report and is kept in the configuration store */
+bool APP_DEFENDER_PeriodSet(uint32_t periodS);
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* AWS_CLOUD_DEMO */
+#endif /* _APP_DEFENDER_H */
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,304 @@
+/*******************************************************************************
+  MPLAB Harmony Application Source File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_dhcp_lease.c
+
+  Summary:
+    This file contains the source code for the DHCP lease cache.
+
+  Description:
+    After a reset or a wake-up the DHCP client starts from scratch: DISCOVER,
+    wait for the OFFER, REQUEST, wait for the ACK, then a 1 s ARP probe. The
+    lease the device held before usually still runs, so it is kept here with
+    the BSS it came from. When the cached BSS is joined again the client is
+    put straight into INIT-REBOOT (RFC 2131 3.2), a single broadcast REQUEST
+    for the old address. If the lease is known to run for a while yet, the
+    address, gateway and DNS servers are also applied right away and the IP
+    link is reported up; a NAK from the server drops them and the client
+    falls back to a DISCOVER.
+ *******************************************************************************/
+#include <string.h>
+#include "app.h"
+#include "app_common.h"
+#include "app_config_store.h"
+#include "app_dhcp_lease.h"
+#include "app_time.h"
+#include "system/console/sys_console.h"
+
+// *****************************************************************************
+
+static const char* const pathNames[] = {
+    "client", "INIT-REBOOT", "cached lease"
+};
+
+static uint32_t ssidHash(void)
+{
+    return APP_CONFIG_STORE_Hash(wifi.ssid, strnlen((const char*)wifi.ssid, sizeof(wifi.ssid)));
+}
+
+/* The record was taken on the BSS the ongoing association went to */
+static bool leaseMatches(void)
+{
+    return appDhcpLeaseData.valid
+            && APP_DHCP_LeasePolicyMatches(appDhcpLeaseData.record.ssidHash, appDhcpLeaseData.record.bssid,
+                    ssidHash(), appData.fastConnectTried ? appData.fastConnect.bssid : NULL);
+}
+
+static void writeRecord(void)
+{
+    APP_DHCP_LEASE_RECORD rec;
+
+    taskENTER_CRITICAL();
+    rec = appDhcpLeaseData.record;
+    if (!appDhcpLeaseData.valid) {
+        rec.magic = 0;
+    }
+    appDhcpLeaseData.expiryStored = rec.expiry;
+    appDhcpLeaseData.dirty = false;
+    taskEXIT_CRITICAL();
+
+    /* A failed write is not retried; the record is rewritten on the next lease */
+    APP_CONFIG_STORE_SlotWrite(APP_CONFIG_STORE_SLOT_DHCP, &rec, sizeof(rec));
+}
+
+/* Copy the lease the client just got into the record */
+static void harvestLease(TCPIP_NET_HANDLE hNet)
+{
+    TCPIP_DHCP_INFO info;
+    APP_DHCP_LEASE_RECORD rec;
+    uint32_t now = APP_TIME_UTCSecondsGet();
+
+    if (!TCPIP_DHCP_InfoGet(hNet, &info)) {
+        return;
+    }
+
+    memset(&rec, 0, sizeof(rec));
+    rec.magic = APP_DHCP_LEASE_MAGIC;
+    rec.ssidHash = ssidHash();
+    rec.address = info.dhcpAddress;
+    rec.mask = info.subnetMask;
+    rec.gateway.Val = TCPIP_STACK_NetAddressGateway(hNet);
+    rec.dns[0].Val = TCPIP_STACK_NetAddressDnsPrimary(hNet);
+    rec.dns[1].Val = TCPIP_STACK_NetAddressDnsSecond(hNet);
+    rec.server = info.serverAddress;
+    rec.leaseDuration = info.leaseDuration;
+    /* The lease counts from the REQUEST, a moment ago */
+    rec.expiry = APP_DHCP_LeasePolicyExpiry(info.leaseDuration, now, TIME_IS_TRUSTED);
+
+    taskENTER_CRITICAL();
+    /* The BSSID is filled in by the task once the WLAN task has it */
+    memcpy(rec.bssid, appDhcpLeaseData.record.bssid, sizeof(rec.bssid));
+    if (!appDhcpLeaseData.valid
+            || rec.address.Val != appDhcpLeaseData.record.address.Val
+            || rec.mask.Val != appDhcpLeaseData.record.mask.Val
+            || rec.gateway.Val != appDhcpLeaseData.record.gateway.Val
+            || memcmp(rec.dns, appDhcpLeaseData.record.dns, sizeof(rec.dns))
+            || rec.server.Val != appDhcpLeaseData.record.server.Val
+            || rec.ssidHash != appDhcpLeaseData.record.ssidHash
+            || APP_DHCP_LeasePolicyStoreDue(rec.expiry, appDhcpLeaseData.expiryStored)) {
+        appDhcpLeaseData.dirty = true;
+    }
+    appDhcpLeaseData.record = rec;
+    appDhcpLeaseData.valid = true;
+    taskEXIT_CRITICAL();
+}
+
+static void dropLease(TCPIP_NET_HANDLE hNet, const char* reason)
+{
+    IPV4_ADDR zeroAdd = {0};
+
+    APP_DHCP_LEASE_PRNT("Cached lease %d.%d.%d.%d %s, asking for a new one\r\n",
+            appDhcpLeaseData.record.address.v[0], appDhcpLeaseData.record.address.v[1],
+            appDhcpLeaseData.record.address.v[2], appDhcpLeaseData.record.address.v[3], reason);
+    taskENTER_CRITICAL();
+    appDhcpLeaseData.valid = false;
+    appDhcpLeaseData.dirty = true;
+    taskEXIT_CRITICAL();
+    appDhcpLeaseData.confirming = false;
+
+    if (APP_DHCP_LEASE_PATH_CACHED == appDhcpLeaseData.path) {
+        /* The client is on its way to a DISCOVER; the address is not ours any more */
+        TCPIP_STACK_NetAddressSet(hNet, &zeroAdd, &zeroAdd, false);
+        IP_ADDR_LOST;
+        appDhcpLeaseData.ipReported = false;
+    }
+    appDhcpLeaseData.path = APP_DHCP_LEASE_PATH_CLIENT;
+}
+
+// *****************************************************************************
+
+/* Read the record left by a previous run. Called once the credentials are known */
+void APP_DHCP_LeaseLoad(void)
+{
+    APP_DHCP_LEASE_RECORD rec;
+
+    appDhcpLeaseData.valid = false;
+    if (0 != APP_CONFIG_STORE_SlotRead(APP_CONFIG_STORE_SLOT_DHCP, &rec, sizeof(rec))
+            || rec.magic != APP_DHCP_LEASE_MAGIC
+            || rec.ssidHash != ssidHash()
+            || rec.address.Val == 0) {
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    appDhcpLeaseData.record = rec;
+    appDhcpLeaseData.valid = true;
+    appDhcpLeaseData.dirty = false;
+    appDhcpLeaseData.expiryStored = rec.expiry;
+    taskEXIT_CRITICAL();
+
+    APP_DHCP_LEASE_DBG(SYS_ERROR_INFO, "Cached lease %d.%d.%d.%d from %d.%d.%d.%d\r\n",
+            rec.address.v[0], rec.address.v[1], rec.address.v[2], rec.address.v[3],
+            rec.server.v[0], rec.server.v[1], rec.server.v[2], rec.server.v[3]);
+}
+
+/* The link is up in STA mode. Take over the start of the DHCP client if the
+ * cached lease applies; false leaves it to the usual DISCOVER */
+bool APP_DHCP_LeaseStart(TCPIP_NET_HANDLE hNet)
+{
+    APP_DHCP_LEASE_RECORD *pRec = &appDhcpLeaseData.record;
+    uint32_t now = APP_TIME_UTCSecondsGet();
+    APP_DHCP_LEASE_PATH path;
+    bool useNow;
+
+    appDhcpLeaseData.linkTimeStamp = SYS_TIME_Counter64Get();
+    appDhcpLeaseData.ipReported = false;
+    appDhcpLeaseData.timeToBoundMs = 0;
+    appDhcpLeaseData.confirming = false;
+    appDhcpLeaseData.path = APP_DHCP_LEASE_PATH_CLIENT;
+    path = APP_DHCP_LeasePolicyPath(leaseMatches(), pRec->expiry, now, TIME_IS_TRUSTED);
+    if (APP_DHCP_LEASE_PATH_CLIENT == path)
+        return false;
+    useNow = APP_DHCP_LEASE_PATH_CACHED == path;
+
+    /* The client was started with the interface; restart it in INIT-REBOOT.
+     * With DHCP disabled the address set here is kept while the REQUEST runs */
+    TCPIP_DHCP_Disable(hNet);
+    if (useNow) {
+        TCPIP_STACK_NetAddressSet(hNet, &pRec->address, &pRec->mask, false);
+        TCPIP_STACK_NetAddressGatewaySet(hNet, &pRec->gateway);
+        if (pRec->dns[0].Val)
+            TCPIP_STACK_NetAddressDnsPrimarySet(hNet, &pRec->dns[0]);
+        if (pRec->dns[1].Val)
+            TCPIP_STACK_NetAddressDnsSecondSet(hNet, &pRec->dns[1]);
+    }
+    if (!TCPIP_DHCP_Request(hNet, pRec->address)) {
+        APP_DHCP_LEASE_DBG(SYS_ERROR_ERROR, "INIT-REBOOT not started\r\n");
+        TCPIP_DHCP_Enable(hNet);
+        return false;
+    }
+
+    appDhcpLeaseData.confirming = true;
+    if (useNow) {
+        appDhcpLeaseData.path = APP_DHCP_LEASE_PATH_CACHED;
+        appDhcpLeaseData.nCached++;
+        appDhcpLeaseData.ipReported = true;
+        appDhcpLeaseData.timeToIpMs = 0;
+        APP_DHCP_LEASE_PRNT("Using cached lease %d.%d.%d.%d (%lu s left), confirming it\r\n",
+                pRec->address.v[0], pRec->address.v[1], pRec->address.v[2], pRec->address.v[3],
+                (unsigned long) (pRec->expiry - now));
+        IP_ADDR_OBTAINED;
+    } else {
+        appDhcpLeaseData.path = APP_DHCP_LEASE_PATH_INIT_REBOOT;
+        appDhcpLeaseData.nInitReboot++;
+        APP_DHCP_LEASE_PRNT("Requesting %d.%d.%d.%d again (INIT-REBOOT)\r\n",
+                pRec->address.v[0], pRec->address.v[1], pRec->address.v[2], pRec->address.v[3]);
+    }
+    return true;
+}
+
+/* Called from the DHCP event handler of the application */
+void APP_DHCP_LeaseEvent(TCPIP_NET_HANDLE hNet, TCPIP_DHCP_EVENT_TYPE evType)
+{
+    uint32_t elapsedMs;
+
+    switch (evType) {
+        case DHCP_EVENT_BOUND:
+        {
+            elapsedMs = APP_MsSince(appDhcpLeaseData.linkTimeStamp);
+            harvestLease(hNet);
+            appDhcpLeaseData.confirming = false;
+            if (!appDhcpLeaseData.ipReported) {
+                /* First lease of this link; renewals come here too */
+                appDhcpLeaseData.ipReported = true;
+                appDhcpLeaseData.timeToIpMs = elapsedMs;
+                appDhcpLeaseData.timeToBoundMs = elapsedMs;
+                APP_DHCP_LEASE_PRNT("IP address %lu ms after link up (%s)\r\n",
+                        (unsigned long) elapsedMs, pathNames[appDhcpLeaseData.path]);
+            } else if (0 == appDhcpLeaseData.timeToBoundMs) {
+                appDhcpLeaseData.timeToBoundMs = elapsedMs;
+                APP_DHCP_LEASE_DBG(SYS_ERROR_INFO, "Cached lease confirmed %lu ms after link up\r\n",
+                        (unsigned long) elapsedMs);
+            }
+            break;
+        }
+
+        case DHCP_EVENT_NACK:
+        {
+            if (appDhcpLeaseData.confirming) {
+                appDhcpLeaseData.nNak++;
+                dropLease(hNet, "refused by the server");
+            }
+            break;
+        }
+
+        case DHCP_EVENT_DECLINE:
+        {
+            if (appDhcpLeaseData.confirming) {
+                dropLease(hNet, "in use by another host");
+            }
+            break;
+        }
+
+        case DHCP_EVENT_CONN_LOST:
+        {
+            appDhcpLeaseData.ipReported = false;
+            appDhcpLeaseData.confirming = false;
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+const char* APP_DHCP_LeasePathName(APP_DHCP_LEASE_PATH path)
+{
+    return (path <= APP_DHCP_LEASE_PATH_CACHED) ? pathNames[path] : "?";
+}
+
+void APP_DHCP_Lease_Initialize(void)
+{
+    memset(&appDhcpLeaseData, 0, sizeof(appDhcpLeaseData));
+}
+
+void APP_DHCP_Lease_Tasks(void)
+{
+    APP_DHCP_LEASE_RECORD *pRec = &appDhcpLeaseData.record;
+
+    if (!APP_CONFIG_STORE_Loaded())
+        return;
+
+    if (appDhcpLeaseData.valid && IP_ADDR_IS_OBTAINED && !appDhcpLeaseData.confirming) {
+        /* Wait for the WLAN task to capture the BSSID of this association;
+         * after a roam the lease carries over to the new BSS */
+        if (!WIFI_IS_CONNECTED || !appData.fastConnectValid || appData.fastConnectUpdate)
+            return;
+        if (memcmp(pRec->bssid, appData.fastConnect.bssid, sizeof(pRec->bssid))) {
+            taskENTER_CRITICAL();
+            memcpy(pRec->bssid, appData.fastConnect.bssid, sizeof(pRec->bssid));
+            appDhcpLeaseData.dirty = true;
+            taskEXIT_CRITICAL();
+        }
+    }
+    if (appDhcpLeaseData.dirty)
+        writeRecord();
+}
+
+/*******************************************************************************
+ End of File
+ */
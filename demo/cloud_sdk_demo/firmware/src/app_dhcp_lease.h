@@ -0,0 +1,109 @@
+/*******************************************************************************
+  MPLAB Harmony Application Header File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_dhcp_lease.h
+
+  Summary:
+    This header file provides prototypes and definitions for the application.
+
+  Description:
+    This header file provides function prototypes and data type definitions for
+    the DHCP lease cache. The last lease is kept in the configuration store
+    with the BSS it was obtained on. On a connect to the same BSS the address
+    is asked for again with an INIT-REBOOT REQUEST instead of a full
+    DISCOVER/OFFER exchange, and while the lease is known to be valid it is
+    used at once, the REQUEST confirming it in the background.
+*******************************************************************************/
+
+#ifndef _APP_DHCP_LEASE_H
+#define _APP_DHCP_LEASE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include "configuration.h"
+#include "tcpip/tcpip.h"
+#include "wdrv_pic32mzw_common.h"
+#include "app_log.h"
+#include "app_dhcp_lease_policy.h"
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+/* Debug wrappers */
+#define APP_DHCP_LEASE_DBG(level,fmt,...) APP_LOG_DBG(APP_LOG_MODULE_DHCP,level,"[APP_DHCP] "fmt,##__VA_ARGS__)
+#define APP_DHCP_LEASE_PRNT(fmt,...) APP_LOG_PRNT(APP_LOG_MODULE_DHCP,"[APP_DHCP] "fmt, ##__VA_ARGS__)
+
+// *****************************************************************************
+
+#define APP_DHCP_LEASE_MAGIC                0x44484301      /* "DHC" + record version */
+
+/* Kept in the DHCP slot of the configuration store */
+typedef struct
+{
+    uint32_t magic;
+    /* Network the lease was obtained on */
+    uint32_t ssidHash;
+    uint8_t bssid[WDRV_PIC32MZW_MAC_ADDR_LEN];
+    IPV4_ADDR address;
+    IPV4_ADDR mask;
+    IPV4_ADDR gateway;
+    IPV4_ADDR dns[2];
+    IPV4_ADDR server;
+    uint32_t leaseDuration;
+    /* UTC seconds at which the lease runs out; 0 if unknown */
+    uint32_t expiry;
+} APP_DHCP_LEASE_RECORD;
+
+typedef struct
+{
+    APP_DHCP_LEASE_RECORD record;
+    bool valid;
+    /* The record differs from the copy in the store */
+    volatile bool dirty;
+    uint32_t expiryStored;
+    /* Current link */
+    APP_DHCP_LEASE_PATH path;
+    /* The INIT-REBOOT REQUEST has not been answered yet */
+    bool confirming;
+    uint64_t linkTimeStamp;
+    bool ipReported;
+    uint32_t timeToIpMs;
+    uint32_t timeToBoundMs;
+    /* Counters since boot */
+    uint32_t nInitReboot;
+    uint32_t nCached;
+    uint32_t nNak;
+} APP_DHCP_LEASE_DATA;
+APP_DHCP_LEASE_DATA appDhcpLeaseData;
+
+// *****************************************************************************
+
+void APP_DHCP_LeaseLoad( void );
+bool APP_DHCP_LeaseStart( TCPIP_NET_HANDLE hNet );
+void APP_DHCP_LeaseEvent( TCPIP_NET_HANDLE hNet, TCPIP_DHCP_EVENT_TYPE evType );
+const char* APP_DHCP_LeasePathName( APP_DHCP_LEASE_PATH path );
+void APP_DHCP_Lease_Initialize( void );
+void APP_DHCP_Lease_Tasks( void );
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _APP_DHCP_LEASE_H */
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,64 @@
+/*******************************************************************************
+  MPLAB Harmony Application Source File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_dhcp_lease_policy.c
+
+  Summary:
+    This file contains the source code for the DHCP lease cache decisions.
+
+  Description:
+    A cached lease is only tried on the BSS it was obtained on: another AP of
+    the same network may sit behind another DHCP server, and the client then
+    does its own INIT-REBOOT anyway. On that BSS the old address is always
+    asked for again (RFC 2131 3.2), and only applied before the ACK if the
+    clock is trusted and says the lease runs for a while yet. Without a
+    trusted clock the lease may well have run out during the reset.
+ *******************************************************************************/
+
+#include <string.h>
+#include "app_dhcp_lease_policy.h"
+
+// *****************************************************************************
+
+/* The lease was taken on the network and BSS of the ongoing association.
+ * 'bssid' is NULL while the BSS of the association is not known */
+bool APP_DHCP_LeasePolicyMatches(uint32_t leaseSsidHash, const uint8_t* leaseBssid,
+                                 uint32_t ssidHash, const uint8_t* bssid)
+{
+    return NULL != bssid
+            && leaseSsidHash == ssidHash
+            && 0 == memcmp(leaseBssid, bssid, APP_DHCP_LEASE_BSSID_LEN);
+}
+
+/* How to start the DHCP client on a new link. 'now' is 0 while the time is
+ * not known, like an 'expiry' that was never set */
+APP_DHCP_LEASE_PATH APP_DHCP_LeasePolicyPath(bool matches, uint32_t expiry, uint32_t now, bool timeTrusted)
+{
+    if (!matches)
+        return APP_DHCP_LEASE_PATH_CLIENT;
+    if (timeTrusted && now && expiry
+            && (int32_t)(expiry - now) > APP_DHCP_LEASE_MIN_REMAINING_s)
+        return APP_DHCP_LEASE_PATH_CACHED;
+    return APP_DHCP_LEASE_PATH_INIT_REBOOT;
+}
+
+/* UTC seconds at which a lease granted now runs out; 0 if unknown */
+uint32_t APP_DHCP_LeasePolicyExpiry(uint32_t leaseDuration, uint32_t now, bool timeTrusted)
+{
+    return (now && timeTrusted) ? (now + leaseDuration) : 0;
+}
+
+/* A renewal of an unchanged lease moved the expiry far enough to be stored.
+ * A shorter lease than the stored one is always stored */
+bool APP_DHCP_LeasePolicyStoreDue(uint32_t expiry, uint32_t expiryStored)
+{
+    return expiry && expiry - expiryStored >= APP_DHCP_LEASE_STORE_INTERVAL_s;
+}
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,76 @@
+/*******************************************************************************
+  MPLAB Harmony Application Header File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_dhcp_lease_policy.h
+
+  Summary:
+    This header file provides prototypes and definitions for the application.
+
+  Description:
+    This header file provides function prototypes and data type definitions for
+    the decisions of the DHCP lease cache: whether a cached lease applies to the
+    link being brought up, whether it is used right away or only asked for again
+    with INIT-REBOOT, and when a renewed lease is worth storing. Plain C with no
+    stack or RTOS dependency; app_dhcp_lease.c applies the decisions and
+    test/app_tests_dhcp_lease.c runs them on a host.
+*******************************************************************************/
+
+#ifndef _APP_DHCP_LEASE_POLICY_H
+#define _APP_DHCP_LEASE_POLICY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+// *****************************************************************************
+
+/* The cached address is only used without waiting for the ACK if the lease
+ * has at least this long to run */
+#define APP_DHCP_LEASE_MIN_REMAINING_s      60
+/* Renewals only move the expiry; they are stored at most this often */
+#define APP_DHCP_LEASE_STORE_INTERVAL_s     86400
+/* Same as WDRV_PIC32MZW_MAC_ADDR_LEN */
+#define APP_DHCP_LEASE_BSSID_LEN            6
+
+// *****************************************************************************
+
+/* How the address of the current link was obtained. CLIENT is the DHCP
+ * client left to itself: a DISCOVER, or its own INIT-REBOOT after a roam */
+typedef enum
+{
+    APP_DHCP_LEASE_PATH_CLIENT=0,
+    APP_DHCP_LEASE_PATH_INIT_REBOOT,
+    APP_DHCP_LEASE_PATH_CACHED
+} APP_DHCP_LEASE_PATH;
+
+// *****************************************************************************
+
+bool APP_DHCP_LeasePolicyMatches( uint32_t leaseSsidHash, const uint8_t* leaseBssid,
+                                  uint32_t ssidHash, const uint8_t* bssid );
+APP_DHCP_LEASE_PATH APP_DHCP_LeasePolicyPath( bool matches, uint32_t expiry, uint32_t now, bool timeTrusted );
+uint32_t APP_DHCP_LeasePolicyExpiry( uint32_t leaseDuration, uint32_t now, bool timeTrusted );
+bool APP_DHCP_LeasePolicyStoreDue( uint32_t expiry, uint32_t expiryStored );
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _APP_DHCP_LEASE_POLICY_H */
+
+/*******************************************************************************
+ End of File
+ */
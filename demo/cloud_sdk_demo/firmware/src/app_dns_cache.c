@@ -0,0 +1,259 @@
+/*******************************************************************************
+  MPLAB Harmony Application Source File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_dns_cache.c
+
+  Summary:
+    This file contains the source code for the persistent DNS cache.
+
+  Description:
+    The TCP/IP stack DNS client only caches in RAM, so the cloud endpoint used
+    to be resolved from scratch after every reset. This module keeps the last
+    answer for the endpoint (addresses and TTL expiry) in the configuration
+    store. The network layer dials the cached address right away, even past
+    its TTL, and this task re-resolves the name in the background so that the
+    record stays current. The decisions are in app_dns_cache_policy.c.
+ *******************************************************************************/
+#include <string.h>
+#include "app.h"
+#include "app_dns_cache.h"
+#include "app_common.h"
+#include "app_config_store.h"
+#include "app_time.h"
+#include "iot_network_wolfssl.h"
+#include "system/console/sys_console.h"
+
+// *****************************************************************************
+
+#if APP_DNS_CACHE_HOSTNAME_LEN != TCPIP_DNS_CLIENT_MAX_HOSTNAME_LEN
+#error "APP_DNS_CACHE_HOSTNAME_LEN must follow TCPIP_DNS_CLIENT_MAX_HOSTNAME_LEN"
+#endif
+
+static APP_DNS_CACHE_DATA appDnsCacheData;
+
+// *****************************************************************************
+
+/* Seconds since epoch, or 0 while the time is not known yet */
+static uint32_t utcNow(void)
+{
+    return APP_TIME_UTCSecondsGet();
+}
+
+static bool networkCacheGet(const char* hostName, uint32_t* pAddress, bool* pStale)
+{
+    IPV4_ADDR addr;
+    APP_DNS_CACHE_LOOKUP lookup = APP_DNS_CacheGet(hostName, &addr);
+
+    if (lookup == APP_DNS_CACHE_LOOKUP_MISS) {
+        return false;
+    }
+    *pAddress = addr.Val;
+    *pStale = (lookup == APP_DNS_CACHE_LOOKUP_STALE);
+    return true;
+}
+
+static void networkCacheInvalidate(const char* hostName, uint32_t address)
+{
+    IPV4_ADDR addr;
+
+    addr.Val = address;
+    APP_DNS_CacheInvalidate(hostName, addr);
+}
+
+/* Registered with the network layer of the AWS SDK */
+static const IotNetworkAddressCache_t appDnsCacheNetwork = {
+    .get = networkCacheGet,
+    .store = APP_DNS_CacheStore,
+    .invalidate = networkCacheInvalidate,
+    .connectTimeout = APP_DNS_CACHE_CONNECT_TMO_s
+};
+
+static void writeRecord(void)
+{
+    APP_DNS_CACHE_RECORD rec;
+
+    taskENTER_CRITICAL();
+    rec = appDnsCacheData.entry.record;
+    if (!appDnsCacheData.entry.valid) {
+        rec.magic = 0;
+    }
+    appDnsCacheData.entry.dirty = false;
+    taskEXIT_CRITICAL();
+
+    /* A failed write is not retried; the record is rewritten on the next change */
+    APP_CONFIG_STORE_SlotWrite(APP_CONFIG_STORE_SLOT_DNS, &rec, sizeof(rec));
+}
+
+/* Copy the answer the stack holds for 'hostName' into the cache record */
+static bool harvestEntry(const char* hostName)
+{
+    TCPIP_DNS_ENTRY_QUERY query;
+    char name[TCPIP_DNS_CLIENT_MAX_HOSTNAME_LEN + 1];
+    IPV4_ADDR addr[APP_DNS_CACHE_MAX_ADDR];
+    uint32_t addrVal[APP_DNS_CACHE_MAX_ADDR];
+    uint32_t now = utcNow();
+    int ix, n;
+
+    memset(&query, 0, sizeof(query));
+    query.hostName = name;
+    query.nameLen = sizeof(name);
+    query.ipv4Entry = addr;
+    query.nIPv4Entries = APP_DNS_CACHE_MAX_ADDR;
+
+    for (ix = 0; ix < TCPIP_DNS_CLIENT_CACHE_ENTRIES; ix++) {
+        if (TCPIP_DNS_EntryQuery(&query, ix) != TCPIP_DNS_RES_OK ||
+                query.nIPv4ValidEntries == 0 || strcmp(name, hostName) != 0) {
+            continue;
+        }
+
+        for (n = 0; n < query.nIPv4ValidEntries; n++) {
+            addrVal[n] = addr[n].Val;
+        }
+        taskENTER_CRITICAL();
+        APP_DNS_CachePolicyAnswer(&appDnsCacheData.entry, hostName, addrVal,
+                (uint8_t) query.nIPv4ValidEntries, query.ttlTime, now);
+        taskEXIT_CRITICAL();
+
+        APP_DNS_CACHE_DBG(SYS_ERROR_DEBUG, "%s -> %d.%d.%d.%d (%d addr, ttl %lu)\r\n", hostName,
+                addr[0].v[0], addr[0].v[1], addr[0].v[2], addr[0].v[3], query.nIPv4ValidEntries, (unsigned long) query.ttlTime);
+        return true;
+    }
+    return false;
+}
+
+// *****************************************************************************
+
+/* Read the record left by a previous run. Called once the configuration is known */
+void APP_DNS_CacheLoad(void)
+{
+    APP_DNS_CACHE_RECORD rec;
+    IPV4_ADDR first;
+    bool loaded;
+
+    if (0 != APP_CONFIG_STORE_SlotRead(APP_CONFIG_STORE_SLOT_DNS, &rec, sizeof(rec))) {
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    loaded = APP_DNS_CachePolicyLoad(&appDnsCacheData.entry, &rec);
+    taskEXIT_CRITICAL();
+
+    if (loaded) {
+        first.Val = rec.addr[0];
+        APP_DNS_CACHE_PRNT("Cached %s -> %d.%d.%d.%d\r\n", appDnsCacheData.entry.record.hostName,
+                first.v[0], first.v[1], first.v[2], first.v[3]);
+    }
+}
+
+/* Return the cached address of 'hostName', marked stale once its TTL is known
+ * to have run out; the refresh is then started right away. The caller dials it
+ * with a short timeout, and invalidates the entry if it does not answer */
+APP_DNS_CACHE_LOOKUP APP_DNS_CacheGet(const char* hostName, IPV4_ADDR* addr)
+{
+    uint32_t now = utcNow();
+    APP_DNS_CACHE_LOOKUP lookup;
+
+    taskENTER_CRITICAL();
+    lookup = APP_DNS_CachePolicyGet(&appDnsCacheData.entry, hostName, now, TIME_IS_TRUSTED, &addr->Val);
+    taskEXIT_CRITICAL();
+    return lookup;
+}
+
+/* Pick up the answer of a lookup just completed by the TCP/IP stack */
+void APP_DNS_CacheStore(const char* hostName)
+{
+    harvestEntry(hostName);
+}
+
+/* The cached address 'addr' did not answer. Rotate to the next one, or drop
+ * the entry once all of them have been tried */
+void APP_DNS_CacheInvalidate(const char* hostName, IPV4_ADDR addr)
+{
+    taskENTER_CRITICAL();
+    APP_DNS_CachePolicyInvalidate(&appDnsCacheData.entry, hostName, addr.Val);
+    taskEXIT_CRITICAL();
+    TCPIP_DNS_RemoveEntry(hostName);
+}
+
+void APP_DNS_Cache_Initialize(void)
+{
+    memset(&appDnsCacheData, 0, sizeof(appDnsCacheData));
+    appDnsCacheData.state = APP_DNS_CACHE_STATE_IDLE;
+    IotNetworkWolfSSL_SetAddressCache(&appDnsCacheNetwork);
+}
+
+void APP_DNS_Cache_Tasks(void)
+{
+    IP_MULTI_ADDRESS addr;
+    TCPIP_DNS_RESULT result;
+    uint32_t now;
+    bool refreshDue;
+
+    switch (appDnsCacheData.state) {
+        case APP_DNS_CACHE_STATE_IDLE:
+        {
+            if (appDnsCacheData.entry.dirty) {
+                writeRecord();
+            }
+
+            if (!WIFI_IS_CONNECTED || !IP_ADDR_IS_OBTAINED || !TIME_IS_TRUSTED) {
+                break;
+            }
+            now = utcNow();
+            taskENTER_CRITICAL();
+            refreshDue = APP_DNS_CachePolicyRefreshDue(&appDnsCacheData.entry, now);
+            taskEXIT_CRITICAL();
+            if (refreshDue) {
+                appDnsCacheData.state = APP_DNS_CACHE_STATE_REFRESH;
+            }
+            break;
+        }
+
+        case APP_DNS_CACHE_STATE_REFRESH:
+        {
+            /* Send_Query bypasses the stack's RAM cache and always asks the server */
+            result = TCPIP_DNS_Send_Query(appDnsCacheData.entry.record.hostName, TCPIP_DNS_TYPE_A);
+            if (result < 0) {
+                APP_DNS_CACHE_DBG(SYS_ERROR_DEBUG, "Refresh of %s not started (%d)\r\n", appDnsCacheData.entry.record.hostName, result);
+                now = utcNow();
+                taskENTER_CRITICAL();
+                APP_DNS_CachePolicyRefreshFailed(&appDnsCacheData.entry, now);
+                taskEXIT_CRITICAL();
+                appDnsCacheData.state = APP_DNS_CACHE_STATE_IDLE;
+                break;
+            }
+            appDnsCacheData.refreshTimeStamp = SYS_TIME_CounterGet();
+            appDnsCacheData.state = APP_DNS_CACHE_STATE_WAIT_REFRESH;
+            break;
+        }
+
+        case APP_DNS_CACHE_STATE_WAIT_REFRESH:
+        {
+            result = TCPIP_DNS_IsResolved(appDnsCacheData.entry.record.hostName, &addr, IP_ADDRESS_TYPE_IPV4);
+            if (result == TCPIP_DNS_RES_PENDING &&
+                    SYS_TIME_CounterGet() - appDnsCacheData.refreshTimeStamp < SYS_TIME_FrequencyGet() * APP_DNS_CACHE_QUERY_TMO_s) {
+                break;
+            }
+            if (result != TCPIP_DNS_RES_OK || !harvestEntry(appDnsCacheData.entry.record.hostName)) {
+                APP_DNS_CACHE_DBG(SYS_ERROR_INFO, "Refresh of %s failed (%d)\r\n", appDnsCacheData.entry.record.hostName, result);
+                now = utcNow();
+                taskENTER_CRITICAL();
+                APP_DNS_CachePolicyRefreshFailed(&appDnsCacheData.entry, now);
+                taskEXIT_CRITICAL();
+            }
+            appDnsCacheData.state = APP_DNS_CACHE_STATE_IDLE;
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,86 @@
+/*******************************************************************************
+  MPLAB Harmony Application Header File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_dns_cache.h
+
+  Summary:
+    This header file provides prototypes and definitions for the application.
+
+  Description:
+    This header file provides function prototypes and data type definitions for
+    the persistent DNS cache of the cloud endpoint. The last resolved addresses
+    and their TTL are kept in the configuration store so that a connection can
+    be started right after boot, while the entry is refreshed in the background.
+*******************************************************************************/
+
+#ifndef _APP_DNS_CACHE_H
+#define _APP_DNS_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include "configuration.h"
+#include "tcpip/tcpip.h"
+#include "app_log.h"
+#include "app_dns_cache_policy.h"
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+/* Debug wrappers */
+#define APP_DNS_CACHE_DBG(level,fmt,...) APP_LOG_DBG(APP_LOG_MODULE_DNS,level,"[APP_DNS] "fmt,##__VA_ARGS__)
+#define APP_DNS_CACHE_PRNT(fmt,...) APP_LOG_PRNT(APP_LOG_MODULE_DNS,"[APP_DNS] "fmt, ##__VA_ARGS__)
+
+// *****************************************************************************
+
+/* Give up on a background refresh after this long and retry later */
+#define APP_DNS_CACHE_QUERY_TMO_s       10
+/* TCP connect timeout used when dialing a cached (possibly stale) address */
+#define APP_DNS_CACHE_CONNECT_TMO_s     3
+
+// *****************************************************************************
+
+typedef enum
+{
+    APP_DNS_CACHE_STATE_IDLE=0,
+    APP_DNS_CACHE_STATE_REFRESH,
+    APP_DNS_CACHE_STATE_WAIT_REFRESH
+} APP_DNS_CACHE_STATES;
+
+typedef struct
+{
+    APP_DNS_CACHE_STATES state;
+    APP_DNS_CACHE_ENTRY entry;
+    uint32_t refreshTimeStamp;
+} APP_DNS_CACHE_DATA;
+
+// *****************************************************************************
+
+void APP_DNS_CacheLoad( void );
+APP_DNS_CACHE_LOOKUP APP_DNS_CacheGet( const char* hostName, IPV4_ADDR* addr );
+void APP_DNS_CacheStore( const char* hostName );
+void APP_DNS_CacheInvalidate( const char* hostName, IPV4_ADDR addr );
+void APP_DNS_Cache_Initialize( void );
+void APP_DNS_Cache_Tasks( void );
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _APP_DNS_CACHE_H */
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,135 @@
+/*******************************************************************************
+  MPLAB Harmony Application Source File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_dns_cache_policy.c
+
+  Summary:
+    This file contains the source code for the DNS cache decisions.
+
+  Description:
+    The cached answer is never withheld from a connection: past its TTL it is
+    handed out marked stale, and the refresh is pulled in so that the retry of
+    a failed connection gets the new answer. A dead address is caught by the
+    short connect timeout of the network layer, which invalidates it; the next
+    address of the answer is tried, and once all of them failed the entry is
+    dropped and the name resolved again.
+ *******************************************************************************/
+
+#include <string.h>
+#include "app_dns_cache_policy.h"
+
+// *****************************************************************************
+
+static bool hostMatches(const APP_DNS_CACHE_ENTRY* entry, const char* hostName)
+{
+    return entry->valid &&
+            0 == strncmp(entry->record.hostName, hostName, sizeof(entry->record.hostName));
+}
+
+// *****************************************************************************
+
+/* Adopt the record left by a previous run. Its expiry can only be checked once
+ * the time is known, so it is refreshed as soon as we are online */
+bool APP_DNS_CachePolicyLoad(APP_DNS_CACHE_ENTRY* entry, const APP_DNS_CACHE_RECORD* rec)
+{
+    if (rec->magic != APP_DNS_CACHE_MAGIC ||
+            rec->nAddr == 0 || rec->nAddr > APP_DNS_CACHE_MAX_ADDR) {
+        return false;
+    }
+
+    entry->record = *rec;
+    entry->record.hostName[sizeof(entry->record.hostName) - 1] = '\0';
+    entry->valid = true;
+    entry->dirty = false;
+    entry->addrIdx = 0;
+    entry->nextRefresh = 0;
+    return true;
+}
+
+/* The address to dial for 'hostName'. 'now' is 0 while the time is not known,
+ * like an 'expiry' that was never set. A stale answer pulls the refresh in */
+APP_DNS_CACHE_LOOKUP APP_DNS_CachePolicyGet(APP_DNS_CACHE_ENTRY* entry, const char* hostName,
+                                            uint32_t now, bool timeTrusted, uint32_t* addr)
+{
+    if (!hostMatches(entry, hostName)) {
+        return APP_DNS_CACHE_LOOKUP_MISS;
+    }
+    *addr = entry->record.addr[entry->addrIdx % entry->record.nAddr];
+
+    if (!timeTrusted || now == 0 || entry->record.expiry == 0 ||
+            (int32_t) (now - entry->record.expiry) < 0) {
+        return APP_DNS_CACHE_LOOKUP_FRESH;
+    }
+    /* Unless a refresh is already due within the margin, e.g. after one failed */
+    if (entry->nextRefresh == 0 ||
+            (int32_t) (entry->nextRefresh - now) > APP_DNS_CACHE_REFRESH_MARGIN_s) {
+        entry->nextRefresh = now;
+    }
+    return APP_DNS_CACHE_LOOKUP_STALE;
+}
+
+/* Take the answer of a lookup of 'hostName': 'nAddr' addresses valid for 'ttl'
+ * seconds. Only a change of the addresses has to survive a reset */
+void APP_DNS_CachePolicyAnswer(APP_DNS_CACHE_ENTRY* entry, const char* hostName,
+                               const uint32_t* addr, uint8_t nAddr, uint32_t ttl, uint32_t now)
+{
+    if (nAddr == 0) {
+        return;
+    }
+    if (nAddr > APP_DNS_CACHE_MAX_ADDR) {
+        nAddr = APP_DNS_CACHE_MAX_ADDR;
+    }
+
+    if (!hostMatches(entry, hostName) || entry->record.nAddr != nAddr ||
+            memcmp(entry->record.addr, addr, nAddr * sizeof(addr[0])) != 0) {
+        entry->dirty = true;
+        entry->addrIdx = 0;
+    }
+    entry->record.magic = APP_DNS_CACHE_MAGIC;
+    strncpy(entry->record.hostName, hostName, sizeof(entry->record.hostName) - 1);
+    entry->record.hostName[sizeof(entry->record.hostName) - 1] = '\0';
+    entry->record.nAddr = nAddr;
+    memcpy(entry->record.addr, addr, nAddr * sizeof(addr[0]));
+    entry->record.expiry = now ? (now + ttl) : 0;
+    entry->valid = true;
+    entry->nextRefresh = now + ((ttl > APP_DNS_CACHE_MIN_REFRESH_s + APP_DNS_CACHE_REFRESH_MARGIN_s) ?
+            (ttl - APP_DNS_CACHE_REFRESH_MARGIN_s) : APP_DNS_CACHE_MIN_REFRESH_s);
+}
+
+/* 'addr', handed out for 'hostName', did not answer. Rotate to the next
+ * address, or drop the entry once all of them have been tried. A refresh that
+ * completed while 'addr' was being dialed already replaced it */
+void APP_DNS_CachePolicyInvalidate(APP_DNS_CACHE_ENTRY* entry, const char* hostName, uint32_t addr)
+{
+    if (!hostMatches(entry, hostName) ||
+            entry->record.addr[entry->addrIdx % entry->record.nAddr] != addr) {
+        return;
+    }
+    if (++entry->addrIdx >= entry->record.nAddr) {
+        entry->valid = false;
+        entry->dirty = true;
+    }
+    entry->nextRefresh = 0;
+}
+
+/* Time to ask the server again for the cached name */
+bool APP_DNS_CachePolicyRefreshDue(const APP_DNS_CACHE_ENTRY* entry, uint32_t now)
+{
+    return entry->valid &&
+            (entry->nextRefresh == 0 || (int32_t) (now - entry->nextRefresh) >= 0);
+}
+
+/* The refresh got no answer. Keep serving the old one, it is still the best
+ * guess we have, and try again after the margin */
+void APP_DNS_CachePolicyRefreshFailed(APP_DNS_CACHE_ENTRY* entry, uint32_t now)
+{
+    entry->nextRefresh = now + APP_DNS_CACHE_REFRESH_MARGIN_s;
+}
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,106 @@
+/*******************************************************************************
+  MPLAB Harmony Application Header File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_dns_cache_policy.h
+
+  Summary:
+    This header file provides prototypes and definitions for the application.
+
+  Description:
+    This header file provides function prototypes and data type definitions for
+    the decisions of the persistent DNS cache: which address a connection is
+    dialed with, when the entry is refreshed, what a new answer or a dead
+    address does to it. Plain C with no stack or RTOS dependency;
+    app_dns_cache.c applies the decisions under its lock and
+    test/app_tests_dns_cache.c runs them on a host.
+*******************************************************************************/
+
+#ifndef _APP_DNS_CACHE_POLICY_H
+#define _APP_DNS_CACHE_POLICY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+// *****************************************************************************
+
+#define APP_DNS_CACHE_MAGIC             0x444E5301      /* "DNS" + record version */
+#define APP_DNS_CACHE_MAX_ADDR          4
+/* Same as TCPIP_DNS_CLIENT_MAX_HOSTNAME_LEN */
+#define APP_DNS_CACHE_HOSTNAME_LEN      100
+/* Start the background refresh this many seconds before the TTL runs out */
+#define APP_DNS_CACHE_REFRESH_MARGIN_s  30
+/* Lower bound between two background refreshes, whatever the TTL says */
+#define APP_DNS_CACHE_MIN_REFRESH_s     300
+
+// *****************************************************************************
+
+/* Kept in the DNS slot of the configuration store. Addresses are IPv4 in
+ * network byte order, as IPV4_ADDR.Val */
+typedef struct
+{
+    uint32_t magic;
+    char hostName[APP_DNS_CACHE_HOSTNAME_LEN + 1];
+    uint8_t nAddr;
+    uint32_t addr[APP_DNS_CACHE_MAX_ADDR];
+    /* UTC seconds at which the TTL of the entry runs out; 0 if unknown */
+    uint32_t expiry;
+} APP_DNS_CACHE_RECORD;
+
+typedef struct
+{
+    APP_DNS_CACHE_RECORD record;
+    bool valid;
+    /* The record differs from the copy in the configuration store */
+    bool dirty;
+    /* Index of the address handed out by the next lookup */
+    uint8_t addrIdx;
+    /* UTC seconds of the next background refresh; 0 for as soon as possible */
+    uint32_t nextRefresh;
+} APP_DNS_CACHE_ENTRY;
+
+typedef enum
+{
+    /* Nothing cached for the name: resolve it */
+    APP_DNS_CACHE_LOOKUP_MISS=0,
+    /* Within its TTL, or the time is not known yet */
+    APP_DNS_CACHE_LOOKUP_FRESH,
+    /* The TTL ran out. Still the best guess: dial it and let the connect
+     * timeout catch a dead address while the refresh runs */
+    APP_DNS_CACHE_LOOKUP_STALE
+} APP_DNS_CACHE_LOOKUP;
+
+// *****************************************************************************
+
+bool APP_DNS_CachePolicyLoad( APP_DNS_CACHE_ENTRY* entry, const APP_DNS_CACHE_RECORD* rec );
+APP_DNS_CACHE_LOOKUP APP_DNS_CachePolicyGet( APP_DNS_CACHE_ENTRY* entry, const char* hostName,
+                                             uint32_t now, bool timeTrusted, uint32_t* addr );
+void APP_DNS_CachePolicyAnswer( APP_DNS_CACHE_ENTRY* entry, const char* hostName,
+                                const uint32_t* addr, uint8_t nAddr, uint32_t ttl, uint32_t now );
+void APP_DNS_CachePolicyInvalidate( APP_DNS_CACHE_ENTRY* entry, const char* hostName, uint32_t addr );
+bool APP_DNS_CachePolicyRefreshDue( const APP_DNS_CACHE_ENTRY* entry, uint32_t now );
+void APP_DNS_CachePolicyRefreshFailed( APP_DNS_CACHE_ENTRY* entry, uint32_t now );
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _APP_DNS_CACHE_POLICY_H */
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,548 @@
+/*******************************************************************************
+  MPLAB Harmony Application Source File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_log.c
+
+  Summary:
+    This file contains the source code for the deferred console logging.
+
+  Description:
+    Writers reserve a slot by moving the ring head with a compare-and-swap,
+    fill it and mark it ready; nothing is locked, so a log call may come from
+    any task or an interrupt. The format string is walked once to copy the
+    arguments with their own size; strings are copied as well since the
+    buffers they point to may be gone by the time the message is printed. The
+    drain task formats the slots in order with the same format string and
+    hands the result to the console, only as fast as the UART queue takes it.
+ *******************************************************************************/
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include "app_log.h"
+#include "definitions.h"
+#include "system/console/sys_console.h"
+
+// *****************************************************************************
+
+/* Core timer, counting at half the CPU clock */
+#define APP_LOG_CYCLES()            _CP0_GET_COUNT()
+/* Longest conversion specification, '%' included */
+#define APP_LOG_SPEC_MAX            16
+
+typedef enum
+{
+    ARG_NONE=0,
+    ARG_INT,
+    ARG_LONG,
+    ARG_LLONG,
+    ARG_SIZE,
+    ARG_PTR,
+    ARG_DOUBLE,
+    ARG_LDOUBLE,
+    ARG_STR
+} ARG_TYPE;
+
+typedef struct
+{
+    ARG_TYPE type;
+    char conv;
+    bool widthStar;
+    bool precStar;
+    /* Literal precision, -1 if none */
+    int precision;
+} SPEC;
+
+static const char* const moduleNames[APP_LOG_MODULE_MAX] = {
+    "app", "aws", "boot", "cfg", "ctrl", "defender", "dhcp", "dns", "oled", "ota",
+    "ps", "roam", "shadow", "time", "trace", "usbmsd", "prov"
+};
+
+static TaskHandle_t xAPP_LOG_Tasks;
+
+// *****************************************************************************
+// Format walking, shared by the writers and the drain task
+
+/* 'p' points after the '%'. Returns the end of the specification, NULL if it
+ * is not understood */
+static const char* parseSpec(const char* p, SPEC* spec)
+{
+    bool isLong = false, isLongLong = false, isSize = false, isLongDouble = false;
+
+    spec->widthStar = spec->precStar = false;
+    spec->precision = -1;
+    while (*p && strchr("-+ #0", *p))
+        p++;
+    if ('*' == *p) {
+        spec->widthStar = true;
+        p++;
+    } else {
+        while (*p >= '0' && *p <= '9')
+            p++;
+    }
+    if ('.' == *p) {
+        p++;
+        if ('*' == *p) {
+            spec->precStar = true;
+            p++;
+        } else {
+            spec->precision = 0;
+            while (*p >= '0' && *p <= '9')
+                spec->precision = spec->precision * 10 + (*p++ - '0');
+        }
+    }
+    if ('h' == *p) {
+        p += ('h' == p[1]) ? 2 : 1;
+    } else if ('l' == *p) {
+        isLongLong = ('l' == p[1]);
+        isLong = !isLongLong;
+        p += isLongLong ? 2 : 1;
+    } else if ('j' == *p) {
+        isLongLong = true;
+        p++;
+    } else if ('z' == *p || 't' == *p) {
+        isSize = true;
+        p++;
+    } else if ('L' == *p) {
+        isLongDouble = true;
+        p++;
+    }
+
+    spec->conv = *p;
+    switch (*p) {
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o':
+            spec->type = isLongLong ? ARG_LLONG : isLong ? ARG_LONG : isSize ? ARG_SIZE : ARG_INT;
+            break;
+        case 'c':
+            spec->type = ARG_INT;
+            break;
+        case 's':
+            spec->type = ARG_STR;
+            break;
+        case 'p':
+        case 'n':
+            spec->type = ARG_PTR;
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            spec->type = isLongDouble ? ARG_LDOUBLE : ARG_DOUBLE;
+            break;
+        case '%':
+            spec->type = ARG_NONE;
+            break;
+        default:
+            return NULL;
+    }
+    return p + 1;
+}
+
+// *****************************************************************************
+// Writer side
+
+static bool argPut(APP_LOG_RECORD* pRec, const void* value, size_t size)
+{
+    if (pRec->argLen + size > APP_LOG_ARGS_SIZE)
+        return false;
+    memcpy(&pRec->args[pRec->argLen], value, size);
+    pRec->argLen += size;
+    return true;
+}
+
+/* Copy the arguments the format string asks for. Stops at the first one that
+ * does not fit; the drain task prints what is there */
+static void recordArgs(APP_LOG_RECORD* pRec, const char* fmt, va_list args)
+{
+    const char* p = fmt;
+    SPEC spec;
+    int star, precision;
+
+    while (NULL != (p = strchr(p, '%'))) {
+        p = parseSpec(p + 1, &spec);
+        if (NULL == p)
+            return;
+        precision = spec.precision;
+        if (spec.widthStar) {
+            star = va_arg(args, int);
+            if (!argPut(pRec, &star, sizeof(star)))
+                goto full;
+        }
+        if (spec.precStar) {
+            star = va_arg(args, int);
+            precision = star;
+            if (!argPut(pRec, &star, sizeof(star)))
+                goto full;
+        }
+        switch (spec.type) {
+            case ARG_INT: {
+                int v = va_arg(args, int);
+                if (!argPut(pRec, &v, sizeof(v)))
+                    goto full;
+                break;
+            }
+            case ARG_LONG: {
+                long v = va_arg(args, long);
+                if (!argPut(pRec, &v, sizeof(v)))
+                    goto full;
+                break;
+            }
+            case ARG_LLONG: {
+                long long v = va_arg(args, long long);
+                if (!argPut(pRec, &v, sizeof(v)))
+                    goto full;
+                break;
+            }
+            case ARG_SIZE: {
+                size_t v = va_arg(args, size_t);
+                if (!argPut(pRec, &v, sizeof(v)))
+                    goto full;
+                break;
+            }
+            case ARG_PTR: {
+                void* v = va_arg(args, void*);
+                if (!argPut(pRec, &v, sizeof(v)))
+                    goto full;
+                break;
+            }
+            case ARG_DOUBLE: {
+                double v = va_arg(args, double);
+                if (!argPut(pRec, &v, sizeof(v)))
+                    goto full;
+                break;
+            }
+            case ARG_LDOUBLE: {
+                long double v = va_arg(args, long double);
+                if (!argPut(pRec, &v, sizeof(v)))
+                    goto full;
+                break;
+            }
+            case ARG_STR: {
+                const char* s = va_arg(args, const char*);
+                const char* end;
+                size_t len, room;
+                uint8_t len8;
+
+                if (NULL == s)
+                    s = "(null)";
+                /* With a precision the string need not be terminated */
+                if (precision >= 0) {
+                    end = memchr(s, '\0', precision);
+                    len = end ? (size_t)(end - s) : (size_t) precision;
+                } else
+                    len = strlen(s);
+                if (pRec->argLen + 1 >= APP_LOG_ARGS_SIZE)
+                    goto full;
+                room = APP_LOG_ARGS_SIZE - pRec->argLen - 1;
+                if (room > 255)
+                    room = 255;
+                if (len > room) {
+                    len = room;
+                    pRec->truncated = true;
+                }
+                len8 = (uint8_t) len;
+                argPut(pRec, &len8, 1);
+                argPut(pRec, s, len);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    return;
+
+full:
+    pRec->truncated = true;
+}
+
+bool APP_LOG_Enabled(APP_LOG_MODULE module, uint8_t level)
+{
+    uint8_t moduleLevel = appLogData.level[module];
+
+    if (APP_LOG_LEVEL_PRINT == level)
+        return (APP_LOG_LEVEL_GLOBAL == moduleLevel || moduleLevel >= SYS_ERROR_INFO);
+    if (APP_LOG_LEVEL_GLOBAL == moduleLevel)
+        return (uint32_t) level <= (uint32_t) SYS_DEBUG_ErrorLevelGet();
+    return level <= moduleLevel;
+}
+
+void APP_LOG_Write(APP_LOG_MODULE module, const char* fmt, ...)
+{
+    uint32_t start = APP_LOG_CYCLES();
+    APP_LOG_RECORD* pRec;
+    uint32_t head, used, cycles;
+    va_list args;
+
+    head = __atomic_load_n(&appLogData.head, __ATOMIC_RELAXED);
+    do {
+        used = head - __atomic_load_n(&appLogData.tail, __ATOMIC_ACQUIRE);
+        if (used >= APP_LOG_RING_SLOTS) {
+            __atomic_fetch_add(&appLogData.nDropped, 1, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&appLogData.nDroppedModule[module], 1, __ATOMIC_RELAXED);
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&appLogData.head, &head, head + 1, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+    if (used + 1 > appLogData.maxUsed)
+        appLogData.maxUsed = used + 1;
+
+    /* The slot is this writer's until it is marked ready */
+    pRec = &appLogData.ring[head % APP_LOG_RING_SLOTS];
+    pRec->module = module;
+    pRec->fmt = fmt;
+    pRec->argLen = 0;
+    pRec->truncated = false;
+    va_start(args, fmt);
+    recordArgs(pRec, fmt, args);
+    va_end(args);
+    if (pRec->truncated)
+        __atomic_fetch_add(&appLogData.nTruncated, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&pRec->ready, 1, __ATOMIC_RELEASE);
+
+    cycles = APP_LOG_CYCLES() - start;
+    __atomic_fetch_add(&appLogData.nWritten, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&appLogData.callCycles, cycles, __ATOMIC_RELAXED);
+    if (cycles > appLogData.callCyclesMax)
+        appLogData.callCyclesMax = cycles;
+}
+
+// *****************************************************************************
+// Drain side
+
+static bool argGet(const APP_LOG_RECORD* pRec, uint16_t* pPos, void* value, size_t size)
+{
+    if (*pPos + size > pRec->argLen)
+        return false;
+    memcpy(value, &pRec->args[*pPos], size);
+    *pPos += size;
+    return true;
+}
+
+#define EMIT(v) ((nStars == 0) ? snprintf(dst, room, specStr, v) \
+        : (nStars == 1) ? snprintf(dst, room, specStr, star[0], v) \
+        : snprintf(dst, room, specStr, star[0], star[1], v))
+
+/* Format a slot into 'line'. Returns its length */
+static uint16_t recordFormat(const APP_LOG_RECORD* pRec, char* line, size_t lineSize)
+{
+    const char* p = pRec->fmt;
+    const char* next;
+    char specStr[APP_LOG_SPEC_MAX + 1];
+    char str[256];
+    size_t n = 0, specLen, room;
+    uint16_t pos = 0;
+    int star[2], nStars, len;
+    SPEC spec;
+    char* dst;
+
+    while (*p && n + 1 < lineSize) {
+        if ('%' != *p) {
+            line[n++] = *p++;
+            continue;
+        }
+        next = parseSpec(p + 1, &spec);
+        specLen = next ? (size_t)(next - p) : 0;
+        if (NULL == next || specLen > APP_LOG_SPEC_MAX) {
+            line[n++] = *p++;
+            continue;
+        }
+        memcpy(specStr, p, specLen);
+        specStr[specLen] = '\0';
+        p = next;
+        if (ARG_NONE == spec.type) {
+            line[n++] = '%';
+            continue;
+        }
+
+        nStars = 0;
+        if (spec.widthStar && !argGet(pRec, &pos, &star[nStars++], sizeof(int)))
+            break;
+        if (spec.precStar && !argGet(pRec, &pos, &star[nStars++], sizeof(int)))
+            break;
+        dst = &line[n];
+        room = lineSize - n;
+        switch (spec.type) {
+            case ARG_INT: {
+                int v;
+                if (!argGet(pRec, &pos, &v, sizeof(v)))
+                    goto out;
+                len = EMIT(v);
+                break;
+            }
+            case ARG_LONG: {
+                long v;
+                if (!argGet(pRec, &pos, &v, sizeof(v)))
+                    goto out;
+                len = EMIT(v);
+                break;
+            }
+            case ARG_LLONG: {
+                long long v;
+                if (!argGet(pRec, &pos, &v, sizeof(v)))
+                    goto out;
+                len = EMIT(v);
+                break;
+            }
+            case ARG_SIZE: {
+                size_t v;
+                if (!argGet(pRec, &pos, &v, sizeof(v)))
+                    goto out;
+                len = EMIT(v);
+                break;
+            }
+            case ARG_PTR: {
+                void* v;
+                if (!argGet(pRec, &pos, &v, sizeof(v)))
+                    goto out;
+                /* %n is never honoured here */
+                len = ('n' == spec.conv) ? 0 : EMIT(v);
+                break;
+            }
+            case ARG_DOUBLE: {
+                double v;
+                if (!argGet(pRec, &pos, &v, sizeof(v)))
+                    goto out;
+                len = EMIT(v);
+                break;
+            }
+            case ARG_LDOUBLE: {
+                long double v;
+                if (!argGet(pRec, &pos, &v, sizeof(v)))
+                    goto out;
+                len = EMIT(v);
+                break;
+            }
+            case ARG_STR: {
+                uint8_t strLen;
+                if (!argGet(pRec, &pos, &strLen, 1) || !argGet(pRec, &pos, str, strLen))
+                    goto out;
+                str[strLen] = '\0';
+                len = EMIT(str);
+                break;
+            }
+            default:
+                len = 0;
+                break;
+        }
+        if (len < 0)
+            len = 0;
+        n += ((size_t) len < room) ? (size_t) len : room - 1;
+    }
+
+out:
+    /* Cut short: an argument did not fit in the slot, or the line is full */
+    if (pRec->truncated || *p) {
+        if (n >= 2 && '\r' == line[n - 2] && '\n' == line[n - 1])
+            n -= 2;
+        if (n + 4 > lineSize)
+            n = lineSize - 4;
+        memcpy(&line[n], "~\r\n", 3);
+        n += 3;
+    }
+    line[n] = '\0';
+    return (uint16_t) n;
+}
+
+#undef EMIT
+
+// *****************************************************************************
+
+void APP_LOG_LevelSet(APP_LOG_MODULE module, uint8_t level)
+{
+    if (module < APP_LOG_MODULE_MAX)
+        appLogData.level[module] = level;
+}
+
+const char* APP_LOG_ModuleName(APP_LOG_MODULE module)
+{
+    return (module < APP_LOG_MODULE_MAX) ? moduleNames[module] : "?";
+}
+
+uint32_t APP_LOG_Pending(void)
+{
+    return __atomic_load_n(&appLogData.head, __ATOMIC_ACQUIRE) - appLogData.tail;
+}
+
+void APP_LOG_StatsReset(void)
+{
+    appLogData.nWritten = 0;
+    appLogData.nDropped = 0;
+    appLogData.nTruncated = 0;
+    memset(appLogData.nDroppedModule, 0, sizeof(appLogData.nDroppedModule));
+    appLogData.callCycles = 0;
+    appLogData.callCyclesMax = 0;
+    appLogData.maxUsed = 0;
+}
+
+/* Give the drain task time to empty the ring, e.g. before a reset */
+void APP_LOG_Flush(void)
+{
+    int i;
+
+    for (i = 0; i < 50 && (APP_LOG_Pending() || appLogData.lineLen); i++)
+        vTaskDelay(APP_LOG_TASK_PERIOD_MS / portTICK_PERIOD_MS);
+}
+
+static void lAPP_LOG_Tasks(void *pvParameters)
+{
+    while (true)
+    {
+        APP_LOG_Tasks();
+        vTaskDelay(APP_LOG_TASK_PERIOD_MS / portTICK_PERIOD_MS);
+    }
+}
+
+void APP_LOG_Initialize(void)
+{
+    memset(appLogData.level, APP_LOG_LEVEL_GLOBAL, sizeof(appLogData.level));
+    /* Below all the application tasks: printing waits until they are idle */
+    (void) xTaskCreate((TaskFunction_t) lAPP_LOG_Tasks,
+                "APP_LOG_Tasks",
+                APP_LOG_TASK_STACK_SIZE,
+                NULL,
+                tskIDLE_PRIORITY,
+                &xAPP_LOG_Tasks);
+}
+
+/* Drain the ring as far as the UART queue has room */
+void APP_LOG_Tasks(void)
+{
+    static uint16_t lineOffset;
+    SYS_CONSOLE_HANDLE handle = SYS_CONSOLE_HandleGet(SYS_CONSOLE_INDEX_0);
+    APP_LOG_RECORD* pRec;
+    ssize_t space;
+    uint32_t tail;
+
+    while (true)
+    {
+        if (appLogData.lineLen)
+        {
+            space = SYS_CONSOLE_WriteFreeBufferCountGet(handle);
+            if (space <= 0)
+                return;
+            if (space > appLogData.lineLen - lineOffset)
+                space = appLogData.lineLen - lineOffset;
+            space = SYS_CONSOLE_Write(handle, &appLogData.line[lineOffset], space);
+            if (space <= 0)
+                return;
+            lineOffset += space;
+            if (lineOffset < appLogData.lineLen)
+                return;
+            appLogData.lineLen = lineOffset = 0;
+        }
+
+        tail = appLogData.tail;
+        if (tail == __atomic_load_n(&appLogData.head, __ATOMIC_ACQUIRE))
+            return;
+        /* A writer holding the oldest slot keeps the later ones waiting */
+        pRec = &appLogData.ring[tail % APP_LOG_RING_SLOTS];
+        if (!__atomic_load_n(&pRec->ready, __ATOMIC_ACQUIRE))
+            return;
+        appLogData.lineLen = recordFormat(pRec, appLogData.line, sizeof(appLogData.line));
+        __atomic_store_n(&pRec->ready, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&appLogData.tail, tail + 1, __ATOMIC_RELEASE);
+    }
+}
+
+/*******************************************************************************
+ End of File
+ */
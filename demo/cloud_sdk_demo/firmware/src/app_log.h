@@ -0,0 +1,149 @@
+/*******************************************************************************
+  MPLAB Harmony Application Header File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_log.h
+
+  Summary:
+    This header file provides prototypes and definitions for the application.
+
+  Description:
+    This header file provides function prototypes and data type definitions for
+    the deferred console logging. A log call only copies its format pointer and
+    its arguments into a slot of a lock-free ring; formatting and writing to
+    the UART are done by a task at idle priority. Each module has its own log
+    level, changed at run time with the "log" command.
+*******************************************************************************/
+
+#ifndef _APP_LOG_H
+#define _APP_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include "configuration.h"
+#include "system/debug/sys_debug.h"
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+// *****************************************************************************
+
+/* Comment out to print from the caller's context again, e.g. to see the last
+ * messages before a crash */
+#define APP_LOG_DEFERRED
+
+/* Slots of the ring. A message takes one slot whatever its length */
+#define APP_LOG_RING_SLOTS          40
+/* Argument bytes of a slot. Strings are copied in and cut to what is left */
+#define APP_LOG_ARGS_SIZE           120
+/* Longest formatted message */
+#define APP_LOG_LINE_MAX            SYS_CONSOLE_PRINT_BUFFER_SIZE
+#define APP_LOG_TASK_STACK_SIZE     1024
+#define APP_LOG_TASK_PERIOD_MS      10
+
+/* Module level following the global level of the "debug" command */
+#define APP_LOG_LEVEL_GLOBAL        0xFF
+/* Level of the _PRNT wrappers. They are shown unless the module level was
+ * set below SYS_ERROR_INFO */
+#define APP_LOG_LEVEL_PRINT         0xFE
+
+// *****************************************************************************
+
+typedef enum
+{
+    APP_LOG_MODULE_APP=0,
+    APP_LOG_MODULE_AWS,
+    APP_LOG_MODULE_BOOT,
+    APP_LOG_MODULE_CFG,
+    APP_LOG_MODULE_CTRL,
+    APP_LOG_MODULE_DEFENDER,
+    APP_LOG_MODULE_DHCP,
+    APP_LOG_MODULE_DNS,
+    APP_LOG_MODULE_OLED,
+    APP_LOG_MODULE_OTA,
+    APP_LOG_MODULE_PS,
+    APP_LOG_MODULE_ROAM,
+    APP_LOG_MODULE_SHADOW,
+    APP_LOG_MODULE_TIME,
+    APP_LOG_MODULE_TRACE,
+    APP_LOG_MODULE_USB_MSD,
+    APP_LOG_MODULE_WIFI_PROV,
+    APP_LOG_MODULE_MAX
+} APP_LOG_MODULE;
+
+typedef struct
+{
+    /* Set once the slot is filled, cleared by the drain task */
+    volatile uint8_t ready;
+    uint8_t module;
+    /* Argument bytes used */
+    uint8_t argLen;
+    /* A string argument had to be cut */
+    uint8_t truncated;
+    const char* fmt;
+    uint8_t args[APP_LOG_ARGS_SIZE];
+} APP_LOG_RECORD;
+
+typedef struct
+{
+    APP_LOG_RECORD ring[APP_LOG_RING_SLOTS];
+    /* Slots reserved by the writers, and drained; free running */
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    uint8_t level[APP_LOG_MODULE_MAX];
+    /* Message being written to the UART */
+    char line[APP_LOG_LINE_MAX];
+    uint16_t lineLen;
+    /* Statistics since boot or the last "log reset" */
+    uint32_t nWritten;
+    uint32_t nDropped;
+    uint32_t nTruncated;
+    uint32_t nDroppedModule[APP_LOG_MODULE_MAX];
+    uint32_t callCycles;
+    uint32_t callCyclesMax;
+    uint32_t maxUsed;
+} APP_LOG_DATA;
+APP_LOG_DATA appLogData;
+
+// *****************************************************************************
+
+#ifdef APP_LOG_DEFERRED
+#define APP_LOG_DBG(module,level,fmt,...) do { if (APP_LOG_Enabled(module, level)) { APP_LOG_Write(module, fmt, ##__VA_ARGS__); } } while (false)
+#else
+#define APP_LOG_DBG(module,level,fmt,...) do { if (APP_LOG_Enabled(module, level)) { SYS_CONSOLE_PRINT(fmt, ##__VA_ARGS__); } } while (false)
+#endif
+#define APP_LOG_PRNT(module,fmt,...) APP_LOG_DBG(module, APP_LOG_LEVEL_PRINT, fmt, ##__VA_ARGS__)
+
+// *****************************************************************************
+
+bool APP_LOG_Enabled( APP_LOG_MODULE module, uint8_t level );
+void APP_LOG_Write( APP_LOG_MODULE module, const char* fmt, ... );
+void APP_LOG_LevelSet( APP_LOG_MODULE module, uint8_t level );
+const char* APP_LOG_ModuleName( APP_LOG_MODULE module );
+uint32_t APP_LOG_Pending( void );
+void APP_LOG_StatsReset( void );
+void APP_LOG_Flush( void );
+void APP_LOG_Initialize( void );
+void APP_LOG_Tasks( void );
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _APP_LOG_H */
+
+/*******************************************************************************
+ End of File
+ */
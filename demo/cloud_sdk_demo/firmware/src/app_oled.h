@@ -26,6 +26,7 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include "configuration.h"
+#include "app_log.h"
 
 // DOM-IGNORE-BEGIN
 #ifdef __cplusplus  // Provide C++ Compatibility
@@ -36,8 +37,8 @@ extern "C" {
 // DOM-IGNORE-END
     
 /* Debug wrappers */
-#define APP_OLED_DBG(level,fmt,...) SYS_DEBUG_PRINT(level,"[APP_OLED] "fmt,##__VA_ARGS__)
-#define APP_OLED_PRNT(fmt,...) SYS_CONSOLE_PRINT("[APP_OLED] "fmt, ##__VA_ARGS__)
+#define APP_OLED_DBG(level,fmt,...) APP_LOG_DBG(APP_LOG_MODULE_OLED,level,"[APP_OLED] "fmt,##__VA_ARGS__)
+#define APP_OLED_PRNT(fmt,...) APP_LOG_PRNT(APP_LOG_MODULE_OLED,"[APP_OLED] "fmt, ##__VA_ARGS__)
 
 // *****************************************************************************
 
@@ -0,0 +1,588 @@
+/*******************************************************************************
+  MPLAB Harmony Application Source File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_ota.c
+
+  Summary:
+    This file contains the source code for the firmware update agent.
+
+  Description:
+    Binds the update agent of app_ota_agent.c to the platform. The agent asks
+    the Jobs service for the next job after each connect and whenever
+    notify-next says the queue changed. The image is requested from the MQTT
+    stream in CBOR, and each block goes from the MQTT receive buffer straight
+    into a sector buffer of the writer. The slot is written and read back
+    through the memory driver, hashed by the hash engine and the signature
+    checked with the secure element. Swapping the image in is left to the
+    bootloader; the job succeeds with the image staged.
+ *******************************************************************************/
+
+// *****************************************************************************
+
+#ifdef AWS_CLOUD_DEMO
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "definitions.h"
+#include "iot_config.h"
+#include "app_common.h"
+#include "app_aws.h"
+#include "app_ota.h"
+#include "app_config_store.h"
+#include "app_ps.h"
+#include "aws_iot_jobs.h"
+#include "iot_serializer.h"
+#include "cryptoauthlib.h"
+#include "wolfssl/wolfcrypt/settings.h"
+#include "wolfssl/wolfcrypt/sha256.h"
+
+// *****************************************************************************
+
+#define APP_OTA_TOPIC_MAX_LEN           256
+#define APP_OTA_REQUEST_MAX_LEN         48
+
+/* Code signing key: X || Y of the P-256 public key the images are signed with.
+ * Jobs are refused until it is filled in */
+static const uint8_t signerKey[64] = { 0 };
+
+/* Sector buffers of the writer, and of the read-back once it is done */
+static uint8_t CACHE_ALIGN sectorBuffers[APP_OTA_WRITER_NUM_BUFFERS * APP_OTA_WRITER_SECTOR_SIZE];
+/* Blocks come in on the MQTT receive task, the flash is driven from ours */
+static OSAL_MUTEX_HANDLE_TYPE writerMutex;
+
+/* Memory driver client of our own, see APP_CONFIG_STORE_ImageSlotGet */
+static DRV_HANDLE memHandle = DRV_HANDLE_INVALID;
+static DRV_MEMORY_COMMAND_HANDLE cmdHandle;
+static volatile DRV_MEMORY_COMMAND_STATUS xferStatus = DRV_MEMORY_COMMAND_COMPLETED;
+static uint32_t readBlockSize;
+static uint32_t writeBlockSize;
+
+/* Read-back digest; the hash engine is held from start to finish */
+static wc_Sha256 sha;
+
+static bool flashSectorWrite(void* context, uint32_t offset, const uint8_t* pSector);
+static int8_t flashStatus(void* context);
+static int8_t slotGet(uint32_t* pSlotSize);
+static bool flashRead(uint32_t offset, uint8_t* pBuffer, uint32_t length);
+static bool progressRead(APP_OTA_PROGRESS* pProgress);
+static bool progressWrite(const APP_OTA_PROGRESS* pProgress);
+static bool jobStartNext(void);
+static bool jobUpdate(const char* pJobId, APP_OTA_JOB_STATUS status, const char* pDetails);
+static bool streamSubscribe(const APP_OTA_JOB* pJob, bool subscribe);
+static bool blocksRequest(const APP_OTA_JOB* pJob, uint32_t firstBlock, uint32_t nBlocks);
+static bool hashStart(uint32_t size);
+static bool hashUpdate(const uint8_t* pData, uint32_t length);
+static bool hashFinish(uint8_t* pDigest);
+static bool signatureVerify(const uint8_t* pDigest, const uint8_t* pSignature, const uint8_t* pKey, bool* pVerified);
+static uint32_t msNow(void);
+static void writerLock(void);
+static void writerUnlock(void);
+static void agentEvent(APP_OTA_EVENT event);
+
+static const APP_OTA_PORT otaPort = {
+    .flash = {
+        .sectorWrite = flashSectorWrite,
+        .status = flashStatus,
+        .context = NULL
+    },
+    .slotGet = slotGet,
+    .slotRead = flashRead,
+    .progressRead = progressRead,
+    .progressWrite = progressWrite,
+    .jobStartNext = jobStartNext,
+    .jobUpdate = jobUpdate,
+    .streamSubscribe = streamSubscribe,
+    .blocksRequest = blocksRequest,
+    .hashStart = hashStart,
+    .hashUpdate = hashUpdate,
+    .hashFinish = hashFinish,
+    .signatureVerify = signatureVerify,
+    .msNow = msNow,
+    .writerLock = writerLock,
+    .writerUnlock = writerUnlock,
+    .event = agentEvent
+};
+
+// *****************************************************************************
+
+static uint32_t msNow(void)
+{
+    return APP_CounterToMs(SYS_TIME_Counter64Get());
+}
+
+static void writerLock(void)
+{
+    OSAL_MUTEX_Lock(&writerMutex, OSAL_WAIT_FOREVER);
+}
+
+static void writerUnlock(void)
+{
+    OSAL_MUTEX_Unlock(&writerMutex);
+}
+
+/* $aws/things/<thing>/streams/<stream>/<suffix> */
+static int topicBuild(char* pTopic, const APP_OTA_JOB* pJob, const char* pSuffix)
+{
+    int len = snprintf(pTopic, APP_OTA_TOPIC_MAX_LEN, "$aws/things/%s/streams/%s/%s",
+                       g_Aws_ClientID, pJob->streamId, pSuffix);
+
+    return (len > 0 && len < APP_OTA_TOPIC_MAX_LEN) ? len : 0;
+}
+
+static void agentEvent(APP_OTA_EVENT event)
+{
+    const APP_OTA_AGENT* pAgent = &appOtaData.agent;
+
+    switch (event) {
+        case APP_OTA_EVENT_NO_JOB:
+            APP_OTA_DBG(SYS_ERROR_DEBUG, "No pending job \r\n");
+            break;
+        case APP_OTA_EVENT_BAD_JOB:
+            APP_OTA_DBG(SYS_ERROR_ERROR, "Job without a usable ID \r\n");
+            break;
+        case APP_OTA_EVENT_JOB:
+            APP_OTA_PRNT("Job %s: %lu bytes from stream %s \r\n", pAgent->job.jobId,
+                         (unsigned long) pAgent->job.size, pAgent->job.streamId);
+            break;
+        case APP_OTA_EVENT_RESUME:
+            APP_OTA_PRNT("Resuming at %lu \r\n", (unsigned long) pAgent->progress.committed);
+            break;
+        case APP_OTA_EVENT_DOWNLOADED:
+            APP_OTA_PRNT("Downloaded %lu bytes in %lu ms, %lu requests, %lu blocks dropped \r\n",
+                         (unsigned long) pAgent->job.size, (unsigned long) (msNow() - pAgent->startTime),
+                         (unsigned long) pAgent->nRequests, (unsigned long) pAgent->nDropped);
+            break;
+        case APP_OTA_EVENT_VERIFIED:
+            APP_OTA_PRNT("Image verified and staged \r\n");
+            break;
+        case APP_OTA_EVENT_STAGED:
+            APP_OTA_PRNT("Image already staged \r\n");
+            break;
+        case APP_OTA_EVENT_FAILED:
+            APP_OTA_DBG(SYS_ERROR_ERROR, "Job %s failed: %s \r\n", pAgent->job.jobId, pAgent->pReason);
+            break;
+        case APP_OTA_EVENT_ENDED:
+            APP_OTA_PRNT("Job %s ended by the service \r\n", pAgent->job.jobId);
+            break;
+        default:
+            break;
+    }
+}
+
+// *****************************************************************************
+
+static void transferHandler(SYS_MEDIA_BLOCK_EVENT event, SYS_MEDIA_BLOCK_COMMAND_HANDLE commandHandle, uintptr_t context)
+{
+    if (commandHandle != cmdHandle)
+        return;
+    xferStatus = (SYS_MEDIA_EVENT_BLOCK_COMMAND_COMPLETE == event) ?
+            DRV_MEMORY_COMMAND_COMPLETED : DRV_MEMORY_COMMAND_ERROR_UNKNOWN;
+}
+
+static bool flashOpen(void)
+{
+    SYS_MEDIA_GEOMETRY *pGeometry;
+
+    if (DRV_HANDLE_INVALID != memHandle)
+        return true;
+    memHandle = DRV_MEMORY_Open(DRV_MEMORY_INDEX_0, DRV_IO_INTENT_READWRITE);
+    if (DRV_HANDLE_INVALID == memHandle)
+        return false;
+    pGeometry = DRV_MEMORY_GeometryGet(memHandle);
+    if (NULL == pGeometry) {
+        DRV_MEMORY_Close(memHandle);
+        memHandle = DRV_HANDLE_INVALID;
+        return false;
+    }
+    readBlockSize = pGeometry->geometryTable[SYS_MEDIA_GEOMETRY_TABLE_READ_ENTRY].blockSize;
+    writeBlockSize = pGeometry->geometryTable[SYS_MEDIA_GEOMETRY_TABLE_WRITE_ENTRY].blockSize;
+    DRV_MEMORY_TransferHandlerSet(memHandle, transferHandler, (uintptr_t) NULL);
+    return true;
+}
+
+static int8_t slotGet(uint32_t* pSlotSize)
+{
+    if (!flashOpen())
+        return 1;
+    return APP_CONFIG_STORE_ImageSlotGet(&appOtaData.slotOffset, pSlotSize) ? 0 : -1;
+}
+
+/* The driver queue may be taken by the FS or the USB host; the writer retries */
+static bool flashSectorWrite(void* context, uint32_t offset, const uint8_t* pSector)
+{
+    xferStatus = DRV_MEMORY_COMMAND_QUEUED;
+    DRV_MEMORY_AsyncEraseWrite(memHandle, &cmdHandle, (void*) pSector,
+                               (appOtaData.slotOffset + offset) / writeBlockSize,
+                               APP_OTA_WRITER_SECTOR_SIZE / writeBlockSize);
+    if (DRV_MEMORY_COMMAND_HANDLE_INVALID == cmdHandle) {
+        xferStatus = DRV_MEMORY_COMMAND_COMPLETED;
+        return false;
+    }
+    return true;
+}
+
+static int8_t flashStatus(void* context)
+{
+    switch (xferStatus) {
+        case DRV_MEMORY_COMMAND_QUEUED:
+        case DRV_MEMORY_COMMAND_IN_PROGRESS:
+            return 1;
+        case DRV_MEMORY_COMMAND_COMPLETED:
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+/* Blocking read from the slot, for the read-back only */
+static bool flashRead(uint32_t offset, uint8_t* pBuffer, uint32_t length)
+{
+    uint32_t timeStamp = msNow();
+
+    do {
+        xferStatus = DRV_MEMORY_COMMAND_QUEUED;
+        DRV_MEMORY_AsyncRead(memHandle, &cmdHandle, pBuffer, (appOtaData.slotOffset + offset) / readBlockSize,
+                             length / readBlockSize);
+        if (DRV_MEMORY_COMMAND_HANDLE_INVALID != cmdHandle)
+            break;
+        xferStatus = DRV_MEMORY_COMMAND_COMPLETED;
+        if (msNow() - timeStamp >= MQTT_TIMEOUT_MS)
+            return false;
+        vTaskDelay(1 / portTICK_PERIOD_MS);
+    } while (true);
+    while (1 == flashStatus(NULL))
+        vTaskDelay(1 / portTICK_PERIOD_MS);
+    return (0 == flashStatus(NULL));
+}
+
+static bool progressRead(APP_OTA_PROGRESS* pProgress)
+{
+    return 0 == APP_CONFIG_STORE_SlotRead(APP_CONFIG_STORE_SLOT_OTA, pProgress, sizeof(APP_OTA_PROGRESS));
+}
+
+static bool progressWrite(const APP_OTA_PROGRESS* pProgress)
+{
+    return 0 == APP_CONFIG_STORE_SlotWrite(APP_CONFIG_STORE_SLOT_OTA, pProgress, sizeof(APP_OTA_PROGRESS));
+}
+
+static bool hashStart(uint32_t size)
+{
+    if (0 != wc_InitSha256(&sha))
+        return false;
+    wc_Sha256SizeSet(&sha, size);
+    return true;
+}
+
+static bool hashUpdate(const uint8_t* pData, uint32_t length)
+{
+    return 0 == wc_Sha256Update(&sha, pData, length);
+}
+
+static bool hashFinish(uint8_t* pDigest)
+{
+    int ret = wc_Sha256Final(&sha, pDigest);
+
+    wc_Sha256Free(&sha);
+    return 0 == ret;
+}
+
+static bool signatureVerify(const uint8_t* pDigest, const uint8_t* pSignature, const uint8_t* pKey, bool* pVerified)
+{
+    ATCA_STATUS status = atcab_verify_extern(pDigest, pSignature, pKey, pVerified);
+
+    if (ATCA_SUCCESS != status || !*pVerified)
+        APP_OTA_DBG(SYS_ERROR_ERROR, "Signature check: status %d, verified %d \r\n", (int) status, (int) *pVerified);
+    return ATCA_SUCCESS == status;
+}
+
+// *****************************************************************************
+
+/* Answer to a job update. A job canceled meanwhile refuses any update */
+static void updateCallback(void* pCallbackContext, AwsIotJobsCallbackParam_t* pCallbackParam)
+{
+    AwsIotJobsError_t result = pCallbackParam->u.operation.result;
+
+    APP_PS_GovernorNotify(APP_PS_EV_RX);
+    if (AWS_IOT_JOBS_SUCCESS == result)
+        return;
+    APP_OTA_DBG(SYS_ERROR_WARNING, "Job update rejected: %s \r\n", AwsIotJobs_strerror(result));
+    if (AWS_IOT_JOBS_TERMINAL_STATE == result || AWS_IOT_JOBS_NOT_FOUND == result)
+        APP_OTA_AgentJobEnded(&appOtaData.agent);
+}
+
+static bool jobUpdate(const char* pJobId, APP_OTA_JOB_STATUS jobStatus, const char* pDetails)
+{
+    static const AwsIotJobState_t jobStates[] = {
+        [APP_OTA_JOB_IN_PROGRESS] = AWS_IOT_JOB_STATE_IN_PROGRESS,
+        [APP_OTA_JOB_SUCCEEDED] = AWS_IOT_JOB_STATE_SUCCEEDED,
+        [APP_OTA_JOB_FAILED] = AWS_IOT_JOB_STATE_FAILED
+    };
+    AwsIotJobsError_t status;
+    AwsIotJobsRequestInfo_t requestInfo = AWS_IOT_JOBS_REQUEST_INFO_INITIALIZER;
+    AwsIotJobsUpdateInfo_t updateInfo = AWS_IOT_JOBS_UPDATE_INFO_INITIALIZER;
+    AwsIotJobsCallbackInfo_t callbackInfo = AWS_IOT_JOBS_CALLBACK_INFO_INITIALIZER;
+
+    requestInfo.mqttConnection = appOtaData.mqttConnection;
+    requestInfo.qos = IOT_MQTT_QOS_1;
+    requestInfo.retryLimit = PUBLISH_RETRY_LIMIT;
+    requestInfo.retryMs = IOT_MQTT_RETRY_MS_ADAPTIVE;
+    requestInfo.pThingName = g_Aws_ClientID;
+    requestInfo.thingNameLength = strlen(g_Aws_ClientID);
+    requestInfo.pJobId = pJobId;
+    requestInfo.jobIdLength = strlen(pJobId);
+    updateInfo.newStatus = jobStates[jobStatus];
+    updateInfo.pStatusDetails = pDetails;
+    updateInfo.statusDetailsLength = strlen(pDetails);
+    callbackInfo.function = updateCallback;
+
+    APP_PS_GovernorNotify(APP_PS_EV_BURST);
+    status = AwsIotJobs_UpdateAsync(&requestInfo, &updateInfo, AWS_IOT_JOBS_FLAG_KEEP_SUBSCRIPTIONS,
+                                    &callbackInfo, NULL);
+    APP_PS_GovernorNotify(APP_PS_EV_PUBLISH);
+    if (AWS_IOT_JOBS_STATUS_PENDING != status) {
+        APP_OTA_DBG(SYS_ERROR_ERROR, "Job update failed: %s \r\n", AwsIotJobs_strerror(status));
+        return false;
+    }
+    return true;
+}
+
+static void startNextCallback(void* pCallbackContext, AwsIotJobsCallbackParam_t* pCallbackParam)
+{
+    AwsIotJobsError_t result = pCallbackParam->u.operation.result;
+
+    APP_PS_GovernorNotify(APP_PS_EV_RX);
+    if (AWS_IOT_JOBS_SUCCESS == result) {
+        APP_OTA_AgentJobNext(&appOtaData.agent, pCallbackParam->u.operation.pResponse,
+                             pCallbackParam->u.operation.responseLength);
+    }
+    else {
+        APP_OTA_DBG(SYS_ERROR_ERROR, "Start next failed: %s \r\n", AwsIotJobs_strerror(result));
+        APP_OTA_AgentJobNext(&appOtaData.agent, NULL, 0);
+    }
+}
+
+/* The next job changed: one was queued, or the current one was canceled */
+static void notifyNextCallback(void* pCallbackContext, AwsIotJobsCallbackParam_t* pCallbackParam)
+{
+    APP_PS_GovernorNotify(APP_PS_EV_RX);
+    APP_OTA_DBG(SYS_ERROR_DEBUG, "Next job changed \r\n");
+    APP_OTA_AgentJobChanged(&appOtaData.agent, pCallbackParam->u.callback.pDocument,
+                            pCallbackParam->u.callback.documentLength);
+}
+
+static bool jobStartNext(void)
+{
+    AwsIotJobsError_t status;
+    AwsIotJobsRequestInfo_t requestInfo = AWS_IOT_JOBS_REQUEST_INFO_INITIALIZER;
+    AwsIotJobsUpdateInfo_t updateInfo = AWS_IOT_JOBS_UPDATE_INFO_INITIALIZER;
+    AwsIotJobsCallbackInfo_t callbackInfo = AWS_IOT_JOBS_CALLBACK_INFO_INITIALIZER;
+
+    requestInfo.mqttConnection = appOtaData.mqttConnection;
+    requestInfo.qos = IOT_MQTT_QOS_1;
+    requestInfo.retryLimit = PUBLISH_RETRY_LIMIT;
+    requestInfo.retryMs = IOT_MQTT_RETRY_MS_ADAPTIVE;
+    requestInfo.pThingName = g_Aws_ClientID;
+    requestInfo.thingNameLength = strlen(g_Aws_ClientID);
+    callbackInfo.function = startNextCallback;
+
+    status = AwsIotJobs_StartNextAsync(&requestInfo, &updateInfo, AWS_IOT_JOBS_FLAG_KEEP_SUBSCRIPTIONS,
+                                       &callbackInfo, NULL);
+    if (AWS_IOT_JOBS_STATUS_PENDING != status) {
+        APP_OTA_DBG(SYS_ERROR_ERROR, "Start next failed: %s \r\n", AwsIotJobs_strerror(status));
+        return false;
+    }
+    return true;
+}
+
+// *****************************************************************************
+
+/* A stream block: {"f": file, "l": block size, "i": block number, "p": data},
+ * with CBOR keys. The data is taken in place */
+static void blockDecode(const uint8_t* pPayload, size_t payloadLength)
+{
+    const IotSerializerDecodeInterface_t* pDecoder = IotSerializer_GetCborDecoder();
+    IotSerializerDecoderObject_t map = IOT_SERIALIZER_DECODER_OBJECT_INITIALIZER;
+    IotSerializerDecoderObject_t fileId = IOT_SERIALIZER_DECODER_OBJECT_INITIALIZER;
+    IotSerializerDecoderObject_t blockId = IOT_SERIALIZER_DECODER_OBJECT_INITIALIZER;
+    IotSerializerDecoderObject_t block = IOT_SERIALIZER_DECODER_OBJECT_INITIALIZER;
+    bool valid;
+
+    if (IOT_SERIALIZER_SUCCESS != pDecoder->init(&map, pPayload, payloadLength))
+        return;
+    block.u.value.u.string.pString = NULL;
+    block.u.value.u.string.length = 0;
+    valid = IOT_SERIALIZER_CONTAINER_MAP == map.type
+            && IOT_SERIALIZER_SUCCESS == pDecoder->find(&map, "f", &fileId)
+            && IOT_SERIALIZER_SCALAR_SIGNED_INT == fileId.type
+            && IOT_SERIALIZER_SUCCESS == pDecoder->find(&map, "i", &blockId)
+            && IOT_SERIALIZER_SCALAR_SIGNED_INT == blockId.type
+            && IOT_SERIALIZER_SUCCESS == pDecoder->find(&map, "p", &block)
+            && IOT_SERIALIZER_SCALAR_BYTE_STRING == block.type;
+    pDecoder->destroy(&map);
+    if (!valid) {
+        appOtaData.agent.nDropped++;
+        return;
+    }
+    APP_OTA_AgentBlockPut(&appOtaData.agent, (int32_t) fileId.u.value.u.signedInt,
+                          (int32_t) blockId.u.value.u.signedInt,
+                          block.u.value.u.string.pString, block.u.value.u.string.length);
+}
+
+static void streamCallback(void* pCallbackContext, IotMqttCallbackParam_t* pPublish)
+{
+    const IotMqttPublishInfo_t* pInfo = &pPublish->u.message.info;
+    static const char rejected[] = "/rejected/cbor";
+
+    APP_PS_GovernorNotify(APP_PS_EV_RX);
+    if (APP_OTA_STATE_DOWNLOAD != appOtaData.agent.state)
+        return;
+    if (pInfo->topicNameLength >= sizeof(rejected) - 1
+            && 0 == memcmp(pInfo->pTopicName + pInfo->topicNameLength - (sizeof(rejected) - 1),
+                           rejected, sizeof(rejected) - 1)) {
+        APP_OTA_AgentStreamRejected(&appOtaData.agent);
+        return;
+    }
+    blockDecode(pInfo->pPayload, pInfo->payloadLength);
+}
+
+static bool streamSubscribe(const APP_OTA_JOB* pJob, bool subscribe)
+{
+    IotMqttError_t status;
+    IotMqttSubscription_t subscriptions[2] = { IOT_MQTT_SUBSCRIPTION_INITIALIZER, IOT_MQTT_SUBSCRIPTION_INITIALIZER };
+    char dataTopic[APP_OTA_TOPIC_MAX_LEN];
+    char rejectedTopic[APP_OTA_TOPIC_MAX_LEN];
+
+    subscriptions[0].topicFilterLength = (uint16_t) topicBuild(dataTopic, pJob, "data/cbor");
+    subscriptions[1].topicFilterLength = (uint16_t) topicBuild(rejectedTopic, pJob, "rejected/cbor");
+    if (0 == subscriptions[0].topicFilterLength || 0 == subscriptions[1].topicFilterLength)
+        return false;
+    subscriptions[0].pTopicFilter = dataTopic;
+    subscriptions[1].pTopicFilter = rejectedTopic;
+    subscriptions[0].qos = subscriptions[1].qos = IOT_MQTT_QOS_0;
+    subscriptions[0].callback.function = subscriptions[1].callback.function = streamCallback;
+
+    if (subscribe)
+        status = IotMqtt_SubscribeSync(appOtaData.mqttConnection, subscriptions, 2, 0, MQTT_TIMEOUT_MS);
+    else
+        status = IotMqtt_UnsubscribeSync(appOtaData.mqttConnection, subscriptions, 2, 0, MQTT_TIMEOUT_MS);
+    if (IOT_MQTT_SUCCESS != status) {
+        APP_OTA_DBG(SYS_ERROR_ERROR, "Stream %s failed: %s \r\n",
+                    subscribe ? "subscribe" : "unsubscribe", IotMqtt_strerror(status));
+        return false;
+    }
+    return true;
+}
+
+/* {"c": token, "f": file, "l": block size, "o": first block, "n": blocks},
+ * with CBOR keys, sent at QoS 0: a lost request is sent again on timeout */
+static bool blocksRequest(const APP_OTA_JOB* pJob, uint32_t firstBlock, uint32_t nBlocks)
+{
+    const IotSerializerEncodeInterface_t* pEncoder = IotSerializer_GetCborEncoder();
+    IotSerializerEncoderObject_t stream = IOT_SERIALIZER_ENCODER_CONTAINER_INITIALIZER_STREAM;
+    IotSerializerEncoderObject_t map = IOT_SERIALIZER_ENCODER_CONTAINER_INITIALIZER_MAP;
+    IotMqttPublishInfo_t publishInfo = IOT_MQTT_PUBLISH_INFO_INITIALIZER;
+    IotSerializerError_t error;
+    IotMqttError_t status;
+    uint8_t request[APP_OTA_REQUEST_MAX_LEN];
+    char topic[APP_OTA_TOPIC_MAX_LEN];
+    size_t requestLength = 0;
+
+    error = pEncoder->init(&stream, request, sizeof(request));
+    if (IOT_SERIALIZER_SUCCESS != error)
+        return false;
+    error = pEncoder->openContainer(&stream, &map, 5);
+    if (IOT_SERIALIZER_SUCCESS == error)
+        error = pEncoder->appendKeyValue(&map, "c", IotSerializer_ScalarTextString("rdy"));
+    if (IOT_SERIALIZER_SUCCESS == error)
+        error = pEncoder->appendKeyValue(&map, "f", IotSerializer_ScalarSignedInt(pJob->fileId));
+    if (IOT_SERIALIZER_SUCCESS == error)
+        error = pEncoder->appendKeyValue(&map, "l", IotSerializer_ScalarSignedInt(APP_OTA_BLOCK_SIZE));
+    if (IOT_SERIALIZER_SUCCESS == error)
+        error = pEncoder->appendKeyValue(&map, "o", IotSerializer_ScalarSignedInt(firstBlock));
+    if (IOT_SERIALIZER_SUCCESS == error)
+        error = pEncoder->appendKeyValue(&map, "n", IotSerializer_ScalarSignedInt(nBlocks));
+    if (IOT_SERIALIZER_SUCCESS == error)
+        error = pEncoder->closeContainer(&stream, &map);
+    if (IOT_SERIALIZER_SUCCESS == error)
+        requestLength = pEncoder->getEncodedSize(&stream, request);
+    pEncoder->destroy(&stream);
+    if (IOT_SERIALIZER_SUCCESS != error)
+        return false;
+
+    publishInfo.qos = IOT_MQTT_QOS_0;
+    publishInfo.pTopicName = topic;
+    publishInfo.topicNameLength = (uint16_t) topicBuild(topic, pJob, "get/cbor");
+    publishInfo.pPayload = request;
+    publishInfo.payloadLength = requestLength;
+    APP_PS_GovernorNotify(APP_PS_EV_BURST);
+    status = IotMqtt_PublishAsync(appOtaData.mqttConnection, &publishInfo, 0, NULL, NULL);
+    APP_PS_GovernorNotify(APP_PS_EV_PUBLISH);
+    if (IOT_MQTT_SUCCESS != status) {
+        APP_OTA_DBG(SYS_ERROR_ERROR, "Block request failed: %s \r\n", IotMqtt_strerror(status));
+        return false;
+    }
+    return true;
+}
+
+// *****************************************************************************
+
+void APP_OTA_Initialize(void)
+{
+    memset(&appOtaData, 0, sizeof(appOtaData));
+    appOtaData.mqttConnection = IOT_MQTT_CONNECTION_INITIALIZER;
+    OSAL_MUTEX_Create(&writerMutex);
+    APP_OTA_AgentInit(&appOtaData.agent, &otaPort, signerKey, sectorBuffers);
+}
+
+bool APP_OTA_Start(IotMqttConnection_t mqttConnection)
+{
+    AwsIotJobsError_t status;
+    AwsIotJobsCallbackInfo_t callbackInfo = AWS_IOT_JOBS_CALLBACK_INFO_INITIALIZER;
+
+    status = AwsIotJobs_Init(MQTT_TIMEOUT_MS);
+    if (AWS_IOT_JOBS_SUCCESS != status) {
+        APP_OTA_DBG(SYS_ERROR_ERROR, "Jobs init failed: %s \r\n", AwsIotJobs_strerror(status));
+        return false;
+    }
+    appOtaData.started = true;
+    appOtaData.mqttConnection = mqttConnection;
+    APP_OTA_AgentStart(&appOtaData.agent);
+
+    callbackInfo.function = notifyNextCallback;
+    status = AwsIotJobs_SetNotifyNextCallback(mqttConnection, g_Aws_ClientID, strlen(g_Aws_ClientID), 0, &callbackInfo);
+    if (AWS_IOT_JOBS_SUCCESS != status) {
+        APP_OTA_DBG(SYS_ERROR_ERROR, "Notify next subscription failed: %s \r\n", AwsIotJobs_strerror(status));
+        APP_OTA_Stop();
+        return false;
+    }
+    return true;
+}
+
+void APP_OTA_Stop(void)
+{
+    if (!appOtaData.started)
+        return;
+    /* Frees the Jobs subscriptions and operations */
+    AwsIotJobs_Cleanup();
+    APP_OTA_AgentStop(&appOtaData.agent);
+    appOtaData.started = false;
+    appOtaData.mqttConnection = IOT_MQTT_CONNECTION_INITIALIZER;
+}
+
+void APP_OTA_Tasks(void)
+{
+    if (!appOtaData.started)
+        return;
+    APP_OTA_AgentTasks(&appOtaData.agent);
+}
+
+#endif /* AWS_CLOUD_DEMO */
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,78 @@
+/*******************************************************************************
+  MPLAB Harmony Application Header File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_ota.h
+
+  Summary:
+    This header file provides prototypes and definitions for firmware updates.
+
+  Description:
+    This header file provides function prototypes and data type definitions for
+    the firmware update agent. An AWS IoT Job names an MQTT stream holding the
+    image; the image is fetched block by block into the image slot of the
+    external flash, then checked against the SHA-256 digest and the ECDSA
+    signature given by the job before the job is reported as succeeded.
+*******************************************************************************/
+
+#ifndef _APP_OTA_H
+#define _APP_OTA_H
+
+#ifdef AWS_CLOUD_DEMO
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "iot_mqtt.h"
+#include "app_log.h"
+#include "app_ota_agent.h"
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+/* Debug wrappers */
+#define APP_OTA_DBG(level,fmt,...) APP_LOG_DBG(APP_LOG_MODULE_OTA,level,"[APP_OTA] "fmt,##__VA_ARGS__)
+#define APP_OTA_PRNT(fmt,...) APP_LOG_PRNT(APP_LOG_MODULE_OTA,"[APP_OTA] "fmt, ##__VA_ARGS__)
+
+// *****************************************************************************
+
+typedef struct
+{
+    IotMqttConnection_t mqttConnection;
+    /* The Jobs library lives as long as one MQTT connection */
+    bool started;
+    /* Image slot in the memory driver's bytes */
+    uint32_t slotOffset;
+    /* Job, download and verification */
+    APP_OTA_AGENT agent;
+} APP_OTA_DATA;
+APP_OTA_DATA appOtaData;
+
+// *****************************************************************************
+
+void APP_OTA_Initialize(void);
+/* Listen for firmware jobs on a new MQTT connection and resume the last one */
+bool APP_OTA_Start(IotMqttConnection_t mqttConnection);
+/* The MQTT connection is gone; the download resumes on the next one */
+void APP_OTA_Stop(void);
+void APP_OTA_Tasks(void);
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* AWS_CLOUD_DEMO */
+#endif /* _APP_OTA_H */
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,536 @@
+/*******************************************************************************
+  MPLAB Harmony Application Source File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_ota_agent.c
+
+  Summary:
+    This file contains the firmware update agent without its platform.
+
+  Description:
+    A firmware job document reads
+    {"operation":"firmware-update","streamId":"<id>","fileId":0,"size":<bytes>,
+     "sha256":"<64 hex>","signature":"<128 hex, r || s>"}.
+    A job is refused as it is handed out when no signer key is built in. The
+    image is requested as many blocks at a time as the writer has room for.
+    The progress record keeps the image digest and the offset known to be in
+    the flash, so that a download cut by a reconnect or a reset goes on from
+    there. Once complete, the slot is read back through the hash and the
+    digest checked against the signature before the job succeeds.
+ *******************************************************************************/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "app_ota_agent.h"
+#include "aws_iot_doc_parser.h"
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Local Functions
+// *****************************************************************************
+// *****************************************************************************
+
+static uint32_t msSince(const APP_OTA_AGENT* pAgent, uint32_t timeStamp)
+{
+    return pAgent->pPort->msNow() - timeStamp;
+}
+
+/* Look up a member of a JSON object holding an object */
+static bool objectFind(const char* pObject, size_t objectLength, const char* pKey,
+                       const char** ppValue, size_t* pValueLength)
+{
+    return AwsIotDocParser_FindPath(pObject, objectLength, pKey, strlen(pKey), ppValue, pValueLength)
+            && '{' == **ppValue;
+}
+
+/* Look up a member of a JSON object holding a string, returned without quotes */
+static bool stringFind(const char* pObject, size_t objectLength, const char* pKey,
+                       const char** ppValue, size_t* pValueLength)
+{
+    if (!AwsIotDocParser_FindPath(pObject, objectLength, pKey, strlen(pKey), ppValue, pValueLength)
+            || *pValueLength < 2 || '"' != **ppValue)
+        return false;
+    (*ppValue)++;
+    *pValueLength -= 2;
+    return true;
+}
+
+/* Look up a member of a JSON object holding a non-negative integer */
+static bool numberFind(const char* pObject, size_t objectLength, const char* pKey, uint32_t* pNumber)
+{
+    const char* pValue;
+    size_t valueLength;
+    char buf[12];
+    char* pEnd;
+
+    if (!AwsIotDocParser_FindPath(pObject, objectLength, pKey, strlen(pKey), &pValue, &valueLength)
+            || 0 == valueLength || valueLength >= sizeof(buf) || '-' == *pValue)
+        return false;
+    memcpy(buf, pValue, valueLength);
+    buf[valueLength] = '\0';
+    *pNumber = (uint32_t) strtoul(buf, &pEnd, 10);
+    return ('\0' == *pEnd);
+}
+
+static bool hexParse(const char* pHex, size_t hexLength, uint8_t* pOut, size_t outLength)
+{
+    char byte[3] = { 0 };
+    char* pEnd;
+    size_t i;
+
+    if (hexLength != 2 * outLength)
+        return false;
+    for (i = 0; i < outLength; i++) {
+        byte[0] = pHex[2 * i];
+        byte[1] = pHex[2 * i + 1];
+        pOut[i] = (uint8_t) strtoul(byte, &pEnd, 16);
+        if ('\0' != *pEnd)
+            return false;
+    }
+    return true;
+}
+
+static bool signerKeySet(const APP_OTA_AGENT* pAgent)
+{
+    size_t i;
+
+    for (i = 0; i < 64; i++) {
+        if (0 != pAgent->pSignerKey[i])
+            return true;
+    }
+    return false;
+}
+
+// *****************************************************************************
+
+static void progressStore(APP_OTA_AGENT* pAgent)
+{
+    if (pAgent->pPort->progressWrite(&pAgent->progress))
+        pAgent->progressStored = pAgent->progress.committed;
+}
+
+/* The job ends with status and reason once the report went out */
+static void jobFail(APP_OTA_AGENT* pAgent, const char* pReason)
+{
+    pAgent->reportStatus = APP_OTA_JOB_FAILED;
+    pAgent->pReason = pReason;
+    pAgent->state = APP_OTA_STATE_REPORT;
+    pAgent->pPort->event(APP_OTA_EVENT_FAILED);
+}
+
+/* Take the job execution handed out by start-next, if it is ours */
+static void jobParse(APP_OTA_AGENT* pAgent, const char* pDocument, size_t documentLength)
+{
+    APP_OTA_JOB* pJob = &pAgent->job;
+    const char* pExecution, * pJobDocument, * pValue;
+    size_t executionLength, jobDocumentLength, valueLength;
+    uint32_t fileId;
+
+    if (!objectFind(pDocument, documentLength, "execution", &pExecution, &executionLength)) {
+        pAgent->pPort->event(APP_OTA_EVENT_NO_JOB);
+        return;
+    }
+    if (!stringFind(pExecution, executionLength, "jobId", &pValue, &valueLength)
+            || 0 == valueLength || valueLength > APP_OTA_JOB_ID_LEN) {
+        pAgent->pPort->event(APP_OTA_EVENT_BAD_JOB);
+        return;
+    }
+    memset(pJob, 0, sizeof(APP_OTA_JOB));
+    memcpy(pJob->jobId, pValue, valueLength);
+
+    if (!objectFind(pExecution, executionLength, "jobDocument", &pJobDocument, &jobDocumentLength)
+            || !stringFind(pJobDocument, jobDocumentLength, "operation", &pValue, &valueLength)
+            || 15 != valueLength || 0 != strncmp(pValue, "firmware-update", 15)) {
+        jobFail(pAgent, "unsupported operation");
+        return;
+    }
+    /* Nothing is downloaded that could not be verified */
+    if (!signerKeySet(pAgent)) {
+        jobFail(pAgent, "no signer key");
+        return;
+    }
+    if (!stringFind(pJobDocument, jobDocumentLength, "streamId", &pValue, &valueLength)
+            || 0 == valueLength || valueLength > APP_OTA_STREAM_ID_LEN) {
+        jobFail(pAgent, "bad streamId");
+        return;
+    }
+    memcpy(pJob->streamId, pValue, valueLength);
+    if (!numberFind(pJobDocument, jobDocumentLength, "fileId", &fileId)
+            || !numberFind(pJobDocument, jobDocumentLength, "size", &pJob->size) || 0 == pJob->size) {
+        jobFail(pAgent, "bad fileId or size");
+        return;
+    }
+    pJob->fileId = (int32_t) fileId;
+    if (!stringFind(pJobDocument, jobDocumentLength, "sha256", &pValue, &valueLength)
+            || !hexParse(pValue, valueLength, pJob->sha256, sizeof(pJob->sha256))) {
+        jobFail(pAgent, "bad sha256");
+        return;
+    }
+    if (!stringFind(pJobDocument, jobDocumentLength, "signature", &pValue, &valueLength)
+            || !hexParse(pValue, valueLength, pJob->signature, sizeof(pJob->signature))) {
+        jobFail(pAgent, "bad signature");
+        return;
+    }
+    pAgent->state = APP_OTA_STATE_JOB;
+    pAgent->pPort->event(APP_OTA_EVENT_JOB);
+}
+
+static void jobStartNext(APP_OTA_AGENT* pAgent)
+{
+    pAgent->jobQuery = false;
+    pAgent->jobPending = true;
+    if (!pAgent->pPort->jobStartNext())
+        pAgent->jobPending = false;
+}
+
+static bool streamSubscribe(APP_OTA_AGENT* pAgent, bool subscribe)
+{
+    if (subscribe == pAgent->subscribed)
+        return true;
+    if (!pAgent->pPort->streamSubscribe(&pAgent->job, subscribe))
+        return false;
+    pAgent->subscribed = subscribe;
+    return true;
+}
+
+// *****************************************************************************
+
+/* Pick up the image where the progress record says, once the slot is there */
+static void downloadStart(APP_OTA_AGENT* pAgent)
+{
+    const APP_OTA_PORT* pPort = pAgent->pPort;
+    APP_OTA_PROGRESS* pProgress = &pAgent->progress;
+    uint32_t resume = 0;
+    int8_t slot;
+
+    /* A sector write of the last connection still reads from the buffers */
+    if (1 == pPort->flash.status(pPort->flash.context))
+        return;
+    slot = pPort->slotGet(&pAgent->slotSize);
+    if (slot > 0)
+        return;
+    if (slot < 0) {
+        jobFail(pAgent, "no image slot");
+        return;
+    }
+    if (pAgent->job.size > pAgent->slotSize) {
+        jobFail(pAgent, "image too large");
+        return;
+    }
+
+    if (APP_OTA_PROGRESS_MAGIC != pProgress->magic && !pPort->progressRead(pProgress))
+        pProgress->magic = 0;
+    if (APP_OTA_PROGRESS_MAGIC == pProgress->magic && pProgress->size == pAgent->job.size
+            && 0 == memcmp(pProgress->sha256, pAgent->job.sha256, sizeof(pProgress->sha256))) {
+        if (APP_OTA_PROGRESS_STAGED == pProgress->state) {
+            pAgent->reportStatus = APP_OTA_JOB_SUCCEEDED;
+            pAgent->pReason = NULL;
+            pAgent->state = APP_OTA_STATE_REPORT;
+            pPort->event(APP_OTA_EVENT_STAGED);
+            return;
+        }
+        resume = pProgress->committed;
+    }
+    else {
+        memset(pProgress, 0, sizeof(APP_OTA_PROGRESS));
+        pProgress->magic = APP_OTA_PROGRESS_MAGIC;
+        pProgress->size = pAgent->job.size;
+        memcpy(pProgress->sha256, pAgent->job.sha256, sizeof(pProgress->sha256));
+        pProgress->state = APP_OTA_PROGRESS_RECEIVING;
+        progressStore(pAgent);
+    }
+
+    pPort->writerLock();
+    APP_OTA_WriterInit(&pAgent->writer, &pPort->flash, pAgent->pBuffers, pAgent->job.size, resume);
+    pPort->writerUnlock();
+    pProgress->committed = pAgent->writer.committed;
+    pAgent->nRequests = 0;
+    pAgent->nBlocks = 0;
+    pAgent->nDropped = 0;
+    pAgent->jobAbort = false;
+    pAgent->pStreamError = NULL;
+    if (!streamSubscribe(pAgent, true))
+        return;
+    pAgent->requestStart = pAgent->writer.received;
+    pAgent->requestEnd = pAgent->writer.received;
+    pAgent->requestRetries = 0;
+    pAgent->reportedPercent = (uint32_t) ((uint64_t) pProgress->committed * 100 / pAgent->job.size);
+    pAgent->startTime = pPort->msNow();
+    if (0 != pProgress->committed)
+        pPort->event(APP_OTA_EVENT_RESUME);
+    pAgent->state = APP_OTA_STATE_DOWNLOAD;
+    pPort->jobUpdate(pAgent->job.jobId, APP_OTA_JOB_IN_PROGRESS, "{\"state\":\"downloading\"}");
+}
+
+static void downloadTasks(APP_OTA_AGENT* pAgent)
+{
+    const APP_OTA_PORT* pPort = pAgent->pPort;
+    APP_OTA_WRITER* pWriter = &pAgent->writer;
+    APP_OTA_PROGRESS* pProgress = &pAgent->progress;
+    uint32_t received, room, committed, nBlocks, percent;
+    char details[APP_OTA_DETAILS_MAX_LEN];
+    bool failed, done;
+
+    if (pAgent->jobAbort) {
+        streamSubscribe(pAgent, false);
+        progressStore(pAgent);
+        pAgent->state = APP_OTA_STATE_IDLE;
+        pAgent->jobQuery = true;
+        pPort->event(APP_OTA_EVENT_ENDED);
+        return;
+    }
+    if (NULL != pAgent->pStreamError) {
+        streamSubscribe(pAgent, false);
+        progressStore(pAgent);
+        jobFail(pAgent, pAgent->pStreamError);
+        return;
+    }
+
+    pPort->writerLock();
+    APP_OTA_WriterTasks(pWriter);
+    received = pWriter->received;
+    room = APP_OTA_WriterRoom(pWriter);
+    committed = pWriter->committed;
+    failed = pWriter->failed;
+    done = APP_OTA_WriterDone(pWriter);
+    pPort->writerUnlock();
+
+    if (failed) {
+        streamSubscribe(pAgent, false);
+        jobFail(pAgent, "flash write");
+        return;
+    }
+    if (committed != pProgress->committed) {
+        pProgress->committed = committed;
+        /* The store waits for a pause before writing, which is when it matters */
+        if (committed - pAgent->progressStored >= APP_OTA_PROGRESS_STEP)
+            progressStore(pAgent);
+        percent = (uint32_t) ((uint64_t) committed * 100 / pAgent->job.size);
+        if (percent / 25 != pAgent->reportedPercent / 25 && !done) {
+            snprintf(details, sizeof(details), "{\"state\":\"downloading\",\"progress\":\"%lu%%\"}",
+                     (unsigned long) percent);
+            pPort->jobUpdate(pAgent->job.jobId, APP_OTA_JOB_IN_PROGRESS, details);
+        }
+        pAgent->reportedPercent = percent;
+    }
+    if (done) {
+        pPort->event(APP_OTA_EVENT_DOWNLOADED);
+        streamSubscribe(pAgent, false);
+        progressStore(pAgent);
+        pAgent->state = APP_OTA_STATE_VERIFY;
+        return;
+    }
+
+    /* Ask for what the buffers can take once the last request was served,
+     * or again if part of it went missing */
+    if (received < pAgent->requestEnd && msSince(pAgent, pAgent->requestTime) < APP_OTA_REQUEST_TMO_MS)
+        return;
+    if (received == pAgent->requestStart && received < pAgent->requestEnd) {
+        if (++pAgent->requestRetries > APP_OTA_REQUEST_RETRIES) {
+            streamSubscribe(pAgent, false);
+            progressStore(pAgent);
+            jobFail(pAgent, "stream timeout");
+            return;
+        }
+    }
+    else
+        pAgent->requestRetries = 0;
+    /* Only the last block is short */
+    nBlocks = (room == pAgent->job.size - received) ?
+            (room + APP_OTA_BLOCK_SIZE - 1) / APP_OTA_BLOCK_SIZE : room / APP_OTA_BLOCK_SIZE;
+    if (0 == nBlocks)
+        return;
+    if (pPort->blocksRequest(&pAgent->job, received / APP_OTA_BLOCK_SIZE, nBlocks)) {
+        pAgent->nRequests++;
+        pAgent->requestStart = received;
+        pAgent->requestEnd = received + nBlocks * APP_OTA_BLOCK_SIZE;
+        if (pAgent->requestEnd > pAgent->job.size)
+            pAgent->requestEnd = pAgent->job.size;
+        pAgent->requestTime = pPort->msNow();
+    }
+}
+
+/* Read the slot back through the hash. This blocks the agent's task for the
+ * read-back; a digest kept running through the download would instead hold
+ * the hash engine, which TLS shares, for as long as the download lasts, and
+ * would not survive a reset */
+static void imageVerify(APP_OTA_AGENT* pAgent)
+{
+    const APP_OTA_PORT* pPort = pAgent->pPort;
+    APP_OTA_PROGRESS* pProgress = &pAgent->progress;
+    const uint32_t bufferSize = APP_OTA_WRITER_NUM_BUFFERS * APP_OTA_WRITER_SECTOR_SIZE;
+    uint8_t digest[32];
+    uint32_t offset, n;
+    bool readOk = true, hashOk, verified = false;
+
+    if (!pPort->hashStart(pAgent->job.size)) {
+        jobFail(pAgent, "hash engine");
+        return;
+    }
+    for (offset = 0; offset < pAgent->job.size && readOk; offset += n) {
+        n = pAgent->job.size - offset;
+        if (n > bufferSize)
+            n = bufferSize;
+        readOk = pPort->slotRead(offset, pAgent->pBuffers, n) && pPort->hashUpdate(pAgent->pBuffers, n);
+    }
+    /* Ends the hash and frees the engine even after a short read */
+    hashOk = pPort->hashFinish(digest);
+    if (!readOk || !hashOk) {
+        jobFail(pAgent, "flash read");
+        return;
+    }
+    if (0 != memcmp(digest, pAgent->job.sha256, sizeof(digest))) {
+        /* Start over should the same image be sent again */
+        pProgress->magic = 0;
+        progressStore(pAgent);
+        jobFail(pAgent, "digest mismatch");
+        return;
+    }
+    if (!pPort->signatureVerify(digest, pAgent->job.signature, pAgent->pSignerKey, &verified) || !verified) {
+        pProgress->magic = 0;
+        progressStore(pAgent);
+        jobFail(pAgent, "bad signature");
+        return;
+    }
+
+    pProgress->state = APP_OTA_PROGRESS_STAGED;
+    progressStore(pAgent);
+    pAgent->reportStatus = APP_OTA_JOB_SUCCEEDED;
+    pAgent->pReason = NULL;
+    pAgent->state = APP_OTA_STATE_REPORT;
+    pPort->event(APP_OTA_EVENT_VERIFIED);
+}
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Application Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+
+void APP_OTA_AgentInit(APP_OTA_AGENT* pAgent, const APP_OTA_PORT* pPort, const uint8_t* pSignerKey,
+                       uint8_t* pBuffers)
+{
+    memset(pAgent, 0, sizeof(APP_OTA_AGENT));
+    pAgent->pPort = pPort;
+    pAgent->pSignerKey = pSignerKey;
+    pAgent->pBuffers = pBuffers;
+    pAgent->state = APP_OTA_STATE_IDLE;
+}
+
+void APP_OTA_AgentStart(APP_OTA_AGENT* pAgent)
+{
+    pAgent->state = APP_OTA_STATE_IDLE;
+    pAgent->subscribed = false;
+    pAgent->jobPending = false;
+    pAgent->jobQuery = true;
+}
+
+void APP_OTA_AgentStop(APP_OTA_AGENT* pAgent)
+{
+    if (APP_OTA_STATE_DOWNLOAD == pAgent->state)
+        progressStore(pAgent);
+    pAgent->state = APP_OTA_STATE_IDLE;
+    /* The stream subscriptions go with the connection */
+    pAgent->subscribed = false;
+    pAgent->jobPending = false;
+}
+
+void APP_OTA_AgentTasks(APP_OTA_AGENT* pAgent)
+{
+    char details[APP_OTA_DETAILS_MAX_LEN];
+
+    switch (pAgent->state) {
+        case APP_OTA_STATE_IDLE:
+            if (pAgent->jobQuery && !pAgent->jobPending)
+                jobStartNext(pAgent);
+            break;
+
+        case APP_OTA_STATE_JOB:
+            downloadStart(pAgent);
+            break;
+
+        case APP_OTA_STATE_DOWNLOAD:
+            downloadTasks(pAgent);
+            break;
+
+        case APP_OTA_STATE_VERIFY:
+            imageVerify(pAgent);
+            break;
+
+        case APP_OTA_STATE_REPORT:
+            if (APP_OTA_JOB_SUCCEEDED == pAgent->reportStatus)
+                snprintf(details, sizeof(details), "{\"state\":\"staged\"}");
+            else
+                snprintf(details, sizeof(details), "{\"reason\":\"%s\"}", pAgent->pReason);
+            pAgent->pPort->jobUpdate(pAgent->job.jobId, pAgent->reportStatus, details);
+            pAgent->state = APP_OTA_STATE_IDLE;
+            pAgent->jobQuery = true;
+            break;
+
+        default:
+            break;
+    }
+}
+
+void APP_OTA_AgentJobNext(APP_OTA_AGENT* pAgent, const char* pDocument, size_t documentLength)
+{
+    if (NULL != pDocument)
+        jobParse(pAgent, pDocument, documentLength);
+    pAgent->jobPending = false;
+}
+
+void APP_OTA_AgentJobChanged(APP_OTA_AGENT* pAgent, const char* pDocument, size_t documentLength)
+{
+    const char* pExecution, * pJobId;
+    size_t executionLength, jobIdLength;
+
+    pAgent->jobQuery = true;
+    if (APP_OTA_STATE_DOWNLOAD != pAgent->state)
+        return;
+    /* The one being downloaded is no longer first in line */
+    if (!objectFind(pDocument, documentLength, "execution", &pExecution, &executionLength)
+            || !stringFind(pExecution, executionLength, "jobId", &pJobId, &jobIdLength)
+            || jobIdLength != strlen(pAgent->job.jobId)
+            || 0 != strncmp(pJobId, pAgent->job.jobId, jobIdLength))
+        pAgent->jobAbort = true;
+}
+
+void APP_OTA_AgentJobEnded(APP_OTA_AGENT* pAgent)
+{
+    pAgent->jobAbort = true;
+}
+
+void APP_OTA_AgentStreamRejected(APP_OTA_AGENT* pAgent)
+{
+    if (APP_OTA_STATE_DOWNLOAD == pAgent->state)
+        pAgent->pStreamError = "stream rejected";
+}
+
+void APP_OTA_AgentBlockPut(APP_OTA_AGENT* pAgent, int32_t fileId, int32_t blockId,
+                           const uint8_t* pData, uint32_t length)
+{
+    APP_OTA_WRITER_STATUS status;
+
+    if (APP_OTA_STATE_DOWNLOAD != pAgent->state)
+        return;
+    if (fileId != pAgent->job.fileId || blockId < 0) {
+        pAgent->nDropped++;
+        return;
+    }
+
+    pAgent->pPort->writerLock();
+    status = APP_OTA_WriterBlockPut(&pAgent->writer, (uint32_t) blockId * APP_OTA_BLOCK_SIZE, pData, length);
+    pAgent->pPort->writerUnlock();
+    if (APP_OTA_WRITER_OK == status)
+        pAgent->nBlocks++;
+    else
+        pAgent->nDropped++;
+}
+
+/*******************************************************************************
+ End of File
+ */
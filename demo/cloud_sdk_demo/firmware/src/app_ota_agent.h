@@ -0,0 +1,222 @@
+/*******************************************************************************
+  MPLAB Harmony Application Header File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_ota_agent.h
+
+  Summary:
+    This header file provides prototypes and definitions for the update agent.
+
+  Description:
+    This header file provides function prototypes and data type definitions for
+    the firmware update agent without its platform: taking a job, fetching the
+    image into the slot, resuming a cut download and verifying the image. The
+    Jobs service, the stream, the flash, the configuration store, the hash
+    engine and the secure element are reached through APP_OTA_PORT; app_ota.c
+    binds them, and test/unit/app_tests_ota.c runs the agent on a host against
+    a simulated flash and Jobs service.
+*******************************************************************************/
+
+#ifndef _APP_OTA_AGENT_H
+#define _APP_OTA_AGENT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "app_ota_writer.h"
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+// *****************************************************************************
+
+/* Stream block size, as requested from the service */
+#define APP_OTA_BLOCK_SIZE              1024
+/* Blocks of a request not all received by then are requested again */
+#define APP_OTA_REQUEST_TMO_MS          3000
+/* Requests in a row without a block before the download is given up */
+#define APP_OTA_REQUEST_RETRIES         10
+/* The progress record is stored each time this much more is in the flash */
+#define APP_OTA_PROGRESS_STEP           0x10000
+#define APP_OTA_JOB_ID_LEN              64
+#define APP_OTA_STREAM_ID_LEN           64
+#define APP_OTA_DETAILS_MAX_LEN         64
+#define APP_OTA_PROGRESS_MAGIC          0x4f544101      /* "OTA" + record version */
+
+// *****************************************************************************
+
+typedef enum
+{
+    /* No job, or waiting for the answer to a start-next */
+    APP_OTA_STATE_IDLE=0,
+    /* A firmware job was handed out */
+    APP_OTA_STATE_JOB,
+    APP_OTA_STATE_DOWNLOAD,
+    APP_OTA_STATE_VERIFY,
+    /* Report the outcome and ask for the next job */
+    APP_OTA_STATE_REPORT
+} APP_OTA_STATES;
+
+typedef enum
+{
+    APP_OTA_PROGRESS_RECEIVING=0,
+    /* Downloaded and verified, waiting for the bootloader */
+    APP_OTA_PROGRESS_STAGED
+} APP_OTA_PROGRESS_STATE;
+
+/* Job execution states reported to the service */
+typedef enum
+{
+    APP_OTA_JOB_IN_PROGRESS=0,
+    APP_OTA_JOB_SUCCEEDED,
+    APP_OTA_JOB_FAILED
+} APP_OTA_JOB_STATUS;
+
+/* What the log shows; the details are in the agent */
+typedef enum
+{
+    APP_OTA_EVENT_NO_JOB=0,
+    /* A job without a usable ID, not even reported */
+    APP_OTA_EVENT_BAD_JOB,
+    APP_OTA_EVENT_JOB,
+    APP_OTA_EVENT_RESUME,
+    APP_OTA_EVENT_DOWNLOADED,
+    APP_OTA_EVENT_VERIFIED,
+    /* The image of the job is already in the slot */
+    APP_OTA_EVENT_STAGED,
+    APP_OTA_EVENT_FAILED,
+    /* Canceled, or no longer first in line */
+    APP_OTA_EVENT_ENDED
+} APP_OTA_EVENT;
+
+/* Private record in the configuration store. The image is known by its digest,
+ * so a job sent again for the same image picks up where the last one stopped */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t size;
+    uint8_t sha256[32];
+    uint32_t committed;
+    uint32_t state;
+} APP_OTA_PROGRESS;
+
+typedef struct
+{
+    char jobId[APP_OTA_JOB_ID_LEN + 1];
+    char streamId[APP_OTA_STREAM_ID_LEN + 1];
+    int32_t fileId;
+    uint32_t size;
+    uint8_t sha256[32];
+    /* r || s */
+    uint8_t signature[64];
+} APP_OTA_JOB;
+
+/* Platform of the agent. Calls are made from the task running
+ * APP_OTA_AgentTasks, except for the writer lock */
+typedef struct
+{
+    /* Sector writes into the image slot */
+    APP_OTA_FLASH flash;
+    /* Size of the image slot: 0 found, 1 the flash is not ready yet, -1 no slot */
+    int8_t (*slotGet)(uint32_t* pSlotSize);
+    /* Blocking read from the slot, for the read-back */
+    bool (*slotRead)(uint32_t offset, uint8_t* pBuffer, uint32_t length);
+    /* Progress record in the configuration store */
+    bool (*progressRead)(APP_OTA_PROGRESS* pProgress);
+    bool (*progressWrite)(const APP_OTA_PROGRESS* pProgress);
+    /* Jobs service. The answer to a start-next comes back through
+     * APP_OTA_AgentJobNext, a refused update through APP_OTA_AgentJobEnded */
+    bool (*jobStartNext)(void);
+    bool (*jobUpdate)(const char* pJobId, APP_OTA_JOB_STATUS status, const char* pDetails);
+    /* Stream of the job. Blocks come back through APP_OTA_AgentBlockPut */
+    bool (*streamSubscribe)(const APP_OTA_JOB* pJob, bool subscribe);
+    bool (*blocksRequest)(const APP_OTA_JOB* pJob, uint32_t firstBlock, uint32_t nBlocks);
+    /* SHA-256 of the read-back; finish also frees a hash cut short */
+    bool (*hashStart)(uint32_t size);
+    bool (*hashUpdate)(const uint8_t* pData, uint32_t length);
+    bool (*hashFinish)(uint8_t* pDigest);
+    /* ECDSA P-256 check of a digest against r || s with the key X || Y */
+    bool (*signatureVerify)(const uint8_t* pDigest, const uint8_t* pSignature, const uint8_t* pKey, bool* pVerified);
+    /* Free running milliseconds */
+    uint32_t (*msNow)(void);
+    /* Blocks come in on the MQTT receive task */
+    void (*writerLock)(void);
+    void (*writerUnlock)(void);
+    void (*event)(APP_OTA_EVENT event);
+} APP_OTA_PORT;
+
+typedef struct
+{
+    const APP_OTA_PORT* pPort;
+    /* X || Y of the P-256 public key the images are signed with */
+    const uint8_t* pSignerKey;
+    /* APP_OTA_WRITER_NUM_BUFFERS sectors, reused by the read-back */
+    uint8_t* pBuffers;
+    APP_OTA_STATES state;
+    /* Ask the service for the next job */
+    volatile bool jobQuery;
+    volatile bool jobPending;
+    /* Set from the Jobs and stream callbacks, handled by APP_OTA_AgentTasks */
+    volatile bool jobAbort;
+    const char* volatile pStreamError;
+    APP_OTA_JOB job;
+    /* Outcome to report and its reason */
+    APP_OTA_JOB_STATUS reportStatus;
+    const char* pReason;
+    uint32_t slotSize;
+    APP_OTA_WRITER writer;
+    APP_OTA_PROGRESS progress;
+    uint32_t progressStored;
+    /* Stream subscribed on this connection */
+    bool subscribed;
+    /* Offsets the outstanding request started and ends at, and when it was sent */
+    uint32_t requestStart;
+    uint32_t requestEnd;
+    uint32_t requestTime;
+    uint32_t requestRetries;
+    uint32_t reportedPercent;
+    uint32_t startTime;
+    /* Statistics */
+    uint32_t nRequests;
+    uint32_t nBlocks;
+    uint32_t nDropped;
+} APP_OTA_AGENT;
+
+// *****************************************************************************
+
+void APP_OTA_AgentInit(APP_OTA_AGENT* pAgent, const APP_OTA_PORT* pPort, const uint8_t* pSignerKey,
+                       uint8_t* pBuffers);
+/* A new MQTT connection: ask for the next job, a cut download comes back as it */
+void APP_OTA_AgentStart(APP_OTA_AGENT* pAgent);
+/* The MQTT connection is gone */
+void APP_OTA_AgentStop(APP_OTA_AGENT* pAgent);
+void APP_OTA_AgentTasks(APP_OTA_AGENT* pAgent);
+/* Answer to a start-next; NULL if it failed */
+void APP_OTA_AgentJobNext(APP_OTA_AGENT* pAgent, const char* pDocument, size_t documentLength);
+/* Notify-next: the next job changed */
+void APP_OTA_AgentJobChanged(APP_OTA_AGENT* pAgent, const char* pDocument, size_t documentLength);
+/* An update was refused because the job ended */
+void APP_OTA_AgentJobEnded(APP_OTA_AGENT* pAgent);
+void APP_OTA_AgentStreamRejected(APP_OTA_AGENT* pAgent);
+void APP_OTA_AgentBlockPut(APP_OTA_AGENT* pAgent, int32_t fileId, int32_t blockId,
+                           const uint8_t* pData, uint32_t length);
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _APP_OTA_AGENT_H */
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,193 @@
+/*******************************************************************************
+  MPLAB Harmony Application Source File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_ota_writer.c
+
+  Summary:
+    This file contains the streaming writer of firmware images.
+
+  Description:
+    Blocks must arrive in order; the stream is a request/response protocol, so
+    a block that does not follow the last one is dropped and requested again.
+    A buffer turns full at a sector boundary or at the end of the image, and
+    is programmed while the next one fills. Only sectors reported as written
+    advance the committed offset, which is where a download resumes after a
+    reconnect or a reset. The sector after it may hold anything and is erased
+    again before it is written.
+ *******************************************************************************/
+
+#include <string.h>
+#include "app_ota_writer.h"
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Local Functions
+// *****************************************************************************
+// *****************************************************************************
+
+static uint8_t writerNext(uint8_t index)
+{
+    return (index + 1) % APP_OTA_WRITER_NUM_BUFFERS;
+}
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Application Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+
+void APP_OTA_WriterInit(APP_OTA_WRITER* pWriter, const APP_OTA_FLASH* pFlash, uint8_t* pBuffers,
+                        uint32_t imageSize, uint32_t resumeOffset)
+{
+    uint8_t i;
+
+    memset(pWriter, 0, sizeof(APP_OTA_WRITER));
+    pWriter->pFlash = pFlash;
+    for(i = 0; i < APP_OTA_WRITER_NUM_BUFFERS; i++)
+    {
+        pWriter->buffer[i].pData = pBuffers + i * APP_OTA_WRITER_SECTOR_SIZE;
+    }
+    if(resumeOffset > imageSize)
+    {
+        resumeOffset = imageSize;
+    }
+    /* The sector holding the resume point was not confirmed, start it over */
+    if(resumeOffset < imageSize)
+    {
+        resumeOffset -= resumeOffset % APP_OTA_WRITER_SECTOR_SIZE;
+    }
+    pWriter->imageSize = imageSize;
+    pWriter->received = resumeOffset;
+    pWriter->committed = resumeOffset;
+}
+
+APP_OTA_WRITER_STATUS APP_OTA_WriterBlockPut(APP_OTA_WRITER* pWriter, uint32_t offset,
+                                             const uint8_t* pData, uint32_t length)
+{
+    APP_OTA_WRITER_BUFFER* pBuffer;
+    uint32_t skip, n;
+
+    if(pWriter->failed || offset > pWriter->imageSize || length > pWriter->imageSize - offset)
+    {
+        return APP_OTA_WRITER_ERROR;
+    }
+    if(offset + length <= pWriter->received)
+    {
+        /* Answer to a request sent twice */
+        return APP_OTA_WRITER_OK;
+    }
+    if(offset > pWriter->received)
+    {
+        pWriter->nOutOfOrder++;
+        return APP_OTA_WRITER_OUT_OF_ORDER;
+    }
+    skip = pWriter->received - offset;
+    pData += skip;
+    length -= skip;
+    if(length > APP_OTA_WriterRoom(pWriter))
+    {
+        pWriter->nBusy++;
+        return APP_OTA_WRITER_BUSY;
+    }
+
+    while(length)
+    {
+        pBuffer = &pWriter->buffer[pWriter->fill];
+        if(pBuffer->state == APP_OTA_WRITER_BUFFER_FREE)
+        {
+            pBuffer->state = APP_OTA_WRITER_BUFFER_FILLING;
+            pBuffer->offset = pWriter->received;
+            pBuffer->length = 0;
+        }
+        n = APP_OTA_WRITER_SECTOR_SIZE - pBuffer->length;
+        if(n > length)
+        {
+            n = length;
+        }
+        memcpy(pBuffer->pData + pBuffer->length, pData, n);
+        pBuffer->length += n;
+        pWriter->received += n;
+        pData += n;
+        length -= n;
+        if(pBuffer->length == APP_OTA_WRITER_SECTOR_SIZE || pWriter->received == pWriter->imageSize)
+        {
+            pBuffer->state = APP_OTA_WRITER_BUFFER_FULL;
+            pWriter->fill = writerNext(pWriter->fill);
+        }
+    }
+    return APP_OTA_WRITER_OK;
+}
+
+void APP_OTA_WriterTasks(APP_OTA_WRITER* pWriter)
+{
+    APP_OTA_WRITER_BUFFER* pBuffer = &pWriter->buffer[pWriter->write];
+    int8_t status;
+
+    if(pWriter->failed)
+    {
+        return;
+    }
+    if(pBuffer->state == APP_OTA_WRITER_BUFFER_WRITING)
+    {
+        status = pWriter->pFlash->status(pWriter->pFlash->context);
+        if(status > 0)
+        {
+            return;
+        }
+        if(status < 0)
+        {
+            pWriter->failed = true;
+            return;
+        }
+        pWriter->committed = pBuffer->offset + pBuffer->length;
+        pWriter->nSectors++;
+        pBuffer->state = APP_OTA_WRITER_BUFFER_FREE;
+        pWriter->write = writerNext(pWriter->write);
+        pBuffer = &pWriter->buffer[pWriter->write];
+    }
+    if(pBuffer->state == APP_OTA_WRITER_BUFFER_FULL)
+    {
+        /* The tail of the last sector reads as erased flash */
+        memset(pBuffer->pData + pBuffer->length, 0xFF, APP_OTA_WRITER_SECTOR_SIZE - pBuffer->length);
+        if(pWriter->pFlash->sectorWrite(pWriter->pFlash->context, pBuffer->offset, pBuffer->pData))
+        {
+            pBuffer->state = APP_OTA_WRITER_BUFFER_WRITING;
+        }
+    }
+}
+
+uint32_t APP_OTA_WriterRoom(const APP_OTA_WRITER* pWriter)
+{
+    uint32_t room = 0;
+    uint8_t i;
+
+    for(i = 0; i < APP_OTA_WRITER_NUM_BUFFERS; i++)
+    {
+        if(pWriter->buffer[i].state == APP_OTA_WRITER_BUFFER_FREE)
+        {
+            room += APP_OTA_WRITER_SECTOR_SIZE;
+        }
+        else if(pWriter->buffer[i].state == APP_OTA_WRITER_BUFFER_FILLING)
+        {
+            room += APP_OTA_WRITER_SECTOR_SIZE - pWriter->buffer[i].length;
+        }
+    }
+    if(room > pWriter->imageSize - pWriter->received)
+    {
+        room = pWriter->imageSize - pWriter->received;
+    }
+    return room;
+}
+
+bool APP_OTA_WriterDone(const APP_OTA_WRITER* pWriter)
+{
+    return !pWriter->failed && pWriter->committed == pWriter->imageSize;
+}
+
+/*******************************************************************************
+ End of File
+ */
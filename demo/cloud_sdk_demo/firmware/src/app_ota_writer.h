@@ -0,0 +1,128 @@
+/*******************************************************************************
+  MPLAB Harmony Application Header File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_ota_writer.h
+
+  Summary:
+    This header file provides prototypes and definitions for the image writer.
+
+  Description:
+    This header file provides function prototypes and data type definitions for
+    the streaming writer of firmware images. Blocks are gathered in one of two
+    sector buffers while the other one is being programmed, so that receiving
+    overlaps the flash writes without holding the image in RAM. The flash is
+    reached through APP_OTA_FLASH; the writer has no other dependency, which
+    lets it run on a host against a simulated flash.
+*******************************************************************************/
+
+#ifndef _APP_OTA_WRITER_H
+#define _APP_OTA_WRITER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+// *****************************************************************************
+
+/* Erase unit of the flash, and size of each buffer */
+#define APP_OTA_WRITER_SECTOR_SIZE      4096
+#define APP_OTA_WRITER_NUM_BUFFERS      2
+
+// *****************************************************************************
+
+typedef enum
+{
+    /* Taken, or a duplicate of data already taken */
+    APP_OTA_WRITER_OK=0,
+    /* Not the next offset; request it again */
+    APP_OTA_WRITER_OUT_OF_ORDER,
+    /* Both buffers are full, the block is dropped */
+    APP_OTA_WRITER_BUSY,
+    /* Beyond the image, or a flash write failed */
+    APP_OTA_WRITER_ERROR
+} APP_OTA_WRITER_STATUS;
+
+typedef enum
+{
+    APP_OTA_WRITER_BUFFER_FREE=0,
+    APP_OTA_WRITER_BUFFER_FILLING,
+    APP_OTA_WRITER_BUFFER_FULL,
+    APP_OTA_WRITER_BUFFER_WRITING
+} APP_OTA_WRITER_BUFFER_STATE;
+
+/* Flash access. Sector writes are asynchronous, one at a time */
+typedef struct
+{
+    /* Erase the sector at offset in the slot and program it; false if the
+     * request cannot be queued now */
+    bool (*sectorWrite)(void* context, uint32_t offset, const uint8_t* pSector);
+    /* Status of the last sector write: 1 busy, 0 done, -1 failed */
+    int8_t (*status)(void* context);
+    void* context;
+} APP_OTA_FLASH;
+
+typedef struct
+{
+    uint8_t* pData;
+    uint32_t offset;
+    uint32_t length;
+    APP_OTA_WRITER_BUFFER_STATE state;
+} APP_OTA_WRITER_BUFFER;
+
+typedef struct
+{
+    const APP_OTA_FLASH* pFlash;
+    APP_OTA_WRITER_BUFFER buffer[APP_OTA_WRITER_NUM_BUFFERS];
+    /* Buffer being filled, and the one to program next */
+    uint8_t fill;
+    uint8_t write;
+    uint32_t imageSize;
+    /* Next offset expected from the stream */
+    uint32_t received;
+    /* Everything before this offset is in the flash */
+    uint32_t committed;
+    bool failed;
+    /* Statistics */
+    uint32_t nSectors;
+    uint32_t nOutOfOrder;
+    uint32_t nBusy;
+} APP_OTA_WRITER;
+
+// *****************************************************************************
+
+/* Start at resumeOffset, rounded down to a sector; pBuffers are
+ * APP_OTA_WRITER_NUM_BUFFERS sectors reachable by the flash driver */
+void APP_OTA_WriterInit(APP_OTA_WRITER* pWriter, const APP_OTA_FLASH* pFlash, uint8_t* pBuffers,
+                        uint32_t imageSize, uint32_t resumeOffset);
+APP_OTA_WRITER_STATUS APP_OTA_WriterBlockPut(APP_OTA_WRITER* pWriter, uint32_t offset,
+                                             const uint8_t* pData, uint32_t length);
+/* Hand full buffers to the flash and collect finished writes */
+void APP_OTA_WriterTasks(APP_OTA_WRITER* pWriter);
+/* Bytes that can be taken right now without a buffer turning busy */
+uint32_t APP_OTA_WriterRoom(const APP_OTA_WRITER* pWriter);
+/* The whole image is in the flash */
+bool APP_OTA_WriterDone(const APP_OTA_WRITER* pWriter);
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _APP_OTA_WRITER_H */
+
+/*******************************************************************************
+ End of File
+ */
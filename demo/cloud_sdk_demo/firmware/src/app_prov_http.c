@@ -0,0 +1,282 @@
+/*******************************************************************************
+  MPLAB Harmony Application Source File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_prov_http.c
+
+  Summary:
+    This file contains the source code for the provisioning HTTP parser.
+
+  Description:
+    A request is parsed in place in its buffer. The blank line ending the
+    headers is looked for in the bytes added since the last call only; once
+    it is there the request line and the two headers the server cares about
+    (Content-Length and Connection) are parsed, and the request is complete
+    when Content-Length bytes of body follow. The bytes after it belong to the
+    next request on the same connection and are kept for it.
+ *******************************************************************************/
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include "app_prov_http.h"
+
+// *****************************************************************************
+
+static bool nameMatches(const char* line, const char* name)
+{
+    size_t len = strlen(name);
+
+    return 0 == strncasecmp(line, name, len) && ':' == line[len];
+}
+
+static const char* headerValue(const char* line)
+{
+    line = strchr(line, ':') + 1;
+    while (' ' == *line || '\t' == *line)
+        line++;
+    return line;
+}
+
+static int hexDigit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    c = tolower((unsigned char) c);
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+static const char* statusText(int status)
+{
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 409: return "Conflict";
+        case 413: return "Payload Too Large";
+        case 503: return "Service Unavailable";
+        default: return "Error";
+    }
+}
+
+/* Split the request line and the headers, now that all of them are in */
+static APP_PROV_HTTP_PARSE_RESULT parseHeaders(APP_PROV_HTTP_REQUEST* pReq)
+{
+    char* line = pReq->buf;
+    char* headers;
+    char* next;
+    char* p;
+    long value;
+
+    /* Lines are NUL terminated in place, the blank line included */
+    for (p = pReq->buf; p < pReq->buf + pReq->headerLen; p++) {
+        if ('\r' == *p || '\n' == *p)
+            *p = '\0';
+    }
+    headers = line + strlen(line) + 1;
+
+    /* METHOD SP path[?query] SP HTTP/1.x */
+    p = strchr(line, ' ');
+    if (NULL == p)
+        return APP_PROV_HTTP_PARSE_BAD_REQUEST;
+    *p++ = '\0';
+    if (0 == strcmp(line, "GET"))
+        pReq->method = APP_PROV_HTTP_METHOD_GET;
+    else if (0 == strcmp(line, "POST"))
+        pReq->method = APP_PROV_HTTP_METHOD_POST;
+    else
+        pReq->method = APP_PROV_HTTP_METHOD_OTHER;
+    pReq->path = p;
+    p = strchr(p, ' ');
+    if (NULL == p || 0 != strncmp(p + 1, "HTTP/1.", 7))
+        return APP_PROV_HTTP_PARSE_BAD_REQUEST;
+    *p++ = '\0';
+    /* Persistent by default from HTTP/1.1 on */
+    pReq->keepAlive = ('0' != p[7]);
+    p = strchr(pReq->path, '?');
+    if (p) {
+        *p++ = '\0';
+        pReq->query = p;
+    } else
+        pReq->query = "";
+
+    for (line = headers; line < pReq->buf + pReq->headerLen; line = next) {
+        next = line + strlen(line) + 1;
+        if ('\0' == *line)
+            continue;
+        if (nameMatches(line, "Content-Length")) {
+            value = strtol(headerValue(line), &p, 10);
+            if (value < 0 || p == headerValue(line))
+                return APP_PROV_HTTP_PARSE_BAD_REQUEST;
+            if (value > APP_PROV_HTTP_MAX_REQUEST - pReq->headerLen)
+                return APP_PROV_HTTP_PARSE_TOO_LARGE;
+            pReq->contentLength = (uint16_t) value;
+        } else if (nameMatches(line, "Connection")) {
+            if (0 == strncasecmp(headerValue(line), "close", 5))
+                pReq->keepAlive = false;
+            else if (0 == strncasecmp(headerValue(line), "keep-alive", 10))
+                pReq->keepAlive = true;
+        }
+    }
+    return APP_PROV_HTTP_PARSE_MORE;
+}
+
+// *****************************************************************************
+
+void APP_PROV_HTTP_RequestInit(APP_PROV_HTTP_REQUEST* pReq)
+{
+    memset(pReq, 0, sizeof(*pReq));
+}
+
+/* Free space at the end of the buffer, for the caller to read the socket into */
+char* APP_PROV_HTTP_RequestTail(APP_PROV_HTTP_REQUEST* pReq, uint16_t* pSpace)
+{
+    *pSpace = APP_PROV_HTTP_MAX_REQUEST - pReq->len;
+    return &pReq->buf[pReq->len];
+}
+
+/* nBytes were appended at the tail. DONE once a whole request is in; the
+ * fields stay valid until APP_PROV_HTTP_RequestNext */
+APP_PROV_HTTP_PARSE_RESULT APP_PROV_HTTP_RequestFeed(APP_PROV_HTTP_REQUEST* pReq, uint16_t nBytes)
+{
+    APP_PROV_HTTP_PARSE_RESULT res;
+    char* end;
+
+    pReq->len += nBytes;
+    pReq->buf[pReq->len] = '\0';
+
+    if (0 == pReq->headerLen) {
+        /* The terminator may straddle the previous and the new bytes */
+        pReq->scanPos = (pReq->scanPos > 3) ? (pReq->scanPos - 3) : 0;
+        end = strstr(&pReq->buf[pReq->scanPos], "\r\n\r\n");
+        if (NULL == end) {
+            pReq->scanPos = pReq->len;
+            return (pReq->len >= APP_PROV_HTTP_MAX_REQUEST) ? APP_PROV_HTTP_PARSE_TOO_LARGE : APP_PROV_HTTP_PARSE_MORE;
+        }
+        pReq->headerLen = (uint16_t)(end - pReq->buf) + 4;
+        res = parseHeaders(pReq);
+        if (APP_PROV_HTTP_PARSE_MORE != res)
+            return res;
+    }
+
+    if (pReq->len < pReq->headerLen + pReq->contentLength)
+        return APP_PROV_HTTP_PARSE_MORE;
+
+    pReq->body = &pReq->buf[pReq->headerLen];
+    pReq->bodyEnd = pReq->buf[pReq->headerLen + pReq->contentLength];
+    pReq->buf[pReq->headerLen + pReq->contentLength] = '\0';
+    return APP_PROV_HTTP_PARSE_DONE;
+}
+
+/* Drop the request just handled and keep what followed it. Feed with 0 bytes
+ * to parse a pipelined request already in the buffer */
+void APP_PROV_HTTP_RequestNext(APP_PROV_HTTP_REQUEST* pReq)
+{
+    uint16_t used = pReq->headerLen + pReq->contentLength;
+
+    if (0 == pReq->headerLen || used > pReq->len) {
+        APP_PROV_HTTP_RequestInit(pReq);
+        return;
+    }
+    pReq->buf[used] = pReq->bodyEnd;
+    pReq->len -= used;
+    memmove(pReq->buf, &pReq->buf[used], pReq->len);
+    pReq->buf[pReq->len] = '\0';
+    pReq->scanPos = 0;
+    pReq->headerLen = 0;
+    pReq->contentLength = 0;
+    pReq->method = APP_PROV_HTTP_METHOD_OTHER;
+    pReq->path = pReq->query = pReq->body = NULL;
+    pReq->keepAlive = false;
+}
+
+/* URL-decoded value of 'name' in an application/x-www-form-urlencoded
+ * string. Returns its length, or -1 if it is missing or does not fit */
+int APP_PROV_HTTP_FormField(const char* form, const char* name, char* value, size_t valueSize)
+{
+    size_t nameLen = strlen(name);
+    size_t n = 0;
+    int hi, lo;
+
+    while (*form) {
+        if (0 == strncmp(form, name, nameLen) && '=' == form[nameLen]) {
+            for (form += nameLen + 1; *form && '&' != *form; form++) {
+                if (n + 1 >= valueSize)
+                    return -1;
+                if ('+' == *form)
+                    value[n++] = ' ';
+                else if ('%' == *form && (hi = hexDigit(form[1])) >= 0 && (lo = hexDigit(form[2])) >= 0) {
+                    value[n++] = (char)((hi << 4) | lo);
+                    form += 2;
+                } else
+                    value[n++] = *form;
+            }
+            value[n] = '\0';
+            return (int) n;
+        }
+        form = strchr(form, '&');
+        if (NULL == form)
+            break;
+        form++;
+    }
+    return -1;
+}
+
+/* 'src' as a quoted JSON string. Returns the length written, or -1 if it does not fit */
+int APP_PROV_HTTP_JsonString(char* dst, size_t dstSize, const uint8_t* src, size_t srcLen)
+{
+    size_t n = 0;
+    size_t i;
+    int len;
+
+    if (dstSize < 3)
+        return -1;
+    dst[n++] = '"';
+    for (i = 0; i < srcLen; i++) {
+        if ('"' == src[i] || '\\' == src[i]) {
+            if (n + 2 >= dstSize)
+                return -1;
+            dst[n++] = '\\';
+            dst[n++] = src[i];
+        } else if (src[i] < 0x20) {
+            len = snprintf(&dst[n], dstSize - n, "\\u%04x", src[i]);
+            if (len < 0 || n + len + 1 >= dstSize)
+                return -1;
+            n += len;
+        } else {
+            if (n + 1 >= dstSize)
+                return -1;
+            dst[n++] = src[i];
+        }
+    }
+    if (n + 1 >= dstSize)
+        return -1;
+    dst[n++] = '"';
+    dst[n] = '\0';
+    return (int) n;
+}
+
+int APP_PROV_HTTP_ResponseHeader(char* dst, size_t dstSize, int status, const char* contentType, size_t contentLength, bool keepAlive)
+{
+    int len = snprintf(dst, dstSize,
+            "HTTP/1.1 %d %s\r\n"
+            "Content-Type: %s\r\n"
+            "Content-Length: %u\r\n"
+            "Cache-Control: no-store\r\n"
+            "Connection: %s\r\n\r\n",
+            status, statusText(status), contentType, (unsigned) contentLength,
+            keepAlive ? "keep-alive" : "close");
+
+    return (len < 0 || (size_t) len >= dstSize) ? -1 : len;
+}
+
+/*******************************************************************************
+ End of File
+ */
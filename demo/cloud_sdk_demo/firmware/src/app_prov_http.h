@@ -0,0 +1,98 @@
+/*******************************************************************************
+  MPLAB Harmony Application Header File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_prov_http.h
+
+  Summary:
+    This header file provides prototypes and definitions for the application.
+
+  Description:
+    This header file provides function prototypes and data type definitions for
+    the HTTP/1.1 request parser of the provisioning server. Bytes are appended
+    to a request as they arrive from the socket and the parser picks up where
+    it stopped, so a request split over several segments, or several requests
+    in one segment, are handled the same way. It has no dependency on the
+    TCP/IP stack or the RTOS and builds on a host as well.
+*******************************************************************************/
+
+#ifndef _APP_PROV_HTTP_H
+#define _APP_PROV_HTTP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+// *****************************************************************************
+
+/* Request line, headers and body together */
+#define APP_PROV_HTTP_MAX_REQUEST       640
+
+// *****************************************************************************
+
+typedef enum
+{
+    APP_PROV_HTTP_PARSE_MORE=0,
+    APP_PROV_HTTP_PARSE_DONE,
+    APP_PROV_HTTP_PARSE_BAD_REQUEST,
+    APP_PROV_HTTP_PARSE_TOO_LARGE
+} APP_PROV_HTTP_PARSE_RESULT;
+
+typedef enum
+{
+    APP_PROV_HTTP_METHOD_OTHER=0,
+    APP_PROV_HTTP_METHOD_GET,
+    APP_PROV_HTTP_METHOD_POST
+} APP_PROV_HTTP_METHOD;
+
+typedef struct
+{
+    char buf[APP_PROV_HTTP_MAX_REQUEST + 1];
+    uint16_t len;
+    /* Where the search for the end of the headers resumes */
+    uint16_t scanPos;
+    /* 0 until the blank line ending the headers has been received */
+    uint16_t headerLen;
+    uint16_t contentLength;
+    /* First byte after the body, saved while the body is NUL terminated */
+    char bodyEnd;
+    /* Parsed fields, pointing into buf */
+    APP_PROV_HTTP_METHOD method;
+    const char* path;
+    const char* query;
+    const char* body;
+    bool keepAlive;
+} APP_PROV_HTTP_REQUEST;
+
+// *****************************************************************************
+
+void APP_PROV_HTTP_RequestInit( APP_PROV_HTTP_REQUEST* pReq );
+char* APP_PROV_HTTP_RequestTail( APP_PROV_HTTP_REQUEST* pReq, uint16_t* pSpace );
+APP_PROV_HTTP_PARSE_RESULT APP_PROV_HTTP_RequestFeed( APP_PROV_HTTP_REQUEST* pReq, uint16_t nBytes );
+void APP_PROV_HTTP_RequestNext( APP_PROV_HTTP_REQUEST* pReq );
+int APP_PROV_HTTP_FormField( const char* form, const char* name, char* value, size_t valueSize );
+int APP_PROV_HTTP_JsonString( char* dst, size_t dstSize, const uint8_t* src, size_t srcLen );
+int APP_PROV_HTTP_ResponseHeader( char* dst, size_t dstSize, int status, const char* contentType, size_t contentLength, bool keepAlive );
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _APP_PROV_HTTP_H */
+
+/*******************************************************************************
+ End of File
+ */
@@ -27,6 +27,12 @@
 // *****************************************************************************
 WIFI_SLEEP_MODE wifiPsMode = WIFI_WON;
 
+/* Power-save governor, see app_ps_policy.c */
+static APP_PS_POLICY psPolicy;
+static bool psLinkUp;
+/* The mode last handed to the driver is no longer known to be in effect */
+static bool psModeStale;
+
 // *****************************************************************************
 
 
@@ -225,6 +231,90 @@ void APP_SetSleepMode(uint8_t val)
     }
 }
 
+// *****************************************************************************
+
+static uint32_t psNowMs(void)
+{
+    return APP_CounterToMs(SYS_TIME_Counter64Get());
+}
+
+void APP_PS_Governor_Initialize(void)
+{
+    APP_PS_PolicyInit(&psPolicy, 0, 0);
+    psLinkUp = false;
+    psModeStale = true;
+}
+
+/* Uplink periods of the cloud application */
+void APP_PS_GovernorConfigure(uint32_t publishPeriodMs, uint32_t keepAliveMs)
+{
+    taskENTER_CRITICAL();
+    psPolicy.publishPeriodMs = publishPeriodMs;
+    psPolicy.keepAliveMs = keepAliveMs;
+    taskEXIT_CRITICAL();
+}
+
+/* Traffic event, from any task or MQTT callback */
+void APP_PS_GovernorNotify(APP_PS_EVENT event)
+{
+    uint32_t now = psNowMs();
+
+    taskENTER_CRITICAL();
+    APP_PS_PolicyEvent(&psPolicy, event, now);
+    taskEXIT_CRITICAL();
+}
+
+/* The listen interval and inactivity limit are only taken before BSSConnect */
+void APP_PS_GovernorConnect(DRV_HANDLE wdrvHandle)
+{
+    uint16_t listen, inact;
+
+    taskENTER_CRITICAL();
+    listen = APP_PS_PolicyListenInterval(&psPolicy);
+    inact = APP_PS_PolicySleepInactLimit(&psPolicy);
+    taskEXIT_CRITICAL();
+
+    if (WDRV_PIC32MZW_STATUS_OK != WDRV_PIC32MZW_PowerSaveListenIntervalSet(wdrvHandle, listen))
+        APP_PS_DBG(SYS_ERROR_ERROR, "Listen interval not set\r\n");
+    if (inact && WDRV_PIC32MZW_STATUS_OK != WDRV_PIC32MZW_PowerSaveSleepInactLimitSet(wdrvHandle, inact))
+        APP_PS_DBG(SYS_ERROR_ERROR, "Sleep inactivity limit not set\r\n");
+    APP_PS_DBG(SYS_ERROR_DEBUG, "Listen interval %d, inactivity limit %d beacons\r\n", listen, inact);
+}
+
+void APP_PS_Governor_Tasks(void)
+{
+    APP_PS_RADIO_MODE mode;
+    bool changed;
+
+    if (APP_MODE_STA != appData.appMode)
+        return;
+
+    if (WIFI_IS_CONNECTED != psLinkUp) {
+        psLinkUp = WIFI_IS_CONNECTED;
+        APP_PS_GovernorNotify(psLinkUp ? APP_PS_EV_LINK_UP : APP_PS_EV_LINK_DOWN);
+        if (psLinkUp)
+            WDRV_PIC32MZW_PowerSaveBroadcastTrackingSet(appData.wdrvHandle, true);
+        psModeStale = true;
+    }
+    if (!psLinkUp)
+        return;
+
+    taskENTER_CRITICAL();
+    changed = APP_PS_PolicyUpdate(&psPolicy, psNowMs());
+    mode = psPolicy.mode;
+    taskEXIT_CRITICAL();
+
+    if (changed || psModeStale) {
+        if (WDRV_PIC32MZW_STATUS_OK == WDRV_PIC32MZW_PowerSaveModeSet(appData.wdrvHandle,
+                (WDRV_PIC32MZW_POWERSAVE_MODE)mode,
+                WDRV_PIC32MZW_POWERSAVE_PIC_ASYNC_MODE,
+                NULL)) {
+            APP_PS_DBG(SYS_ERROR_DEBUG, "Wi-Fi power-save mode %d\r\n", mode);
+            psModeStale = false;
+        }
+    }
+}
+
 /*******************************************************************************
  End of File
  */
@@ -26,6 +26,8 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include "definitions.h"
+#include "app_ps_policy.h"
+#include "app_log.h"
 // DOM-IGNORE-BEGIN
 #ifdef __cplusplus  // Provide C++ Compatibility
 
@@ -36,8 +38,8 @@ extern "C" {
 
 // *****************************************************************************
 
-#define APP_PS_DBG(level,fmt,...) SYS_DEBUG_PRINT(level,"[APP_PS] "fmt, ##__VA_ARGS__)
-#define APP_PS_PRNT(fmt,...) SYS_CONSOLE_PRINT("[APP_PS] "fmt, ##__VA_ARGS__)
+#define APP_PS_DBG(level,fmt,...) APP_LOG_DBG(APP_LOG_MODULE_PS,level,"[APP_PS] "fmt, ##__VA_ARGS__)
+#define APP_PS_PRNT(fmt,...) APP_LOG_PRNT(APP_LOG_MODULE_PS,"[APP_PS] "fmt, ##__VA_ARGS__)
 
 // *****************************************************************************
     
@@ -53,6 +55,11 @@ typedef enum {
 // *****************************************************************************
 
 void APP_SetSleepMode(uint8_t);
+void APP_PS_Governor_Initialize( void );
+void APP_PS_GovernorConfigure( uint32_t publishPeriodMs, uint32_t keepAliveMs );
+void APP_PS_GovernorNotify( APP_PS_EVENT event );
+void APP_PS_GovernorConnect( DRV_HANDLE wdrvHandle );
+void APP_PS_Governor_Tasks( void );
 
 #endif /* _APP_PS_H */
 
@@ -0,0 +1,243 @@
+/*******************************************************************************
+  MPLAB Harmony Application Source File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_ps_policy.c
+
+  Summary:
+    This file contains the source code for the Wi-Fi power-save policy.
+
+  Description:
+    The radio used to be put in WSM once at connect with the driver default
+    listen interval, whatever the MQTT traffic looked like. This policy picks
+    the power-save mode from the traffic it is told about:
+      - run mode during TLS handshakes, shadow exchanges and right after a
+        downlink message, when latency matters more than current;
+      - WDS when the uplink is sparse and the downlink quiet, WSM otherwise;
+    and sizes the listen interval and the sleep inactivity limit from the
+    publish and keepalive periods, so that the radio does not wake for
+    beacons more often than the application talks anyway.
+
+    Only standard C is used here; test/app_tests_ps.c replays traffic traces
+    through the policy on a host and bounds the resulting radio duty cycle.
+ *******************************************************************************/
+
+#include <string.h>
+#include "app_ps_policy.h"
+
+/* Radio-on cost model used by the simulation (ms) */
+#define APP_PS_SIM_STEP_MS          10
+#define APP_PS_SIM_BEACON_ON_MS     2
+#define APP_PS_SIM_WDS_WAKE_MS      3
+#define APP_PS_SIM_TX_ON_MS         8
+#define APP_PS_SIM_RX_ON_MS         4
+
+// *****************************************************************************
+
+/* a is at or after b, across the 32-bit ms wrap */
+static bool timeReached(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) >= 0;
+}
+
+static void holdRun(APP_PS_POLICY* pPolicy, uint32_t nowMs, uint32_t holdMs)
+{
+    if (!pPolicy->holdActive || timeReached(nowMs + holdMs, pPolicy->holdUntil)) {
+        pPolicy->holdUntil = nowMs + holdMs;
+        pPolicy->holdActive = true;
+    }
+}
+
+static void uplink(APP_PS_POLICY* pPolicy, uint32_t nowMs)
+{
+    uint32_t interval;
+
+    if (pPolicy->uplinkSeen) {
+        interval = nowMs - pPolicy->lastUplink;
+        pPolicy->uplinkIntervalMs = pPolicy->uplinkIntervalMs ?
+                (pPolicy->uplinkIntervalMs * 3 + interval) / 4 : interval;
+    }
+    pPolicy->lastUplink = nowMs;
+    pPolicy->uplinkSeen = true;
+}
+
+/* Shortest period at which the application talks to the AP anyway */
+static uint32_t uplinkPeriod(const APP_PS_POLICY* pPolicy)
+{
+    uint32_t period = pPolicy->keepAliveMs;
+
+    if (pPolicy->publishPeriodMs && (!period || pPolicy->publishPeriodMs < period))
+        period = pPolicy->publishPeriodMs;
+    if (pPolicy->uplinkIntervalMs && (!period || pPolicy->uplinkIntervalMs < period))
+        period = pPolicy->uplinkIntervalMs;
+    return period;
+}
+
+// *****************************************************************************
+
+void APP_PS_PolicyInit(APP_PS_POLICY* pPolicy, uint32_t publishPeriodMs, uint32_t keepAliveMs)
+{
+    memset(pPolicy, 0, sizeof(*pPolicy));
+    pPolicy->publishPeriodMs = publishPeriodMs;
+    pPolicy->keepAliveMs = keepAliveMs;
+    pPolicy->mode = APP_PS_RADIO_RUN;
+}
+
+void APP_PS_PolicyEvent(APP_PS_POLICY* pPolicy, APP_PS_EVENT event, uint32_t nowMs)
+{
+    switch (event) {
+        case APP_PS_EV_LINK_UP:
+            pPolicy->linkUp = true;
+            pPolicy->rxWindowStart = nowMs;
+            pPolicy->rxCount = 0;
+            break;
+        case APP_PS_EV_LINK_DOWN:
+            pPolicy->linkUp = false;
+            pPolicy->tlsActive = false;
+            pPolicy->holdActive = false;
+            pPolicy->uplinkSeen = false;
+            break;
+        case APP_PS_EV_PUBLISH:
+        case APP_PS_EV_KEEPALIVE:
+            uplink(pPolicy, nowMs);
+            break;
+        case APP_PS_EV_RX:
+            pPolicy->rxCount++;
+            holdRun(pPolicy, nowMs, APP_PS_POLICY_RX_HOLD_MS);
+            break;
+        case APP_PS_EV_TLS_START:
+            pPolicy->tlsActive = true;
+            pPolicy->tlsStart = nowMs;
+            break;
+        case APP_PS_EV_TLS_END:
+            pPolicy->tlsActive = false;
+            break;
+        case APP_PS_EV_BURST:
+            holdRun(pPolicy, nowMs, APP_PS_POLICY_BURST_HOLD_MS);
+            break;
+        default:
+            break;
+    }
+}
+
+/* Re-evaluate the mode. Returns true when it changed */
+bool APP_PS_PolicyUpdate(APP_PS_POLICY* pPolicy, uint32_t nowMs)
+{
+    APP_PS_RADIO_MODE mode;
+    uint32_t period;
+
+    if (timeReached(nowMs, pPolicy->rxWindowStart + APP_PS_POLICY_RX_WINDOW_MS)) {
+        pPolicy->rxPerMin = (pPolicy->rxPerMin + pPolicy->rxCount) / 2;
+        pPolicy->rxCount = 0;
+        pPolicy->rxWindowStart = nowMs;
+    }
+    if (pPolicy->tlsActive && timeReached(nowMs, pPolicy->tlsStart + APP_PS_POLICY_TLS_TMO_MS))
+        pPolicy->tlsActive = false;
+    if (pPolicy->holdActive && timeReached(nowMs, pPolicy->holdUntil))
+        pPolicy->holdActive = false;
+
+    period = uplinkPeriod(pPolicy);
+    if (!pPolicy->linkUp || pPolicy->tlsActive || pPolicy->holdActive)
+        mode = APP_PS_RADIO_RUN;
+    else if (period >= APP_PS_POLICY_WDS_MIN_INTERVAL_MS
+            && pPolicy->rxPerMin < APP_PS_POLICY_WDS_MAX_RX_PER_MIN)
+        mode = APP_PS_RADIO_WDS;
+    else
+        mode = APP_PS_RADIO_WSM;
+
+    if (mode == pPolicy->mode)
+        return false;
+    pPolicy->mode = mode;
+    return true;
+}
+
+/* Beacons between two wakeups: the radio is up for the uplink at least once
+ * per period anyway, and frames buffered by the AP wait no longer than that.
+ * A busy downlink gets the shortest interval */
+uint16_t APP_PS_PolicyListenInterval(const APP_PS_POLICY* pPolicy)
+{
+    uint32_t listen;
+
+    if (pPolicy->rxPerMin >= APP_PS_POLICY_WDS_MAX_RX_PER_MIN * 10)
+        return APP_PS_POLICY_LISTEN_MIN;
+    if (!uplinkPeriod(pPolicy))
+        return APP_PS_POLICY_LISTEN_MAX;
+    listen = uplinkPeriod(pPolicy) / APP_PS_POLICY_BEACON_MS;
+    if (listen < APP_PS_POLICY_LISTEN_MIN)
+        listen = APP_PS_POLICY_LISTEN_MIN;
+    if (listen > APP_PS_POLICY_LISTEN_MAX)
+        listen = APP_PS_POLICY_LISTEN_MAX;
+    return (uint16_t)listen;
+}
+
+/* The keepalive already keeps the AP from dropping us; only send NULL frames
+ * when one and a half keepalive periods went by without traffic. 0 keeps the
+ * driver default */
+uint16_t APP_PS_PolicySleepInactLimit(const APP_PS_POLICY* pPolicy)
+{
+    uint32_t limit;
+
+    if (!pPolicy->keepAliveMs)
+        return 0;
+    limit = (pPolicy->keepAliveMs + pPolicy->keepAliveMs / 2) / APP_PS_POLICY_BEACON_MS;
+    return (limit > 0xFFFF) ? 0xFFFF : (uint16_t)limit;
+}
+
+/* Replay 'pTrace' through a fresh policy and estimate the radio duty cycle */
+void APP_PS_PolicySimulate(const APP_PS_TRACE_ENTRY* pTrace, size_t nEntries, uint32_t durationMs,
+                           uint32_t publishPeriodMs, uint32_t keepAliveMs, APP_PS_SIM_RESULT* pResult)
+{
+    APP_PS_POLICY policy;
+    uint64_t onUs = 0;
+    uint32_t t;
+    uint16_t listen;
+    size_t ix = 0;
+
+    memset(pResult, 0, sizeof(*pResult));
+    APP_PS_PolicyInit(&policy, publishPeriodMs, keepAliveMs);
+    listen = APP_PS_PolicyListenInterval(&policy);
+
+    for (t = 0; t < durationMs; t += APP_PS_SIM_STEP_MS) {
+        for (; ix < nEntries && pTrace[ix].timeMs <= t; ix++) {
+            /* Association parameters are only taken at connect */
+            if (APP_PS_EV_LINK_UP == pTrace[ix].event)
+                listen = APP_PS_PolicyListenInterval(&policy);
+            if (APP_PS_EV_PUBLISH == pTrace[ix].event || APP_PS_EV_KEEPALIVE == pTrace[ix].event)
+                onUs += APP_PS_SIM_TX_ON_MS * 1000;
+            if (APP_PS_EV_RX == pTrace[ix].event)
+                onUs += APP_PS_SIM_RX_ON_MS * 1000;
+            APP_PS_PolicyEvent(&policy, pTrace[ix].event, pTrace[ix].timeMs);
+        }
+        if (APP_PS_PolicyUpdate(&policy, t))
+            pResult->modeChanges++;
+
+        switch (policy.mode) {
+            case APP_PS_RADIO_RUN:
+                pResult->runMs += APP_PS_SIM_STEP_MS;
+                onUs += APP_PS_SIM_STEP_MS * 1000;
+                break;
+            case APP_PS_RADIO_WSM:
+                pResult->wsmMs += APP_PS_SIM_STEP_MS;
+                onUs += (uint64_t)APP_PS_SIM_STEP_MS * APP_PS_SIM_BEACON_ON_MS * 1000
+                        / ((uint32_t)listen * APP_PS_POLICY_BEACON_MS);
+                break;
+            case APP_PS_RADIO_WDS:
+                pResult->wdsMs += APP_PS_SIM_STEP_MS;
+                onUs += (uint64_t)APP_PS_SIM_STEP_MS * (APP_PS_SIM_BEACON_ON_MS + APP_PS_SIM_WDS_WAKE_MS) * 1000
+                        / ((uint32_t)listen * APP_PS_POLICY_BEACON_MS);
+                break;
+        }
+    }
+
+    pResult->radioOnMs = (uint32_t)(onUs / 1000);
+    if (pResult->radioOnMs > durationMs)
+        pResult->radioOnMs = durationMs;
+    pResult->dutyPermille = durationMs ? (uint16_t)((uint64_t)pResult->radioOnMs * 1000 / durationMs) : 0;
+}
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,143 @@
+/*******************************************************************************
+  MPLAB Harmony Application Header File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_ps_policy.h
+
+  Summary:
+    This header file provides prototypes and definitions for the application.
+
+  Description:
+    This header file provides function prototypes and data type definitions for
+    the Wi-Fi power-save policy. The policy is plain C with no driver or RTOS
+    dependency: it is fed timestamped traffic events and tells which radio
+    mode, listen interval and sleep inactivity limit to use. app_ps.c applies
+    its decisions to the driver; the same code can be replayed on a host
+    against a recorded event trace, see APP_PS_PolicySimulate.
+*******************************************************************************/
+
+#ifndef _APP_PS_POLICY_H
+#define _APP_PS_POLICY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+// *****************************************************************************
+
+/* Beacon interval assumed for the listen interval and inactivity limit (ms) */
+#define APP_PS_POLICY_BEACON_MS             102
+/* Listen interval bounds (beacons); 10 is the driver default */
+#define APP_PS_POLICY_LISTEN_MIN            1
+#define APP_PS_POLICY_LISTEN_MAX            10
+/* Stay in run mode this long after a downlink message, replies tend to follow */
+#define APP_PS_POLICY_RX_HOLD_MS            500
+/* ...and this long after each message of a shadow exchange */
+#define APP_PS_POLICY_BURST_HOLD_MS         1500
+/* A TLS handshake never keeps the radio in run mode longer than this */
+#define APP_PS_POLICY_TLS_TMO_MS            15000
+/* Use WDS rather than WSM when the uplink is quieter than this */
+#define APP_PS_POLICY_WDS_MIN_INTERVAL_MS   5000
+/* ...and fewer downlink messages than this arrive per minute */
+#define APP_PS_POLICY_WDS_MAX_RX_PER_MIN    2
+/* Downlink rate window */
+#define APP_PS_POLICY_RX_WINDOW_MS          60000
+
+// *****************************************************************************
+
+typedef enum
+{
+    APP_PS_EV_LINK_UP=0,
+    APP_PS_EV_LINK_DOWN,
+    /* Uplink MQTT PUBLISH */
+    APP_PS_EV_PUBLISH,
+    /* Uplink MQTT PINGREQ */
+    APP_PS_EV_KEEPALIVE,
+    /* Downlink MQTT PUBLISH */
+    APP_PS_EV_RX,
+    APP_PS_EV_TLS_START,
+    APP_PS_EV_TLS_END,
+    /* Message of a shadow exchange, in either direction */
+    APP_PS_EV_BURST
+} APP_PS_EVENT;
+
+/* Same values as WDRV_PIC32MZW_POWERSAVE_MODE */
+typedef enum
+{
+    APP_PS_RADIO_RUN=0,
+    APP_PS_RADIO_WSM,
+    APP_PS_RADIO_WDS
+} APP_PS_RADIO_MODE;
+
+typedef struct
+{
+    /* Configured uplink periods; 0 if unknown */
+    uint32_t publishPeriodMs;
+    uint32_t keepAliveMs;
+    bool linkUp;
+    bool tlsActive;
+    uint32_t tlsStart;
+    /* Run mode is held until then */
+    uint32_t holdUntil;
+    bool holdActive;
+    /* Observed interval between uplink messages, 0 until two were seen */
+    uint32_t uplinkIntervalMs;
+    uint32_t lastUplink;
+    bool uplinkSeen;
+    /* Downlink messages per minute, averaged over windows */
+    uint16_t rxPerMin;
+    uint16_t rxCount;
+    uint32_t rxWindowStart;
+    APP_PS_RADIO_MODE mode;
+} APP_PS_POLICY;
+
+/* Replay input: one event at timeMs, in increasing time order */
+typedef struct
+{
+    uint32_t timeMs;
+    APP_PS_EVENT event;
+} APP_PS_TRACE_ENTRY;
+
+typedef struct
+{
+    uint32_t runMs;
+    uint32_t wsmMs;
+    uint32_t wdsMs;
+    uint32_t modeChanges;
+    /* Estimated time the radio was awake, and its share of the trace */
+    uint32_t radioOnMs;
+    uint16_t dutyPermille;
+} APP_PS_SIM_RESULT;
+
+// *****************************************************************************
+
+void APP_PS_PolicyInit( APP_PS_POLICY* pPolicy, uint32_t publishPeriodMs, uint32_t keepAliveMs );
+void APP_PS_PolicyEvent( APP_PS_POLICY* pPolicy, APP_PS_EVENT event, uint32_t nowMs );
+bool APP_PS_PolicyUpdate( APP_PS_POLICY* pPolicy, uint32_t nowMs );
+uint16_t APP_PS_PolicyListenInterval( const APP_PS_POLICY* pPolicy );
+uint16_t APP_PS_PolicySleepInactLimit( const APP_PS_POLICY* pPolicy );
+void APP_PS_PolicySimulate( const APP_PS_TRACE_ENTRY* pTrace, size_t nEntries, uint32_t durationMs,
+                            uint32_t publishPeriodMs, uint32_t keepAliveMs, APP_PS_SIM_RESULT* pResult );
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _APP_PS_POLICY_H */
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,238 @@
+/*******************************************************************************
+  MPLAB Harmony Application Source File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_roam.c
+
+  Summary:
+    This file contains the source code for the STA link-quality monitor.
+
+  Description:
+    The STA used to stay with whichever AP answered first for the configured
+    SSID. This task samples the association RSSI and the MAC transmit backlog,
+    and when the link degrades it runs a passive background scan for the same
+    SSID. If another BSS is better by a margin, the WLAN task is asked to move
+    to it while keeping the IP configuration, so that the MQTT connection rides
+    through the switch. Scans back off while nothing better is around.
+ *******************************************************************************/
+#include <string.h>
+#include "app.h"
+#include "app_roam.h"
+#include "app_common.h"
+#include "system/console/sys_console.h"
+#include "tcpip/tcpip_manager.h"
+
+// *****************************************************************************
+
+static void avgUpdate(int16_t *pAvg, int32_t sample)
+{
+    *pAvg += (sample * APP_ROAM_AVG_SCALE - *pAvg) / APP_ROAM_AVG_WEIGHT;
+}
+
+static bool txBacklogGet(uint32_t *pBacklog)
+{
+    TCPIP_MAC_TX_STATISTICS txStats;
+
+    if (!TCPIP_STACK_NetMACStatisticsGet(TCPIP_STACK_IndexToNet(0), NULL, &txStats))
+        return false;
+    *pBacklog = txStats.nTxPendBuffers;
+    return true;
+}
+
+/* Called by the driver for each BSS found; keeps the strongest other BSS of our SSID */
+static bool scanCallback(DRV_HANDLE handle, uint8_t index, uint8_t ofTotal, WDRV_PIC32MZW_BSS_INFO *pBSSInfo)
+{
+    APP_ROAM_CANDIDATE *pCand = &appRoamData.candidate;
+    size_t ssidLen = strnlen((const char*)wifi.ssid, sizeof(wifi.ssid));
+
+    if (0 == ofTotal || NULL == pBSSInfo) {
+        appRoamData.scanDone = true;
+        return false;
+    }
+
+    if (pBSSInfo->ctx.ssid.length == ssidLen
+            && 0 == memcmp(pBSSInfo->ctx.ssid.name, wifi.ssid, ssidLen)
+            && pBSSInfo->ctx.bssid.valid
+            && 0 != memcmp(pBSSInfo->ctx.bssid.addr, appRoamData.currentBssid, WDRV_PIC32MZW_MAC_ADDR_LEN)
+            && (!pCand->valid || pBSSInfo->rssi > pCand->rssi)) {
+        memcpy(pCand->bssid, pBSSInfo->ctx.bssid.addr, WDRV_PIC32MZW_MAC_ADDR_LEN);
+        pCand->channel = pBSSInfo->ctx.channel;
+        pCand->rssi = pBSSInfo->rssi;
+        pCand->valid = true;
+    }
+
+    if (index >= ofTotal) {
+        appRoamData.scanDone = true;
+        return false;
+    }
+    return true;
+}
+
+// *****************************************************************************
+
+void APP_ROAM_Initialize(void)
+{
+    memset(&appRoamData, 0, sizeof(appRoamData));
+    appRoamData.state = APP_ROAM_STATE_INIT;
+    appRoamData.scanInterval = APP_ROAM_SCAN_INTERVAL_MIN_S;
+}
+
+void APP_ROAM_Tasks(void)
+{
+    WDRV_PIC32MZW_MAC_ADDR bssid;
+    WDRV_PIC32MZW_STATUS status;
+    uint32_t backlog;
+    int8_t rssi;
+    int16_t rssiCur;
+
+    if (APP_MODE_STA != appData.appMode)
+        return;
+
+    switch (appRoamData.state) {
+        /* Wait for an association and note which BSS it is */
+        case APP_ROAM_STATE_INIT:
+        {
+            if (!WIFI_IS_CONNECTED || appData.roaming)
+                break;
+            status = WDRV_PIC32MZW_AssocPeerAddressGet((WDRV_PIC32MZW_ASSOC_HANDLE)appData.assocHandle, &bssid);
+            if (WDRV_PIC32MZW_STATUS_OK != status || !bssid.valid)
+                break;
+            memcpy(appRoamData.currentBssid, bssid.addr, WDRV_PIC32MZW_MAC_ADDR_LEN);
+            appRoamData.rssiSeeded = false;
+            appRoamData.txBacklogAvg = 0;
+            appRoamData.sampleTimeStamp = 0;
+            appRoamData.scanTimeStamp = SYS_TIME_Counter64Get();
+            appRoamData.state = APP_ROAM_STATE_MONITOR;
+            break;
+        }
+
+        /* Sample the link and decide whether to look around */
+        case APP_ROAM_STATE_MONITOR:
+        {
+            if (!WIFI_IS_CONNECTED) {
+                appRoamData.state = APP_ROAM_STATE_INIT;
+                break;
+            }
+            if (appRoamData.sampleTimeStamp && APP_MsSince(appRoamData.sampleTimeStamp) < APP_ROAM_SAMPLE_PERIOD_MS)
+                break;
+            appRoamData.sampleTimeStamp = SYS_TIME_Counter64Get();
+
+            if (WDRV_PIC32MZW_STATUS_OK == WDRV_PIC32MZW_AssocRSSIGet((WDRV_PIC32MZW_ASSOC_HANDLE)appData.assocHandle, &rssi, NULL)) {
+                appRoamData.rssiLast = rssi;
+                if (!appRoamData.rssiSeeded) {
+                    appRoamData.rssiAvg = rssi * APP_ROAM_AVG_SCALE;
+                    appRoamData.rssiSeeded = true;
+                } else {
+                    avgUpdate(&appRoamData.rssiAvg, rssi);
+                }
+            }
+            if (txBacklogGet(&backlog))
+                avgUpdate(&appRoamData.txBacklogAvg, backlog);
+
+            if (!appRoamData.rssiSeeded)
+                break;
+            if ((appRoamData.rssiAvg < APP_ROAM_RSSI_TRIGGER * APP_ROAM_AVG_SCALE
+                    || appRoamData.txBacklogAvg >= APP_ROAM_TX_BACKLOG_TRIGGER * APP_ROAM_AVG_SCALE)
+                    && APP_MsSince(appRoamData.scanTimeStamp) >= appRoamData.scanInterval * 1000) {
+                appRoamData.state = APP_ROAM_STATE_SCAN;
+            }
+            break;
+        }
+
+        /* Passive scan for the same SSID, without leaving the association */
+        case APP_ROAM_STATE_SCAN:
+        {
+            appRoamData.candidate.valid = false;
+            appRoamData.scanDone = false;
+            appRoamData.scanTimeStamp = SYS_TIME_Counter64Get();
+            WDRV_PIC32MZW_BSSFindSetScanParameters(appData.wdrvHandle, 0, 0, APP_ROAM_PASSIVE_SLOT_MS, 0);
+            status = WDRV_PIC32MZW_BSSFindFirst(appData.wdrvHandle, WDRV_PIC32MZW_CID_ANY, false, NULL, scanCallback);
+            if (WDRV_PIC32MZW_STATUS_OK == status) {
+                appRoamData.nScans++;
+                appRoamData.state = APP_ROAM_STATE_WAIT_SCAN;
+            } else {
+                APP_ROAM_DBG(SYS_ERROR_DEBUG, "Background scan not started (%d)\r\n", status);
+                appRoamData.state = APP_ROAM_STATE_MONITOR;
+            }
+            break;
+        }
+
+        case APP_ROAM_STATE_WAIT_SCAN:
+        {
+            if (!appRoamData.scanDone && APP_MsSince(appRoamData.scanTimeStamp) < APP_ROAM_SCAN_TMO_S * 1000)
+                break;
+            if (!WIFI_IS_CONNECTED) {
+                appRoamData.state = APP_ROAM_STATE_INIT;
+                break;
+            }
+
+            rssiCur = appRoamData.rssiAvg / APP_ROAM_AVG_SCALE;
+            if (appRoamData.candidate.valid
+                    && appRoamData.candidate.rssi >= rssiCur + APP_ROAM_RSSI_HYSTERESIS) {
+                APP_ROAM_PRNT("Roaming to %02x:%02x:%02x:%02x:%02x:%02x (ch %d, %d dBm); current %d dBm, tx backlog %d\r\n",
+                        appRoamData.candidate.bssid[0], appRoamData.candidate.bssid[1], appRoamData.candidate.bssid[2],
+                        appRoamData.candidate.bssid[3], appRoamData.candidate.bssid[4], appRoamData.candidate.bssid[5],
+                        appRoamData.candidate.channel, appRoamData.candidate.rssi, rssiCur,
+                        appRoamData.txBacklogAvg / APP_ROAM_AVG_SCALE);
+                if (APP_WlanRoam(appRoamData.candidate.bssid, appRoamData.candidate.channel)) {
+                    appRoamData.roamTimeStamp = SYS_TIME_Counter64Get();
+                    appRoamData.nRoams++;
+                    appRoamData.scanInterval = APP_ROAM_SCAN_INTERVAL_MIN_S;
+                    appRoamData.state = APP_ROAM_STATE_ROAMING;
+                    break;
+                }
+            } else {
+                APP_ROAM_DBG(SYS_ERROR_INFO, "No better BSS (best %d dBm, current %d dBm)\r\n",
+                        appRoamData.candidate.valid ? appRoamData.candidate.rssi : 0, rssiCur);
+                appRoamData.scanInterval *= 2;
+                if (appRoamData.scanInterval > APP_ROAM_SCAN_INTERVAL_MAX_S)
+                    appRoamData.scanInterval = APP_ROAM_SCAN_INTERVAL_MAX_S;
+            }
+            appRoamData.state = APP_ROAM_STATE_MONITOR;
+            break;
+        }
+
+        /* The WLAN task is switching BSS */
+        case APP_ROAM_STATE_ROAMING:
+        {
+            if (appData.roaming)
+                break;
+            if (!WIFI_IS_CONNECTED) {
+                /* The WLAN task fell back to its regular reconnect */
+                APP_ROAM_PRNT("Roam failed after %lu ms\r\n", (unsigned long) APP_MsSince(appRoamData.roamTimeStamp));
+                appRoamData.state = APP_ROAM_STATE_INIT;
+                break;
+            }
+            appRoamData.lastLinkMs = APP_MsSince(appRoamData.roamTimeStamp);
+            APP_ROAM_PRNT("Associated with the new BSS after %lu ms\r\n", (unsigned long) appRoamData.lastLinkMs);
+            appRoamData.state = APP_ROAM_STATE_RECOVERING;
+            break;
+        }
+
+        /* Throughput is back once the frames queued during the switch are gone */
+        case APP_ROAM_STATE_RECOVERING:
+        {
+            if (!WIFI_IS_CONNECTED) {
+                appRoamData.state = APP_ROAM_STATE_INIT;
+                break;
+            }
+            if ((txBacklogGet(&backlog) && 0 == backlog)
+                    || APP_MsSince(appRoamData.roamTimeStamp) >= APP_ROAM_SCAN_INTERVAL_MIN_S * 1000) {
+                appRoamData.lastRecoverMs = APP_MsSince(appRoamData.roamTimeStamp);
+                APP_ROAM_PRNT("Traffic recovered %lu ms after the roam decision\r\n", (unsigned long) appRoamData.lastRecoverMs);
+                appRoamData.state = APP_ROAM_STATE_INIT;
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,118 @@
+/*******************************************************************************
+  MPLAB Harmony Application Header File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_roam.h
+
+  Summary:
+    This header file provides prototypes and definitions for the application.
+
+  Description:
+    This header file provides function prototypes and data type definitions for
+    the STA link-quality monitor. It tracks the RSSI and the transmit backlog of
+    the current association, looks for a better BSS of the same SSID with
+    passive background scans, and asks the WLAN task to roam to it.
+*******************************************************************************/
+
+#ifndef _APP_ROAM_H
+#define _APP_ROAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include "configuration.h"
+#include "wdrv_pic32mzw_common.h"
+#include "app_log.h"
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+/* Debug wrappers */
+#define APP_ROAM_DBG(level,fmt,...) APP_LOG_DBG(APP_LOG_MODULE_ROAM,level,"[APP_ROAM] "fmt,##__VA_ARGS__)
+#define APP_ROAM_PRNT(fmt,...) APP_LOG_PRNT(APP_LOG_MODULE_ROAM,"[APP_ROAM] "fmt, ##__VA_ARGS__)
+
+// *****************************************************************************
+
+#define APP_ROAM_SAMPLE_PERIOD_MS       2000
+/* Averages are kept in 1/APP_ROAM_AVG_SCALE units, new samples weigh 1/APP_ROAM_AVG_WEIGHT */
+#define APP_ROAM_AVG_SCALE              16
+#define APP_ROAM_AVG_WEIGHT             4
+/* Look for another BSS below this RSSI (dBm)... */
+#define APP_ROAM_RSSI_TRIGGER           -72
+/* ...or while this many frames are stuck in the transmit queue on average */
+#define APP_ROAM_TX_BACKLOG_TRIGGER     6
+/* A candidate must beat the current BSS by this much (dB) */
+#define APP_ROAM_RSSI_HYSTERESIS        8
+/* Background scan pacing: doubles after each scan that found nothing better */
+#define APP_ROAM_SCAN_INTERVAL_MIN_S    30
+#define APP_ROAM_SCAN_INTERVAL_MAX_S    480
+#define APP_ROAM_SCAN_TMO_S             5
+/* Passive dwell per channel; a bit over one 102.4 ms beacon interval */
+#define APP_ROAM_PASSIVE_SLOT_MS        110
+
+// *****************************************************************************
+
+typedef enum
+{
+    APP_ROAM_STATE_INIT=0,
+    APP_ROAM_STATE_MONITOR,
+    APP_ROAM_STATE_SCAN,
+    APP_ROAM_STATE_WAIT_SCAN,
+    APP_ROAM_STATE_ROAMING,
+    APP_ROAM_STATE_RECOVERING
+} APP_ROAM_STATES;
+
+typedef struct
+{
+    uint8_t bssid[WDRV_PIC32MZW_MAC_ADDR_LEN];
+    WDRV_PIC32MZW_CHANNEL_ID channel;
+    int8_t rssi;
+    bool valid;
+} APP_ROAM_CANDIDATE;
+
+typedef struct
+{
+    APP_ROAM_STATES state;
+    int16_t rssiAvg;
+    int16_t txBacklogAvg;
+    int8_t rssiLast;
+    bool rssiSeeded;
+    uint64_t sampleTimeStamp;
+    uint64_t scanTimeStamp;
+    uint32_t scanInterval;
+    uint8_t currentBssid[WDRV_PIC32MZW_MAC_ADDR_LEN];
+    volatile bool scanDone;
+    APP_ROAM_CANDIDATE candidate;
+    uint64_t roamTimeStamp;
+    uint32_t nScans;
+    uint32_t nRoams;
+    uint32_t lastLinkMs;
+    uint32_t lastRecoverMs;
+} APP_ROAM_DATA;
+APP_ROAM_DATA appRoamData;
+
+// *****************************************************************************
+
+void APP_ROAM_Initialize( void );
+void APP_ROAM_Tasks( void );
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _APP_ROAM_H */
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,412 @@
+/*******************************************************************************
+  MPLAB Harmony Application Source File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_shadow.c
+
+  Summary:
+    This file contains the source code for the device shadow.
+
+  Description:
+    The Shadow library subscribes to the delta topic and, kept for the whole
+    connection, to the accepted/rejected topics of the update and get
+    operations; the update/documents topic and the wildcard are not used.
+    When the MQTT session was resumed, the delta and get topics are only
+    registered with the new connection: the broker still holds them.
+    A get after each connect gives the reported state the service holds and
+    any delta missed while offline. Documents are scanned in place with the
+    AWS IoT document parser, and deltas older than the newest shadow version
+    seen are dropped. An update carries the fields whose value differs from
+    the one last accepted, with a client token matching it to its answer.
+ *******************************************************************************/
+
+// *****************************************************************************
+
+#ifdef AWS_CLOUD_DEMO
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "iot_config.h"
+#include "app_common.h"
+#include "app_aws.h"
+#include "app_shadow.h"
+#include "app_ps.h"
+#include "aws_iot_shadow.h"
+#include "aws_iot_doc_parser.h"
+
+// *****************************************************************************
+
+/* Keys of the reported state, by APP_SHADOW_FIELD */
+static const char* const fieldNames[APP_SHADOW_FIELD_MAX] = {
+    "toggle"
+};
+
+// *****************************************************************************
+
+/* A JSON integer or boolean, as returned by the document parser */
+static bool numberParse(const char* pValue, size_t valueLength, long* pNumber)
+{
+    char buf[12];
+    char* pEnd;
+
+    if (4 == valueLength && 0 == strncmp(pValue, "true", 4)) {
+        *pNumber = 1;
+        return true;
+    }
+    if (5 == valueLength && 0 == strncmp(pValue, "false", 5)) {
+        *pNumber = 0;
+        return true;
+    }
+    if (0 == valueLength || valueLength >= sizeof(buf))
+        return false;
+    memcpy(buf, pValue, valueLength);
+    buf[valueLength] = '\0';
+    *pNumber = strtol(buf, &pEnd, 10);
+    return ('\0' == *pEnd);
+}
+
+/* Look up a member of a JSON object, or a dotted path of them, and parse its
+ * value as a number */
+static bool keyParse(const char* pObject, size_t objectLength, const char* pKey, long* pNumber)
+{
+    const char* pValue;
+    size_t valueLength;
+
+    if (!AwsIotDocParser_FindPath(pObject, objectLength, pKey, strlen(pKey), &pValue, &valueLength))
+        return false;
+    return numberParse(pValue, valueLength, pNumber);
+}
+
+/* Look up a member of a JSON object, or a dotted path of them, holding an object */
+static bool objectFind(const char* pObject, size_t objectLength, const char* pKey,
+                       const char** ppValue, size_t* pValueLength)
+{
+    return AwsIotDocParser_FindPath(pObject, objectLength, pKey, strlen(pKey), ppValue, pValueLength)
+            && '{' == **ppValue;
+}
+
+// *****************************************************************************
+
+/* Set a field of the device to its desired value */
+static void fieldApply(APP_SHADOW_FIELD field, int32_t value)
+{
+    switch (field) {
+        case APP_SHADOW_FIELD_TOGGLE:
+            if (value) {
+                APP_SHADOW_PRNT("LED ON \r\n");
+                APP_manageLed(LED_YELLOW, LED_S_BLINK_STARTING_ON, BLINK_MODE_SINGLE);
+            } else {
+                APP_SHADOW_PRNT("LED OFF \r\n");
+                APP_manageLed(LED_YELLOW, LED_S_BLINK_STARTING_OFF, BLINK_MODE_SINGLE);
+            }
+            break;
+        default:
+            return;
+    }
+    appShadowData.field[field].value = value;
+}
+
+/* Apply the fields present in the state of a delta */
+static void fieldsApply(const char* pState, size_t stateLength)
+{
+    uint32_t i;
+    long value;
+
+    for (i = 0; i < APP_SHADOW_FIELD_MAX; i++) {
+        if (keyParse(pState, stateLength, fieldNames[i], &value))
+            fieldApply((APP_SHADOW_FIELD) i, (int32_t) value);
+    }
+}
+
+/* Take the reported state held by the service as the diffing base */
+static void fieldsReported(const char* pReported, size_t reportedLength)
+{
+    uint32_t i;
+    long value;
+
+    for (i = 0; i < APP_SHADOW_FIELD_MAX; i++) {
+        if (keyParse(pReported, reportedLength, fieldNames[i], &value)) {
+            appShadowData.field[i].reported = (int32_t) value;
+            appShadowData.field[i].known = true;
+        }
+    }
+}
+
+/* Deltas and the get answer may overtake each other; only a document newer
+ * than any seen on this connection is applied. Documents without a version
+ * are taken as they come */
+static bool versionCheck(const char* pDocument, size_t documentLength)
+{
+    long version;
+
+    if (!keyParse(pDocument, documentLength, "version", &version))
+        return true;
+    if (0 != appShadowData.version && (uint32_t) version <= appShadowData.version) {
+        appShadowData.nStale++;
+        APP_SHADOW_DBG(SYS_ERROR_INFO, "Version %ld not newer than %lu, dropped \r\n",
+                       version, (unsigned long) appShadowData.version);
+        return false;
+    }
+    appShadowData.version = (uint32_t) version;
+    return true;
+}
+
+// *****************************************************************************
+
+/* Desired state differs from the reported one */
+static void deltaCallback(void* pCallbackContext, AwsIotShadowCallbackParam_t* pCallbackParam)
+{
+    const char* pDocument = pCallbackParam->u.callback.pDocument;
+    size_t documentLength = pCallbackParam->u.callback.documentLength;
+    const char* pState;
+    size_t stateLength;
+
+    APP_PS_GovernorNotify(APP_PS_EV_RX);
+    appShadowData.nDeltas++;
+    APP_SHADOW_DBG(SYS_ERROR_DEBUG, "Delta: %.*s \r\n", (int) documentLength, pDocument);
+    if (!versionCheck(pDocument, documentLength))
+        return;
+    if (objectFind(pDocument, documentLength, "state", &pState, &stateLength))
+        fieldsApply(pState, stateLength);
+    /* Keep the radio up until the reported state went out */
+    APP_PS_GovernorNotify(APP_PS_EV_BURST);
+}
+
+/* Answer to the get sent after the connect */
+static void getCallback(void* pCallbackContext, AwsIotShadowCallbackParam_t* pCallbackParam)
+{
+    AwsIotShadowError_t result = pCallbackParam->u.operation.result;
+    const char* pDocument = pCallbackParam->u.operation.get.pDocument;
+    size_t documentLength = pCallbackParam->u.operation.get.documentLength;
+    const char* pObject;
+    size_t objectLength;
+    bool newer;
+
+    APP_PS_GovernorNotify(APP_PS_EV_RX);
+    if (AWS_IOT_SHADOW_SUCCESS == result) {
+        newer = versionCheck(pDocument, documentLength);
+        if (objectFind(pDocument, documentLength, "state.reported", &pObject, &objectLength))
+            fieldsReported(pObject, objectLength);
+        if (newer && objectFind(pDocument, documentLength, "state.delta", &pObject, &objectLength))
+            fieldsApply(pObject, objectLength);
+        APP_SHADOW_DBG(SYS_ERROR_INFO, "Shadow version %lu \r\n", (unsigned long) appShadowData.version);
+    }
+    else if (AWS_IOT_SHADOW_NOT_FOUND == result) {
+        /* The first update creates it, with every field */
+        APP_SHADOW_DBG(SYS_ERROR_INFO, "No shadow yet \r\n");
+    }
+    else {
+        APP_SHADOW_DBG(SYS_ERROR_ERROR, "Shadow get failed: %s \r\n", AwsIotShadow_strerror(result));
+    }
+    appShadowData.synced = true;
+}
+
+/* Answer to an update, matched by its client token */
+static void updateCallback(void* pCallbackContext, AwsIotShadowCallbackParam_t* pCallbackParam)
+{
+    uint32_t token = (uint32_t) (uintptr_t) pCallbackContext;
+    AwsIotShadowError_t result = pCallbackParam->u.operation.result;
+    uint32_t i;
+
+    APP_PS_GovernorNotify(APP_PS_EV_RX);
+    /* Given up on already */
+    if (token != appShadowData.token)
+        return;
+    if (AWS_IOT_SHADOW_SUCCESS == result) {
+        for (i = 0; i < APP_SHADOW_FIELD_MAX; i++) {
+            if (appShadowData.inFlight & (1U << i)) {
+                appShadowData.field[i].reported = appShadowData.field[i].sending;
+                appShadowData.field[i].known = true;
+            }
+        }
+        APP_SHADOW_DBG(SYS_ERROR_DEBUG, "Update %lu accepted \r\n", (unsigned long) token);
+    }
+    else {
+        APP_SHADOW_DBG(SYS_ERROR_ERROR, "Update %lu rejected: %s \r\n",
+                       (unsigned long) token, AwsIotShadow_strerror(result));
+        appShadowData.holdOff = true;
+    }
+    appShadowData.token = 0;
+}
+
+// *****************************************************************************
+
+void APP_SHADOW_Initialize(void)
+{
+    memset(&appShadowData, 0, sizeof(appShadowData));
+    appShadowData.mqttConnection = IOT_MQTT_CONNECTION_INITIALIZER;
+    appShadowData.field[APP_SHADOW_FIELD_TOGGLE].value = !LED_YELLOW_Get();
+}
+
+bool APP_SHADOW_Start(IotMqttConnection_t mqttConnection)
+{
+    AwsIotShadowError_t status;
+    AwsIotShadowCallbackInfo_t callbackInfo = AWS_IOT_SHADOW_CALLBACK_INFO_INITIALIZER;
+    AwsIotShadowDocumentInfo_t documentInfo = AWS_IOT_SHADOW_DOCUMENT_INFO_INITIALIZER;
+    size_t thingNameLength = strlen(g_Aws_ClientID);
+    /* A resumed session still holds the subscriptions of the last connection;
+     * they are only registered with this one, no SUBSCRIBE goes out */
+    uint32_t restore = IotMqtt_SessionPresent(mqttConnection) ? AWS_IOT_SHADOW_FLAG_SESSION_RESTORE : 0;
+
+    status = AwsIotShadow_Init(MQTT_TIMEOUT_MS);
+    if (AWS_IOT_SHADOW_SUCCESS != status) {
+        APP_SHADOW_DBG(SYS_ERROR_ERROR, "Shadow init failed: %s \r\n", AwsIotShadow_strerror(status));
+        return false;
+    }
+    appShadowData.started = true;
+    appShadowData.mqttConnection = mqttConnection;
+    appShadowData.synced = false;
+    appShadowData.version = 0;
+    appShadowData.token = 0;
+    appShadowData.holdOff = false;
+    appShadowData.updateTimeStamp = SYS_TIME_Counter64Get();
+
+    callbackInfo.function = deltaCallback;
+    status = AwsIotShadow_SetDeltaCallback(mqttConnection, g_Aws_ClientID, thingNameLength, restore, &callbackInfo);
+    if (AWS_IOT_SHADOW_SUCCESS != status) {
+        APP_SHADOW_DBG(SYS_ERROR_ERROR, "Delta subscription failed: %s \r\n", AwsIotShadow_strerror(status));
+        APP_SHADOW_Stop();
+        return false;
+    }
+
+    documentInfo.pThingName = g_Aws_ClientID;
+    documentInfo.thingNameLength = thingNameLength;
+    documentInfo.qos = IOT_MQTT_QOS_1;
+    documentInfo.retryLimit = PUBLISH_RETRY_LIMIT;
+    documentInfo.retryMs = IOT_MQTT_RETRY_MS_ADAPTIVE;
+    callbackInfo.function = getCallback;
+    status = AwsIotShadow_GetAsync(mqttConnection, &documentInfo, AWS_IOT_SHADOW_FLAG_KEEP_SUBSCRIPTIONS | restore,
+                                   &callbackInfo, NULL);
+    if (AWS_IOT_SHADOW_STATUS_PENDING != status) {
+        APP_SHADOW_DBG(SYS_ERROR_ERROR, "Shadow get failed: %s \r\n", AwsIotShadow_strerror(status));
+        APP_SHADOW_Stop();
+        return false;
+    }
+    return true;
+}
+
+void APP_SHADOW_Stop(void)
+{
+    if (!appShadowData.started)
+        return;
+    /* Frees the subscriptions and the operations still waiting for an
+     * answer; the next connection registers them again */
+    AwsIotShadow_Cleanup();
+    appShadowData.started = false;
+    appShadowData.synced = false;
+    appShadowData.token = 0;
+    appShadowData.mqttConnection = IOT_MQTT_CONNECTION_INITIALIZER;
+}
+
+bool APP_SHADOW_ReportPending(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < APP_SHADOW_FIELD_MAX; i++) {
+        if (!appShadowData.field[i].known || appShadowData.field[i].value != appShadowData.field[i].reported)
+            return true;
+    }
+    return false;
+}
+
+bool APP_SHADOW_Report(void)
+{
+    AwsIotShadowError_t status;
+    AwsIotShadowCallbackInfo_t updateComplete = AWS_IOT_SHADOW_CALLBACK_INFO_INITIALIZER;
+    AwsIotShadowDocumentInfo_t documentInfo = AWS_IOT_SHADOW_DOCUMENT_INFO_INITIALIZER;
+    char pDocument[APP_SHADOW_DOC_MAX_LEN];
+    uint32_t elapsedMs = APP_MsSince(appShadowData.updateTimeStamp);
+    uint32_t i, mask = 0, nFields = 0, token;
+    int32_t value;
+    int len, n;
+
+    if (!appShadowData.started)
+        return true;
+    /* Deltas are applied meanwhile; the first update waits for the reported
+     * state held by the service, unless the get went unanswered */
+    if (!appShadowData.synced && elapsedMs < APP_SHADOW_UPDATE_TMO_MS)
+        return true;
+    if (0 != appShadowData.token) {
+        if (elapsedMs < APP_SHADOW_UPDATE_TMO_MS)
+            return true;
+        APP_SHADOW_DBG(SYS_ERROR_WARNING, "Update %lu not answered, sending again \r\n",
+                       (unsigned long) appShadowData.token);
+        appShadowData.token = 0;
+    }
+    if (appShadowData.holdOff && elapsedMs < APP_SHADOW_UPDATE_TMO_MS)
+        return true;
+
+    len = snprintf(pDocument, sizeof(pDocument), "{\"state\":{\"reported\":{");
+    for (i = 0; i < APP_SHADOW_FIELD_MAX; i++) {
+        value = appShadowData.field[i].value;
+        if (appShadowData.field[i].known && value == appShadowData.field[i].reported)
+            continue;
+        n = snprintf(pDocument + len, sizeof(pDocument) - len, "%s\"%s\":%ld",
+                     mask ? "," : "", fieldNames[i], (long) value);
+        if (n < 0 || n >= (int) sizeof(pDocument) - len) {
+            APP_SHADOW_DBG(SYS_ERROR_ERROR, "Update document too long \r\n");
+            return false;
+        }
+        len += n;
+        appShadowData.field[i].sending = value;
+        mask |= 1U << i;
+        nFields++;
+    }
+    if (0 == mask)
+        return true;
+
+    /* Never 0, which stands for no update in flight */
+    token = ++appShadowData.tokenCounter;
+    if (0 == token)
+        token = ++appShadowData.tokenCounter;
+    n = snprintf(pDocument + len, sizeof(pDocument) - len, "}},\"clientToken\":\"%lu\"}", (unsigned long) token);
+    if (n < 0 || n >= (int) sizeof(pDocument) - len) {
+        APP_SHADOW_DBG(SYS_ERROR_ERROR, "Update document too long \r\n");
+        return false;
+    }
+    len += n;
+
+    documentInfo.pThingName = g_Aws_ClientID;
+    documentInfo.thingNameLength = strlen(g_Aws_ClientID);
+    documentInfo.qos = IOT_MQTT_QOS_1;
+    documentInfo.retryLimit = PUBLISH_RETRY_LIMIT;
+    documentInfo.retryMs = IOT_MQTT_RETRY_MS_ADAPTIVE;
+    documentInfo.u.update.pUpdateDocument = pDocument;
+    documentInfo.u.update.updateDocumentLength = (size_t) len;
+    updateComplete.function = updateCallback;
+    updateComplete.pCallbackContext = (void*) (uintptr_t) token;
+
+    /* Set before the answer can come */
+    appShadowData.inFlight = mask;
+    appShadowData.token = token;
+    appShadowData.holdOff = false;
+    appShadowData.updateTimeStamp = SYS_TIME_Counter64Get();
+    APP_SHADOW_DBG(SYS_ERROR_INFO, "Update %lu: %.*s \r\n", (unsigned long) token, len, pDocument);
+
+    APP_PS_GovernorNotify(APP_PS_EV_BURST);
+    /* The first update subscribes to its answers, the next ones reuse them.
+     * Not restored with a resumed session: the last connection may not have
+     * sent an update, and its answers would then never arrive */
+    status = AwsIotShadow_UpdateAsync(appShadowData.mqttConnection, &documentInfo,
+                                      AWS_IOT_SHADOW_FLAG_KEEP_SUBSCRIPTIONS, &updateComplete, NULL);
+    APP_PS_GovernorNotify(APP_PS_EV_PUBLISH);
+    if (AWS_IOT_SHADOW_STATUS_PENDING != status) {
+        APP_SHADOW_DBG(SYS_ERROR_ERROR, "Shadow update failed: %s \r\n", AwsIotShadow_strerror(status));
+        appShadowData.token = 0;
+        appShadowData.holdOff = true;
+        return false;
+    }
+    appShadowData.nUpdates++;
+    appShadowData.nFieldsSent += nFields;
+    return true;
+}
+
+#endif /* AWS_CLOUD_DEMO */
+
+/*******************************************************************************
+ End of File
+ */
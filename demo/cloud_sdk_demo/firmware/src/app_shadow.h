@@ -0,0 +1,118 @@
+/*******************************************************************************
+  MPLAB Harmony Application Header File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_shadow.h
+
+  Summary:
+    This header file provides prototypes and definitions for the device shadow.
+
+  Description:
+    This header file provides function prototypes and data type definitions for
+    the device shadow, kept through the AWS IoT Shadow library. Desired values
+    arrive as deltas; the reported state is cached with the shadow version so
+    that an update only carries the fields that changed since the service
+    last accepted them.
+*******************************************************************************/
+
+#ifndef _APP_SHADOW_H
+#define _APP_SHADOW_H
+
+#ifdef AWS_CLOUD_DEMO
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "iot_mqtt.h"
+#include "app_log.h"
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+/* Debug wrappers */
+#define APP_SHADOW_DBG(level,fmt,...) APP_LOG_DBG(APP_LOG_MODULE_SHADOW,level,"[APP_SHADOW] "fmt,##__VA_ARGS__)
+#define APP_SHADOW_PRNT(fmt,...) APP_LOG_PRNT(APP_LOG_MODULE_SHADOW,"[APP_SHADOW] "fmt, ##__VA_ARGS__)
+
+// *****************************************************************************
+
+/* Longest update document: every field changed */
+#define APP_SHADOW_DOC_MAX_LEN          128
+/* An update neither accepted nor rejected by then is sent again */
+#define APP_SHADOW_UPDATE_TMO_MS        10000
+
+// *****************************************************************************
+
+/* Fields of the reported state */
+typedef enum
+{
+    APP_SHADOW_FIELD_TOGGLE=0,
+    APP_SHADOW_FIELD_MAX
+} APP_SHADOW_FIELD;
+
+typedef struct
+{
+    /* Value on the device */
+    volatile int32_t value;
+    /* Value last accepted by the service, valid once known */
+    int32_t reported;
+    bool known;
+    /* Value carried by the update in flight */
+    int32_t sending;
+} APP_SHADOW_CACHE_ENTRY;
+
+typedef struct
+{
+    IotMqttConnection_t mqttConnection;
+    /* The Shadow library lives as long as one MQTT connection */
+    bool started;
+    /* The shadow was read after the connect; deltas may still come first */
+    volatile bool synced;
+    /* Version of the newest shadow document seen, 0 until one was */
+    volatile uint32_t version;
+    APP_SHADOW_CACHE_ENTRY field[APP_SHADOW_FIELD_MAX];
+    /* Update in flight: its client token (0 if none), fields and start */
+    volatile uint32_t token;
+    uint32_t tokenCounter;
+    uint32_t inFlight;
+    uint64_t updateTimeStamp;
+    /* A rejected or failed update is not repeated before APP_SHADOW_UPDATE_TMO_MS */
+    volatile bool holdOff;
+    /* Statistics */
+    uint32_t nDeltas;
+    uint32_t nStale;
+    uint32_t nUpdates;
+    uint32_t nFieldsSent;
+} APP_SHADOW_DATA;
+APP_SHADOW_DATA appShadowData;
+
+// *****************************************************************************
+
+void APP_SHADOW_Initialize(void);
+/* Register the delta callback and read the shadow on a new MQTT connection */
+bool APP_SHADOW_Start(IotMqttConnection_t mqttConnection);
+/* The MQTT connection is gone; drops the subscriptions and pending operations */
+void APP_SHADOW_Stop(void);
+/* A field of the reported state changed or was never accepted */
+bool APP_SHADOW_ReportPending(void);
+/* Send the fields that changed; false if the update could not go out */
+bool APP_SHADOW_Report(void);
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* AWS_CLOUD_DEMO */
+#endif /* _APP_SHADOW_H */
+
+/*******************************************************************************
+ End of File
+ */
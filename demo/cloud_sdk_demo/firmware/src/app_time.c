@@ -0,0 +1,297 @@
+/*******************************************************************************
+  MPLAB Harmony Application Source File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_time.c
+
+  Summary:
+    This file contains the source code for the wall-clock time.
+
+  Description:
+    The cloud connection used to wait for the first SNTP answer at every boot,
+    since the TLS certificate dates cannot be checked without the time. The
+    RTCC keeps counting through a software, watchdog or MCLR reset and through
+    deep sleep, only a power loss clears it. So once SNTP has answered, the
+    RTCC is set to UTC and left running, and the SNTP time is stored with the
+    RTCC reading at that moment. The next boot adds the RTCC time elapsed
+    since, corrected for the drift measured between SNTP updates. The result
+    is used for certificate checks as long as its error bound stays small;
+    SNTP then replaces it in the background.
+ *******************************************************************************/
+#include <string.h>
+#include "definitions.h"
+#include "app.h"
+#include "app_common.h"
+#include "app_time.h"
+#include "app_config_store.h"
+#include "system/console/sys_console.h"
+#include "tcpip/sntp.h"
+#include "wolfssl/wolfcrypt/asn_public.h"
+
+// *****************************************************************************
+
+/* Days since 1970-01-01 of a Gregorian date */
+static uint32_t daysFromCivil(uint32_t y, uint32_t m, uint32_t d)
+{
+    uint32_t era, yoe, doy, doe;
+
+    y -= (m <= 2);
+    era = y / 400;
+    yoe = y - era * 400;
+    doy = (153 * ((m > 2) ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static void civilFromDays(uint32_t days, struct tm* t)
+{
+    uint32_t era, doe, yoe, doy, mp, m;
+
+    days += 719468;
+    era = days / 146097;
+    doe = days - era * 146097;
+    yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    mp = (5 * doy + 2) / 153;
+    m = (mp < 10) ? mp + 3 : mp - 9;
+    t->tm_year = yoe + era * 400 + (m <= 2) - 1900;
+    t->tm_mon = m - 1;
+    t->tm_mday = doy - (153 * mp + 2) / 5 + 1;
+}
+
+/* RTCC time in UNIX seconds; 0 if it does not hold a date */
+static uint32_t rtccGet(void)
+{
+    struct tm t;
+
+    /* The PLIB returns the full year and a 0 based month */
+    RTCC_TimeGet(&t);
+    if (t.tm_mon < 0 || t.tm_mon > 11 || t.tm_mday < 1 || t.tm_mday > 31 ||
+            t.tm_hour > 23 || t.tm_min > 59 || t.tm_sec > 59)
+        return 0;
+    return daysFromCivil(t.tm_year, t.tm_mon + 1, t.tm_mday) * 86400
+            + t.tm_hour * 3600 + t.tm_min * 60 + t.tm_sec;
+}
+
+static void rtccSet(uint32_t utc)
+{
+    struct tm t;
+    uint32_t days = utc / 86400;
+    uint32_t sec = utc % 86400;
+
+    memset(&t, 0, sizeof(t));
+    civilFromDays(days, &t);
+    t.tm_wday = (days + 4) % 7;
+    t.tm_hour = sec / 3600;
+    t.tm_min = (sec / 60) % 60;
+    t.tm_sec = sec % 60;
+    RTCC_TimeSet(&t);
+}
+
+/* Time from the RTCC, corrected for its drift since the last SNTP update */
+static bool rtccEstimate(uint32_t* pUtc, uint32_t* pUncertainty)
+{
+    APP_TIME_RECORD *pRec = &appTimeData.record;
+    uint32_t rtcc = rtccGet();
+    uint32_t elapsed;
+    int32_t correction = 0;
+
+    if (!appTimeData.rtccSet || !appTimeData.recordValid || rtcc < pRec->rtccSync)
+        return false;
+    elapsed = rtcc - pRec->rtccSync;
+    if (pRec->driftValid)
+        correction = (int32_t)((int64_t) elapsed * pRec->driftPpm / 1000000);
+    *pUtc = pRec->utcSync + elapsed - correction;
+    *pUncertainty = APP_TIME_RESOLUTION_s + (uint32_t)((uint64_t) elapsed *
+            (pRec->driftValid ? APP_TIME_DRIFT_ERROR_PPM : APP_TIME_RTCC_MAX_DRIFT_PPM) / 1000000);
+    return true;
+}
+
+/* A new SNTP timestamp arrived: measure the drift, keep the RTCC on UTC and
+ * store the new reference */
+static void sntpUpdate(void)
+{
+    APP_TIME_RECORD *pRec = &appTimeData.record;
+    uint32_t utc, ms, rtcc, interval;
+    int32_t measured, estimateError = 0;
+    bool store = !appTimeData.storedThisBoot;
+
+    if (SNTP_RES_TSTAMP_ERROR == TCPIP_SNTP_TimeGet(&utc, &ms))
+        return;
+    rtcc = rtccGet();
+
+    if (APP_TIME_SOURCE_RTCC == appTimeData.source)
+        estimateError = (int32_t)(appTimeData.utcBase - utc +
+                (uint32_t)((SYS_TIME_Counter64Get() - appTimeData.trustedTimeStamp) / SYS_TIME_FrequencyGet()));
+
+    if (!appTimeData.rtccSet || (rtcc > utc ? rtcc - utc : utc - rtcc) > APP_TIME_RTCC_MAX_ERROR_s)
+    {
+        /* Setting the RTCC restarts the drift measurement */
+        rtccSet(utc + (ms >= 500));
+        rtcc = utc;
+        appTimeData.rtccSet = true;
+        pRec->utcAnchor = utc;
+        pRec->rtccAnchor = rtcc;
+        store = true;
+    }
+    else if (!appTimeData.recordValid)
+    {
+        pRec->utcAnchor = utc;
+        pRec->rtccAnchor = rtcc;
+    }
+    else
+    {
+        interval = utc - pRec->utcAnchor;
+        if (interval >= APP_TIME_DRIFT_MIN_INTERVAL_s && interval < 0x80000000)
+        {
+            measured = (int32_t)(((int64_t)(rtcc - pRec->rtccAnchor) - interval) * 1000000 / interval);
+            pRec->driftPpm = pRec->driftValid ? (3 * pRec->driftPpm + measured) / 4 : measured;
+            pRec->driftValid = true;
+            pRec->utcAnchor = utc;
+            pRec->rtccAnchor = rtcc;
+            store = true;
+            APP_TIME_DBG(SYS_ERROR_INFO, "RTCC drift %ld ppm over %lu s, now %ld ppm\r\n",
+                    (long) measured, (unsigned long) interval, (long) pRec->driftPpm);
+        }
+    }
+    pRec->magic = APP_TIME_MAGIC;
+    pRec->utcSync = utc;
+    pRec->rtccSync = rtcc;
+    appTimeData.recordValid = true;
+
+    if (store || utc - appTimeData.utcStored >= APP_TIME_STORE_INTERVAL_s)
+    {
+        if (0 == APP_CONFIG_STORE_SlotWrite(APP_CONFIG_STORE_SLOT_TIME, pRec, sizeof(*pRec)))
+        {
+            appTimeData.utcStored = utc;
+            appTimeData.storedThisBoot = true;
+        }
+    }
+
+    if (0 == appTimeData.nSyncs++)
+    {
+        if (APP_TIME_SOURCE_RTCC == appTimeData.source)
+            APP_TIME_PRNT("SNTP time %lu ms after boot, %lu ms after the RTCC estimate, which was off by %ld s\r\n",
+                    (unsigned long) APP_CounterToMs(SYS_TIME_Counter64Get()),
+                    (unsigned long) APP_MsSince(appTimeData.trustedTimeStamp),
+                    (long) estimateError);
+        else
+            APP_TIME_PRNT("SNTP time %lu ms after boot\r\n", (unsigned long) APP_CounterToMs(SYS_TIME_Counter64Get()));
+    }
+    appTimeData.source = APP_TIME_SOURCE_SNTP;
+    TIME_TRUSTED;
+}
+
+// *****************************************************************************
+
+void APP_TIME_Initialize(void)
+{
+    RCON_RESET_CAUSE resetCause = RCON_ResetCauseGet();
+    uint32_t rtcc = rtccGet();
+
+    memset(&appTimeData, 0, sizeof(appTimeData));
+    appTimeData.state = APP_TIME_STATE_WAIT_STORE;
+    appTimeData.source = APP_TIME_SOURCE_NONE;
+    /* A power-on reset clears the RTCC. The flags are sticky, clear them so
+     * that the next reset is told apart */
+    appTimeData.rtccSet = !(resetCause & (RCON_RESET_CAUSE_POR | RCON_RESET_CAUSE_BOR)) &&
+            rtcc >= APP_TIME_MIN_VALID;
+    RCON_ResetCauseClear((RCON_RESET_CAUSE)(RCON_RESET_CAUSE_POR | RCON_RESET_CAUSE_BOR));
+    TIME_NOT_TRUSTED;
+    /* Certificate dates are checked against APP_TIME_Time */
+    wc_SetTimeCb(APP_TIME_Time);
+}
+
+void APP_TIME_Tasks(void)
+{
+    uint32_t lastUpdate;
+
+    switch (appTimeData.state)
+    {
+        /* The reference of the previous run is in the configuration store */
+        case APP_TIME_STATE_WAIT_STORE:
+        {
+            uint32_t utc, uncertainty;
+
+            if (!APP_CONFIG_STORE_Loaded())
+                break;
+            if (0 == APP_CONFIG_STORE_SlotRead(APP_CONFIG_STORE_SLOT_TIME, &appTimeData.record, sizeof(appTimeData.record)) &&
+                    APP_TIME_MAGIC == appTimeData.record.magic)
+            {
+                appTimeData.recordValid = true;
+                appTimeData.utcStored = appTimeData.record.utcSync;
+            }
+            else
+                memset(&appTimeData.record, 0, sizeof(appTimeData.record));
+
+            if (!appTimeData.rtccSet)
+                APP_TIME_DBG(SYS_ERROR_INFO, "RTCC was reset, waiting for SNTP\r\n");
+            else if (rtccEstimate(&utc, &uncertainty) && uncertainty <= APP_TIME_MAX_UNCERTAINTY_s &&
+                    SNTP_RES_TSTAMP_ERROR == TCPIP_SNTP_TimeStampStatus())
+            {
+                appTimeData.utcBase = utc;
+                appTimeData.uncertainty = uncertainty;
+                appTimeData.trustedTimeStamp = SYS_TIME_Counter64Get();
+                appTimeData.source = APP_TIME_SOURCE_RTCC;
+                TIME_TRUSTED;
+                APP_TIME_PRNT("Time from the RTCC (+/- %lu s), %lu ms after boot\r\n",
+                        (unsigned long) uncertainty, (unsigned long) APP_CounterToMs(SYS_TIME_Counter64Get()));
+            }
+            appTimeData.state = APP_TIME_STATE_RUN;
+            break;
+        }
+
+        case APP_TIME_STATE_RUN:
+        {
+            /* Query on link-up rather than on the next SNTP tick */
+            if (IP_ADDR_IS_OBTAINED && !appTimeData.ipObtained)
+                TCPIP_SNTP_ConnectionInitiate();
+            appTimeData.ipObtained = IP_ADDR_IS_OBTAINED;
+
+            if (SNTP_RES_TSTAMP_ERROR != TCPIP_SNTP_TimeStampGet(NULL, &lastUpdate) &&
+                    (0 == appTimeData.nSyncs || lastUpdate != appTimeData.sntpLastUpdate))
+            {
+                appTimeData.sntpLastUpdate = lastUpdate;
+                sntpUpdate();
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+/* The RTCC holds UTC from a previous run and must not be reset */
+bool APP_TIME_RtccIsSet(void)
+{
+    return appTimeData.rtccSet;
+}
+
+/* UNIX seconds, or 0 while the time is not known */
+uint32_t APP_TIME_UTCSecondsGet(void)
+{
+    if (SNTP_RES_TSTAMP_ERROR != TCPIP_SNTP_TimeStampStatus())
+        return TCPIP_SNTP_UTCSecondsGet();
+    if (APP_TIME_SOURCE_RTCC == appTimeData.source)
+        return appTimeData.utcBase +
+                (uint32_t)((SYS_TIME_Counter64Get() - appTimeData.trustedTimeStamp) / SYS_TIME_FrequencyGet());
+    return 0;
+}
+
+/* wolfCrypt time callback */
+time_t APP_TIME_Time(time_t* timer)
+{
+    time_t sec = (time_t) APP_TIME_UTCSecondsGet();
+
+    if (timer != NULL)
+        *timer = sec;
+    return sec;
+}
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,135 @@
+/*******************************************************************************
+  MPLAB Harmony Application Header File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_time.h
+
+  Summary:
+    This header file provides prototypes and definitions for the application.
+
+  Description:
+    This header file provides function prototypes and data type definitions for
+    the wall-clock time. The RTCC is kept on UTC across resets and deep sleep;
+    the last SNTP time, the RTCC reading at that moment and the measured RTCC
+    drift are kept in the configuration store. At boot they give a time
+    estimate with a bound on its error, which is trusted for certificate
+    checks until SNTP answers.
+*******************************************************************************/
+
+#ifndef _APP_TIME_H
+#define _APP_TIME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <time.h>
+#include "configuration.h"
+#include "app_log.h"
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+/* Debug wrappers */
+#define APP_TIME_DBG(level,fmt,...) APP_LOG_DBG(APP_LOG_MODULE_TIME,level,"[APP_TIME] "fmt,##__VA_ARGS__)
+#define APP_TIME_PRNT(fmt,...) APP_LOG_PRNT(APP_LOG_MODULE_TIME,"[APP_TIME] "fmt, ##__VA_ARGS__)
+
+// *****************************************************************************
+
+#define APP_TIME_MAGIC                  0x544D4501      /* "TME" + record version */
+/* Earliest time the RTCC can hold once set, anything before is a reset RTCC */
+#define APP_TIME_MIN_VALID              1577836800UL    /* 2020-01-01 */
+/* RTCC rate error assumed until it has been measured */
+#define APP_TIME_RTCC_MAX_DRIFT_PPM     20000
+/* Error of the measured drift, plus the seconds lost by the RTCC resolution */
+#define APP_TIME_DRIFT_ERROR_PPM        100
+#define APP_TIME_RESOLUTION_s           2
+/* Drift is measured over at least this long between two SNTP updates */
+#define APP_TIME_DRIFT_MIN_INTERVAL_s   21600
+/* The RTCC is set again once it is this far from the SNTP time. This restarts
+ * the drift measurement, so it is not done for small errors */
+#define APP_TIME_RTCC_MAX_ERROR_s       3600
+/* The estimate is not trusted beyond this error */
+#define APP_TIME_MAX_UNCERTAINTY_s      3600
+/* A new SNTP time is stored at most this often; drift updates are stored at once */
+#define APP_TIME_STORE_INTERVAL_s       86400
+
+// *****************************************************************************
+
+typedef enum
+{
+    APP_TIME_STATE_WAIT_STORE=0,
+    APP_TIME_STATE_RUN
+} APP_TIME_STATES;
+
+typedef enum
+{
+    APP_TIME_SOURCE_NONE=0,
+    APP_TIME_SOURCE_RTCC,
+    APP_TIME_SOURCE_SNTP
+} APP_TIME_SOURCE;
+
+/* Kept in the TIME slot of the configuration store. Times are UNIX seconds */
+typedef struct
+{
+    uint32_t magic;
+    /* Last SNTP time and the RTCC reading at that moment */
+    uint32_t utcSync;
+    uint32_t rtccSync;
+    /* Start of the ongoing drift measurement */
+    uint32_t utcAnchor;
+    uint32_t rtccAnchor;
+    /* RTCC rate error, positive when it runs fast */
+    int32_t driftPpm;
+    bool driftValid;
+} APP_TIME_RECORD;
+
+typedef struct
+{
+    APP_TIME_STATES state;
+    APP_TIME_RECORD record;
+    bool recordValid;
+    /* The RTCC kept running through the reset and is on UTC */
+    bool rtccSet;
+    APP_TIME_SOURCE source;
+    /* Time at trustedTimeStamp, and the bound on its error */
+    uint32_t utcBase;
+    uint32_t uncertainty;
+    uint64_t trustedTimeStamp;
+    /* SNTP update tick of the last timestamp handled */
+    uint32_t sntpLastUpdate;
+    uint32_t nSyncs;
+    /* utcSync of the record last written to the store */
+    uint32_t utcStored;
+    bool storedThisBoot;
+    bool ipObtained;
+} APP_TIME_DATA;
+APP_TIME_DATA appTimeData;
+
+// *****************************************************************************
+
+void APP_TIME_Initialize( void );
+void APP_TIME_Tasks( void );
+bool APP_TIME_RtccIsSet( void );
+uint32_t APP_TIME_UTCSecondsGet( void );
+time_t APP_TIME_Time( time_t* timer );
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _APP_TIME_H */
+
+/*******************************************************************************
+ End of File
+ */
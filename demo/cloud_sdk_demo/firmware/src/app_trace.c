@@ -0,0 +1,183 @@
+/*******************************************************************************
+  MPLAB Harmony Application Source File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_trace.c
+
+  Summary:
+    This file contains the source code for the binary event trace.
+
+  Description:
+    The ring lives in persistent RAM, which the startup code leaves alone on
+    any reset but a power-on. The general exception handler is overridden to
+    record the fault, mark the ring and reset; at the next boot the marked
+    ring is copied out and handed to the MSD task, which writes it to the
+    volume once the file system is up. Flash is not touched from the handler
+    itself since the SST26 driver needs the RTOS.
+ *******************************************************************************/
+#include <string.h>
+#include "app_trace.h"
+#include "definitions.h"
+
+// *****************************************************************************
+
+/* From exceptions.c, whose handler this one replaces */
+#define APP_TRACE_EXCEP_IBE     6U
+extern volatile uint32_t ibe_error_cntr;
+
+/* Not cleared by the startup code */
+APP_TRACE_BUFFER appTraceBuffer __attribute__((persistent, aligned(16)));
+
+// *****************************************************************************
+
+#if defined(APP_TRACE_ENABLED)
+void _general_exception_handler(void)
+{
+    uint32_t cause = (_CP0_GET_CAUSE() & 0x0000007CU) >> 2U;
+    uint32_t address = _CP0_GET_EPC();
+
+    /* The first instruction bus error after a flash erase or a deep sleep
+     * wake up can be a false ECC error; return as exceptions.c does */
+    if (APP_TRACE_EXCEP_IBE == cause && ++ibe_error_cntr <= 1)
+        return;
+
+    appTraceData.enabled = true;
+    APP_TRACE_Event(APP_TRACE_EV_FAULT, cause, address);
+    appTraceBuffer.faultCause = cause;
+    appTraceBuffer.faultAddress = address;
+    appTraceBuffer.magic = APP_TRACE_MAGIC_FAULT;
+    /* The ring is cached; RAM must hold it before the reset */
+    CACHE_DataCacheClean((uint32_t) &appTraceBuffer, sizeof(appTraceBuffer));
+
+#if defined(__DEBUG) || defined(__DEBUG_D) && defined(__XC32)
+    while (true)
+        __builtin_software_breakpoint();
+#elif defined(APP_TRACE_RESET_ON_FAULT)
+    SYSKEY = 0x00000000;
+    SYSKEY = 0xAA996655;
+    SYSKEY = 0x556699AA;
+    RSWRSTbits.SWRST = 1;
+    RSWRST = RSWRSTbits.SWRST;
+    while (true);
+#else
+    while (true);
+#endif
+}
+#endif
+
+// *****************************************************************************
+
+/* Record the state of a task state machine when it changed since the last call */
+void APP_TRACE_StateTrack(APP_TRACE_EVENT event, uint32_t state)
+{
+    if (state == appTraceData.lastState[event])
+        return;
+    APP_TRACE_Event(event, state, appTraceData.lastState[event]);
+    appTraceData.lastState[event] = state;
+}
+
+void APP_TRACE_Clear(void)
+{
+    taskENTER_CRITICAL();
+    memset(appTraceBuffer.ring, 0, sizeof(appTraceBuffer.ring));
+    appTraceBuffer.head = 0;
+    taskEXIT_CRITICAL();
+}
+
+bool APP_TRACE_FaultImageGet(const uint8_t** ppImage, size_t* pSize)
+{
+    *ppImage = appTraceData.pFaultImage;
+    *pSize = appTraceData.faultImageSize;
+    return NULL != appTraceData.pFaultImage;
+}
+
+void APP_TRACE_FaultImageRelease(bool saved)
+{
+    vPortFree(appTraceData.pFaultImage);
+    appTraceData.pFaultImage = NULL;
+    appTraceData.faultImageSize = 0;
+    appTraceData.lastFaultSaved = saved;
+    if (saved)
+        APP_TRACE_PRNT("Trace of the last fault saved to %s\r\n", APP_TRACE_FILE_NAME);
+}
+
+/* Copy the ring of the run that faulted, oldest record first, behind a file header */
+static void faultImageCreate(void)
+{
+    APP_TRACE_FILE_HEADER* pHeader;
+    APP_TRACE_RECORD* pRec;
+    uint32_t head = appTraceBuffer.head;
+    uint32_t n = (head < APP_TRACE_RECORDS) ? head : APP_TRACE_RECORDS;
+    uint32_t i;
+
+    appTraceData.faultImageSize = sizeof(APP_TRACE_FILE_HEADER) + n * sizeof(APP_TRACE_RECORD);
+    appTraceData.pFaultImage = pvPortMalloc(appTraceData.faultImageSize);
+    if (NULL == appTraceData.pFaultImage) {
+        appTraceData.faultImageSize = 0;
+        return;
+    }
+    pHeader = (APP_TRACE_FILE_HEADER*) appTraceData.pFaultImage;
+    pHeader->magic = APP_TRACE_FILE_MAGIC;
+    pHeader->version = APP_TRACE_FILE_VERSION;
+    pHeader->recordSize = sizeof(APP_TRACE_RECORD);
+    /* Core timer ticks at half the CPU clock */
+    pHeader->coreTimerHz = SYS_TIME_CPU_CLOCK_FREQUENCY / 2;
+    pHeader->head = head;
+    pHeader->nRecords = n;
+    pHeader->faultCause = appTraceBuffer.faultCause;
+    pHeader->faultAddress = appTraceBuffer.faultAddress;
+    pHeader->bootCount = appTraceBuffer.bootCount;
+    pRec = (APP_TRACE_RECORD*) (pHeader + 1);
+    for (i = 0; i < n; i++)
+        pRec[i] = appTraceBuffer.ring[(head - n + i) & (APP_TRACE_RECORDS - 1)];
+}
+
+static void syncRecord(uint64_t now)
+{
+    appTraceData.syncTimeStamp = now;
+    APP_TRACE_Event(APP_TRACE_EV_SYNC, (uint32_t) (now / (SYS_TIME_FrequencyGet() / 1000)), 0);
+}
+
+void APP_TRACE_Initialize(void)
+{
+    RCON_RESET_CAUSE resetCause = RCON_ResetCauseGet();
+    bool valid = !(resetCause & RCON_RESET_CAUSE_POR) &&
+            (APP_TRACE_MAGIC == appTraceBuffer.magic || APP_TRACE_MAGIC_FAULT == appTraceBuffer.magic);
+
+    memset(appTraceData.lastState, 0xFF, sizeof(appTraceData.lastState));
+    if (valid && APP_TRACE_MAGIC_FAULT == appTraceBuffer.magic) {
+        appTraceData.lastFaultCause = appTraceBuffer.faultCause;
+        appTraceData.lastFaultAddress = appTraceBuffer.faultAddress;
+        faultImageCreate();
+        APP_TRACE_PRNT("Fault %lu at 0x%08lx in the last run\r\n",
+                (unsigned long) appTraceData.lastFaultCause, (unsigned long) appTraceData.lastFaultAddress);
+    }
+
+    appTraceBuffer.bootCount = valid ? appTraceBuffer.bootCount + 1 : 0;
+    appTraceBuffer.faultCause = appTraceBuffer.faultAddress = 0;
+    memset(appTraceBuffer.ring, 0, sizeof(appTraceBuffer.ring));
+    appTraceBuffer.head = 0;
+    appTraceBuffer.magic = APP_TRACE_MAGIC;
+
+#ifdef APP_TRACE_ENABLED
+    appTraceData.enabled = true;
+#endif
+    APP_TRACE_Event(APP_TRACE_EV_BOOT, resetCause, appTraceBuffer.bootCount);
+    syncRecord(SYS_TIME_Counter64Get());
+}
+
+void APP_TRACE_Tasks(void)
+{
+    uint64_t now = SYS_TIME_Counter64Get();
+
+    if (now - appTraceData.syncTimeStamp < (uint64_t) SYS_TIME_FrequencyGet() * APP_TRACE_SYNC_PERIOD_MS / 1000)
+        return;
+    syncRecord(now);
+}
+
+/*******************************************************************************
+ End of File
+ */
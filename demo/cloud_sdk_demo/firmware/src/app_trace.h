@@ -0,0 +1,189 @@
+/*******************************************************************************
+  MPLAB Harmony Application Header File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_trace.h
+
+  Summary:
+    This header file provides prototypes and definitions for the application.
+
+  Description:
+    This header file provides function prototypes and data type definitions for
+    the binary event trace. An event is a fixed 16 byte record (core timer
+    count, event id, sequence number and two arguments) stored in a ring kept
+    in persistent RAM, so that recording one costs a few tens of cycles and
+    the last events survive a crash. After a fault the ring is written to
+    TRACE.BIN on the MSD volume at the next boot; it can also be dumped with
+    the "trace" console command. tools/trace_decode.py turns either into a
+    timeline and latency histograms.
+*******************************************************************************/
+
+#ifndef _APP_TRACE_H
+#define _APP_TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <xc.h>
+#include "configuration.h"
+#include "app_log.h"
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+/* Debug wrappers */
+#define APP_TRACE_DBG(level,fmt,...) APP_LOG_DBG(APP_LOG_MODULE_TRACE,level,"[APP_TRACE] "fmt,##__VA_ARGS__)
+#define APP_TRACE_PRNT(fmt,...) APP_LOG_PRNT(APP_LOG_MODULE_TRACE,"[APP_TRACE] "fmt, ##__VA_ARGS__)
+
+// *****************************************************************************
+
+/* Comment out to compile every trace point away */
+#define APP_TRACE_ENABLED
+/* Reset the device after a fault instead of halting, so that the trace is
+ * saved right away. Debug builds always halt at a breakpoint */
+#define APP_TRACE_RESET_ON_FAULT
+
+/* Records of the ring, a power of 2 */
+#define APP_TRACE_RECORDS               256
+/* A SYNC record ties the core timer, which wraps every ~43 s, to the uptime */
+#define APP_TRACE_SYNC_PERIOD_MS        10000
+#define APP_TRACE_FILE_NAME             "TRACE.BIN"
+
+#define APP_TRACE_MAGIC                 0x43525441  /* "ATRC" */
+#define APP_TRACE_MAGIC_FAULT           0x544C4146  /* "FALT" */
+#define APP_TRACE_FILE_MAGIC            0x31435254  /* "TRC1" */
+#define APP_TRACE_FILE_VERSION          1
+
+// *****************************************************************************
+
+/* Keep in sync with EVENTS in tools/trace_decode.py */
+typedef enum
+{
+    APP_TRACE_EV_NONE=0,
+    /* arg0: ms since boot */
+    APP_TRACE_EV_SYNC,
+    /* arg0: RCON reset cause, arg1: boot count since the trace was cleared */
+    APP_TRACE_EV_BOOT,
+    /* arg0: exception cause, arg1: EPC */
+    APP_TRACE_EV_FAULT,
+    /* arg0: new state, arg1: previous state */
+    APP_TRACE_EV_WLAN_STATE,
+    APP_TRACE_EV_AWS_STATE,
+    /* arg0: socket, arg1: IPv4 address */
+    APP_TRACE_EV_SOCKET_OPEN,
+    /* arg0: socket, arg1: port */
+    APP_TRACE_EV_SOCKET_CONNECTED,
+    /* arg0: socket */
+    APP_TRACE_EV_SOCKET_CLOSE,
+    /* arg0: socket */
+    APP_TRACE_EV_TLS_START,
+    /* arg0: socket, arg1: 1 if the session is secure */
+    APP_TRACE_EV_TLS_DONE,
+    /* arg0: MQTT fixed header byte, arg1: packet length */
+    APP_TRACE_EV_MQTT_TX,
+    /* Free for ad hoc instrumentation */
+    APP_TRACE_EV_USER,
+    APP_TRACE_EV_MAX
+} APP_TRACE_EVENT;
+
+typedef struct
+{
+    uint32_t ts;
+    uint16_t event;
+    /* Low bits of the record index, to spot records overwritten while read */
+    uint16_t seq;
+    uint32_t arg0;
+    uint32_t arg1;
+} APP_TRACE_RECORD;
+
+/* Kept in persistent RAM; valid across a reset when magic is set */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t bootCount;
+    uint32_t faultCause;
+    uint32_t faultAddress;
+    /* Records written; free running */
+    volatile uint32_t head;
+    APP_TRACE_RECORD ring[APP_TRACE_RECORDS];
+} APP_TRACE_BUFFER;
+
+/* TRACE.BIN: this header, then the records oldest first. Little endian */
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize;
+    uint32_t coreTimerHz;
+    uint32_t head;
+    uint32_t nRecords;
+    uint32_t faultCause;
+    uint32_t faultAddress;
+    uint32_t bootCount;
+} APP_TRACE_FILE_HEADER;
+
+typedef struct
+{
+    volatile bool enabled;
+    /* Trace of the run that faulted, waiting to be written to the volume */
+    uint8_t* pFaultImage;
+    size_t faultImageSize;
+    /* Of the previous run, kept for the "trace" command */
+    uint32_t lastFaultCause;
+    uint32_t lastFaultAddress;
+    bool lastFaultSaved;
+    uint64_t syncTimeStamp;
+    /* Last state reported for each _STATE event */
+    uint32_t lastState[APP_TRACE_EV_MAX];
+} APP_TRACE_DATA;
+APP_TRACE_DATA appTraceData;
+
+extern APP_TRACE_BUFFER appTraceBuffer;
+
+// *****************************************************************************
+
+static inline void APP_TRACE_Event(APP_TRACE_EVENT event, uint32_t arg0, uint32_t arg1)
+{
+#ifdef APP_TRACE_ENABLED
+    APP_TRACE_RECORD* pRec;
+    uint32_t idx;
+
+    if (!appTraceData.enabled)
+        return;
+    idx = __atomic_fetch_add(&appTraceBuffer.head, 1, __ATOMIC_RELAXED);
+    pRec = &appTraceBuffer.ring[idx & (APP_TRACE_RECORDS - 1)];
+    pRec->ts = _CP0_GET_COUNT();
+    pRec->event = (uint16_t) event;
+    pRec->seq = (uint16_t) idx;
+    pRec->arg0 = arg0;
+    pRec->arg1 = arg1;
+#endif
+}
+
+void APP_TRACE_StateTrack( APP_TRACE_EVENT event, uint32_t state );
+void APP_TRACE_Clear( void );
+bool APP_TRACE_FaultImageGet( const uint8_t** ppImage, size_t* pSize );
+void APP_TRACE_FaultImageRelease( bool saved );
+void APP_TRACE_Initialize( void );
+void APP_TRACE_Tasks( void );
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _APP_TRACE_H */
+
+/*******************************************************************************
+ End of File
+ */
@@ -19,7 +19,12 @@
 #include "app.h"
 #include "app_common.h"
 #include "app_usb_msd.h"
-#include "cJSON.h"
+#include "app_dns_cache.h"
+#include "app_dhcp_lease.h"
+#include "app_config_store.h"
+#include "app_boot_timeline.h"
+#include "app_trace.h"
+#include "aws_iot_doc_parser.h"
 #include "wdrv_pic32mzw_client_api.h"
 #include "wolfcrypt/asn.h"
 #include "atca_basic.h"
@@ -44,6 +49,20 @@ extern char g_Cloud_Endpoint[100];
 
 // *****************************************************************************
 
+/* The cloud files are read and the ECC608 is released, TLS may use it from
+ * now on. A connection started from the store is restarted if they changed */
+static void cloudFilesDone(void)
+{
+    if (appUSBMSDData.configFromStore && appUSBMSDData.configChanged)
+    {
+        APP_USB_MSD_PRNT("Configuration files changed, restarting\r\n");
+        appUSBMSDData.USBMSDTaskState = APP_USB_MSD_RESET;
+        return;
+    }
+    CLOUD_CONFIG_DONE;
+    appUSBMSDData.USBMSDTaskState = APP_USB_MSD_CONNECT;
+}
+
 /* USB event callback */
 void USBDeviceEventHandler(USB_DEVICE_EVENT event, void * pEventData, uintptr_t context)
 {
@@ -51,9 +70,12 @@ void USBDeviceEventHandler(USB_DEVICE_EVENT event, void * pEventData, uintptr_t
     switch (event) {
     case USB_DEVICE_EVENT_RESET:
     case USB_DEVICE_EVENT_DECONFIGURED:
+        appData->usbHostConfigured = false;
         break;
 
     case USB_DEVICE_EVENT_CONFIGURED:
+        /* The host owns the FAT volume from now on */
+        appData->usbHostConfigured = true;
         break;
 
     case USB_DEVICE_EVENT_SUSPENDED:
@@ -67,6 +89,7 @@ void USBDeviceEventHandler(USB_DEVICE_EVENT event, void * pEventData, uintptr_t
     case USB_DEVICE_EVENT_POWER_REMOVED:
         /* VBUS is not detected. Detach the device */
         USB_DEVICE_Detach(appData->usbDeviceHandle);
+        appData->usbHostConfigured = false;
         break;
 
         /* These events are not used in this demo */
@@ -193,15 +216,18 @@ static int8_t getSubjectKeyID(uint8_t* derCert, size_t derCertSz, char* keyID) {
 }
 
 /*Read Wi-Fi configuration file*/
+/* Returns 1 if the file is the one the configuration store was generated from */
 static int8_t readWifiConfigFile() {
     SYS_FS_RESULT fsResult = SYS_FS_RES_FAILURE;
     SYS_FS_HANDLE fd = (SYS_FS_HANDLE)NULL;
-    bool status;
+    uint32_t hash;
     
     /* Touch the file */
     fsResult = SYS_FS_FileStat(APP_USB_MSD_WIFI_CONFIG_FILE_NAME, &appUSBMSDData.fileStatus);
     if (SYS_FS_RES_FAILURE != fsResult) {
         APP_USB_MSD_PRNT("config file exists (FS Error %d)\r\n", SYS_FS_Error());
+        if (APP_CONFIG_STORE_StampMatches(APP_CONFIG_STORE_FILE_WIFI, &appUSBMSDData.fileStatus))
+            return 1;
         
         /* Open the file */
         fd = SYS_FS_FileOpen(APP_USB_MSD_WIFI_CONFIG_FILE_NAME, SYS_FS_FILE_OPEN_READ);
@@ -221,12 +247,22 @@ static int8_t readWifiConfigFile() {
                 }
                 else
                 {
+                    /* Only touched or copied over */
+                    hash = APP_CONFIG_STORE_Hash(appUSBMSDData.appBuffer, strlen((char *)appUSBMSDData.appBuffer));
+                    if (APP_CONFIG_STORE_HashMatches(APP_CONFIG_STORE_FILE_WIFI, hash))
+                    {
+                        APP_CONFIG_STORE_StampSet(APP_CONFIG_STORE_FILE_WIFI, &appUSBMSDData.fileStatus, hash);
+                        return 1;
+                    }
                     /* Parse file contents*/
                     if(parseWifiConfig() == false)
                     {
                         APP_USB_MSD_DBG(SYS_ERROR_ERROR, "Failed parsing Wi-Fi config\r\n");
                         return -1;
                     }
+                    if (APP_CONFIG_STORE_WifiSet(wifi.ssid, wifi.key, wifi.auth))
+                        appUSBMSDData.configChanged = true;
+                    APP_CONFIG_STORE_StampSet(APP_CONFIG_STORE_FILE_WIFI, &appUSBMSDData.fileStatus, hash);
                     return 0;
                 }
             }
@@ -261,17 +297,41 @@ static int8_t writeWifiConfigFile(char* ssid, char* passphrase, uint8_t auth)
     return 0;
 }
 
+/* Copy a string member of cloud.json; values with escapes or too long for the
+ * buffer are refused rather than cut */
+static bool jsonStringGet(const char* pJson, size_t jsonLength, const char* pKey, char* pOut, size_t outSize)
+{
+    const char* pValue;
+    size_t valueLength;
+
+    if (!AwsIotDocParser_FindPath(pJson, jsonLength, pKey, strlen(pKey), &pValue, &valueLength)
+            || valueLength < 2 || '"' != pValue[0])
+        return false;
+    pValue++;
+    valueLength -= 2;
+    if (valueLength >= outSize || NULL != memchr(pValue, '\\', valueLength))
+        return false;
+    memcpy(pOut, pValue, valueLength);
+    pOut[valueLength] = '\0';
+    return true;
+}
+
 /* Read cloud configuration file */
+/* Returns 1 if the file is the one the configuration store was generated from */
 static int8_t readCloudConfigFile() {
     /*Read the MQTT config now*/
     SYS_FS_RESULT fsResult = SYS_FS_RES_FAILURE;
     SYS_FS_HANDLE fd = (SYS_FS_HANDLE)NULL;
     size_t size, rSize;
+    uint32_t hash;
     
     /* Touch the file */
     fsResult = SYS_FS_FileStat(APP_USB_MSD_CLOUD_CONFIG_FILE_NAME, &appUSBMSDData.fileStatus);
     if (SYS_FS_RES_FAILURE != fsResult) 
     {
+        if (APP_CONFIG_STORE_StampMatches(APP_CONFIG_STORE_FILE_CLOUD, &appUSBMSDData.fileStatus))
+            return 1;
+
         /* Open the file*/
         fd = SYS_FS_FileOpen(APP_USB_MSD_CLOUD_CONFIG_FILE_NAME, SYS_FS_FILE_OPEN_READ);
         if (SYS_FS_HANDLE_INVALID != fd) 
@@ -281,8 +341,12 @@ static int8_t readCloudConfigFile() {
             size = SYS_FS_FileTell(fd);
             SYS_FS_FileSeek(fd, 0L, SYS_FS_SEEK_SET);
 
-            char configString[size + 1];
-            memset(configString, 0, size + 1);
+            if (size > APP_USB_MSD_CLOUD_CONFIG_MAX_LEN) {
+                APP_USB_MSD_DBG(SYS_ERROR_ERROR, "Cloud config file too large (%d bytes) \r\n", (int) size);
+                SYS_FS_FileClose(fd);
+                return -1;
+            }
+            char configString[APP_USB_MSD_CLOUD_CONFIG_MAX_LEN];
             rSize = SYS_FS_FileRead(fd, configString, size);
             SYS_FS_FileClose(fd);
 
@@ -291,34 +355,32 @@ static int8_t readCloudConfigFile() {
                 return -1;
             }
             
-            /*Parse the file */
-            cJSON *messageJson = cJSON_Parse(configString);
-            if (messageJson == NULL) {
-                const char *error_ptr = cJSON_GetErrorPtr();            
-                if (error_ptr != NULL) {
-                    APP_USB_MSD_DBG(SYS_ERROR_ERROR, "Message JSON parse Error. Error before: %s \r\n", error_ptr);
-            }
-                cJSON_Delete(messageJson);
-                return -1;
+            /* Only touched or copied over */
+            hash = APP_CONFIG_STORE_Hash(configString, size);
+            if (APP_CONFIG_STORE_HashMatches(APP_CONFIG_STORE_FILE_CLOUD, hash))
+            {
+                APP_CONFIG_STORE_StampSet(APP_CONFIG_STORE_FILE_CLOUD, &appUSBMSDData.fileStatus, hash);
+                return 1;
             }
             
-            cJSON *endpoint = cJSON_GetObjectItem(messageJson, "Endpoint");
-            if (!endpoint || endpoint->type !=cJSON_String ) {
+            /* Parse the file in place */
+            if (!jsonStringGet(configString, size, "Endpoint", g_Cloud_Endpoint, sizeof(g_Cloud_Endpoint))) {
                 APP_USB_MSD_DBG(SYS_ERROR_ERROR, "JSON endpoint parsing error\r\n");
-                cJSON_Delete(messageJson);
                 return -1;
             }
-            snprintf(g_Cloud_Endpoint, sizeof(g_Cloud_Endpoint), "%s", endpoint->valuestring);
 #ifdef AWS_CLOUD_DEMO
             //Get the ClientID
-            cJSON *clientID = cJSON_GetObjectItem(messageJson, "ClientID");
-            if (!clientID || endpoint->type !=cJSON_String ) {
+            if (!jsonStringGet(configString, size, "ClientID", g_Aws_ClientID, sizeof(g_Aws_ClientID))) {
                 APP_USB_MSD_DBG(SYS_ERROR_ERROR, "JSON ClientID parsing error\r\n");
-                cJSON_Delete(messageJson);
                 return -1;
             }
-            snprintf(g_Aws_ClientID, sizeof(g_Aws_ClientID), "%s", clientID->valuestring);
+            if (APP_CONFIG_STORE_CloudSet(g_Cloud_Endpoint, g_Aws_ClientID))
+                appUSBMSDData.configChanged = true;
+#else
+            if (APP_CONFIG_STORE_CloudSet(g_Cloud_Endpoint, ""))
+                appUSBMSDData.configChanged = true;
 #endif
+            APP_CONFIG_STORE_StampSet(APP_CONFIG_STORE_FILE_CLOUD, &appUSBMSDData.fileStatus, hash);
         }
         else
         {
@@ -499,6 +561,9 @@ static bool checkFSMount(){
 void APP_SoftResetDevice(void) {
     bool int_flag = false;
 
+    /* Let the messages still in the log ring out */
+    APP_LOG_Flush();
+
     /*disable interrupts since we are going to do a sysKey unlock*/
     int_flag = (bool) __builtin_disable_interrupts();
 
@@ -537,6 +602,9 @@ void APP_USB_MSD_Initialize ( void )
     appUSBMSDData.USBMSDTaskState = APP_USB_MSD_INIT;
     appUSBMSDData.fsMounted = false;
     appUSBMSDData.wifiConfigRewrite = false;
+    appUSBMSDData.configFromStore = false;
+    appUSBMSDData.configChanged = false;
+    appUSBMSDData.usbHostConfigured = false;
     appUSBMSDData.usbDeviceHandle = USB_DEVICE_HANDLE_INVALID;
     memset(appUSBMSDData.ecc608SerialNum, 0, sizeof(appUSBMSDData.ecc608SerialNum));
 #if SYS_FS_AUTOMOUNT_ENABLE
@@ -545,6 +613,7 @@ void APP_USB_MSD_Initialize ( void )
     strcpy(wifi.ssid, APP_STA_DEFAULT_SSID);
     strcpy(wifi.key, APP_STA_DEFAULT_PASSPHRASE);
     wifi.auth = APP_STA_DEFAULT_AUTH;
+    APP_CONFIG_STORE_Initialize();
 }
 
 /* Application USB MSD main task */
@@ -554,11 +623,50 @@ void APP_USB_MSD_Tasks ( void )
     bool status;
     int8_t ret = 0;
     SYS_FS_FORMAT_PARAM opt;
+    uint32_t partition[4] = {0};
+    uint32_t nSectors;
+    const uint8_t* pTrace;
+    size_t traceSize;
+
+    APP_CONFIG_STORE_Tasks();
 
     switch (appUSBMSDData.USBMSDTaskState) {
         /* Application's initial state. */
         case APP_USB_MSD_INIT:
         {
+            appUSBMSDData.USBMSDTaskState = APP_USB_MSD_WAIT_STORE;
+            break;
+        }
+        
+        /* Start with the stored configuration if there is one; the files are
+         * checked against it once the FS is mounted */
+        case APP_USB_MSD_WAIT_STORE:
+        {
+            if (!APP_CONFIG_STORE_Loaded())
+                break;
+            /* A factory reset starts over from the default configuration */
+            if (SW1_IS_PRESSED && SW2_IS_PRESSED)
+            {
+                APP_CONFIG_STORE_Clear();
+            }
+            else if (APP_CONFIG_STORE_Valid())
+            {
+                APP_CONFIG_STORE_RECORD *pRec = &appConfigStoreData.record;
+
+                memcpy(wifi.ssid, pRec->ssid, sizeof(wifi.ssid));
+                memcpy(wifi.key, pRec->key, sizeof(wifi.key));
+                wifi.auth = pRec->auth;
+                snprintf(g_Cloud_Endpoint, sizeof(g_Cloud_Endpoint), "%s", pRec->endpoint);
+#ifdef AWS_CLOUD_DEMO
+                snprintf(g_Aws_ClientID, sizeof(g_Aws_ClientID), "%s", pRec->clientID);
+#endif
+                APP_WlanFastConnectLoad();
+                APP_DHCP_LeaseLoad();
+                APP_DNS_CacheLoad();
+                appUSBMSDData.configFromStore = true;
+                SET_WIFI_CREDENTIALS(CREDENTIALS_VALID);
+                APP_USB_MSD_PRNT("Credentials from the configuration store, %lu ms after boot\r\n", (unsigned long) APP_CounterToMs(SYS_TIME_Counter64Get()));
+            }
             appUSBMSDData.USBMSDTaskState = APP_USB_MSD_WAIT_FS_MOUNT;
             break;
         }
@@ -588,10 +696,13 @@ void APP_USB_MSD_Tasks ( void )
                 }
                 else 
                 {
-                    appUSBMSDData.USBMSDTaskState = APP_USB_MSD_TOUCH_CLOUD_FILES;
+                    appUSBMSDData.USBMSDTaskState = APP_USB_MSD_TOUCH_WIFI_CONFIG_FILE;
                 }
                 
                 SYS_FS_FileDirectoryRemove("FILE.txt");
+                /* Records of older firmware, now in the configuration store */
+                SYS_FS_FileDirectoryRemove("DNS.BIN");
+                SYS_FS_FileDirectoryRemove("WLAN.BIN");
             }
             break;
         }
@@ -600,6 +711,21 @@ void APP_USB_MSD_Tasks ( void )
         {
             opt.fmt = SYS_FS_FORMAT_FAT;
             opt.au_size = 0;
+            /* The new volume is a partition that ends before the configuration
+             * sectors; the host leaves the space outside of it alone */
+            nSectors = APP_CONFIG_STORE_VolumeFormat();
+            if (nSectors > APP_USB_MSD_PARTITION_START) {
+                partition[0] = nSectors - APP_USB_MSD_PARTITION_START;
+                if (SYS_FS_DrivePartition(SYS_FS_MEDIA_IDX0_MOUNT_NAME_VOLUME_IDX0, partition, (void *)work) != SYS_FS_RES_SUCCESS)
+                {
+                    APP_USB_MSD_DBG(SYS_ERROR_ERROR, "Media partition failed\r\n");
+                    appUSBMSDData.USBMSDTaskState = APP_USB_MSD_ERROR;
+                    break;
+                }
+                /* The media manager only reads the partition table when the
+                 * media is attached; format into the new partition */
+                VolToPart[0].pt = 1;
+            }
             if (SYS_FS_DriveFormat (SYS_FS_MEDIA_IDX0_MOUNT_NAME_VOLUME_IDX0, &opt, (void *)work, SYS_FS_FAT_MAX_SS) != SYS_FS_RES_SUCCESS)
             {
                 /* Format of the disk failed. */
@@ -609,17 +735,64 @@ void APP_USB_MSD_Tasks ( void )
             else
             {
                 /* Format succeeded. Open a file. */
-                appUSBMSDData.USBMSDTaskState = APP_USB_MSD_TOUCH_CLOUD_FILES;
+                appUSBMSDData.USBMSDTaskState = APP_USB_MSD_TOUCH_WIFI_CONFIG_FILE;
             }
             break;
         }
         
-        /* Write cloud config file and web pages' files if not already existing*/
-        case APP_USB_MSD_TOUCH_CLOUD_FILES:
-        {
+        /* Write and Read Wi-Fi configuration file */
+        case APP_USB_MSD_TOUCH_WIFI_CONFIG_FILE:
+        {   
             SYS_FS_DriveLabelSet(SYS_FS_MEDIA_IDX0_MOUNT_NAME_VOLUME_IDX0,APP_USB_MSD_DRIVE_NAME);
             SYS_FS_CurrentDriveSet(SYS_FS_MEDIA_IDX0_MOUNT_NAME_VOLUME_IDX0);
 
+            /* Trace of a run that ended in a fault, kept in RAM over the reset */
+            if (APP_TRACE_FaultImageGet(&pTrace, &traceSize))
+                APP_TRACE_FaultImageRelease(0 == writeFile(APP_TRACE_FILE_NAME, pTrace, traceSize));
+
+            ret = writeWifiConfigFile((char*)wifi.ssid, 
+                                            (char*)wifi.key, 
+                                            wifi.auth);
+            /* Write Wi-Fi config file */
+            if (0 != ret && !appUSBMSDData.wifiConfigRewrite){
+                APP_USB_MSD_DBG(SYS_ERROR_ERROR, "error writing Wi-Fi config File\r\n");
+                appUSBMSDData.USBMSDTaskState = APP_USB_MSD_TOUCH_CLOUD_FILES;
+                break;
+            }
+            
+            /*Read data from active config*/
+            ret = readWifiConfigFile();
+            
+            /* Reboot after new Wi-Fi config applied (via AP prov), once it is stored */
+            if(appUSBMSDData.wifiConfigRewrite)
+            {
+                appUSBMSDData.USBMSDTaskState = APP_USB_MSD_RESET;
+                break;
+            }
+            
+            if (appUSBMSDData.configFromStore)
+            {
+                if (0 > ret)
+                    APP_USB_MSD_DBG(SYS_ERROR_ERROR, "Keeping the stored Wi-Fi config\r\n");
+            }
+            else if (0 <= ret){
+                APP_WlanFastConnectLoad();
+                APP_DHCP_LeaseLoad();
+                SET_WIFI_CREDENTIALS(CREDENTIALS_VALID);
+                APP_USB_MSD_PRNT("Credentials from %s, %lu ms after boot\r\n", APP_USB_MSD_WIFI_CONFIG_FILE_NAME, (unsigned long) APP_CounterToMs(SYS_TIME_Counter64Get()));
+            }
+            else
+                SET_WIFI_CREDENTIALS(CREDENTIALS_INVALID);
+            
+            /* The WLAN task can scan and associate while the ECC608 is read */
+            appUSBMSDData.USBMSDTaskState = APP_USB_MSD_TOUCH_CLOUD_FILES;
+            break;
+        }
+        
+        /* Write cloud config file and web pages' files if not already existing.
+         * Wi-Fi is already coming up meanwhile */
+        case APP_USB_MSD_TOUCH_CLOUD_FILES:
+        {
             extern ATCAIfaceCfg atecc608_0_init_data;
             ATCA_STATUS atcaStat;
             atcaStat = atcab_init(&atecc608_0_init_data);
@@ -630,58 +803,37 @@ void APP_USB_MSD_Tasks ( void )
                 {
                     APP_USB_MSD_DBG(SYS_ERROR_ERROR, "error writing cloud config File\r\n");
                     atcab_release();
-                    appUSBMSDData.USBMSDTaskState = APP_USB_MSD_TOUCH_WIFI_CONFIG_FILE;
+                    cloudFilesDone();
                     break;
                 }
                 
                 /*Read data from active config*/
-                if (0 != readCloudConfigFile()) {
+                ret = readCloudConfigFile();
+                if (0 > ret) {
                     APP_USB_MSD_DBG(SYS_ERROR_ERROR, "invalid cloud config File\r\n");
                     atcab_release();
-                    appUSBMSDData.USBMSDTaskState = APP_USB_MSD_TOUCH_WIFI_CONFIG_FILE;
+                    cloudFilesDone();
                     break;
                 }
+                
+                /* Last known address of the cloud endpoint */
+                if (!appUSBMSDData.configFromStore)
+                    APP_DNS_CacheLoad();
             }
             else
             {
                 APP_USB_MSD_DBG(SYS_ERROR_ERROR, "atcab_init failed\r\n");
                 atcab_release();
-                appUSBMSDData.USBMSDTaskState = APP_USB_MSD_TOUCH_WIFI_CONFIG_FILE;
+                cloudFilesDone();
                 break;
             }
             
             atcab_release();
             
-            appUSBMSDData.USBMSDTaskState = APP_USB_MSD_TOUCH_WIFI_CONFIG_FILE;          
+            cloudFilesDone();
             break;
         }
 
-        /* Write and Read Wi-Fi configuration file */
-        case APP_USB_MSD_TOUCH_WIFI_CONFIG_FILE:
-        {   
-            ret = writeWifiConfigFile((char*)wifi.ssid, 
-                                            (char*)wifi.key, 
-                                            wifi.auth);
-            /* Write Wi-Fi config file */
-            if (0 != ret && !appUSBMSDData.wifiConfigRewrite){
-                APP_USB_MSD_DBG(SYS_ERROR_ERROR, "error writing Wi-Fi config File\r\n");
-                appUSBMSDData.USBMSDTaskState = APP_USB_MSD_CONNECT;
-                break;
-            }
-            
-            /* Reboot after new Wi-Fi config applied (via AP prov) */
-            if(appUSBMSDData.wifiConfigRewrite)
-                APP_SoftResetDevice();
-                    
-            /*Read data from active config*/
-            if (0 == readWifiConfigFile())
-                SET_WIFI_CREDENTIALS(CREDENTIALS_VALID);
-            else
-                SET_WIFI_CREDENTIALS(CREDENTIALS_INVALID);
-            appUSBMSDData.USBMSDTaskState = APP_USB_MSD_CONNECT;
-            break;
-        }
-        
         case APP_USB_MSD_CONNECT:
         {
             appUSBMSDData.usbDeviceHandle = USB_DEVICE_Open(USB_DEVICE_INDEX_0, DRV_IO_INTENT_READWRITE);
@@ -696,6 +848,14 @@ void APP_USB_MSD_Tasks ( void )
             break;
         }
 
+        /* Reset once the configuration store is written */
+        case APP_USB_MSD_RESET:
+        {
+            if (APP_CONFIG_STORE_Idle())
+                APP_SoftResetDevice();
+            break;
+        }
+
         /* Unmount FS */
         case APP_USB_MSD_FS_UNMOUNT:
         {
@@ -736,7 +896,9 @@ void APP_USB_MSD_Tasks ( void )
         {
             APP_USB_MSD_DBG(SYS_ERROR_ERROR, "APP_USB_MSD_ERROR\r\n");
             /* Always inform APP_Task() about credentials validity to avoid code blocking*/
-            SET_WIFI_CREDENTIALS(CREDENTIALS_INVALID);
+            if (!appUSBMSDData.configFromStore)
+                SET_WIFI_CREDENTIALS(CREDENTIALS_INVALID);
+            CLOUD_CONFIG_DONE;
             appUSBMSDData.USBMSDTaskState = APP_USB_MSD_IDLE;
             break;
         }
@@ -746,6 +908,7 @@ void APP_USB_MSD_Tasks ( void )
             break;
         }
     }
+    APP_BOOT_TimelineStateTrack(APP_BOOT_MOD_USB_MSD, appUSBMSDData.USBMSDTaskState);
 }
 
 /*******************************************************************************
@@ -30,6 +30,7 @@
 #include "usb/usb_chapter_9.h"
 #include "usb/usb_device.h"
 #include "system/fs/sys_fs.h"
+#include "app_log.h"
 
 // DOM-IGNORE-BEGIN
 #ifdef __cplusplus  // Provide C++ Compatibility
@@ -42,8 +43,8 @@ extern "C" {
 // *****************************************************************************
 
 /* Debug wrappers */
-#define APP_USB_MSD_DBG(level,fmt,...) SYS_DEBUG_PRINT(level,"[APP_USBMSD] "fmt,##__VA_ARGS__)
-#define APP_USB_MSD_PRNT(fmt,...) SYS_CONSOLE_PRINT("[APP_USBMSD] "fmt, ##__VA_ARGS__)
+#define APP_USB_MSD_DBG(level,fmt,...) APP_LOG_DBG(APP_LOG_MODULE_USB_MSD,level,"[APP_USBMSD] "fmt,##__VA_ARGS__)
+#define APP_USB_MSD_PRNT(fmt,...) APP_LOG_PRNT(APP_LOG_MODULE_USB_MSD,"[APP_USBMSD] "fmt, ##__VA_ARGS__)
  
 /* Config/Web files' names */
 #define APP_USB_MSD_WIFI_CONFIG_FILE_NAME   "WIFI.CFG"    
@@ -61,6 +62,8 @@ extern "C" {
                                                 + sizeof(WIFI_AUTH))
 #define APP_USB_MSD_AZURE_CLOUD_CONFIG_DATA_TEMPLATE "{\r\n\"Endpoint\":\"%s\",\r\n\"ThmbPrnt\":\"%s\"\r\n}"
 #define APP_USB_MSD_AWS_CLOUD_CONFIG_DATA_TEMPLATE "{\r\n\"Endpoint\":\"%s\",\r\n\"ClientID\":\"%s\"\r\n}"
+/* cloud.json is read on the stack; larger files are refused */
+#define APP_USB_MSD_CLOUD_CONFIG_MAX_LEN        512
 #define APP_USB_MSD_CLICKME_DATA_TEMPLATE "<html><body><script type=\"text/javascript\">window.location.href =\"\
                               https://iot.microchip.com/pic32mzw1/aws/%s\";</script></body></html>"
 #define APP_USB_MSD_VOICE_CLICKME_DATA_TEMPLATE "<html><body><script type=\"text/javascript\">window.location.href =\"\
@@ -74,18 +77,22 @@ extern "C" {
 #endif
     
 #define APP_USB_MSD_DRIVE_NAME              "CURIOSITY"
+/* First sector of the partition created by SYS_FS_DrivePartition (N_SEC_TRACK of FatFs) */
+#define APP_USB_MSD_PARTITION_START         63
 // *****************************************************************************
 
 typedef enum
 {
     /* Application USB MSD task state machine. */
     APP_USB_MSD_INIT=0,
+    APP_USB_MSD_WAIT_STORE,
     APP_USB_MSD_PENDING,
     APP_USB_MSD_WAIT_FS_MOUNT,
     APP_USB_MSD_CLEAR_DRIVE,
     APP_USB_MSD_TOUCH_CLOUD_FILES,
     APP_USB_MSD_TOUCH_WIFI_CONFIG_FILE,
     APP_USB_MSD_CONNECT,
+    APP_USB_MSD_RESET,
     APP_USB_MSD_FS_UNMOUNT,
     APP_USB_MSD_DEINIT,
     APP_USB_MSD_IDLE,
@@ -103,7 +110,13 @@ typedef struct
     SYS_FS_HANDLE fileHandle;
     SYS_FS_FSTAT fileStatus;
     volatile bool fsMounted;
+    /* Set while a USB host has the drive configured */
+    volatile bool usbHostConfigured;
     bool wifiConfigRewrite;
+    /* Credentials were taken from the configuration store, before the FS mount */
+    bool configFromStore;
+    /* A configuration file differs from what the store holds */
+    bool configChanged;
     uint8_t appBuffer[256];
     char ecc608SerialNum[27];
 } APP_USB_MSD_DATA;
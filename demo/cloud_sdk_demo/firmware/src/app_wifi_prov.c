@@ -31,7 +31,6 @@ extern uint8_t g_macaddress[6];
 
 // *****************************************************************************
 
-#define SERVER_PORT 80
 #define HEX2ASCII(x) (((x) >= 10) ? (((x) - 10) + 'A') : ((x) + '0'))
 #define M2M_MAX_SSID_LEN 33
 #define M2M_MAX_PSK_LEN  65
@@ -105,6 +104,428 @@ static int8_t parseWifiConfig()
     return ret;
 }
 
+// *****************************************************************************
+// Scan results
+
+/* WIFI_AUTH value a network can be provisioned with, 0 if it cannot */
+static uint8_t scanAuth(WDRV_PIC32MZW_AUTH_TYPE authType)
+{
+    switch (authType) {
+        case WDRV_PIC32MZW_AUTH_TYPE_OPEN:
+            return OPEN;
+        case WDRV_PIC32MZW_AUTH_TYPE_WPAWPA2_PERSONAL:
+        case WDRV_PIC32MZW_AUTH_TYPE_WPA2_PERSONAL:
+            return WPAWPA2MIXED;
+#ifdef WDRV_PIC32MZW_WPA3_PERSONAL_SUPPORT
+        case WDRV_PIC32MZW_AUTH_TYPE_WPA2WPA3_PERSONAL:
+        case WDRV_PIC32MZW_AUTH_TYPE_WPA3_PERSONAL:
+            return WPA2WPA3MIXED;
+#endif
+        default:
+            return 0;
+    }
+}
+
+/* Called by the driver for each BSS found. One entry per SSID, the strongest
+ * BSS, and the list kept sorted strongest first */
+static bool scanCallback(DRV_HANDLE handle, uint8_t index, uint8_t ofTotal, WDRV_PIC32MZW_BSS_INFO *pBSSInfo)
+{
+    APP_WIFI_PROV_SCAN_ENTRY *pScan = appWifiProvData.scan;
+    uint8_t ssidLen;
+    int i, pos;
+
+    if (0 == ofTotal || NULL == pBSSInfo) {
+        appWifiProvData.scanDone = true;
+        return false;
+    }
+
+    ssidLen = pBSSInfo->ctx.ssid.length;
+    if (ssidLen > 0 && ssidLen <= WDRV_PIC32MZW_MAX_SSID_LEN) {
+        for (i = 0; i < appWifiProvData.nScan; i++) {
+            if (pScan[i].ssidLen == ssidLen && 0 == memcmp(pScan[i].ssid, pBSSInfo->ctx.ssid.name, ssidLen))
+                break;
+        }
+        if (i < appWifiProvData.nScan && pScan[i].rssi >= pBSSInfo->rssi) {
+            /* A stronger BSS of this SSID is already listed */
+            i = -1;
+        } else if (i == appWifiProvData.nScan) {
+            /* New SSID, drop the weakest if the list is full */
+            if (appWifiProvData.nScan < APP_WIFI_PROV_SCAN_MAX)
+                appWifiProvData.nScan++;
+            else if (pScan[APP_WIFI_PROV_SCAN_MAX - 1].rssi >= pBSSInfo->rssi)
+                i = -1;
+            else
+                i = APP_WIFI_PROV_SCAN_MAX - 1;
+        }
+        if (i >= 0) {
+            /* Move the entries in between down and insert by RSSI */
+            for (pos = i; pos > 0 && pScan[pos - 1].rssi < pBSSInfo->rssi; pos--)
+                pScan[pos] = pScan[pos - 1];
+            memcpy(pScan[pos].ssid, pBSSInfo->ctx.ssid.name, ssidLen);
+            pScan[pos].ssidLen = ssidLen;
+            pScan[pos].rssi = pBSSInfo->rssi;
+            pScan[pos].channel = pBSSInfo->ctx.channel;
+            pScan[pos].auth = scanAuth(pBSSInfo->authTypeRecommended);
+        }
+    }
+
+    if (index >= ofTotal) {
+        appWifiProvData.scanDone = true;
+        return false;
+    }
+    return true;
+}
+
+// *****************************************************************************
+// Provisioning server
+
+/* Called from the TCP/IP task; the server task picks the signals up */
+static void socketSignalHandler(TCP_SOCKET hTCP, TCPIP_NET_HANDLE hNet, TCPIP_TCP_SIGNAL_TYPE sigType, const void* param)
+{
+    APP_WIFI_PROV_CONN *pConn = &appWifiProvData.conn[(uintptr_t) param];
+
+    taskENTER_CRITICAL();
+    pConn->signals |= sigType;
+    taskEXIT_CRITICAL();
+}
+
+static void connReset(APP_WIFI_PROV_CONN *pConn)
+{
+    if (APP_WIFI_PROV_CONN_LISTEN != pConn->state && appWifiProvData.nClients)
+        appWifiProvData.nClients--;
+    pConn->state = APP_WIFI_PROV_CONN_LISTEN;
+    pConn->legacy = false;
+    pConn->closeAfterTx = false;
+    pConn->readAgain = false;
+    pConn->txLen = 0;
+    pConn->txSent = 0;
+    APP_PROV_HTTP_RequestInit(&pConn->req);
+}
+
+/* End the connection; the server socket goes back to listening */
+static void connClose(APP_WIFI_PROV_CONN *pConn)
+{
+    if (!TCPIP_TCP_Disconnect(pConn->socket))
+        TCPIP_TCP_Abort(pConn->socket, false);
+    connReset(pConn);
+}
+
+/* Queue a response. The body is copied after the header in the TX buffer */
+static void connRespond(APP_WIFI_PROV_CONN *pConn, int status, const char* contentType, const char* body, bool keepAlive)
+{
+    size_t bodyLen = strlen(body);
+    int len;
+
+    len = APP_PROV_HTTP_ResponseHeader(pConn->txBuf, sizeof(pConn->txBuf), status, contentType, bodyLen, keepAlive);
+    if (len < 0 || len + bodyLen > sizeof(pConn->txBuf)) {
+        /* Does not happen with the bodies built here; drop the connection rather than send half */
+        connClose(pConn);
+        return;
+    }
+    memcpy(&pConn->txBuf[len], body, bodyLen);
+    pConn->txLen = len + bodyLen;
+    pConn->txSent = 0;
+    pConn->closeAfterTx = !keepAlive;
+    pConn->state = APP_WIFI_PROV_CONN_TX;
+}
+
+static void connRespondError(APP_WIFI_PROV_CONN *pConn, int status, const char* message, bool keepAlive)
+{
+    static char body[96];
+
+    snprintf(body, sizeof(body), "{\"error\":\"%s\"}", message);
+    connRespond(pConn, status, "application/json", body, keepAlive);
+}
+
+/* [{"ssid":"...","rssi":-50,"ch":6,"auth":2},...] */
+static void handleScan(APP_WIFI_PROV_CONN *pConn, bool keepAlive)
+{
+    static char body[APP_WIFI_PROV_TX_BUFFER_SIZE - 192];
+    char ssid[2 * WDRV_PIC32MZW_MAX_SSID_LEN + 3];
+    size_t n = 0;
+    int i, len;
+
+    body[n++] = '[';
+    for (i = 0; i < appWifiProvData.nScan; i++) {
+        APP_WIFI_PROV_SCAN_ENTRY *pScan = &appWifiProvData.scan[i];
+
+        if (APP_PROV_HTTP_JsonString(ssid, sizeof(ssid), pScan->ssid, pScan->ssidLen) < 0)
+            continue;
+        len = snprintf(&body[n], sizeof(body) - n, "%s{\"ssid\":%s,\"rssi\":%d,\"ch\":%u,\"auth\":%u}",
+                (n > 1) ? "," : "", ssid, pScan->rssi, pScan->channel, pScan->auth);
+        /* Keep room for the closing bracket; the weakest networks are left out */
+        if (len < 0 || n + len + 2 > sizeof(body))
+            break;
+        n += len;
+    }
+    body[n++] = ']';
+    body[n] = '\0';
+    connRespond(pConn, 200, "application/json", body, keepAlive);
+}
+
+/* Form fields ssid, auth (a WIFI_AUTH value) and key */
+static void handleWifi(APP_WIFI_PROV_CONN *pConn, bool keepAlive)
+{
+    const char* form = pConn->req.body;
+    /* wifi.ssid is kept NUL terminated */
+    char ssid[sizeof(wifi.ssid)];
+    char key[sizeof(wifi.key)];
+    char auth[4];
+    int authVal;
+
+    if (APP_PROV_HTTP_FormField(form, "ssid", ssid, sizeof(ssid)) <= 0
+            || APP_PROV_HTTP_FormField(form, "auth", auth, sizeof(auth)) <= 0) {
+        connRespondError(pConn, 400, "ssid and auth are required", keepAlive);
+        return;
+    }
+    authVal = atoi(auth);
+    if (authVal < OPEN || authVal >= WIFI_AUTH_MAX) {
+        connRespondError(pConn, 400, "unknown auth", keepAlive);
+        return;
+    }
+    if (OPEN == authVal)
+        key[0] = '\0';
+    else if (APP_PROV_HTTP_FormField(form, "key", key, sizeof(key)) <= 0) {
+        connRespondError(pConn, 400, "key is required", keepAlive);
+        return;
+    }
+
+    strcpy((char*) wifi.ssid, ssid);
+    strcpy((char*) wifi.key, key);
+    wifi.auth = authVal;
+    appWifiProvData.credentialsSet = true;
+    APP_WIFI_PROV_DBG(SYS_ERROR_DEBUG, "SSID:%s - AUTH:%d\r\n", ssid, authVal);
+    connRespond(pConn, 200, "application/json", "{\"status\":\"ok\"}", keepAlive);
+}
+
+static void handleRequest(APP_WIFI_PROV_CONN *pConn, int8_t connIdx)
+{
+    APP_PROV_HTTP_REQUEST *pReq = &pConn->req;
+    bool keepAlive = pReq->keepAlive;
+
+    appWifiProvData.nRequests++;
+    APP_WIFI_PROV_DBG(SYS_ERROR_DEBUG, "Client %d: %s %s\r\n", connIdx,
+            (APP_PROV_HTTP_METHOD_GET == pReq->method) ? "GET" : (APP_PROV_HTTP_METHOD_POST == pReq->method) ? "POST" : "?",
+            pReq->path);
+
+    if (0 == strcmp(pReq->path, "/scan")) {
+        if (APP_PROV_HTTP_METHOD_GET == pReq->method)
+            handleScan(pConn, keepAlive);
+        else
+            connRespondError(pConn, 405, "use GET", keepAlive);
+    } else if (0 == strcmp(pReq->path, "/wifi")) {
+        if (APP_PROV_HTTP_METHOD_POST == pReq->method)
+            handleWifi(pConn, keepAlive);
+        else
+            connRespondError(pConn, 405, "use POST", keepAlive);
+    } else if (0 == strcmp(pReq->path, "/finish")) {
+        if (APP_PROV_HTTP_METHOD_POST != pReq->method)
+            connRespondError(pConn, 405, "use POST", keepAlive);
+        else if (!appWifiProvData.credentialsSet)
+            connRespondError(pConn, 409, "no credentials yet", keepAlive);
+        else {
+            /* The AP goes down once this response is out */
+            connRespond(pConn, 200, "application/json", "{\"status\":\"ok\"}", false);
+            appWifiProvData.finishConn = connIdx;
+        }
+    } else if (0 == strcmp(pReq->path, "/")) {
+        connRespond(pConn, 200, "text/plain",
+                "WFI32-IoT provisioning\r\n"
+                "GET /scan\r\n"
+                "POST /wifi ssid=<ssid>&auth=<1:open 2:WPA/WPA2 4:WPA2/WPA3>&key=<passphrase>\r\n"
+                "POST /finish\r\n", keepAlive);
+    } else
+        connRespondError(pConn, 404, "not found", keepAlive);
+}
+
+/* Credentials written and the AP to be stopped */
+static void provisioningComplete(void)
+{
+    APP_RewriteWifiConfigFile();
+    APP_WIFI_PROV_PRNT("Provisioning complete, %lu ms after the AP came up (%lu requests, up to %u clients at once)\r\n",
+            (unsigned long) APP_MsSince(appWifiProvData.apUpTimeStamp), (unsigned long) appWifiProvData.nRequests,
+            appWifiProvData.maxClients);
+    appWifiProvData.tcpServerTaskState = APP_TCP_SERVER_CLOSE_SOCKET;
+    appWifiProvData.wifiProvTaskState = APP_WIFI_PROV_AP_DISABLE;
+}
+
+/* A message of the mobile app protocol, handled as before */
+static void handleLegacy(APP_WIFI_PROV_CONN *pConn)
+{
+    APP_PROV_HTTP_REQUEST *pReq = &pConn->req;
+    uint16_t len = pReq->len;
+    size_t doneLen = strlen(APP_WIFI_PROV_DONE_ID);
+    bool done = false;
+
+    if (len > sizeof(appWifiProvData.appBuffer) - 1)
+        len = sizeof(appWifiProvData.appBuffer) - 1;
+    memcpy(appWifiProvData.appBuffer, pReq->buf, len);
+    appWifiProvData.appBuffer[len] = '\0';
+    APP_PROV_HTTP_RequestInit(pReq);
+    appWifiProvData.nRequests++;
+    APP_WIFI_PROV_DBG(SYS_ERROR_DEBUG, "Received command: len %d \r\n", len);
+    APP_WIFI_PROV_DBG(SYS_ERROR_DEBUG, "%s \r\n", (char*)appWifiProvData.appBuffer);
+
+    /* A client sending "apply,..." and "finish" back to back is read as one message */
+    if (len > doneLen && 0 == strcmp((char*)&appWifiProvData.appBuffer[len - doneLen], APP_WIFI_PROV_DONE_ID)) {
+        done = true;
+        if (0 == strncmp((char*)appWifiProvData.appBuffer, APP_WIFI_PROV_DONE_ID, doneLen))
+            appWifiProvData.appBuffer[0] = '\0';
+        else
+            appWifiProvData.appBuffer[len - doneLen] = '\0';
+    } else if (0 == strncmp((char*)appWifiProvData.appBuffer, APP_WIFI_PROV_DONE_ID, doneLen)) {
+        done = true;
+        appWifiProvData.appBuffer[0] = '\0';
+    }
+
+    /* Check buffer contents for being Wi-Fi credentials*/
+    if (appWifiProvData.appBuffer[0]) {
+        if (parseWifiConfig() < 0)
+            APP_WIFI_PROV_DBG(SYS_ERROR_ERROR, "Failed parsing Wi-Fi config\r\n");
+        else
+            appWifiProvData.credentialsSet = true;
+    }
+    if (done)
+        provisioningComplete();
+}
+
+/* Messages of the mobile app start with one of these words; an HTTP request
+ * line cannot */
+static bool isLegacy(const char* buf)
+{
+    return (0 == strncmp(buf, APP_WIFI_PROV_WIFI_CONFIG_ID, 5) || 0 == strncmp(buf, APP_WIFI_PROV_DONE_ID, 5));
+}
+
+/* Move what the socket holds into the request buffer and parse it */
+static void connReceive(APP_WIFI_PROV_CONN *pConn, int8_t connIdx)
+{
+    APP_PROV_HTTP_REQUEST *pReq = &pConn->req;
+    APP_PROV_HTTP_PARSE_RESULT res;
+    uint16_t space, avail, nRead;
+    char* tail;
+
+    tail = APP_PROV_HTTP_RequestTail(pReq, &space);
+    avail = TCPIP_TCP_GetIsReady(pConn->socket);
+    nRead = (avail > space) ? space : avail;
+    pConn->readAgain = (avail > space);
+    if (nRead) {
+        nRead = TCPIP_TCP_ArrayGet(pConn->socket, (uint8_t*) tail, nRead);
+        pConn->activityTimeStamp = SYS_TIME_Counter64Get();
+    }
+    if (0 == nRead && 0 == pReq->len)
+        return;
+
+    /* Told apart as soon as the first five bytes are in */
+    if (!pConn->legacy && 0 == pReq->headerLen && pReq->len < 5 && pReq->len + nRead >= 5) {
+        tail[nRead] = '\0';
+        if (isLegacy(pReq->buf)) {
+            pConn->legacy = true;
+            APP_WIFI_PROV_DBG(SYS_ERROR_DEBUG, "Client %d uses the raw protocol\r\n", connIdx);
+        }
+    }
+    if (pConn->legacy) {
+        /* Handled once the client goes quiet */
+        pReq->len += nRead;
+        pReq->buf[pReq->len] = '\0';
+        if (pReq->len >= APP_PROV_HTTP_MAX_REQUEST)
+            handleLegacy(pConn);
+        return;
+    }
+
+    res = APP_PROV_HTTP_RequestFeed(pReq, nRead);
+    if (APP_PROV_HTTP_PARSE_DONE == res)
+        handleRequest(pConn, connIdx);
+    else if (APP_PROV_HTTP_PARSE_BAD_REQUEST == res)
+        connRespondError(pConn, 400, "bad request", false);
+    else if (APP_PROV_HTTP_PARSE_TOO_LARGE == res)
+        connRespondError(pConn, 413, "request too large", false);
+}
+
+/* Push as much of the response as the socket takes */
+static void connSend(APP_WIFI_PROV_CONN *pConn, int8_t connIdx)
+{
+    uint16_t space = TCPIP_TCP_PutIsReady(pConn->socket);
+    uint16_t n = pConn->txLen - pConn->txSent;
+
+    if (n > space)
+        n = space;
+    if (n) {
+        pConn->txSent += TCPIP_TCP_ArrayPut(pConn->socket, (uint8_t*) &pConn->txBuf[pConn->txSent], n);
+        pConn->activityTimeStamp = SYS_TIME_Counter64Get();
+    }
+    if (pConn->txSent < pConn->txLen)
+        return;
+    TCPIP_TCP_Flush(pConn->socket);
+
+    if (appWifiProvData.finishConn == connIdx) {
+        appWifiProvData.finishConn = -1;
+        provisioningComplete();
+        return;
+    }
+    if (pConn->closeAfterTx) {
+        connClose(pConn);
+        return;
+    }
+    /* Keep-alive: a pipelined request may already be in the buffer */
+    pConn->state = APP_WIFI_PROV_CONN_RX;
+    APP_PROV_HTTP_RequestNext(&pConn->req);
+    pConn->txLen = pConn->txSent = 0;
+    pConn->readAgain = true;
+}
+
+/* One pass over a connection. The socket is only read when the stack has
+ * signalled data for it */
+static void connTasks(APP_WIFI_PROV_CONN *pConn, int8_t connIdx)
+{
+    uint16_t signals;
+
+    taskENTER_CRITICAL();
+    signals = pConn->signals;
+    pConn->signals = 0;
+    taskEXIT_CRITICAL();
+
+    if (signals & (TCPIP_TCP_SIGNAL_RX_RST | TCPIP_TCP_SIGNAL_KEEP_ALIVE_TMO)) {
+        if (APP_WIFI_PROV_CONN_LISTEN != pConn->state)
+            APP_WIFI_PROV_DBG(SYS_ERROR_DEBUG, "Client %d reset\r\n", connIdx);
+        TCPIP_TCP_Abort(pConn->socket, false);
+        connReset(pConn);
+        return;
+    }
+
+    if (APP_WIFI_PROV_CONN_LISTEN == pConn->state) {
+        if (0 == (signals & (TCPIP_TCP_SIGNAL_ESTABLISHED | TCPIP_TCP_SIGNAL_RX_DATA)) || !TCPIP_TCP_IsConnected(pConn->socket))
+            return;
+        pConn->state = APP_WIFI_PROV_CONN_RX;
+        pConn->activityTimeStamp = SYS_TIME_Counter64Get();
+        if (++appWifiProvData.nClients > appWifiProvData.maxClients)
+            appWifiProvData.maxClients = appWifiProvData.nClients;
+        APP_WIFI_PROV_PRNT("Client %d connected (%u at once)\r\n", connIdx, appWifiProvData.nClients);
+        signals |= TCPIP_TCP_SIGNAL_RX_DATA;
+    }
+
+    if (APP_WIFI_PROV_CONN_TX == pConn->state && (signals & TCPIP_TCP_SIGNAL_RX_FIN))
+        pConn->closeAfterTx = true;
+
+    if (APP_WIFI_PROV_CONN_RX == pConn->state) {
+        if ((signals & TCPIP_TCP_SIGNAL_RX_DATA) || pConn->readAgain)
+            connReceive(pConn, connIdx);
+        if (pConn->legacy && pConn->req.len
+                && ((signals & TCPIP_TCP_SIGNAL_RX_FIN) || APP_MsSince(pConn->activityTimeStamp) >= APP_WIFI_PROV_LEGACY_QUIET_MS))
+            handleLegacy(pConn);
+    }
+
+    if (APP_WIFI_PROV_CONN_TX == pConn->state)
+        connSend(pConn, connIdx);
+
+    if (APP_WIFI_PROV_CONN_LISTEN != pConn->state
+            && ((APP_WIFI_PROV_CONN_RX == pConn->state && (signals & TCPIP_TCP_SIGNAL_RX_FIN))
+                || APP_MsSince(pConn->activityTimeStamp) >= APP_WIFI_PROV_IDLE_TMO_MS)) {
+        /* The client is done with the connection, or has forgotten it */
+        APP_WIFI_PROV_DBG(SYS_ERROR_DEBUG, "Client %d closed\r\n", connIdx);
+        connClose(pConn);
+    }
+}
+
 // *****************************************************************************
 
 void APP_InitializeWifiProv ( void )
@@ -132,8 +553,41 @@ void APP_TaskWifiProv ( void )
             break;
         }
      
-        /* Enable AP*/
+        /* Scan before the AP is up: the driver does not scan while it runs one */
         case APP_WIFI_PROV_AP_ENABLE:
+        {
+            appWifiProvData.nScan = 0;
+            appWifiProvData.scanDone = false;
+            appWifiProvData.credentialsSet = false;
+            appWifiProvData.finishConn = -1;
+            appWifiProvData.nRequests = 0;
+            appWifiProvData.nClients = 0;
+            appWifiProvData.maxClients = 0;
+            appWifiProvData.scanTimeStamp = SYS_TIME_Counter64Get();
+            if (WDRV_PIC32MZW_BSSFindFirst(appData.wdrvHandle, WDRV_PIC32MZW_CID_ANY, true, NULL, scanCallback) != WDRV_PIC32MZW_STATUS_OK)
+            {
+                APP_WIFI_PROV_DBG(SYS_ERROR_ERROR, "Failed to start scan\r\n");
+                appWifiProvData.wifiProvTaskState = APP_WIFI_PROV_AP_START;
+                break;
+            }
+            appWifiProvData.wifiProvTaskState = APP_WIFI_PROV_WAITING_FOR_SCAN;
+            break;
+        }
+
+        /* Wait for the scan results */
+        case APP_WIFI_PROV_WAITING_FOR_SCAN:
+        {
+            if (appWifiProvData.scanDone || APP_MsSince(appWifiProvData.scanTimeStamp) >= APP_WIFI_PROV_SCAN_TMO_MS)
+            {
+                APP_WIFI_PROV_PRNT("%d networks found in %lu ms\r\n", appWifiProvData.nScan,
+                        (unsigned long) APP_MsSince(appWifiProvData.scanTimeStamp));
+                appWifiProvData.wifiProvTaskState = APP_WIFI_PROV_AP_START;
+            }
+            break;
+        }
+
+        /* Enable AP*/
+        case APP_WIFI_PROV_AP_START:
         {
             uint8_t ssid[M2M_MAX_SSID_LEN] = DEFAULT_SSID;           
             WDRV_PIC32MZW_BSSCtxSetDefaults(&g_wifiConfig.bssCtx);
@@ -165,6 +619,7 @@ void APP_TaskWifiProv ( void )
                APP_WIFI_PROV_PRNT("AP is enabled\r\n");
                APP_manageLed(LED_BLUE, LED_S_BLINK_STARTING_ON, BLINK_MODE_PERIODIC);
                 appWifiProvData.wifiProvTaskState = APP_WIFI_PROV_AP_ENABLED;          
+                appWifiProvData.apUpTimeStamp = SYS_TIME_Counter64Get();
                 /* Change TCP server task state to open a socket*/
                 appWifiProvData.tcpServerTaskState = APP_TCP_SERVER_OPEN_SOCKET;
             }
@@ -224,11 +679,15 @@ void APP_TaskWifiProv ( void )
 
 void APP_TaskTcpServer ( void )
 {
+    int8_t i;
+
     switch ( appWifiProvData.tcpServerTaskState )
     {
         /* TCP server task initial state. */
         case APP_TCP_SERVER_INIT:
         {
+            for (i = 0; i < APP_WIFI_PROV_MAX_CLIENTS; i++)
+                appWifiProvData.conn[i].socket = INVALID_SOCKET;
             appWifiProvData.tcpServerTaskState = APP_TCP_SERVER_PENDING;
             break;
         }
@@ -239,89 +698,65 @@ void APP_TaskTcpServer ( void )
             break;
         }
         
-        /* Open a socket */
+        /* Open one listening socket per client served at the same time */
         case APP_TCP_SERVER_OPEN_SOCKET:
         {
-            appWifiProvData.socket = TCPIP_TCP_ServerOpen(IP_ADDRESS_TYPE_IPV4, SERVER_PORT, 0);
-            if(appWifiProvData.socket == INVALID_SOCKET)
+            int8_t nOpen = 0;
+
+            for (i = 0; i < APP_WIFI_PROV_MAX_CLIENTS; i++) {
+                APP_WIFI_PROV_CONN *pConn = &appWifiProvData.conn[i];
+
+                pConn->signals = 0;
+                pConn->hSignal = 0;
+                pConn->state = APP_WIFI_PROV_CONN_LISTEN;
+                connReset(pConn);
+                pConn->socket = TCPIP_TCP_ServerOpen(IP_ADDRESS_TYPE_IPV4, APP_WIFI_PROV_SERVER_PORT, 0);
+                if (pConn->socket == INVALID_SOCKET)
+                    continue;
+                pConn->hSignal = TCPIP_TCP_SignalHandlerRegister(pConn->socket,
+                        TCPIP_TCP_SIGNAL_ESTABLISHED | TCPIP_TCP_SIGNAL_RX_DATA | TCPIP_TCP_SIGNAL_RX_FIN
+                        | TCPIP_TCP_SIGNAL_RX_RST | TCPIP_TCP_SIGNAL_KEEP_ALIVE_TMO,
+                        socketSignalHandler, (const void*) (uintptr_t) i);
+                nOpen++;
+            }
+            if (0 == nOpen)
             {
                 APP_WIFI_PROV_DBG(SYS_ERROR_ERROR, "Couldn't open server socket\r\n");
                 break;
             }
-            APP_WIFI_PROV_DBG(SYS_ERROR_DEBUG, "TCP socket %d opened\r\n", appWifiProvData.socket);
+            APP_WIFI_PROV_DBG(SYS_ERROR_DEBUG, "%d TCP sockets listening on port %d\r\n", nOpen, APP_WIFI_PROV_SERVER_PORT);
             
-            appWifiProvData.tcpServerTaskState = APP_TCP_SERVER_WAITING_SOCKET_CONNECTION;
+            appWifiProvData.tcpServerTaskState = APP_TCP_SERVER_SERVE;
             break;
         }
            
-        /* Wait for a connection over this socket */
-        case APP_TCP_SERVER_WAITING_SOCKET_CONNECTION:
-        {
-            if(!TCPIP_TCP_IsConnected(appWifiProvData.socket))
-            {
-                break;
-            }
-            APP_WIFI_PROV_PRNT("TCP socket %d connected\r\n", appWifiProvData.socket);
-            
-            appWifiProvData.tcpServerTaskState = APP_TCP_SERVER_PARSE_SOCKET_DATA;
-            break;
-        }
-        
-        /* Wait for data (valid credentials) over this socket*/
-        case APP_TCP_SERVER_PARSE_SOCKET_DATA:
+        /* Serve the connected clients */
+        case APP_TCP_SERVER_SERVE:
         {
-            int readSize = 0;
-            int8_t ret = 0;
-            char *p;
-            if(!TCPIP_TCP_IsConnected(appWifiProvData.socket))
-            {
-                return;
+            for (i = 0; i < APP_WIFI_PROV_MAX_CLIENTS
+                    && APP_TCP_SERVER_SERVE == appWifiProvData.tcpServerTaskState; i++) {
+                if (appWifiProvData.conn[i].socket != INVALID_SOCKET)
+                    connTasks(&appWifiProvData.conn[i], i);
             }
-            
-            readSize = TCPIP_TCP_GetIsReady(appWifiProvData.socket);	// Get TCP RX FIFO byte count
-            if(readSize)
-            {
-                if(readSize > sizeof(appWifiProvData.appBuffer) - 1)
-                {
-                    readSize = sizeof(appWifiProvData.appBuffer) - 1;
-                }
-                TCPIP_TCP_ArrayGet(appWifiProvData.socket, appWifiProvData.appBuffer, readSize);
-                appWifiProvData.appBuffer[readSize] = '\0';
-                APP_WIFI_PROV_DBG(SYS_ERROR_DEBUG, "Received command: len %d \r\n", readSize);
-                APP_WIFI_PROV_DBG(SYS_ERROR_DEBUG, "%s \r\n", (char*)appWifiProvData.appBuffer);
-                p = (char*)appWifiProvData.appBuffer;
-
-                /* Check buffer contents for being Wi-Fi credentials*/
-                ret = parseWifiConfig();
-                if(ret < 0)
-                {
-                    APP_WIFI_PROV_DBG(SYS_ERROR_ERROR, "Failed parsing Wi-Fi config\r\n");
-                    break;
-                }
-                
-                /* Apply received Wi-Fi credentials */
-                if (p != NULL && !strncmp(p, APP_WIFI_PROV_DONE_ID, strlen(APP_WIFI_PROV_DONE_ID))) {                                   
-                    /* Store Wi-Fi credentials to MSD*/
-                    APP_RewriteWifiConfigFile();
-                    
-                    APP_WIFI_PROV_PRNT("Provisioning complete\r\n");
-                    appWifiProvData.tcpServerTaskState = APP_TCP_SERVER_CLOSE_SOCKET;
-                    appWifiProvData.wifiProvTaskState = APP_WIFI_PROV_AP_DISABLE;
-                }
-            }
-                        
             break;
         }
         
-        /* Close the socket */
+        /* Close the sockets */
         case APP_TCP_SERVER_CLOSE_SOCKET:
         {            
-            if(TCPIP_TCP_Close(appWifiProvData.socket) == false)
-            {
-                APP_WIFI_PROV_DBG(SYS_ERROR_ERROR, "Couldn't close server socket\r\n");
-                break;
+            for (i = 0; i < APP_WIFI_PROV_MAX_CLIENTS; i++) {
+                APP_WIFI_PROV_CONN *pConn = &appWifiProvData.conn[i];
+
+                if (pConn->socket == INVALID_SOCKET)
+                    continue;
+                if (pConn->hSignal)
+                    TCPIP_TCP_SignalHandlerDeregister(pConn->socket, pConn->hSignal);
+                if (TCPIP_TCP_Close(pConn->socket) == false)
+                    APP_WIFI_PROV_DBG(SYS_ERROR_ERROR, "Couldn't close server socket %d\r\n", pConn->socket);
+                pConn->socket = INVALID_SOCKET;
+                pConn->hSignal = 0;
             }
-            APP_WIFI_PROV_DBG(SYS_ERROR_DEBUG, "TCP socket %d closed\r\n", appWifiProvData.socket);
+            APP_WIFI_PROV_DBG(SYS_ERROR_DEBUG, "TCP sockets closed\r\n");
             
             appWifiProvData.tcpServerTaskState = APP_TCP_SERVER_IDLE;
             break;
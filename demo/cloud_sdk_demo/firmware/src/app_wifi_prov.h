@@ -12,10 +12,11 @@
 
   Description:
     This header file provides function prototypes and data type definitions for
-    the application.  Some of these are required by the system (such as the
-    "APP_Initialize" and "APP_Tasks" prototypes) and some of them are only used
-    internally by the application (such as the "APP_STATES" definition).  Both
-    are defined here for convenience.
+    the SoftAP provisioning. The networks around are scanned once before the
+    AP is started, then a small HTTP/1.1 server on several sockets serves the
+    scan results and takes the credentials, one request at a time per
+    connection and with keep-alive. The raw "apply,..."/"finish" messages of
+    the provisioning mobile app are still accepted on the same port.
 *******************************************************************************/
     
 #ifndef _APP_WIFI_PROV_H
@@ -29,6 +30,10 @@
 #include <stdlib.h>
 #include "system_config.h"
 #include "system_definitions.h"
+#include "tcpip/tcpip.h"
+#include "wdrv_pic32mzw_common.h"
+#include "app_prov_http.h"
+#include "app_log.h"
 
 // DOM-IGNORE-BEGIN
 #ifdef __cplusplus  // Provide C++ Compatibility
@@ -38,12 +43,25 @@ extern "C" {
 
 // *****************************************************************************
 
-#define APP_WIFI_PROV_DBG(level,fmt,...) SYS_DEBUG_PRINT(level,"[APP_WIFI_PROV] "fmt,##__VA_ARGS__)
-#define APP_WIFI_PROV_PRNT(fmt,...) SYS_CONSOLE_PRINT("[APP_WIFI_PROV] "fmt, ##__VA_ARGS__)
+#define APP_WIFI_PROV_DBG(level,fmt,...) APP_LOG_DBG(APP_LOG_MODULE_WIFI_PROV,level,"[APP_WIFI_PROV] "fmt,##__VA_ARGS__)
+#define APP_WIFI_PROV_PRNT(fmt,...) APP_LOG_PRNT(APP_LOG_MODULE_WIFI_PROV,"[APP_WIFI_PROV] "fmt, ##__VA_ARGS__)
     
 #define APP_WIFI_PROV_WIFI_CONFIG_ID       "apply"
 #define APP_WIFI_PROV_DONE_ID              "finish"
- 
+
+#define APP_WIFI_PROV_SERVER_PORT          80
+/* Listening sockets, i.e. clients served at the same time */
+#define APP_WIFI_PROV_MAX_CLIENTS          3
+/* A connection with nothing going on for this long is dropped to free its socket */
+#define APP_WIFI_PROV_IDLE_TMO_MS          10000
+/* The raw messages have no framing: one is taken as complete once the client
+ * has been silent for this long, or has closed its side */
+#define APP_WIFI_PROV_LEGACY_QUIET_MS      100
+#define APP_WIFI_PROV_TX_BUFFER_SIZE       1024
+/* Networks kept from the scan done before the AP is started */
+#define APP_WIFI_PROV_SCAN_MAX             16
+#define APP_WIFI_PROV_SCAN_TMO_MS          5000
+
 // *****************************************************************************
 
 typedef enum
@@ -52,6 +70,8 @@ typedef enum
     APP_WIFI_PROV_INIT=0,
     APP_WIFI_PROV_PENDING,
     APP_WIFI_PROV_AP_ENABLE,
+    APP_WIFI_PROV_WAITING_FOR_SCAN,
+    APP_WIFI_PROV_AP_START,
     APP_WIFI_PROV_WAITING_FOR_AP_ENABLED,
     APP_WIFI_PROV_AP_ENABLED,
     APP_WIFI_PROV_AP_DISABLE,
@@ -66,15 +86,52 @@ typedef enum
     APP_TCP_SERVER_INIT=0,
     APP_TCP_SERVER_PENDING,
     APP_TCP_SERVER_OPEN_SOCKET,
-    APP_TCP_SERVER_WAITING_SOCKET_CONNECTION,
-    APP_TCP_SERVER_PARSE_SOCKET_DATA,
+    APP_TCP_SERVER_SERVE,
     APP_TCP_SERVER_CLOSE_SOCKET,
     APP_TCP_SERVER_IDLE,
     APP_TCP_SERVER_ERROR
 } APP_TASK_TCP_SERVER_STATES;
 
+typedef enum
+{
+    APP_WIFI_PROV_CONN_LISTEN=0,
+    /* Reading a request */
+    APP_WIFI_PROV_CONN_RX,
+    /* Sending the response */
+    APP_WIFI_PROV_CONN_TX
+} APP_WIFI_PROV_CONN_STATE;
+
 // *****************************************************************************
 
+typedef struct
+{
+    TCP_SOCKET socket;
+    TCPIP_TCP_SIGNAL_HANDLE hSignal;
+    /* TCP signals since the last pass, set from the TCP/IP task */
+    volatile uint16_t signals;
+    APP_WIFI_PROV_CONN_STATE state;
+    /* The client speaks the raw protocol of the mobile app */
+    bool legacy;
+    bool closeAfterTx;
+    /* The request buffer was full, more may be waiting in the socket */
+    bool readAgain;
+    uint64_t activityTimeStamp;
+    APP_PROV_HTTP_REQUEST req;
+    uint16_t txLen;
+    uint16_t txSent;
+    char txBuf[APP_WIFI_PROV_TX_BUFFER_SIZE];
+} APP_WIFI_PROV_CONN;
+
+typedef struct
+{
+    uint8_t ssid[WDRV_PIC32MZW_MAX_SSID_LEN];
+    uint8_t ssidLen;
+    int8_t rssi;
+    uint8_t channel;
+    /* WIFI_AUTH value to provision it with, 0 if not supported */
+    uint8_t auth;
+} APP_WIFI_PROV_SCAN_ENTRY;
+
 typedef struct
 {
     /* The application's current state */
@@ -82,8 +139,21 @@ typedef struct
     APP_TASK_TCP_SERVER_STATES tcpServerTaskState;
     bool apReady;
     bool isConnected;
-    TCP_SOCKET socket;
     uint8_t appBuffer[256];
+    APP_WIFI_PROV_CONN conn[APP_WIFI_PROV_MAX_CLIENTS];
+    /* Scan results, strongest first, one entry per SSID */
+    APP_WIFI_PROV_SCAN_ENTRY scan[APP_WIFI_PROV_SCAN_MAX];
+    uint8_t nScan;
+    volatile bool scanDone;
+    uint64_t scanTimeStamp;
+    /* Credentials received, and the connection whose response ends provisioning */
+    bool credentialsSet;
+    int8_t finishConn;
+    /* Statistics of this provisioning session */
+    uint64_t apUpTimeStamp;
+    uint32_t nRequests;
+    uint8_t nClients;
+    uint8_t maxClients;
 } APP_WIFI_PROV_DATA;
 APP_WIFI_PROV_DATA appWifiProvData;
 
@@ -171,8 +171,8 @@ extern "C" {
 
 /* Memory Driver Instance 0 Configuration */
 #define DRV_MEMORY_INDEX_0                   0
-#define DRV_MEMORY_CLIENTS_NUMBER_IDX0       2
-#define DRV_MEMORY_BUF_Q_SIZE_IDX0    1
+#define DRV_MEMORY_CLIENTS_NUMBER_IDX0       4
+#define DRV_MEMORY_BUF_Q_SIZE_IDX0    2
 /* Memory Driver Instance 0 RTOS Configurations*/
 #define DRV_MEMORY_STACK_SIZE_IDX0               1024
 #define DRV_MEMORY_PRIORITY_IDX0                 1
@@ -239,7 +239,6 @@ extern "C" {
 #define NO_WRITEV
 #define MICROCHIP_TCPIP
 #define WOLFSSL_DTLS
-#define NO_PWDBASED
 #define HAVE_TLS_EXTENSIONS
 #define HAVE_SUPPORTED_CURVES
 #define HAVE_SNI
@@ -541,7 +540,7 @@ extern "C" {
 #define TCPIP_NTP_SERVER_MAX_LENGTH				30
 #define TCPIP_NTP_QUERY_INTERVAL				600
 #define TCPIP_NTP_FAST_QUERY_INTERVAL	    	14
-#define TCPIP_NTP_TASK_TICK_RATE				1100
+#define TCPIP_NTP_TASK_TICK_RATE				250
 #define TCPIP_NTP_RX_QUEUE_LIMIT				2
 
 
@@ -556,7 +555,7 @@ extern "C" {
 #define NO_WRITEV
 #define NO_FILESYSTEM
 #define USE_FAST_MATH
-#define NO_PWDBASED
+// NO_PWDBASED left out: PBKDF2 derives the WPA2 PMK in app.c
 #define HAVE_MCAPI
 #define WOLF_CRYPTO_CB  // provide call-back support
 #define WOLFSSL_MICROCHIP_PIC32MZ
@@ -596,7 +595,6 @@ extern "C" {
 #define FREERTOS
 #define NO_SIG_WRAPPER
 #define NO_ERROR_STRINGS
-#define NO_WOLFSSL_MEMORY
 /*Enabling TNGTLS certificate loading*/
 #define HAVE_SUPPORTED_CURVES
 #define WOLFSSL_ATECC608A
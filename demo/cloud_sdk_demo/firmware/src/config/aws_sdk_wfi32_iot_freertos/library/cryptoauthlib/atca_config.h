@@ -25,7 +25,7 @@
 #define ATCA_POLLING_INIT_TIME_MSEC       1
 #endif
 #ifndef ATCA_POLLING_FREQUENCY_TIME_MSEC
-#define ATCA_POLLING_FREQUENCY_TIME_MSEC  2
+#define ATCA_POLLING_FREQUENCY_TIME_MSEC  1
 #endif
 #ifndef ATCA_POLLING_MAX_TIME_MSEC
 #define ATCA_POLLING_MAX_TIME_MSEC        2500
@@ -213,6 +213,7 @@ typedef bool (* atca_i2c_plib_read)( uint16_t, uint8_t *, size_t );
 typedef bool (* atca_i2c_plib_write)( uint16_t, uint8_t *, size_t );
 typedef bool (* atca_i2c_plib_is_busy)( void );
 typedef PLIB_I2C_ERROR (* atca_i2c_error_get)( void );
+typedef void (* atca_i2c_plib_callback_register)( I2C_CALLBACK, uintptr_t );
 typedef bool (* atca_i2c_plib_transfer_setup)(PLIB_I2C_TRANSFER_SETUP* setup, uint32_t srcClkFreq);
 
 typedef struct atca_plib_i2c_api
@@ -222,6 +223,7 @@ typedef struct atca_plib_i2c_api
     atca_i2c_plib_is_busy           is_busy;
     atca_i2c_error_get              error_get;
     atca_i2c_plib_transfer_setup    transfer_setup;
+    atca_i2c_plib_callback_register callback_register;
 } atca_plib_i2c_api_t;
 
 
@@ -105,6 +105,14 @@ ATCA_STATUS initATCADevice(ATCAIfaceCfg *cfg, ATCADevice ca_dev)
         return status;
     }
 
+    ca_dev->hold_count = 0;
+    status = hal_create_mutex(&ca_dev->mutex, "atca_device");
+    if (status != ATCA_SUCCESS)
+    {
+        (void)releaseATCAIface(&ca_dev->mIface);
+        return status;
+    }
+
     return ATCA_SUCCESS;
 }
 
@@ -128,6 +136,12 @@ ATCA_STATUS releaseATCADevice(ATCADevice ca_dev)
         return ATCA_BAD_PARAM;
     }
 
+    if (ca_dev->mutex != NULL)
+    {
+        (void)hal_destroy_mutex(ca_dev->mutex);
+        ca_dev->mutex = NULL;
+    }
+
     return releaseATCAIface(&ca_dev->mIface);
 }
 
@@ -160,6 +160,8 @@ struct atca_device
 
     uint16_t options;                   /**< Nested command details parameter */
 
+    void*    mutex;                     /**< Serializes commands, holds and idles between tasks */
+    uint32_t hold_count;                /**< Nesting count of calib_execute_hold(), under mutex */
 };
 
 typedef struct atca_device * ATCADevice;
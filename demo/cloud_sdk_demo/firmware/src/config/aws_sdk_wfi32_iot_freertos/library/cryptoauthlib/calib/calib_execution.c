@@ -226,6 +226,44 @@ static const device_execution_time_t device_execution_time_sha10x[] = {
 };
 // *INDENT-ON*
 
+#ifndef ATCA_NO_POLL
+// *INDENT-OFF* - Preserve time formatting from the code formatter
+/* First wait before polling an ATECC608 for the slow commands used during a
+   TLS handshake, about half of the datasheet maximum. Polling from 1 ms on
+   would only fill the bus with NACKed reads for these. */
+static const device_execution_time_t device_poll_first_wait_608[] = {
+    { ATCA_ECDH,         37},
+    { ATCA_GENKEY,       57},
+    { ATCA_KDF,          80},
+    { ATCA_SIGN,         57},
+    { ATCA_VERIFY,       52},
+    { ATCA_RANDOM,       11}
+};
+// *INDENT-ON*
+
+/** \brief return how long to wait before the first completion poll
+ *  \param[in] opcode  Opcode value of the command
+ *  \param[in] device  Device the command is sent to
+ *  \return wait time in milliseconds
+ */
+static uint32_t calib_get_poll_first_wait(uint8_t opcode, ATCADevice device)
+{
+    uint8_t i;
+
+    if (ATECC608 == device->mIface.mIfaceCFG->devtype)
+    {
+        for (i = 0; i < sizeof(device_poll_first_wait_608) / sizeof(device_execution_time_t); i++)
+        {
+            if (device_poll_first_wait_608[i].opcode == opcode)
+            {
+                return device_poll_first_wait_608[i].execution_time_msec;
+            }
+        }
+    }
+    return ATCA_POLLING_INIT_TIME_MSEC;
+}
+#endif
+
 /** \brief return the typical execution time for the given command
  *  \param[in] opcode  Opcode value of the command
  *  \param[in] ca_cmd  Command object for which the execution times are associated
@@ -449,17 +487,8 @@ ATCA_STATUS calib_execute_receive(ATCADevice device, uint8_t device_address, uin
     return status;
 }
 
-/** \brief Wakes up device, sends the packet, waits for command completion,
- *         receives response, and puts the device into the idle state.
- *
- * \param[in,out] packet  As input, the packet to be sent. As output, the
- *                       data buffer in the packet structure will contain the
- *                       response.
- * \param[in]    device  CryptoAuthentication device to send the command to.
- *
- * \return ATCA_SUCCESS on success, otherwise an error code.
- */
-ATCA_STATUS calib_execute_command(ATCAPacket* packet, ATCADevice device)
+/* Body of calib_execute_command(), called with the device mutex taken */
+static ATCA_STATUS calib_execute_command_locked(ATCAPacket* packet, ATCADevice device)
 {
     ATCA_STATUS status;
     uint32_t execution_or_wait_time;
@@ -478,7 +507,7 @@ ATCA_STATUS calib_execute_command(ATCAPacket* packet, ATCADevice device)
         execution_or_wait_time = device->execution_time_msec;
         max_delay_count = 0;
 #else
-        execution_or_wait_time = ATCA_POLLING_INIT_TIME_MSEC;
+        execution_or_wait_time = calib_get_poll_first_wait(packet->opcode, device);
         max_delay_count = ATCA_POLLING_MAX_TIME_MSEC / ATCA_POLLING_FREQUENCY_TIME_MSEC;
 
     #if ATCA_CA2_SUPPORT
@@ -592,8 +621,10 @@ ATCA_STATUS calib_execute_command(ATCAPacket* packet, ATCADevice device)
     }
     while (0);
 
-    // Skip Idle for ECC204 device
-    if (!atcab_is_ca2_device(device->mIface.mIfaceCFG->devtype))
+    // Skip Idle for ECC204 device, or while a burst of commands is held awake.
+    // Any failure still idles the device so the next command starts clean.
+    if (!atcab_is_ca2_device(device->mIface.mIfaceCFG->devtype)
+        && (0u == device->hold_count || ATCA_SUCCESS != status))
     {
         (void)calib_idle(device);
         device->device_state = ATCA_DEVICE_STATE_IDLE;
@@ -601,3 +632,92 @@ ATCA_STATUS calib_execute_command(ATCAPacket* packet, ATCADevice device)
 
     return status;
 }
+
+/** \brief Wakes up device, sends the packet, waits for command completion,
+ *         receives response, and puts the device into the idle state.
+ *         Commands from several tasks are serialized on the device mutex.
+ *
+ * \param[in,out] packet  As input, the packet to be sent. As output, the
+ *                       data buffer in the packet structure will contain the
+ *                       response.
+ * \param[in]    device  CryptoAuthentication device to send the command to.
+ *
+ * \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+ATCA_STATUS calib_execute_command(ATCAPacket* packet, ATCADevice device)
+{
+    ATCA_STATUS status;
+
+    if (NULL == device)
+    {
+        return ATCA_BAD_PARAM;
+    }
+    if (ATCA_SUCCESS != (status = hal_lock_mutex(device->mutex)))
+    {
+        return status;
+    }
+    status = calib_execute_command_locked(packet, device);
+    (void)hal_unlock_mutex(device->mutex);
+
+    return status;
+}
+
+/** \brief Keeps the device awake across the following calib_execute_command()
+ *         calls so a burst of commands shares a single wake/idle cycle. Must
+ *         be balanced by calib_execute_release() once it succeeded. Bursts
+ *         should stay well below the device watchdog timeout (about 1.3 s).
+ *
+ * \param[in] device  CryptoAuthentication device the burst is sent to.
+ *
+ * \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+ATCA_STATUS calib_execute_hold(ATCADevice device)
+{
+    ATCA_STATUS status;
+
+    if (NULL == device)
+    {
+        return ATCA_BAD_PARAM;
+    }
+    if (ATCA_SUCCESS == (status = hal_lock_mutex(device->mutex)))
+    {
+        device->hold_count++;
+        (void)hal_unlock_mutex(device->mutex);
+    }
+
+    return status;
+}
+
+/** \brief Ends a burst started by calib_execute_hold(). The device is put
+ *         into the idle state when this call releases the outermost hold;
+ *         a release without a hold leaves the device alone.
+ *
+ * \param[in] device  CryptoAuthentication device the burst was sent to.
+ *
+ * \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+ATCA_STATUS calib_execute_release(ATCADevice device)
+{
+    ATCA_STATUS status;
+
+    if (NULL == device)
+    {
+        return ATCA_BAD_PARAM;
+    }
+    if (ATCA_SUCCESS != (status = hal_lock_mutex(device->mutex)))
+    {
+        return status;
+    }
+    if (0u < device->hold_count)
+    {
+        device->hold_count--;
+        if ((0u == device->hold_count) && (ATCA_DEVICE_STATE_ACTIVE == device->device_state))
+        {
+            status = calib_idle(device);
+            device->device_state = ATCA_DEVICE_STATE_IDLE;
+        }
+    }
+    (void)hal_unlock_mutex(device->mutex);
+
+    return status;
+}
@@ -69,6 +69,8 @@ ATCA_STATUS calib_execute_receive(ATCADevice device, uint8_t device_address, uin
 #endif
 
 ATCA_STATUS calib_execute_command(ATCAPacket* packet, ATCADevice device);
+ATCA_STATUS calib_execute_hold(ATCADevice device);
+ATCA_STATUS calib_execute_release(ATCADevice device);
 
 #ifdef __cplusplus
 }
@@ -33,6 +33,9 @@
 #include <stdio.h>
 
 #include "cryptoauthlib.h"
+#include "osal/osal.h"
+#include "FreeRTOS.h"
+#include "task.h"
 
 
 /** \defgroup hal_ Hardware abstraction layer (hal_)
@@ -75,6 +78,17 @@ ATCA_STATUS hal_i2c_discover_devices(int bus_num, ATCAIfaceCfg cfg[], int *found
     return ATCA_UNIMPLEMENTED;
 }
 
+/* Transfer-complete signal from the I2C PLIB interrupt. Once registered the
+   calling task blocks on it instead of spinning on is_busy() */
+static OSAL_SEM_DECLARE(hal_i2c_done_sem);
+static bool hal_i2c_async_ready = false;
+
+static void hal_i2c_transfer_done(uintptr_t context)
+{
+    (void)context;
+    (void)OSAL_SEM_PostISR(&hal_i2c_done_sem);
+}
+
 static ATCA_STATUS hal_i2c_wait(atca_plib_i2c_api_t* plib, uint32_t rate, uint16_t length)
 {
     ATCA_STATUS status = ATCA_SUCCESS;
@@ -102,6 +116,37 @@ static ATCA_STATUS hal_i2c_wait(atca_plib_i2c_api_t* plib, uint32_t rate, uint16
     return status;
 }
 
+/** \brief Wait for the transfer just started to complete. Blocks on the
+ *         transfer-complete interrupt when available so other tasks run
+ *         meanwhile, otherwise falls back to polling the PLIB.
+ */
+static ATCA_STATUS hal_i2c_wait_done(atca_plib_i2c_api_t* plib, uint32_t rate, uint16_t length)
+{
+    if (hal_i2c_async_ready && (taskSCHEDULER_RUNNING == xTaskGetSchedulerState()))
+    {
+        /* Transfer time in ms at the given rate, plus a tick of margin */
+        uint32_t timeout_ms = (((uint32_t)length + 2) * 9 * 1000) / rate + 2;
+
+        if (OSAL_RESULT_SUCCESS == OSAL_SEM_Pend(&hal_i2c_done_sem, (uint16_t)timeout_ms))
+        {
+            return ATCA_SUCCESS;
+        }
+        /* Missed or late interrupt: the PLIB state is still authoritative */
+    }
+    return hal_i2c_wait(plib, rate, length);
+}
+
+/** \brief Discard a completion left over from an earlier transfer (e.g. one
+ *         that timed out) before starting a new one.
+ */
+static void hal_i2c_clear_done(void)
+{
+    if (hal_i2c_async_ready)
+    {
+        (void)OSAL_SEM_Pend(&hal_i2c_done_sem, 0);
+    }
+}
+
 
 /** \brief
     - this HAL implementation assumes you've included the START Twi libraries in your project, otherwise,
@@ -122,6 +167,21 @@ static ATCA_STATUS hal_i2c_wait(atca_plib_i2c_api_t* plib, uint32_t rate, uint16
 
 ATCA_STATUS hal_i2c_init(ATCAIface iface, ATCAIfaceCfg *cfg)
 {
+    atca_plib_i2c_api_t * plib;
+
+    if ((NULL == cfg) || (NULL == (plib = (atca_plib_i2c_api_t*)cfg->cfg_data)))
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+    if (!hal_i2c_async_ready && (NULL != plib->callback_register))
+    {
+        if (OSAL_RESULT_SUCCESS == OSAL_SEM_Create(&hal_i2c_done_sem, OSAL_SEM_TYPE_BINARY, 1, 0))
+        {
+            plib->callback_register(hal_i2c_transfer_done, (uintptr_t)0);
+            hal_i2c_async_ready = true;
+        }
+    }
     return ATCA_SUCCESS;
 }
 
@@ -165,10 +225,11 @@ ATCA_STATUS hal_i2c_send(ATCAIface iface, uint8_t address, uint8_t *txdata, int
     if (ATCA_SUCCESS == status)
     {
         status = ATCA_COMM_FAIL;
+        hal_i2c_clear_done();
         if (plib->write(address >> 1, txdata, txlength) == true)
         {
             /* Wait for the I2C transfer to complete */
-            status = hal_i2c_wait(plib, cfg->atcai2c.baud, txlength);
+            status = hal_i2c_wait_done(plib, cfg->atcai2c.baud, txlength);
 
             if (ATCA_SUCCESS == status)
             {
@@ -210,10 +271,11 @@ ATCA_STATUS hal_i2c_receive(ATCAIface iface, uint8_t address, uint8_t *rxdata, u
 
     /* Read given length bytes from device */
     status = ATCA_COMM_FAIL;
+    hal_i2c_clear_done();
     if (plib->read(address >> 1, rxdata, *rxlength) == true)
     {
         /* Wait for the I2C transfer to complete */
-        if (ATCA_SUCCESS == (status = hal_i2c_wait(plib, cfg->atcai2c.baud, *rxlength)))
+        if (ATCA_SUCCESS == (status = hal_i2c_wait_done(plib, cfg->atcai2c.baud, *rxlength)))
         {
             /* Transfer complete. Check if the transfer was successful */
             if (plib->error_get() != PLIB_I2C_ERROR_NONE)
@@ -41,6 +41,7 @@ Microchip or any third party.
 #include "wolfssl/ssl.h"
 #include "wolfssl/wolfcrypt/logging.h"
 #include "wolfssl/wolfcrypt/random.h"
+#include "wolfssl/wolfcrypt/error-crypt.h"
 
 extern  int CheckAvailableSize(WOLFSSL *ssl, int size);
 #include "wolfssl/wolfcrypt/port/atmel/atmel.h"
@@ -54,6 +55,106 @@ typedef struct
     bool isInited;
 }net_pres_wolfsslInfo;
 
+#ifdef WOLFSSL_STATIC_MEMORY
+// Dedicated arena for the client context and its per-connection objects.
+// Keeps handshake and record buffers out of the shared heap_3 heap so that
+// repeated reconnects do not fragment it for the TCP/IP stack and Wi-Fi driver.
+// With a negotiated max fragment length the record buffers are small enough
+// for the general buckets and no dedicated IO pool is needed. The largest
+// general buckets still take a full record for servers that ignore it.
+static byte net_pres_wolfsslGenMem[NET_PRES_WOLFSSL_STATIC_GEN_MEM_SIZE];
+#ifndef NET_PRES_WOLFSSL_MAX_FRAGMENT
+static byte net_pres_wolfsslIOMem[NET_PRES_WOLFSSL_STATIC_IO_MEM_SIZE];
+#endif
+
+typedef struct
+{
+    word32 avaBlock[WOLFMEM_MAX_BUCKETS];   // free blocks per bucket right after partitioning
+    word32 avaIO;                           // free IO buffers right after partitioning
+    NET_PRES_EncProviderMemStats stats;
+}net_pres_wolfsslMemInfo;
+
+static net_pres_wolfsslMemInfo net_pres_wolfsslMem;
+
+static void _net_pres_wolfsslMemSample(WOLFSSL_CTX* ctx)
+{
+    WOLFSSL_MEM_STATS memStats;
+    uint32_t inUse = 0;
+    int i;
+
+    if (ctx == NULL || wolfSSL_CTX_is_static_memory(ctx, &memStats) != 1)
+    {
+        return;
+    }
+    for (i = 0; i < WOLFMEM_MAX_BUCKETS; i++)
+    {
+        inUse += (net_pres_wolfsslMem.avaBlock[i] - memStats.avaBlock[i]) * memStats.blockSz[i];
+    }
+    inUse += (net_pres_wolfsslMem.avaIO - memStats.avaIO) * WOLFMEM_IO_SZ;
+
+    net_pres_wolfsslMem.stats.inUse = inUse;
+    if (inUse > net_pres_wolfsslMem.stats.peakInUse)
+    {
+        net_pres_wolfsslMem.stats.peakInUse = inUse;
+    }
+    net_pres_wolfsslMem.stats.totalAlloc = memStats.totalAlloc;
+    net_pres_wolfsslMem.stats.totalFree = memStats.totalFr;
+}
+
+static void _net_pres_wolfsslConnSample(WOLFSSL* ssl)
+{
+    WOLFSSL_MEM_CONN_STATS connStats;
+
+    memset(&connStats, 0, sizeof(connStats));
+    if (wolfSSL_is_static_memory(ssl, &connStats) == 1 &&
+        connStats.peakMem > net_pres_wolfsslMem.stats.connPeak)
+    {
+        net_pres_wolfsslMem.stats.connPeak = connStats.peakMem;
+    }
+    _net_pres_wolfsslMemSample(wolfSSL_get_SSL_CTX(ssl));
+}
+
+static WOLFSSL_CTX* _net_pres_wolfsslStaticCtxNew(void)
+{
+    WOLFSSL_CTX* ctx = NULL;
+    WOLFSSL_MEM_STATS memStats;
+    int i;
+
+    memset(&net_pres_wolfsslMem, 0, sizeof(net_pres_wolfsslMem));
+    if (wolfSSL_CTX_load_static_memory(&ctx, wolfSSLv23_client_method_ex,
+            net_pres_wolfsslGenMem, sizeof(net_pres_wolfsslGenMem),
+            WOLFMEM_GENERAL | WOLFMEM_TRACK_STATS, NET_PRES_WOLFSSL_STATIC_MAX_CONN) != WOLFSSL_SUCCESS)
+    {
+        return NULL;
+    }
+#ifndef NET_PRES_WOLFSSL_MAX_FRAGMENT
+    if (wolfSSL_CTX_load_static_memory(&ctx, NULL,
+            net_pres_wolfsslIOMem, sizeof(net_pres_wolfsslIOMem),
+            WOLFMEM_IO_POOL, NET_PRES_WOLFSSL_STATIC_MAX_CONN) != WOLFSSL_SUCCESS)
+    {
+        wolfSSL_CTX_free(ctx);
+        return NULL;
+    }
+#endif
+
+    // Snapshot the partitioning: everything not free later on is in use.
+    if (wolfSSL_CTX_is_static_memory(ctx, &memStats) == 1)
+    {
+        for (i = 0; i < WOLFMEM_MAX_BUCKETS; i++)
+        {
+            net_pres_wolfsslMem.avaBlock[i] = memStats.avaBlock[i];
+        }
+        net_pres_wolfsslMem.avaIO = memStats.avaIO;
+    }
+    net_pres_wolfsslMem.stats.arenaSize = sizeof(net_pres_wolfsslGenMem);
+#ifndef NET_PRES_WOLFSSL_MAX_FRAGMENT
+    net_pres_wolfsslMem.stats.arenaSize += sizeof(net_pres_wolfsslIOMem);
+#endif
+    _net_pres_wolfsslMemSample(ctx);
+    return ctx;
+}
+#endif  // WOLFSSL_STATIC_MEMORY
+
 // Temporary fix till crypto library is upgraded to recent wolfssl versions.
 int  InitRng(RNG* rng)
 {
@@ -122,7 +223,11 @@ bool NET_PRES_EncProviderStreamClientInit0(NET_PRES_TransportObject * transObjec
         _net_pres_wolfsslUsers++;
     }
     net_pres_wolfSSLInfoStreamClient0.transObject = transObject;
+#ifdef WOLFSSL_STATIC_MEMORY
+    net_pres_wolfSSLInfoStreamClient0.context = _net_pres_wolfsslStaticCtxNew();
+#else
 	net_pres_wolfSSLInfoStreamClient0.context = wolfSSL_CTX_new(wolfSSLv23_client_method());
+#endif
     if (net_pres_wolfSSLInfoStreamClient0.context == 0)
     {
         return false;
@@ -164,6 +269,9 @@ bool NET_PRES_EncProviderStreamClientOpen0(uintptr_t transHandle, void * provide
         WOLFSSL* ssl = wolfSSL_new(net_pres_wolfSSLInfoStreamClient0.context);
         if (ssl == NULL)
         {
+#ifdef WOLFSSL_STATIC_MEMORY
+            net_pres_wolfsslMem.stats.allocFailures++;
+#endif
             return false;
         }
         if (wolfSSL_set_fd(ssl, transHandle) != SSL_SUCCESS)
@@ -175,6 +283,18 @@ bool NET_PRES_EncProviderStreamClientOpen0(uintptr_t transHandle, void * provide
         {
             return false;
         }
+#ifdef NET_PRES_WOLFSSL_MAX_FRAGMENT
+        // The TCP RX buffer is 1460 bytes and publishes are small: ask the
+        // server for short records so wolfSSL never grows 16 KB buffers.
+        if (wolfSSL_UseMaxFragment(ssl, NET_PRES_WOLFSSL_MAX_FRAGMENT) != WOLFSSL_SUCCESS)
+        {
+            wolfSSL_free(ssl);
+            return false;
+        }
+#endif
+#ifdef WOLFSSL_STATIC_MEMORY
+        _net_pres_wolfsslConnSample(ssl);
+#endif
         memcpy(providerData, &ssl, sizeof(WOLFSSL*));
         return true;
 }
@@ -187,6 +307,9 @@ NET_PRES_EncSessionStatus NET_PRES_EncProviderClientConnect0(void * providerData
     WOLFSSL* ssl;
     memcpy(&ssl, providerData, sizeof(WOLFSSL*));
     int result = wolfSSL_connect(ssl);
+#ifdef WOLFSSL_STATIC_MEMORY
+    _net_pres_wolfsslConnSample(ssl);
+#endif
     switch (result)
     {
         case SSL_SUCCESS:
@@ -194,6 +317,12 @@ NET_PRES_EncSessionStatus NET_PRES_EncProviderClientConnect0(void * providerData
         default:
         {
             int error = wolfSSL_get_error(ssl, result);
+#ifdef WOLFSSL_STATIC_MEMORY
+            if (error == MEMORY_E)
+            {
+                net_pres_wolfsslMem.stats.allocFailures++;
+            }
+#endif
             switch (error)
             {
                 case SSL_ERROR_WANT_READ:
@@ -209,7 +338,13 @@ NET_PRES_EncSessionStatus NET_PRES_EncProviderConnectionClose0(void * providerDa
 {
     WOLFSSL* ssl;
     memcpy(&ssl, providerData, sizeof(WOLFSSL*));
+#ifdef WOLFSSL_STATIC_MEMORY
+    _net_pres_wolfsslConnSample(ssl);
+#endif
     wolfSSL_free(ssl);
+#ifdef WOLFSSL_STATIC_MEMORY
+    _net_pres_wolfsslMemSample(net_pres_wolfSSLInfoStreamClient0.context);
+#endif
     return NET_PRES_ENC_SS_CLOSED;
 }
 int32_t NET_PRES_EncProviderWrite0(void * providerData, const uint8_t * buffer, uint16_t size)
@@ -314,3 +449,17 @@ int32_t NET_PRES_EncProviderMaxOutputSize0(void * providerData)
     }  
     return ret;
 }
+bool NET_PRES_EncProviderMemStatsGet0(NET_PRES_EncProviderMemStats * pStats)
+{
+#ifdef WOLFSSL_STATIC_MEMORY
+    if (pStats == NULL || !net_pres_wolfSSLInfoStreamClient0.isInited)
+    {
+        return false;
+    }
+    _net_pres_wolfsslMemSample(net_pres_wolfSSLInfoStreamClient0.context);
+    memcpy(pStats, &net_pres_wolfsslMem.stats, sizeof(NET_PRES_EncProviderMemStats));
+    return true;
+#else
+    return false;
+#endif
+}
@@ -43,6 +43,19 @@ Microchip or any third party.
 extern "C" {
 #endif
 extern NET_PRES_EncProviderObject net_pres_EncProviderStreamClient0;
+
+// Usage of the wolfSSL static memory arena (WOLFSSL_STATIC_MEMORY)
+typedef struct
+{
+    uint32_t arenaSize;         // bytes handed to wolfSSL (general + IO pools)
+    uint32_t inUse;             // bytes currently held by the context and its sessions
+    uint32_t peakInUse;         // high-water mark of inUse since the provider init
+    uint32_t connPeak;          // largest single-connection peak reported by wolfSSL
+    uint32_t totalAlloc;        // lifetime allocations served from the arena
+    uint32_t totalFree;         // lifetime frees returned to the arena
+    uint32_t allocFailures;     // session creations/handshakes failed for lack of memory
+}NET_PRES_EncProviderMemStats;
+
 bool NET_PRES_EncProviderStreamClientInit0(struct _NET_PRES_TransportObject * transObject);
 bool NET_PRES_EncProviderStreamClientDeinit0(void);
 bool NET_PRES_EncProviderStreamClientOpen0(uintptr_t transHandle, void * providerData);
@@ -56,6 +69,7 @@ int32_t NET_PRES_EncProviderReadReady0(void * providerData);
 int32_t NET_PRES_EncProviderPeek0(void * providerData, uint8_t * buffer, uint16_t size);
 int32_t NET_PRES_EncProviderOutputSize0(void * providerData, int32_t inSize);
 int32_t NET_PRES_EncProviderMaxOutputSize0(void * providerData);
+bool NET_PRES_EncProviderMemStatsGet0(NET_PRES_EncProviderMemStats * pStats);
 #define NET_PRES_SNI_HOST_NAME		"microchip.com"
 #ifdef __CPLUSPLUS
 }
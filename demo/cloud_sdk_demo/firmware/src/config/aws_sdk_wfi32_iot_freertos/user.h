@@ -38,6 +38,49 @@ extern "C" {
 #define WOLFSSL_DER_TO_PEM
 #define WOLFSSL_BASE64_ENCODE
 
+/* TLS sessions are served from a static arena, see net_pres_enc_glue.c.
+ * NO_WOLFSSL_MEMORY is removed from the wolfSSL section of configuration.h
+ * for it; if the configurator puts it back, settings.h stops the build */
+#define WOLFSSL_STATIC_MEMORY
+#define HAVE_MAX_FRAGMENT
+/* Ask the server for 2 KB records (WOLFSSL_MFL_2_11). Comment out to go back
+ * to full 16 KB records served from the IO pool */
+#define NET_PRES_WOLFSSL_MAX_FRAGMENT       WOLFSSL_MFL_2_11
+#ifdef NET_PRES_WOLFSSL_MAX_FRAGMENT
+/* Bucket counts for 64,128,256,512,1024,2432,3456,4544,16992 byte blocks.
+ * Record buffers fit the 2432 buckets and one large block holds the
+ * reassembled server certificate chain. The second large block takes a full
+ * 16 KB record, so a server that ignores the extension still gets through the
+ * handshake. Sized for one client session only: the session and its chain
+ * need most of the arena, so a second concurrent connection does not fit in
+ * the 100 KB, which is about what one session took from the heap before */
+#define LARGEST_MEM_BUCKET                  16992
+#define WOLFMEM_DIST                        40,10,6,12,5,8,4,2,2
+#define NET_PRES_WOLFSSL_STATIC_MAX_CONN    1
+#define NET_PRES_WOLFSSL_STATIC_GEN_MEM_SIZE    (100 * 1024)
+#else
+/* Bucket counts for 64,128,256,512,1024,2432,3456,4544,16128 byte blocks.
+ * Sized for one ECDHE-ECDSA client session with the peer chain kept; the
+ * 2432 buckets also take the big integers of the RSA server chain check */
+#define WOLFMEM_DIST                        40,10,6,12,5,8,4,2,1
+#define NET_PRES_WOLFSSL_STATIC_MAX_CONN    1
+#define NET_PRES_WOLFSSL_STATIC_GEN_MEM_SIZE    (80 * 1024)
+/* Input and output record buffer per connection, plus bucket headers */
+#define NET_PRES_WOLFSSL_STATIC_IO_MEM_SIZE     (2 * NET_PRES_WOLFSSL_STATIC_MAX_CONN * (WOLFMEM_IO_SZ + 32) + 16)
+#endif
+
+/* Seed the DRBG from the ECC608 and keep a prefetched pool of its output */
+#define WOLFSSL_ATECC_RNG
+#define ATECC_RNG_POOL_SIZE                 128
+
+/* Hashes of a length given up front (wc_Sha256SizeSet) stream through the
+ * engine instead of being gathered in the heap; used for firmware images */
+#define WOLFSSL_PIC32MZ_LARGE_HASH
+
+/* Traffic counters for Device Defender, see iot_metrics_pic32mzw1.c */
+#define WDRV_PIC32MZW_MAC_RX_PKT_INSPECT_HOOK   IotMetrics_MacRxInspect
+#define WDRV_PIC32MZW_MAC_TX_PKT_INSPECT_HOOK   IotMetrics_MacTxInspect
+
 
 #define LED_RED_On    LED_RED_Clear
 #define LED_YELLOW_On LED_YELLOW_Clear
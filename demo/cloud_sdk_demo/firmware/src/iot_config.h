@@ -29,14 +29,24 @@
 #define IOT_DEMO_SERVER                "a1gqt8sttiign3-ats.iot.us-east-2.amazonaws.com"
 #define IOT_DEMO_PORT                  ( 8883 )
 #define CLIENT_IDENTIFIER_MAX_LENGTH             ( 256 )
-#define KEEP_ALIVE_SECONDS                       ( 10 )
+/* Longest keep-alive accepted by AWS IoT; the PINGREQ interval is learned
+ * from the network, from IOT_MQTT_KEEP_ALIVE_MIN_MS up to this */
+#define KEEP_ALIVE_SECONDS                       ( 1200 )
+#define IOT_MQTT_KEEP_ALIVE_MIN_MS               ( 10000 )
+/* A learned limit is raised again after this many PINGREQs answered at it */
+#define IOT_MQTT_KEEP_ALIVE_LIMIT_HOLD           ( 32 )
 #define MQTT_TIMEOUT_MS                          ( 5000 )
 #define IOT_MQTT_RESPONSE_WAIT_MS                ( 5000 )
 #define AWS_IOT_MQTT_ENABLE_METRICS              ( 0 ) //(disabled to avoid setting/sending username in MQTT connect)
 #define PUBLISH_TOPIC_COUNT                       ( 1 )
-#define SUBSCRIBE_TOPIC_COUNT                    ( 1 )
 #define PUBLISH_RETRY_LIMIT                      ( 10 )
-#define PUBLISH_RETRY_MS                         ( 1000 )
+/* QoS 1 publishes awaiting a PUBACK; the retry period follows the PUBACK round
+ * trip time, starting from IOT_MQTT_ADAPTIVE_RETRY_INITIAL_MS */
+#define PUBLISH_WINDOW                           ( 4 )
+#define IOT_MQTT_ADAPTIVE_RETRY_INITIAL_MS       ( 1000 )
+/* Device Defender reports are encoded once into a static buffer; a report
+ * with every socket of the stack in use takes about 250 bytes */
+#define AWS_IOT_DEFENDER_REPORT_BUFFER_SIZE      ( 512 )
 
 /* Enable asserts in the libraries. */
 #define IOT_CONTAINERS_ENABLE_ASSERTS           ( 0 )
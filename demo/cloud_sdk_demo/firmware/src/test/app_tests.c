@@ -0,0 +1,50 @@
+/*******************************************************************************
+  MPLAB Harmony Application Test Source File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_tests.c
+
+  Summary:
+    Test runner for the host tests of the application.
+
+  Description:
+    Only the application modules that do not depend on the TCP/IP stack, the
+    drivers or FreeRTOS are tested on a host. They build with the test
+    framework and the test application of the AWS libraries, see
+    CMakeLists.txt in this directory.
+ *******************************************************************************/
+
+/* Standard includes. */
+#include <stdbool.h>
+
+/* Test framework includes. */
+#include "unity_fixture.h"
+
+// *****************************************************************************
+
+/* Runs the application test groups. None of them needs the network; the
+ * reconnect soak of the TLS memory takes a few minutes */
+void RunAppTests( bool disableNetworkTests, bool disableLongTests )
+{
+    /* Silence warnings about unused parameters. */
+    ( void ) disableNetworkTests;
+
+    RUN_TEST_GROUP( APP_Unit_DhcpLease );
+    RUN_TEST_GROUP( APP_Unit_DnsCache );
+    RUN_TEST_GROUP( APP_Unit_Ps );
+    RUN_TEST_GROUP( APP_Unit_ProvHttp );
+    RUN_TEST_GROUP( APP_Unit_Ota );
+    RUN_TEST_GROUP( APP_Unit_Atca );
+
+    if( disableLongTests == false )
+    {
+        RUN_TEST_GROUP( APP_Unit_TlsMem );
+    }
+}
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,37 @@
+/*******************************************************************************
+  System Definitions for the Host Tests
+
+  File Name:
+    definitions.h
+
+  Summary:
+    Stands in for the generated definitions.h when cryptoauthlib is built on
+    a host.
+
+  Description:
+    atca_config.h of the aws_sdk_wfi32_iot_freertos configuration includes
+    definitions.h for the I2C peripheral library types of its HAL. The host
+    tests replace the HAL, so only those types are declared here.
+ *******************************************************************************/
+
+#ifndef DEFINITIONS_H
+#define DEFINITIONS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int I2C_ERROR;
+#define I2C_ERROR_NONE  0
+
+typedef struct
+{
+    uint32_t clkSpeed;
+}I2C_TRANSFER_SETUP;
+
+typedef void (* I2C_CALLBACK)( uintptr_t contextHandle );
+
+#endif // DEFINITIONS_H
+/*******************************************************************************
+ End of File
+*/
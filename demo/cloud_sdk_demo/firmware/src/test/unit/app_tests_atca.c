@@ -0,0 +1,450 @@
+/*******************************************************************************
+  MPLAB Harmony Application Test Source File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_tests_atca.c
+
+  Summary:
+    Tests for the command bursts of the ECC608 against a simulated device.
+
+  Description:
+    The command execution and the device object of cryptoauthlib run
+    unchanged; the interface below them is a simulated ECC608 on a 400 kHz
+    I2C bus. It counts wake and idle cycles and the bus time they take, and it
+    flags a command sent while another one is in flight and an idle that cuts
+    a command short. Covers that a burst between calib_execute_hold() and
+    calib_execute_release() shares one wake cycle, that only the release of
+    the outermost hold idles the device, and that bursts and single commands
+    from two tasks stay apart on the device mutex.
+ *******************************************************************************/
+
+/* Standard includes. */
+#include <string.h>
+
+/* Platform layer includes. */
+#include "platform/iot_clock.h"
+#include "platform/iot_threads.h"
+
+/* Module under test. */
+#include "cryptoauthlib.h"
+#include "calib/calib_basic.h"
+#include "calib/calib_command.h"
+#include "calib/calib_execution.h"
+
+/* Test framework includes. */
+#include "unity_fixture.h"
+
+// *****************************************************************************
+
+/* Simulated bus and device timing, in microseconds. One byte with its
+ * acknowledge at 400 kHz, the wake pulse plus tWHI, and Random, which is
+ * assumed to take 1 ms */
+#define TEST_BYTE_us            25U
+#define TEST_WAKE_us            (60U + 1500U)
+#define TEST_RANDOM_us          1000U
+
+/* Random output, as in atmel_read_random() refilling a 128-byte pool */
+#define TEST_RANDOM_LEN         32U
+#define TEST_POOL_LEN           128U
+
+/* Bursts and single commands of the two tasks */
+#define TEST_TASK_BURSTS        100U
+#define TEST_TASK_SINGLES       200U
+
+typedef struct
+{
+    bool     awake;
+    bool     inFlight;          // a command was sent and its response not read
+    uint64_t readyAt_us;        // when the command in flight completes
+    uint8_t  response[1 + TEST_RANDOM_LEN + 2];
+    uint64_t now_us;            // simulated time
+    uint64_t bus_us;            // time the bus and the device were busy
+    uint32_t wakes;
+    uint32_t idles;
+    uint32_t commands;
+    uint32_t violations;        // command while asleep or in flight, idle in flight
+}TEST_ECC608;
+
+static TEST_ECC608 ecc608;
+
+static ATCAIfaceCfg deviceCfg;
+static struct atca_device device;
+
+/* Backs the device mutex; the device object creates one */
+static IotMutex_t deviceMutex;
+
+/* Signals the end of the burst task */
+static IotSemaphore_t taskDone;
+static volatile uint32_t taskFailures;
+
+// *****************************************************************************
+// Simulated ECC608 and HAL
+
+static void _busTime(uint32_t us)
+{
+    ecc608.now_us += us;
+    ecc608.bus_us += us;
+}
+
+ATCA_STATUS initATCAIface(ATCAIfaceCfg *cfg, ATCAIface ca_iface)
+{
+    memset(ca_iface, 0, sizeof(*ca_iface));
+    ca_iface->mIfaceCFG = cfg;
+    return ATCA_SUCCESS;
+}
+
+ATCA_STATUS releaseATCAIface(ATCAIface ca_iface)
+{
+    return ATCA_SUCCESS;
+}
+
+ATCA_STATUS atcontrol(ATCAIface ca_iface, uint8_t option, void* param, size_t paramlen)
+{
+    return ATCA_UNIMPLEMENTED;
+}
+
+ATCA_STATUS atsend(ATCAIface ca_iface, uint8_t word_address, uint8_t *txdata, int txlength)
+{
+    _busTime((uint32_t)(txlength + 1) * TEST_BYTE_us);
+    if (!ecc608.awake)
+    {
+        ecc608.violations++;
+        return ATCA_TX_FAIL;
+    }
+    if (txlength == 1)
+    {
+        // Word address before a read: not acknowledged while busy
+        return (ecc608.now_us < ecc608.readyAt_us) ? ATCA_TX_FAIL : ATCA_SUCCESS;
+    }
+    if (ecc608.inFlight)
+    {
+        ecc608.violations++;
+    }
+    ecc608.inFlight = true;
+    ecc608.readyAt_us = ecc608.now_us + TEST_RANDOM_us;
+    ecc608.commands++;
+    ecc608.response[0] = sizeof(ecc608.response);
+    memset(&ecc608.response[1], (int)(ecc608.commands & 0xFF), TEST_RANDOM_LEN);
+    return ATCA_SUCCESS;
+}
+
+ATCA_STATUS atreceive(ATCAIface ca_iface, uint8_t word_address, uint8_t *rxdata, uint16_t *rxlength)
+{
+    _busTime((uint32_t)(*rxlength + 1) * TEST_BYTE_us);
+    if (!ecc608.awake || !ecc608.inFlight || ecc608.now_us < ecc608.readyAt_us)
+    {
+        return ATCA_RX_NO_RESPONSE;
+    }
+    if (*rxlength == 1)
+    {
+        rxdata[0] = ecc608.response[0];
+    }
+    else
+    {
+        memcpy(rxdata, &ecc608.response[1], *rxlength);
+        ecc608.inFlight = false;
+    }
+    return ATCA_SUCCESS;
+}
+
+ATCA_STATUS calib_wakeup(ATCADevice device)
+{
+    _busTime(TEST_WAKE_us + 4U * TEST_BYTE_us);
+    ecc608.awake = true;
+    ecc608.wakes++;
+    return ATCA_SUCCESS;
+}
+
+ATCA_STATUS calib_idle(ATCADevice device)
+{
+    _busTime(2U * TEST_BYTE_us);
+    if (ecc608.inFlight)
+    {
+        ecc608.violations++;
+    }
+    ecc608.awake = false;
+    ecc608.idles++;
+    return ATCA_SUCCESS;
+}
+
+ATCA_STATUS atCheckCrc(const uint8_t *response)
+{
+    return ATCA_SUCCESS;
+}
+
+ATCA_STATUS isATCAError(uint8_t *data)
+{
+    return ATCA_SUCCESS;
+}
+
+ATCA_STATUS atca_trace(ATCA_STATUS status)
+{
+    return status;
+}
+
+bool atca_iface_is_kit(ATCAIface ca_iface)
+{
+    return false;
+}
+
+int atca_iface_get_retries(ATCAIface ca_iface)
+{
+    return 1;
+}
+
+uint8_t atcab_get_device_address(ATCADevice device)
+{
+    return 0xC0;
+}
+
+bool atcab_is_ca2_device(ATCADeviceType dev_type)
+{
+    return false;
+}
+
+/* Delays advance the simulated time and let the other task run */
+void hal_rtos_delay_ms(uint32_t ms)
+{
+    ecc608.now_us += (uint64_t)ms * 1000U;
+    IotClock_SleepMs(0);
+}
+
+ATCA_STATUS hal_create_mutex(void ** ppMutex, char* pName)
+{
+    if (!IotMutex_Create(&deviceMutex, false))
+    {
+        return ATCA_FUNC_FAIL;
+    }
+    *ppMutex = &deviceMutex;
+    return ATCA_SUCCESS;
+}
+
+ATCA_STATUS hal_destroy_mutex(void * pMutex)
+{
+    IotMutex_Destroy((IotMutex_t *)pMutex);
+    return ATCA_SUCCESS;
+}
+
+ATCA_STATUS hal_lock_mutex(void * pMutex)
+{
+    if (pMutex == NULL)
+    {
+        return ATCA_BAD_PARAM;
+    }
+    IotMutex_Lock((IotMutex_t *)pMutex);
+    return ATCA_SUCCESS;
+}
+
+ATCA_STATUS hal_unlock_mutex(void * pMutex)
+{
+    if (pMutex == NULL)
+    {
+        return ATCA_BAD_PARAM;
+    }
+    IotMutex_Unlock((IotMutex_t *)pMutex);
+    return ATCA_SUCCESS;
+}
+
+// *****************************************************************************
+
+static ATCA_STATUS _random(uint8_t* out)
+{
+    ATCAPacket packet;
+    ATCA_STATUS status;
+
+    memset(&packet, 0, sizeof(packet));
+    packet.txsize = RANDOM_COUNT;
+    packet.opcode = ATCA_RANDOM;
+    status = calib_execute_command(&packet, &device);
+    if (status == ATCA_SUCCESS)
+    {
+        memcpy(out, &packet.data[1], TEST_RANDOM_LEN);
+    }
+    return status;
+}
+
+/* Fills a pool the way atmel_read_random() does, held or not */
+static ATCA_STATUS _fillPool(bool hold)
+{
+    uint8_t pool[TEST_POOL_LEN];
+    ATCA_STATUS status = ATCA_SUCCESS;
+    uint32_t i;
+
+    if (hold && (status = calib_execute_hold(&device)) != ATCA_SUCCESS)
+    {
+        return status;
+    }
+    for (i = 0; i < TEST_POOL_LEN && status == ATCA_SUCCESS; i += TEST_RANDOM_LEN)
+    {
+        status = _random(&pool[i]);
+    }
+    if (hold)
+    {
+        (void)calib_execute_release(&device);
+    }
+    return status;
+}
+
+static void _burstTask(void * pArgument)
+{
+    uint32_t i;
+
+    for (i = 0; i < TEST_TASK_BURSTS; i++)
+    {
+        if (_fillPool(true) != ATCA_SUCCESS)
+        {
+            taskFailures++;
+        }
+    }
+    IotSemaphore_Post(&taskDone);
+}
+
+// *****************************************************************************
+
+TEST_GROUP( APP_Unit_Atca );
+
+TEST_SETUP( APP_Unit_Atca )
+{
+    memset(&ecc608, 0, sizeof(ecc608));
+    memset(&deviceCfg, 0, sizeof(deviceCfg));
+    deviceCfg.iface_type = ATCA_I2C_IFACE;
+    deviceCfg.devtype = ATECC608;
+    memset(&device, 0, sizeof(device));
+    TEST_ASSERT_EQUAL_INT( ATCA_SUCCESS, initATCADevice( &deviceCfg, &device ) );
+    TEST_ASSERT_NOT_NULL( device.mutex );
+}
+
+TEST_TEAR_DOWN( APP_Unit_Atca )
+{
+    TEST_ASSERT_EQUAL_INT( ATCA_SUCCESS, releaseATCADevice( &device ) );
+    TEST_ASSERT_NULL( device.mutex );
+}
+
+TEST_GROUP_RUNNER( APP_Unit_Atca )
+{
+    RUN_TEST_CASE( APP_Unit_Atca, SingleCommandIdles );
+    RUN_TEST_CASE( APP_Unit_Atca, BurstSharesOneWake );
+    RUN_TEST_CASE( APP_Unit_Atca, NestedHolds );
+    RUN_TEST_CASE( APP_Unit_Atca, ReleaseWithoutHold );
+    RUN_TEST_CASE( APP_Unit_Atca, TwoTasks );
+}
+
+// *****************************************************************************
+
+/* Without a hold every command has its own wake cycle */
+TEST( APP_Unit_Atca, SingleCommandIdles )
+{
+    uint8_t out[TEST_RANDOM_LEN];
+
+    TEST_ASSERT_EQUAL_INT( ATCA_SUCCESS, _random( out ) );
+    TEST_ASSERT_EQUAL_UINT32( 1, ecc608.wakes );
+    TEST_ASSERT_EQUAL_UINT32( 1, ecc608.idles );
+    TEST_ASSERT_EQUAL_INT( ATCA_DEVICE_STATE_IDLE, device.device_state );
+    TEST_ASSERT_EQUAL_UINT32( 0, ecc608.violations );
+}
+
+/* A held pool fill wakes the device once instead of once per command and
+ * saves the bus time of the other wake cycles */
+TEST( APP_Unit_Atca, BurstSharesOneWake )
+{
+    uint64_t single_us;
+    uint64_t held_us;
+    uint32_t commands = TEST_POOL_LEN / TEST_RANDOM_LEN;
+
+    TEST_ASSERT_EQUAL_INT( ATCA_SUCCESS, _fillPool( false ) );
+    TEST_ASSERT_EQUAL_UINT32( commands, ecc608.wakes );
+    TEST_ASSERT_EQUAL_UINT32( commands, ecc608.idles );
+    single_us = ecc608.bus_us;
+
+    memset(&ecc608, 0, sizeof(ecc608));
+    TEST_ASSERT_EQUAL_INT( ATCA_SUCCESS, _fillPool( true ) );
+    TEST_ASSERT_EQUAL_UINT32( commands, ecc608.commands );
+    TEST_ASSERT_EQUAL_UINT32( 1, ecc608.wakes );
+    TEST_ASSERT_EQUAL_UINT32( 1, ecc608.idles );
+    TEST_ASSERT_EQUAL_INT( ATCA_DEVICE_STATE_IDLE, device.device_state );
+    TEST_ASSERT_EQUAL_UINT32( 0, device.hold_count );
+    held_us = ecc608.bus_us;
+
+    TEST_ASSERT_EQUAL_UINT32( (commands - 1) * (TEST_WAKE_us + 6U * TEST_BYTE_us), (uint32_t)(single_us - held_us) );
+    TEST_ASSERT_EQUAL_UINT32( 0, ecc608.violations );
+}
+
+/* Only the release of the outermost hold idles the device */
+TEST( APP_Unit_Atca, NestedHolds )
+{
+    uint8_t out[TEST_RANDOM_LEN];
+
+    TEST_ASSERT_EQUAL_INT( ATCA_SUCCESS, calib_execute_hold( &device ) );
+    TEST_ASSERT_EQUAL_INT( ATCA_SUCCESS, calib_execute_hold( &device ) );
+    TEST_ASSERT_EQUAL_INT( ATCA_SUCCESS, _random( out ) );
+    TEST_ASSERT_EQUAL_INT( ATCA_SUCCESS, calib_execute_release( &device ) );
+    TEST_ASSERT_EQUAL_UINT32( 0, ecc608.idles );
+    TEST_ASSERT_EQUAL_INT( ATCA_DEVICE_STATE_ACTIVE, device.device_state );
+
+    TEST_ASSERT_EQUAL_INT( ATCA_SUCCESS, _random( out ) );
+    TEST_ASSERT_EQUAL_INT( ATCA_SUCCESS, calib_execute_release( &device ) );
+    TEST_ASSERT_EQUAL_UINT32( 1, ecc608.wakes );
+    TEST_ASSERT_EQUAL_UINT32( 1, ecc608.idles );
+    TEST_ASSERT_EQUAL_UINT32( 0, device.hold_count );
+}
+
+/* A release without a hold neither idles an awake device nor goes below zero */
+TEST( APP_Unit_Atca, ReleaseWithoutHold )
+{
+    uint8_t out[TEST_RANDOM_LEN];
+
+    /* Woken by someone else, for example atcab_wakeup(). */
+    TEST_ASSERT_EQUAL_INT( ATCA_SUCCESS, calib_wakeup( &device ) );
+    device.device_state = ATCA_DEVICE_STATE_ACTIVE;
+
+    TEST_ASSERT_EQUAL_INT( ATCA_SUCCESS, calib_execute_release( &device ) );
+    TEST_ASSERT_EQUAL_UINT32( 0, ecc608.idles );
+    TEST_ASSERT_EQUAL_INT( ATCA_DEVICE_STATE_ACTIVE, device.device_state );
+    TEST_ASSERT_EQUAL_UINT32( 0, device.hold_count );
+
+    /* The next hold still counts from zero. */
+    TEST_ASSERT_EQUAL_INT( ATCA_SUCCESS, calib_execute_hold( &device ) );
+    TEST_ASSERT_EQUAL_INT( ATCA_SUCCESS, _random( out ) );
+    TEST_ASSERT_EQUAL_UINT32( 0, ecc608.idles );
+    TEST_ASSERT_EQUAL_INT( ATCA_SUCCESS, calib_execute_release( &device ) );
+    TEST_ASSERT_EQUAL_UINT32( 1, ecc608.idles );
+    TEST_ASSERT_EQUAL_UINT32( 0, ecc608.violations );
+}
+
+/* Bursts of one task and single commands of another share the device: no
+ * command overlaps another and no idle cuts one short */
+TEST( APP_Unit_Atca, TwoTasks )
+{
+    uint8_t out[TEST_RANDOM_LEN];
+    uint32_t i;
+    uint32_t failures = 0;
+
+    taskFailures = 0;
+    TEST_ASSERT_TRUE( IotSemaphore_Create( &taskDone, 0, 1 ) );
+    TEST_ASSERT_TRUE( Iot_CreateDetachedThread( _burstTask, NULL, IOT_THREAD_DEFAULT_PRIORITY,
+                                                IOT_THREAD_DEFAULT_STACK_SIZE ) );
+    for (i = 0; i < TEST_TASK_SINGLES; i++)
+    {
+        if (_random(out) != ATCA_SUCCESS)
+        {
+            failures++;
+        }
+    }
+    IotSemaphore_Wait(&taskDone);
+    IotSemaphore_Destroy(&taskDone);
+
+    TEST_ASSERT_EQUAL_UINT32( 0, failures );
+    TEST_ASSERT_EQUAL_UINT32( 0, taskFailures );
+    TEST_ASSERT_EQUAL_UINT32( TEST_TASK_SINGLES + TEST_TASK_BURSTS * (TEST_POOL_LEN / TEST_RANDOM_LEN), ecc608.commands );
+    TEST_ASSERT_EQUAL_UINT32( 0, ecc608.violations );
+    TEST_ASSERT_EQUAL_UINT32( ecc608.wakes, ecc608.idles );
+    TEST_ASSERT_EQUAL_UINT32( 0, device.hold_count );
+    TEST_ASSERT_EQUAL_INT( ATCA_DEVICE_STATE_IDLE, device.device_state );
+}
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,166 @@
+/*******************************************************************************
+  MPLAB Harmony Application Test Source File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_tests_dhcp_lease.c
+
+  Summary:
+    Tests for the decisions of the DHCP lease cache.
+
+  Description:
+    Covers when a cached lease applies to a new link, when it is used before
+    the ACK of the INIT-REBOOT REQUEST, and when a renewal is stored.
+ *******************************************************************************/
+
+/* Standard includes. */
+#include <string.h>
+
+/* Module under test. */
+#include "app_dhcp_lease_policy.h"
+
+/* Test framework includes. */
+#include "unity_fixture.h"
+
+// *****************************************************************************
+
+/* SSID hash and BSSID the lease was obtained on */
+#define TEST_SSID_HASH      0x12345678
+/* A UTC time in the range the device sees */
+#define TEST_NOW            1700000000U
+/* One day */
+#define TEST_LEASE_s        86400U
+
+static const uint8_t leaseBssid[APP_DHCP_LEASE_BSSID_LEN] = { 0x00, 0x04, 0xA3, 0x11, 0x22, 0x33 };
+
+// *****************************************************************************
+
+TEST_GROUP( APP_Unit_DhcpLease );
+
+TEST_SETUP( APP_Unit_DhcpLease )
+{
+}
+
+TEST_TEAR_DOWN( APP_Unit_DhcpLease )
+{
+}
+
+TEST_GROUP_RUNNER( APP_Unit_DhcpLease )
+{
+    RUN_TEST_CASE( APP_Unit_DhcpLease, MatchesSameBss );
+    RUN_TEST_CASE( APP_Unit_DhcpLease, PathWithoutMatch );
+    RUN_TEST_CASE( APP_Unit_DhcpLease, PathCachedWhileLeaseRuns );
+    RUN_TEST_CASE( APP_Unit_DhcpLease, PathInitRebootWithoutTrustedTime );
+    RUN_TEST_CASE( APP_Unit_DhcpLease, PathInitRebootNearExpiry );
+    RUN_TEST_CASE( APP_Unit_DhcpLease, PathAcrossTimeWrap );
+    RUN_TEST_CASE( APP_Unit_DhcpLease, Expiry );
+    RUN_TEST_CASE( APP_Unit_DhcpLease, StoreDue );
+}
+
+// *****************************************************************************
+
+/* Only the network and BSS the lease came from, once the BSS is known */
+TEST( APP_Unit_DhcpLease, MatchesSameBss )
+{
+    uint8_t bssid[APP_DHCP_LEASE_BSSID_LEN];
+
+    memcpy(bssid, leaseBssid, sizeof(bssid));
+    TEST_ASSERT_TRUE( APP_DHCP_LeasePolicyMatches( TEST_SSID_HASH, leaseBssid, TEST_SSID_HASH, bssid ) );
+
+    /* Unknown BSS: no fast connect was tried. */
+    TEST_ASSERT_FALSE( APP_DHCP_LeasePolicyMatches( TEST_SSID_HASH, leaseBssid, TEST_SSID_HASH, NULL ) );
+
+    /* Another network. */
+    TEST_ASSERT_FALSE( APP_DHCP_LeasePolicyMatches( TEST_SSID_HASH, leaseBssid, TEST_SSID_HASH + 1, bssid ) );
+
+    /* Another AP of the same network; only the last byte differs. */
+    bssid[APP_DHCP_LEASE_BSSID_LEN - 1] ^= 1;
+    TEST_ASSERT_FALSE( APP_DHCP_LeasePolicyMatches( TEST_SSID_HASH, leaseBssid, TEST_SSID_HASH, bssid ) );
+}
+
+/* Without a matching lease the client is left to itself, whatever the time */
+TEST( APP_Unit_DhcpLease, PathWithoutMatch )
+{
+    TEST_ASSERT_EQUAL( APP_DHCP_LEASE_PATH_CLIENT,
+                       APP_DHCP_LeasePolicyPath( false, TEST_NOW + TEST_LEASE_s, TEST_NOW, true ) );
+    TEST_ASSERT_EQUAL( APP_DHCP_LEASE_PATH_CLIENT,
+                       APP_DHCP_LeasePolicyPath( false, 0, 0, false ) );
+}
+
+/* A lease known to run for a while is used before the ACK */
+TEST( APP_Unit_DhcpLease, PathCachedWhileLeaseRuns )
+{
+    TEST_ASSERT_EQUAL( APP_DHCP_LEASE_PATH_CACHED,
+                       APP_DHCP_LeasePolicyPath( true, TEST_NOW + TEST_LEASE_s, TEST_NOW, true ) );
+    TEST_ASSERT_EQUAL( APP_DHCP_LEASE_PATH_CACHED,
+                       APP_DHCP_LeasePolicyPath( true, TEST_NOW + APP_DHCP_LEASE_MIN_REMAINING_s + 1, TEST_NOW, true ) );
+}
+
+/* Without a trusted time, or an expiry, the address is only asked for */
+TEST( APP_Unit_DhcpLease, PathInitRebootWithoutTrustedTime )
+{
+    /* Time from the RTCC not confirmed yet. */
+    TEST_ASSERT_EQUAL( APP_DHCP_LEASE_PATH_INIT_REBOOT,
+                       APP_DHCP_LeasePolicyPath( true, TEST_NOW + TEST_LEASE_s, TEST_NOW, false ) );
+
+    /* No time at all. */
+    TEST_ASSERT_EQUAL( APP_DHCP_LEASE_PATH_INIT_REBOOT,
+                       APP_DHCP_LeasePolicyPath( true, TEST_NOW + TEST_LEASE_s, 0, true ) );
+
+    /* The lease was obtained before the time was known. */
+    TEST_ASSERT_EQUAL( APP_DHCP_LEASE_PATH_INIT_REBOOT,
+                       APP_DHCP_LeasePolicyPath( true, 0, TEST_NOW, true ) );
+}
+
+/* A lease about to run out, or run out during the reset, is only asked for */
+TEST( APP_Unit_DhcpLease, PathInitRebootNearExpiry )
+{
+    TEST_ASSERT_EQUAL( APP_DHCP_LEASE_PATH_INIT_REBOOT,
+                       APP_DHCP_LeasePolicyPath( true, TEST_NOW + APP_DHCP_LEASE_MIN_REMAINING_s, TEST_NOW, true ) );
+    TEST_ASSERT_EQUAL( APP_DHCP_LEASE_PATH_INIT_REBOOT,
+                       APP_DHCP_LeasePolicyPath( true, TEST_NOW, TEST_NOW, true ) );
+    TEST_ASSERT_EQUAL( APP_DHCP_LEASE_PATH_INIT_REBOOT,
+                       APP_DHCP_LeasePolicyPath( true, TEST_NOW - TEST_LEASE_s, TEST_NOW, true ) );
+}
+
+/* The remaining time is taken modulo 2^32 */
+TEST( APP_Unit_DhcpLease, PathAcrossTimeWrap )
+{
+    TEST_ASSERT_EQUAL( APP_DHCP_LEASE_PATH_CACHED,
+                       APP_DHCP_LeasePolicyPath( true, TEST_LEASE_s / 2, UINT32_MAX - TEST_LEASE_s / 2, true ) );
+    TEST_ASSERT_EQUAL( APP_DHCP_LEASE_PATH_INIT_REBOOT,
+                       APP_DHCP_LeasePolicyPath( true, UINT32_MAX - TEST_LEASE_s, TEST_LEASE_s, true ) );
+}
+
+/* The expiry is only recorded against a trusted time */
+TEST( APP_Unit_DhcpLease, Expiry )
+{
+    TEST_ASSERT_EQUAL_UINT32( TEST_NOW + TEST_LEASE_s, APP_DHCP_LeasePolicyExpiry( TEST_LEASE_s, TEST_NOW, true ) );
+    TEST_ASSERT_EQUAL_UINT32( 0, APP_DHCP_LeasePolicyExpiry( TEST_LEASE_s, TEST_NOW, false ) );
+    TEST_ASSERT_EQUAL_UINT32( 0, APP_DHCP_LeasePolicyExpiry( TEST_LEASE_s, 0, true ) );
+}
+
+/* Renewals are stored once they moved the expiry by a day, shorter leases at once */
+TEST( APP_Unit_DhcpLease, StoreDue )
+{
+    uint32_t stored = TEST_NOW + TEST_LEASE_s;
+
+    /* Renewal half-way through the lease. */
+    TEST_ASSERT_FALSE( APP_DHCP_LeasePolicyStoreDue( stored + TEST_LEASE_s / 2, stored ) );
+    TEST_ASSERT_TRUE( APP_DHCP_LeasePolicyStoreDue( stored + APP_DHCP_LEASE_STORE_INTERVAL_s, stored ) );
+
+    /* The server shortened the lease. */
+    TEST_ASSERT_TRUE( APP_DHCP_LeasePolicyStoreDue( stored - 1, stored ) );
+
+    /* Nothing stored yet. */
+    TEST_ASSERT_TRUE( APP_DHCP_LeasePolicyStoreDue( stored, 0 ) );
+
+    /* Unknown expiry: nothing to move. */
+    TEST_ASSERT_FALSE( APP_DHCP_LeasePolicyStoreDue( 0, stored ) );
+}
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,517 @@
+/*******************************************************************************
+  MPLAB Harmony Application Test Source File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_tests_dns_cache.c
+
+  Summary:
+    Tests for the decisions of the persistent DNS cache.
+
+  Description:
+    A scripted DNS server answers the lookups, and only some addresses accept
+    a connection. The tests dial the endpoint the way _dnsLookupAndConnect()
+    of iot_network_wolfssl.c does and run the background refresh of
+    APP_DNS_Cache_Tasks() in between. They cover stale entries, which are
+    still dialed while they are refreshed, and wrong ones, which are caught
+    by the connect timeout and replaced.
+ *******************************************************************************/
+
+/* Standard includes. */
+#include <string.h>
+
+/* Module under test. */
+#include "app_dns_cache_policy.h"
+
+/* Test framework includes. */
+#include "unity_fixture.h"
+
+// *****************************************************************************
+
+#define TEST_HOST           "a1b2c3d4e5f6g7-ats.iot.us-east-2.amazonaws.com"
+/* A UTC time in the range the device sees */
+#define TEST_NOW            1700000000U
+/* TTL of the endpoint records */
+#define TEST_TTL_s          60U
+/* Costs of the steps of a connection, in ms. The connect timeout is
+ * APP_DNS_CACHE_CONNECT_TMO_s of app_dns_cache.h */
+#define TEST_DNS_RTT_ms     120U
+#define TEST_TCP_RTT_ms     40U
+#define TEST_CONNECT_TMO_ms 3000U
+
+#define TEST_ADDR_A         0x0A01A8C0U
+#define TEST_ADDR_B         0x0B01A8C0U
+#define TEST_ADDR_C         0x0C01A8C0U
+
+/* One answer of the scripted DNS server; no addresses for a lost query */
+typedef struct
+{
+    uint8_t nAddr;
+    uint32_t addr[APP_DNS_CACHE_MAX_ADDR];
+    uint32_t ttl;
+} TEST_DNS_ANSWER;
+
+/* Outcome of one connection attempt */
+typedef struct
+{
+    bool connected;
+    APP_DNS_CACHE_LOOKUP lookup;
+    uint32_t addr;
+    uint32_t elapsed_ms;
+} TEST_DIAL;
+
+static APP_DNS_CACHE_ENTRY entry;
+static const TEST_DNS_ANSWER* script;
+static size_t scriptLen;
+static size_t nQueries;
+/* Addresses that accept a connection */
+static const uint32_t* liveAddr;
+static size_t nLiveAddr;
+static uint32_t now;
+static bool timeTrusted;
+/* The background refresh completes while a connection is being dialed */
+static bool refreshWhileDialing;
+
+// *****************************************************************************
+
+static void serverScript(const TEST_DNS_ANSWER* answers, size_t nAnswers)
+{
+    script = answers;
+    scriptLen = nAnswers;
+    nQueries = 0;
+}
+
+static void serverLive(const uint32_t* addr, size_t nAddr)
+{
+    liveAddr = addr;
+    nLiveAddr = nAddr;
+}
+
+/* The next answer of the script; the last one repeats */
+static const TEST_DNS_ANSWER* serverQuery(void)
+{
+    const TEST_DNS_ANSWER* answer;
+
+    TEST_ASSERT_TRUE( scriptLen > 0 );
+    answer = &script[(nQueries < scriptLen) ? nQueries : (scriptLen - 1)];
+    nQueries++;
+    return answer;
+}
+
+static bool isLive(uint32_t addr)
+{
+    size_t ix;
+
+    for (ix = 0; ix < nLiveAddr; ix++) {
+        if (liveAddr[ix] == addr) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* One pass of APP_DNS_Cache_Tasks() while online with a trusted time.
+ * Returns true if a refresh was sent */
+static bool backgroundRefresh(void)
+{
+    const TEST_DNS_ANSWER* answer;
+
+    if (!APP_DNS_CachePolicyRefreshDue(&entry, now)) {
+        return false;
+    }
+    answer = serverQuery();
+    if (answer->nAddr == 0) {
+        APP_DNS_CachePolicyRefreshFailed(&entry, now);
+    } else {
+        APP_DNS_CachePolicyAnswer(&entry, TEST_HOST, answer->addr, answer->nAddr, answer->ttl, now);
+    }
+    return true;
+}
+
+/* The lookup of _dnsLookupAndConnect(): the cached address if there is one,
+ * stale or not, otherwise a blocking lookup stored into the cache. A cached
+ * address that does not answer is invalidated */
+static TEST_DIAL dial(void)
+{
+    TEST_DIAL result;
+    const TEST_DNS_ANSWER* answer;
+
+    memset(&result, 0, sizeof(result));
+    result.lookup = APP_DNS_CachePolicyGet(&entry, TEST_HOST, now, timeTrusted, &result.addr);
+    if (result.lookup == APP_DNS_CACHE_LOOKUP_MISS) {
+        answer = serverQuery();
+        result.elapsed_ms += TEST_DNS_RTT_ms;
+        if (answer->nAddr == 0) {
+            return result;
+        }
+        APP_DNS_CachePolicyAnswer(&entry, TEST_HOST, answer->addr, answer->nAddr, answer->ttl, now);
+        result.addr = answer->addr[0];
+    }
+    if (refreshWhileDialing) {
+        backgroundRefresh();
+    }
+
+    if (isLive(result.addr)) {
+        result.connected = true;
+        result.elapsed_ms += TEST_TCP_RTT_ms;
+        return result;
+    }
+    result.elapsed_ms += TEST_CONNECT_TMO_ms;
+    if (result.lookup != APP_DNS_CACHE_LOOKUP_MISS) {
+        APP_DNS_CachePolicyInvalidate(&entry, TEST_HOST, result.addr);
+    }
+    return result;
+}
+
+/* Cache the first answer of the script, as a first connection does */
+static void primeCache(void)
+{
+    TEST_DIAL first = dial();
+
+    TEST_ASSERT_TRUE( first.connected );
+    TEST_ASSERT_EQUAL( APP_DNS_CACHE_LOOKUP_MISS, first.lookup );
+    entry.dirty = false;
+}
+
+// *****************************************************************************
+
+TEST_GROUP( APP_Unit_DnsCache );
+
+TEST_SETUP( APP_Unit_DnsCache )
+{
+    memset(&entry, 0, sizeof(entry));
+    serverScript(NULL, 0);
+    serverLive(NULL, 0);
+    now = TEST_NOW;
+    timeTrusted = true;
+    refreshWhileDialing = false;
+}
+
+TEST_TEAR_DOWN( APP_Unit_DnsCache )
+{
+}
+
+TEST_GROUP_RUNNER( APP_Unit_DnsCache )
+{
+    RUN_TEST_CASE( APP_Unit_DnsCache, FreshEntrySkipsLookup );
+    RUN_TEST_CASE( APP_Unit_DnsCache, StaleEntryDialedAndRefreshed );
+    RUN_TEST_CASE( APP_Unit_DnsCache, StaleEntryOfMovedEndpoint );
+    RUN_TEST_CASE( APP_Unit_DnsCache, WrongAddressRotates );
+    RUN_TEST_CASE( APP_Unit_DnsCache, WrongEntryDropped );
+    RUN_TEST_CASE( APP_Unit_DnsCache, FailedRefreshKeepsAnswer );
+    RUN_TEST_CASE( APP_Unit_DnsCache, UntrustedTimeIsFresh );
+    RUN_TEST_CASE( APP_Unit_DnsCache, OtherHostMisses );
+    RUN_TEST_CASE( APP_Unit_DnsCache, LoadChecksRecord );
+    RUN_TEST_CASE( APP_Unit_DnsCache, StoredOnlyOnChange );
+}
+
+// *****************************************************************************
+
+/* Within the TTL the cached address is dialed without asking the server */
+TEST( APP_Unit_DnsCache, FreshEntrySkipsLookup )
+{
+    static const TEST_DNS_ANSWER answers[] = { { 1, { TEST_ADDR_A }, TEST_TTL_s } };
+    static const uint32_t live[] = { TEST_ADDR_A };
+    TEST_DIAL result;
+
+    serverScript(answers, 1);
+    serverLive(live, 1);
+    primeCache();
+
+    now += TEST_TTL_s / 2;
+    result = dial();
+    TEST_ASSERT_TRUE( result.connected );
+    TEST_ASSERT_EQUAL( APP_DNS_CACHE_LOOKUP_FRESH, result.lookup );
+    TEST_ASSERT_EQUAL_HEX32( TEST_ADDR_A, result.addr );
+    TEST_ASSERT_EQUAL_UINT32( TEST_TCP_RTT_ms, result.elapsed_ms );
+    TEST_ASSERT_EQUAL( 1, nQueries );
+}
+
+/* Past the TTL the last address is still dialed, marked stale, and the
+ * refresh runs right away instead of at its scheduled time */
+TEST( APP_Unit_DnsCache, StaleEntryDialedAndRefreshed )
+{
+    static const TEST_DNS_ANSWER answers[] = { { 1, { TEST_ADDR_A }, TEST_TTL_s } };
+    static const uint32_t live[] = { TEST_ADDR_A };
+    TEST_DIAL result;
+
+    serverScript(answers, 1);
+    serverLive(live, 1);
+    primeCache();
+
+    /* The refresh is held off by APP_DNS_CACHE_MIN_REFRESH_s, and a reset
+     * loses the schedule anyway: make the entry run out before it. */
+    now += TEST_TTL_s;
+    entry.nextRefresh = now + APP_DNS_CACHE_MIN_REFRESH_s;
+    TEST_ASSERT_FALSE( backgroundRefresh() );
+
+    result = dial();
+    TEST_ASSERT_TRUE( result.connected );
+    TEST_ASSERT_EQUAL( APP_DNS_CACHE_LOOKUP_STALE, result.lookup );
+    TEST_ASSERT_EQUAL_HEX32( TEST_ADDR_A, result.addr );
+    /* The connection did not wait for the server. */
+    TEST_ASSERT_EQUAL_UINT32( TEST_TCP_RTT_ms, result.elapsed_ms );
+    TEST_ASSERT_EQUAL( 1, nQueries );
+
+    /* Refreshed in parallel, and fresh again. */
+    TEST_ASSERT_TRUE( backgroundRefresh() );
+    TEST_ASSERT_EQUAL( 2, nQueries );
+    TEST_ASSERT_FALSE( entry.dirty );
+    TEST_ASSERT_EQUAL( APP_DNS_CACHE_LOOKUP_FRESH, dial().lookup );
+}
+
+/* The endpoint moved while the entry was stale. The dead address costs one
+ * connect timeout, during which the refresh started by the stale lookup puts
+ * the new address in place; the late failure of the old one leaves it be */
+TEST( APP_Unit_DnsCache, StaleEntryOfMovedEndpoint )
+{
+    static const TEST_DNS_ANSWER answers[] =
+    {
+        { 1, { TEST_ADDR_A }, TEST_TTL_s },
+        { 1, { TEST_ADDR_B }, TEST_TTL_s }
+    };
+    static const uint32_t liveBefore[] = { TEST_ADDR_A };
+    static const uint32_t liveAfter[] = { TEST_ADDR_B };
+    TEST_DIAL result;
+
+    serverScript(answers, 2);
+    serverLive(liveBefore, 1);
+    primeCache();
+
+    now += 3600;
+    serverLive(liveAfter, 1);
+    refreshWhileDialing = true;
+
+    result = dial();
+    TEST_ASSERT_FALSE( result.connected );
+    TEST_ASSERT_EQUAL( APP_DNS_CACHE_LOOKUP_STALE, result.lookup );
+    TEST_ASSERT_EQUAL_HEX32( TEST_ADDR_A, result.addr );
+    TEST_ASSERT_EQUAL_UINT32( TEST_CONNECT_TMO_ms, result.elapsed_ms );
+    TEST_ASSERT_EQUAL( 2, nQueries );
+
+    /* The new answer is what survives a reset. */
+    TEST_ASSERT_TRUE( entry.valid );
+    TEST_ASSERT_TRUE( entry.dirty );
+    TEST_ASSERT_EQUAL_HEX32( TEST_ADDR_B, entry.record.addr[0] );
+    TEST_ASSERT_EQUAL_UINT32( now + TEST_TTL_s, entry.record.expiry );
+
+    /* The retry needs no lookup. */
+    result = dial();
+    TEST_ASSERT_TRUE( result.connected );
+    TEST_ASSERT_EQUAL( APP_DNS_CACHE_LOOKUP_FRESH, result.lookup );
+    TEST_ASSERT_EQUAL_HEX32( TEST_ADDR_B, result.addr );
+    TEST_ASSERT_EQUAL_UINT32( TEST_TCP_RTT_ms, result.elapsed_ms );
+    TEST_ASSERT_EQUAL( 2, nQueries );
+}
+
+/* A wrong address of a multi-address answer is passed over for the next
+ * one, without asking the server again */
+TEST( APP_Unit_DnsCache, WrongAddressRotates )
+{
+    static const TEST_DNS_ANSWER answers[] = { { 3, { TEST_ADDR_A, TEST_ADDR_B, TEST_ADDR_C }, TEST_TTL_s } };
+    static const uint32_t liveFirst[] = { TEST_ADDR_A };
+    static const uint32_t liveLater[] = { TEST_ADDR_C };
+    TEST_DIAL result;
+
+    serverScript(answers, 1);
+    serverLive(liveFirst, 1);
+    primeCache();
+    serverLive(liveLater, 1);
+
+    result = dial();
+    TEST_ASSERT_FALSE( result.connected );
+    TEST_ASSERT_EQUAL_HEX32( TEST_ADDR_A, result.addr );
+    result = dial();
+    TEST_ASSERT_FALSE( result.connected );
+    TEST_ASSERT_EQUAL_HEX32( TEST_ADDR_B, result.addr );
+    result = dial();
+    TEST_ASSERT_TRUE( result.connected );
+    TEST_ASSERT_EQUAL( APP_DNS_CACHE_LOOKUP_FRESH, result.lookup );
+    TEST_ASSERT_EQUAL_HEX32( TEST_ADDR_C, result.addr );
+
+    TEST_ASSERT_EQUAL( 1, nQueries );
+    TEST_ASSERT_FALSE( entry.dirty );
+    /* Each failure asks for a refresh. */
+    TEST_ASSERT_TRUE( APP_DNS_CachePolicyRefreshDue(&entry, now) );
+}
+
+/* Once every address of the answer failed, the entry is dropped, and the
+ * next connection resolves the name. Here the server moved the endpoint
+ * within the TTL, so no refresh was under way */
+TEST( APP_Unit_DnsCache, WrongEntryDropped )
+{
+    static const TEST_DNS_ANSWER answers[] =
+    {
+        { 2, { TEST_ADDR_A, TEST_ADDR_B }, TEST_TTL_s },
+        { 1, { TEST_ADDR_C }, TEST_TTL_s }
+    };
+    static const uint32_t liveFirst[] = { TEST_ADDR_A };
+    static const uint32_t liveLater[] = { TEST_ADDR_C };
+    TEST_DIAL result;
+    uint32_t addr;
+
+    serverScript(answers, 2);
+    serverLive(liveFirst, 1);
+    primeCache();
+    serverLive(liveLater, 1);
+
+    TEST_ASSERT_FALSE( dial().connected );
+    TEST_ASSERT_FALSE( dial().connected );
+    TEST_ASSERT_FALSE( entry.valid );
+    TEST_ASSERT_TRUE( entry.dirty );
+    TEST_ASSERT_EQUAL( APP_DNS_CACHE_LOOKUP_MISS, APP_DNS_CachePolicyGet(&entry, TEST_HOST, now, true, &addr) );
+    /* Nothing left to refresh; the next connection does the lookup. */
+    TEST_ASSERT_FALSE( backgroundRefresh() );
+
+    result = dial();
+    TEST_ASSERT_TRUE( result.connected );
+    TEST_ASSERT_EQUAL_HEX32( TEST_ADDR_C, result.addr );
+    TEST_ASSERT_EQUAL( 2, nQueries );
+}
+
+/* A refresh that gets no answer keeps the old one in service, and is only
+ * retried after the margin, however often the stale entry is dialed */
+TEST( APP_Unit_DnsCache, FailedRefreshKeepsAnswer )
+{
+    static const TEST_DNS_ANSWER answers[] =
+    {
+        { 1, { TEST_ADDR_A }, TEST_TTL_s },
+        { 0, { 0 }, 0 },
+        { 1, { TEST_ADDR_A }, TEST_TTL_s }
+    };
+    static const uint32_t live[] = { TEST_ADDR_A };
+    TEST_DIAL result;
+
+    serverScript(answers, 3);
+    serverLive(live, 1);
+    primeCache();
+
+    now += 3600;
+    TEST_ASSERT_TRUE( backgroundRefresh() );
+    TEST_ASSERT_EQUAL( 2, nQueries );
+
+    now += APP_DNS_CACHE_REFRESH_MARGIN_s - 1;
+    result = dial();
+    TEST_ASSERT_TRUE( result.connected );
+    TEST_ASSERT_EQUAL( APP_DNS_CACHE_LOOKUP_STALE, result.lookup );
+    TEST_ASSERT_FALSE( backgroundRefresh() );
+
+    now += 1;
+    TEST_ASSERT_TRUE( backgroundRefresh() );
+    TEST_ASSERT_EQUAL( 3, nQueries );
+    TEST_ASSERT_EQUAL( APP_DNS_CACHE_LOOKUP_FRESH, dial().lookup );
+}
+
+/* Until the time is trusted the expiry cannot be checked; the entry is
+ * dialed as it is, and the connect timeout catches a wrong one */
+TEST( APP_Unit_DnsCache, UntrustedTimeIsFresh )
+{
+    static const TEST_DNS_ANSWER answers[] = { { 1, { TEST_ADDR_A }, TEST_TTL_s } };
+    static const uint32_t live[] = { TEST_ADDR_A };
+
+    serverScript(answers, 1);
+    serverLive(live, 1);
+    primeCache();
+
+    now += 3600;
+    timeTrusted = false;
+    TEST_ASSERT_EQUAL( APP_DNS_CACHE_LOOKUP_FRESH, dial().lookup );
+
+    now = 0;
+    TEST_ASSERT_EQUAL( APP_DNS_CACHE_LOOKUP_FRESH, dial().lookup );
+}
+
+/* The entry of another endpoint is neither handed out nor invalidated */
+TEST( APP_Unit_DnsCache, OtherHostMisses )
+{
+    static const uint32_t addr[] = { TEST_ADDR_A };
+    uint32_t got = 0;
+
+    APP_DNS_CachePolicyAnswer(&entry, "other.example.com", addr, 1, TEST_TTL_s, now);
+    TEST_ASSERT_EQUAL( APP_DNS_CACHE_LOOKUP_MISS, APP_DNS_CachePolicyGet(&entry, TEST_HOST, now, true, &got) );
+
+    APP_DNS_CachePolicyInvalidate(&entry, TEST_HOST, TEST_ADDR_A);
+    TEST_ASSERT_EQUAL( APP_DNS_CACHE_LOOKUP_FRESH,
+                       APP_DNS_CachePolicyGet(&entry, "other.example.com", now, true, &got) );
+    TEST_ASSERT_EQUAL_HEX32( TEST_ADDR_A, got );
+}
+
+/* A record from the store is only taken if it is one, and is refreshed as
+ * soon as we are online */
+TEST( APP_Unit_DnsCache, LoadChecksRecord )
+{
+    APP_DNS_CACHE_RECORD rec;
+    uint32_t got = 0;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.magic = APP_DNS_CACHE_MAGIC;
+    strcpy(rec.hostName, TEST_HOST);
+    rec.nAddr = 1;
+    rec.addr[0] = TEST_ADDR_A;
+    rec.expiry = TEST_NOW - 1;
+
+    /* Erased or foreign slot. */
+    rec.magic = 0xFFFFFFFF;
+    TEST_ASSERT_FALSE( APP_DNS_CachePolicyLoad(&entry, &rec) );
+    rec.magic = APP_DNS_CACHE_MAGIC;
+
+    rec.nAddr = 0;
+    TEST_ASSERT_FALSE( APP_DNS_CachePolicyLoad(&entry, &rec) );
+    rec.nAddr = APP_DNS_CACHE_MAX_ADDR + 1;
+    TEST_ASSERT_FALSE( APP_DNS_CachePolicyLoad(&entry, &rec) );
+    TEST_ASSERT_FALSE( entry.valid );
+
+    /* An unterminated name is cut, not read past. */
+    rec.nAddr = 1;
+    memset(rec.hostName, 'x', sizeof(rec.hostName));
+    TEST_ASSERT_TRUE( APP_DNS_CachePolicyLoad(&entry, &rec) );
+    TEST_ASSERT_EQUAL( APP_DNS_CACHE_HOSTNAME_LEN, strlen(entry.record.hostName) );
+
+    strcpy(rec.hostName, TEST_HOST);
+    TEST_ASSERT_TRUE( APP_DNS_CachePolicyLoad(&entry, &rec) );
+    TEST_ASSERT_FALSE( entry.dirty );
+    TEST_ASSERT_TRUE( APP_DNS_CachePolicyRefreshDue(&entry, now) );
+
+    /* Run out during the reset: still dialed. */
+    TEST_ASSERT_EQUAL( APP_DNS_CACHE_LOOKUP_STALE, APP_DNS_CachePolicyGet(&entry, TEST_HOST, now, true, &got) );
+    TEST_ASSERT_EQUAL_HEX32( TEST_ADDR_A, got );
+}
+
+/* Refreshes that only move the expiry do not wear the store */
+TEST( APP_Unit_DnsCache, StoredOnlyOnChange )
+{
+    static const TEST_DNS_ANSWER answers[] =
+    {
+        { 2, { TEST_ADDR_A, TEST_ADDR_B }, TEST_TTL_s },
+        { 2, { TEST_ADDR_A, TEST_ADDR_B }, 2 * TEST_TTL_s },
+        { 2, { TEST_ADDR_B, TEST_ADDR_A }, TEST_TTL_s },
+        { 1, { TEST_ADDR_B }, TEST_TTL_s }
+    };
+    static const uint32_t live[] = { TEST_ADDR_A, TEST_ADDR_B };
+
+    serverScript(answers, 4);
+    serverLive(live, 2);
+    primeCache();
+
+    now += APP_DNS_CACHE_MIN_REFRESH_s;
+    TEST_ASSERT_TRUE( backgroundRefresh() );
+    TEST_ASSERT_FALSE( entry.dirty );
+    TEST_ASSERT_EQUAL_UINT32( now + 2 * TEST_TTL_s, entry.record.expiry );
+
+    /* Same addresses, other order. */
+    now += APP_DNS_CACHE_MIN_REFRESH_s;
+    TEST_ASSERT_TRUE( backgroundRefresh() );
+    TEST_ASSERT_TRUE( entry.dirty );
+    entry.dirty = false;
+
+    now += APP_DNS_CACHE_MIN_REFRESH_s;
+    TEST_ASSERT_TRUE( backgroundRefresh() );
+    TEST_ASSERT_TRUE( entry.dirty );
+    TEST_ASSERT_EQUAL( 1, entry.record.nAddr );
+}
+
+/*******************************************************************************
+ End of File
+ */
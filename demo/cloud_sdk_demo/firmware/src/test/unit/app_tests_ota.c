@@ -0,0 +1,617 @@
+/*******************************************************************************
+  MPLAB Harmony Application Test Source File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_tests_ota.c
+
+  Summary:
+    Tests for the firmware update agent.
+
+  Description:
+    The agent runs against an image slot in RAM, a configuration store record
+    in RAM and a simulated Jobs service and stream that answer its requests
+    between two calls of its task. The hash and the signature check are
+    stand-ins: the tests cover what the agent decides from their results, not
+    the cryptography. Covers blocks arriving out of order, a download resumed
+    from the stored progress after a reset, a stream that stops answering, and
+    images refused for their digest, their signature or a missing signer key.
+ *******************************************************************************/
+
+/* Standard includes. */
+#include <string.h>
+#include <stdio.h>
+
+/* Module under test. */
+#include "app_ota_agent.h"
+
+/* Test framework includes. */
+#include "unity_fixture.h"
+
+// *****************************************************************************
+
+/* Not a whole number of sectors or blocks, and past one progress step */
+#define TEST_IMAGE_SIZE         (100 * 1024 + 300)
+#define TEST_SLOT_SIZE          (128 * 1024)
+#define TEST_JOB_ID             "fw-1"
+#define TEST_STREAM_ID          "stream-1"
+#define TEST_FILE_ID            1
+/* Time that passes for each call of the agent's task */
+#define TEST_STEP_MS            10
+#define TEST_MAX_STEPS          100000
+/* Flash status polls a sector write stays busy for */
+#define TEST_FLASH_BUSY_POLLS   2
+
+typedef enum
+{
+    /* Every block of a request, in order */
+    TEST_SERVE_IN_ORDER=0,
+    /* The last two blocks of a request swapped, the first one sent twice
+     * and a block of another file in between */
+    TEST_SERVE_SHUFFLED,
+    /* Every other request in order, the others not at all */
+    TEST_SERVE_LOSSY,
+    /* No answer at all */
+    TEST_SERVE_NONE
+} TEST_SERVE;
+
+/* Simulated Jobs service holding at most one job */
+typedef struct
+{
+    char document[512];
+    bool queued;
+    /* A start-next waits for its answer */
+    bool startNext;
+    APP_OTA_JOB_STATUS status;
+    char details[APP_OTA_DETAILS_MAX_LEN];
+    uint32_t nUpdates;
+    /* Updates with a terminal status */
+    uint32_t nReports;
+} TEST_JOBS;
+
+/* Simulated stream */
+typedef struct
+{
+    TEST_SERVE serve;
+    bool subscribed;
+    uint32_t nSubscribes;
+    bool pending;
+    uint32_t firstBlock;
+    uint32_t nBlocks;
+    uint32_t nRequests;
+    /* First block of the first request */
+    uint32_t firstRequested;
+} TEST_STREAM;
+
+static APP_OTA_AGENT agent;
+static uint8_t buffers[APP_OTA_WRITER_NUM_BUFFERS * APP_OTA_WRITER_SECTOR_SIZE];
+static uint8_t image[TEST_IMAGE_SIZE];
+static uint8_t imageDigest[32];
+static uint8_t slot[TEST_SLOT_SIZE];
+static uint32_t flashBusy;
+static uint32_t nFlashWrites;
+static uint32_t lowestWrite;
+static APP_OTA_PROGRESS store;
+static bool storeValid;
+static TEST_JOBS jobs;
+static TEST_STREAM stream;
+static uint8_t hashState[32];
+static uint32_t hashPosition;
+static uint32_t now;
+static uint32_t events[APP_OTA_EVENT_ENDED + 1];
+
+static const uint8_t signerKey[64] = { 0x04, 0x11, 0x22, 0x33 };
+static const uint8_t noKey[64] = { 0 };
+static const uint8_t goodSignature[64] = { 0x5A, 0xA5, 0x0F, 0xF0 };
+
+// *****************************************************************************
+
+/* Order dependent stand-in for SHA-256 */
+static void hashBytes(uint8_t* pState, uint32_t* pPosition, const uint8_t* pData, uint32_t length)
+{
+    uint32_t i;
+
+    for (i = 0; i < length; i++, (*pPosition)++) {
+        pState[*pPosition % 32] = (uint8_t) (pState[*pPosition % 32] * 31 + pData[i] + 1);
+    }
+}
+
+static void hexPrint(char* pHex, const uint8_t* pData, size_t length)
+{
+    size_t i;
+
+    for (i = 0; i < length; i++) {
+        sprintf(pHex + 2 * i, "%02x", pData[i]);
+    }
+}
+
+// *****************************************************************************
+// Platform of the agent
+
+static bool flashSectorWrite(void* context, uint32_t offset, const uint8_t* pSector)
+{
+    TEST_ASSERT_EQUAL_UINT32( 0, offset % APP_OTA_WRITER_SECTOR_SIZE );
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32( TEST_SLOT_SIZE - APP_OTA_WRITER_SECTOR_SIZE, offset );
+    TEST_ASSERT_EQUAL_UINT32( 0, flashBusy );
+
+    memcpy(slot + offset, pSector, APP_OTA_WRITER_SECTOR_SIZE);
+    flashBusy = TEST_FLASH_BUSY_POLLS;
+    nFlashWrites++;
+    if (offset < lowestWrite)
+        lowestWrite = offset;
+    return true;
+}
+
+static int8_t flashStatus(void* context)
+{
+    if (0 == flashBusy)
+        return 0;
+    flashBusy--;
+    return 1;
+}
+
+static int8_t slotGet(uint32_t* pSlotSize)
+{
+    *pSlotSize = TEST_SLOT_SIZE;
+    return 0;
+}
+
+static bool slotRead(uint32_t offset, uint8_t* pBuffer, uint32_t length)
+{
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32( TEST_SLOT_SIZE, offset + length );
+    memcpy(pBuffer, slot + offset, length);
+    return true;
+}
+
+static bool progressRead(APP_OTA_PROGRESS* pProgress)
+{
+    if (!storeValid)
+        return false;
+    *pProgress = store;
+    return true;
+}
+
+static bool progressWrite(const APP_OTA_PROGRESS* pProgress)
+{
+    store = *pProgress;
+    storeValid = true;
+    return true;
+}
+
+static bool jobStartNext(void)
+{
+    TEST_ASSERT_FALSE( jobs.startNext );
+    jobs.startNext = true;
+    return true;
+}
+
+static bool jobUpdate(const char* pJobId, APP_OTA_JOB_STATUS status, const char* pDetails)
+{
+    TEST_ASSERT_EQUAL_STRING( TEST_JOB_ID, pJobId );
+    jobs.status = status;
+    strncpy(jobs.details, pDetails, sizeof(jobs.details) - 1);
+    jobs.nUpdates++;
+    if (APP_OTA_JOB_IN_PROGRESS != status) {
+        /* The execution leaves the queue */
+        jobs.queued = false;
+        jobs.nReports++;
+    }
+    return true;
+}
+
+static bool streamSubscribe(const APP_OTA_JOB* pJob, bool subscribe)
+{
+    TEST_ASSERT_EQUAL_STRING( TEST_STREAM_ID, pJob->streamId );
+    stream.subscribed = subscribe;
+    if (subscribe)
+        stream.nSubscribes++;
+    return true;
+}
+
+static bool blocksRequest(const APP_OTA_JOB* pJob, uint32_t firstBlock, uint32_t nBlocks)
+{
+    TEST_ASSERT_TRUE( stream.subscribed );
+    TEST_ASSERT_EQUAL_INT32( TEST_FILE_ID, pJob->fileId );
+    TEST_ASSERT_NOT_EQUAL( 0, nBlocks );
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32( (TEST_IMAGE_SIZE + APP_OTA_BLOCK_SIZE - 1) / APP_OTA_BLOCK_SIZE,
+                                      firstBlock + nBlocks );
+    stream.pending = true;
+    stream.firstBlock = firstBlock;
+    stream.nBlocks = nBlocks;
+    if (0 == stream.nRequests)
+        stream.firstRequested = firstBlock;
+    stream.nRequests++;
+    return true;
+}
+
+static bool hashStart(uint32_t size)
+{
+    TEST_ASSERT_EQUAL_UINT32( TEST_IMAGE_SIZE, size );
+    memset(hashState, 0, sizeof(hashState));
+    hashPosition = 0;
+    return true;
+}
+
+static bool hashUpdate(const uint8_t* pData, uint32_t length)
+{
+    hashBytes(hashState, &hashPosition, pData, length);
+    return true;
+}
+
+static bool hashFinish(uint8_t* pDigest)
+{
+    memcpy(pDigest, hashState, sizeof(hashState));
+    return true;
+}
+
+static bool signatureVerify(const uint8_t* pDigest, const uint8_t* pSignature, const uint8_t* pKey, bool* pVerified)
+{
+    *pVerified = 0 == memcmp(pKey, signerKey, sizeof(signerKey))
+            && 0 == memcmp(pSignature, goodSignature, sizeof(goodSignature))
+            && 0 == memcmp(pDigest, imageDigest, sizeof(imageDigest));
+    return true;
+}
+
+static uint32_t msNow(void)
+{
+    return now;
+}
+
+static void writerLock(void)
+{
+}
+
+static void writerUnlock(void)
+{
+}
+
+static void agentEvent(APP_OTA_EVENT event)
+{
+    events[event]++;
+}
+
+static const APP_OTA_PORT testPort = {
+    .flash = {
+        .sectorWrite = flashSectorWrite,
+        .status = flashStatus,
+        .context = NULL
+    },
+    .slotGet = slotGet,
+    .slotRead = slotRead,
+    .progressRead = progressRead,
+    .progressWrite = progressWrite,
+    .jobStartNext = jobStartNext,
+    .jobUpdate = jobUpdate,
+    .streamSubscribe = streamSubscribe,
+    .blocksRequest = blocksRequest,
+    .hashStart = hashStart,
+    .hashUpdate = hashUpdate,
+    .hashFinish = hashFinish,
+    .signatureVerify = signatureVerify,
+    .msNow = msNow,
+    .writerLock = writerLock,
+    .writerUnlock = writerUnlock,
+    .event = agentEvent
+};
+
+// *****************************************************************************
+
+/* Queue a firmware job for the image with the given digest and signature */
+static void jobQueue(const uint8_t* pDigest, const uint8_t* pSignature)
+{
+    char sha256[2 * 32 + 1];
+    char signature[2 * 64 + 1];
+
+    hexPrint(sha256, pDigest, 32);
+    hexPrint(signature, pSignature, 64);
+    snprintf(jobs.document, sizeof(jobs.document),
+             "{\"clientToken\":\"1\",\"execution\":{\"jobId\":\"%s\",\"status\":\"QUEUED\","
+             "\"jobDocument\":{\"operation\":\"firmware-update\",\"streamId\":\"%s\",\"fileId\":%d,"
+             "\"size\":%d,\"sha256\":\"%s\",\"signature\":\"%s\"}}}",
+             TEST_JOB_ID, TEST_STREAM_ID, TEST_FILE_ID, TEST_IMAGE_SIZE, sha256, signature);
+    jobs.queued = true;
+}
+
+static void blockSend(int32_t fileId, uint32_t block)
+{
+    uint32_t offset = block * APP_OTA_BLOCK_SIZE;
+    uint32_t length = TEST_IMAGE_SIZE - offset;
+
+    if (length > APP_OTA_BLOCK_SIZE)
+        length = APP_OTA_BLOCK_SIZE;
+    APP_OTA_AgentBlockPut(&agent, fileId, (int32_t) block, image + offset, length);
+}
+
+/* Answer what the agent asked for during its last task call */
+static void servicesAnswer(void)
+{
+    static const char noJob[] = "{\"clientToken\":\"1\"}";
+    uint32_t i, last;
+
+    if (jobs.startNext) {
+        jobs.startNext = false;
+        if (jobs.queued)
+            APP_OTA_AgentJobNext(&agent, jobs.document, strlen(jobs.document));
+        else
+            APP_OTA_AgentJobNext(&agent, noJob, sizeof(noJob) - 1);
+    }
+    if (!stream.pending)
+        return;
+    stream.pending = false;
+    last = stream.firstBlock + stream.nBlocks - 1;
+    switch (stream.serve) {
+        case TEST_SERVE_LOSSY:
+            if (0 != stream.nRequests % 2)
+                break;
+            /* no break */
+        case TEST_SERVE_IN_ORDER:
+            for (i = stream.firstBlock; i <= last; i++)
+                blockSend(TEST_FILE_ID, i);
+            break;
+
+        case TEST_SERVE_SHUFFLED:
+            blockSend(TEST_FILE_ID, stream.firstBlock);
+            blockSend(TEST_FILE_ID, stream.firstBlock);
+            blockSend(TEST_FILE_ID + 1, stream.firstBlock + 1);
+            for (i = stream.firstBlock + 1; i + 1 < last; i++)
+                blockSend(TEST_FILE_ID, i);
+            if (last > stream.firstBlock)
+                blockSend(TEST_FILE_ID, last);
+            if (last > stream.firstBlock + 1)
+                blockSend(TEST_FILE_ID, last - 1);
+            break;
+
+        default:
+            break;
+    }
+}
+
+/* Run the agent until the job was reported as finished */
+static void runUntilReported(void)
+{
+    uint32_t reports = jobs.nReports;
+    uint32_t steps;
+
+    for (steps = 0; steps < TEST_MAX_STEPS && jobs.nReports == reports; steps++) {
+        APP_OTA_AgentTasks(&agent);
+        servicesAnswer();
+        now += TEST_STEP_MS;
+    }
+    TEST_ASSERT_NOT_EQUAL( reports, jobs.nReports );
+}
+
+/* Run the agent until a progress record past 'committed' was stored */
+static void runUntilStored(uint32_t committed)
+{
+    uint32_t steps;
+
+    for (steps = 0; steps < TEST_MAX_STEPS && !(storeValid && store.committed >= committed); steps++) {
+        APP_OTA_AgentTasks(&agent);
+        servicesAnswer();
+        now += TEST_STEP_MS;
+    }
+    TEST_ASSERT_TRUE( storeValid );
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32( committed, store.committed );
+}
+
+/* A reset: all RAM state is gone, the slot and the store are kept */
+static void agentRestart(const uint8_t* pKey)
+{
+    APP_OTA_AgentInit(&agent, &testPort, pKey, buffers);
+    APP_OTA_AgentStart(&agent);
+    memset(&stream, 0, sizeof(stream));
+    jobs.startNext = false;
+    flashBusy = 0;
+    nFlashWrites = 0;
+    lowestWrite = UINT32_MAX;
+}
+
+// *****************************************************************************
+
+TEST_GROUP( APP_Unit_Ota );
+
+TEST_SETUP( APP_Unit_Ota )
+{
+    uint32_t i, seed = 12345;
+
+    for (i = 0; i < TEST_IMAGE_SIZE; i++) {
+        seed = seed * 1103515245 + 12345;
+        image[i] = (uint8_t) (seed >> 16);
+    }
+    memset(imageDigest, 0, sizeof(imageDigest));
+    i = 0;
+    hashBytes(imageDigest, &i, image, TEST_IMAGE_SIZE);
+
+    memset(slot, 0xFF, sizeof(slot));
+    memset(&store, 0, sizeof(store));
+    storeValid = false;
+    memset(&jobs, 0, sizeof(jobs));
+    memset(events, 0, sizeof(events));
+    now = 1000;
+    agentRestart(signerKey);
+}
+
+TEST_TEAR_DOWN( APP_Unit_Ota )
+{
+}
+
+TEST_GROUP_RUNNER( APP_Unit_Ota )
+{
+    RUN_TEST_CASE( APP_Unit_Ota, Download );
+    RUN_TEST_CASE( APP_Unit_Ota, BlocksOutOfOrder );
+    RUN_TEST_CASE( APP_Unit_Ota, ResumeAfterReset );
+    RUN_TEST_CASE( APP_Unit_Ota, AlreadyStaged );
+    RUN_TEST_CASE( APP_Unit_Ota, LossyStream );
+    RUN_TEST_CASE( APP_Unit_Ota, StreamTimeout );
+    RUN_TEST_CASE( APP_Unit_Ota, DigestMismatch );
+    RUN_TEST_CASE( APP_Unit_Ota, BadSignature );
+    RUN_TEST_CASE( APP_Unit_Ota, NoSignerKey );
+}
+
+// *****************************************************************************
+
+/* The whole image ends up in the slot, and the job succeeds with it staged */
+TEST( APP_Unit_Ota, Download )
+{
+    jobQueue(imageDigest, goodSignature);
+    runUntilReported();
+
+    TEST_ASSERT_EQUAL( APP_OTA_JOB_SUCCEEDED, jobs.status );
+    TEST_ASSERT_EQUAL_STRING( "{\"state\":\"staged\"}", jobs.details );
+    TEST_ASSERT_EQUAL_MEMORY( image, slot, TEST_IMAGE_SIZE );
+    TEST_ASSERT_EQUAL_UINT32( APP_OTA_PROGRESS_MAGIC, store.magic );
+    TEST_ASSERT_EQUAL_UINT32( APP_OTA_PROGRESS_STAGED, store.state );
+    TEST_ASSERT_EQUAL_UINT32( TEST_IMAGE_SIZE, store.committed );
+    TEST_ASSERT_EQUAL_UINT32( 1, events[APP_OTA_EVENT_VERIFIED] );
+    TEST_ASSERT_EQUAL_UINT32( 0, events[APP_OTA_EVENT_RESUME] );
+    TEST_ASSERT_FALSE( stream.subscribed );
+
+    /* Each request fills both buffers; nothing was dropped */
+    TEST_ASSERT_EQUAL_UINT32( (TEST_IMAGE_SIZE + APP_OTA_BLOCK_SIZE - 1) / APP_OTA_BLOCK_SIZE, agent.nBlocks );
+    TEST_ASSERT_EQUAL_UINT32( 0, agent.nDropped );
+    TEST_ASSERT_EQUAL_UINT32( (TEST_IMAGE_SIZE + APP_OTA_WRITER_SECTOR_SIZE - 1) / APP_OTA_WRITER_SECTOR_SIZE,
+                              nFlashWrites );
+}
+
+/* Blocks that do not follow the last one are dropped and requested again;
+ * duplicates and blocks of another file change nothing */
+TEST( APP_Unit_Ota, BlocksOutOfOrder )
+{
+    uint32_t minRequests = (TEST_IMAGE_SIZE + sizeof(buffers) - 1) / sizeof(buffers);
+
+    stream.serve = TEST_SERVE_SHUFFLED;
+    jobQueue(imageDigest, goodSignature);
+    runUntilReported();
+
+    TEST_ASSERT_EQUAL( APP_OTA_JOB_SUCCEEDED, jobs.status );
+    TEST_ASSERT_EQUAL_MEMORY( image, slot, TEST_IMAGE_SIZE );
+    TEST_ASSERT_NOT_EQUAL( 0, agent.nDropped );
+    TEST_ASSERT_GREATER_THAN_UINT32( minRequests, stream.nRequests );
+    TEST_ASSERT_EQUAL_UINT32( stream.nRequests, agent.nRequests );
+}
+
+/* After a reset the download goes on from the offset last stored, and the
+ * sectors before it are not written again */
+TEST( APP_Unit_Ota, ResumeAfterReset )
+{
+    uint32_t stored;
+
+    jobQueue(imageDigest, goodSignature);
+    runUntilStored(APP_OTA_PROGRESS_STEP);
+    stored = store.committed;
+    TEST_ASSERT_LESS_THAN_UINT32( TEST_IMAGE_SIZE, stored );
+    TEST_ASSERT_EQUAL_UINT32( 0, stored % APP_OTA_WRITER_SECTOR_SIZE );
+
+    /* Whatever was past the stored offset may not be in the flash */
+    memset(slot + stored, 0xA5, sizeof(slot) - stored);
+    agentRestart(signerKey);
+    runUntilReported();
+
+    TEST_ASSERT_EQUAL( APP_OTA_JOB_SUCCEEDED, jobs.status );
+    TEST_ASSERT_EQUAL_MEMORY( image, slot, TEST_IMAGE_SIZE );
+    TEST_ASSERT_EQUAL_UINT32( 1, events[APP_OTA_EVENT_RESUME] );
+    TEST_ASSERT_EQUAL_UINT32( stored / APP_OTA_BLOCK_SIZE, stream.firstRequested );
+    TEST_ASSERT_EQUAL_UINT32( stored, lowestWrite );
+    TEST_ASSERT_EQUAL_UINT32( (TEST_IMAGE_SIZE - stored + APP_OTA_BLOCK_SIZE - 1) / APP_OTA_BLOCK_SIZE,
+                              agent.nBlocks );
+}
+
+/* A job sent again for an image already staged succeeds without a download */
+TEST( APP_Unit_Ota, AlreadyStaged )
+{
+    jobQueue(imageDigest, goodSignature);
+    runUntilReported();
+    TEST_ASSERT_EQUAL( APP_OTA_JOB_SUCCEEDED, jobs.status );
+
+    agentRestart(signerKey);
+    jobQueue(imageDigest, goodSignature);
+    runUntilReported();
+
+    TEST_ASSERT_EQUAL( APP_OTA_JOB_SUCCEEDED, jobs.status );
+    TEST_ASSERT_EQUAL_UINT32( 1, events[APP_OTA_EVENT_STAGED] );
+    TEST_ASSERT_EQUAL_UINT32( 0, stream.nSubscribes );
+    TEST_ASSERT_EQUAL_UINT32( 0, nFlashWrites );
+}
+
+/* Only requests in a row without a block count against the retries, so a
+ * stream losing many requests overall still gets the image through */
+TEST( APP_Unit_Ota, LossyStream )
+{
+    stream.serve = TEST_SERVE_LOSSY;
+    jobQueue(imageDigest, goodSignature);
+    runUntilReported();
+
+    TEST_ASSERT_EQUAL( APP_OTA_JOB_SUCCEEDED, jobs.status );
+    TEST_ASSERT_EQUAL_MEMORY( image, slot, TEST_IMAGE_SIZE );
+    TEST_ASSERT_GREATER_THAN_UINT32( 2 * APP_OTA_REQUEST_RETRIES, stream.nRequests );
+}
+
+/* The download is given up after APP_OTA_REQUEST_RETRIES requests in a row
+ * without a block, and the progress is kept */
+TEST( APP_Unit_Ota, StreamTimeout )
+{
+    stream.serve = TEST_SERVE_NONE;
+    jobQueue(imageDigest, goodSignature);
+    runUntilReported();
+
+    TEST_ASSERT_EQUAL( APP_OTA_JOB_FAILED, jobs.status );
+    TEST_ASSERT_EQUAL_STRING( "{\"reason\":\"stream timeout\"}", jobs.details );
+    TEST_ASSERT_EQUAL_UINT32( APP_OTA_REQUEST_RETRIES + 1, stream.nRequests );
+    TEST_ASSERT_FALSE( stream.subscribed );
+    TEST_ASSERT_EQUAL_UINT32( APP_OTA_PROGRESS_MAGIC, store.magic );
+}
+
+/* An image that does not hash to the digest of the job is refused, and the
+ * next job for it starts over */
+TEST( APP_Unit_Ota, DigestMismatch )
+{
+    uint8_t digest[32];
+
+    memcpy(digest, imageDigest, sizeof(digest));
+    digest[31] ^= 1;
+    jobQueue(digest, goodSignature);
+    runUntilReported();
+
+    TEST_ASSERT_EQUAL( APP_OTA_JOB_FAILED, jobs.status );
+    TEST_ASSERT_EQUAL_STRING( "{\"reason\":\"digest mismatch\"}", jobs.details );
+    TEST_ASSERT_EQUAL_UINT32( 0, store.magic );
+}
+
+/* An image whose signature does not check out is refused, and the next job
+ * for it starts over */
+TEST( APP_Unit_Ota, BadSignature )
+{
+    uint8_t signature[64];
+
+    memcpy(signature, goodSignature, sizeof(signature));
+    signature[0] ^= 1;
+    jobQueue(imageDigest, signature);
+    runUntilReported();
+
+    TEST_ASSERT_EQUAL( APP_OTA_JOB_FAILED, jobs.status );
+    TEST_ASSERT_EQUAL_STRING( "{\"reason\":\"bad signature\"}", jobs.details );
+    TEST_ASSERT_EQUAL_UINT32( 0, store.magic );
+    TEST_ASSERT_EQUAL_MEMORY( image, slot, TEST_IMAGE_SIZE );
+}
+
+/* Without a signer key the job is refused as it is handed out, before
+ * anything is downloaded */
+TEST( APP_Unit_Ota, NoSignerKey )
+{
+    agentRestart(noKey);
+    jobQueue(imageDigest, goodSignature);
+    runUntilReported();
+
+    TEST_ASSERT_EQUAL( APP_OTA_JOB_FAILED, jobs.status );
+    TEST_ASSERT_EQUAL_STRING( "{\"reason\":\"no signer key\"}", jobs.details );
+    TEST_ASSERT_EQUAL_UINT32( 1, jobs.nUpdates );
+    TEST_ASSERT_EQUAL_UINT32( 0, stream.nSubscribes );
+    TEST_ASSERT_EQUAL_UINT32( 0, nFlashWrites );
+    TEST_ASSERT_FALSE( storeValid );
+}
+
+/*******************************************************************************
+ End of File
+ */
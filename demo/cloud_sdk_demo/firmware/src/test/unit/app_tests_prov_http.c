@@ -0,0 +1,262 @@
+/*******************************************************************************
+  MPLAB Harmony Application Test Source File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_tests_prov_http.c
+
+  Summary:
+    Tests for the HTTP/1.1 request parser of the provisioning server.
+
+  Description:
+    Requests are fed the way the socket delivers them: split over several
+    segments, down to one byte each, or several of them in one segment. Also
+    covers persistent connections and the requests answered with a 400 or a
+    413 by the server.
+ *******************************************************************************/
+
+/* Standard includes. */
+#include <string.h>
+
+/* Module under test. */
+#include "app_prov_http.h"
+
+/* Test framework includes. */
+#include "unity_fixture.h"
+
+// *****************************************************************************
+
+#define TEST_POST       "POST /wifi HTTP/1.1\r\n" \
+                        "Host: 192.168.1.1\r\n" \
+                        "Content-Type: application/x-www-form-urlencoded\r\n" \
+                        "Content-Length: 28\r\n\r\n" \
+                        "ssid=My+AP&pass=a%26b&auth=3"
+#define TEST_POST_BODY  "ssid=My+AP&pass=a%26b&auth=3"
+
+#define TEST_GET(path)  "GET " path " HTTP/1.1\r\nHost: 192.168.1.1\r\n\r\n"
+
+static APP_PROV_HTTP_REQUEST req;
+
+// *****************************************************************************
+
+/* Append 'n' bytes of 'data' at the tail, like a read of the socket */
+static APP_PROV_HTTP_PARSE_RESULT feed(const char* data, size_t n)
+{
+    uint16_t space;
+    char* tail = APP_PROV_HTTP_RequestTail(&req, &space);
+
+    TEST_ASSERT_LESS_OR_EQUAL( space, n );
+    memcpy(tail, data, n);
+    return APP_PROV_HTTP_RequestFeed(&req, (uint16_t) n);
+}
+
+static APP_PROV_HTTP_PARSE_RESULT feedString(const char* data)
+{
+    return feed(data, strlen(data));
+}
+
+// *****************************************************************************
+
+TEST_GROUP( APP_Unit_ProvHttp );
+
+TEST_SETUP( APP_Unit_ProvHttp )
+{
+    APP_PROV_HTTP_RequestInit(&req);
+}
+
+TEST_TEAR_DOWN( APP_Unit_ProvHttp )
+{
+}
+
+TEST_GROUP_RUNNER( APP_Unit_ProvHttp )
+{
+    RUN_TEST_CASE( APP_Unit_ProvHttp, ByteByByte );
+    RUN_TEST_CASE( APP_Unit_ProvHttp, TerminatorAcrossSegments );
+    RUN_TEST_CASE( APP_Unit_ProvHttp, BodyAcrossSegments );
+    RUN_TEST_CASE( APP_Unit_ProvHttp, Pipelined );
+    RUN_TEST_CASE( APP_Unit_ProvHttp, PipelinedAfterBody );
+    RUN_TEST_CASE( APP_Unit_ProvHttp, KeepAlive );
+    RUN_TEST_CASE( APP_Unit_ProvHttp, BadRequest );
+    RUN_TEST_CASE( APP_Unit_ProvHttp, TooLargeBody );
+    RUN_TEST_CASE( APP_Unit_ProvHttp, TooLargeHeaders );
+    RUN_TEST_CASE( APP_Unit_ProvHttp, ResponseHeader );
+}
+
+// *****************************************************************************
+
+/* A request read one byte at a time is only done with its last byte */
+TEST( APP_Unit_ProvHttp, ByteByByte )
+{
+    const char* request = TEST_POST;
+    size_t len = strlen(request);
+    char value[16];
+    size_t i;
+
+    for (i = 0; i < len - 1; i++)
+        TEST_ASSERT_EQUAL( APP_PROV_HTTP_PARSE_MORE, feed(&request[i], 1) );
+    TEST_ASSERT_EQUAL( APP_PROV_HTTP_PARSE_DONE, feed(&request[i], 1) );
+
+    TEST_ASSERT_EQUAL( APP_PROV_HTTP_METHOD_POST, req.method );
+    TEST_ASSERT_EQUAL_STRING( "/wifi", req.path );
+    TEST_ASSERT_EQUAL_STRING( "", req.query );
+    TEST_ASSERT_EQUAL_STRING( TEST_POST_BODY, req.body );
+    TEST_ASSERT_TRUE( req.keepAlive );
+
+    TEST_ASSERT_EQUAL( 5, APP_PROV_HTTP_FormField(req.body, "ssid", value, sizeof(value)) );
+    TEST_ASSERT_EQUAL_STRING( "My AP", value );
+    TEST_ASSERT_EQUAL( 3, APP_PROV_HTTP_FormField(req.body, "pass", value, sizeof(value)) );
+    TEST_ASSERT_EQUAL_STRING( "a&b", value );
+}
+
+/* The blank line ending the headers split over every possible pair of segments */
+TEST( APP_Unit_ProvHttp, TerminatorAcrossSegments )
+{
+    const char* request = TEST_GET("/scan?n=4");
+    size_t len = strlen(request);
+    size_t split;
+
+    for (split = len - 4; split < len; split++) {
+        APP_PROV_HTTP_RequestInit(&req);
+        TEST_ASSERT_EQUAL( APP_PROV_HTTP_PARSE_MORE, feed(request, split) );
+        TEST_ASSERT_EQUAL( APP_PROV_HTTP_PARSE_DONE, feed(&request[split], len - split) );
+        TEST_ASSERT_EQUAL( APP_PROV_HTTP_METHOD_GET, req.method );
+        TEST_ASSERT_EQUAL_STRING( "/scan", req.path );
+        TEST_ASSERT_EQUAL_STRING( "n=4", req.query );
+    }
+}
+
+/* Headers in one segment, the body trickling in after them */
+TEST( APP_Unit_ProvHttp, BodyAcrossSegments )
+{
+    const char* request = TEST_POST;
+    size_t headerLen = strlen(request) - strlen(TEST_POST_BODY);
+
+    TEST_ASSERT_EQUAL( APP_PROV_HTTP_PARSE_MORE, feed(request, headerLen) );
+    TEST_ASSERT_EQUAL( APP_PROV_HTTP_PARSE_MORE, feed(&request[headerLen], 10) );
+    TEST_ASSERT_EQUAL( APP_PROV_HTTP_PARSE_DONE, feedString(&request[headerLen + 10]) );
+    TEST_ASSERT_EQUAL_STRING( TEST_POST_BODY, req.body );
+}
+
+/* Two requests and the start of a third in one segment */
+TEST( APP_Unit_ProvHttp, Pipelined )
+{
+    const char* third = TEST_GET("/c");
+
+    TEST_ASSERT_EQUAL( APP_PROV_HTTP_PARSE_DONE, feedString(TEST_GET("/a") TEST_GET("/b") "GET /c HT") );
+    TEST_ASSERT_EQUAL_STRING( "/a", req.path );
+
+    APP_PROV_HTTP_RequestNext(&req);
+    TEST_ASSERT_EQUAL( APP_PROV_HTTP_PARSE_DONE, APP_PROV_HTTP_RequestFeed(&req, 0) );
+    TEST_ASSERT_EQUAL_STRING( "/b", req.path );
+
+    APP_PROV_HTTP_RequestNext(&req);
+    TEST_ASSERT_EQUAL( APP_PROV_HTTP_PARSE_MORE, APP_PROV_HTTP_RequestFeed(&req, 0) );
+    TEST_ASSERT_EQUAL( APP_PROV_HTTP_PARSE_DONE, feedString(&third[strlen("GET /c HT")]) );
+    TEST_ASSERT_EQUAL_STRING( "/c", req.path );
+
+    /* Nothing left over */
+    APP_PROV_HTTP_RequestNext(&req);
+    TEST_ASSERT_EQUAL( 0, req.len );
+}
+
+/* The byte after a body is NUL terminated while the request is handled, and
+ * given back to the next request */
+TEST( APP_Unit_ProvHttp, PipelinedAfterBody )
+{
+    TEST_ASSERT_EQUAL( APP_PROV_HTTP_PARSE_DONE, feedString(TEST_POST TEST_GET("/status")) );
+    TEST_ASSERT_EQUAL_STRING( TEST_POST_BODY, req.body );
+
+    APP_PROV_HTTP_RequestNext(&req);
+    TEST_ASSERT_EQUAL( APP_PROV_HTTP_PARSE_DONE, APP_PROV_HTTP_RequestFeed(&req, 0) );
+    TEST_ASSERT_EQUAL( APP_PROV_HTTP_METHOD_GET, req.method );
+    TEST_ASSERT_EQUAL_STRING( "/status", req.path );
+}
+
+/* Persistent by default from HTTP/1.1 on, unless the Connection header says otherwise */
+TEST( APP_Unit_ProvHttp, KeepAlive )
+{
+    TEST_ASSERT_EQUAL( APP_PROV_HTTP_PARSE_DONE, feedString("GET / HTTP/1.1\r\n\r\n") );
+    TEST_ASSERT_TRUE( req.keepAlive );
+
+    APP_PROV_HTTP_RequestNext(&req);
+    TEST_ASSERT_EQUAL( APP_PROV_HTTP_PARSE_DONE, feedString("GET / HTTP/1.1\r\nConnection: close\r\n\r\n") );
+    TEST_ASSERT_FALSE( req.keepAlive );
+
+    APP_PROV_HTTP_RequestNext(&req);
+    TEST_ASSERT_EQUAL( APP_PROV_HTTP_PARSE_DONE, feedString("GET / HTTP/1.0\r\n\r\n") );
+    TEST_ASSERT_FALSE( req.keepAlive );
+
+    APP_PROV_HTTP_RequestNext(&req);
+    TEST_ASSERT_EQUAL( APP_PROV_HTTP_PARSE_DONE, feedString("GET / HTTP/1.0\r\nconnection:Keep-Alive\r\n\r\n") );
+    TEST_ASSERT_TRUE( req.keepAlive );
+}
+
+/* Answered with a 400 */
+TEST( APP_Unit_ProvHttp, BadRequest )
+{
+    TEST_ASSERT_EQUAL( APP_PROV_HTTP_PARSE_BAD_REQUEST, feedString("GET /\r\n\r\n") );
+
+    APP_PROV_HTTP_RequestInit(&req);
+    TEST_ASSERT_EQUAL( APP_PROV_HTTP_PARSE_BAD_REQUEST, feedString("GET / SIP/2.0\r\n\r\n") );
+
+    APP_PROV_HTTP_RequestInit(&req);
+    TEST_ASSERT_EQUAL( APP_PROV_HTTP_PARSE_BAD_REQUEST, feedString("POST / HTTP/1.1\r\nContent-Length: -1\r\n\r\n") );
+
+    APP_PROV_HTTP_RequestInit(&req);
+    TEST_ASSERT_EQUAL( APP_PROV_HTTP_PARSE_BAD_REQUEST, feedString("POST / HTTP/1.1\r\nContent-Length: x\r\n\r\n") );
+}
+
+/* A body that cannot fit after the headers is refused before it is read */
+TEST( APP_Unit_ProvHttp, TooLargeBody )
+{
+    TEST_ASSERT_EQUAL( APP_PROV_HTTP_PARSE_TOO_LARGE, feedString("POST /wifi HTTP/1.1\r\nContent-Length: 1000\r\n\r\n") );
+
+    /* The largest body that fits after these 44 bytes of headers is accepted */
+    APP_PROV_HTTP_RequestInit(&req);
+    TEST_ASSERT_EQUAL( APP_PROV_HTTP_PARSE_TOO_LARGE, feedString("POST /wifi HTTP/1.1\r\nContent-Length: 597\r\n\r\n") );
+    APP_PROV_HTTP_RequestInit(&req);
+    TEST_ASSERT_EQUAL( APP_PROV_HTTP_PARSE_MORE, feedString("POST /wifi HTTP/1.1\r\nContent-Length: 596\r\n\r\n") );
+    TEST_ASSERT_EQUAL( APP_PROV_HTTP_MAX_REQUEST, req.headerLen + req.contentLength );
+}
+
+/* Headers that fill the buffer without the blank line */
+TEST( APP_Unit_ProvHttp, TooLargeHeaders )
+{
+    char line[64];
+    APP_PROV_HTTP_PARSE_RESULT res = APP_PROV_HTTP_PARSE_MORE;
+    uint16_t space;
+
+    TEST_ASSERT_EQUAL( APP_PROV_HTTP_PARSE_MORE, feedString("GET / HTTP/1.1\r\n") );
+    memset(line, 'a', sizeof(line));
+    while (APP_PROV_HTTP_PARSE_MORE == res) {
+        APP_PROV_HTTP_RequestTail(&req, &space);
+        TEST_ASSERT_GREATER_THAN( 0, space );
+        res = feed(line, (space < sizeof(line)) ? space : sizeof(line));
+    }
+    TEST_ASSERT_EQUAL( APP_PROV_HTTP_PARSE_TOO_LARGE, res );
+    TEST_ASSERT_EQUAL( APP_PROV_HTTP_MAX_REQUEST, req.len );
+}
+
+/* The error responses close the connection */
+TEST( APP_Unit_ProvHttp, ResponseHeader )
+{
+    static const char expected[] =
+            "HTTP/1.1 413 Payload Too Large\r\n"
+            "Content-Type: application/json\r\n"
+            "Content-Length: 12\r\n"
+            "Cache-Control: no-store\r\n"
+            "Connection: close\r\n\r\n";
+    char header[160];
+
+    TEST_ASSERT_EQUAL( sizeof(expected) - 1,
+                       APP_PROV_HTTP_ResponseHeader(header, sizeof(header), 413, "application/json", 12, false) );
+    TEST_ASSERT_EQUAL_STRING( expected, header );
+
+    TEST_ASSERT_EQUAL( -1, APP_PROV_HTTP_ResponseHeader(header, sizeof(expected) - 1, 413, "application/json", 12, false) );
+}
+
+/*******************************************************************************
+ End of File
+ */
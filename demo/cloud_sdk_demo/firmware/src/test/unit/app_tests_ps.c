@@ -0,0 +1,288 @@
+/*******************************************************************************
+  MPLAB Harmony Application Test Source File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_tests_ps.c
+
+  Summary:
+    Tests for the Wi-Fi power-save policy.
+
+  Description:
+    Covers the mode picked for each kind of traffic, the listen interval and
+    sleep inactivity limit derived from the MQTT periods, and the radio duty
+    cycle estimated by APP_PS_PolicySimulate() for the traffic of the demo:
+    sparse telemetry, shadow exchanges, a steady uplink, a chatty downlink and
+    a TLS handshake that never completes.
+ *******************************************************************************/
+
+/* Standard includes. */
+#include <string.h>
+
+/* Module under test. */
+#include "app_ps_policy.h"
+
+/* Test framework includes. */
+#include "unity_fixture.h"
+
+// *****************************************************************************
+
+/* Step of the simulation in app_ps_policy.c */
+#define TEST_SIM_STEP_MS        10
+#define TEST_MAX_TRACE          4096
+/* The handshake of every trace */
+#define TEST_TLS_START_MS       100
+#define TEST_TLS_END_MS         2100
+
+static APP_PS_TRACE_ENTRY trace[TEST_MAX_TRACE];
+static size_t traceLen;
+
+// *****************************************************************************
+
+static void traceEvent(uint32_t timeMs, APP_PS_EVENT event)
+{
+    TEST_ASSERT_TRUE( traceLen < TEST_MAX_TRACE );
+    trace[traceLen].timeMs = timeMs;
+    trace[traceLen].event = event;
+    traceLen++;
+}
+
+/* Association and TLS handshake of the MQTT connection */
+static void traceConnect(void)
+{
+    traceEvent(0, APP_PS_EV_LINK_UP);
+    traceEvent(TEST_TLS_START_MS, APP_PS_EV_TLS_START);
+    traceEvent(TEST_TLS_END_MS, APP_PS_EV_TLS_END);
+}
+
+/* A publish every minute with the keepalive in between, as the demo does
+ * with its default telemetry period */
+static void traceTelemetry(uint32_t durationMs)
+{
+    uint32_t t;
+
+    for (t = 5000; t < durationMs; t += 30000) {
+        traceEvent(t, ((t / 30000) % 2) ? APP_PS_EV_KEEPALIVE : APP_PS_EV_PUBLISH);
+    }
+}
+
+// *****************************************************************************
+
+TEST_GROUP( APP_Unit_Ps );
+
+TEST_SETUP( APP_Unit_Ps )
+{
+    traceLen = 0;
+}
+
+TEST_TEAR_DOWN( APP_Unit_Ps )
+{
+}
+
+TEST_GROUP_RUNNER( APP_Unit_Ps )
+{
+    RUN_TEST_CASE( APP_Unit_Ps, RunModeUntilLinkUp );
+    RUN_TEST_CASE( APP_Unit_Ps, DownlinkHoldsRunMode );
+    RUN_TEST_CASE( APP_Unit_Ps, ListenInterval );
+    RUN_TEST_CASE( APP_Unit_Ps, SleepInactLimit );
+    RUN_TEST_CASE( APP_Unit_Ps, SparseTelemetryDuty );
+    RUN_TEST_CASE( APP_Unit_Ps, ShadowExchangesDuty );
+    RUN_TEST_CASE( APP_Unit_Ps, SteadyUplinkDuty );
+    RUN_TEST_CASE( APP_Unit_Ps, ChattyDownlinkDuty );
+    RUN_TEST_CASE( APP_Unit_Ps, StuckHandshakeBounded );
+}
+
+// *****************************************************************************
+
+/* Nothing saves power before the link is up and the handshake is done */
+TEST( APP_Unit_Ps, RunModeUntilLinkUp )
+{
+    APP_PS_POLICY policy;
+
+    APP_PS_PolicyInit(&policy, 60000, 60000);
+    TEST_ASSERT_FALSE( APP_PS_PolicyUpdate(&policy, 0) );
+    TEST_ASSERT_EQUAL( APP_PS_RADIO_RUN, policy.mode );
+
+    APP_PS_PolicyEvent(&policy, APP_PS_EV_LINK_UP, 0);
+    APP_PS_PolicyEvent(&policy, APP_PS_EV_TLS_START, 10);
+    TEST_ASSERT_FALSE( APP_PS_PolicyUpdate(&policy, 20) );
+
+    APP_PS_PolicyEvent(&policy, APP_PS_EV_TLS_END, 2000);
+    TEST_ASSERT_TRUE( APP_PS_PolicyUpdate(&policy, 2000) );
+    TEST_ASSERT_EQUAL( APP_PS_RADIO_WDS, policy.mode );
+
+    APP_PS_PolicyEvent(&policy, APP_PS_EV_LINK_DOWN, 3000);
+    TEST_ASSERT_TRUE( APP_PS_PolicyUpdate(&policy, 3000) );
+    TEST_ASSERT_EQUAL( APP_PS_RADIO_RUN, policy.mode );
+}
+
+/* A downlink message keeps the radio up for the reply, then lets it doze */
+TEST( APP_Unit_Ps, DownlinkHoldsRunMode )
+{
+    APP_PS_POLICY policy;
+
+    APP_PS_PolicyInit(&policy, 60000, 60000);
+    APP_PS_PolicyEvent(&policy, APP_PS_EV_LINK_UP, 0);
+    APP_PS_PolicyUpdate(&policy, 0);
+    TEST_ASSERT_EQUAL( APP_PS_RADIO_WDS, policy.mode );
+
+    APP_PS_PolicyEvent(&policy, APP_PS_EV_RX, 1000);
+    APP_PS_PolicyUpdate(&policy, 1000);
+    TEST_ASSERT_EQUAL( APP_PS_RADIO_RUN, policy.mode );
+    APP_PS_PolicyUpdate(&policy, 1000 + APP_PS_POLICY_RX_HOLD_MS - 1);
+    TEST_ASSERT_EQUAL( APP_PS_RADIO_RUN, policy.mode );
+    APP_PS_PolicyUpdate(&policy, 1000 + APP_PS_POLICY_RX_HOLD_MS);
+    TEST_ASSERT_EQUAL( APP_PS_RADIO_WDS, policy.mode );
+
+    /* A shadow exchange holds longer, and a shorter hold does not cut it. */
+    APP_PS_PolicyEvent(&policy, APP_PS_EV_BURST, 5000);
+    APP_PS_PolicyEvent(&policy, APP_PS_EV_RX, 5100);
+    APP_PS_PolicyUpdate(&policy, 5000 + APP_PS_POLICY_BURST_HOLD_MS - 1);
+    TEST_ASSERT_EQUAL( APP_PS_RADIO_RUN, policy.mode );
+    APP_PS_PolicyUpdate(&policy, 5000 + APP_PS_POLICY_BURST_HOLD_MS);
+    TEST_ASSERT_NOT_EQUAL( APP_PS_RADIO_RUN, policy.mode );
+}
+
+/* The radio wakes for beacons about as often as the application talks */
+TEST( APP_Unit_Ps, ListenInterval )
+{
+    APP_PS_POLICY policy;
+
+    /* Nothing known: driver default. */
+    APP_PS_PolicyInit(&policy, 0, 0);
+    TEST_ASSERT_EQUAL( APP_PS_POLICY_LISTEN_MAX, APP_PS_PolicyListenInterval(&policy) );
+
+    APP_PS_PolicyInit(&policy, 60000, 60000);
+    TEST_ASSERT_EQUAL( APP_PS_POLICY_LISTEN_MAX, APP_PS_PolicyListenInterval(&policy) );
+
+    APP_PS_PolicyInit(&policy, 500, 60000);
+    TEST_ASSERT_EQUAL( 500 / APP_PS_POLICY_BEACON_MS, APP_PS_PolicyListenInterval(&policy) );
+
+    APP_PS_PolicyInit(&policy, 50, 60000);
+    TEST_ASSERT_EQUAL( APP_PS_POLICY_LISTEN_MIN, APP_PS_PolicyListenInterval(&policy) );
+
+    /* A busy downlink gets the shortest interval, whatever the uplink. */
+    APP_PS_PolicyInit(&policy, 60000, 60000);
+    policy.rxPerMin = APP_PS_POLICY_WDS_MAX_RX_PER_MIN * 10;
+    TEST_ASSERT_EQUAL( APP_PS_POLICY_LISTEN_MIN, APP_PS_PolicyListenInterval(&policy) );
+}
+
+/* NULL frames only after one and a half keepalive periods of silence */
+TEST( APP_Unit_Ps, SleepInactLimit )
+{
+    APP_PS_POLICY policy;
+
+    APP_PS_PolicyInit(&policy, 60000, 0);
+    TEST_ASSERT_EQUAL( 0, APP_PS_PolicySleepInactLimit(&policy) );
+
+    APP_PS_PolicyInit(&policy, 60000, 60000);
+    TEST_ASSERT_EQUAL( 90000 / APP_PS_POLICY_BEACON_MS, APP_PS_PolicySleepInactLimit(&policy) );
+
+    APP_PS_PolicyInit(&policy, 60000, 0xFFFFFFF);
+    TEST_ASSERT_EQUAL( 0xFFFF, APP_PS_PolicySleepInactLimit(&policy) );
+}
+
+/* Telemetry once a minute: the radio sleeps deeply between messages and is
+ * on well under 1% of the time */
+TEST( APP_Unit_Ps, SparseTelemetryDuty )
+{
+    const uint32_t durationMs = 30 * 60000;
+    APP_PS_SIM_RESULT result;
+
+    traceConnect();
+    traceTelemetry(durationMs);
+    APP_PS_PolicySimulate(trace, traceLen, durationMs, 60000, 60000, &result);
+
+    TEST_ASSERT_EQUAL_UINT32( TEST_TLS_END_MS - TEST_TLS_START_MS, result.runMs );
+    TEST_ASSERT_EQUAL_UINT32( 0, result.wsmMs );
+    TEST_ASSERT_EQUAL_UINT32( durationMs - (TEST_TLS_END_MS - TEST_TLS_START_MS), result.wdsMs );
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32( 4, result.modeChanges );
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32( 7, result.dutyPermille );
+}
+
+/* Shadow exchanges every five minutes cost their hold time, not a change
+ * of mode for the rest of the period */
+TEST( APP_Unit_Ps, ShadowExchangesDuty )
+{
+    const uint32_t durationMs = 30 * 60000;
+    APP_PS_SIM_RESULT result;
+    uint32_t t;
+
+    traceConnect();
+    for (t = 5000; t < durationMs; t += 30000) {
+        traceEvent(t, ((t / 30000) % 2) ? APP_PS_EV_KEEPALIVE : APP_PS_EV_PUBLISH);
+        if ((t - 5000) % 300000 == 0) {
+            traceEvent(t + 10, APP_PS_EV_BURST);
+            traceEvent(t + 200, APP_PS_EV_BURST);
+        }
+    }
+    APP_PS_PolicySimulate(trace, traceLen, durationMs, 60000, 60000, &result);
+
+    /* Six exchanges, each held from its last message. */
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32( TEST_TLS_END_MS - TEST_TLS_START_MS + 6 * APP_PS_POLICY_BURST_HOLD_MS, result.runMs );
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32( TEST_TLS_END_MS - TEST_TLS_START_MS + 6 * (APP_PS_POLICY_BURST_HOLD_MS + 200 + TEST_SIM_STEP_MS),
+                                      result.runMs );
+    TEST_ASSERT_EQUAL_UINT32( 0, result.wsmMs );
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32( 12, result.dutyPermille );
+}
+
+/* A publish every second stays in WSM, the AP buffering for less than a
+ * publish period */
+TEST( APP_Unit_Ps, SteadyUplinkDuty )
+{
+    const uint32_t durationMs = 10 * 60000;
+    APP_PS_SIM_RESULT result;
+    uint32_t t;
+
+    traceConnect();
+    for (t = 3000; t < durationMs; t += 1000) {
+        traceEvent(t, APP_PS_EV_PUBLISH);
+    }
+    APP_PS_PolicySimulate(trace, traceLen, durationMs, 1000, 60000, &result);
+
+    TEST_ASSERT_EQUAL_UINT32( TEST_TLS_END_MS - TEST_TLS_START_MS, result.runMs );
+    TEST_ASSERT_EQUAL_UINT32( 0, result.wdsMs );
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32( 4, result.modeChanges );
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32( 15, result.dutyPermille );
+}
+
+/* A downlink message every second keeps the radio answering: half of the
+ * time in run mode, never in WDS, and the duty cycle bounded by that */
+TEST( APP_Unit_Ps, ChattyDownlinkDuty )
+{
+    const uint32_t durationMs = 10 * 60000;
+    APP_PS_SIM_RESULT result;
+    uint32_t t;
+
+    traceConnect();
+    for (t = 3000; t < durationMs; t += 500) {
+        traceEvent(t, (t % 1000) ? APP_PS_EV_RX : APP_PS_EV_PUBLISH);
+    }
+    APP_PS_PolicySimulate(trace, traceLen, durationMs, 1000, 60000, &result);
+
+    TEST_ASSERT_EQUAL_UINT32( 0, result.wdsMs );
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32( durationMs / 2, result.runMs );
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32( 450, result.dutyPermille );
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32( 550, result.dutyPermille );
+}
+
+/* A handshake that never ends keeps run mode for the TLS timeout only */
+TEST( APP_Unit_Ps, StuckHandshakeBounded )
+{
+    const uint32_t durationMs = 60000;
+    APP_PS_SIM_RESULT result;
+
+    traceEvent(0, APP_PS_EV_LINK_UP);
+    traceEvent(TEST_TLS_START_MS, APP_PS_EV_TLS_START);
+    APP_PS_PolicySimulate(trace, traceLen, durationMs, 60000, 60000, &result);
+
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32( TEST_TLS_START_MS + APP_PS_POLICY_TLS_TMO_MS, result.runMs );
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32( APP_PS_POLICY_TLS_TMO_MS, result.runMs );
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32( 260, result.dutyPermille );
+}
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,319 @@
+/*******************************************************************************
+  MPLAB Harmony Application Test Source File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    app_tests_tls_mem.c
+
+  Summary:
+    Soak test of the static TLS memory arena.
+
+  Description:
+    Reconnects a client many times against a server over an in-memory pipe.
+    The client context is loaded into an arena the way net_pres_enc_glue.c
+    loads it on the device, with the bucket layout of user.h, see
+    test/wolfssl/user_settings.h. Every session has to complete its handshake
+    and exchange records, and the arena has to return to the state right after
+    partitioning once the session is freed, so it does not fragment over the
+    reconnects of a device that stays up for months.
+ *******************************************************************************/
+
+/* Standard includes. */
+#include <stdint.h>
+#include <string.h>
+
+/* wolfSSL includes. */
+#include <wolfssl/wolfcrypt/settings.h>
+#include <wolfssl/ssl.h>
+#include <wolfssl/certs_test.h>
+
+/* Test framework includes. */
+#include "unity_fixture.h"
+
+// *****************************************************************************
+
+/* Client sessions of the soak */
+#ifndef APP_TEST_TLS_RECONNECTS
+#define APP_TEST_TLS_RECONNECTS     10000
+#endif
+
+/* Server name of the wolfSSL test certificate */
+#define TEST_SNI                    "www.wolfssl.com"
+
+/* Capacity of each direction of the pipe; a full flight of the server fits */
+#define TEST_PIPE_SIZE              (24 * 1024)
+
+/* Rounds of connect and accept before a handshake counts as stuck */
+#define TEST_HANDSHAKE_ROUNDS       32
+
+typedef struct
+{
+    uint8_t buf[TEST_PIPE_SIZE];
+    size_t  len;
+}TEST_PIPE;
+
+/* Client to server and server to client */
+static TEST_PIPE pipeUp;
+static TEST_PIPE pipeDown;
+
+static byte clientArena[NET_PRES_WOLFSSL_STATIC_GEN_MEM_SIZE];
+#ifndef NET_PRES_WOLFSSL_MAX_FRAGMENT
+static byte clientIOArena[NET_PRES_WOLFSSL_STATIC_IO_MEM_SIZE];
+#endif
+
+static WOLFSSL_CTX* clientCtx;
+static WOLFSSL_CTX* serverCtx;
+
+/* Free blocks per bucket and IO buffers right after partitioning */
+static WOLFSSL_MEM_STATS arenaInitial;
+
+// *****************************************************************************
+
+static int _pipeRecv(TEST_PIPE* pPipe, char* buf, int sz)
+{
+    size_t n = (size_t)sz;
+
+    if (pPipe->len == 0)
+    {
+        return WOLFSSL_CBIO_ERR_WANT_READ;
+    }
+    if (n > pPipe->len)
+    {
+        n = pPipe->len;
+    }
+    memcpy(buf, pPipe->buf, n);
+    memmove(pPipe->buf, pPipe->buf + n, pPipe->len - n);
+    pPipe->len -= n;
+    return (int)n;
+}
+
+static int _pipeSend(TEST_PIPE* pPipe, const char* buf, int sz)
+{
+    size_t n = (size_t)sz;
+
+    if (n > sizeof(pPipe->buf) - pPipe->len)
+    {
+        n = sizeof(pPipe->buf) - pPipe->len;
+        if (n == 0)
+        {
+            return WOLFSSL_CBIO_ERR_WANT_WRITE;
+        }
+    }
+    memcpy(pPipe->buf + pPipe->len, buf, n);
+    pPipe->len += n;
+    return (int)n;
+}
+
+static int _clientRecv(WOLFSSL* ssl, char* buf, int sz, void* ctx)
+{
+    return _pipeRecv(&pipeDown, buf, sz);
+}
+
+static int _clientSend(WOLFSSL* ssl, char* buf, int sz, void* ctx)
+{
+    return _pipeSend(&pipeUp, buf, sz);
+}
+
+static int _serverRecv(WOLFSSL* ssl, char* buf, int sz, void* ctx)
+{
+    return _pipeRecv(&pipeUp, buf, sz);
+}
+
+static int _serverSend(WOLFSSL* ssl, char* buf, int sz, void* ctx)
+{
+    return _pipeSend(&pipeDown, buf, sz);
+}
+
+/* The wolfSSL test certificates have fixed dates; only the date is forgiven,
+ * here and when they are loaded */
+static int _verifyDates(int preverify, WOLFSSL_X509_STORE_CTX* store)
+{
+    if (preverify == 0 && (store->error == ASN_BEFORE_DATE_E || store->error == ASN_AFTER_DATE_E))
+    {
+        return 1;
+    }
+    return preverify;
+}
+
+static void _arenaState(WOLFSSL_MEM_STATS* pStats)
+{
+    memset(pStats, 0, sizeof(*pStats));
+    TEST_ASSERT_EQUAL_INT( 1, wolfSSL_CTX_is_static_memory( clientCtx, pStats ) );
+}
+
+/* One session: handshake, a record each way, close, free */
+static void _session(uint32_t* pConnPeak)
+{
+    WOLFSSL* client;
+    WOLFSSL* server;
+    WOLFSSL_MEM_CONN_STATS connStats;
+    const char request[] = "{\"state\":{\"reported\":{\"on\":true}}}";
+    char reply[sizeof(request)];
+    int clientDone = 0;
+    int serverDone = 0;
+    int round;
+
+    pipeUp.len = 0;
+    pipeDown.len = 0;
+
+    client = wolfSSL_new(clientCtx);
+    TEST_ASSERT_NOT_NULL( client );
+    server = wolfSSL_new(serverCtx);
+    TEST_ASSERT_NOT_NULL( server );
+    TEST_ASSERT_EQUAL_INT( WOLFSSL_SUCCESS, wolfSSL_UseSNI( client, WOLFSSL_SNI_HOST_NAME, TEST_SNI, sizeof(TEST_SNI) - 1 ) );
+#ifdef NET_PRES_WOLFSSL_MAX_FRAGMENT
+    TEST_ASSERT_EQUAL_INT( WOLFSSL_SUCCESS, wolfSSL_UseMaxFragment( client, NET_PRES_WOLFSSL_MAX_FRAGMENT ) );
+#endif
+
+    for (round = 0; round < TEST_HANDSHAKE_ROUNDS && !(clientDone && serverDone); round++)
+    {
+        if (!clientDone)
+        {
+            if (wolfSSL_connect(client) == WOLFSSL_SUCCESS)
+            {
+                clientDone = 1;
+            }
+            else
+            {
+                TEST_ASSERT_EQUAL_INT( WOLFSSL_ERROR_WANT_READ, wolfSSL_get_error( client, 0 ) );
+            }
+        }
+        if (!serverDone)
+        {
+            if (wolfSSL_accept(server) == WOLFSSL_SUCCESS)
+            {
+                serverDone = 1;
+            }
+            else
+            {
+                TEST_ASSERT_EQUAL_INT( WOLFSSL_ERROR_WANT_READ, wolfSSL_get_error( server, 0 ) );
+            }
+        }
+    }
+    TEST_ASSERT_TRUE( clientDone && serverDone );
+#ifdef NET_PRES_WOLFSSL_MAX_FRAGMENT
+    /* The server took the smaller records. */
+    TEST_ASSERT_TRUE( wolfSSL_GetMaxOutputSize( client ) <= (1 << (8 + NET_PRES_WOLFSSL_MAX_FRAGMENT)) );
+#endif
+
+    TEST_ASSERT_EQUAL_INT( sizeof(request), wolfSSL_write( client, request, sizeof(request) ) );
+    TEST_ASSERT_EQUAL_INT( sizeof(request), wolfSSL_read( server, reply, sizeof(reply) ) );
+    TEST_ASSERT_EQUAL_INT( sizeof(request), wolfSSL_write( server, reply, sizeof(reply) ) );
+    memset(reply, 0, sizeof(reply));
+    TEST_ASSERT_EQUAL_INT( sizeof(request), wolfSSL_read( client, reply, sizeof(reply) ) );
+    TEST_ASSERT_EQUAL_STRING( request, reply );
+
+    memset(&connStats, 0, sizeof(connStats));
+    TEST_ASSERT_EQUAL_INT( 1, wolfSSL_is_static_memory( client, &connStats ) );
+    if (connStats.peakMem > *pConnPeak)
+    {
+        *pConnPeak = connStats.peakMem;
+    }
+
+    wolfSSL_shutdown(client);
+    wolfSSL_free(client);
+    wolfSSL_free(server);
+}
+
+// *****************************************************************************
+
+TEST_GROUP( APP_Unit_TlsMem );
+
+TEST_SETUP( APP_Unit_TlsMem )
+{
+    TEST_ASSERT_EQUAL_INT( WOLFSSL_SUCCESS, wolfSSL_Init() );
+
+    /* Client: static arena, as on the device. */
+    clientCtx = NULL;
+    TEST_ASSERT_EQUAL_INT( WOLFSSL_SUCCESS, wolfSSL_CTX_load_static_memory( &clientCtx, wolfSSLv23_client_method_ex,
+                                                                            clientArena, sizeof(clientArena),
+                                                                            WOLFMEM_GENERAL | WOLFMEM_TRACK_STATS,
+                                                                            NET_PRES_WOLFSSL_STATIC_MAX_CONN ) );
+#ifndef NET_PRES_WOLFSSL_MAX_FRAGMENT
+    TEST_ASSERT_EQUAL_INT( WOLFSSL_SUCCESS, wolfSSL_CTX_load_static_memory( &clientCtx, NULL,
+                                                                            clientIOArena, sizeof(clientIOArena),
+                                                                            WOLFMEM_IO_POOL,
+                                                                            NET_PRES_WOLFSSL_STATIC_MAX_CONN ) );
+#endif
+    _arenaState(&arenaInitial);
+
+    TEST_ASSERT_EQUAL_INT( WOLFSSL_SUCCESS, wolfSSL_CTX_load_verify_buffer_ex( clientCtx, ca_cert_der_2048,
+                                                                               sizeof_ca_cert_der_2048, WOLFSSL_FILETYPE_ASN1,
+                                                                               0, WOLFSSL_LOAD_FLAG_DATE_ERR_OKAY ) );
+    TEST_ASSERT_EQUAL_INT( WOLFSSL_SUCCESS, wolfSSL_CTX_use_certificate_buffer( clientCtx, cliecc_cert_der_256,
+                                                                                sizeof_cliecc_cert_der_256, WOLFSSL_FILETYPE_ASN1 ) );
+    TEST_ASSERT_EQUAL_INT( WOLFSSL_SUCCESS, wolfSSL_CTX_use_PrivateKey_buffer( clientCtx, ecc_clikey_der_256,
+                                                                               sizeof_ecc_clikey_der_256, WOLFSSL_FILETYPE_ASN1 ) );
+    wolfSSL_CTX_set_verify(clientCtx, WOLFSSL_VERIFY_PEER, _verifyDates);
+    wolfSSL_CTX_SetIORecv(clientCtx, _clientRecv);
+    wolfSSL_CTX_SetIOSend(clientCtx, _clientSend);
+
+    /* Server: heap, with the RSA chain of the AWS IoT endpoints. */
+    serverCtx = wolfSSL_CTX_new(wolfSSLv23_server_method());
+    TEST_ASSERT_NOT_NULL( serverCtx );
+    TEST_ASSERT_EQUAL_INT( WOLFSSL_SUCCESS, wolfSSL_CTX_use_certificate_buffer( serverCtx, server_cert_der_2048,
+                                                                                sizeof_server_cert_der_2048, WOLFSSL_FILETYPE_ASN1 ) );
+    TEST_ASSERT_EQUAL_INT( WOLFSSL_SUCCESS, wolfSSL_CTX_use_PrivateKey_buffer( serverCtx, server_key_der_2048,
+                                                                               sizeof_server_key_der_2048, WOLFSSL_FILETYPE_ASN1 ) );
+    TEST_ASSERT_EQUAL_INT( WOLFSSL_SUCCESS, wolfSSL_CTX_load_verify_buffer_ex( serverCtx, cliecc_cert_der_256,
+                                                                               sizeof_cliecc_cert_der_256, WOLFSSL_FILETYPE_ASN1,
+                                                                               0, WOLFSSL_LOAD_FLAG_DATE_ERR_OKAY ) );
+    wolfSSL_CTX_set_verify(serverCtx, WOLFSSL_VERIFY_PEER | WOLFSSL_VERIFY_FAIL_IF_NO_PEER_CERT, _verifyDates);
+    wolfSSL_CTX_SetIORecv(serverCtx, _serverRecv);
+    wolfSSL_CTX_SetIOSend(serverCtx, _serverSend);
+}
+
+TEST_TEAR_DOWN( APP_Unit_TlsMem )
+{
+    wolfSSL_CTX_free(serverCtx);
+    serverCtx = NULL;
+    wolfSSL_CTX_free(clientCtx);
+    clientCtx = NULL;
+    wolfSSL_Cleanup();
+}
+
+TEST_GROUP_RUNNER( APP_Unit_TlsMem )
+{
+    RUN_TEST_CASE( APP_Unit_TlsMem, ReconnectSoak );
+}
+
+// *****************************************************************************
+
+/* Every reconnect succeeds and hands all of its blocks back */
+TEST( APP_Unit_TlsMem, ReconnectSoak )
+{
+    WOLFSSL_MEM_STATS before;
+    WOLFSSL_MEM_STATS after;
+    uint32_t connPeak = 0;
+    uint32_t i;
+    int b;
+
+    /* Blocks held by the context itself: certificates and keys. */
+    _arenaState(&before);
+
+    for (i = 0; i < APP_TEST_TLS_RECONNECTS; i++)
+    {
+        _session(&connPeak);
+
+        _arenaState(&after);
+        for (b = 0; b < WOLFMEM_MAX_BUCKETS; b++)
+        {
+            TEST_ASSERT_EQUAL_UINT32( before.avaBlock[b], after.avaBlock[b] );
+        }
+        TEST_ASSERT_EQUAL_UINT32( arenaInitial.avaIO, after.avaIO );
+        TEST_ASSERT_EQUAL_UINT32( before.curAlloc, after.curAlloc );
+    }
+
+    /* A session fits the arena next to the context. */
+    TEST_ASSERT_TRUE( connPeak > 0 );
+    TEST_ASSERT_TRUE( connPeak < NET_PRES_WOLFSSL_STATIC_GEN_MEM_SIZE );
+
+    /* Nothing else came from the arena in between. */
+    TEST_ASSERT_EQUAL_UINT32( after.totalAlloc - before.totalAlloc, after.totalFr - before.totalFr );
+}
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,85 @@
+/*******************************************************************************
+  wolfSSL Host Test Configuration Header
+
+  File Name:
+    user_settings.h
+
+  Summary:
+    wolfSSL options of the host build used by the TLS memory tests.
+
+  Description:
+    The static memory and record size options are those of user.h in the
+    aws_sdk_wfi32_iot_freertos configuration; keep both in step. The TLS
+    options follow the wolfSSL sections of configuration.h as far as a host
+    without the crypto engine and the ECC608 allows: keys and signatures are
+    done in software, and the server side is built for the peer of the tests.
+    Define APP_TEST_TLS_FULL_RECORDS to build the layout without a negotiated
+    max fragment length.
+ *******************************************************************************/
+
+#ifndef USER_SETTINGS_H
+#define USER_SETTINGS_H
+
+/* Static memory, as in user.h */
+#define WOLFSSL_STATIC_MEMORY
+#define HAVE_MAX_FRAGMENT
+#ifndef APP_TEST_TLS_FULL_RECORDS
+#define NET_PRES_WOLFSSL_MAX_FRAGMENT       WOLFSSL_MFL_2_11
+#endif
+#ifdef NET_PRES_WOLFSSL_MAX_FRAGMENT
+#define LARGEST_MEM_BUCKET                  16992
+#define WOLFMEM_DIST                        40,10,6,12,5,8,4,2,2
+#define NET_PRES_WOLFSSL_STATIC_MAX_CONN    1
+#define NET_PRES_WOLFSSL_STATIC_GEN_MEM_SIZE    (100 * 1024)
+#else
+#define WOLFMEM_DIST                        40,10,6,12,5,8,4,2,1
+#define NET_PRES_WOLFSSL_STATIC_MAX_CONN    1
+#define NET_PRES_WOLFSSL_STATIC_GEN_MEM_SIZE    (80 * 1024)
+#define NET_PRES_WOLFSSL_STATIC_IO_MEM_SIZE     (2 * NET_PRES_WOLFSSL_STATIC_MAX_CONN * (WOLFMEM_IO_SZ + 32) + 16)
+#endif
+
+/* TLS layer, as in configuration.h */
+#define WOLFSSL_ALT_NAMES
+#define WOLFSSL_DER_LOAD
+#define KEEP_OUR_CERT
+#define KEEP_PEER_CERT
+#define WOLFSSL_USER_IO
+#define NO_WRITEV
+#define WOLFSSL_DTLS
+#define HAVE_TLS_EXTENSIONS
+#define HAVE_SUPPORTED_CURVES
+#define HAVE_SNI
+#define NO_ERROR_STRINGS
+#define NO_OLD_TLS
+#define HAVE_PK_CALLBACKS
+
+/* wolfCrypt, as in configuration.h */
+#define NO_FILESYSTEM
+#define USE_FAST_MATH
+#define TFM_NO_ASM
+#define WOLFSSL_NO_ASM
+#define FP_MAX_BITS 4096
+#define WOLFSSL_AES_SMALL_TABLES
+#define HAVE_AESGCM
+#define HAVE_ECC
+#define HAVE_HASHDRBG
+#define NO_MD4
+#define NO_RC4
+#define NO_HC128
+#define NO_RABBIT
+#define NO_DH
+#define NO_DSA
+#define NO_SIG_WRAPPER
+#define WC_NO_HARDEN
+#define WOLFSSL_DER_TO_PEM
+#define WOLFSSL_BASE64_ENCODE
+
+/* Host only: the tests run in one thread and use the wolfSSL test keys */
+#define SINGLE_THREADED
+#define USE_CERT_BUFFERS_2048
+#define USE_CERT_BUFFERS_256
+
+#endif // USER_SETTINGS_H
+/*******************************************************************************
+ End of File
+*/
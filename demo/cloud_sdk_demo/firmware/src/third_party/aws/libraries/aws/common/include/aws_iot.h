@@ -113,8 +113,7 @@
  * subscriptions.
  * @param[in] subscriptionCount The number of elements in pSubscriptionList.
  * @param[in] flags Flags which modify the behavior of this function. See @ref mqtt_constants_flags.
- * Currently, flags are ignored by this function; this parameter is for
- * future-compatibility.
+ * #IOT_MQTT_FLAG_SESSION_RESTORE is only used by @ref mqtt_function_subscribesync.
  * @param[in] timeoutMs If the MQTT server does not acknowledge the subscriptions within
  * this timeout in milliseconds, this function returns #IOT_MQTT_TIMEOUT.
  *
@@ -179,6 +178,7 @@ typedef struct AwsIotSubscriptionInfo_t
     IotMqttConnection_t mqttConnection;            /**< @brief The MQTT connection to use. */
     AwsIotMqttCallbackFunction_t callbackFunction; /**< @brief Callback function for MQTT subscribe. */
     uint32_t timeout;                              /**< @brief Timeout for MQTT function. */
+    uint32_t flags;                                /**< @brief Flags for MQTT function. */
 
     /* Topic filter. */
     char * pTopicFilterBase;        /**< @brief Contains the base topic filter, without "/accepted" or "/rejected". */
@@ -66,4 +66,38 @@ bool AwsIotDocParser_FindValue( const char * pAwsIotJsonDocument,
                                 const char ** pAwsIotJsonValue,
                                 size_t * pAwsIotJsonValueLength );
 
+/**
+ * @brief Find a value by its path from the top of a JSON document.
+ *
+ * Unlike AwsIotDocParser_FindValue(), a key only matches a member of the object
+ * the path leads to; a key of the same name nested elsewhere in the document,
+ * or a string value that reads like the key, is never taken for it. The path
+ * holds keys separated by `.`, such as `state.reported`, each one naming a member
+ * of the object reached by the keys before it. Keys are compared as they are
+ * written in the document, without decoding escapes, and cannot contain a `.`.
+ *
+ * The document is scanned in place, once, with no memory allocation and a
+ * constant stack. Each lookup is bounded by the value found for the key before
+ * it, and whatever the scan passes over must be well formed: an unterminated
+ * string, mismatched or unbalanced brackets, more than 32 levels of nesting or
+ * a document cut short make the lookup fail.
+ *
+ * @param[in] pAwsIotJsonDocument Pointer to AWS IoT Service JSON document.
+ * @param[in] awsIotJsonDocumentLength Length of AWS IoT Service JSON document.
+ * @param[in] pAwsIotJsonPath Keys separated by `.`, from the top level object.
+ * @param[in] awsIotJsonPathLength Length of the path.
+ * @param[out] pAwsIotJsonValue Pointer to the pointer of value found.
+ * @param[out] pAwsIotJsonValueLength Pointer to the length of the value found.
+ *
+ * @returns `true` if a value is found, `false` if a value cannot be found. As
+ * with AwsIotDocParser_FindValue(), a string value includes its quotes. If
+ * returns `false`, the values in out pointers will not be valid.
+ */
+bool AwsIotDocParser_FindPath( const char * pAwsIotJsonDocument,
+                               size_t awsIotJsonDocumentLength,
+                               const char * pAwsIotJsonPath,
+                               size_t awsIotJsonPathLength,
+                               const char ** pAwsIotJsonValue,
+                               size_t * pAwsIotJsonValueLength );
+
 #endif /* ifndef AWS_IOT_DOC_PARSER_H_ */
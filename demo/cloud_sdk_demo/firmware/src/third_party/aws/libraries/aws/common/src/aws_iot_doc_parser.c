@@ -29,6 +29,7 @@
 #include "iot_config.h"
 
 /* Standard includes. */
+#include <stdint.h>
 #include <string.h>
 
 /* JSON utilities include. */
@@ -39,6 +40,65 @@
 #define IS_WHITESPACE( str, idx ) \
     ( ( str )[ ( idx ) ] == ' ' || ( str )[ ( idx ) ] == '\n' || ( str )[ ( idx ) ] == '\r' || ( str )[ ( idx ) ] == '\t' )
 
+/**
+ * @brief Deepest nesting of objects and arrays in a value skipped by
+ * AwsIotDocParser_FindPath(), one bit per level.
+ */
+#define MAX_NESTING_DEPTH    ( 32 )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Skip the whitespace starting at an index.
+ *
+ * @return The index of the next character that is not whitespace.
+ */
+static size_t _skipWhitespace( const char * pJsonDocument,
+                               size_t jsonDocumentLength,
+                               size_t index );
+
+/**
+ * @brief Skip a JSON string, starting at its opening quote.
+ *
+ * @param[in,out] pIndex Index of the opening quote; set past the closing quote.
+ *
+ * @return `false` if the string is not terminated.
+ */
+static bool _skipString( const char * pJsonDocument,
+                         size_t jsonDocumentLength,
+                         size_t * pIndex );
+
+/**
+ * @brief Skip a JSON value, checking that its brackets are balanced and that
+ * a true, false or null is spelled out in full.
+ *
+ * @param[in,out] pIndex Index of the first character; set past the last one.
+ *
+ * @return `false` if the value is empty or malformed.
+ */
+static bool _skipValue( const char * pJsonDocument,
+                        size_t jsonDocumentLength,
+                        size_t * pIndex );
+
+/**
+ * @brief Find a member of a JSON object by its key.
+ *
+ * The member's value must be followed by the `,` or `}` that ends it, so that
+ * a value cut short by the end of the document is not taken whole.
+ *
+ * @param[in,out] pIndex Index of the object's opening brace; set to the first
+ * character of the member's value.
+ * @param[out] pValueEnd Set past the last character of the member's value.
+ *
+ * @return `false` if the object has no such member or is malformed.
+ */
+static bool _findMember( const char * pJsonDocument,
+                         size_t jsonDocumentLength,
+                         const char * pKey,
+                         size_t keyLength,
+                         size_t * pIndex,
+                         size_t * pValueEnd );
+
 /*-----------------------------------------------------------*/
 
 bool AwsIotDocParser_FindValue( const char * pAwsIotJsonDocument,
@@ -292,3 +352,303 @@ bool AwsIotDocParser_FindValue( const char * pAwsIotJsonDocument,
 }
 
 /*-----------------------------------------------------------*/
+
+static size_t _skipWhitespace( const char * pJsonDocument,
+                               size_t jsonDocumentLength,
+                               size_t index )
+{
+    while( ( index < jsonDocumentLength ) && IS_WHITESPACE( pJsonDocument, index ) )
+    {
+        index++;
+    }
+
+    return index;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool _skipString( const char * pJsonDocument,
+                         size_t jsonDocumentLength,
+                         size_t * pIndex )
+{
+    size_t i = *pIndex + 1;
+
+    while( i < jsonDocumentLength )
+    {
+        if( pJsonDocument[ i ] == '\\' )
+        {
+            /* Skip the escaped character, whatever it is. */
+            i += 2;
+        }
+        else if( pJsonDocument[ i ] == '\"' )
+        {
+            *pIndex = i + 1;
+
+            return true;
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    return false;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool _skipValue( const char * pJsonDocument,
+                        size_t jsonDocumentLength,
+                        size_t * pIndex )
+{
+    size_t i = *pIndex, depth = 0, literalLength = 0;
+    uint32_t arrayLevels = 0;
+    const char * pLiteral = NULL;
+    char c = '\0';
+
+    if( i >= jsonDocumentLength )
+    {
+        return false;
+    }
+
+    switch( pJsonDocument[ i ] )
+    {
+        case '\"':
+
+            return _skipString( pJsonDocument, jsonDocumentLength, pIndex );
+
+        case '{':
+        case '[':
+
+            /* Bit 0 of arrayLevels tells whether the innermost open level is
+             * an array, so that each closing character must match its opening
+             * one. */
+            while( i < jsonDocumentLength )
+            {
+                c = pJsonDocument[ i ];
+
+                if( c == '\"' )
+                {
+                    if( _skipString( pJsonDocument, jsonDocumentLength, &i ) == false )
+                    {
+                        return false;
+                    }
+
+                    continue;
+                }
+
+                if( ( c == '{' ) || ( c == '[' ) )
+                {
+                    if( depth == MAX_NESTING_DEPTH )
+                    {
+                        return false;
+                    }
+
+                    arrayLevels = ( arrayLevels << 1 ) | ( ( c == '[' ) ? 1UL : 0UL );
+                    depth++;
+                }
+                else if( ( c == '}' ) || ( c == ']' ) )
+                {
+                    if( ( ( arrayLevels & 1UL ) == 1UL ) != ( c == ']' ) )
+                    {
+                        return false;
+                    }
+
+                    arrayLevels >>= 1;
+                    depth--;
+                }
+
+                i++;
+
+                if( depth == 0 )
+                {
+                    *pIndex = i;
+
+                    return true;
+                }
+            }
+
+            return false;
+
+        case 't':
+        case 'f':
+        case 'n':
+
+            pLiteral = ( pJsonDocument[ i ] == 't' ) ? "true" :
+                       ( ( pJsonDocument[ i ] == 'f' ) ? "false" : "null" );
+            literalLength = strlen( pLiteral );
+
+            if( ( jsonDocumentLength - i < literalLength ) ||
+                ( memcmp( pJsonDocument + i, pLiteral, literalLength ) != 0 ) )
+            {
+                return false;
+            }
+
+            *pIndex = i + literalLength;
+
+            return true;
+
+        default:
+
+            /* A number runs up to the first character that cannot be part of
+             * one, which the caller checks is a delimiter. */
+            while( i < jsonDocumentLength )
+            {
+                c = pJsonDocument[ i ];
+
+                if( !( ( ( c >= '0' ) && ( c <= '9' ) ) ||
+                       ( c == '-' ) || ( c == '+' ) || ( c == '.' ) ||
+                       ( c == 'e' ) || ( c == 'E' ) ) )
+                {
+                    break;
+                }
+
+                i++;
+            }
+
+            if( i == *pIndex )
+            {
+                return false;
+            }
+
+            *pIndex = i;
+
+            return true;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static bool _findMember( const char * pJsonDocument,
+                         size_t jsonDocumentLength,
+                         const char * pKey,
+                         size_t keyLength,
+                         size_t * pIndex,
+                         size_t * pValueEnd )
+{
+    size_t i = *pIndex, keyStart = 0, valueStart = 0, valueEnd = 0;
+    bool keyMatches = false;
+
+    if( ( i >= jsonDocumentLength ) || ( pJsonDocument[ i ] != '{' ) )
+    {
+        return false;
+    }
+
+    i = _skipWhitespace( pJsonDocument, jsonDocumentLength, i + 1 );
+
+    /* Each member is a key string, a : and a value, followed by a , or the
+     * closing brace, which ends the search. */
+    while( ( i < jsonDocumentLength ) && ( pJsonDocument[ i ] == '\"' ) )
+    {
+        keyStart = i + 1;
+
+        if( _skipString( pJsonDocument, jsonDocumentLength, &i ) == false )
+        {
+            return false;
+        }
+
+        keyMatches = ( ( i - 1 - keyStart ) == keyLength ) &&
+                     ( memcmp( pJsonDocument + keyStart, pKey, keyLength ) == 0 );
+
+        i = _skipWhitespace( pJsonDocument, jsonDocumentLength, i );
+
+        if( ( i >= jsonDocumentLength ) || ( pJsonDocument[ i ] != ':' ) )
+        {
+            return false;
+        }
+
+        i = _skipWhitespace( pJsonDocument, jsonDocumentLength, i + 1 );
+        valueStart = i;
+
+        if( _skipValue( pJsonDocument, jsonDocumentLength, &i ) == false )
+        {
+            return false;
+        }
+
+        valueEnd = i;
+        i = _skipWhitespace( pJsonDocument, jsonDocumentLength, i );
+
+        if( ( i >= jsonDocumentLength ) ||
+            ( ( pJsonDocument[ i ] != ',' ) && ( pJsonDocument[ i ] != '}' ) ) )
+        {
+            return false;
+        }
+
+        if( keyMatches == true )
+        {
+            *pIndex = valueStart;
+            *pValueEnd = valueEnd;
+
+            return true;
+        }
+
+        if( pJsonDocument[ i ] == '}' )
+        {
+            return false;
+        }
+
+        i = _skipWhitespace( pJsonDocument, jsonDocumentLength, i + 1 );
+    }
+
+    return false;
+}
+
+/*-----------------------------------------------------------*/
+
+bool AwsIotDocParser_FindPath( const char * pAwsIotJsonDocument,
+                               size_t awsIotJsonDocumentLength,
+                               const char * pAwsIotJsonPath,
+                               size_t awsIotJsonPathLength,
+                               const char ** pAwsIotJsonValue,
+                               size_t * pAwsIotJsonValueLength )
+{
+    size_t i = 0, valueEnd = awsIotJsonDocumentLength;
+    size_t keyStart = 0, keyEnd = 0;
+
+    /* Validate all the arguments.*/
+    if( ( pAwsIotJsonDocument == NULL ) || ( pAwsIotJsonPath == NULL ) ||
+        ( awsIotJsonDocumentLength == 0 ) || ( awsIotJsonPathLength == 0 ) )
+    {
+        return false;
+    }
+
+    i = _skipWhitespace( pAwsIotJsonDocument, awsIotJsonDocumentLength, 0 );
+
+    /* Look up each key of the path in the value found for the one before it. */
+    while( keyStart <= awsIotJsonPathLength )
+    {
+        keyEnd = keyStart;
+
+        while( ( keyEnd < awsIotJsonPathLength ) && ( pAwsIotJsonPath[ keyEnd ] != '.' ) )
+        {
+            keyEnd++;
+        }
+
+        if( ( keyEnd == keyStart ) ||
+            ( _findMember( pAwsIotJsonDocument,
+                           valueEnd,
+                           pAwsIotJsonPath + keyStart,
+                           keyEnd - keyStart,
+                           &i,
+                           &valueEnd ) == false ) )
+        {
+            return false;
+        }
+
+        keyStart = keyEnd + 1;
+    }
+
+    if( pAwsIotJsonValue != NULL )
+    {
+        *pAwsIotJsonValue = pAwsIotJsonDocument + i;
+    }
+
+    if( pAwsIotJsonValueLength != NULL )
+    {
+        *pAwsIotJsonValueLength = valueEnd - i;
+    }
+
+    return true;
+}
+
+/*-----------------------------------------------------------*/
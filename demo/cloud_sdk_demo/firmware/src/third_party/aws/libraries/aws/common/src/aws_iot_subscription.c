@@ -79,13 +79,12 @@ static IotMqttError_t _modifySubscriptions( AwsIotMqttFunction_t mqttOperation,
 
     /* Call the MQTT operation function.
      * Subscription count is 1 in this case.
-     * None of the flags are set in this call. Hence 0 is passed for flags.
      * Please refer to documentation for AwsIotMqttFunction_t for more details.
      */
     status = mqttOperation( pSubscriptionInfo->mqttConnection,
                             &subscription,
                             1,
-                            0,
+                            pSubscriptionInfo->flags,
                             pSubscriptionInfo->timeout );
 
     return status;
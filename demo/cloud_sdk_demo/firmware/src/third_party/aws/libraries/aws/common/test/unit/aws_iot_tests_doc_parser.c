@@ -33,6 +33,9 @@
 #include <stdio.h>
 #include <string.h>
 
+/* Platform clock include. */
+#include "platform/iot_clock.h"
+
 /* AWS IoT parser include. */
 #include "aws_iot_doc_parser.h"
 
@@ -71,6 +74,61 @@ static void _parseJson( bool expectedResult,
 
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief Lookups of each path in #TEST_Aws_Iot_Doc_Unit_Parser_Benchmark.
+ */
+#define BENCHMARK_LOOKUPS    ( 100000 )
+
+/**
+ * @brief A Shadow get accepted document, as sent by the service.
+ */
+static const char _shadowGetDocument[] =
+    "{\"state\":{\"desired\":{\"toggle\":1,\"temperature\":20},"
+    "\"reported\":{\"toggle\":0,\"temperature\":23,\"light\":512,\"version\":\"1.2.0\"},"
+    "\"delta\":{\"toggle\":1}},"
+    "\"metadata\":{\"desired\":{\"toggle\":{\"timestamp\":1603097470},\"temperature\":{\"timestamp\":1603097470}},"
+    "\"reported\":{\"toggle\":{\"timestamp\":1603097412},\"temperature\":{\"timestamp\":1603097412},"
+    "\"light\":{\"timestamp\":1603097412},\"version\":{\"timestamp\":1603097412}}},"
+    "\"version\":1187,\"timestamp\":1603097471,\"clientToken\":\"wfi32-0f3a9c\"}";
+
+/**
+ * @brief A Shadow delta document, as sent by the service.
+ */
+static const char _shadowDeltaDocument[] =
+    "{\"version\":1188,\"timestamp\":1603097502,\"state\":{\"toggle\":0},"
+    "\"metadata\":{\"toggle\":{\"timestamp\":1603097502}}}";
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Wrapper for looking up paths in JSON documents and checking the result.
+ */
+static void _parsePath( bool expectedResult,
+                        const char * pJsonDocument,
+                        size_t jsonDocumentLength,
+                        const char * pJsonPath,
+                        const char * pExpectedJsonValue )
+{
+    const char * pJsonValue = NULL;
+    size_t jsonValueLength = 0;
+
+    TEST_ASSERT_EQUAL_INT( expectedResult,
+                           AwsIotDocParser_FindPath( pJsonDocument,
+                                                     jsonDocumentLength,
+                                                     pJsonPath,
+                                                     strlen( pJsonPath ),
+                                                     &pJsonValue,
+                                                     &jsonValueLength ) );
+
+    if( expectedResult == true )
+    {
+        TEST_ASSERT_EQUAL( strlen( pExpectedJsonValue ), jsonValueLength );
+        TEST_ASSERT_EQUAL_STRING_LEN( pExpectedJsonValue, pJsonValue, jsonValueLength );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
 /**
  * @brief Test group for Shadow parser tests.
  */
@@ -103,6 +161,9 @@ TEST_GROUP_RUNNER( Aws_Iot_Doc_Unit_Parser )
 {
     RUN_TEST_CASE( Aws_Iot_Doc_Unit_Parser, JsonValid );
     RUN_TEST_CASE( Aws_Iot_Doc_Unit_Parser, JsonInvalid );
+    RUN_TEST_CASE( Aws_Iot_Doc_Unit_Parser, PathValid );
+    RUN_TEST_CASE( Aws_Iot_Doc_Unit_Parser, PathInvalid );
+    RUN_TEST_CASE( Aws_Iot_Doc_Unit_Parser, Benchmark );
 }
 
 /*-----------------------------------------------------------*/
@@ -315,3 +376,194 @@ TEST( Aws_Iot_Doc_Unit_Parser, JsonInvalid )
 }
 
 /*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests looking up paths in valid JSON documents.
+ */
+TEST( Aws_Iot_Doc_Unit_Parser, PathValid )
+{
+    const size_t getLength = sizeof( _shadowGetDocument ) - 1;
+    const size_t deltaLength = sizeof( _shadowDeltaDocument ) - 1;
+
+    /* Top level keys are not confused with nested keys of the same name. */
+    _parsePath( true, _shadowGetDocument, getLength, "version", "1187" );
+    _parsePath( true, _shadowGetDocument, getLength, "state.reported.version", "\"1.2.0\"" );
+    _parsePath( true, _shadowGetDocument, getLength, "state.delta", "{\"toggle\":1}" );
+    _parsePath( true, _shadowGetDocument, getLength, "state.reported.toggle", "0" );
+    _parsePath( true, _shadowGetDocument, getLength, "metadata.reported.light.timestamp", "1603097412" );
+    _parsePath( true, _shadowGetDocument, getLength, "clientToken", "\"wfi32-0f3a9c\"" );
+    _parsePath( true, _shadowDeltaDocument, deltaLength, "state.toggle", "0" );
+
+    /* Keys found by AwsIotDocParser_FindValue anywhere are only found where
+     * the path leads. */
+    _parsePath( false, _shadowDeltaDocument, deltaLength, "toggle", NULL );
+    _parsePath( false, _shadowGetDocument, getLength, "state.timestamp", NULL );
+
+    /* Whitespace, arrays, escapes and brackets within strings. */
+    {
+        const char pJsonDocument[] = " \r\n{ \"a\" : [ 1, {\"b\":\"}]\\\"\"} ] ,\n\t\"c\" :\t{ \"d\" : -1.5e+3 } }";
+        size_t jsonDocumentLength = strlen( pJsonDocument );
+
+        _parsePath( true, pJsonDocument, jsonDocumentLength, "a", "[ 1, {\"b\":\"}]\\\"\"} ]" );
+        _parsePath( true, pJsonDocument, jsonDocumentLength, "c.d", "-1.5e+3" );
+    }
+
+    /* A string value that reads like a key. */
+    {
+        const char pJsonDocument[] = "{\"a\":\"b\",\"b\":true}";
+        size_t jsonDocumentLength = strlen( pJsonDocument );
+
+        _parsePath( true, pJsonDocument, jsonDocumentLength, "b", "true" );
+    }
+
+    /* Duplicate keys: the first one is taken. */
+    {
+        const char pJsonDocument[] = "{\"a\":1,\"a\":2}";
+        size_t jsonDocumentLength = strlen( pJsonDocument );
+
+        _parsePath( true, pJsonDocument, jsonDocumentLength, "a", "1" );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that path lookups in malformed JSON documents fail without
+ * reading out-of-bounds memory.
+ */
+TEST( Aws_Iot_Doc_Unit_Parser, PathInvalid )
+{
+    const size_t getLength = sizeof( _shadowGetDocument ) - 1;
+    size_t length = 0;
+
+    /* Bad paths. */
+    _parsePath( false, _shadowGetDocument, getLength, "", NULL );
+    _parsePath( false, _shadowGetDocument, getLength, ".state", NULL );
+    _parsePath( false, _shadowGetDocument, getLength, "state.", NULL );
+    _parsePath( false, _shadowGetDocument, getLength, "state..delta", NULL );
+    _parsePath( false, _shadowGetDocument, getLength, "version.toggle", NULL );
+    TEST_ASSERT_FALSE( AwsIotDocParser_FindPath( NULL, 10, "a", 1, NULL, NULL ) );
+    TEST_ASSERT_FALSE( AwsIotDocParser_FindPath( "{\"a\":1}", 7, NULL, 1, NULL, NULL ) );
+
+    /* Every document cut short fails, even when only its closing brace is
+     * missing; a lookup never reads past the length. */
+    for( length = 1; length < getLength; length++ )
+    {
+        _parsePath( false, _shadowGetDocument, length, "clientToken", NULL );
+    }
+
+    /* The top level is not an object. */
+    _parsePath( false, "[{\"a\":1}]", 9, "a", NULL );
+    _parsePath( false, "\"a\"", 3, "a", NULL );
+
+    /* Mismatched brackets. */
+    _parsePath( false, "{\"a\":{\"x\":[1}],\"b\":2}", 21, "b", NULL );
+    _parsePath( false, "{\"a\":[{\"x\":1]},\"b\":2}", 21, "b", NULL );
+
+    /* Unterminated string ending with an escaped quote. */
+    _parsePath( false, "{\"a\":\"x\\\"", 10, "a", NULL );
+
+    /* Missing :, missing value, missing , between members. */
+    _parsePath( false, "{\"a\" 1}", 7, "a", NULL );
+    _parsePath( false, "{\"a\":,\"b\":1}", 12, "b", NULL );
+    _parsePath( false, "{\"a\":1 \"b\":2}", 13, "b", NULL );
+
+    /* Not a JSON primitive. */
+    _parsePath( false, "{\"a\":x!y}", 9, "a", NULL );
+    _parsePath( false, "{\"a\":12x}", 9, "a", NULL );
+
+    /* true, false and null misspelled or cut short. */
+    _parsePath( false, "{\"a\":tru}", 9, "a", NULL );
+    _parsePath( false, "{\"a\":truex}", 11, "a", NULL );
+    _parsePath( false, "{\"a\":fals}", 10, "a", NULL );
+    _parsePath( false, "{\"a\":nil}", 9, "a", NULL );
+    _parsePath( false, "{\"a\":null", 9, "a", NULL );
+
+    /* A scalar cut short by the end of the document is not taken whole. */
+    _parsePath( false, "{\"a\":12", 7, "a", NULL );
+    _parsePath( false, "{\"a\":12 ", 8, "a", NULL );
+    _parsePath( false, "{\"b\":{\"a\":12", 12, "b.a", NULL );
+
+    /* Nesting deeper than the parser follows. */
+    {
+        char pJsonDocument[ 100 ] = { 0 };
+        size_t depth = 0, i = 0;
+
+        for( depth = 32; depth <= 33; depth++ )
+        {
+            ( void ) strcpy( pJsonDocument, "{\"a\":" );
+
+            for( i = 0; i < depth; i++ )
+            {
+                ( void ) strcat( pJsonDocument, "[" );
+            }
+
+            for( i = 0; i < depth; i++ )
+            {
+                ( void ) strcat( pJsonDocument, "]" );
+            }
+
+            ( void ) strcat( pJsonDocument, ",\"b\":1}" );
+            _parsePath( depth == 32, pJsonDocument, strlen( pJsonDocument ), "b", "1" );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Measures the lookups made by the Shadow agent on real documents,
+ * with both parser functions.
+ */
+TEST( Aws_Iot_Doc_Unit_Parser, Benchmark )
+{
+    const char * const pPaths[] = { "version", "state.reported", "state.delta" };
+    const size_t getLength = sizeof( _shadowGetDocument ) - 1;
+    const char * pValue = NULL;
+    size_t valueLength = 0, i = 0, p = 0;
+    uint64_t startTime = 0, findPathTime = 0, findValueTime = 0;
+
+    startTime = IotClock_GetTimeMs();
+
+    for( i = 0; i < BENCHMARK_LOOKUPS; i++ )
+    {
+        for( p = 0; p < sizeof( pPaths ) / sizeof( pPaths[ 0 ] ); p++ )
+        {
+            TEST_ASSERT_TRUE( AwsIotDocParser_FindPath( _shadowGetDocument, getLength,
+                                                        pPaths[ p ], strlen( pPaths[ p ] ),
+                                                        &pValue, &valueLength ) );
+        }
+    }
+
+    findPathTime = IotClock_GetTimeMs() - startTime;
+
+    /* The same lookups, a key at a time. */
+    startTime = IotClock_GetTimeMs();
+
+    for( i = 0; i < BENCHMARK_LOOKUPS; i++ )
+    {
+        TEST_ASSERT_TRUE( AwsIotDocParser_FindValue( _shadowGetDocument, getLength,
+                                                     "version", 7, &pValue, &valueLength ) );
+        TEST_ASSERT_TRUE( AwsIotDocParser_FindValue( _shadowGetDocument, getLength,
+                                                     "state", 5, &pValue, &valueLength ) );
+        TEST_ASSERT_TRUE( AwsIotDocParser_FindValue( pValue, valueLength,
+                                                     "reported", 8, &pValue, &valueLength ) );
+        TEST_ASSERT_TRUE( AwsIotDocParser_FindValue( _shadowGetDocument, getLength,
+                                                     "state", 5, &pValue, &valueLength ) );
+        TEST_ASSERT_TRUE( AwsIotDocParser_FindValue( pValue, valueLength,
+                                                     "delta", 5, &pValue, &valueLength ) );
+    }
+
+    findValueTime = IotClock_GetTimeMs() - startTime;
+
+    UnityPrint( "Benchmark " );
+    UnityPrintNumber( ( UNITY_INT ) getLength );
+    UnityPrint( " byte shadow document: FindPath " );
+    UnityPrintNumber( ( UNITY_INT ) ( ( findPathTime * 1000000 ) / BENCHMARK_LOOKUPS ) );
+    UnityPrint( " ns, FindValue " );
+    UnityPrintNumber( ( UNITY_INT ) ( ( findValueTime * 1000000 ) / BENCHMARK_LOOKUPS ) );
+    UnityPrint( " ns per document." );
+    UNITY_PRINT_EOL();
+}
+
+/*-----------------------------------------------------------*/
@@ -87,6 +87,23 @@
 #define AWS_IOT_DEFENDER_METRICS_TCP_CONNECTIONS_ESTABLISHED                                                                          \
     ( AWS_IOT_DEFENDER_METRICS_TCP_CONNECTIONS_ESTABLISHED_CONNECTIONS | AWS_IOT_DEFENDER_METRICS_TCP_CONNECTIONS_ESTABLISHED_TOTAL ) \
 
+#define AWS_IOT_DEFENDER_METRICS_LISTENING_PORTS_TOTAL                      0x00000001 /**< Total count of listening TCP or UDP ports. */
+#define AWS_IOT_DEFENDER_METRICS_LISTENING_PORTS_PORT                       0x00000002 /**< Number of each listening TCP or UDP port. */
+
+/**
+ * Listening ports metrics including the port numbers and total count.
+ */
+#define AWS_IOT_DEFENDER_METRICS_LISTENING_PORTS \
+    ( AWS_IOT_DEFENDER_METRICS_LISTENING_PORTS_PORT | AWS_IOT_DEFENDER_METRICS_LISTENING_PORTS_TOTAL )
+
+/*
+ * Network statistics count the traffic since the previous report, not since boot.
+ */
+#define AWS_IOT_DEFENDER_METRICS_NETWORK_STATS_BYTES_IN                     0x00000001 /**< Bytes received since the previous report. */
+#define AWS_IOT_DEFENDER_METRICS_NETWORK_STATS_BYTES_OUT                    0x00000002 /**< Bytes sent since the previous report. */
+#define AWS_IOT_DEFENDER_METRICS_NETWORK_STATS_PACKETS_IN                   0x00000004 /**< Packets received since the previous report. */
+#define AWS_IOT_DEFENDER_METRICS_NETWORK_STATS_PACKETS_OUT                  0x00000008 /**< Packets sent since the previous report. */
+
 /**@} end of DefenderMetricsFlags */
 
 /**
@@ -129,7 +146,10 @@
  */
 typedef enum
 {
-    AWS_IOT_DEFENDER_METRICS_TCP_CONNECTIONS, /**< TCP connection metrics group. */
+    AWS_IOT_DEFENDER_METRICS_TCP_CONNECTIONS,     /**< TCP connection metrics group. */
+    AWS_IOT_DEFENDER_METRICS_LISTENING_TCP_PORTS, /**< Listening TCP ports metrics group. */
+    AWS_IOT_DEFENDER_METRICS_LISTENING_UDP_PORTS, /**< Listening UDP ports metrics group. */
+    AWS_IOT_DEFENDER_METRICS_NETWORK_STATS        /**< Network statistics metrics group. */
 } AwsIotDefenderMetricsGroup_t;
 
 /**
@@ -45,6 +45,21 @@
 #define CONN_TAG            AwsIotDefenderInternal_SelectTag( "connections", "cs" )
 #define REMOTE_ADDR_TAG     AwsIotDefenderInternal_SelectTag( "remote_addr", "rad" )
 
+#define TCP_PORTS_TAG       AwsIotDefenderInternal_SelectTag( "listening_tcp_ports", "tp" )
+#define UDP_PORTS_TAG       AwsIotDefenderInternal_SelectTag( "listening_udp_ports", "up" )
+#define PORTS_TAG           AwsIotDefenderInternal_SelectTag( "ports", "pts" )
+#define PORT_TAG            AwsIotDefenderInternal_SelectTag( "port", "pt" )
+
+#define NET_STATS_TAG       AwsIotDefenderInternal_SelectTag( "network_stats", "ns" )
+#define BYTES_IN_TAG        AwsIotDefenderInternal_SelectTag( "bytes_in", "bi" )
+#define BYTES_OUT_TAG       AwsIotDefenderInternal_SelectTag( "bytes_out", "bo" )
+#define PACKETS_IN_TAG      AwsIotDefenderInternal_SelectTag( "packets_in", "pi" )
+#define PACKETS_OUT_TAG     AwsIotDefenderInternal_SelectTag( "packets_out", "po" )
+
+/* Whether the encoder may run out of buffer: while measuring the report, or
+ * at any time when the report is built in the static buffer. */
+#define _mayRunOutOfBuffer()    ( ( _report.pDataBuffer == NULL ) || ( AWS_IOT_DEFENDER_REPORT_BUFFER_SIZE > 0 ) )
+
 /**
  * Structure to hold a metrics report.
  */
@@ -63,6 +78,15 @@ static _metricsReport_t _report =
     .size        = 0
 };
 
+#if AWS_IOT_DEFENDER_REPORT_BUFFER_SIZE > 0
+    /* Buffer every report is built in. */
+    static uint8_t _reportBuffer[ AWS_IOT_DEFENDER_REPORT_BUFFER_SIZE ];
+#endif
+
+/* Network counters read for the report being built, and at the last report. */
+static IotMetricsNetworkStats_t _networkStatsNow = { 0 };
+static IotMetricsNetworkStats_t _lastNetworkStats = { 0 };
+
 /* Define a "snapshot" global array of metrics flag. */
 static uint32_t _metricsFlagSnapshot[ DEFENDER_METRICS_GROUP_COUNT ];
 
@@ -85,6 +109,21 @@ static void _serialize( void );
 static void _serializeTcpConnections( void * param1,
                                       const IotListDouble_t * pTcpConnectionsMetricsList );
 
+static void _serializeListeningTcpPorts( void * param1,
+                                         const IotListDouble_t * pPortsMetricsList );
+
+static void _serializeListeningUdpPorts( void * param1,
+                                         const IotListDouble_t * pPortsMetricsList );
+
+static void _serializeListeningPorts( IotSerializerEncoderObject_t * pMetricsObject,
+                                      const char * pTag,
+                                      uint32_t portsFlag,
+                                      const IotListDouble_t * pPortsMetricsList );
+
+static void _serializeNetworkStats( IotSerializerEncoderObject_t * pMetricsObject );
+
+static void _sampleNetworkStats( void );
+
 #if DEBUG_CBOR_PRINT == 1
     static void _printReport();
 #endif
@@ -141,35 +180,64 @@ bool AwsIotDefenderInternal_CreateReport( void )
     /* Generate report id based on current time. */
     _AwsIotDefenderReportId = IotClock_GetTimeMs();
 
-    /* Dry-run serialization to calculate the required size. */
-    _serialize();
+    /* Read the counters once, so that every pass encodes the same values. */
+    _sampleNetworkStats();
 
-    /* Get the calculated required size. */
-    dataSize = _pAwsIotDefenderEncoder->getExtraBufferSizeNeeded( pEncoderObject );
+    #if AWS_IOT_DEFENDER_REPORT_BUFFER_SIZE > 0
+        ( void ) pReportBuffer;
 
-    /* Clean the encoder object handle. */
-    _pAwsIotDefenderEncoder->destroy( pEncoderObject );
+        _report.pDataBuffer = _reportBuffer;
+        _report.size = sizeof( _reportBuffer );
 
-    /* Allocate memory once. */
-    pReportBuffer = AwsIotDefender_MallocReport( dataSize * sizeof( uint8_t ) );
+        /* Single serialization; the encoder counts what did not fit. */
+        _serialize();
 
-    if( pReportBuffer != NULL )
-    {
-        _report.pDataBuffer = pReportBuffer;
-        _report.size = dataSize;
+        dataSize = _pAwsIotDefenderEncoder->getExtraBufferSizeNeeded( pEncoderObject );
 
-        /* Actual serialization. */
+        if( dataSize > 0 )
+        {
+            IotLogError( "Metrics report is %lu bytes larger than its buffer.", ( unsigned long ) dataSize );
+
+            AwsIotDefenderInternal_DeleteReport();
+            result = false;
+        }
+    #else /* if AWS_IOT_DEFENDER_REPORT_BUFFER_SIZE > 0 */
+        /* Dry-run serialization to calculate the required size. */
         _serialize();
 
+        /* Get the calculated required size. */
+        dataSize = _pAwsIotDefenderEncoder->getExtraBufferSizeNeeded( pEncoderObject );
+
+        /* Clean the encoder object handle. */
+        _pAwsIotDefenderEncoder->destroy( pEncoderObject );
+
+        /* Allocate memory once. */
+        pReportBuffer = AwsIotDefender_MallocReport( dataSize * sizeof( uint8_t ) );
+
+        if( pReportBuffer != NULL )
+        {
+            _report.pDataBuffer = pReportBuffer;
+            _report.size = dataSize;
+
+            /* Actual serialization. */
+            _serialize();
+        }
+        else
+        {
+            result = false;
+        }
+    #endif /* if AWS_IOT_DEFENDER_REPORT_BUFFER_SIZE > 0 */
+
+    if( result == true )
+    {
+        /* The next report counts the traffic from here. */
+        _lastNetworkStats = _networkStatsNow;
+
         /* Output the report to stdout if debugging mode is enabled. */
         #if DEBUG_CBOR_PRINT == 1
             _printReport();
         #endif
     }
-    else
-    {
-        result = false;
-    }
 
     return result;
 }
@@ -182,7 +250,9 @@ void AwsIotDefenderInternal_DeleteReport( void )
     _pAwsIotDefenderEncoder->destroy( &( _report.object ) );
 
     /* Free the memory of data buffer. */
-    AwsIotDefender_FreeReport( _report.pDataBuffer );
+    #if AWS_IOT_DEFENDER_REPORT_BUFFER_SIZE == 0
+        AwsIotDefender_FreeReport( _report.pDataBuffer );
+    #endif
 
     /* Reset report members. */
     _report.pDataBuffer = NULL;
@@ -214,7 +284,7 @@ static void _serialize( void )
     IotSerializerEncoderObject_t metricsMap = IOT_SERIALIZER_ENCODER_CONTAINER_INITIALIZER_MAP;
 
     /* Define an assert function for serialization returned error. */
-    void (* assertNoError)( IotSerializerError_t ) = _report.pDataBuffer == NULL ? _assertSuccessOrBufferToSmall
+    void (* assertNoError)( IotSerializerError_t ) = _mayRunOutOfBuffer() ? _assertSuccessOrBufferToSmall
                                                      : _assertSuccess;
 
     uint8_t metricsGroupCount = 0;
@@ -281,6 +351,18 @@ static void _serialize( void )
                     IotMetrics_GetTcpConnections( ( void * ) &metricsMap, _serializeTcpConnections );
                     break;
 
+                case AWS_IOT_DEFENDER_METRICS_LISTENING_TCP_PORTS:
+                    IotMetrics_GetListeningTcpPorts( ( void * ) &metricsMap, _serializeListeningTcpPorts );
+                    break;
+
+                case AWS_IOT_DEFENDER_METRICS_LISTENING_UDP_PORTS:
+                    IotMetrics_GetListeningUdpPorts( ( void * ) &metricsMap, _serializeListeningUdpPorts );
+                    break;
+
+                case AWS_IOT_DEFENDER_METRICS_NETWORK_STATS:
+                    _serializeNetworkStats( &metricsMap );
+                    break;
+
                 default:
                     /* The index of metricsFlagSnapshot must be one of the metrics group. */
                     AwsIotDefender_Assert( 0 );
@@ -340,7 +422,7 @@ static void _serializeTcpConnections( void * param1,
     uint8_t hasTotal = ( tcpConnFlag & AWS_IOT_DEFENDER_METRICS_TCP_CONNECTIONS_ESTABLISHED_TOTAL ) > 0;
     uint8_t hasRemoteAddr = ( tcpConnFlag & AWS_IOT_DEFENDER_METRICS_TCP_CONNECTIONS_ESTABLISHED_REMOTE_ADDR ) > 0;
 
-    void (* assertNoError)( IotSerializerError_t ) = _report.pDataBuffer == NULL ? _assertSuccessOrBufferToSmall
+    void (* assertNoError)( IotSerializerError_t ) = _mayRunOutOfBuffer() ? _assertSuccessOrBufferToSmall
                                                      : _assertSuccess;
 
     /* Create the "tcp_connections" map with 1 key "established_connections" */
@@ -421,6 +503,195 @@ static void _serializeTcpConnections( void * param1,
     assertNoError( serializerError );
 }
 
+/*-----------------------------------------------------------*/
+
+static void _serializeListeningTcpPorts( void * param1,
+                                         const IotListDouble_t * pPortsMetricsList )
+{
+    _serializeListeningPorts( ( IotSerializerEncoderObject_t * ) param1,
+                              TCP_PORTS_TAG,
+                              _metricsFlagSnapshot[ AWS_IOT_DEFENDER_METRICS_LISTENING_TCP_PORTS ],
+                              pPortsMetricsList );
+}
+
+/*-----------------------------------------------------------*/
+
+static void _serializeListeningUdpPorts( void * param1,
+                                         const IotListDouble_t * pPortsMetricsList )
+{
+    _serializeListeningPorts( ( IotSerializerEncoderObject_t * ) param1,
+                              UDP_PORTS_TAG,
+                              _metricsFlagSnapshot[ AWS_IOT_DEFENDER_METRICS_LISTENING_UDP_PORTS ],
+                              pPortsMetricsList );
+}
+
+/*-----------------------------------------------------------*/
+
+/*
+ * "listening_tcp_ports" or "listening_udp_ports":
+ * {
+ *  "ports": [ { "port": 8883 }, ... ],
+ *  "total": 1
+ * }
+ */
+static void _serializeListeningPorts( IotSerializerEncoderObject_t * pMetricsObject,
+                                      const char * pTag,
+                                      uint32_t portsFlag,
+                                      const IotListDouble_t * pPortsMetricsList )
+{
+    IotSerializerScalarData_t scalarData = { 0 };
+    IotSerializerError_t serializerError = IOT_SERIALIZER_SUCCESS;
+
+    IotSerializerEncoderObject_t portsMap = IOT_SERIALIZER_ENCODER_CONTAINER_INITIALIZER_MAP;
+    IotSerializerEncoderObject_t portsArray = IOT_SERIALIZER_ENCODER_CONTAINER_INITIALIZER_ARRAY;
+
+    IotLink_t * pListIterator = NULL;
+    IotMetricsListeningPort_t * pMetricsPort = NULL;
+
+    size_t total = IotListDouble_Count( pPortsMetricsList );
+
+    /* Whether "ports" should show up is not only determined by user input, but also if there is at least 1 port. */
+    uint8_t hasPorts = ( portsFlag & AWS_IOT_DEFENDER_METRICS_LISTENING_PORTS_PORT ) > 0 &&
+                       ( total > 0 );
+    uint8_t hasTotal = ( portsFlag & AWS_IOT_DEFENDER_METRICS_LISTENING_PORTS_TOTAL ) > 0;
+
+    void (* assertNoError)( IotSerializerError_t ) = _mayRunOutOfBuffer() ? _assertSuccessOrBufferToSmall
+                                                     : _assertSuccess;
+
+    AwsIotDefender_Assert( pMetricsObject != NULL );
+
+    serializerError = _pAwsIotDefenderEncoder->openContainerWithKey( pMetricsObject,
+                                                                     pTag,
+                                                                     &portsMap,
+                                                                     hasPorts + hasTotal );
+    assertNoError( serializerError );
+
+    if( hasPorts )
+    {
+        serializerError = _pAwsIotDefenderEncoder->openContainerWithKey( &portsMap,
+                                                                         PORTS_TAG,
+                                                                         &portsArray,
+                                                                         total );
+        assertNoError( serializerError );
+
+        IotContainers_ForEach( pPortsMetricsList, pListIterator )
+        {
+            IotSerializerEncoderObject_t portMap = IOT_SERIALIZER_ENCODER_CONTAINER_INITIALIZER_MAP;
+
+            pMetricsPort = IotLink_Container( IotMetricsListeningPort_t, pListIterator, link );
+
+            serializerError = _pAwsIotDefenderEncoder->openContainer( &portsArray, &portMap, 1 );
+            assertNoError( serializerError );
+
+            scalarData.type = IOT_SERIALIZER_SCALAR_SIGNED_INT;
+            scalarData.value.u.signedInt = ( int64_t ) pMetricsPort->port;
+
+            serializerError = _pAwsIotDefenderEncoder->appendKeyValue( &portMap, PORT_TAG, scalarData );
+            assertNoError( serializerError );
+
+            serializerError = _pAwsIotDefenderEncoder->closeContainer( &portsArray, &portMap );
+            assertNoError( serializerError );
+        }
+
+        serializerError = _pAwsIotDefenderEncoder->closeContainer( &portsMap, &portsArray );
+        assertNoError( serializerError );
+    }
+
+    if( hasTotal )
+    {
+        scalarData.type = IOT_SERIALIZER_SCALAR_SIGNED_INT;
+        scalarData.value.u.signedInt = ( int64_t ) total;
+
+        serializerError = _pAwsIotDefenderEncoder->appendKeyValue( &portsMap, TOTAL_TAG, scalarData );
+        assertNoError( serializerError );
+    }
+
+    serializerError = _pAwsIotDefenderEncoder->closeContainer( pMetricsObject, &portsMap );
+    assertNoError( serializerError );
+}
+
+/*-----------------------------------------------------------*/
+
+/*
+ * "network_stats":
+ * {
+ *  "bytes_in": 29358,
+ *  "bytes_out": 26485,
+ *  "packets_in": 100,
+ *  "packets_out": 113
+ * }
+ */
+static void _serializeNetworkStats( IotSerializerEncoderObject_t * pMetricsObject )
+{
+    IotSerializerScalarData_t scalarData = { 0 };
+    IotSerializerError_t serializerError = IOT_SERIALIZER_SUCCESS;
+
+    IotSerializerEncoderObject_t networkStatsMap = IOT_SERIALIZER_ENCODER_CONTAINER_INITIALIZER_MAP;
+
+    uint32_t networkStatsFlag = _metricsFlagSnapshot[ AWS_IOT_DEFENDER_METRICS_NETWORK_STATS ];
+
+    /* Tags and values by flag; the counters wrap, so the differences are taken modulo 2^32. */
+    const struct
+    {
+        uint32_t flag;
+        const char * pTag;
+        uint32_t value;
+    } stats[] =
+    {
+        { AWS_IOT_DEFENDER_METRICS_NETWORK_STATS_BYTES_IN,    BYTES_IN_TAG,    _networkStatsNow.bytesIn - _lastNetworkStats.bytesIn       },
+        { AWS_IOT_DEFENDER_METRICS_NETWORK_STATS_BYTES_OUT,   BYTES_OUT_TAG,   _networkStatsNow.bytesOut - _lastNetworkStats.bytesOut     },
+        { AWS_IOT_DEFENDER_METRICS_NETWORK_STATS_PACKETS_IN,  PACKETS_IN_TAG,  _networkStatsNow.packetsIn - _lastNetworkStats.packetsIn   },
+        { AWS_IOT_DEFENDER_METRICS_NETWORK_STATS_PACKETS_OUT, PACKETS_OUT_TAG, _networkStatsNow.packetsOut - _lastNetworkStats.packetsOut }
+    };
+    uint8_t statsCount = 0;
+    size_t i = 0;
+
+    void (* assertNoError)( IotSerializerError_t ) = _mayRunOutOfBuffer() ? _assertSuccessOrBufferToSmall
+                                                     : _assertSuccess;
+
+    AwsIotDefender_Assert( pMetricsObject != NULL );
+
+    for( i = 0; i < sizeof( stats ) / sizeof( stats[ 0 ] ); i++ )
+    {
+        statsCount += ( networkStatsFlag & stats[ i ].flag ) > 0;
+    }
+
+    serializerError = _pAwsIotDefenderEncoder->openContainerWithKey( pMetricsObject,
+                                                                     NET_STATS_TAG,
+                                                                     &networkStatsMap,
+                                                                     statsCount );
+    assertNoError( serializerError );
+
+    for( i = 0; i < sizeof( stats ) / sizeof( stats[ 0 ] ); i++ )
+    {
+        if( networkStatsFlag & stats[ i ].flag )
+        {
+            scalarData.type = IOT_SERIALIZER_SCALAR_SIGNED_INT;
+            scalarData.value.u.signedInt = ( int64_t ) stats[ i ].value;
+
+            serializerError = _pAwsIotDefenderEncoder->appendKeyValue( &networkStatsMap,
+                                                                       stats[ i ].pTag,
+                                                                       scalarData );
+            assertNoError( serializerError );
+        }
+    }
+
+    serializerError = _pAwsIotDefenderEncoder->closeContainer( pMetricsObject, &networkStatsMap );
+    assertNoError( serializerError );
+}
+
+/*-----------------------------------------------------------*/
+
+static void _sampleNetworkStats( void )
+{
+    if( _metricsFlagSnapshot[ AWS_IOT_DEFENDER_METRICS_NETWORK_STATS ] )
+    {
+        IotMetrics_GetNetworkStats( &_networkStatsNow );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
 #if DEBUG_CBOR_PRINT == 1
     #include "cbor.h"
     /*-----------------------------------------------------------*/
@@ -187,6 +187,16 @@
  * <b>Recommended values:</b>  greater than or equal to `300` seconds; defender service might throttle if the period is too short <br>
  * <b>Default value (if undefined):</b>  `300` <br>
  *
+ * @section AWS_IOT_DEFENDER_REPORT_BUFFER_SIZE
+ * @brief Size of a static buffer that every metrics report is built in.
+ *
+ * With a static buffer a report is encoded once, instead of once to learn its
+ * size and again into a buffer allocated for it. A report that does not fit
+ * is dropped and the publish is failed.
+ *
+ * <b>Possible values:</b>  `0` to allocate each report, or a size in bytes <br>
+ * <b>Default value (if undefined):</b>  `0` <br>
+ *
  * @section AWS_IOT_DEFENDER_MQTT_CONNECT_TIMEOUT_SECONDS
  * @brief Default MQTT connect timeout.
  *
@@ -214,6 +224,10 @@
     #define AWS_IOT_DEFENDER_WAIT_SERVER_MAX_SECONDS    ( 3 )
 #endif
 
+#ifndef AWS_IOT_DEFENDER_REPORT_BUFFER_SIZE
+    #define AWS_IOT_DEFENDER_REPORT_BUFFER_SIZE    ( 0 )
+#endif
+
 #ifndef AWS_IOT_DEFENDER_MQTT_CONNECT_TIMEOUT_SECONDS
     #define AWS_IOT_DEFENDER_MQTT_CONNECT_TIMEOUT_SECONDS    ( 10U )
 #endif
@@ -243,7 +257,7 @@
 /*----------------- Below this line is INTERNAL used only --------------------*/
 
 /* This MUST be consistent with enum AwsIotDefenderMetricsGroup_t. */
-#define DEFENDER_METRICS_GROUP_COUNT    1
+#define DEFENDER_METRICS_GROUP_COUNT    4
 
 /**
  * Define encoder/decoder based on configuration AWS_IOT_DEFENDER_FORMAT.
@@ -290,7 +304,8 @@ typedef struct _defenderMetrics
 } _defenderMetrics_t;
 
 /**
- * Create a report, memory is allocated inside the function.
+ * Create a report, memory is allocated inside the function unless
+ * AWS_IOT_DEFENDER_REPORT_BUFFER_SIZE is set.
  */
 bool AwsIotDefenderInternal_CreateReport( void );
 
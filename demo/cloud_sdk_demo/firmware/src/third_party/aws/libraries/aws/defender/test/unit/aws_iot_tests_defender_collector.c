@@ -0,0 +1,533 @@
+/*
+ * AWS IoT Defender V3.0.0
+ * Copyright (C) 2018 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file aws_iot_tests_defender_collector.c
+ * @brief Tests for the metrics report built by the Defender collector.
+ *
+ * The platform metrics functions are replaced by a fake socket table and fake
+ * traffic counters, so that reports are built without a network stack.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <string.h>
+
+/* SDK initialization include. */
+#include "iot_init.h"
+
+/* Platform layer includes. */
+#include "platform/iot_clock.h"
+#include "platform/iot_metrics.h"
+#include "platform/iot_threads.h"
+
+/* Defender internal include. */
+#include "private/aws_iot_defender_internal.h"
+
+/* Serializer include. */
+#include "iot_serializer.h"
+
+/* Test framework includes. */
+#include "unity_fixture.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Most sockets of each kind in the fake socket table.
+ */
+#define MAX_SOCKETS           ( 64 )
+
+/**
+ * @brief Reports built for each size in #TEST_Defender_Unit_Collector_Benchmark.
+ */
+#define BENCHMARK_REPORTS     ( 1000 )
+
+/**
+ * @brief Select the tag the collector uses for a key.
+ */
+#define TAG( longTag, shortTag )    AwsIotDefenderInternal_SelectTag( longTag, shortTag )
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Fake socket table and traffic counters.
+ */
+static IotMetricsTcpConnection_t _connections[ MAX_SOCKETS ];
+static IotMetricsListeningPort_t _tcpPorts[ MAX_SOCKETS ];
+static IotMetricsListeningPort_t _udpPorts[ MAX_SOCKETS ];
+static size_t _connectionCount = 0, _tcpPortCount = 0, _udpPortCount = 0;
+static IotMetricsNetworkStats_t _networkStats = { 0 };
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Provide a list of the first count entries of a fake table.
+ */
+static void _provideList( IotLink_t * pFirstLink,
+                          size_t entrySize,
+                          size_t count,
+                          void * pContext,
+                          void ( * metricsCallback )( void *, const IotListDouble_t * ) )
+{
+    IotListDouble_t list = IOT_LIST_DOUBLE_INITIALIZER;
+    size_t i = 0;
+
+    IotListDouble_Create( &list );
+
+    for( i = 0; i < count; i++ )
+    {
+        IotListDouble_InsertTail( &list,
+                                  ( IotLink_t * ) ( ( uint8_t * ) pFirstLink + i * entrySize ) );
+    }
+
+    metricsCallback( pContext, &list );
+}
+
+/*-----------------------------------------------------------*/
+
+bool IotMetrics_Init( void )
+{
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMetrics_Cleanup( void )
+{
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMetrics_GetTcpConnections( void * pContext,
+                                   void ( * metricsCallback )( void *, const IotListDouble_t * ) )
+{
+    _provideList( &( _connections[ 0 ].link ), sizeof( _connections[ 0 ] ), _connectionCount,
+                  pContext, metricsCallback );
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMetrics_GetListeningTcpPorts( void * pContext,
+                                      void ( * metricsCallback )( void *, const IotListDouble_t * ) )
+{
+    _provideList( &( _tcpPorts[ 0 ].link ), sizeof( _tcpPorts[ 0 ] ), _tcpPortCount,
+                  pContext, metricsCallback );
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMetrics_GetListeningUdpPorts( void * pContext,
+                                      void ( * metricsCallback )( void *, const IotListDouble_t * ) )
+{
+    _provideList( &( _udpPorts[ 0 ].link ), sizeof( _udpPorts[ 0 ] ), _udpPortCount,
+                  pContext, metricsCallback );
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMetrics_GetNetworkStats( IotMetricsNetworkStats_t * pNetworkStats )
+{
+    *pNetworkStats = _networkStats;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Fill the fake socket table.
+ */
+static void _setSockets( size_t connectionCount,
+                         size_t tcpPortCount,
+                         size_t udpPortCount )
+{
+    size_t i = 0;
+
+    for( i = 0; i < connectionCount; i++ )
+    {
+        _connections[ i ].addressLength = ( size_t ) snprintf( _connections[ i ].pRemoteAddress,
+                                                               IOT_METRICS_IP_ADDRESS_LENGTH,
+                                                               "52.14.%u.%u:8883",
+                                                               ( unsigned ) ( i / 250 ),
+                                                               ( unsigned ) ( i % 250 + 1 ) );
+    }
+
+    for( i = 0; i < tcpPortCount; i++ )
+    {
+        _tcpPorts[ i ].port = ( uint16_t ) ( 80 + i );
+    }
+
+    for( i = 0; i < udpPortCount; i++ )
+    {
+        _udpPorts[ i ].port = ( uint16_t ) ( 49152 + i );
+    }
+
+    _connectionCount = connectionCount;
+    _tcpPortCount = tcpPortCount;
+    _udpPortCount = udpPortCount;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Collect every metric of every group.
+ */
+static void _setAllMetrics( void )
+{
+    _AwsIotDefenderMetrics.metricsFlag[ AWS_IOT_DEFENDER_METRICS_TCP_CONNECTIONS ] = AWS_IOT_DEFENDER_METRICS_ALL;
+    _AwsIotDefenderMetrics.metricsFlag[ AWS_IOT_DEFENDER_METRICS_LISTENING_TCP_PORTS ] = AWS_IOT_DEFENDER_METRICS_ALL;
+    _AwsIotDefenderMetrics.metricsFlag[ AWS_IOT_DEFENDER_METRICS_LISTENING_UDP_PORTS ] = AWS_IOT_DEFENDER_METRICS_ALL;
+    _AwsIotDefenderMetrics.metricsFlag[ AWS_IOT_DEFENDER_METRICS_NETWORK_STATS ] = AWS_IOT_DEFENDER_METRICS_ALL;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Find an integer in a map of the report.
+ */
+static int64_t _findInteger( IotSerializerDecoderObject_t * pMap,
+                             const char * pKey )
+{
+    IotSerializerDecoderObject_t valueObject = IOT_SERIALIZER_DECODER_OBJECT_INITIALIZER;
+
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _pAwsIotDefenderDecoder->find( pMap, pKey, &valueObject ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SCALAR_SIGNED_INT, valueObject.type );
+
+    return valueObject.u.value.u.signedInt;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Open the "metrics" map of the report just built.
+ */
+static void _openMetrics( IotSerializerDecoderObject_t * pReport,
+                          IotSerializerDecoderObject_t * pMetrics )
+{
+    TEST_ASSERT_NOT_NULL( AwsIotDefenderInternal_GetReportBuffer() );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                       _pAwsIotDefenderDecoder->init( pReport,
+                                                      AwsIotDefenderInternal_GetReportBuffer(),
+                                                      AwsIotDefenderInternal_GetReportBufferSize() ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                       _pAwsIotDefenderDecoder->find( pReport, TAG( "metrics", "met" ), pMetrics ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_CONTAINER_MAP, pMetrics->type );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Check a "listening_tcp_ports" or "listening_udp_ports" map.
+ */
+static void _verifyListeningPorts( IotSerializerDecoderObject_t * pMetrics,
+                                   const char * pTag,
+                                   const IotMetricsListeningPort_t * pPorts,
+                                   size_t count )
+{
+    IotSerializerDecoderObject_t portsMap = IOT_SERIALIZER_DECODER_OBJECT_INITIALIZER;
+    IotSerializerDecoderObject_t portsArray = IOT_SERIALIZER_DECODER_OBJECT_INITIALIZER;
+    IotSerializerDecoderIterator_t iterator = IOT_SERIALIZER_DECODER_ITERATOR_INITIALIZER;
+    size_t i = 0;
+
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _pAwsIotDefenderDecoder->find( pMetrics, pTag, &portsMap ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_CONTAINER_MAP, portsMap.type );
+    TEST_ASSERT_EQUAL( count, _findInteger( &portsMap, TAG( "total", "t" ) ) );
+
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                       _pAwsIotDefenderDecoder->find( &portsMap, TAG( "ports", "pts" ), &portsArray ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_CONTAINER_ARRAY, portsArray.type );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _pAwsIotDefenderDecoder->stepIn( &portsArray, &iterator ) );
+
+    for( i = 0; i < count; i++ )
+    {
+        IotSerializerDecoderObject_t portMap = IOT_SERIALIZER_DECODER_OBJECT_INITIALIZER;
+
+        TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _pAwsIotDefenderDecoder->get( iterator, &portMap ) );
+        TEST_ASSERT_EQUAL( IOT_SERIALIZER_CONTAINER_MAP, portMap.type );
+        TEST_ASSERT_EQUAL( pPorts[ i ].port, _findInteger( &portMap, TAG( "port", "pt" ) ) );
+        _pAwsIotDefenderDecoder->destroy( &portMap );
+
+        TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _pAwsIotDefenderDecoder->next( iterator ) );
+    }
+
+    TEST_ASSERT_TRUE( _pAwsIotDefenderDecoder->isEndOfContainer( iterator ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS, _pAwsIotDefenderDecoder->stepOut( iterator, &portsArray ) );
+
+    _pAwsIotDefenderDecoder->destroy( &portsArray );
+    _pAwsIotDefenderDecoder->destroy( &portsMap );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Check the "network_stats" map.
+ */
+static void _verifyNetworkStats( IotSerializerDecoderObject_t * pMetrics,
+                                 uint32_t bytesIn,
+                                 uint32_t bytesOut,
+                                 uint32_t packetsIn,
+                                 uint32_t packetsOut )
+{
+    IotSerializerDecoderObject_t statsMap = IOT_SERIALIZER_DECODER_OBJECT_INITIALIZER;
+
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                       _pAwsIotDefenderDecoder->find( pMetrics, TAG( "network_stats", "ns" ), &statsMap ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_CONTAINER_MAP, statsMap.type );
+
+    TEST_ASSERT_EQUAL( bytesIn, _findInteger( &statsMap, TAG( "bytes_in", "bi" ) ) );
+    TEST_ASSERT_EQUAL( bytesOut, _findInteger( &statsMap, TAG( "bytes_out", "bo" ) ) );
+    TEST_ASSERT_EQUAL( packetsIn, _findInteger( &statsMap, TAG( "packets_in", "pi" ) ) );
+    TEST_ASSERT_EQUAL( packetsOut, _findInteger( &statsMap, TAG( "packets_out", "po" ) ) );
+
+    _pAwsIotDefenderDecoder->destroy( &statsMap );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Build a report and check its network statistics.
+ */
+static void _reportNetworkStats( uint32_t bytesIn,
+                                 uint32_t bytesOut,
+                                 uint32_t packetsIn,
+                                 uint32_t packetsOut )
+{
+    IotSerializerDecoderObject_t report = IOT_SERIALIZER_DECODER_OBJECT_INITIALIZER;
+    IotSerializerDecoderObject_t metrics = IOT_SERIALIZER_DECODER_OBJECT_INITIALIZER;
+
+    TEST_ASSERT_TRUE( AwsIotDefenderInternal_CreateReport() );
+    _openMetrics( &report, &metrics );
+    _verifyNetworkStats( &metrics, bytesIn, bytesOut, packetsIn, packetsOut );
+
+    _pAwsIotDefenderDecoder->destroy( &metrics );
+    _pAwsIotDefenderDecoder->destroy( &report );
+    AwsIotDefenderInternal_DeleteReport();
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test group for the Defender collector.
+ */
+TEST_GROUP( Defender_Unit_Collector );
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test setup for the Defender collector.
+ */
+TEST_SETUP( Defender_Unit_Collector )
+{
+    TEST_ASSERT_EQUAL_INT( true, IotSdk_Init() );
+    TEST_ASSERT_EQUAL_INT( true, IotMutex_Create( &_AwsIotDefenderMetrics.mutex, false ) );
+
+    _pAwsIotDefenderEncoder = IotSerializer_GetCborEncoder();
+    _pAwsIotDefenderDecoder = IotSerializer_GetCborDecoder();
+
+    ( void ) memset( _AwsIotDefenderMetrics.metricsFlag, 0x00, sizeof( _AwsIotDefenderMetrics.metricsFlag ) );
+    ( void ) memset( &_networkStats, 0x00, sizeof( _networkStats ) );
+    _setSockets( 0, 0, 0 );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test tear down for the Defender collector.
+ */
+TEST_TEAR_DOWN( Defender_Unit_Collector )
+{
+    AwsIotDefenderInternal_DeleteReport();
+    IotMutex_Destroy( &_AwsIotDefenderMetrics.mutex );
+    IotSdk_Cleanup();
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test group runner for the Defender collector.
+ */
+TEST_GROUP_RUNNER( Defender_Unit_Collector )
+{
+    RUN_TEST_CASE( Defender_Unit_Collector, AllMetricsGroups );
+    RUN_TEST_CASE( Defender_Unit_Collector, NetworkStatsSincePreviousReport );
+    RUN_TEST_CASE( Defender_Unit_Collector, ReportLargerThanBuffer );
+    RUN_TEST_CASE( Defender_Unit_Collector, Benchmark );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that every metrics group shows up in the report with the
+ * content of the socket table.
+ */
+TEST( Defender_Unit_Collector, AllMetricsGroups )
+{
+    IotSerializerDecoderObject_t report = IOT_SERIALIZER_DECODER_OBJECT_INITIALIZER;
+    IotSerializerDecoderObject_t metrics = IOT_SERIALIZER_DECODER_OBJECT_INITIALIZER;
+    IotSerializerDecoderObject_t tcpConnections = IOT_SERIALIZER_DECODER_OBJECT_INITIALIZER;
+    IotSerializerDecoderObject_t established = IOT_SERIALIZER_DECODER_OBJECT_INITIALIZER;
+
+    _setAllMetrics();
+    _setSockets( 2, 1, 3 );
+    _networkStats.bytesIn = 1500;
+    _networkStats.bytesOut = 700;
+    _networkStats.packetsIn = 12;
+    _networkStats.packetsOut = 9;
+
+    TEST_ASSERT_TRUE( AwsIotDefenderInternal_CreateReport() );
+    _openMetrics( &report, &metrics );
+
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                       _pAwsIotDefenderDecoder->find( &metrics, TAG( "tcp_connections", "tc" ), &tcpConnections ) );
+    TEST_ASSERT_EQUAL( IOT_SERIALIZER_SUCCESS,
+                       _pAwsIotDefenderDecoder->find( &tcpConnections, TAG( "established_connections", "ec" ), &established ) );
+    TEST_ASSERT_EQUAL( 2, _findInteger( &established, TAG( "total", "t" ) ) );
+    _pAwsIotDefenderDecoder->destroy( &established );
+    _pAwsIotDefenderDecoder->destroy( &tcpConnections );
+
+    _verifyListeningPorts( &metrics, TAG( "listening_tcp_ports", "tp" ), _tcpPorts, 1 );
+    _verifyListeningPorts( &metrics, TAG( "listening_udp_ports", "up" ), _udpPorts, 3 );
+    _verifyNetworkStats( &metrics, 1500, 700, 12, 9 );
+
+    _pAwsIotDefenderDecoder->destroy( &metrics );
+    _pAwsIotDefenderDecoder->destroy( &report );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that network statistics count the traffic since the previous
+ * report, across a wrap of the counters.
+ */
+TEST( Defender_Unit_Collector, NetworkStatsSincePreviousReport )
+{
+    _AwsIotDefenderMetrics.metricsFlag[ AWS_IOT_DEFENDER_METRICS_NETWORK_STATS ] = AWS_IOT_DEFENDER_METRICS_ALL;
+
+    /* Start from the counters left by other tests. */
+    _networkStats.bytesIn = 0xffffff00UL;
+    _networkStats.bytesOut = 5000;
+    _networkStats.packetsIn = 40;
+    _networkStats.packetsOut = 30;
+    TEST_ASSERT_TRUE( AwsIotDefenderInternal_CreateReport() );
+    AwsIotDefenderInternal_DeleteReport();
+
+    _networkStats.bytesIn = 0x100;
+    _networkStats.bytesOut = 5600;
+    _networkStats.packetsIn = 43;
+    _networkStats.packetsOut = 35;
+    _reportNetworkStats( 0x200, 600, 3, 5 );
+
+    /* No traffic. */
+    _reportNetworkStats( 0, 0, 0, 0 );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that a report which does not fit the static buffer is dropped
+ * and leaves the network statistics for the next report.
+ */
+TEST( Defender_Unit_Collector, ReportLargerThanBuffer )
+{
+    #if AWS_IOT_DEFENDER_REPORT_BUFFER_SIZE > 0
+        _setAllMetrics();
+        _networkStats.bytesIn = 100;
+        _networkStats.bytesOut = 100;
+        _networkStats.packetsIn = 1;
+        _networkStats.packetsOut = 1;
+        TEST_ASSERT_TRUE( AwsIotDefenderInternal_CreateReport() );
+        AwsIotDefenderInternal_DeleteReport();
+
+        _networkStats.bytesIn = 300;
+        _setSockets( MAX_SOCKETS, 0, 0 );
+        TEST_ASSERT_FALSE( AwsIotDefenderInternal_CreateReport() );
+        TEST_ASSERT_NULL( AwsIotDefenderInternal_GetReportBuffer() );
+        TEST_ASSERT_EQUAL( 0, AwsIotDefenderInternal_GetReportBufferSize() );
+
+        /* The traffic of the dropped report goes with the next one. */
+        _setSockets( 0, 0, 0 );
+        _reportNetworkStats( 200, 0, 0, 0 );
+    #else
+        TEST_IGNORE_MESSAGE( "Reports are allocated to size." );
+    #endif
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Measures the size of a report and the time to build it for growing
+ * socket tables.
+ */
+TEST( Defender_Unit_Collector, Benchmark )
+{
+    const size_t sockets[] = { 1, 5, 16 };
+    uint64_t startTime = 0, elapsed = 0;
+    size_t reportSize = 0, lastReportSize = 0;
+    size_t s = 0, i = 0;
+
+    _setAllMetrics();
+
+    for( s = 0; s < sizeof( sockets ) / sizeof( sockets[ 0 ] ); s++ )
+    {
+        _setSockets( sockets[ s ], sockets[ s ], sockets[ s ] );
+
+        startTime = IotClock_GetTimeMs();
+
+        for( i = 0; i < BENCHMARK_REPORTS; i++ )
+        {
+            _networkStats.bytesIn += 1500;
+            _networkStats.packetsIn++;
+
+            if( AwsIotDefenderInternal_CreateReport() == false )
+            {
+                break;
+            }
+
+            reportSize = AwsIotDefenderInternal_GetReportBufferSize();
+            AwsIotDefenderInternal_DeleteReport();
+        }
+
+        elapsed = IotClock_GetTimeMs() - startTime;
+
+        UnityPrint( "Benchmark " );
+        UnityPrintNumber( ( UNITY_INT ) sockets[ s ] );
+        UnityPrint( " sockets of each kind: " );
+
+        if( i < BENCHMARK_REPORTS )
+        {
+            UnityPrint( "report larger than AWS_IOT_DEFENDER_REPORT_BUFFER_SIZE." );
+            UNITY_PRINT_EOL();
+            continue;
+        }
+
+        UnityPrintNumber( ( UNITY_INT ) reportSize );
+        UnityPrint( " bytes, " );
+        UnityPrintNumber( ( UNITY_INT ) ( ( elapsed * 1000 ) / BENCHMARK_REPORTS ) );
+        UnityPrint( " us per report." );
+        UNITY_PRINT_EOL();
+
+        TEST_ASSERT_GREATER_THAN( lastReportSize, reportSize );
+        lastReportSize = reportSize;
+    }
+}
+
+/*-----------------------------------------------------------*/
@@ -630,8 +630,8 @@ AwsIotShadowError_t AwsIotShadow_Wait( AwsIotShadowOperation_t operation,
  * @param[in] pThingName The subscription to `update/delta` will be added for
  * this Thing Name.
  * @param[in] thingNameLength The length of `pThingName`.
- * @param[in] flags This parameter is for future-compatibility. Currently, flags
- * are not supported for this function and this parameter is ignored.
+ * @param[in] flags Flags which modify the behavior of this function. Only
+ * #AWS_IOT_SHADOW_FLAG_SESSION_RESTORE is used by this function.
  * @param[in] pDeltaCallback Callback function to invoke for incoming delta
  * documents.
  *
@@ -745,8 +745,8 @@ AwsIotShadowError_t AwsIotShadow_SetDeltaCallback( IotMqttConnection_t mqttConne
  * @param[in] pThingName The subscription to `update/documents` will be added for
  * this Thing Name.
  * @param[in] thingNameLength The length of `pThingName`.
- * @param[in] flags This parameter is for future-compatibility. Currently, flags are
- * not supported for this function and this parameter is ignored.
+ * @param[in] flags Flags which modify the behavior of this function. Only
+ * #AWS_IOT_SHADOW_FLAG_SESSION_RESTORE is used by this function.
  * @param[in] pUpdatedCallback Callback function to invoke for incoming updated documents.
  *
  * @return One of the following:
@@ -530,6 +530,13 @@ typedef struct AwsIotShadowDocumentInfo
  *   @copybrief AWS_IOT_SHADOW_FLAG_WAITABLE
  * - #AWS_IOT_SHADOW_FLAG_KEEP_SUBSCRIPTIONS <br>
  *   @copybrief AWS_IOT_SHADOW_FLAG_KEEP_SUBSCRIPTIONS
+ * - #AWS_IOT_SHADOW_FLAG_SESSION_RESTORE <br>
+ *   @copybrief AWS_IOT_SHADOW_FLAG_SESSION_RESTORE
+ *
+ * The following flags are valid for @ref shadow_function_setdeltacallback and
+ * @ref shadow_function_setupdatedcallback.
+ * - #AWS_IOT_SHADOW_FLAG_SESSION_RESTORE <br>
+ *   @copybrief AWS_IOT_SHADOW_FLAG_SESSION_RESTORE
  *
  * The following flags are valid for @ref shadow_function_removepersistentsubscriptions.
  * These flags are not valid for the Shadow operation functions.
@@ -593,6 +600,27 @@ typedef struct AwsIotShadowDocumentInfo
  */
 #define AWS_IOT_SHADOW_FLAG_KEEP_SUBSCRIPTIONS             ( 0x00000002 )
 
+/**
+ * @brief Register the Shadow subscriptions of a resumed MQTT session without
+ * sending SUBSCRIBE.
+ *
+ * This flag is valid if passed to @ref shadow_function_setdeltacallback,
+ * @ref shadow_function_setupdatedcallback, or together with
+ * #AWS_IOT_SHADOW_FLAG_KEEP_SUBSCRIPTIONS to @ref shadow_function_deleteasync,
+ * @ref shadow_function_getasync, @ref shadow_function_updateasync, or their
+ * blocking versions.
+ *
+ * When the server reported a session present on CONNECT, it still holds the
+ * subscriptions made on the previous connection of the session. This flag
+ * passes #IOT_MQTT_FLAG_SESSION_RESTORE to @ref mqtt_function_subscribesync,
+ * so the Shadow topics are added to the MQTT connection without a round trip
+ * to the server. When no session is present, the topics are subscribed as usual.
+ *
+ * @warning Only set this flag if every connection of the session subscribes to
+ * the same Shadow topics.
+ */
+#define AWS_IOT_SHADOW_FLAG_SESSION_RESTORE                ( 0x00000004 )
+
 /**
  * @brief Remove the persistent subscriptions from a Shadow delete operation.
  *
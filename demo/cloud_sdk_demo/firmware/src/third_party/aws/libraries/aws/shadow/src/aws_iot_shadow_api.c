@@ -99,6 +99,7 @@ static AwsIotShadowError_t _validateDocumentInfo( _shadowOperationType_t type,
  * @param[in] type Type of Shadow callback.
  * @param[in] pThingName Thing Name for Shadow callback.
  * @param[in] thingNameLength Length of `pThingName`.
+ * @param[in] flags Flags passed to the Shadow API function.
  * @param[in] pCallbackInfo Callback information to set.
  *
  * @return #AWS_IOT_SHADOW_SUCCESS, #AWS_IOT_SHADOW_BAD_PARAMETER,
@@ -108,6 +109,7 @@ static AwsIotShadowError_t _setCallbackCommon( IotMqttConnection_t mqttConnectio
                                                _shadowCallbackType_t type,
                                                const char * pThingName,
                                                size_t thingNameLength,
+                                               uint32_t flags,
                                                const AwsIotShadowCallbackInfo_t * pCallbackInfo );
 
 /**
@@ -119,6 +121,7 @@ static AwsIotShadowError_t _setCallbackCommon( IotMqttConnection_t mqttConnectio
  * @param[in] pSubscription Shadow subscriptions object for callback.
  * @param[in] mqttOperation Either @ref mqtt_function_subscribesync or
  * @ref mqtt_function_unsubscribesync.
+ * @param[in] mqttFlags Flags for `mqttOperation`.
  *
  * @return #AWS_IOT_SHADOW_SUCCESS, #AWS_IOT_SHADOW_NO_MEMORY, or
  * #AWS_IOT_SHADOW_MQTT_ERROR.
@@ -126,7 +129,8 @@ static AwsIotShadowError_t _setCallbackCommon( IotMqttConnection_t mqttConnectio
 static AwsIotShadowError_t _modifyCallbackSubscriptions( IotMqttConnection_t mqttConnection,
                                                          _shadowCallbackType_t type,
                                                          _shadowSubscription_t * pSubscription,
-                                                         AwsIotMqttFunction_t mqttOperation );
+                                                         AwsIotMqttFunction_t mqttOperation,
+                                                         uint32_t mqttFlags );
 
 /**
  * @brief Common function for incoming Shadow callbacks.
@@ -336,6 +340,7 @@ static AwsIotShadowError_t _setCallbackCommon( IotMqttConnection_t mqttConnectio
                                                _shadowCallbackType_t type,
                                                const char * pThingName,
                                                size_t thingNameLength,
+                                               uint32_t flags,
                                                const AwsIotShadowCallbackInfo_t * pCallbackInfo )
 {
     IOT_FUNCTION_ENTRY( AwsIotShadowError_t, AWS_IOT_SHADOW_SUCCESS );
@@ -409,7 +414,8 @@ static AwsIotShadowError_t _setCallbackCommon( IotMqttConnection_t mqttConnectio
             ( void ) _modifyCallbackSubscriptions( mqttConnection,
                                                    type,
                                                    pSubscription,
-                                                   IotMqtt_UnsubscribeSync );
+                                                   IotMqtt_UnsubscribeSync,
+                                                   0 );
             ( void ) memset( &( pSubscription->callbacks[ type ] ),
                              0x00,
                              sizeof( AwsIotShadowCallbackInfo_t ) );
@@ -432,7 +438,8 @@ static AwsIotShadowError_t _setCallbackCommon( IotMqttConnection_t mqttConnectio
             status = _modifyCallbackSubscriptions( mqttConnection,
                                                    type,
                                                    pSubscription,
-                                                   IotMqtt_SubscribeSync );
+                                                   IotMqtt_SubscribeSync,
+                                                   SHADOW_MQTT_SUBSCRIBE_FLAGS( flags ) );
 
             if( status == AWS_IOT_SHADOW_SUCCESS )
             {
@@ -472,7 +479,8 @@ static AwsIotShadowError_t _setCallbackCommon( IotMqttConnection_t mqttConnectio
 static AwsIotShadowError_t _modifyCallbackSubscriptions( IotMqttConnection_t mqttConnection,
                                                          _shadowCallbackType_t type,
                                                          _shadowSubscription_t * pSubscription,
-                                                         AwsIotMqttFunction_t mqttOperation )
+                                                         AwsIotMqttFunction_t mqttOperation,
+                                                         uint32_t mqttFlags )
 {
     IOT_FUNCTION_ENTRY( AwsIotShadowError_t, AWS_IOT_SHADOW_SUCCESS );
     IotMqttError_t mqttStatus = IOT_MQTT_STATUS_PENDING;
@@ -545,7 +553,7 @@ static AwsIotShadowError_t _modifyCallbackSubscriptions( IotMqttConnection_t mqt
     mqttStatus = mqttOperation( mqttConnection,
                                 &subscription,
                                 1,
-                                0,
+                                mqttFlags,
                                 _AwsIotShadowMqttTimeoutMs );
 
     /* Check the result of the MQTT operation. */
@@ -1214,13 +1222,11 @@ AwsIotShadowError_t AwsIotShadow_SetDeltaCallback( IotMqttConnection_t mqttConne
                                                    uint32_t flags,
                                                    const AwsIotShadowCallbackInfo_t * pDeltaCallback )
 {
-    /* Flags are currently not used by this function. */
-    ( void ) flags;
-
     return _setCallbackCommon( mqttConnection,
                                DELTA_CALLBACK,
                                pThingName,
                                thingNameLength,
+                               flags,
                                pDeltaCallback );
 }
 
@@ -1232,13 +1238,11 @@ AwsIotShadowError_t AwsIotShadow_SetUpdatedCallback( IotMqttConnection_t mqttCon
                                                      uint32_t flags,
                                                      const AwsIotShadowCallbackInfo_t * pUpdatedCallback )
 {
-    /* Flags are currently not used by this function. */
-    ( void ) flags;
-
     return _setCallbackCommon( mqttConnection,
                                UPDATED_CALLBACK,
                                pThingName,
                                thingNameLength,
+                               flags,
                                pUpdatedCallback );
 }
 
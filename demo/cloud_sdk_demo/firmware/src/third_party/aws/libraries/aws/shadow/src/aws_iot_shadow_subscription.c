@@ -301,6 +301,7 @@ AwsIotShadowError_t _AwsIotShadow_IncrementReferences( _shadowOperation_t * pOpe
         subscriptionInfo.timeout = _AwsIotShadowMqttTimeoutMs;
         subscriptionInfo.pTopicFilterBase = pTopicBuffer;
         subscriptionInfo.topicFilterBaseLength = operationTopicLength;
+        subscriptionInfo.flags = SHADOW_MQTT_SUBSCRIBE_FLAGS( pOperation->flags );
 
         subscriptionStatus = AwsIot_ModifySubscriptions( IotMqtt_SubscribeSync,
                                                          &subscriptionInfo );
@@ -270,6 +270,13 @@
     ( ( X ) == IOT_MQTT_NO_MEMORY ) ? AWS_IOT_SHADOW_NO_MEMORY : \
     AWS_IOT_SHADOW_MQTT_ERROR
 
+/**
+ * @brief The flags for @ref mqtt_function_subscribesync that match the flags
+ * of a Shadow API function.
+ */
+#define SHADOW_MQTT_SUBSCRIBE_FLAGS( flags ) \
+    ( ( ( ( flags ) & AWS_IOT_SHADOW_FLAG_SESSION_RESTORE ) != 0 ) ? IOT_MQTT_FLAG_SESSION_RESTORE : 0 )
+
 /*----------------------- Shadow internal data types ------------------------*/
 
 /**
@@ -46,6 +46,7 @@ void RunShadowTests( bool disableNetworkTests, bool disableLongTests )
 
     RUN_TEST_GROUP( Shadow_Unit_Parser );
     RUN_TEST_GROUP( Shadow_Unit_API );
+    RUN_TEST_GROUP( Shadow_Unit_Delta );
 
     if( disableNetworkTests == false )
     {
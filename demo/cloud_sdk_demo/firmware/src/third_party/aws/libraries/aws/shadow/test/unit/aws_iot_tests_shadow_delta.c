@@ -0,0 +1,527 @@
+/*
+ * AWS IoT Shadow V2.1.0
+ * Copyright (C) 2018 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file aws_iot_tests_shadow_delta.c
+ * @brief Tests for the inbound traffic of a device that follows its Shadow
+ * through delta callbacks and persistent operation subscriptions.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <stdio.h>
+#include <string.h>
+
+/* SDK initialization include. */
+#include "iot_init.h"
+
+/* Platform layer includes. */
+#include "platform/iot_clock.h"
+#include "platform/iot_threads.h"
+
+/* Shadow internal include. */
+#include "private/aws_iot_shadow_internal.h"
+
+/* JSON utilities include. */
+#include "aws_iot_doc_parser.h"
+
+/* Test framework includes. */
+#include "unity_fixture.h"
+
+/* MQTT include. */
+#include "iot_mqtt.h"
+
+/* MQTT mock include. */
+#include "iot_tests_mqtt_mock.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The Thing Name shared among all the tests.
+ */
+#define TEST_THING_NAME             "TestThingName"
+
+/**
+ * @brief The length of #TEST_THING_NAME.
+ */
+#define TEST_THING_NAME_LENGTH      ( sizeof( TEST_THING_NAME ) - 1 )
+
+/**
+ * @brief Prefix of the Shadow topics of #TEST_THING_NAME.
+ */
+#define TEST_TOPIC_PREFIX           "$aws/things/" TEST_THING_NAME "/shadow/"
+
+/**
+ * @brief The wildcard filter a device used before it relied on the Shadow
+ * library, which also matches the `documents` and its own `accepted` topics.
+ */
+#define TEST_WILDCARD_FILTER        TEST_TOPIC_PREFIX "update/#"
+
+/**
+ * @brief Number of desired-state changes simulated by the traffic tests.
+ */
+#define TEST_DELTA_COUNT            ( 200 )
+
+/**
+ * @brief Time to wait for the callbacks of an incoming PUBLISH.
+ */
+#define TEST_CALLBACK_TIMEOUT_MS    ( 1000 )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A message the Shadow service publishes.
+ */
+typedef struct _serviceMessage
+{
+    const char * pTopicName; /**< @brief Topic of the message. */
+    const char * pPayload;   /**< @brief Payload of the message. */
+} _serviceMessage_t;
+
+/**
+ * @brief Inbound traffic counted by a traffic test.
+ */
+typedef struct _trafficStats
+{
+    uint32_t messages;       /**< @brief PUBLISH messages routed to the device. */
+    uint32_t bytes;          /**< @brief Topic and payload bytes routed to the device. */
+    uint32_t callbacks;      /**< @brief Device callbacks invoked. */
+} _trafficStats_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief What the Shadow service publishes when a desired value is set from
+ * the cloud, and again when the device reports it.
+ */
+static const _serviceMessage_t _pDeltaExchange[] =
+{
+    /* The cloud sets the desired value. */
+    { TEST_TOPIC_PREFIX "update/accepted",
+      "{\"state\":{\"desired\":{\"toggle\":1}},\"metadata\":{\"desired\":{\"toggle\":{\"timestamp\":1600000000}}},"
+      "\"version\":42,\"timestamp\":1600000000}" },
+    { TEST_TOPIC_PREFIX "update/documents",
+      "{\"previous\":{\"state\":{\"desired\":{\"toggle\":0},\"reported\":{\"toggle\":0}},"
+      "\"metadata\":{\"desired\":{\"toggle\":{\"timestamp\":1599999000}},\"reported\":{\"toggle\":{\"timestamp\":1599999000}}},"
+      "\"version\":41},\"current\":{\"state\":{\"desired\":{\"toggle\":1},\"reported\":{\"toggle\":0}},"
+      "\"metadata\":{\"desired\":{\"toggle\":{\"timestamp\":1600000000}},\"reported\":{\"toggle\":{\"timestamp\":1599999000}}},"
+      "\"version\":42},\"timestamp\":1600000000}" },
+    { TEST_TOPIC_PREFIX "update/delta",
+      "{\"version\":42,\"timestamp\":1600000000,\"state\":{\"toggle\":1},"
+      "\"metadata\":{\"toggle\":{\"timestamp\":1600000000}}}" },
+    /* The device reports the value it applied. */
+    { TEST_TOPIC_PREFIX "update/accepted",
+      "{\"state\":{\"reported\":{\"toggle\":1}},\"metadata\":{\"reported\":{\"toggle\":{\"timestamp\":1600000001}}},"
+      "\"version\":43,\"timestamp\":1600000001,\"clientToken\":\"1\"}" },
+    { TEST_TOPIC_PREFIX "update/documents",
+      "{\"previous\":{\"state\":{\"desired\":{\"toggle\":1},\"reported\":{\"toggle\":0}},"
+      "\"metadata\":{\"desired\":{\"toggle\":{\"timestamp\":1600000000}},\"reported\":{\"toggle\":{\"timestamp\":1599999000}}},"
+      "\"version\":42},\"current\":{\"state\":{\"desired\":{\"toggle\":1},\"reported\":{\"toggle\":1}},"
+      "\"metadata\":{\"desired\":{\"toggle\":{\"timestamp\":1600000000}},\"reported\":{\"toggle\":{\"timestamp\":1600000001}}},"
+      "\"version\":43},\"timestamp\":1600000001}" }
+};
+
+/**
+ * @brief Number of messages in #_pDeltaExchange.
+ */
+#define DELTA_EXCHANGE_LENGTH    ( sizeof( _pDeltaExchange ) / sizeof( _pDeltaExchange[ 0 ] ) )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The MQTT connection shared among the tests.
+ */
+static IotMqttConnection_t _pMqttConnection = IOT_MQTT_CONNECTION_INITIALIZER;
+
+/**
+ * @brief Posted by the callbacks of these tests.
+ */
+static IotSemaphore_t _callbackSem;
+
+/**
+ * @brief Value of `toggle` in the last delta document parsed.
+ */
+static int32_t _toggle = -1;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Find `state.toggle` the way a device does to follow a delta.
+ */
+static void _parseToggle( const char * pDocument,
+                          size_t documentLength )
+{
+    const char * pState = NULL, * pToggle = NULL;
+    size_t stateLength = 0, toggleLength = 0;
+
+    if( ( AwsIotDocParser_FindValue( pDocument, documentLength, "state", 5,
+                                     &pState, &stateLength ) == true ) &&
+        ( AwsIotDocParser_FindValue( pState, stateLength, "toggle", 6,
+                                     &pToggle, &toggleLength ) == true ) )
+    {
+        _toggle = ( *pToggle == '1' ) ? 1 : 0;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Device callback for the wildcard subscription: every message on the
+ * `update` topics reaches it.
+ */
+static void _wildcardCallback( void * pArgument,
+                               IotMqttCallbackParam_t * pPublish )
+{
+    const IotMqttPublishInfo_t * pInfo = &( pPublish->u.message.info );
+
+    ( void ) pArgument;
+
+    /* The device picks the delta out of the update topics by name. */
+    if( ( pInfo->topicNameLength >= sizeof( "/delta" ) - 1 ) &&
+        ( memcmp( pInfo->pTopicName + pInfo->topicNameLength - ( sizeof( "/delta" ) - 1 ),
+                  "/delta",
+                  sizeof( "/delta" ) - 1 ) == 0 ) )
+    {
+        _parseToggle( pInfo->pPayload, pInfo->payloadLength );
+    }
+
+    IotSemaphore_Post( &_callbackSem );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Device callback for Shadow deltas.
+ */
+static void _deltaCallback( void * pArgument,
+                            AwsIotShadowCallbackParam_t * pCallbackParam )
+{
+    ( void ) pArgument;
+
+    _parseToggle( pCallbackParam->u.callback.pDocument,
+                  pCallbackParam->u.callback.documentLength );
+
+    IotSemaphore_Post( &_callbackSem );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Device callback for completed Shadow operations.
+ */
+static void _operationCallback( void * pArgument,
+                                AwsIotShadowCallbackParam_t * pCallbackParam )
+{
+    AwsIotShadowError_t * pResult = ( AwsIotShadowError_t * ) pArgument;
+
+    *pResult = pCallbackParam->u.operation.result;
+
+    IotSemaphore_Post( &_callbackSem );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Whether the broker routes a topic to the mocked connection.
+ *
+ * The MQTT library keeps the filters the device subscribed to; the broker
+ * matches a topic with the same filter or with any `/#` filter above it.
+ */
+static bool _brokerRoutes( const char * pTopicName )
+{
+    char pFilter[ 128 ] = { 0 };
+    size_t length = strlen( pTopicName );
+
+    if( IotMqtt_IsSubscribed( _pMqttConnection, pTopicName, ( uint16_t ) length, NULL ) == true )
+    {
+        return true;
+    }
+
+    while( length > 0 )
+    {
+        length--;
+
+        if( pTopicName[ length ] == '/' )
+        {
+            ( void ) memcpy( pFilter, pTopicName, length );
+            ( void ) memcpy( pFilter + length, "/#", 3 );
+
+            if( IotMqtt_IsSubscribed( _pMqttConnection, pFilter, ( uint16_t ) ( length + 2 ), NULL ) == true )
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Replay #_pDeltaExchange #TEST_DELTA_COUNT times through the broker and
+ * wait for the device to have processed it.
+ *
+ * @param[in] callbacksPerExchange Number of device callbacks that post
+ * #_callbackSem in each exchange.
+ * @param[out] pStats Inbound traffic of the replay.
+ */
+static void _replayExchanges( uint32_t callbacksPerExchange,
+                              _trafficStats_t * pStats )
+{
+    uint32_t i = 0, j = 0, k = 0;
+    const _serviceMessage_t * pMessage = NULL;
+
+    ( void ) memset( pStats, 0x00, sizeof( _trafficStats_t ) );
+
+    for( i = 0; i < TEST_DELTA_COUNT; i++ )
+    {
+        for( j = 0; j < DELTA_EXCHANGE_LENGTH; j++ )
+        {
+            pMessage = &( _pDeltaExchange[ j ] );
+
+            if( _brokerRoutes( pMessage->pTopicName ) == false )
+            {
+                continue;
+            }
+
+            pStats->messages++;
+            pStats->bytes += ( uint32_t ) ( strlen( pMessage->pTopicName ) + strlen( pMessage->pPayload ) );
+
+            TEST_ASSERT_EQUAL_INT( true, IotTest_MqttMockReceivePublish( pMessage->pTopicName,
+                                                                         ( uint16_t ) strlen( pMessage->pTopicName ),
+                                                                         pMessage->pPayload,
+                                                                         strlen( pMessage->pPayload ) ) );
+        }
+
+        /* The callbacks run in the task pool; wait for them before the next
+         * exchange, like a device that reports between two deltas. */
+        for( k = 0; k < callbacksPerExchange; k++ )
+        {
+            TEST_ASSERT_EQUAL_INT( true, IotSemaphore_TimedWait( &_callbackSem,
+                                                                 TEST_CALLBACK_TIMEOUT_MS ) );
+            pStats->callbacks++;
+        }
+    }
+
+    /* No other device callback ran. */
+    IotClock_SleepMs( 50 );
+    TEST_ASSERT_EQUAL( 0, IotSemaphore_GetCount( &_callbackSem ) );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Subscribe the way a device using the Shadow library does: a delta
+ * callback, and the `update` and `get` operation topics kept subscribed by
+ * a first update and get.
+ */
+static void _subscribeShadow( void )
+{
+    AwsIotShadowError_t result = AWS_IOT_SHADOW_STATUS_PENDING;
+    AwsIotShadowCallbackInfo_t callbackInfo = AWS_IOT_SHADOW_CALLBACK_INFO_INITIALIZER;
+    AwsIotShadowDocumentInfo_t documentInfo = AWS_IOT_SHADOW_DOCUMENT_INFO_INITIALIZER;
+    static const char pGetAccepted[] =
+        "{\"state\":{\"desired\":{\"toggle\":0},\"reported\":{\"toggle\":0}},\"version\":43,\"clientToken\":\"2\"}";
+
+    callbackInfo.function = _deltaCallback;
+    TEST_ASSERT_EQUAL( AWS_IOT_SHADOW_SUCCESS,
+                       AwsIotShadow_SetDeltaCallback( _pMqttConnection,
+                                                      TEST_THING_NAME,
+                                                      TEST_THING_NAME_LENGTH,
+                                                      0,
+                                                      &callbackInfo ) );
+
+    documentInfo.pThingName = TEST_THING_NAME;
+    documentInfo.thingNameLength = TEST_THING_NAME_LENGTH;
+    documentInfo.qos = IOT_MQTT_QOS_1;
+    documentInfo.u.update.pUpdateDocument = "{\"state\":{\"reported\":{\"toggle\":1}},\"clientToken\":\"1\"}";
+    documentInfo.u.update.updateDocumentLength = strlen( documentInfo.u.update.pUpdateDocument );
+
+    callbackInfo.function = _operationCallback;
+    callbackInfo.pCallbackContext = &result;
+    TEST_ASSERT_EQUAL( AWS_IOT_SHADOW_STATUS_PENDING,
+                       AwsIotShadow_UpdateAsync( _pMqttConnection,
+                                                 &documentInfo,
+                                                 AWS_IOT_SHADOW_FLAG_KEEP_SUBSCRIPTIONS,
+                                                 &callbackInfo,
+                                                 NULL ) );
+
+    /* The reported state is accepted with the client token of the update. */
+    TEST_ASSERT_EQUAL_INT( true, IotTest_MqttMockReceivePublish( _pDeltaExchange[ 3 ].pTopicName,
+                                                                 ( uint16_t ) strlen( _pDeltaExchange[ 3 ].pTopicName ),
+                                                                 _pDeltaExchange[ 3 ].pPayload,
+                                                                 strlen( _pDeltaExchange[ 3 ].pPayload ) ) );
+    TEST_ASSERT_EQUAL_INT( true, IotSemaphore_TimedWait( &_callbackSem, TEST_CALLBACK_TIMEOUT_MS ) );
+    TEST_ASSERT_EQUAL( AWS_IOT_SHADOW_SUCCESS, result );
+
+    result = AWS_IOT_SHADOW_STATUS_PENDING;
+    TEST_ASSERT_EQUAL( AWS_IOT_SHADOW_STATUS_PENDING,
+                       AwsIotShadow_GetAsync( _pMqttConnection,
+                                              &documentInfo,
+                                              AWS_IOT_SHADOW_FLAG_KEEP_SUBSCRIPTIONS,
+                                              &callbackInfo,
+                                              NULL ) );
+    TEST_ASSERT_EQUAL_INT( true, IotTest_MqttMockReceivePublish( TEST_TOPIC_PREFIX "get/accepted",
+                                                                 sizeof( TEST_TOPIC_PREFIX "get/accepted" ) - 1,
+                                                                 pGetAccepted,
+                                                                 sizeof( pGetAccepted ) - 1 ) );
+    TEST_ASSERT_EQUAL_INT( true, IotSemaphore_TimedWait( &_callbackSem, TEST_CALLBACK_TIMEOUT_MS ) );
+    TEST_ASSERT_EQUAL( AWS_IOT_SHADOW_SUCCESS, result );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test group for Shadow delta traffic tests.
+ */
+TEST_GROUP( Shadow_Unit_Delta );
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test setup for Shadow delta traffic tests.
+ */
+TEST_SETUP( Shadow_Unit_Delta )
+{
+    /* Initialize SDK. */
+    TEST_ASSERT_EQUAL_INT( true, IotSdk_Init() );
+
+    /* Initialize the MQTT library. */
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_Init() );
+
+    /* Initialize the Shadow library. */
+    TEST_ASSERT_EQUAL( AWS_IOT_SHADOW_SUCCESS, AwsIotShadow_Init( 0 ) );
+
+    /* Initialize MQTT mock. */
+    TEST_ASSERT_EQUAL_INT( true, IotTest_MqttMockInit( &_pMqttConnection ) );
+
+    TEST_ASSERT_EQUAL_INT( true, IotSemaphore_Create( &_callbackSem, 0, TEST_DELTA_COUNT ) );
+
+    _toggle = -1;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test tear down for Shadow delta traffic tests.
+ */
+TEST_TEAR_DOWN( Shadow_Unit_Delta )
+{
+    IotSemaphore_Destroy( &_callbackSem );
+
+    /* Clean up MQTT mock. */
+    IotTest_MqttMockCleanup();
+
+    /* Clean up the Shadow library. */
+    AwsIotShadow_Cleanup();
+
+    /* Clean up the MQTT library. */
+    IotMqtt_Cleanup();
+
+    /* Clean up SDK. */
+    IotSdk_Cleanup();
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test group runner for Shadow delta traffic tests.
+ */
+TEST_GROUP_RUNNER( Shadow_Unit_Delta )
+{
+    RUN_TEST_CASE( Shadow_Unit_Delta, Subscriptions );
+    RUN_TEST_CASE( Shadow_Unit_Delta, TrafficPerDelta );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A device using the Shadow library is subscribed to the delta, and to
+ * the accepted topics of its update and get only.
+ */
+TEST( Shadow_Unit_Delta, Subscriptions )
+{
+    _subscribeShadow();
+
+    TEST_ASSERT_EQUAL_INT( true, _brokerRoutes( TEST_TOPIC_PREFIX "update/delta" ) );
+    TEST_ASSERT_EQUAL_INT( true, _brokerRoutes( TEST_TOPIC_PREFIX "update/accepted" ) );
+    TEST_ASSERT_EQUAL_INT( true, _brokerRoutes( TEST_TOPIC_PREFIX "get/accepted" ) );
+    TEST_ASSERT_EQUAL_INT( false, _brokerRoutes( TEST_TOPIC_PREFIX "update/documents" ) );
+    TEST_ASSERT_EQUAL_INT( false, _brokerRoutes( TEST_TOPIC_PREFIX "delete/accepted" ) );
+    TEST_ASSERT_EQUAL_INT( false, _brokerRoutes( TEST_WILDCARD_FILTER ) );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Compare the inbound traffic and device callbacks per desired-state
+ * change of the wildcard subscription and of the Shadow library subscriptions.
+ */
+TEST( Shadow_Unit_Delta, TrafficPerDelta )
+{
+    IotMqttSubscription_t subscription = IOT_MQTT_SUBSCRIPTION_INITIALIZER;
+    _trafficStats_t wildcard = { 0 }, shadow = { 0 };
+
+    /* The wildcard subscription gets all five messages of an exchange. */
+    subscription.qos = IOT_MQTT_QOS_1;
+    subscription.pTopicFilter = TEST_WILDCARD_FILTER;
+    subscription.topicFilterLength = sizeof( TEST_WILDCARD_FILTER ) - 1;
+    subscription.callback.function = _wildcardCallback;
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS,
+                       IotMqtt_SubscribeSync( _pMqttConnection, &subscription, 1, 0, IOT_TEST_MQTT_TIMEOUT_MS ) );
+
+    _replayExchanges( DELTA_EXCHANGE_LENGTH, &wildcard );
+    TEST_ASSERT_EQUAL( 1, _toggle );
+
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS,
+                       IotMqtt_UnsubscribeSync( _pMqttConnection, &subscription, 1, 0, IOT_TEST_MQTT_TIMEOUT_MS ) );
+
+    /* With the Shadow library, the device callback only sees the delta; the
+     * accepted documents are matched against pending operations. */
+    _subscribeShadow();
+    _toggle = -1;
+    _replayExchanges( 1, &shadow );
+    TEST_ASSERT_EQUAL( 1, _toggle );
+
+    printf( "Per delta: wildcard %lu messages, %lu bytes, %lu callbacks; "
+            "shadow %lu messages, %lu bytes, %lu callbacks\r\n",
+            ( unsigned long ) ( wildcard.messages / TEST_DELTA_COUNT ),
+            ( unsigned long ) ( wildcard.bytes / TEST_DELTA_COUNT ),
+            ( unsigned long ) ( wildcard.callbacks / TEST_DELTA_COUNT ),
+            ( unsigned long ) ( shadow.messages / TEST_DELTA_COUNT ),
+            ( unsigned long ) ( shadow.bytes / TEST_DELTA_COUNT ),
+            ( unsigned long ) ( shadow.callbacks / TEST_DELTA_COUNT ) );
+
+    /* The documents topic is no longer routed to the device... */
+    TEST_ASSERT_EQUAL( DELTA_EXCHANGE_LENGTH * TEST_DELTA_COUNT, wildcard.messages );
+    TEST_ASSERT_EQUAL( ( DELTA_EXCHANGE_LENGTH - 2 ) * TEST_DELTA_COUNT, shadow.messages );
+    TEST_ASSERT_LESS_THAN_UINT32( wildcard.bytes / 2, shadow.bytes );
+
+    /* ...and the device is called for the delta only. */
+    TEST_ASSERT_EQUAL( DELTA_EXCHANGE_LENGTH * TEST_DELTA_COUNT, wildcard.callbacks );
+    TEST_ASSERT_EQUAL( TEST_DELTA_COUNT, shadow.callbacks );
+}
+
+/*-----------------------------------------------------------*/
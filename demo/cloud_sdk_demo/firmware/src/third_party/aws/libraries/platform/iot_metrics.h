@@ -40,17 +40,26 @@
 /* Linear containers (lists and queues) include. */
 #include "iot_linear_containers.h"
 
+/* Platform types include. */
+#include "types/iot_platform_types.h"
+
 /**
  * @functionspage{platform_metrics,platform metrics component,Metrics}
  * - @functionname{platform_metrics_function_init}
  * - @functionname{platform_metrics_function_cleanup}
  * - @functionname{platform_metrics_function_gettcpconnections}
+ * - @functionname{platform_metrics_function_getlisteningtcpports}
+ * - @functionname{platform_metrics_function_getlisteningudpports}
+ * - @functionname{platform_metrics_function_getnetworkstats}
  */
 
 /**
  * @functionpage{IotMetrics_Init,platform_metrics,init}
  * @functionpage{IotMetrics_Cleanup,platform_metrics,cleanup}
  * @functionpage{IotMetrics_GetTcpConnections,platform_metrics,gettcpconnections}
+ * @functionpage{IotMetrics_GetListeningTcpPorts,platform_metrics,getlisteningtcpports}
+ * @functionpage{IotMetrics_GetListeningUdpPorts,platform_metrics,getlisteningudpports}
+ * @functionpage{IotMetrics_GetNetworkStats,platform_metrics,getnetworkstats}
  */
 
 /**
@@ -97,4 +106,37 @@ void IotMetrics_GetTcpConnections( void * pContext,
                                    void ( * metricsCallback )( void *, const IotListDouble_t * ) );
 /* @[declare_platform_metrics_gettcpconnections] */
 
+/**
+ * @brief Retrieve a list of the TCP ports listening for connections.
+ *
+ * @param[in] pContext Context passed as the first parameter of `metricsCallback`.
+ * @param[in] metricsCallback Called by this function to provide the list of
+ * #IotMetricsListeningPort_t. The list should not be used after the callback returns.
+ */
+/* @[declare_platform_metrics_getlisteningtcpports] */
+void IotMetrics_GetListeningTcpPorts( void * pContext,
+                                      void ( * metricsCallback )( void *, const IotListDouble_t * ) );
+/* @[declare_platform_metrics_getlisteningtcpports] */
+
+/**
+ * @brief Retrieve a list of the UDP ports open for datagrams.
+ *
+ * @param[in] pContext Context passed as the first parameter of `metricsCallback`.
+ * @param[in] metricsCallback Called by this function to provide the list of
+ * #IotMetricsListeningPort_t. The list should not be used after the callback returns.
+ */
+/* @[declare_platform_metrics_getlisteningudpports] */
+void IotMetrics_GetListeningUdpPorts( void * pContext,
+                                      void ( * metricsCallback )( void *, const IotListDouble_t * ) );
+/* @[declare_platform_metrics_getlisteningudpports] */
+
+/**
+ * @brief Read the traffic counters of the network interfaces.
+ *
+ * @param[out] pNetworkStats Set to the current counters.
+ */
+/* @[declare_platform_metrics_getnetworkstats] */
+void IotMetrics_GetNetworkStats( IotMetricsNetworkStats_t * pNetworkStats );
+/* @[declare_platform_metrics_getnetworkstats] */
+
 #endif /* ifndef IOT_METRICS_H_ */
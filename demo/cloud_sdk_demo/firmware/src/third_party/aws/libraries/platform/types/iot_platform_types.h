@@ -187,4 +187,30 @@ typedef struct IotMetricsTcpConnection
     char pRemoteAddress[ IOT_METRICS_IP_ADDRESS_LENGTH ];
 } IotMetricsTcpConnection_t;
 
+/**
+ * @brief Represents a TCP or UDP port open for incoming traffic.
+ *
+ * A list of these is provided by @ref platform_metrics_function_getlisteningtcpports
+ * and @ref platform_metrics_function_getlisteningudpports.
+ */
+typedef struct IotMetricsListeningPort
+{
+    IotLink_t link; /**< @brief List link member. */
+    uint16_t port;  /**< @brief Local port number. */
+} IotMetricsListeningPort_t;
+
+/**
+ * @brief Traffic counters of the network interfaces.
+ *
+ * The counters run from boot and wrap around; Defender reports the difference
+ * between two reads, which stays right across one wrap.
+ */
+typedef struct IotMetricsNetworkStats
+{
+    uint32_t bytesIn;    /**< @brief Bytes received. */
+    uint32_t bytesOut;   /**< @brief Bytes sent. */
+    uint32_t packetsIn;  /**< @brief Packets received. */
+    uint32_t packetsOut; /**< @brief Packets sent. */
+} IotMetricsNetworkStats_t;
+
 #endif /* ifndef IOT_PLATFORM_TYPES_H_ */
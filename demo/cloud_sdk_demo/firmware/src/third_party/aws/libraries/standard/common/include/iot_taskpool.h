@@ -54,7 +54,9 @@
  * - @functionname{taskpool_function_recyclejob}
  * - @functionname{taskpool_function_schedule}
  * - @functionname{taskpool_function_scheduledeferred}
+ * - @functionname{taskpool_function_scheduledeferredwithflags}
  * - @functionname{taskpool_function_getstatus}
+ * - @functionname{taskpool_function_getstats}
  * - @functionname{taskpool_function_trycancel}
  * - @functionname{taskpool_function_getjobstoragefromhandle}
  * - @functionname{taskpool_function_strerror}
@@ -72,7 +74,9 @@
  * @functionpage{IotTaskPool_RecycleJob,taskpool,recyclejob}
  * @functionpage{IotTaskPool_Schedule,taskpool,schedule}
  * @functionpage{IotTaskPool_ScheduleDeferred,taskpool,scheduledeferred}
+ * @functionpage{IotTaskPool_ScheduleDeferredWithFlags,taskpool,scheduledeferredwithflags}
  * @functionpage{IotTaskPool_GetStatus,taskpool,getstatus}
+ * @functionpage{IotTaskPool_GetStats,taskpool,getstats}
  * @functionpage{IotTaskPool_TryCancel,taskpool,trycancel}
  * @functionpage{IotTaskPool_GetJobStorageFromHandle,taskpool,getjobstoragefromhandle}
  * @functionpage{IotTaskPool_strerror,taskpool,strerror}
@@ -327,7 +331,8 @@ IotTaskPoolError_t IotTaskPool_RecycleJob( IotTaskPool_t taskPool,
  * @param[in] taskPool A handle to the task pool that must have been previously initialized with.
  * a call to @ref IotTaskPool_Create.
  * @param[in] job A job to schedule for execution. This must be first initialized with a call to @ref IotTaskPool_CreateJob.
- * @param[in] flags Flags to be passed by the user, e.g. to identify the job as high priority by specifying #IOT_TASKPOOL_JOB_HIGH_PRIORITY.
+ * @param[in] flags Flags to be passed by the user, e.g. to identify the job as high priority by specifying #IOT_TASKPOOL_JOB_HIGH_PRIORITY,
+ * or to queue it in the time-critical lane by specifying #IOT_TASKPOOL_JOB_TIME_CRITICAL.
  *
  * @return One of the following:
  * - #IOT_TASKPOOL_SUCCESS
@@ -430,6 +435,10 @@ IotTaskPoolError_t IotTaskPool_Schedule( IotTaskPool_t taskPool,
  *
  * @note This function will not allocate memory.
  *
+ * @note Deferred jobs are kept in a timer wheel with a granularity of @ref IOT_TASKPOOL_TIMER_TICK_MS, so
+ * scheduling or canceling one takes the same time however many jobs are deferred, and a job may be scheduled
+ * up to one tick after `timeMs` expires, never before.
+ *
  * @warning The `taskPool` used in this function should be the same
  * used to create the job pointed to by `job`, or the results will be undefined.
  *
@@ -440,6 +449,32 @@ IotTaskPoolError_t IotTaskPool_ScheduleDeferred( IotTaskPool_t taskPool,
                                                  uint32_t timeMs );
 /* @[declare_taskpool_scheduledeferred] */
 
+/**
+ * @brief This function schedules a job like @ref IotTaskPool_ScheduleDeferred, and queues it in the lane selected
+ * by `flags` when the time interval expires.
+ *
+ * @param[in] taskPool A handle to the task pool that must have been previously initialized with.
+ * a call to @ref IotTaskPool_Create.
+ * @param[in] job A job to schedule for execution. This must be first initialized with a call to @ref IotTaskPool_CreateJob.
+ * @param[in] timeMs The time in milliseconds to wait before scheduling the job.
+ * @param[in] flags Either 0 or #IOT_TASKPOOL_JOB_TIME_CRITICAL.
+ *
+ * @return One of the following:
+ * - #IOT_TASKPOOL_SUCCESS
+ * - #IOT_TASKPOOL_BAD_PARAMETER
+ * - #IOT_TASKPOOL_ILLEGAL_OPERATION
+ * - #IOT_TASKPOOL_SHUTDOWN_IN_PROGRESS
+ *
+ * @note #IOT_TASKPOOL_JOB_HIGH_PRIORITY is not accepted, since a deferred job could not report a failure to
+ * create its worker.
+ */
+/* @[declare_taskpool_scheduledeferredwithflags] */
+IotTaskPoolError_t IotTaskPool_ScheduleDeferredWithFlags( IotTaskPool_t taskPool,
+                                                          IotTaskPoolJob_t job,
+                                                          uint32_t timeMs,
+                                                          uint32_t flags );
+/* @[declare_taskpool_scheduledeferredwithflags] */
+
 /**
  * @brief This function retrieves the current status of a job.
  *
@@ -462,6 +497,26 @@ IotTaskPoolError_t IotTaskPool_GetStatus( IotTaskPool_t taskPool,
                                           IotTaskPoolJobStatus_t * const pStatus );
 /* @[declare_taskpool_getstatus] */
 
+/**
+ * @brief This function retrieves the queue-wait and run-time histograms of the jobs the task pool
+ * dispatched so far, per lane.
+ *
+ * Every job adds one sample to the histograms of the lane it was dispatched from, when its callback returns.
+ *
+ * @param[in] taskPool A handle to the task pool that must have been previously initialized with
+ * a call to @ref IotTaskPool_Create or @ref IotTaskPool_CreateSystemTaskPool.
+ * @param[out] pStats The statistics of the task pool.
+ *
+ * @return One of the following:
+ * - #IOT_TASKPOOL_SUCCESS
+ * - #IOT_TASKPOOL_BAD_PARAMETER
+ * - #IOT_TASKPOOL_SHUTDOWN_IN_PROGRESS
+ */
+/* @[declare_taskpool_getstats] */
+IotTaskPoolError_t IotTaskPool_GetStats( IotTaskPool_t taskPool,
+                                         IotTaskPoolStats_t * const pStats );
+/* @[declare_taskpool_getstats] */
+
 /**
  * @brief This function tries to cancel a job that was previously scheduled with @ref IotTaskPool_Schedule.
  *
@@ -551,4 +606,22 @@ const char * IotTaskPool_strerror( IotTaskPoolError_t status );
     #define IOT_TASKPOOL_JOB_WAIT_TIMEOUT_MS    ( 60 * 1000UL )
 #endif
 
+/**
+ * @brief The maximum number of workers a task pool may create above its maximum number of threads,
+ * to run time-critical jobs while all its workers are busy. A spare worker only runs time-critical jobs, and
+ * stays parked between them until the task pool is destroyed.
+ */
+#ifndef IOT_TASKPOOL_SPARE_WORKERS
+    #define IOT_TASKPOOL_SPARE_WORKERS    ( 1UL )
+#endif
+
+/**
+ * @brief The granularity in milliseconds of the timer for deferred jobs.
+ * A deferred job may run up to one tick late; a coarser tick wakes up the timer less often
+ * and lets more jobs expire together.
+ */
+#ifndef IOT_TASKPOOL_TIMER_TICK_MS
+    #define IOT_TASKPOOL_TIMER_TICK_MS    ( 10UL )
+#endif
+
 #endif /* ifndef IOT_TASKPOOL_H_ */
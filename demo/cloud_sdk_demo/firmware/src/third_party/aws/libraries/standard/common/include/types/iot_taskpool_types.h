@@ -168,6 +168,8 @@ typedef struct IotTaskPoolJobStorage
     void * dummy3;                  /**< @brief Placeholder. */
     uint32_t dummy4;                /**< @brief Placeholder. */
     IotTaskPoolJobStatus_t status;  /**< @brief Placeholder. */
+    uint32_t dummy6;                /**< @brief Placeholder. */
+    uint32_t dummy7;                /**< @brief Placeholder. */
 } IotTaskPoolJobStorage_t;
 
 /**
@@ -228,6 +230,57 @@ typedef struct IotTaskPoolInfo
     int32_t priority;    /**< @brief priority for every task pool thread. The priority for each thread is fixed after the task pool is created and cannot be changed. */
 } IotTaskPoolInfo_t;
 
+/**
+ * @ingroup taskpool_datatypes_enums
+ * @brief The ready queues of a task pool.
+ *
+ * Jobs scheduled with #IOT_TASKPOOL_JOB_TIME_CRITICAL or #IOT_TASKPOOL_JOB_HIGH_PRIORITY wait in the
+ * time-critical lane, all other jobs in the normal lane. A worker always takes the oldest job of the
+ * time-critical lane before any job of the normal lane.
+ */
+typedef enum IotTaskPoolLane
+{
+    IOT_TASKPOOL_LANE_TIME_CRITICAL = 0, /**< @brief Protocol jobs that must not wait behind user callbacks. */
+    IOT_TASKPOOL_LANE_NORMAL,            /**< @brief All other jobs. */
+    IOT_TASKPOOL_LANES                   /**< @brief The number of lanes. */
+} IotTaskPoolLane_t;
+
+/**
+ * @brief The number of buckets of a task pool latency histogram.
+ *
+ * Bucket 0 counts the jobs that took less than 1 ms, and bucket `n` those that took
+ * from 2^(n-1) to 2^n - 1 ms. The last bucket also counts all longer times.
+ */
+#define IOT_TASKPOOL_HISTOGRAM_BUCKETS    ( 16 )
+
+/**
+ * @ingroup taskpool_datatypes_paramstructs
+ * @brief Latency statistics of the jobs dispatched from one lane.
+ *
+ * @paramfor @ref taskpool_function_getstats
+ */
+typedef struct IotTaskPoolLaneStats
+{
+    uint32_t jobs;                                             /**< @brief Number of jobs that completed. */
+    uint32_t maxQueueWaitMs;                                   /**< @brief Longest time a job waited in the lane. */
+    uint32_t maxRunTimeMs;                                     /**< @brief Longest time a job callback ran. */
+    uint32_t queueWaitMs[ IOT_TASKPOOL_HISTOGRAM_BUCKETS ];    /**< @brief Histogram of the time from scheduling (or timer expiry) to dispatch. */
+    uint32_t runTimeMs[ IOT_TASKPOOL_HISTOGRAM_BUCKETS ];      /**< @brief Histogram of the time spent in the job callback. */
+} IotTaskPoolLaneStats_t;
+
+/**
+ * @ingroup taskpool_datatypes_paramstructs
+ * @brief Latency statistics of a task pool, since it was created.
+ *
+ * @paramfor @ref taskpool_function_getstats
+ */
+typedef struct IotTaskPoolStats
+{
+    IotTaskPoolLaneStats_t lanes[ IOT_TASKPOOL_LANES ]; /**< @brief Statistics per lane, indexed by #IotTaskPoolLane_t. */
+    uint32_t spareWorkers;                              /**< @brief Number of workers created above the maximum to serve the time-critical lane. */
+    uint32_t spareWakeups;                              /**< @brief Number of times a spare worker was woken up for a time-critical job. */
+} IotTaskPoolStats_t;
+
 /*------------------------- TASKPOOL defined constants --------------------------*/
 
 /**
@@ -275,7 +328,7 @@ typedef struct IotTaskPoolInfo
 /** @brief Initializer for a #IotTaskPool_t. */
 #define IOT_TASKPOOL_INITIALIZER                NULL
 /** @brief Initializer for a #IotTaskPoolJobStorage_t. */
-#define IOT_TASKPOOL_JOB_STORAGE_INITIALIZER    { { NULL, NULL }, NULL, NULL, 0, IOT_TASKPOOL_STATUS_UNDEFINED }
+#define IOT_TASKPOOL_JOB_STORAGE_INITIALIZER    { { NULL, NULL }, NULL, NULL, 0, IOT_TASKPOOL_STATUS_UNDEFINED, 0, 0 }
 /** @brief Initializer for a #IotTaskPoolJob_t. */
 #define IOT_TASKPOOL_JOB_INITIALIZER            NULL
 /* @[define_taskpool_initializers] */
@@ -289,6 +342,18 @@ typedef struct IotTaskPoolInfo
  */
 #define IOT_TASKPOOL_JOB_HIGH_PRIORITY    ( ( uint32_t ) 0x00000001 )
 
+/**
+ * @brief Flag for scheduling a job in the time-critical lane.
+ *
+ * Time-critical jobs are dispatched before any job of the normal lane. When every worker is busy, a
+ * spare worker is woken up, so that a slow callback does not hold back the job. Spare workers are
+ * created above the maximum number of threads the first time they are needed, up to
+ * #IOT_TASKPOOL_SPARE_WORKERS, and stay parked until the task pool is destroyed. Unlike
+ * #IOT_TASKPOOL_JOB_HIGH_PRIORITY, failing to create the spare worker is not an error: the job then
+ * waits at the front of the ready jobs.
+ */
+#define IOT_TASKPOOL_JOB_TIME_CRITICAL    ( ( uint32_t ) 0x00000002 )
+
 /**
  * @brief Allows the use of the handle to the system task pool.
  *
@@ -63,6 +63,11 @@
  */
 #define TASKPOOL_JOB_RESCHEDULE_DELAY_MS    ( 10ULL )
 
+/**
+ * @brief Converts a time in milliseconds to a tick of the timer wheel for deferred jobs.
+ */
+#define TASKPOOL_TIMER_TICK( timeMs )       ( ( uint32_t ) ( ( timeMs ) / IOT_TASKPOOL_TIMER_TICK_MS ) )
+
 /* ---------------------------------------------------------------------------------- */
 
 /**
@@ -73,7 +78,7 @@
  * the system libraries as well. The system task pool needs to be initialized before any library is used or
  * before any code that posts jobs to the task pool runs.
  */
-_taskPool_t _IotSystemTaskPool = { .dispatchQueue = IOT_DEQUEUE_INITIALIZER };
+_taskPool_t _IotSystemTaskPool = { .dispatchQueue = { IOT_DEQUEUE_INITIALIZER, IOT_DEQUEUE_INITIALIZER } };
 
 /* -------------- Convenience functions to create/recycle/destroy jobs -------------- */
 
@@ -132,25 +137,107 @@ static void _destroyJob( _taskPoolJob_t * const pJob );
  */
 static void _taskPoolWorker( void * pUserContext );
 
+/**
+ * The procedure for a spare worker thread, which runs the jobs of the time-critical lane while
+ * all the workers are busy, and is parked in between.
+ *
+ * @param[in] pUserContext The user context.
+ *
+ */
+static void _taskPoolSpareWorker( void * pUserContext );
+
+/**
+ * Takes the next job to execute, from the time-critical lane first, and marks it as executing.
+ *
+ * @param[in] pTaskPool The task pool to take the job from.
+ * @param[in] timeCriticalOnly Whether to leave the jobs of the normal lane queued.
+ * @param[out] pLane The lane the job was queued in.
+ * @param[out] pQueueWaitMs How long the job waited in its lane.
+ *
+ * @return The job, or `NULL` if there is no job to take.
+ */
+static _taskPoolJob_t * _dispatchJob( _taskPool_t * const pTaskPool,
+                                      bool timeCriticalOnly,
+                                      IotTaskPoolLane_t * const pLane,
+                                      uint32_t * const pQueueWaitMs );
+
+/**
+ * Adds the latencies of an executed job to the statistics of its lane.
+ *
+ * @param[in] pTaskPool The task pool that executed the job.
+ * @param[in] lane The lane the job was queued in.
+ * @param[in] queueWaitMs How long the job waited in its lane.
+ * @param[in] runTimeMs How long the job callback ran.
+ */
+static void _recordJobLatency( _taskPool_t * const pTaskPool,
+                               IotTaskPoolLane_t lane,
+                               uint32_t queueWaitMs,
+                               uint32_t runTimeMs );
+
 /* -------------- Convenience functions to handle timer events  -------------- */
 
 /**
- * Comparer for the time list.
+ * Places a deferred job in the timer wheel, in the slot of its expiration tick.
  *
- * param[in] pTimerEventLink1 The link to the first timer event.
- * param[in] pTimerEventLink1 The link to the first timer event.
+ * param[in] pTaskPool The task pool to defer the job with.
+ * param[in] pJob The job to place, with its expiration tick set.
  */
-static int32_t _timerEventCompare( const IotLink_t * const pTimerEventLink1,
-                                   const IotLink_t * const pTimerEventLink2 );
+static void _timerWheelInsert( _taskPool_t * const pTaskPool,
+                               _taskPoolJob_t * const pJob );
 
 /**
- * Reschedules the timer for handling deferred jobs to the next timeout.
+ * Takes a deferred job out of the timer wheel.
  *
- * param[in] pTimer The timer to reschedule.
- * param[in] pFirstTimerEvent The timer event that carries the timeout and job information.
+ * param[in] pTaskPool The task pool the job was deferred with.
+ * param[in] pJob The job to take out.
  */
-static void _rescheduleDeferredJobsTimer( IotTimer_t * const pTimer,
-                                          _taskPoolTimerEvent_t * const pFirstTimerEvent );
+static void _timerWheelRemove( _taskPool_t * const pTaskPool,
+                               _taskPoolJob_t * const pJob );
+
+/**
+ * Empties a slot of the timer wheel, moving its jobs to the expired list when they are due
+ * or to a lower level of the wheel otherwise.
+ *
+ * param[in] pTaskPool The task pool that owns the timer wheel.
+ * param[in] level The level of the slot.
+ * param[in] slot The slot to empty.
+ * param[out] pExpiredJobs The list to append the jobs that are due to.
+ */
+static void _timerWheelCascade( _taskPool_t * const pTaskPool,
+                                uint32_t level,
+                                uint32_t slot,
+                                IotListDouble_t * const pExpiredJobs );
+
+/**
+ * Advances the timer wheel to the current tick and collects all the jobs that expired.
+ *
+ * param[in] pTaskPool The task pool that owns the timer wheel.
+ * param[in] nowTick The current tick.
+ * param[out] pExpiredJobs The list to append the jobs that are due to, in the order they expired.
+ */
+static void _timerWheelAdvance( _taskPool_t * const pTaskPool,
+                                uint32_t nowTick,
+                                IotListDouble_t * const pExpiredJobs );
+
+/**
+ * Finds the next tick the timer wheel has a slot to process at.
+ *
+ * param[in] pTaskPool The task pool that owns the timer wheel.
+ * param[out] pTick The next tick to process.
+ *
+ * @return `false` if no job is deferred.
+ */
+static bool _timerWheelNextTick( const _taskPool_t * const pTaskPool,
+                                 uint32_t * const pTick );
+
+/**
+ * Reschedules the timer for handling deferred jobs to the given tick.
+ *
+ * param[in] pTaskPool The task pool that owns the timer.
+ * param[in] tick The tick the timer should fire at.
+ */
+static void _rescheduleDeferredJobsTimer( _taskPool_t * const pTaskPool,
+                                          uint32_t tick );
 
 /**
  * The task pool timer procedure for scheduling deferred jobs.
@@ -227,16 +314,6 @@ static IotTaskPoolError_t _scheduleInternal( _taskPool_t * const pTaskPool,
                                              _taskPoolJob_t * const pJob,
                                              uint32_t flags );
 
-/**
- * Matches a deferred job in the timer queue with its timer event wrapper.
- *
- * @param[in] pLink A pointer to the timer event link in the timer queue.
- * @param[in] pMatch A pointer to the job to match.
- *
- */
-static bool _matchJobByPointer( const IotLink_t * const pLink,
-                                void * pMatch );
-
 /**
  * Tries to cancel a job.
  *
@@ -340,7 +417,7 @@ IotTaskPoolError_t IotTaskPool_Destroy( IotTaskPool_t taskPoolHandle )
     _taskPool_t * pTaskPool = ( _taskPool_t * ) taskPoolHandle;
 
     /* Track how many threads the task pool owns. */
-    uint32_t activeThreads;
+    uint32_t activeThreads, retiringThreads, spareThreads;
 
     /* Parameter checking. */
     TASKPOOL_ON_NULL_ARG_GOTO_CLEANUP( pTaskPool );
@@ -355,68 +432,73 @@ IotTaskPoolError_t IotTaskPool_Destroy( IotTaskPool_t taskPoolHandle )
         /* Record how many active threads in the task pool. */
         activeThreads = pTaskPool->activeThreads;
 
+        /* Threads that exceeded the quota no longer count as active, but they still
+         * run their last jobs and then signal their exit. */
+        retiringThreads = pTaskPool->retiringThreads;
+
+        /* Spare workers are parked on a signal of their own. */
+        spareThreads = pTaskPool->spareThreads;
+
         /* Destroying a Task pool happens in six (6) stages: First, (1) we clear the job queue and (2) the timer queue.
          * Then (3) we clear the jobs cache. We will then (4) wait for all worker threads to signal exit,
          * before (5) setting the exit condition and wake up all active worker threads. Finally (6) destroying
          * all task pool data structures and release the associated memory.
          */
 
-        /* (1) Clear the job queue. */
-        do
+        /* (1) Clear the job queues. */
+        for( count = 0; count < IOT_TASKPOOL_LANES; ++count )
         {
-            pItemLink = NULL;
+            do
+            {
+                pItemLink = NULL;
 
-            pItemLink = IotDeQueue_DequeueHead( &pTaskPool->dispatchQueue );
+                pItemLink = IotDeQueue_DequeueHead( &pTaskPool->dispatchQueue[ count ] );
 
-            if( pItemLink != NULL )
-            {
-                _taskPoolJob_t * pJob = IotLink_Container( _taskPoolJob_t, pItemLink, link );
+                if( pItemLink != NULL )
+                {
+                    _taskPoolJob_t * pJob = IotLink_Container( _taskPoolJob_t, pItemLink, link );
 
-                _destroyJob( pJob );
-            }
-        } while( pItemLink );
+                    _destroyJob( pJob );
+                }
+            } while( pItemLink );
+        }
 
-        /* (2) Clear the timer queue. */
+        /* (2) Clear the timer wheel. */
         {
-            _taskPoolTimerEvent_t * pTimerEvent;
+            uint32_t level, slot;
 
             /* A deferred job may have fired already. Since deferred jobs will go through the same mutex
              * the shutdown sequence is holding at this stage, there is no risk for race conditions. Yet, we
              * need to let the deferred job to destroy the task pool. */
-
-            pItemLink = IotListDouble_PeekHead( &pTaskPool->timerEventsList );
-
-            if( pItemLink != NULL )
+            if( ( pTaskPool->timerArmed == true ) &&
+                ( ( int32_t ) ( pTaskPool->timerArmedTick - TASKPOOL_TIMER_TICK( IotClock_GetTimeMs() ) ) <= 0 ) )
             {
-                uint64_t now = IotClock_GetTimeMs();
-
-                pTimerEvent = IotLink_Container( _taskPoolTimerEvent_t, pItemLink, link );
-
-                if( pTimerEvent->expirationTime <= now )
-                {
-                    IotLogDebug( "Shutdown will be deferred to the timer thread" );
+                IotLogDebug( "Shutdown will be deferred to the timer thread" );
 
-                    /* Timer may have fired already! Let the timer thread destroy
-                     * complete the taskpool destruction sequence. */
-                    completeShutdown = false;
-                }
+                /* Timer may have fired already! Let the timer thread destroy
+                 * complete the taskpool destruction sequence. */
+                completeShutdown = false;
+            }
 
-                /* Remove all timers from the timeout list. */
-                for( ; ; )
+            /* Remove all deferred jobs from the timer wheel. */
+            for( level = 0; level < TASKPOOL_TIMER_WHEEL_LEVELS; ++level )
+            {
+                for( slot = 0; slot < TASKPOOL_TIMER_WHEEL_SLOTS; ++slot )
                 {
-                    pItemLink = IotListDouble_RemoveHead( &pTaskPool->timerEventsList );
-
-                    if( pItemLink == NULL )
+                    for( ; ; )
                     {
-                        break;
-                    }
-
-                    pTimerEvent = IotLink_Container( _taskPoolTimerEvent_t, pItemLink, link );
+                        pItemLink = IotListDouble_RemoveHead( &pTaskPool->timerWheel[ level ][ slot ] );
 
-                    _destroyJob( pTimerEvent->pJob );
+                        if( pItemLink == NULL )
+                        {
+                            break;
+                        }
 
-                    IotTaskPool_FreeTimerEvent( pTimerEvent );
+                        _destroyJob( IotLink_Container( _taskPoolJob_t, pItemLink, link ) );
+                    }
                 }
+
+                pTaskPool->timerWheelSlotsInUse[ level ] = 0;
             }
         }
 
@@ -437,11 +519,16 @@ IotTaskPoolError_t IotTaskPool_Destroy( IotTaskPool_t taskPoolHandle )
 
         /* (4) Set the exit condition. */
         _signalShutdown( pTaskPool, activeThreads );
+
+        for( count = 0; count < spareThreads; ++count )
+        {
+            IotSemaphore_Post( &pTaskPool->spareSignal );
+        }
     }
     TASKPOOL_EXIT_CRITICAL();
 
     /* (5) Wait for all active threads to reach the end of their life-span. */
-    for( count = 0; count < activeThreads; ++count )
+    for( count = 0; count < activeThreads + retiringThreads + spareThreads; ++count )
     {
         IotSemaphore_Wait( &pTaskPool->startStopSignal );
     }
@@ -698,7 +785,7 @@ IotTaskPoolError_t IotTaskPool_Schedule( IotTaskPool_t taskPoolHandle,
     /* Parameter checking. */
     TASKPOOL_ON_NULL_ARG_GOTO_CLEANUP( taskPoolHandle );
     TASKPOOL_ON_NULL_ARG_GOTO_CLEANUP( pJob );
-    TASKPOOL_ON_ARG_ERROR_GOTO_CLEANUP( ( flags != 0UL ) && ( flags != IOT_TASKPOOL_JOB_HIGH_PRIORITY ) );
+    TASKPOOL_ON_ARG_ERROR_GOTO_CLEANUP( ( flags & ~( IOT_TASKPOOL_JOB_HIGH_PRIORITY | IOT_TASKPOOL_JOB_TIME_CRITICAL ) ) != 0UL );
 
     pTaskPool = ( _taskPool_t * ) taskPoolHandle;
 
@@ -730,6 +817,16 @@ IotTaskPoolError_t IotTaskPool_Schedule( IotTaskPool_t taskPoolHandle,
 IotTaskPoolError_t IotTaskPool_ScheduleDeferred( IotTaskPool_t taskPoolHandle,
                                                  IotTaskPoolJob_t pJob,
                                                  uint32_t timeMs )
+{
+    return IotTaskPool_ScheduleDeferredWithFlags( taskPoolHandle, pJob, timeMs, 0 );
+}
+
+/*-----------------------------------------------------------*/
+
+IotTaskPoolError_t IotTaskPool_ScheduleDeferredWithFlags( IotTaskPool_t taskPoolHandle,
+                                                          IotTaskPoolJob_t pJob,
+                                                          uint32_t timeMs,
+                                                          uint32_t flags )
 {
     TASKPOOL_FUNCTION_ENTRY( IOT_TASKPOOL_SUCCESS );
     _taskPool_t * pTaskPool = NULL;
@@ -737,12 +834,13 @@ IotTaskPoolError_t IotTaskPool_ScheduleDeferred( IotTaskPool_t taskPoolHandle,
     /* Parameter checking. */
     TASKPOOL_ON_NULL_ARG_GOTO_CLEANUP( taskPoolHandle );
     TASKPOOL_ON_NULL_ARG_GOTO_CLEANUP( pJob );
+    TASKPOOL_ON_ARG_ERROR_GOTO_CLEANUP( ( flags & ~IOT_TASKPOOL_JOB_TIME_CRITICAL ) != 0UL );
 
     pTaskPool = ( _taskPool_t * ) taskPoolHandle;
 
     if( timeMs == 0UL )
     {
-        TASKPOOL_SET_AND_GOTO_CLEANUP( IotTaskPool_Schedule( pTaskPool, pJob, 0 ) );
+        TASKPOOL_SET_AND_GOTO_CLEANUP( IotTaskPool_Schedule( pTaskPool, pJob, flags ) );
     }
 	
     TASKPOOL_ENTER_CRITICAL();
@@ -758,45 +856,34 @@ IotTaskPoolError_t IotTaskPool_ScheduleDeferred( IotTaskPool_t taskPoolHandle,
         /* If all safety checks completed, proceed. */
         if( TASKPOOL_SUCCEEDED( _trySafeExtraction( pTaskPool, pJob, false ) ) )
         {
-            IotLink_t * pTimerEventLink;
-            uint64_t now;
+            _taskPoolJob_t * pDeferredJob = ( _taskPoolJob_t * ) pJob;
 
-            _taskPoolTimerEvent_t * pTimerEvent = ( _taskPoolTimerEvent_t * ) IotTaskPool_MallocTimerEvent( sizeof( _taskPoolTimerEvent_t ) );
+            /* Round the expiration up to the next tick, a job never runs early. */
+            pDeferredJob->expirationTick = ( uint32_t ) ( ( IotClock_GetTimeMs() + timeMs + IOT_TASKPOOL_TIMER_TICK_MS - 1UL ) /
+                                                          IOT_TASKPOOL_TIMER_TICK_MS );
 
-            if( pTimerEvent == NULL )
+            /* Remember the lane to queue the job in when it expires. */
+            if( ( flags & IOT_TASKPOOL_JOB_TIME_CRITICAL ) != 0UL )
             {
-                TASKPOOL_EXIT_CRITICAL();
-
-                TASKPOOL_SET_AND_GOTO_CLEANUP( IOT_TASKPOOL_NO_MEMORY );
+                pDeferredJob->flags |= IOT_TASK_POOL_INTERNAL_TIME_CRITICAL;
+            }
+            else
+            {
+                pDeferredJob->flags &= ~IOT_TASK_POOL_INTERNAL_TIME_CRITICAL;
             }
 
-            memset( pTimerEvent, 0x00, sizeof( _taskPoolTimerEvent_t ) );
-
-            now = IotClock_GetTimeMs();
-
-            pTimerEvent->link.pNext = NULL;
-            pTimerEvent->link.pPrevious = NULL;
-            pTimerEvent->expirationTime = now + timeMs;
-            pTimerEvent->pJob = ( _taskPoolJob_t * ) pJob;
-
-            /* Append the timer event to the timer list. */
-            IotListDouble_InsertSorted( &pTaskPool->timerEventsList, &pTimerEvent->link, _timerEventCompare );
+            /* Place the job in the timer wheel. */
+            _timerWheelInsert( pTaskPool, pDeferredJob );
 
             /* Update the job status to 'scheduled'. */
             pJob->status = IOT_TASKPOOL_STATUS_DEFERRED;
 
-            /* Peek the first event in the timer event list. There must be at least one,
-             * since we just inserted it. */
-            pTimerEventLink = IotListDouble_PeekHead( &pTaskPool->timerEventsList );
-            IotTaskPool_Assert( pTimerEventLink != NULL );
-
-            /* If the event we inserted is at the front of the queue, then
-             * we need to reschedule the underlying timer. */
-            if( pTimerEventLink == &pTimerEvent->link )
+            /* If the job expires before the timer fires, then we need to reschedule
+             * the underlying timer. */
+            if( ( pTaskPool->timerArmed == false ) ||
+                ( ( int32_t ) ( pDeferredJob->expirationTick - pTaskPool->timerArmedTick ) < 0 ) )
             {
-                pTimerEvent = IotLink_Container( _taskPoolTimerEvent_t, pTimerEventLink, link );
-
-                _rescheduleDeferredJobsTimer( &pTaskPool->timer, pTimerEvent );
+                _rescheduleDeferredJobsTimer( pTaskPool, pDeferredJob->expirationTick );
             }
         }
         else
@@ -848,6 +935,37 @@ IotTaskPoolError_t IotTaskPool_GetStatus( IotTaskPool_t taskPoolHandle,
 
 /*-----------------------------------------------------------*/
 
+IotTaskPoolError_t IotTaskPool_GetStats( IotTaskPool_t taskPoolHandle,
+                                         IotTaskPoolStats_t * const pStats )
+{
+    TASKPOOL_FUNCTION_ENTRY( IOT_TASKPOOL_SUCCESS );
+    _taskPool_t * pTaskPool = NULL;
+
+    /* Parameter checking. */
+    TASKPOOL_ON_NULL_ARG_GOTO_CLEANUP( taskPoolHandle );
+    TASKPOOL_ON_NULL_ARG_GOTO_CLEANUP( pStats );
+
+    pTaskPool = ( _taskPool_t * ) taskPoolHandle;
+
+    TASKPOOL_ENTER_CRITICAL();
+    {
+        /* Bail out early if this task pool is shutting down. */
+        if( _IsShutdownStarted( pTaskPool ) )
+        {
+            TASKPOOL_EXIT_CRITICAL();
+
+            TASKPOOL_SET_AND_GOTO_CLEANUP( IOT_TASKPOOL_SHUTDOWN_IN_PROGRESS );
+        }
+
+        *pStats = pTaskPool->stats;
+    }
+    TASKPOOL_EXIT_CRITICAL();
+
+    TASKPOOL_NO_FUNCTION_CLEANUP();
+}
+
+/*-----------------------------------------------------------*/
+
 IotTaskPoolError_t IotTaskPool_TryCancel( IotTaskPool_t taskPoolHandle,
                                           IotTaskPoolJob_t pJob,
                                           IotTaskPoolJobStatus_t * const pStatus )
@@ -961,16 +1079,28 @@ static IotTaskPoolError_t _initTaskPoolControlStructures( const IotTaskPoolInfo_
     bool semStartStopInit = false;
     bool lockInit = false;
     bool semDispatchInit = false;
+    bool semSpareInit = false;
     bool timerInit = false;
+    uint32_t count, slot;
 
     /* Zero out all data structures. */
-    memset( ( void * ) pTaskPool, 0x00, sizeof( IotTaskPool_t ) );
+    memset( ( void * ) pTaskPool, 0x00, sizeof( _taskPool_t ) );
 
     /* Initialize a job data structures that require no de-initialization.
      * All other data structures carry a value of 'NULL' before initialization.
      */
-    IotDeQueue_Create( &pTaskPool->dispatchQueue );
-    IotListDouble_Create( &pTaskPool->timerEventsList );
+    IotDeQueue_Create( &pTaskPool->dispatchQueue[ IOT_TASKPOOL_LANE_TIME_CRITICAL ] );
+    IotDeQueue_Create( &pTaskPool->dispatchQueue[ IOT_TASKPOOL_LANE_NORMAL ] );
+
+    for( count = 0; count < TASKPOOL_TIMER_WHEEL_LEVELS; ++count )
+    {
+        for( slot = 0; slot < TASKPOOL_TIMER_WHEEL_SLOTS; ++slot )
+        {
+            IotListDouble_Create( &pTaskPool->timerWheel[ count ][ slot ] );
+        }
+    }
+
+    pTaskPool->timerWheelTick = TASKPOOL_TIMER_TICK( IotClock_GetTimeMs() );
 
     pTaskPool->minThreads = pInfo->minThreads;
     pTaskPool->maxThreads = pInfo->maxThreads;
@@ -993,10 +1123,20 @@ static IotTaskPoolError_t _initTaskPoolControlStructures( const IotTaskPoolInfo_
             {
                 semDispatchInit = true;
 
-                /* Create the timer mutex for a new connection. */
-                if( IotClock_TimerCreate( &( pTaskPool->timer ), _timerThread, pTaskPool ) == true )
+                /* Initialize the semaphore the spare workers are parked on. */
+                if( IotSemaphore_Create( &pTaskPool->spareSignal, 0, TASKPOOL_MAX_SEM_VALUE ) == true )
                 {
-                    timerInit = true;
+                    semSpareInit = true;
+
+                    /* Create the timer mutex for a new connection. */
+                    if( IotClock_TimerCreate( &( pTaskPool->timer ), _timerThread, pTaskPool ) == true )
+                    {
+                        timerInit = true;
+                    }
+                    else
+                    {
+                        TASKPOOL_SET_AND_GOTO_CLEANUP( IOT_TASKPOOL_NO_MEMORY );
+                    }
                 }
                 else
                 {
@@ -1037,6 +1177,11 @@ static IotTaskPoolError_t _initTaskPoolControlStructures( const IotTaskPoolInfo_
             IotSemaphore_Destroy( &pTaskPool->dispatchSignal );
         }
 
+        if( semSpareInit == true )
+        {
+            IotSemaphore_Destroy( &pTaskPool->spareSignal );
+        }
+
         if( timerInit == true )
         {
             IotClock_TimerDestroy( &pTaskPool->timer );
@@ -1140,6 +1285,7 @@ static void _destroyTaskPool( _taskPool_t * const pTaskPool )
 {
     IotClock_TimerDestroy( &pTaskPool->timer );
     IotSemaphore_Destroy( &pTaskPool->dispatchSignal );
+    IotSemaphore_Destroy( &pTaskPool->spareSignal );
     IotSemaphore_Destroy( &pTaskPool->startStopSignal );
     IotMutex_Destroy( &pTaskPool->lock );
 }
@@ -1151,6 +1297,9 @@ static void _taskPoolWorker( void * pUserContext )
     IotTaskPool_Assert( pUserContext != NULL );
 
     IotTaskPoolRoutine_t userCallback = NULL;
+    IotTaskPoolLane_t lane = IOT_TASKPOOL_LANE_NORMAL;
+    uint32_t queueWaitMs = 0, runTimeMs = 0;
+    uint64_t startTime = 0;
     bool running = true;
 
     /* Extract pTaskPool pointer from context. */
@@ -1166,7 +1315,7 @@ static void _taskPoolWorker( void * pUserContext )
     do
     {
         bool jobAvailable;
-        IotLink_t * pFirst;
+        bool shutdown = false;
         _taskPoolJob_t * pJob = NULL;
 
         /* Wait on incoming notifications. If waiting on the semaphore return with timeout, then
@@ -1231,18 +1380,19 @@ static void _taskPoolWorker( void * pUserContext )
             /* Only look for a job if waiting did not timed out. */
             if( jobAvailable == true )
             {
-                /* Dequeue the first job in FIFO order. */
-                pFirst = IotDeQueue_DequeueHead( &pTaskPool->dispatchQueue );
+                /* Dequeue the first job, time-critical lane first. If there is indeed a job,
+                 * release the lock before processing the job. */
+                pJob = _dispatchJob( pTaskPool, false, &lane, &queueWaitMs );
 
-                /* If there is indeed a job, then update status under lock, and release the lock before processing the job. */
-                if( pFirst != NULL )
+                if( pJob != NULL )
                 {
-                    /* Extract the job from its link. */
-                    pJob = IotLink_Container( _taskPoolJob_t, pFirst, link );
-
-                    /* Update status to 'executing'. */
-                    pJob->status = IOT_TASKPOOL_STATUS_COMPLETED;
                     userCallback = pJob->userCallback;
+
+                    /* A thread leaving because of the quota is waited for on shutdown until its last job is done. */
+                    if( running == false )
+                    {
+                        pTaskPool->retiringThreads++;
+                    }
                 }
             }
         }
@@ -1258,18 +1408,15 @@ static void _taskPoolWorker( void * pUserContext )
                 IotTaskPool_Assert( IotLink_IsLinked( &pJob->link ) == false );
                 IotTaskPool_Assert( userCallback != NULL );
 
+                startTime = IotClock_GetTimeMs();
+
                 userCallback( pTaskPool, pJob, pJob->pUserContext );
 
-                /* This job is finished, clear its pointer. */
+                runTimeMs = ( uint32_t ) ( IotClock_GetTimeMs() - startTime );
+
+                /* This job is finished, clear its pointer. The callback may have recycled or rescheduled it already. */
                 pJob = NULL;
                 userCallback = NULL;
-
-                /* If this thread exceeded the quota, then let it terminate. */
-                if( running == false )
-                {
-                    /* Abandon the INNER LOOP. Execution will transfer back to the OUTER LOOP condition. */
-                    break;
-                }
             }
 
             /* Acquire the lock before updating the job status. */
@@ -1278,14 +1425,38 @@ static void _taskPoolWorker( void * pUserContext )
                 /* Update the number of busy threads, so new requests can be served by creating new threads, up to maxThreads. */
                 pTaskPool->activeJobs--;
 
-                /* Try and dequeue the next job in the dispatch queue. */
-                IotLink_t * pItem = NULL;
+                _recordJobLatency( pTaskPool, lane, queueWaitMs, runTimeMs );
+
+                if( lane == IOT_TASKPOOL_LANE_TIME_CRITICAL )
+                {
+                    pTaskPool->timeCriticalJobs--;
+                }
+
+                /* Dequeue the next job, time-critical lane first. A thread that exceeded the quota
+                 * for a high priority job only serves the time-critical lane before terminating. */
+                pJob = _dispatchJob( pTaskPool, ( running == false ), &lane, &queueWaitMs );
+
+                /* If this thread exceeded the quota and has no job left, then let it terminate. */
+                if( ( running == false ) && ( pJob == NULL ) )
+                {
+                    pTaskPool->retiringThreads--;
+
+                    /* The task pool may be waiting for this thread to exit. */
+                    shutdown = _IsShutdownStarted( pTaskPool );
 
-                /* Dequeue the next job from the dispatch queue. */
-                pItem = IotDeQueue_DequeueHead( &pTaskPool->dispatchQueue );
+                    TASKPOOL_EXIT_CRITICAL();
 
-                /* If there is no job left in the dispatch queue, update the worker status and leave. */
-                if( pItem == NULL )
+                    if( shutdown == true )
+                    {
+                        IotSemaphore_Post( &pTaskPool->startStopSignal );
+                    }
+
+                    /* Abandon the INNER LOOP. Execution will transfer back to the OUTER LOOP condition. */
+                    break;
+                }
+
+                /* If there is no job left in the dispatch queues, update the worker status and leave. */
+                if( pJob == NULL )
                 {
                     TASKPOOL_EXIT_CRITICAL();
 
@@ -1294,18 +1465,169 @@ static void _taskPoolWorker( void * pUserContext )
                 }
                 else
                 {
-                    pJob = IotLink_Container( _taskPoolJob_t, pItem, link );
-
                     userCallback = pJob->userCallback;
                 }
-
-                pJob->status = IOT_TASKPOOL_STATUS_COMPLETED;
             }
             TASKPOOL_EXIT_CRITICAL();
         }
     } while( running == true );
 }
 
+/*-----------------------------------------------------------*/
+
+static void _taskPoolSpareWorker( void * pUserContext )
+{
+    IotTaskPool_Assert( pUserContext != NULL );
+
+    IotTaskPoolLane_t lane = IOT_TASKPOOL_LANE_TIME_CRITICAL;
+    uint32_t queueWaitMs = 0, runTimeMs = 0;
+    uint64_t startTime = 0;
+    _taskPoolJob_t * pJob = NULL;
+    IotTaskPoolRoutine_t userCallback = NULL;
+
+    /* Extract pTaskPool pointer from context. */
+    _taskPool_t * pTaskPool = ( _taskPool_t * ) pUserContext;
+
+    /* Signal that this worker completed initialization and it is ready to receive notifications. */
+    IotSemaphore_Post( &pTaskPool->startStopSignal );
+
+    for( ; ; )
+    {
+        /* Stay parked until a time-critical job finds all the workers busy. Spare workers do not
+         * time out, so that the task pool does not create one for each burst of time-critical jobs. */
+        IotSemaphore_Wait( &pTaskPool->spareSignal );
+
+        TASKPOOL_ENTER_CRITICAL();
+
+        if( _IsShutdownStarted( pTaskPool ) )
+        {
+            IotLogDebug( "Spare worker thread exiting because shutdown condition was set." );
+
+            pTaskPool->spareThreads--;
+
+            TASKPOOL_EXIT_CRITICAL();
+
+            /* Signal that this worker is exiting. */
+            IotSemaphore_Post( &pTaskPool->startStopSignal );
+
+            break;
+        }
+
+        /* A worker may have taken the job already; then there is nothing to do. Otherwise, run
+         * the time-critical jobs queued behind it as well, in order, and leave the normal lane
+         * to the workers. */
+        for( ; ; )
+        {
+            pJob = _dispatchJob( pTaskPool, true, &lane, &queueWaitMs );
+
+            if( pJob == NULL )
+            {
+                break;
+            }
+
+            userCallback = pJob->userCallback;
+
+            TASKPOOL_EXIT_CRITICAL();
+
+            IotTaskPool_Assert( IotLink_IsLinked( &pJob->link ) == false );
+            IotTaskPool_Assert( userCallback != NULL );
+
+            startTime = IotClock_GetTimeMs();
+
+            userCallback( pTaskPool, pJob, pJob->pUserContext );
+
+            runTimeMs = ( uint32_t ) ( IotClock_GetTimeMs() - startTime );
+
+            /* The callback may have recycled or rescheduled the job already. */
+            pJob = NULL;
+            userCallback = NULL;
+
+            TASKPOOL_ENTER_CRITICAL();
+
+            pTaskPool->activeJobs--;
+            pTaskPool->timeCriticalJobs--;
+
+            _recordJobLatency( pTaskPool, lane, queueWaitMs, runTimeMs );
+        }
+
+        pTaskPool->busySpares--;
+
+        TASKPOOL_EXIT_CRITICAL();
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static _taskPoolJob_t * _dispatchJob( _taskPool_t * const pTaskPool,
+                                      bool timeCriticalOnly,
+                                      IotTaskPoolLane_t * const pLane,
+                                      uint32_t * const pQueueWaitMs )
+{
+    _taskPoolJob_t * pJob = NULL;
+    IotLink_t * pItem = IotDeQueue_DequeueHead( &pTaskPool->dispatchQueue[ IOT_TASKPOOL_LANE_TIME_CRITICAL ] );
+
+    if( ( pItem == NULL ) && ( timeCriticalOnly == false ) )
+    {
+        pItem = IotDeQueue_DequeueHead( &pTaskPool->dispatchQueue[ IOT_TASKPOOL_LANE_NORMAL ] );
+    }
+
+    if( pItem != NULL )
+    {
+        pJob = IotLink_Container( _taskPoolJob_t, pItem, link );
+
+        /* Update status to 'executing'. */
+        pJob->status = IOT_TASKPOOL_STATUS_COMPLETED;
+
+        /* The job fields cannot be trusted once the callback returns, read them now. */
+        *pLane = ( ( pJob->flags & IOT_TASK_POOL_INTERNAL_TIME_CRITICAL ) != 0UL ) ?
+                 IOT_TASKPOOL_LANE_TIME_CRITICAL : IOT_TASKPOOL_LANE_NORMAL;
+        *pQueueWaitMs = ( uint32_t ) IotClock_GetTimeMs() - pJob->readyTimeMs;
+
+        if( *pLane == IOT_TASKPOOL_LANE_TIME_CRITICAL )
+        {
+            pTaskPool->timeCriticalJobs++;
+        }
+    }
+
+    return pJob;
+}
+
+/*-----------------------------------------------------------*/
+
+static void _recordJobLatency( _taskPool_t * const pTaskPool,
+                               IotTaskPoolLane_t lane,
+                               uint32_t queueWaitMs,
+                               uint32_t runTimeMs )
+{
+    IotTaskPoolLaneStats_t * pStats = &pTaskPool->stats.lanes[ lane ];
+    uint32_t waitBucket = 0, runBucket = 0, timeMs = 0;
+
+    /* Bucket n counts the times with n significant bits. */
+    for( timeMs = queueWaitMs; ( timeMs != 0UL ) && ( waitBucket < IOT_TASKPOOL_HISTOGRAM_BUCKETS - 1 ); timeMs >>= 1 )
+    {
+        waitBucket++;
+    }
+
+    for( timeMs = runTimeMs; ( timeMs != 0UL ) && ( runBucket < IOT_TASKPOOL_HISTOGRAM_BUCKETS - 1 ); timeMs >>= 1 )
+    {
+        runBucket++;
+    }
+
+    pStats->jobs++;
+    pStats->queueWaitMs[ waitBucket ]++;
+    pStats->runTimeMs[ runBucket ]++;
+
+    if( queueWaitMs > pStats->maxQueueWaitMs )
+    {
+        pStats->maxQueueWaitMs = queueWaitMs;
+    }
+
+    if( runTimeMs > pStats->maxRunTimeMs )
+    {
+        pStats->maxRunTimeMs = runTimeMs;
+    }
+}
+
 /* ---------------------------------------------------------------------------------------------- */
 
 static void _initJobsCache( _taskPoolCache_t * const pCache )
@@ -1458,6 +1780,14 @@ static IotTaskPoolError_t _scheduleInternal( _taskPool_t * const pTaskPool,
 
     bool mustGrow = false;
     bool shouldGrow = false;
+    bool spareWake = false;
+    IotTaskPoolLane_t lane = IOT_TASKPOOL_LANE_NORMAL;
+
+    /* High priority jobs also skip the jobs of the normal lane. */
+    if( ( flags & ( IOT_TASKPOOL_JOB_HIGH_PRIORITY | IOT_TASKPOOL_JOB_TIME_CRITICAL ) ) != 0UL )
+    {
+        lane = IOT_TASKPOOL_LANE_TIME_CRITICAL;
+    }
 
     /* Update the job status to 'scheduled'. */
     pJob->status = IOT_TASKPOOL_STATUS_SCHEDULED;
@@ -1486,11 +1816,53 @@ static IotTaskPoolError_t _scheduleInternal( _taskPool_t * const pTaskPool,
         {
             shouldGrow = true;
         }
+
+        /* A time-critical job wakes up a spare worker if all the workers are busy with jobs of the
+         * normal lane, so that it does not wait behind a slow callback. Otherwise, it only waits for
+         * the time-critical jobs ahead of it, which are short. */
+        else if( ( lane == IOT_TASKPOOL_LANE_TIME_CRITICAL ) &&
+                 ( activeThreads < pTaskPool->activeJobs ) &&
+                 ( pTaskPool->timeCriticalJobs == 0UL ) &&
+                 ( IotDeQueue_IsEmpty( &pTaskPool->dispatchQueue[ IOT_TASKPOOL_LANE_TIME_CRITICAL ] ) == true ) &&
+                 ( pTaskPool->busySpares < IOT_TASKPOOL_SPARE_WORKERS ) )
+        {
+            spareWake = true;
+        }
         else
         {
             /* Nothing to do. */
         }
 
+        /* A spare worker is only created if none is parked, and then kept. */
+        if( ( spareWake == true ) && ( pTaskPool->busySpares == pTaskPool->spareThreads ) )
+        {
+            IotLogInfo( "Growing a Task pool with a spare worker thread..." );
+
+            if( Iot_CreateDetachedThread( _taskPoolSpareWorker,
+                                          pTaskPool,
+                                          pTaskPool->priority,
+                                          pTaskPool->stackSize ) )
+            {
+                IotSemaphore_Wait( &pTaskPool->startStopSignal );
+
+                pTaskPool->spareThreads++;
+                pTaskPool->stats.spareWorkers++;
+            }
+            else
+            {
+                /* The job then waits for a worker, at the front of the ready jobs. */
+                IotLogWarn( "Task pool failed to create a spare worker thread." );
+
+                spareWake = false;
+            }
+        }
+
+        if( spareWake == true )
+        {
+            pTaskPool->busySpares++;
+            pTaskPool->stats.spareWakeups++;
+        }
+
         if( ( mustGrow == true ) || ( shouldGrow == true ) )
         {
             IotLogInfo( "Growing a Task pool with a new worker thread..." );
@@ -1522,21 +1894,40 @@ static IotTaskPoolError_t _scheduleInternal( _taskPool_t * const pTaskPool,
 
     if( TASKPOOL_SUCCEEDED( status ) )
     {
-        /* Append the job to the dispatch queue.
+        /* Remember the lane, for the statistics of the job. */
+        if( lane == IOT_TASKPOOL_LANE_TIME_CRITICAL )
+        {
+            pJob->flags |= IOT_TASK_POOL_INTERNAL_TIME_CRITICAL;
+        }
+        else
+        {
+            pJob->flags &= ~IOT_TASK_POOL_INTERNAL_TIME_CRITICAL;
+        }
+
+        pJob->readyTimeMs = ( uint32_t ) IotClock_GetTimeMs();
+
+        /* Append the job to the dispatch queue of its lane.
          * Put the job at the front, if it is a high priority job. */
         if( mustGrow == true )
         {
             IotLogDebug( "High priority job: placing job at the head of the queue." );
 
-            IotDeQueue_EnqueueHead( &pTaskPool->dispatchQueue, &pJob->link );
+            IotDeQueue_EnqueueHead( &pTaskPool->dispatchQueue[ lane ], &pJob->link );
         }
         else
         {
-            IotDeQueue_EnqueueTail( &pTaskPool->dispatchQueue, &pJob->link );
+            IotDeQueue_EnqueueTail( &pTaskPool->dispatchQueue[ lane ], &pJob->link );
         }
 
-        /* Signal a worker to pick up the job. */
-        IotSemaphore_Post( &pTaskPool->dispatchSignal );
+        /* Signal a worker, or the spare worker, to pick up the job. */
+        if( spareWake == true )
+        {
+            IotSemaphore_Post( &pTaskPool->spareSignal );
+        }
+        else
+        {
+            IotSemaphore_Post( &pTaskPool->dispatchSignal );
+        }
     }
     else
     {
@@ -1553,23 +1944,6 @@ static IotTaskPoolError_t _scheduleInternal( _taskPool_t * const pTaskPool,
 
 /*-----------------------------------------------------------*/
 
-static bool _matchJobByPointer( const IotLink_t * const pLink,
-                                void * pMatch )
-{
-    const _taskPoolJob_t * const pJob = ( _taskPoolJob_t * ) pMatch;
-
-    const _taskPoolTimerEvent_t * const pTimerEvent = IotLink_Container( _taskPoolTimerEvent_t, pLink, link );
-
-    if( pJob == pTimerEvent->pJob )
-    {
-        return true;
-    }
-
-    return false;
-}
-
-/*-----------------------------------------------------------*/
-
 static IotTaskPoolError_t _tryCancelInternal( _taskPool_t * const pTaskPool,
                                               _taskPoolJob_t * const pJob,
                                               IotTaskPoolJobStatus_t * const pStatus )
@@ -1628,40 +2002,14 @@ static IotTaskPoolError_t _tryCancelInternal( _taskPool_t * const pTaskPool,
         }
 
         /* If the job current status is 'deferred' then the job has to be pending
-         * in the timeouts queue. */
+         * in the timer wheel. */
         else if( currentStatus == IOT_TASKPOOL_STATUS_DEFERRED )
         {
-            /* Find the timer event associated with the current job. There MUST be one, hence assert if not. */
-            IotLink_t * pTimerEventLink = IotListDouble_FindFirstMatch( &pTaskPool->timerEventsList, NULL, _matchJobByPointer, pJob );
-            IotTaskPool_Assert( pTimerEventLink != NULL );
-
-            if( pTimerEventLink != NULL )
-            {
-                bool shouldReschedule = false;
-
-                /* If the job being canceled was at the head of the timeouts queue, then we need to reschedule the timer
-                 * with the next job timeout */
-                IotLink_t * pHeadLink = IotListDouble_PeekHead( &pTaskPool->timerEventsList );
-
-                if( pHeadLink == pTimerEventLink )
-                {
-                    shouldReschedule = true;
-                }
-
-                /* Remove the timer event associated with the canceled job and free the associated memory. */
-                IotListDouble_Remove( pTimerEventLink );
-                IotTaskPool_FreeTimerEvent( IotLink_Container( _taskPoolTimerEvent_t, pTimerEventLink, link ) );
-
-                if( shouldReschedule )
-                {
-                    IotLink_t * pNextTimerEventLink = IotListDouble_PeekHead( &pTaskPool->timerEventsList );
+            /* A deferred job must be in the timer wheel. The timer is left armed, when it
+             * fires for no job it only advances the wheel. */
+            IotTaskPool_Assert( IotLink_IsLinked( &pJob->link ) );
 
-                    if( pNextTimerEventLink != NULL )
-                    {
-                        _rescheduleDeferredJobsTimer( &pTaskPool->timer, IotLink_Container( _taskPoolTimerEvent_t, pNextTimerEventLink, link ) );
-                    }
-                }
-            }
+            _timerWheelRemove( pTaskPool, pJob );
         }
         else
         {
@@ -1730,42 +2078,216 @@ static IotTaskPoolError_t _trySafeExtraction( _taskPool_t * const pTaskPool,
 
 /*-----------------------------------------------------------*/
 
-static int32_t _timerEventCompare( const IotLink_t * const pTimerEventLink1,
-                                   const IotLink_t * const pTimerEventLink2 )
+static void _timerWheelInsert( _taskPool_t * const pTaskPool,
+                               _taskPoolJob_t * const pJob )
+{
+    uint32_t level = 0;
+    uint32_t slot = 0;
+    uint32_t slotTick = pJob->expirationTick;
+    uint32_t delta = pJob->expirationTick - pTaskPool->timerWheelTick;
+
+    /* The slot of the current tick was processed already, a job that is due goes in the next one. */
+    if( ( delta == 0UL ) || ( delta > ( uint32_t ) INT32_MAX ) )
+    {
+        slotTick = pTaskPool->timerWheelTick + 1UL;
+        delta = 1UL;
+    }
+
+    /* A job beyond the range of the wheel waits in the farthest slot of the last level,
+     * and is placed again when that slot is cascaded. */
+    if( delta >= TASKPOOL_TIMER_WHEEL_RANGE )
+    {
+        slotTick = pTaskPool->timerWheelTick + TASKPOOL_TIMER_WHEEL_RANGE - 1UL;
+        delta = TASKPOOL_TIMER_WHEEL_RANGE - 1UL;
+    }
+
+    /* Each level spans 32 times the ticks of the level below. */
+    while( delta >= ( 1UL << ( TASKPOOL_TIMER_WHEEL_SLOT_BITS * ( level + 1UL ) ) ) )
+    {
+        level++;
+    }
+
+    slot = ( slotTick >> ( TASKPOOL_TIMER_WHEEL_SLOT_BITS * level ) ) & TASKPOOL_TIMER_WHEEL_SLOT_MASK;
+
+    IotListDouble_InsertTail( &pTaskPool->timerWheel[ level ][ slot ], &pJob->link );
+    pTaskPool->timerWheelSlotsInUse[ level ] |= ( 1UL << slot );
+
+    /* Keep the position in the job, so that it can be canceled without searching. */
+    pJob->flags = ( pJob->flags & ~IOT_TASK_POOL_INTERNAL_WHEEL_MASK ) |
+                  ( ( ( level << TASKPOOL_TIMER_WHEEL_SLOT_BITS ) | slot ) << IOT_TASK_POOL_INTERNAL_WHEEL_SHIFT );
+}
+
+/*-----------------------------------------------------------*/
+
+static void _timerWheelRemove( _taskPool_t * const pTaskPool,
+                               _taskPoolJob_t * const pJob )
 {
-    const _taskPoolTimerEvent_t * const pTimerEvent1 = IotLink_Container( _taskPoolTimerEvent_t,
-                                                                          pTimerEventLink1,
-                                                                          link );
-    const _taskPoolTimerEvent_t * const pTimerEvent2 = IotLink_Container( _taskPoolTimerEvent_t,
-                                                                          pTimerEventLink2,
-                                                                          link );
+    uint32_t position = ( pJob->flags & IOT_TASK_POOL_INTERNAL_WHEEL_MASK ) >> IOT_TASK_POOL_INTERNAL_WHEEL_SHIFT;
+    uint32_t level = position >> TASKPOOL_TIMER_WHEEL_SLOT_BITS;
+    uint32_t slot = position & TASKPOOL_TIMER_WHEEL_SLOT_MASK;
+
+    IotListDouble_Remove( &pJob->link );
 
-    if( pTimerEvent1->expirationTime < pTimerEvent2->expirationTime )
+    if( IotListDouble_IsEmpty( &pTaskPool->timerWheel[ level ][ slot ] ) )
     {
-        return -1;
+        pTaskPool->timerWheelSlotsInUse[ level ] &= ~( 1UL << slot );
     }
+}
+
+/*-----------------------------------------------------------*/
 
-    if( pTimerEvent1->expirationTime > pTimerEvent2->expirationTime )
+static void _timerWheelCascade( _taskPool_t * const pTaskPool,
+                                uint32_t level,
+                                uint32_t slot,
+                                IotListDouble_t * const pExpiredJobs )
+{
+    IotLink_t * pLink = NULL;
+    _taskPoolJob_t * pJob = NULL;
+
+    pTaskPool->timerWheelSlotsInUse[ level ] &= ~( 1UL << slot );
+
+    for( ; ; )
     {
-        return 1;
+        pLink = IotListDouble_RemoveHead( &pTaskPool->timerWheel[ level ][ slot ] );
+
+        if( pLink == NULL )
+        {
+            break;
+        }
+
+        pJob = IotLink_Container( _taskPoolJob_t, pLink, link );
+
+        if( ( int32_t ) ( pJob->expirationTick - pTaskPool->timerWheelTick ) <= 0 )
+        {
+            IotListDouble_InsertTail( pExpiredJobs, &pJob->link );
+        }
+        else
+        {
+            /* The job lands in a lower level, or in another slot of the last level
+             * if it is still beyond the range of the wheel. */
+            _timerWheelInsert( pTaskPool, pJob );
+        }
     }
+}
+
+/*-----------------------------------------------------------*/
+
+static void _timerWheelAdvance( _taskPool_t * const pTaskPool,
+                                uint32_t nowTick,
+                                IotListDouble_t * const pExpiredJobs )
+{
+    uint32_t level = 0;
+    uint32_t shift = 0;
+    uint32_t nextTick = 0;
+
+    while( ( int32_t ) ( nowTick - pTaskPool->timerWheelTick ) > 0 )
+    {
+        /* Skip the ticks with nothing to process, up to the next slot of the lowest level in use. */
+        for( level = 0; level < TASKPOOL_TIMER_WHEEL_LEVELS; ++level )
+        {
+            if( pTaskPool->timerWheelSlotsInUse[ level ] != 0UL )
+            {
+                break;
+            }
+        }
+
+        if( level == TASKPOOL_TIMER_WHEEL_LEVELS )
+        {
+            pTaskPool->timerWheelTick = nowTick;
+
+            break;
+        }
+
+        shift = TASKPOOL_TIMER_WHEEL_SLOT_BITS * level;
+        nextTick = ( ( pTaskPool->timerWheelTick >> shift ) + 1UL ) << shift;
+
+        if( ( int32_t ) ( nextTick - nowTick ) > 0 )
+        {
+            pTaskPool->timerWheelTick = nowTick;
+
+            break;
+        }
 
-    return 0;
+        pTaskPool->timerWheelTick = nextTick;
+
+        /* Every time a level wraps around, the jobs of the next slot of the level above move down. */
+        for( level = 1; level < TASKPOOL_TIMER_WHEEL_LEVELS; ++level )
+        {
+            shift = TASKPOOL_TIMER_WHEEL_SLOT_BITS * level;
+
+            if( ( nextTick & ( ( 1UL << shift ) - 1UL ) ) != 0UL )
+            {
+                break;
+            }
+
+            _timerWheelCascade( pTaskPool, level, ( nextTick >> shift ) & TASKPOOL_TIMER_WHEEL_SLOT_MASK, pExpiredJobs );
+        }
+
+        /* All the jobs in the first level slot of the current tick are due. */
+        _timerWheelCascade( pTaskPool, 0, nextTick & TASKPOOL_TIMER_WHEEL_SLOT_MASK, pExpiredJobs );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static bool _timerWheelNextTick( const _taskPool_t * const pTaskPool,
+                                 uint32_t * const pTick )
+{
+    bool found = false;
+    uint32_t level = 0;
+    uint32_t shift = 0;
+    uint32_t slot = 0;
+    uint32_t offset = 0;
+    uint32_t tick = 0;
+
+    /* A slot of the first level is processed at the tick its jobs expire, a slot of the
+     * other levels when it is cascaded, which may come before the jobs of a lower level. */
+    for( level = 0; level < TASKPOOL_TIMER_WHEEL_LEVELS; ++level )
+    {
+        if( pTaskPool->timerWheelSlotsInUse[ level ] == 0UL )
+        {
+            continue;
+        }
+
+        /* Find the first slot in use after the current one, which may be the current one
+         * again a full turn later. */
+        shift = TASKPOOL_TIMER_WHEEL_SLOT_BITS * level;
+        slot = ( pTaskPool->timerWheelTick >> shift ) & TASKPOOL_TIMER_WHEEL_SLOT_MASK;
+        offset = 0;
+
+        do
+        {
+            slot = ( slot + 1UL ) & TASKPOOL_TIMER_WHEEL_SLOT_MASK;
+            offset++;
+        } while( ( pTaskPool->timerWheelSlotsInUse[ level ] & ( 1UL << slot ) ) == 0UL );
+
+        tick = ( ( pTaskPool->timerWheelTick >> shift ) + offset ) << shift;
+
+        if( ( found == false ) ||
+            ( ( int32_t ) ( tick - pTaskPool->timerWheelTick ) < ( int32_t ) ( *pTick - pTaskPool->timerWheelTick ) ) )
+        {
+            *pTick = tick;
+            found = true;
+        }
+    }
+
+    return found;
 }
 
 /*-----------------------------------------------------------*/
 
-static void _rescheduleDeferredJobsTimer( IotTimer_t * const pTimer,
-                                          _taskPoolTimerEvent_t * const pFirstTimerEvent )
+static void _rescheduleDeferredJobsTimer( _taskPool_t * const pTaskPool,
+                                          uint32_t tick )
 {
     uint64_t delta = 0;
     uint64_t now = IotClock_GetTimeMs();
+    uint32_t nowTick = TASKPOOL_TIMER_TICK( now );
 
-    if( pFirstTimerEvent->expirationTime > now )
+    if( ( int32_t ) ( tick - nowTick ) > 0 )
     {
-        delta = pFirstTimerEvent->expirationTime - now;
+        delta = ( uint64_t ) ( tick - nowTick ) * IOT_TASKPOOL_TIMER_TICK_MS - ( now % IOT_TASKPOOL_TIMER_TICK_MS );
     }
-    
+
     if( delta < TASKPOOL_JOB_RESCHEDULE_DELAY_MS )
     {
         delta = TASKPOOL_JOB_RESCHEDULE_DELAY_MS; /* The job will be late... */
@@ -1773,7 +2295,10 @@ static void _rescheduleDeferredJobsTimer( IotTimer_t * const pTimer,
 
     IotTaskPool_Assert( delta > 0 );
 
-    if( IotClock_TimerArm( pTimer, ( uint32_t ) delta, 0 ) == false )
+    pTaskPool->timerArmedTick = tick;
+    pTaskPool->timerArmed = true;
+
+    if( IotClock_TimerArm( &pTaskPool->timer, ( uint32_t ) delta, 0 ) == false )
     {
         IotLogWarn( "Failed to re-arm timer for task pool" );
     }
@@ -1784,13 +2309,16 @@ static void _rescheduleDeferredJobsTimer( IotTimer_t * const pTimer,
 static void _timerThread( void * pArgument )
 {
     _taskPool_t * pTaskPool = ( _taskPool_t * ) pArgument;
-    _taskPoolTimerEvent_t * pTimerEvent = NULL;
+    _taskPoolJob_t * pJob = NULL;
+    IotLink_t * pLink = NULL;
+    IotListDouble_t expiredJobs = IOT_LIST_DOUBLE_INITIALIZER;
+    uint32_t nextTick = 0;
 
     IotLogDebug( "Timer thread started for task pool %p.", pTaskPool );
 
     /* Attempt to lock the timer mutex. Return immediately if the mutex cannot be locked.
      * If this mutex cannot be locked it means that another thread is manipulating the
-     * timeouts list, and will reset the timer to fire again, although it will be late.
+     * timer wheel, and will reset the timer to fire again, although it will be late.
      */
     TASKPOOL_ENTER_CRITICAL();
     {
@@ -1807,52 +2335,42 @@ static void _timerThread( void * pArgument )
             return;
         }
 
-        /* Dispatch all deferred job whose timer expired, then reset the timer for the next
-         * job down the line. */
-        for( ; ; )
-        {
-            /* Peek the first event in the timer event list. */
-            IotLink_t * pLink = IotListDouble_PeekHead( &pTaskPool->timerEventsList );
+        pTaskPool->timerArmed = false;
 
-            /* Check if the timer misfired for any reason.  */
-            if( pLink != NULL )
-            {
-                /* Record the current time. */
-                uint64_t now = IotClock_GetTimeMs();
+        /* Collect all deferred jobs whose timer expired, which may be none if the timer
+         * misfired or the jobs were canceled, and dispatch them in one go. */
+        IotListDouble_Create( &expiredJobs );
 
-                /* Extract the job from its envelope. */
-                pTimerEvent = IotLink_Container( _taskPoolTimerEvent_t, pLink, link );
+        _timerWheelAdvance( pTaskPool, TASKPOOL_TIMER_TICK( IotClock_GetTimeMs() ), &expiredJobs );
 
-                /* Check if the first event should be processed now. */
-                if( pTimerEvent->expirationTime <= now )
-                {
-                    /*  Remove the timer event for immediate processing. */
-                    IotListDouble_Remove( &( pTimerEvent->link ) );
-                }
-                else
-                {
-                    /* The first element in the timer queue shouldn't be processed yet.
-                     * Arm the timer for when it should be processed and leave altogether. */
-                    _rescheduleDeferredJobsTimer( &pTaskPool->timer, pTimerEvent );
+        for( ; ; )
+        {
+            pLink = IotListDouble_RemoveHead( &expiredJobs );
 
-                    break;
-                }
-            }
-            /* If there are no timer events to process, terminate this thread. */
-            else
+            if( pLink == NULL )
             {
-                IotLogDebug( "No further timer events to process. Exiting timer thread." );
-
                 break;
             }
 
-            IotLogDebug( "Scheduling job from timer event." );
+            pJob = IotLink_Container( _taskPoolJob_t, pLink, link );
 
-            /* Queue the job associated with the received timer event. */
-            ( void ) _scheduleInternal( pTaskPool, pTimerEvent->pJob, 0 );
+            IotLogDebug( "Scheduling deferred job %p.", pJob );
 
-            /* Free the timer event. */
-            IotTaskPool_FreeTimerEvent( pTimerEvent );
+            /* Queue the job in the lane it was deferred for. */
+            ( void ) _scheduleInternal( pTaskPool,
+                                        pJob,
+                                        ( ( pJob->flags & IOT_TASK_POOL_INTERNAL_TIME_CRITICAL ) != 0UL ) ?
+                                        IOT_TASKPOOL_JOB_TIME_CRITICAL : 0UL );
+        }
+
+        /* Reset the timer for the next slot down the line. */
+        if( _timerWheelNextTick( pTaskPool, &nextTick ) == true )
+        {
+            _rescheduleDeferredJobsTimer( pTaskPool, nextTick );
+        }
+        else
+        {
+            IotLogDebug( "No further deferred jobs to process." );
         }
     }
     TASKPOOL_EXIT_CRITICAL();
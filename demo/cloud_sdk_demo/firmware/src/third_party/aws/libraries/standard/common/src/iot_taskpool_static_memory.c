@@ -54,14 +54,11 @@
  * Static memory buffers and flags, allocated and zeroed at compile-time.
  */
 static uint32_t _pInUseTaskPools[ IOT_TASKPOOLS ] = { 0U };                                           /**< @brief Task pools in-use flags. */
-static _taskPool_t _pTaskPools[ IOT_TASKPOOLS ] = { { .dispatchQueue = IOT_DEQUEUE_INITIALIZER } };   /**< @brief Task pools. */
+static _taskPool_t _pTaskPools[ IOT_TASKPOOLS ] = { { .dispatchQueue = { IOT_DEQUEUE_INITIALIZER, IOT_DEQUEUE_INITIALIZER } } };   /**< @brief Task pools. */
 
 static uint32_t _pInUseTaskPoolJobs[ IOT_TASKPOOL_JOBS_RECYCLE_LIMIT ] = { 0U };                                /**< @brief Task pool jobs in-use flags. */
 static _taskPoolJob_t _pTaskPoolJobs[ IOT_TASKPOOL_JOBS_RECYCLE_LIMIT ] = { { .link = IOT_LINK_INITIALIZER } }; /**< @brief Task pool jobs. */
 
-static uint32_t _pInUseTaskPoolTimerEvents[ IOT_TASKPOOL_JOBS_RECYCLE_LIMIT ] = { 0U };                         /**< @brief Task pool timer event in-use flags. */
-static _taskPoolTimerEvent_t _pTaskPoolTimerEvents[ IOT_TASKPOOL_JOBS_RECYCLE_LIMIT ] = { { .link = { 0 } } };  /**< @brief Task pool timer events. */
-
 /*-----------------------------------------------------------*/
 
 void * IotTaskPool_MallocTaskPool( size_t size )
@@ -133,39 +130,4 @@ void IotTaskPool_FreeJob( void * ptr )
 
 /*-----------------------------------------------------------*/
 
-void * IotTaskPool_MallocTimerEvent( size_t size )
-{
-    int32_t freeIndex = -1;
-    void * pNewTimerEvent = NULL;
-
-    /* Check size argument. */
-    if( size == sizeof( _taskPoolTimerEvent_t ) )
-    {
-        /* Find a free task pool timer event. */
-        freeIndex = IotStaticMemory_FindFree( _pInUseTaskPoolTimerEvents,
-                                              IOT_TASKPOOL_JOBS_RECYCLE_LIMIT );
-
-        if( freeIndex != -1 )
-        {
-            pNewTimerEvent = &( _pTaskPoolTimerEvents[ freeIndex ] );
-        }
-    }
-
-    return pNewTimerEvent;
-}
-
-/*-----------------------------------------------------------*/
-
-void IotTaskPool_FreeTimerEvent( void * ptr )
-{
-    /* Return the in-use task pool timer event. */
-    IotStaticMemory_ReturnInUse( ptr,
-                                 _pTaskPoolTimerEvents,
-                                 _pInUseTaskPoolTimerEvents,
-                                 IOT_TASKPOOL_JOBS_RECYCLE_LIMIT,
-                                 sizeof( _taskPoolTimerEvent_t ) );
-}
-
-/*-----------------------------------------------------------*/
-
 #endif
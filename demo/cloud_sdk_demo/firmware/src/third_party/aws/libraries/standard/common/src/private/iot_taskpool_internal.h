@@ -167,18 +167,6 @@
  */
     void IotTaskPool_FreeJob( void * ptr );
 
-/**
- * @brief Allocate an #_taskPoolTimerEvent_t. This function should have the
- * same signature as [malloc].
- */
-    void * IotTaskPool_MallocTimerEvent( size_t size );
-
-/**
- * @brief Free an #_taskPoolTimerEvent_t. This function should have the
- * same signature as[ free ].
- */
-    void IotTaskPool_FreeTimerEvent( void * ptr );
-
 #else /* if IOT_STATIC_MEMORY_ONLY == 1 */
     #include <stdlib.h>
 
@@ -213,22 +201,6 @@
             #error "No free function defined for IotTaskPool_FreeJob"
         #endif
     #endif
-
-    #ifndef IotTaskPool_MallocTimerEvent
-        #ifdef Iot_DefaultMalloc
-            #define IotTaskPool_MallocTimerEvent    Iot_DefaultMalloc
-        #else
-            #error "No malloc function defined for IotTaskPool_MallocTimerEvent"
-        #endif
-    #endif
-
-    #ifndef IotTaskPool_FreeTimerEvent
-        #ifdef Iot_DefaultFree
-            #define IotTaskPool_FreeTimerEvent    Iot_DefaultFree
-        #else
-            #error "No free function defined for IotTaskPool_FreeTimerEvent"
-        #endif
-    #endif
 #endif /* if IOT_STATIC_MEMORY_ONLY == 1 */
 
 /* ---------------------------------------------------------------------------------------------- */
@@ -239,7 +211,26 @@
  *
  * A macros to manage task pool memory allocation.
  */
-#define IOT_TASK_POOL_INTERNAL_STATIC    ( ( uint32_t ) 0x00000001 )      /* Flag to mark a job as user-allocated. */
+#define IOT_TASK_POOL_INTERNAL_STATIC           ( ( uint32_t ) 0x00000001 ) /* Flag to mark a job as user-allocated. */
+#define IOT_TASK_POOL_INTERNAL_TIME_CRITICAL    ( ( uint32_t ) 0x00000002 ) /* Flag to mark a job as queued in the time-critical lane. */
+#define IOT_TASK_POOL_INTERNAL_WHEEL_SHIFT      ( 8 )                        /* Position of the timer wheel slot of a deferred job in its flags. */
+#define IOT_TASK_POOL_INTERNAL_WHEEL_MASK       ( ( uint32_t ) 0x0000FF00 )  /* Mask of the timer wheel slot of a deferred job in its flags. */
+/** @endcond */
+
+/**
+ * @cond DOXYGEN_IGNORE
+ * Doxygen should ignore this section.
+ *
+ * Geometry of the timer wheel for deferred jobs. Each level has 32 slots, so
+ * that the slots in use fit a 32 bit mask, and covers 32 times the range of
+ * the level below it. With 4 levels, jobs up to 2^20 ticks away are placed
+ * directly; later ones wait in the last level until they come in range.
+ */
+#define TASKPOOL_TIMER_WHEEL_SLOT_BITS    ( 5 )
+#define TASKPOOL_TIMER_WHEEL_SLOTS        ( 1UL << TASKPOOL_TIMER_WHEEL_SLOT_BITS )
+#define TASKPOOL_TIMER_WHEEL_SLOT_MASK    ( TASKPOOL_TIMER_WHEEL_SLOTS - 1UL )
+#define TASKPOOL_TIMER_WHEEL_LEVELS       ( 4 )
+#define TASKPOOL_TIMER_WHEEL_RANGE        ( 1UL << ( TASKPOOL_TIMER_WHEEL_SLOT_BITS * TASKPOOL_TIMER_WHEEL_LEVELS ) )
 /** @endcond */
 
 /**
@@ -266,19 +257,29 @@ typedef struct _taskPoolCache
  */
 typedef struct _taskPool
 {
-    IotDeQueue_t dispatchQueue;      /**< @brief The queue for the jobs waiting to be executed. */
-    IotListDouble_t timerEventsList; /**< @brief The timeouts queue for all deferred jobs waiting to be executed. */
+    IotDeQueue_t dispatchQueue[ IOT_TASKPOOL_LANES ]; /**< @brief The queues for the jobs waiting to be executed, one per lane. */
+    IotListDouble_t timerWheel[ TASKPOOL_TIMER_WHEEL_LEVELS ][ TASKPOOL_TIMER_WHEEL_SLOTS ]; /**< @brief The deferred jobs waiting to be executed, by expiration tick. */
+    uint32_t timerWheelSlotsInUse[ TASKPOOL_TIMER_WHEEL_LEVELS ];                             /**< @brief One bit per non-empty slot of each level of the timer wheel. */
+    uint32_t timerWheelTick;         /**< @brief The last tick the timer wheel was advanced to, in units of @ref IOT_TASKPOOL_TIMER_TICK_MS. */
+    uint32_t timerArmedTick;         /**< @brief The tick the timer is armed for, when @ref _taskPool_t.timerArmed is set. */
+    bool timerArmed;                 /**< @brief Whether the timer is armed. */
     _taskPoolCache_t jobsCache;      /**< @brief A cache to re-use jobs in order to limit memory allocations. */
     uint32_t minThreads;             /**< @brief The minimum number of threads for the task pool. */
     uint32_t maxThreads;             /**< @brief The maximum number of threads for the task pool. */
     uint32_t activeThreads;          /**< @brief The number of threads in the task pool at any given time. */
+    uint32_t retiringThreads;        /**< @brief The number of threads running their last jobs before exiting, not counted as active. */
+    uint32_t spareThreads;           /**< @brief The number of spare workers, not counted as active. */
+    uint32_t busySpares;             /**< @brief The number of spare workers woken up for the time-critical lane. */
+    uint32_t timeCriticalJobs;       /**< @brief The number of jobs of the time-critical lane being executed. */
     uint32_t activeJobs;             /**< @brief The number of active jobs in the task pool at any given time. */
     uint32_t stackSize;              /**< @brief The stack size for all task pool threads. */
     int32_t priority;                /**< @brief The priority for all task pool threads. */
     IotSemaphore_t dispatchSignal;   /**< @brief The synchronization object on which threads are waiting for incoming jobs. */
     IotSemaphore_t startStopSignal;  /**< @brief The synchronization object for threads to signal start and stop condition. */
+    IotSemaphore_t spareSignal;      /**< @brief The synchronization object on which spare workers are parked. */
     IotTimer_t timer;                /**< @brief The timer for deferred jobs. */
     IotMutex_t lock;                 /**< @brief The lock to protect the task pool data structure access. */
+    IotTaskPoolStats_t stats;        /**< @brief The latency statistics of the jobs. */
 } _taskPool_t;
 
 /**
@@ -295,19 +296,8 @@ typedef struct _taskPoolJob
     void * pUserContext;               /**< @brief The user provided context. */
     uint32_t flags;                    /**< @brief Internal flags. */
     IotTaskPoolJobStatus_t status;     /**< @brief The status for the job. */
+    uint32_t readyTimeMs;              /**< @brief When the job was last queued for dispatch, truncated to 32 bits. */
+    uint32_t expirationTick;           /**< @brief When a deferred job is due, in timer wheel ticks. */
 } _taskPoolJob_t;
 
-/**
- * @brief Represents an operation that is subject to a timer.
- *
- * These events are queued per task pool. They are sorted by their
- * expiration time.
- */
-typedef struct _taskPoolTimerEvent
-{
-    IotLink_t link;          /**< @brief List link member. */
-    uint64_t expirationTime; /**< @brief When this event should be processed. */
-    _taskPoolJob_t * pJob;   /**< @brief The task pool job associated with this event. */
-} _taskPoolTimerEvent_t;
-
 #endif /* ifndef IOT_TASKPOOL_INTERNAL_H_ */
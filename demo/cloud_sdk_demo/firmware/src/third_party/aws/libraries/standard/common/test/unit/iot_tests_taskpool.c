@@ -75,6 +75,16 @@ typedef struct JobBlockingUserContext
     IotSemaphore_t block;  /**< @brief A synch object to wait on. */
 } JobBlockingUserContext_t;
 
+/**
+ * @brief A user context to prove deferred jobs run on time.
+ */
+typedef struct JobDeferredUserContext
+{
+    JobUserContext_t * pCounter; /**< @brief The counter shared by all jobs. */
+    uint64_t dueMs;              /**< @brief When the job is due. */
+    uint64_t ranMs;              /**< @brief When the job ran, 0 if it did not. */
+} JobDeferredUserContext_t;
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -126,6 +136,9 @@ TEST_GROUP_RUNNER( Common_Unit_Task_Pool )
     RUN_TEST_CASE( Common_Unit_Task_Pool, ScheduleTasks_ReSchedule );
     RUN_TEST_CASE( Common_Unit_Task_Pool, ScheduleTasks_ReScheduleDeferred );
     RUN_TEST_CASE( Common_Unit_Task_Pool, ScheduleTasks_CancelTasks );
+    RUN_TEST_CASE( Common_Unit_Task_Pool, ScheduleTasks_TimeCriticalLatency );
+    RUN_TEST_CASE( Common_Unit_Task_Pool, ScheduleTasks_ScheduleManyDeferredThenWait );
+    RUN_TEST_CASE( Common_Unit_Task_Pool, ScheduleTasks_DeferredBenchmark );
 }
 
 /*-----------------------------------------------------------*/
@@ -200,6 +213,48 @@ TEST_GROUP_RUNNER( Common_Unit_Task_Pool )
     #define TEST_TASKPOOL_MAX_THREADS    7
 #endif
 
+/**
+ * @brief Define how long a slow user callback runs, e.g. one writing a file system.
+ */
+#ifndef TEST_TASKPOOL_SLOW_CALLBACK_MS
+    #define TEST_TASKPOOL_SLOW_CALLBACK_MS    ( 100 )
+#endif
+
+/**
+ * @brief Define the number of slow user callbacks queued at once.
+ */
+#ifndef TEST_TASKPOOL_SLOW_JOBS
+    #define TEST_TASKPOOL_SLOW_JOBS    ( 5 )
+#endif
+
+/**
+ * @brief Define the number of protocol jobs scheduled while the slow callbacks run.
+ */
+#ifndef TEST_TASKPOOL_PROTOCOL_JOBS
+    #define TEST_TASKPOOL_PROTOCOL_JOBS    ( 20 )
+#endif
+
+/**
+ * @brief Define the number of deferred jobs pending at once, and the longest delay among them.
+ */
+#ifndef TEST_TASKPOOL_DEFERRED_JOBS
+    #define TEST_TASKPOOL_DEFERRED_JOBS    ( 100 )
+#endif
+#ifndef TEST_TASKPOOL_DEFERRED_MAX_DELAY_MS
+    #define TEST_TASKPOOL_DEFERRED_MAX_DELAY_MS    ( 600 )
+#endif
+
+/**
+ * @brief Define the largest number of pending deferred jobs in the benchmark, and how many
+ * jobs are canceled and deferred again at each size.
+ */
+#ifndef TEST_TASKPOOL_BENCHMARK_MAX_JOBS
+    #define TEST_TASKPOOL_BENCHMARK_MAX_JOBS    ( 1000 )
+#endif
+#ifndef TEST_TASKPOOL_BENCHMARK_OPERATIONS
+    #define TEST_TASKPOOL_BENCHMARK_OPERATIONS    ( 100000 )
+#endif
+
 /**
  * @brief One hour in milliseconds.
  */
@@ -351,10 +406,156 @@ static void BlankExecution( IotTaskPool_t pTaskPool,
     TEST_ASSERT( ( error == IOT_TASKPOOL_SUCCESS ) || ( error == IOT_TASKPOOL_SHUTDOWN_IN_PROGRESS ) );
 }
 
+/**
+ * @brief A callback that runs for long, and does not recycle its job.
+ */
+static void ExecutionSlowWithoutDestroyCb( IotTaskPool_t pTaskPool,
+                                           IotTaskPoolJob_t pJob,
+                                           void * pContext )
+{
+    JobUserContext_t * pUserContext = ( JobUserContext_t * ) pContext;
+
+    ( void ) pTaskPool;
+    ( void ) pJob;
+
+    IotClock_SleepMs( TEST_TASKPOOL_SLOW_CALLBACK_MS );
+
+    IotMutex_Lock( &pUserContext->lock );
+    pUserContext->counter++;
+    IotMutex_Unlock( &pUserContext->lock );
+}
+
+/**
+ * @brief A callback that returns at once, and does not recycle its job.
+ */
+static void ExecutionFastWithoutDestroyCb( IotTaskPool_t pTaskPool,
+                                           IotTaskPoolJob_t pJob,
+                                           void * pContext )
+{
+    JobUserContext_t * pUserContext = ( JobUserContext_t * ) pContext;
+
+    ( void ) pTaskPool;
+    ( void ) pJob;
+
+    IotMutex_Lock( &pUserContext->lock );
+    pUserContext->counter++;
+    IotMutex_Unlock( &pUserContext->lock );
+}
+
+/**
+ * @brief A callback that records when a deferred job ran, and does not recycle its job.
+ */
+static void ExecutionDeferredCb( IotTaskPool_t pTaskPool,
+                                 IotTaskPoolJob_t pJob,
+                                 void * pContext )
+{
+    JobDeferredUserContext_t * pUserContext = ( JobDeferredUserContext_t * ) pContext;
+
+    ( void ) pTaskPool;
+    ( void ) pJob;
+
+    IotMutex_Lock( &pUserContext->pCounter->lock );
+    pUserContext->ranMs = IotClock_GetTimeMs();
+    pUserContext->pCounter->counter++;
+    IotMutex_Unlock( &pUserContext->pCounter->lock );
+}
+
+/**
+ * @brief Returns the upper bound of the bucket that holds the given percentile of a histogram.
+ */
+static uint32_t HistogramPercentileMs( const uint32_t * pHistogram,
+                                       uint32_t samples,
+                                       uint32_t percent )
+{
+    uint32_t bucket, count = 0;
+
+    for( bucket = 0; bucket < IOT_TASKPOOL_HISTOGRAM_BUCKETS - 1; ++bucket )
+    {
+        count += pHistogram[ bucket ];
+
+        if( count * 100 >= samples * percent )
+        {
+            break;
+        }
+    }
+
+    return ( 1UL << bucket ) - 1;
+}
+
+/**
+ * @brief Queues slow user callbacks on a single-thread task pool, as the system task pool has, then
+ * schedules short protocol jobs with the given flags while the slow callbacks run.
+ */
+static void ScheduleUnderSlowCallbacks( uint32_t protocolFlags,
+                                        IotTaskPoolStats_t * pStats )
+{
+    uint32_t count;
+    IotTaskPool_t taskPool = IOT_TASKPOOL_INITIALIZER;
+    const IotTaskPoolInfo_t tpInfo = { .minThreads = 1, .maxThreads = 1, .stackSize = IOT_THREAD_DEFAULT_STACK_SIZE, .priority = IOT_THREAD_DEFAULT_PRIORITY };
+    IotTaskPoolJobStorage_t jobsStorage[ TEST_TASKPOOL_SLOW_JOBS + TEST_TASKPOOL_PROTOCOL_JOBS ];
+    IotTaskPoolJob_t jobs[ TEST_TASKPOOL_SLOW_JOBS + TEST_TASKPOOL_PROTOCOL_JOBS ];
+
+    JobUserContext_t userContext = IOT_TASKPOOL_TEST_JOB_CONTEXT_INITIALIZER;
+
+    /* Initialize user context. */
+    TEST_ASSERT( IotMutex_Create( &userContext.lock, false ) );
+
+    TEST_ASSERT( IotTaskPool_Create( &tpInfo, &taskPool ) == IOT_TASKPOOL_SUCCESS );
+
+    if( TEST_PROTECT() )
+    {
+        /* The slow callbacks occupy the only worker for a while. */
+        for( count = 0; count < TEST_TASKPOOL_SLOW_JOBS; ++count )
+        {
+            TEST_ASSERT( IotTaskPool_CreateJob( &ExecutionSlowWithoutDestroyCb, &userContext, &jobsStorage[ count ], &jobs[ count ] ) == IOT_TASKPOOL_SUCCESS );
+            TEST_ASSERT( IotTaskPool_Schedule( taskPool, jobs[ count ], 0 ) == IOT_TASKPOOL_SUCCESS );
+        }
+
+        /* Protocol jobs come in regularly meanwhile, like PUBACKs of a stream of PUBLISH messages. */
+        for( ; count < TEST_TASKPOOL_SLOW_JOBS + TEST_TASKPOOL_PROTOCOL_JOBS; ++count )
+        {
+            IotClock_SleepMs( ( TEST_TASKPOOL_SLOW_JOBS * TEST_TASKPOOL_SLOW_CALLBACK_MS ) / TEST_TASKPOOL_PROTOCOL_JOBS );
+
+            TEST_ASSERT( IotTaskPool_CreateJob( &ExecutionFastWithoutDestroyCb, &userContext, &jobsStorage[ count ], &jobs[ count ] ) == IOT_TASKPOOL_SUCCESS );
+            TEST_ASSERT( IotTaskPool_Schedule( taskPool, jobs[ count ], protocolFlags ) == IOT_TASKPOOL_SUCCESS );
+        }
+
+        /* Wait until all callbacks are executed. */
+        while( true )
+        {
+            IotClock_SleepMs( 50 );
+
+            IotMutex_Lock( &userContext.lock );
+
+            if( userContext.counter == TEST_TASKPOOL_SLOW_JOBS + TEST_TASKPOOL_PROTOCOL_JOBS )
+            {
+                IotMutex_Unlock( &userContext.lock );
+
+                break;
+            }
+
+            IotMutex_Unlock( &userContext.lock );
+        }
+
+        TEST_ASSERT( IotTaskPool_GetStats( taskPool, pStats ) == IOT_TASKPOOL_SUCCESS );
+    }
+
+    TEST_ASSERT( IotTaskPool_Destroy( taskPool ) == IOT_TASKPOOL_SUCCESS );
+
+    /* Destroy user context. */
+    IotMutex_Destroy( &userContext.lock );
+}
+
 /* ---------------------------------------------------------------------------------------------- */
 /* ---------------------------------------------------------------------------------------------- */
 /* ---------------------------------------------------------------------------------------------- */
 
+/**
+ * @brief Jobs for the deferred jobs benchmark, too many for the stack of the test.
+ */
+static IotTaskPoolJobStorage_t benchmarkJobStorage[ TEST_TASKPOOL_BENCHMARK_MAX_JOBS ];
+static IotTaskPoolJob_t benchmarkJobs[ TEST_TASKPOOL_BENCHMARK_MAX_JOBS ];
+
 /**
  * @brief Number of legal task pool initialization configurations.
  */
@@ -1835,3 +2036,199 @@ TEST( Common_Unit_Task_Pool, ScheduleTasks_CancelTasks )
 }
 
 /*-----------------------------------------------------------*/
+
+/**
+ * @brief Test that time-critical jobs do not wait behind slow user callbacks, and print the tail
+ * queue wait of the protocol jobs with and without the time-critical lane.
+ */
+TEST( Common_Unit_Task_Pool, ScheduleTasks_TimeCriticalLatency )
+{
+    IotTaskPoolStats_t fifoStats, laneStats;
+    const IotTaskPoolLaneStats_t * pNormal = NULL, * pCritical = NULL;
+    uint32_t fifoTailMs, laneTailMs;
+
+    /* Bad flags. */
+    TEST_ASSERT( IotTaskPool_Schedule( IOT_SYSTEM_TASKPOOL, ( IotTaskPoolJob_t ) &fifoStats, 0x80 ) == IOT_TASKPOOL_BAD_PARAMETER );
+    TEST_ASSERT( IotTaskPool_ScheduleDeferredWithFlags( IOT_SYSTEM_TASKPOOL, ( IotTaskPoolJob_t ) &fifoStats, 10, IOT_TASKPOOL_JOB_HIGH_PRIORITY ) == IOT_TASKPOOL_BAD_PARAMETER );
+    TEST_ASSERT( IotTaskPool_GetStats( IOT_SYSTEM_TASKPOOL, NULL ) == IOT_TASKPOOL_BAD_PARAMETER );
+
+    /* All jobs in one FIFO queue: the protocol jobs wait for all the slow callbacks queued before them. */
+    ScheduleUnderSlowCallbacks( 0, &fifoStats );
+
+    pNormal = &fifoStats.lanes[ IOT_TASKPOOL_LANE_NORMAL ];
+    TEST_ASSERT_EQUAL_UINT32( TEST_TASKPOOL_SLOW_JOBS + TEST_TASKPOOL_PROTOCOL_JOBS, pNormal->jobs );
+    TEST_ASSERT_EQUAL_UINT32( 0, fifoStats.lanes[ IOT_TASKPOOL_LANE_TIME_CRITICAL ].jobs );
+    TEST_ASSERT_EQUAL_UINT32( 0, fifoStats.spareWorkers );
+    TEST_ASSERT_EQUAL_UINT32( 0, fifoStats.spareWakeups );
+    TEST_ASSERT( pNormal->maxQueueWaitMs >= TEST_TASKPOOL_SLOW_CALLBACK_MS );
+    TEST_ASSERT( pNormal->maxRunTimeMs >= TEST_TASKPOOL_SLOW_CALLBACK_MS );
+    fifoTailMs = HistogramPercentileMs( pNormal->queueWaitMs, pNormal->jobs, 99 );
+
+    /* Protocol jobs in the time-critical lane: they get a spare worker and do not wait for the slow callbacks. */
+    ScheduleUnderSlowCallbacks( IOT_TASKPOOL_JOB_TIME_CRITICAL, &laneStats );
+
+    pNormal = &laneStats.lanes[ IOT_TASKPOOL_LANE_NORMAL ];
+    pCritical = &laneStats.lanes[ IOT_TASKPOOL_LANE_TIME_CRITICAL ];
+    TEST_ASSERT_EQUAL_UINT32( TEST_TASKPOOL_SLOW_JOBS, pNormal->jobs );
+    TEST_ASSERT_EQUAL_UINT32( TEST_TASKPOOL_PROTOCOL_JOBS, pCritical->jobs );
+    TEST_ASSERT( laneStats.spareWorkers > 0 );
+
+    /* The spare worker is parked between the protocol jobs, not created again for each. */
+    TEST_ASSERT( laneStats.spareWorkers <= IOT_TASKPOOL_SPARE_WORKERS );
+    TEST_ASSERT( laneStats.spareWakeups > laneStats.spareWorkers );
+    TEST_ASSERT( pCritical->maxQueueWaitMs < TEST_TASKPOOL_SLOW_CALLBACK_MS );
+    TEST_ASSERT( pCritical->maxRunTimeMs < TEST_TASKPOOL_SLOW_CALLBACK_MS );
+    laneTailMs = HistogramPercentileMs( pCritical->queueWaitMs, pCritical->jobs, 99 );
+
+    TEST_ASSERT( laneTailMs < fifoTailMs );
+
+    UnityPrint( "Protocol job p99 queue wait (ms), FIFO: <= " );
+    UnityPrintNumber( ( UNITY_INT ) fifoTailMs );
+    UnityPrint( ", max " );
+    UnityPrintNumber( ( UNITY_INT ) fifoStats.lanes[ IOT_TASKPOOL_LANE_NORMAL ].maxQueueWaitMs );
+    UnityPrint( "; time-critical lane: <= " );
+    UnityPrintNumber( ( UNITY_INT ) laneTailMs );
+    UnityPrint( ", max " );
+    UnityPrintNumber( ( UNITY_INT ) pCritical->maxQueueWaitMs );
+    UNITY_PRINT_EOL();
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test deferring many jobs at once with spread delays: none runs early, all run,
+ * and canceled ones never run.
+ */
+TEST( Common_Unit_Task_Pool, ScheduleTasks_ScheduleManyDeferredThenWait )
+{
+    IotTaskPool_t taskPool = IOT_TASKPOOL_INITIALIZER;
+    const IotTaskPoolInfo_t tpInfo = { .minThreads = 2, .maxThreads = 3, .stackSize = IOT_THREAD_DEFAULT_STACK_SIZE, .priority = IOT_THREAD_DEFAULT_PRIORITY };
+
+    JobUserContext_t userContext = IOT_TASKPOOL_TEST_JOB_CONTEXT_INITIALIZER;
+    JobDeferredUserContext_t jobContexts[ TEST_TASKPOOL_DEFERRED_JOBS ];
+    IotTaskPoolJobStorage_t jobStorage[ TEST_TASKPOOL_DEFERRED_JOBS ];
+    IotTaskPoolJob_t jobs[ TEST_TASKPOOL_DEFERRED_JOBS ];
+
+    /* Initialize user context. */
+    TEST_ASSERT( IotMutex_Create( &userContext.lock, false ) );
+
+    TEST_ASSERT( IotTaskPool_Create( &tpInfo, &taskPool ) == IOT_TASKPOOL_SUCCESS );
+
+    if( TEST_PROTECT() )
+    {
+        uint32_t count, expected = 0, waitedMs = 0;
+        uint32_t delayMs;
+
+        for( count = 0; count < TEST_TASKPOOL_DEFERRED_JOBS; ++count )
+        {
+            /* Spread the delays over several turns of the first level of the timer wheel. */
+            delayMs = 1 + ( ( count * 7919 ) % TEST_TASKPOOL_DEFERRED_MAX_DELAY_MS );
+
+            jobContexts[ count ].pCounter = &userContext;
+            jobContexts[ count ].ranMs = 0;
+            jobContexts[ count ].dueMs = IotClock_GetTimeMs() + delayMs;
+
+            TEST_ASSERT( IotTaskPool_CreateJob( &ExecutionDeferredCb, &jobContexts[ count ], &jobStorage[ count ], &jobs[ count ] ) == IOT_TASKPOOL_SUCCESS );
+            TEST_ASSERT( IotTaskPool_ScheduleDeferred( taskPool, jobs[ count ], delayMs ) == IOT_TASKPOOL_SUCCESS );
+        }
+
+        /* Cancel one job in five, the cancel may come too late for the shortest delays. */
+        for( count = 0; count < TEST_TASKPOOL_DEFERRED_JOBS; ++count )
+        {
+            if( ( ( count % 5 ) != 0 ) ||
+                ( IotTaskPool_TryCancel( taskPool, jobs[ count ], NULL ) != IOT_TASKPOOL_SUCCESS ) )
+            {
+                ++expected;
+            }
+        }
+
+        /* Wait for all the jobs that were not canceled, and for the canceled ones to be late. */
+        while( waitedMs < TEST_TASKPOOL_DEFERRED_MAX_DELAY_MS * 4 )
+        {
+            IotClock_SleepMs( 50 );
+            waitedMs += 50;
+
+            IotMutex_Lock( &userContext.lock );
+
+            if( ( userContext.counter == expected ) && ( waitedMs > TEST_TASKPOOL_DEFERRED_MAX_DELAY_MS ) )
+            {
+                IotMutex_Unlock( &userContext.lock );
+
+                break;
+            }
+
+            IotMutex_Unlock( &userContext.lock );
+        }
+
+        IotMutex_Lock( &userContext.lock );
+        TEST_ASSERT_EQUAL_UINT32( expected, userContext.counter );
+
+        for( count = 0; count < TEST_TASKPOOL_DEFERRED_JOBS; ++count )
+        {
+            if( jobContexts[ count ].ranMs != 0 )
+            {
+                TEST_ASSERT( jobContexts[ count ].ranMs >= jobContexts[ count ].dueMs );
+            }
+        }
+
+        IotMutex_Unlock( &userContext.lock );
+    }
+
+    TEST_ASSERT( IotTaskPool_Destroy( taskPool ) == IOT_TASKPOOL_SUCCESS );
+
+    /* Destroy user context. */
+    IotMutex_Destroy( &userContext.lock );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Measure the time to cancel a deferred job and defer it again, with 10, 100 and 1000 deferred jobs
+ * pending, and print it.
+ */
+TEST( Common_Unit_Task_Pool, ScheduleTasks_DeferredBenchmark )
+{
+    static const uint32_t pendingJobs[] = { 10, 100, TEST_TASKPOOL_BENCHMARK_MAX_JOBS };
+    uint32_t size, count, operation;
+    uint64_t startMs, elapsedMs;
+
+    for( size = 0; size < sizeof( pendingJobs ) / sizeof( pendingJobs[ 0 ] ); ++size )
+    {
+        /* Defer the jobs from one minute to one hour from now, so that none expires. */
+        for( count = 0; count < pendingJobs[ size ]; ++count )
+        {
+            TEST_ASSERT( IotTaskPool_CreateJob( &BlankExecution, NULL, &benchmarkJobStorage[ count ], &benchmarkJobs[ count ] ) == IOT_TASKPOOL_SUCCESS );
+            TEST_ASSERT( IotTaskPool_ScheduleDeferred( IOT_SYSTEM_TASKPOOL,
+                                                       benchmarkJobs[ count ],
+                                                       60 * 1000 + ( ( count * 7919 ) % ONE_HOUR_FROM_NOW_MS ) ) == IOT_TASKPOOL_SUCCESS );
+        }
+
+        startMs = IotClock_GetTimeMs();
+
+        for( operation = 0; operation < TEST_TASKPOOL_BENCHMARK_OPERATIONS; ++operation )
+        {
+            count = operation % pendingJobs[ size ];
+
+            TEST_ASSERT( IotTaskPool_TryCancel( IOT_SYSTEM_TASKPOOL, benchmarkJobs[ count ], NULL ) == IOT_TASKPOOL_SUCCESS );
+            TEST_ASSERT( IotTaskPool_ScheduleDeferred( IOT_SYSTEM_TASKPOOL,
+                                                       benchmarkJobs[ count ],
+                                                       60 * 1000 + ( ( operation * 7919 ) % ONE_HOUR_FROM_NOW_MS ) ) == IOT_TASKPOOL_SUCCESS );
+        }
+
+        elapsedMs = IotClock_GetTimeMs() - startMs;
+
+        for( count = 0; count < pendingJobs[ size ]; ++count )
+        {
+            TEST_ASSERT( IotTaskPool_TryCancel( IOT_SYSTEM_TASKPOOL, benchmarkJobs[ count ], NULL ) == IOT_TASKPOOL_SUCCESS );
+        }
+
+        UnityPrint( "Deferred jobs pending: " );
+        UnityPrintNumber( ( UNITY_INT ) pendingJobs[ size ] );
+        UnityPrint( ", cancel and defer again: " );
+        UnityPrintNumber( ( UNITY_INT ) ( elapsedMs * 1000000 / TEST_TASKPOOL_BENCHMARK_OPERATIONS ) );
+        UnityPrint( " ns" );
+        UNITY_PRINT_EOL();
+    }
+}
+
+/*-----------------------------------------------------------*/
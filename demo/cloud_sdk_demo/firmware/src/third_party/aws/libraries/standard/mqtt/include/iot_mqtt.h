@@ -71,6 +71,11 @@
  * @functionpage{IotMqtt_strerror,mqtt,strerror}
  * @functionpage{IotMqtt_OperationType,mqtt,operationtype}
  * @functionpage{IotMqtt_IsSubscribed,mqtt,issubscribed}
+ * @functionpage{IotMqtt_InitSession,mqtt,initsession}
+ * @functionpage{IotMqtt_CleanupSession,mqtt,cleanupsession}
+ * @functionpage{IotMqtt_SessionPresent,mqtt,sessionpresent}
+ * @functionpage{IotMqtt_WaitPublishCredit,mqtt,waitpublishcredit}
+ * @functionpage{IotMqtt_GetPublishStats,mqtt,getpublishstats}
  */
 
 /**
@@ -464,8 +469,7 @@ IotMqttError_t IotMqtt_SubscribeAsync( IotMqttConnection_t mqttConnection,
  * subscriptions.
  * @param[in] subscriptionCount The number of elements in pSubscriptionList.
  * @param[in] flags Flags which modify the behavior of this function. See @ref mqtt_constants_flags.
- * Currently, flags are ignored by this function; this parameter is for
- * future-compatibility.
+ * Only #IOT_MQTT_FLAG_SESSION_RESTORE is used by this function.
  * @param[in] timeoutMs If the MQTT server does not acknowledge the subscriptions within
  * this timeout in milliseconds, this function returns #IOT_MQTT_TIMEOUT.
  *
@@ -842,6 +846,88 @@ bool IotMqtt_IsSubscribed( IotMqttConnection_t mqttConnection,
                            IotMqttSubscription_t * const pCurrentSubscription );
 /* @[declare_mqtt_issubscribed] */
 
+/**
+ * @brief Initialize the client side state of a persistent MQTT session.
+ *
+ * The session may then be given to @ref mqtt_function_connect in
+ * #IotMqttConnectInfo_t.pSession, for any number of connections in turn. QoS 1
+ * PUBLISH messages not acknowledged when one of these connections is closed by
+ * @ref mqtt_function_disconnect are kept in the session and sent again, with the
+ * same packet identifier and the DUP flag set, as soon as the next connection is
+ * established.
+ *
+ * @param[in] pSession The session to initialize.
+ *
+ * @return One of the following:
+ * - #IOT_MQTT_SUCCESS
+ * - #IOT_MQTT_BAD_PARAMETER
+ * - #IOT_MQTT_NO_MEMORY
+ */
+/* @[declare_mqtt_initsession] */
+IotMqttError_t IotMqtt_InitSession( IotMqttSession_t * pSession );
+/* @[declare_mqtt_initsession] */
+
+/**
+ * @brief Free the PUBLISH messages kept in an MQTT session.
+ *
+ * The callback of each PUBLISH message still kept is invoked with
+ * #IOT_MQTT_NETWORK_ERROR and no connection. No connection may use the session
+ * when this function is called.
+ *
+ * @param[in] pSession The session to clean up.
+ */
+/* @[declare_mqtt_cleanupsession] */
+void IotMqtt_CleanupSession( IotMqttSession_t * pSession );
+/* @[declare_mqtt_cleanupsession] */
+
+/**
+ * @brief Check if the server kept a previous session for an MQTT connection.
+ *
+ * Returns the "Session Present" flag of the CONNACK. When it is set, the
+ * subscriptions of the previous session are still active on the server and do
+ * not need to be made again.
+ *
+ * @param[in] mqttConnection An established MQTT connection.
+ *
+ * @return `true` if the server reported a session present; `false` otherwise.
+ */
+/* @[declare_mqtt_sessionpresent] */
+bool IotMqtt_SessionPresent( IotMqttConnection_t mqttConnection );
+/* @[declare_mqtt_sessionpresent] */
+
+/**
+ * @brief Wait until a QoS 1 PUBLISH fits in the publish window of an MQTT
+ * connection.
+ *
+ * Lets a producer hold back while #IotMqttConnectInfo_t.publishWindow PUBLISH
+ * messages are waiting for a PUBACK, instead of having
+ * @ref mqtt_function_publishasync fail with #IOT_MQTT_WINDOW_FULL. The credit
+ * is not reserved; with several producers, the PUBLISH may still find the window
+ * full.
+ *
+ * @param[in] mqttConnection An established MQTT connection.
+ * @param[in] timeoutMs How long to wait. Pass `0` to only check.
+ *
+ * @return `true` if a QoS 1 PUBLISH may be sent now; `false` if the window was
+ * still full after `timeoutMs`.
+ */
+/* @[declare_mqtt_waitpublishcredit] */
+bool IotMqtt_WaitPublishCredit( IotMqttConnection_t mqttConnection,
+                                uint32_t timeoutMs );
+/* @[declare_mqtt_waitpublishcredit] */
+
+/**
+ * @brief Get the publish window and PUBACK round trip time of an MQTT
+ * connection.
+ *
+ * @param[in] mqttConnection An established MQTT connection.
+ * @param[out] pStats Set to the current values.
+ */
+/* @[declare_mqtt_getpublishstats] */
+void IotMqtt_GetPublishStats( IotMqttConnection_t mqttConnection,
+                              IotMqttPublishStats_t * pStats );
+/* @[declare_mqtt_getpublishstats] */
+
 /**
  * @cond DOXYGEN_IGNORE
  * Doxygen should ignore this section.
@@ -264,7 +264,20 @@ typedef enum IotMqttError
      * - @ref mqtt_function_publishsync
      * - @ref mqtt_function_wait
      */
-    IOT_MQTT_NOT_INITIALIZED = 11
+    IOT_MQTT_NOT_INITIALIZED = 11,
+
+    /**
+     * @brief A QoS 1 PUBLISH was not queued because [the publish window]
+     * (#IotMqttConnectInfo_t.publishWindow) of the connection is full.
+     *
+     * Functions that may return this value:
+     * - @ref mqtt_function_publishasync
+     * - @ref mqtt_function_publishsync
+     *
+     * @ref mqtt_function_waitpublishcredit can be used to wait for a PUBACK
+     * to free the window.
+     */
+    IOT_MQTT_WINDOW_FULL = 12
 } IotMqttError_t;
 
 /**
@@ -384,6 +397,11 @@ typedef enum IotMqttDisconnectReason
  *
  * After the 20th retransmission, the MQTT library will wait
  * @ref IOT_MQTT_RESPONSE_WAIT_MS before checking a final time for a PUBACK.
+ *
+ * When #IotMqttPublishInfo_t.retryMs is #IOT_MQTT_RETRY_MS_ADAPTIVE, the first
+ * retransmission is sent after the retransmission timeout of the connection,
+ * computed from the PUBACK round trip times as in RFC 6298, and the following
+ * ones back off from there as above.
  */
 typedef struct IotMqttPublishInfo
 {
@@ -396,7 +414,7 @@ typedef struct IotMqttPublishInfo
     const void * pPayload;    /**< @brief Payload of PUBLISH. */
     size_t payloadLength;     /**< @brief Length of #IotMqttPublishInfo_t.pPayload. For LWT messages, this is limited to 65535. */
 
-    uint32_t retryMs;         /**< @brief If no response is received within this time, the message is retransmitted. */
+    uint32_t retryMs;         /**< @brief If no response is received within this time, the message is retransmitted. May be #IOT_MQTT_RETRY_MS_ADAPTIVE. */
     uint32_t retryLimit;      /**< @brief How many times to attempt retransmission. */
 } IotMqttPublishInfo_t;
 
@@ -558,6 +576,74 @@ typedef struct IotMqttSubscription
     IotMqttCallbackInfo_t callback;
 } IotMqttSubscription_t;
 
+/**
+ * @ingroup mqtt_datatypes_paramstructs
+ * @brief Client side state of a persistent MQTT session.
+ *
+ * @paramfor @ref mqtt_function_connect, @ref mqtt_function_initsession,
+ * @ref mqtt_function_cleanupsession
+ *
+ * Holds the QoS 1 PUBLISH messages that were not acknowledged when their
+ * connection was closed, so that they can be sent again with the DUP flag set,
+ * and with the same packet identifier, over the next connection that uses the
+ * session. See #IotMqttConnectInfo_t.pSession.
+ *
+ * Must be initialized with @ref mqtt_function_initsession before its first use
+ * and must outlive every connection that uses it.
+ *
+ * @warning Only the counters may be read by the application; the other members
+ * are private to the MQTT library.
+ */
+typedef struct IotMqttSession
+{
+    IotMutex_t mutex;                    /**< @brief Private. */
+    IotListDouble_t publishes;           /**< @brief Private. */
+    const struct IotMqttSerializer * pSerializer; /**< @brief Private. */
+
+    uint32_t stored;  /**< @brief PUBLISH messages kept when their connection was closed. */
+    uint32_t resent;  /**< @brief PUBLISH messages sent again over a new connection. */
+    uint32_t pending; /**< @brief PUBLISH messages held right now. */
+} IotMqttSession_t;
+
+/**
+ * @ingroup mqtt_datatypes_paramstructs
+ * @brief Keep-alive interval learned from the network path of a connection.
+ *
+ * @paramfor @ref mqtt_function_connect
+ *
+ * NAT gateways and access points drop a TCP mapping left idle for longer than
+ * their own timeout, which is often far shorter than the keep-alive accepted by
+ * the MQTT server. When #IotMqttConnectInfo_t.pKeepAlive points to this struct,
+ * a PINGREQ is only sent after #IotMqttKeepAlive_t.intervalMs without any
+ * traffic on the connection. The interval grows after each PINGRESP, up to
+ * #IotMqttConnectInfo_t.keepAliveSeconds and just under the shortest idle time
+ * that a connection did not survive. A missed PINGRESP halves the interval and
+ * is followed at once by a second PINGREQ; if that one is missed as well the
+ * connection is closed and its idle time becomes the new limit. Idle time counts
+ * from the older of the last packet sent and the last packet received.
+ *
+ * A limit may also have been learned from an outage of the path, or from a
+ * gateway since replaced. After #IotMqttKeepAlive_t.limitHold PINGREQs answered
+ * at the limit, it is raised by half. If a PINGREQ is then answered past the old
+ * limit, the raise holds; otherwise the connection is closed, the old limit is
+ * restored, and the next raise waits twice as long.
+ *
+ * The struct may be stored by the application, per network, and given again to
+ * the next connection so that the interval is not learned from scratch. It must
+ * outlive the connection that uses it and must not be modified meanwhile.
+ */
+typedef struct IotMqttKeepAlive
+{
+    uint32_t intervalMs;   /**< @brief Idle time before a PINGREQ. 0 to start from `IOT_MQTT_KEEP_ALIVE_MIN_MS`. */
+    uint32_t limitMs;      /**< @brief Shortest idle time that a connection did not survive, 0 if none. */
+    uint32_t limitAge;     /**< @brief PINGREQs answered at the limit since it was learned or raised. */
+    uint32_t limitHold;    /**< @brief limitAge at which the limit is raised. 0 for `IOT_MQTT_KEEP_ALIVE_LIMIT_HOLD`. */
+    uint32_t raisedFromMs; /**< @brief The limit before a raise that is not confirmed yet, 0 if none. */
+
+    uint32_t pingreqs;     /**< @brief PINGREQ packets sent. */
+    uint32_t missed;       /**< @brief PINGRESP packets not received in time. */
+} IotMqttKeepAlive_t;
+
 /**
  * @ingroup mqtt_datatypes_paramstructs
  * @brief MQTT connection details.
@@ -664,8 +750,50 @@ typedef struct IotMqttConnectInfo
      */
     const IotMqttPublishInfo_t * pWillInfo;
 
+    /**
+     * @brief Client side session state, or `NULL` if not needed.
+     *
+     * When set, QoS 1 PUBLISH messages still waiting for a PUBACK when the
+     * connection is closed are kept in this session instead of completing with
+     * #IOT_MQTT_NETWORK_ERROR. They are sent again as soon as a new connection
+     * using the same session is established. Their callbacks are invoked once the
+     * PUBACK is received, or by @ref mqtt_function_cleanupsession.
+     *
+     * The messages are sent again even when the server reports no session present,
+     * in which case they are delivered as new messages. Messages published with
+     * #IOT_MQTT_FLAG_WAITABLE are never kept.
+     *
+     * Should be used with #IotMqttConnectInfo_t.cleanSession set to `false` and a
+     * stable #IotMqttConnectInfo_t.pClientIdentifier.
+     */
+    IotMqttSession_t * pSession;
+
+    /**
+     * @brief Most QoS 1 PUBLISH messages waiting for a PUBACK at any time.
+     *
+     * A PUBLISH over this limit fails with #IOT_MQTT_WINDOW_FULL until a PUBACK
+     * frees a credit; see @ref mqtt_function_waitpublishcredit. Set to 0 for no
+     * limit. When `IOT_STATIC_MEMORY_ONLY` is `1`, the window is also capped,
+     * or set when 0, so that two operations of the static pool stay free for a
+     * SUBSCRIBE, UNSUBSCRIBE or DISCONNECT and an incoming PUBLISH.
+     *
+     * A PUBLISH without a callback and not #IOT_MQTT_FLAG_WAITABLE completes once
+     * sent, so it frees its credit without waiting for the PUBACK.
+     */
+    uint16_t publishWindow;
+
     uint16_t keepAliveSeconds;       /**< @brief Period of keep-alive messages. Set to 0 to disable keep-alive. */
 
+    /**
+     * @brief Adaptive keep-alive state, or `NULL` for a fixed period.
+     *
+     * When set, #IotMqttConnectInfo_t.keepAliveSeconds is only the longest
+     * period, sent to the server in the CONNECT packet, and PINGREQ packets are
+     * sent as described in #IotMqttKeepAlive_t. Ignored when keep-alive is
+     * disabled.
+     */
+    IotMqttKeepAlive_t * pKeepAlive;
+
     const char * pClientIdentifier;  /**< @brief MQTT client identifier. */
     uint16_t clientIdentifierLength; /**< @brief Length of #IotMqttConnectInfo_t.pClientIdentifier. */
 
@@ -682,6 +810,25 @@ typedef struct IotMqttConnectInfo
     uint16_t passwordLength; /**< @brief Length of #IotMqttConnectInfo_t.pPassword. */
 } IotMqttConnectInfo_t;
 
+/**
+ * @ingroup mqtt_datatypes_paramstructs
+ * @brief Publish window and PUBACK round trip time of an MQTT connection.
+ *
+ * @paramfor @ref mqtt_function_getpublishstats
+ *
+ * The round trip time is only sampled from PUBLISH messages sent once, so
+ * that a PUBACK always matches the transmission it is timed against.
+ */
+typedef struct IotMqttPublishStats
+{
+    uint32_t window;   /**< @brief #IotMqttConnectInfo_t.publishWindow in effect, 0 for none. */
+    uint32_t inFlight; /**< @brief QoS 1 PUBLISH messages holding a credit of the window. */
+    uint32_t samples;  /**< @brief Number of round trip times measured. */
+    uint32_t srttMs;   /**< @brief Smoothed round trip time. */
+    uint32_t rttVarMs; /**< @brief Round trip time variation. */
+    uint32_t retryMs;  /**< @brief Retransmission timeout used by #IOT_MQTT_RETRY_MS_ADAPTIVE. */
+} IotMqttPublishStats_t;
+
 /**
  * @ingroup mqtt_datatypes_paramstructs
  * @brief MQTT packet details.
@@ -1110,6 +1257,8 @@ typedef struct IotMqttNetworkInfo
  *   @copybrief IOT_MQTT_FLAG_WAITABLE
  * - #IOT_MQTT_FLAG_CLEANUP_ONLY <br>
  *   @copybrief IOT_MQTT_FLAG_CLEANUP_ONLY
+ * - #IOT_MQTT_FLAG_SESSION_RESTORE <br>
+ *   @copybrief IOT_MQTT_FLAG_SESSION_RESTORE
  *
  * Flags should be bitwise-ORed with each other to change the behavior of
  * @ref mqtt_function_subscribeasync, @ref mqtt_function_unsubscribeasync,
@@ -1138,7 +1287,7 @@ typedef struct IotMqttNetworkInfo
 /** @brief Initializer for #IotMqttOperation_t. */
 #define IOT_MQTT_OPERATION_INITIALIZER        NULL
 /** @brief Initializer for #IotMqttPacketInfo_t. */
-#define IOT_MQTT_PACKET_INFO_INITIALIZER      { .pRemainingData = NULL, remainingLength = 0, packetIdentifier = 0, .type = 0 }
+#define IOT_MQTT_PACKET_INFO_INITIALIZER      { .pRemainingData = NULL, .remainingLength = 0, .packetIdentifier = 0, .type = 0 }
 /* @[define_mqtt_initializers] */
 
 /**
@@ -1166,4 +1315,26 @@ typedef struct IotMqttNetworkInfo
  */
 #define IOT_MQTT_FLAG_CLEANUP_ONLY    ( 0x00000001 )
 
+/**
+ * @brief Causes @ref mqtt_function_subscribesync to only register subscriptions
+ * that the server kept with the session.
+ *
+ * This flag is only valid for @ref mqtt_function_subscribesync. When @ref
+ * mqtt_function_sessionpresent returns `true` for the connection, no SUBSCRIBE
+ * packet is sent: the subscriptions are added to the connection at once, as
+ * [pConnectInfo->pPreviousSubscriptions](@ref IotMqttConnectInfo_t.pPreviousSubscriptions)
+ * does for subscriptions known before the connect. Otherwise, the flag has no
+ * effect.
+ *
+ * It must only be passed for a topic filter subscribed on every connection of
+ * the session.
+ */
+#define IOT_MQTT_FLAG_SESSION_RESTORE    ( 0x00000002 )
+
+/**
+ * @brief Value of #IotMqttPublishInfo_t.retryMs that sets the retransmission
+ * period from the PUBACK round trip time of the connection.
+ */
+#define IOT_MQTT_RETRY_MS_ADAPTIVE    ( UINT32_MAX )
+
 #endif /* ifndef IOT_MQTT_TYPES_H_ */
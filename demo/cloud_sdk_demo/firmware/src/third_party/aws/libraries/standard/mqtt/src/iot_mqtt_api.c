@@ -147,12 +147,14 @@ static IotNetworkError_t _createNetworkConnection( const IotMqttNetworkInfo_t *
  * @param[in] pNetworkInfo User-provided network information for the new
  * connection.
  * @param[in] keepAliveSeconds User-provided keep-alive interval for the new connection.
+ * @param[in] publishWindow User-provided publish window for the new connection.
  *
  * @return Pointer to a newly-created MQTT connection; `NULL` on failure.
  */
 static _mqttConnection_t * _createMqttConnection( bool awsIotMqttMode,
                                                   const IotMqttNetworkInfo_t * pNetworkInfo,
-                                                  uint16_t keepAliveSeconds );
+                                                  uint16_t keepAliveSeconds,
+                                                  uint16_t publishWindow );
 
 /**
  * @brief Destroys the members of an MQTT connection.
@@ -487,11 +489,13 @@ static IotNetworkError_t _createNetworkConnection( const IotMqttNetworkInfo_t *
 
 static _mqttConnection_t * _createMqttConnection( bool awsIotMqttMode,
                                                   const IotMqttNetworkInfo_t * pNetworkInfo,
-                                                  uint16_t keepAliveSeconds )
+                                                  uint16_t keepAliveSeconds,
+                                                  uint16_t publishWindow )
 {
     IOT_FUNCTION_ENTRY( bool, true );
     _mqttConnection_t * pMqttConnection = NULL;
     bool referencesMutexCreated = false, subscriptionMutexCreated = false;
+    bool publishWindowCreated = false;
 
     /* Allocate memory for the new MQTT connection. */
     pMqttConnection = IotMqtt_MallocConnection( sizeof( _mqttConnection_t ) );
@@ -543,6 +547,18 @@ static _mqttConnection_t * _createMqttConnection( bool awsIotMqttMode,
         EMPTY_ELSE_MARKER;
     }
 
+    /* Create the publish window for a new connection. */
+    publishWindowCreated = _IotMqtt_CreatePublishWindow( pMqttConnection, publishWindow );
+
+    if( publishWindowCreated == false )
+    {
+        IOT_SET_AND_GOTO_CLEANUP( false );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
     /* Create the new connection's subscription and operation lists. */
     IotListDouble_Create( &( pMqttConnection->subscriptionList ) );
     IotListDouble_Create( &( pMqttConnection->pendingProcessing ) );
@@ -572,6 +588,15 @@ static _mqttConnection_t * _createMqttConnection( bool awsIotMqttMode,
 
     if( status == false )
     {
+        if( publishWindowCreated == true )
+        {
+            _IotMqtt_DestroyPublishWindow( pMqttConnection );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+
         if( subscriptionMutexCreated == true )
         {
             IotMutex_Destroy( &( pMqttConnection->subscriptionMutex ) );
@@ -671,9 +696,10 @@ static void _destroyMqttConnection( _mqttConnection_t * pMqttConnection )
         EMPTY_ELSE_MARKER;
     }
 
-    /* Destroy mutexes. */
+    /* Destroy mutexes and the publish window. */
     IotMutex_Destroy( &( pMqttConnection->referencesMutex ) );
     IotMutex_Destroy( &( pMqttConnection->subscriptionMutex ) );
+    _IotMqtt_DestroyPublishWindow( pMqttConnection );
 
     IotLogDebug( "(MQTT connection %p) Connection destroyed.", pMqttConnection );
 
@@ -1129,7 +1155,8 @@ IotMqttError_t IotMqtt_Connect( const IotMqttNetworkInfo_t * pNetworkInfo,
     /* Initialize a new MQTT connection object. */
     pNewMqttConnection = _createMqttConnection( pConnectInfo->awsIotMqttMode,
                                                 pNetworkInfo,
-                                                pConnectInfo->keepAliveSeconds );
+                                                pConnectInfo->keepAliveSeconds,
+                                                pConnectInfo->publishWindow );
 
     if( pNewMqttConnection == NULL )
     {
@@ -1141,6 +1168,27 @@ IotMqttError_t IotMqtt_Connect( const IotMqttNetworkInfo_t * pNetworkInfo,
         pNewMqttConnection->pNetworkConnection = pNetworkConnection;
         pNewMqttConnection->ownNetworkConnection = ownNetworkConnection;
 
+        /* Set the session that keeps unacknowledged PUBLISH messages. */
+        pNewMqttConnection->pSession = pConnectInfo->pSession;
+
+        /* Set the adaptive keep-alive, which waits for its current interval
+         * before the first PINGREQ. */
+        pNewMqttConnection->lastSendMs = ( uint32_t ) IotClock_GetTimeMs();
+        pNewMqttConnection->lastReceiveMs = pNewMqttConnection->lastSendMs;
+
+        if( ( pConnectInfo->pKeepAlive != NULL ) &&
+            ( pNewMqttConnection->pingreq.u.operation.periodic.ping.keepAliveMs != 0 ) )
+        {
+            pNewMqttConnection->pingreq.u.operation.periodic.ping.pAdaptive = pConnectInfo->pKeepAlive;
+            pNewMqttConnection->pingreq.u.operation.periodic.ping.nextPeriodMs =
+                _IotMqtt_KeepAliveInterval( pConnectInfo->pKeepAlive,
+                                            pNewMqttConnection->pingreq.u.operation.periodic.ping.keepAliveMs );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+
         /* Set the MQTT packet serializer overrides. */
         #if IOT_MQTT_ENABLE_SERIALIZER_OVERRIDES == 1
             pNewMqttConnection->pSerializer = pNetworkInfo->pMqttSerializer;
@@ -1251,9 +1299,10 @@ IotMqttError_t IotMqtt_Connect( const IotMqttNetworkInfo_t * pNetworkInfo,
         {
             IotLogDebug( "Scheduling first MQTT keep-alive job." );
 
-            taskPoolStatus = IotTaskPool_ScheduleDeferred( IOT_SYSTEM_TASKPOOL,
-                                                           pNewMqttConnection->pingreq.job,
-                                                           pNewMqttConnection->pingreq.u.operation.periodic.ping.nextPeriodMs );
+            taskPoolStatus = IotTaskPool_ScheduleDeferredWithFlags( IOT_SYSTEM_TASKPOOL,
+                                                                    pNewMqttConnection->pingreq.job,
+                                                                    pNewMqttConnection->pingreq.u.operation.periodic.ping.nextPeriodMs,
+                                                                    IOT_TASKPOOL_JOB_TIME_CRITICAL );
 
             if( taskPoolStatus != IOT_TASKPOOL_SUCCESS )
             {
@@ -1322,6 +1371,17 @@ IotMqttError_t IotMqtt_Connect( const IotMqttNetworkInfo_t * pNetworkInfo,
     {
         IotLogInfo( "New MQTT connection %p established.", pMqttConnection );
 
+        /* Send again the PUBLISH messages left unacknowledged by the previous
+         * connection of the session. */
+        if( pNewMqttConnection->pSession != NULL )
+        {
+            _IotMqtt_ResumeSession( pNewMqttConnection );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+
         /* Set the output parameter. */
         *pMqttConnection = pNewMqttConnection;
     }
@@ -1447,6 +1507,9 @@ void IotMqtt_Disconnect( IotMqttConnection_t mqttConnection,
         /* At this point, the connection should be marked disconnected. */
         IotMqtt_Assert( mqttConnection->disconnected == true );
 
+        /* Keep the unacknowledged PUBLISH messages in the connection's session. */
+        _IotMqtt_SuspendSession( mqttConnection );
+
         /* Attempt cancel and destroy each operation in the connection's lists. */
         IotListDouble_RemoveAll( &( mqttConnection->pendingProcessing ),
                                  _mqttOperation_tryDestroy,
@@ -1509,16 +1572,41 @@ IotMqttError_t IotMqtt_SubscribeSync( IotMqttConnection_t mqttConnection,
     IotMqttError_t status = IOT_MQTT_STATUS_PENDING;
     IotMqttOperation_t subscribeOperation = IOT_MQTT_OPERATION_INITIALIZER;
 
-    /* Flags are not used, but the parameter is present for future compatibility. */
-    ( void ) flags;
+    if( ( ( flags & IOT_MQTT_FLAG_SESSION_RESTORE ) == IOT_MQTT_FLAG_SESSION_RESTORE ) &&
+        ( IotMqtt_SessionPresent( mqttConnection ) == true ) )
+    {
+        /* The server kept the subscriptions; only add them to the connection,
+         * with the packet identifier of the previous subscriptions of a
+         * CONNECT. */
+        status = _subscriptionCommonSetup( IOT_MQTT_SUBSCRIBE,
+                                           mqttConnection,
+                                           pSubscriptionList,
+                                           subscriptionCount,
+                                           0,
+                                           NULL );
 
-    /* Call the asynchronous SUBSCRIBE function. */
-    status = IotMqtt_SubscribeAsync( mqttConnection,
-                                     pSubscriptionList,
-                                     subscriptionCount,
-                                     IOT_MQTT_FLAG_WAITABLE | MQTT_INTERNAL_FLAG_BLOCK_ON_SEND,
-                                     NULL,
-                                     &subscribeOperation );
+        if( status == IOT_MQTT_SUCCESS )
+        {
+            status = _IotMqtt_AddSubscriptions( mqttConnection,
+                                                2,
+                                                pSubscriptionList,
+                                                subscriptionCount );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+    }
+    else
+    {
+        /* Call the asynchronous SUBSCRIBE function. */
+        status = IotMqtt_SubscribeAsync( mqttConnection,
+                                         pSubscriptionList,
+                                         subscriptionCount,
+                                         IOT_MQTT_FLAG_WAITABLE | MQTT_INTERNAL_FLAG_BLOCK_ON_SEND,
+                                         NULL,
+                                         &subscribeOperation );
+    }
 
     /* Wait for the SUBSCRIBE operation to complete. */
     if( status == IOT_MQTT_STATUS_PENDING )
@@ -1625,6 +1713,7 @@ IotMqttError_t IotMqtt_PublishAsync( IotMqttConnection_t mqttConnection,
     IOT_FUNCTION_ENTRY( IotMqttError_t, IOT_MQTT_SUCCESS );
     _mqttOperation_t * pOperation = NULL;
     uint8_t ** pPacketIdentifierHigh = NULL;
+    bool windowCredit = false;
 
     /* Check that IotMqtt_Init was called. */
     if( _checkInit() == false )
@@ -1700,6 +1789,29 @@ IotMqttError_t IotMqtt_PublishAsync( IotMqttConnection_t mqttConnection,
         EMPTY_ELSE_MARKER;
     }
 
+    /* A QoS 1 PUBLISH needs room in the publish window. */
+    if( pPublishInfo->qos != IOT_MQTT_QOS_0 )
+    {
+        windowCredit = _IotMqtt_TakePublishCredit( mqttConnection );
+
+        if( windowCredit == false )
+        {
+            IotLogDebug( "(MQTT connection %p) Publish window of %hu is full.",
+                         mqttConnection,
+                         mqttConnection->publishWindow );
+
+            IOT_SET_AND_GOTO_CLEANUP( IOT_MQTT_WINDOW_FULL );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
     /* Create a PUBLISH operation. */
     status = _IotMqtt_CreateOperation( mqttConnection,
                                        flags,
@@ -1715,9 +1827,13 @@ IotMqttError_t IotMqtt_PublishAsync( IotMqttConnection_t mqttConnection,
         EMPTY_ELSE_MARKER;
     }
 
-    /* Check the PUBLISH operation data and set the operation type. */
+    /* Check the PUBLISH operation data and set the operation type. The
+     * operation now holds the credit, if any. */
     IotMqtt_Assert( pOperation->u.operation.status == IOT_MQTT_STATUS_PENDING );
     pOperation->u.operation.type = IOT_MQTT_PUBLISH_TO_SERVER;
+    pOperation->u.operation.windowCredit = ( windowCredit == true ) &&
+                                           ( mqttConnection->publishWindow > 0 );
+    windowCredit = false;
 
     /* In AWS IoT MQTT mode, a pointer to the packet identifier must be saved. */
     if( mqttConnection->awsIotMqttMode == true )
@@ -1756,7 +1872,16 @@ IotMqttError_t IotMqtt_PublishAsync( IotMqttConnection_t mqttConnection,
         if( pPublishInfo->qos != IOT_MQTT_QOS_0 )
         {
             pOperation->u.operation.periodic.retry.limit = pPublishInfo->retryLimit;
-            pOperation->u.operation.periodic.retry.nextPeriodMs = pPublishInfo->retryMs;
+
+            if( pPublishInfo->retryMs == IOT_MQTT_RETRY_MS_ADAPTIVE )
+            {
+                pOperation->u.operation.periodic.retry.adaptive = true;
+                pOperation->u.operation.periodic.retry.nextPeriodMs = mqttConnection->rtoMs;
+            }
+            else
+            {
+                pOperation->u.operation.periodic.retry.nextPeriodMs = pPublishInfo->retryMs;
+            }
         }
         else
         {
@@ -1837,6 +1962,10 @@ IotMqttError_t IotMqtt_PublishAsync( IotMqttConnection_t mqttConnection,
         {
             _IotMqtt_DestroyOperation( pOperation );
         }
+        else if( windowCredit == true )
+        {
+            _IotMqtt_GivePublishCredit( mqttConnection );
+        }
         else
         {
             EMPTY_ELSE_MARKER;
@@ -2087,6 +2216,10 @@ const char * IotMqtt_strerror( IotMqttError_t status )
             pMessage = "NOT INITIALIZED";
             break;
 
+        case IOT_MQTT_WINDOW_FULL:
+            pMessage = "WINDOW FULL";
+            break;
+
         default:
             pMessage = "INVALID STATUS";
             break;
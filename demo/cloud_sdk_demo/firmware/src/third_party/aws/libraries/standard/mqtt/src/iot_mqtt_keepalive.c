@@ -0,0 +1,311 @@
+/*
+ * IoT MQTT V2.1.0
+ * Copyright (C) 2018 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/**
+ * @file iot_mqtt_keepalive.c
+ * @brief Implements the policy of the adaptive keep-alive.
+ *
+ * The keep-alive job only sends a PINGREQ once the connection has been idle for
+ * the current interval, so that traffic keeps deferring it. Each PINGRESP grows
+ * the interval by half, up to the period accepted by the server and under the
+ * shortest idle time that a connection did not survive, learned from a NAT
+ * gateway or access point dropping the mapping. A missed PINGRESP halves the
+ * interval and is followed at once by a second PINGREQ, so that a single lost
+ * packet does not close the connection; if that one is missed too, its idle time
+ * becomes the new limit.
+ *
+ * A limit is not kept for ever: it may come from an outage rather than from the
+ * path, and a gateway may be replaced. Once enough PINGREQs were answered at the
+ * limit, it is raised by half. A PINGREQ answered past the old limit confirms
+ * the raise; a connection lost before restores the old limit and doubles the
+ * number of PINGREQs before the next raise, so that a limit that is real costs
+ * fewer and fewer reconnects.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* MQTT internal include. */
+#include "private/iot_mqtt_internal.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Shortest interval of a connection.
+ *
+ * @param[in] keepAliveMs The keep-alive period accepted by the server.
+ *
+ * @return `IOT_MQTT_KEEP_ALIVE_MIN_MS`, or `keepAliveMs` if shorter.
+ */
+static uint32_t _floorMs( uint32_t keepAliveMs );
+
+/**
+ * @brief Account for a PINGREQ answered after the full interval.
+ *
+ * Confirms a raise of the limit, ages the limit and raises it once it is old
+ * enough.
+ *
+ * @param[in,out] pKeepAlive #IotMqttConnectInfo_t.pKeepAlive.
+ * @param[in] keepAliveMs The keep-alive period accepted by the server.
+ * @param[in] idleMs Idle time of the connection when the PINGREQ was sent.
+ */
+static void _ageLimit( IotMqttKeepAlive_t * pKeepAlive,
+                       uint32_t keepAliveMs,
+                       uint32_t idleMs );
+
+/**
+ * @brief Learn the limit from a connection that did not survive.
+ *
+ * @param[in,out] pKeepAlive #IotMqttConnectInfo_t.pKeepAlive.
+ * @param[in] idleMs Idle time of the connection when the first unanswered
+ * PINGREQ was sent.
+ */
+static void _learnLimit( IotMqttKeepAlive_t * pKeepAlive,
+                         uint32_t idleMs );
+
+/*-----------------------------------------------------------*/
+
+static uint32_t _floorMs( uint32_t keepAliveMs )
+{
+    return ( keepAliveMs < IOT_MQTT_KEEP_ALIVE_MIN_MS ) ? keepAliveMs : IOT_MQTT_KEEP_ALIVE_MIN_MS;
+}
+
+/*-----------------------------------------------------------*/
+
+static void _ageLimit( IotMqttKeepAlive_t * pKeepAlive,
+                       uint32_t keepAliveMs,
+                       uint32_t idleMs )
+{
+    uint32_t holdCount = ( pKeepAlive->limitHold != 0 ) ? pKeepAlive->limitHold : IOT_MQTT_KEEP_ALIVE_LIMIT_HOLD;
+
+    if( ( pKeepAlive->raisedFromMs != 0 ) &&
+        ( ( idleMs >= pKeepAlive->raisedFromMs ) || ( idleMs >= keepAliveMs ) ) )
+    {
+        /* The connection survived past the old limit, or as long as the server
+         * allows: the old limit was not the path's. */
+        pKeepAlive->raisedFromMs = 0;
+        pKeepAlive->limitHold = 0;
+
+        if( pKeepAlive->limitMs - pKeepAlive->limitMs / 8 >= keepAliveMs )
+        {
+            pKeepAlive->limitMs = 0;
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+    }
+    else if( ( pKeepAlive->limitMs != 0 ) &&
+             ( pKeepAlive->raisedFromMs == 0 ) &&
+             ( idleMs >= pKeepAlive->limitMs - pKeepAlive->limitMs / 8 ) )
+    {
+        ( pKeepAlive->limitAge )++;
+
+        if( pKeepAlive->limitAge >= holdCount )
+        {
+            pKeepAlive->raisedFromMs = pKeepAlive->limitMs;
+            pKeepAlive->limitMs += pKeepAlive->limitMs / 2;
+            pKeepAlive->limitAge = 0;
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void _learnLimit( IotMqttKeepAlive_t * pKeepAlive,
+                         uint32_t idleMs )
+{
+    uint32_t holdCount = ( pKeepAlive->limitHold != 0 ) ? pKeepAlive->limitHold : IOT_MQTT_KEEP_ALIVE_LIMIT_HOLD;
+
+    if( pKeepAlive->raisedFromMs != 0 )
+    {
+        /* The raise did not hold; wait twice as long for the next one. */
+        pKeepAlive->limitMs = pKeepAlive->raisedFromMs;
+        pKeepAlive->raisedFromMs = 0;
+        pKeepAlive->limitHold = ( holdCount < UINT32_MAX / 2 ) ? holdCount * 2 : holdCount;
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    if( ( pKeepAlive->limitMs == 0 ) || ( idleMs < pKeepAlive->limitMs ) )
+    {
+        pKeepAlive->limitMs = idleMs;
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    pKeepAlive->limitAge = 0;
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t _IotMqtt_KeepAliveInterval( const IotMqttKeepAlive_t * pKeepAlive,
+                                     uint32_t keepAliveMs )
+{
+    uint32_t floorMs = _floorMs( keepAliveMs );
+    uint32_t ceilingMs = keepAliveMs;
+    uint32_t intervalMs = pKeepAlive->intervalMs;
+
+    /* Stay an eighth under the idle time known to kill the connection. */
+    if( ( pKeepAlive->limitMs != 0 ) &&
+        ( pKeepAlive->limitMs - pKeepAlive->limitMs / 8 < ceilingMs ) )
+    {
+        ceilingMs = pKeepAlive->limitMs - pKeepAlive->limitMs / 8;
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    if( ceilingMs < floorMs )
+    {
+        ceilingMs = floorMs;
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    if( intervalMs < floorMs )
+    {
+        intervalMs = floorMs;
+    }
+    else if( intervalMs > ceilingMs )
+    {
+        intervalMs = ceilingMs;
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    return intervalMs;
+}
+
+/*-----------------------------------------------------------*/
+
+_mqttKeepAliveAction_t _IotMqtt_KeepAliveStep( IotMqttKeepAlive_t * pKeepAlive,
+                                               _mqttKeepAliveState_t * pState,
+                                               uint32_t keepAliveMs,
+                                               uint32_t idleMs,
+                                               bool pingrespReceived,
+                                               uint32_t * pNextPeriodMs )
+{
+    _mqttKeepAliveAction_t action = MQTT_KEEP_ALIVE_WAIT;
+    uint64_t grownMs = 0;
+
+    pKeepAlive->intervalMs = _IotMqtt_KeepAliveInterval( pKeepAlive, keepAliveMs );
+
+    if( pState->waiting == true )
+    {
+        if( pingrespReceived == true )
+        {
+            /* The interval only grows from a PINGREQ sent after the full
+             * interval, not from the probe that followed a missed PINGRESP. */
+            if( pState->probe == false )
+            {
+                _ageLimit( pKeepAlive, keepAliveMs, pState->idleMs );
+                grownMs = ( uint64_t ) pKeepAlive->intervalMs * 3U / 2U;
+                pKeepAlive->intervalMs = ( grownMs < keepAliveMs ) ? ( uint32_t ) grownMs : keepAliveMs;
+                pKeepAlive->intervalMs = _IotMqtt_KeepAliveInterval( pKeepAlive, keepAliveMs );
+            }
+            else
+            {
+                EMPTY_ELSE_MARKER;
+            }
+
+            pState->waiting = false;
+            pState->probe = false;
+        }
+        else
+        {
+            ( pKeepAlive->missed )++;
+
+            if( pState->probe == false )
+            {
+                /* Maybe a lost packet; probe again right away. */
+                pKeepAlive->intervalMs = pKeepAlive->intervalMs / 2;
+                pKeepAlive->intervalMs = _IotMqtt_KeepAliveInterval( pKeepAlive, keepAliveMs );
+                pState->probe = true;
+                action = MQTT_KEEP_ALIVE_SEND;
+            }
+            else
+            {
+                /* The path dropped the connection after pState->idleMs. */
+                _learnLimit( pKeepAlive, pState->idleMs );
+                pKeepAlive->intervalMs = _IotMqtt_KeepAliveInterval( pKeepAlive, keepAliveMs );
+                pState->waiting = false;
+                pState->probe = false;
+                action = MQTT_KEEP_ALIVE_CLOSE;
+            }
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    if( ( action == MQTT_KEEP_ALIVE_WAIT ) && ( pState->waiting == false ) )
+    {
+        if( idleMs < pKeepAlive->intervalMs )
+        {
+            *pNextPeriodMs = pKeepAlive->intervalMs - idleMs;
+        }
+        else
+        {
+            pState->idleMs = idleMs;
+            pState->waiting = true;
+            action = MQTT_KEEP_ALIVE_SEND;
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    if( action == MQTT_KEEP_ALIVE_SEND )
+    {
+        ( pKeepAlive->pingreqs )++;
+        *pNextPeriodMs = IOT_MQTT_RESPONSE_WAIT_MS;
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    return action;
+}
+
+/*-----------------------------------------------------------*/
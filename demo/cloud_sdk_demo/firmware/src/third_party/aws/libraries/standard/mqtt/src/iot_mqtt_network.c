@@ -38,6 +38,7 @@
 #include "private/iot_mqtt_internal.h"
 
 /* Platform layer includes. */
+#include "platform/iot_clock.h"
 #include "platform/iot_threads.h"
 
 /* Atomics include. */
@@ -323,7 +324,9 @@ static IotMqttError_t _deserializeIncomingPacket( _mqttConnection_t * pMqttConne
         case MQTT_PACKET_TYPE_CONNACK:
             IotLogDebug( "(MQTT connection %p) CONNACK in data stream.", pMqttConnection );
 
-            /* Deserialize CONNACK and notify of result. */
+            /* Deserialize CONNACK and notify of result. The deserializer needs
+             * the connection to record the "Session Present" flag. */
+            pIncomingPacket->u.pMqttConnection = pMqttConnection;
             status = _getConnackDeserializer( pMqttConnection->pSerializer )( pIncomingPacket );
 
             pOperation = _IotMqtt_FindOperation( pMqttConnection,
@@ -458,6 +461,15 @@ static IotMqttError_t _deserializeIncomingPacket( _mqttConnection_t * pMqttConne
 
             if( pOperation != NULL )
             {
+                if( status == IOT_MQTT_SUCCESS )
+                {
+                    _IotMqtt_SamplePublishRtt( pOperation );
+                }
+                else
+                {
+                    EMPTY_ELSE_MARKER;
+                }
+
                 pOperation->u.operation.status = status;
                 _IotMqtt_Notify( pOperation );
             }
@@ -812,6 +824,9 @@ void IotMqtt_ReceiveCallback( IotNetworkConnection_t pNetworkConnection,
 
     if( status == IOT_MQTT_SUCCESS )
     {
+        /* Traffic defers the next PINGREQ of an adaptive keep-alive. */
+        pMqttConnection->lastReceiveMs = ( uint32_t ) IotClock_GetTimeMs();
+
         /* Deserialize the received packet. */
         status = _deserializeIncomingPacket( pMqttConnection,
                                              &incomingPacket );
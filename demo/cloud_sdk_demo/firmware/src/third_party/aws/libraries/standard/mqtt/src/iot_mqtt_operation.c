@@ -112,6 +112,16 @@ static bool _checkRetryLimit( _mqttOperation_t * pOperation );
  */
 static bool _scheduleNextRetry( _mqttOperation_t * pOperation );
 
+/**
+ * @brief Run the adaptive keep-alive of a connection and send its PINGREQ when
+ * due.
+ *
+ * @param[in] pMqttConnection The MQTT connection.
+ *
+ * @return `false` if the connection must be closed; `true` otherwise.
+ */
+static bool _processAdaptiveKeepAlive( _mqttConnection_t * pMqttConnection );
+
 /*-----------------------------------------------------------*/
 
 static bool _mqttOperation_match( const IotLink_t * pOperationLink,
@@ -246,6 +256,18 @@ static bool _scheduleNextRetry( _mqttOperation_t * pOperation )
     /* Increment the retry count. */
     ( pOperation->u.operation.periodic.retry.count )++;
 
+    /* An adaptive PUBLISH starts backing off from the connection's current
+     * retransmission timeout. */
+    if( ( pOperation->u.operation.periodic.retry.adaptive == true ) &&
+        ( pOperation->u.operation.periodic.retry.count == 1 ) )
+    {
+        pOperation->u.operation.periodic.retry.nextPeriodMs = pMqttConnection->rtoMs;
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
     /* Check for a response shortly for the final retry. Otherwise, calculate the
      * next retry period. */
     if( pOperation->u.operation.periodic.retry.count >
@@ -344,6 +366,77 @@ static bool _scheduleNextRetry( _mqttOperation_t * pOperation )
 
 /*-----------------------------------------------------------*/
 
+static bool _processAdaptiveKeepAlive( _mqttConnection_t * pMqttConnection )
+{
+    bool status = true;
+    size_t bytesSent = 0;
+    uint32_t nowMs = ( uint32_t ) IotClock_GetTimeMs();
+    uint32_t idleMs = nowMs - pMqttConnection->lastSendMs;
+    _mqttOperation_t * pPingreqOperation = &( pMqttConnection->pingreq );
+    bool pingrespReceived = ( Atomic_Add_u32( &( pPingreqOperation->u.operation.periodic.ping.failure ), 0 ) == 0 );
+
+    /* Idle time counts from the older of the last packet sent and received, so
+     * that a connection that keeps sending still finds out when nothing comes
+     * back. */
+    if( nowMs - pMqttConnection->lastReceiveMs > idleMs )
+    {
+        idleMs = nowMs - pMqttConnection->lastReceiveMs;
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    switch( _IotMqtt_KeepAliveStep( pPingreqOperation->u.operation.periodic.ping.pAdaptive,
+                                    &( pPingreqOperation->u.operation.periodic.ping.state ),
+                                    pPingreqOperation->u.operation.periodic.ping.keepAliveMs,
+                                    idleMs,
+                                    pingrespReceived,
+                                    &( pPingreqOperation->u.operation.periodic.ping.nextPeriodMs ) ) )
+    {
+        case MQTT_KEEP_ALIVE_SEND:
+            IotLogDebug( "(MQTT connection %p) Sending PINGREQ after %lu ms idle.",
+                         pMqttConnection,
+                         ( unsigned long ) idleMs );
+
+            /* Flag the failure first; a probe follows a PINGREQ that already
+             * left it set, and a quick PINGRESP must still clear it. */
+            ( void ) Atomic_OR_u32( &( pPingreqOperation->u.operation.periodic.ping.failure ), 1 );
+
+            bytesSent = pMqttConnection->pNetworkInterface->send( pMqttConnection->pNetworkConnection,
+                                                                  pPingreqOperation->u.operation.pMqttPacket,
+                                                                  pPingreqOperation->u.operation.packetSize );
+
+            if( bytesSent != pPingreqOperation->u.operation.packetSize )
+            {
+                IotLogError( "(MQTT connection %p) Failed to send PINGREQ.", pMqttConnection );
+                status = false;
+            }
+            else
+            {
+                pMqttConnection->lastSendMs = ( uint32_t ) IotClock_GetTimeMs();
+            }
+
+            break;
+
+        case MQTT_KEEP_ALIVE_CLOSE:
+            IotLogError( "(MQTT connection %p) No PINGRESP after %lu ms idle. Keep-alive limit "
+                         "is now %lu ms.",
+                         pMqttConnection,
+                         ( unsigned long ) pPingreqOperation->u.operation.periodic.ping.state.idleMs,
+                         ( unsigned long ) pPingreqOperation->u.operation.periodic.ping.pAdaptive->limitMs );
+            status = false;
+            break;
+
+        default:
+            break;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
 IotMqttError_t _IotMqtt_CreateOperation( _mqttConnection_t * pMqttConnection,
                                          uint32_t flags,
                                          const IotMqttCallbackInfo_t * pCallbackInfo,
@@ -575,6 +668,9 @@ void _IotMqtt_DestroyOperation( _mqttOperation_t * pOperation )
     IotMqtt_Assert( ( pOperation->u.operation.jobReference >= 0 ) &&
                     ( pOperation->u.operation.jobReference <= 2 ) );
 
+    /* A PUBLISH that failed before completing still holds its credit. */
+    _IotMqtt_ReleasePublishCredit( pOperation );
+
     /* Jobs to be destroyed should be removed from the MQTT connection's
      * lists. */
     IotMutex_Lock( &( pMqttConnection->referencesMutex ) );
@@ -670,17 +766,17 @@ void _IotMqtt_ProcessKeepAlive( IotTaskPool_t pTaskPool,
      * value is 65,535 seconds. */
     IotMqtt_Assert( pPingreqOperation->u.operation.periodic.ping.keepAliveMs <= 65535000 );
 
-    /* Only two values are valid for the next keep alive job delay. */
-    IotMqtt_Assert( ( pPingreqOperation->u.operation.periodic.ping.nextPeriodMs ==
-                      pPingreqOperation->u.operation.periodic.ping.keepAliveMs ) ||
-                    ( pPingreqOperation->u.operation.periodic.ping.nextPeriodMs
-                      == IOT_MQTT_RESPONSE_WAIT_MS ) );
-
     IotLogDebug( "(MQTT connection %p) Keep-alive job started.", pMqttConnection );
 
-    /* Determine whether to send a PINGREQ or check for PINGRESP. */
-    if( pPingreqOperation->u.operation.periodic.ping.nextPeriodMs ==
-        pPingreqOperation->u.operation.periodic.ping.keepAliveMs )
+    /* An adaptive keep-alive works out its own schedule. Otherwise, determine
+     * whether to send a PINGREQ or check for PINGRESP; only two values are
+     * valid for the next keep alive job delay. */
+    if( pPingreqOperation->u.operation.periodic.ping.pAdaptive != NULL )
+    {
+        status = _processAdaptiveKeepAlive( pMqttConnection );
+    }
+    else if( pPingreqOperation->u.operation.periodic.ping.nextPeriodMs ==
+             pPingreqOperation->u.operation.periodic.ping.keepAliveMs )
     {
         IotLogDebug( "(MQTT connection %p) Sending PINGREQ.", pMqttConnection );
 
@@ -698,6 +794,8 @@ void _IotMqtt_ProcessKeepAlive( IotTaskPool_t pTaskPool,
         }
         else
         {
+            pMqttConnection->lastSendMs = ( uint32_t ) IotClock_GetTimeMs();
+
             /* Assume the keep-alive will fail. The network receive callback will
              * clear the failure flag upon receiving a PINGRESP. */
             swapStatus = Atomic_CompareAndSwap_u32( &( pPingreqOperation->u.operation.periodic.ping.failure ),
@@ -715,6 +813,8 @@ void _IotMqtt_ProcessKeepAlive( IotTaskPool_t pTaskPool,
     }
     else
     {
+        IotMqtt_Assert( pPingreqOperation->u.operation.periodic.ping.nextPeriodMs == IOT_MQTT_RESPONSE_WAIT_MS );
+
         IotLogDebug( "(MQTT connection %p) Checking for PINGRESP.", pMqttConnection );
 
         if( Atomic_Add_u32( &( pPingreqOperation->u.operation.periodic.ping.failure ), 0 ) == 0 )
@@ -749,9 +849,10 @@ void _IotMqtt_ProcessKeepAlive( IotTaskPool_t pTaskPool,
                                                 &pKeepAliveJob );
         IotMqtt_Assert( taskPoolStatus == IOT_TASKPOOL_SUCCESS );
 
-        taskPoolStatus = IotTaskPool_ScheduleDeferred( pTaskPool,
-                                                       pKeepAliveJob,
-                                                       pPingreqOperation->u.operation.periodic.ping.nextPeriodMs );
+        taskPoolStatus = IotTaskPool_ScheduleDeferredWithFlags( pTaskPool,
+                                                                pKeepAliveJob,
+                                                                pPingreqOperation->u.operation.periodic.ping.nextPeriodMs,
+                                                                IOT_TASKPOOL_JOB_TIME_CRITICAL );
 
         if( taskPoolStatus == IOT_TASKPOOL_SUCCESS )
         {
@@ -843,7 +944,7 @@ void _IotMqtt_ProcessSend( IotTaskPool_t pTaskPool,
                            void * pContext )
 {
     size_t bytesSent = 0;
-    bool destroyOperation = false, waitable = false, networkPending = false;
+    bool destroyOperation = false, waitable = false, networkPending = false, stored = false;
     _mqttOperation_t * pOperation = ( _mqttOperation_t * ) pContext;
     _mqttConnection_t * pMqttConnection = pOperation->pMqttConnection;
 
@@ -861,8 +962,35 @@ void _IotMqtt_ProcessSend( IotTaskPool_t pTaskPool,
     /* Check if this operation is waitable. */
     waitable = ( pOperation->u.operation.flags & IOT_MQTT_FLAG_WAITABLE ) == IOT_MQTT_FLAG_WAITABLE;
 
+    /* A PUBLISH of a connection closed while this job was pending is kept in
+     * the connection's session. */
+    if( pMqttConnection->pSession != NULL )
+    {
+        IotMutex_Lock( &( pMqttConnection->referencesMutex ) );
+
+        if( pMqttConnection->disconnected == true )
+        {
+            stored = _IotMqtt_StorePublish( pOperation,
+                                            pOperation->u.operation.periodic.retry.count > 0 );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+
+        IotMutex_Unlock( &( pMqttConnection->referencesMutex ) );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
     /* Check PUBLISH retry counts and limits. */
-    if( pOperation->u.operation.periodic.retry.limit > 0 )
+    if( stored == true )
+    {
+        EMPTY_ELSE_MARKER;
+    }
+    else if( pOperation->u.operation.periodic.retry.limit > 0 )
     {
         if( _checkRetryLimit( pOperation ) == false )
         {
@@ -879,22 +1007,63 @@ void _IotMqtt_ProcessSend( IotTaskPool_t pTaskPool,
     }
 
     /* Send an operation that is waiting for a response. */
-    if( pOperation->u.operation.status == IOT_MQTT_STATUS_PENDING )
+    if( ( stored == false ) && ( pOperation->u.operation.status == IOT_MQTT_STATUS_PENDING ) )
     {
         IotLogDebug( "(MQTT connection %p, %s operation %p) Sending MQTT packet.",
                      pMqttConnection,
                      IotMqtt_OperationType( pOperation->u.operation.type ),
                      pOperation );
 
+        /* The round trip time is measured from the first transmission. */
+        if( pOperation->u.operation.transmissions == 0 )
+        {
+            pOperation->u.operation.sendTimeMs = IotClock_GetTimeMs();
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+
+        if( pOperation->u.operation.transmissions < UINT8_MAX )
+        {
+            ( pOperation->u.operation.transmissions )++;
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+
         /* Transmit the MQTT packet from the operation over the network. */
         bytesSent = pMqttConnection->pNetworkInterface->send( pMqttConnection->pNetworkConnection,
                                                               pOperation->u.operation.pMqttPacket,
                                                               pOperation->u.operation.packetSize );
 
-        /* Check transmission status. */
+        if( bytesSent == pOperation->u.operation.packetSize )
+        {
+            /* Traffic defers the next PINGREQ of an adaptive keep-alive. */
+            pMqttConnection->lastSendMs = ( uint32_t ) IotClock_GetTimeMs();
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+
+        /* Check transmission status. A PUBLISH that could not be sent is kept
+         * in the connection's session, if any, instead of failing. */
         if( bytesSent != pOperation->u.operation.packetSize )
         {
-            pOperation->u.operation.status = IOT_MQTT_NETWORK_ERROR;
+            IotMutex_Lock( &( pMqttConnection->referencesMutex ) );
+            stored = _IotMqtt_StorePublish( pOperation, true );
+            IotMutex_Unlock( &( pMqttConnection->referencesMutex ) );
+
+            if( stored == false )
+            {
+                pOperation->u.operation.status = IOT_MQTT_NETWORK_ERROR;
+            }
+            else
+            {
+                EMPTY_ELSE_MARKER;
+            }
         }
         else
         {
@@ -931,12 +1100,31 @@ void _IotMqtt_ProcessSend( IotTaskPool_t pTaskPool,
     }
     
     /* Check if this operation requires further processing. */
-    if( pOperation->u.operation.status == IOT_MQTT_STATUS_PENDING )
+    if( ( stored == false ) && ( pOperation->u.operation.status == IOT_MQTT_STATUS_PENDING ) )
     {
         /* Check if this operation should be scheduled for retransmission. */
         if( pOperation->u.operation.periodic.retry.limit > 0 )
         {
-            if( _scheduleNextRetry( pOperation ) == false )
+            /* A PUBLISH sent while its connection was being closed is kept in
+             * the session instead of being retried. Both are decided with the
+             * connection references mutex held, so that the connection cannot
+             * be closed in between. */
+            IotMutex_Lock( &( pMqttConnection->referencesMutex ) );
+
+            if( pMqttConnection->disconnected == true )
+            {
+                stored = _IotMqtt_StorePublish( pOperation, true );
+            }
+            else
+            {
+                EMPTY_ELSE_MARKER;
+            }
+
+            if( stored == true )
+            {
+                EMPTY_ELSE_MARKER;
+            }
+            else if( _scheduleNextRetry( pOperation ) == false )
             {
                 pOperation->u.operation.status = IOT_MQTT_SCHEDULING_ERROR;
             }
@@ -946,6 +1134,8 @@ void _IotMqtt_ProcessSend( IotTaskPool_t pTaskPool,
                  * from the network. */
                 networkPending = true;
             }
+
+            IotMutex_Unlock( &( pMqttConnection->referencesMutex ) );
         }
         else
         {
@@ -963,9 +1153,20 @@ void _IotMqtt_ProcessSend( IotTaskPool_t pTaskPool,
                 EMPTY_ELSE_MARKER;
             }
 
+            /* A PUBLISH sent while its connection was being closed is kept in
+             * the session, since the connection's lists were already emptied. */
+            if( ( destroyOperation == false ) && ( pMqttConnection->disconnected == true ) )
+            {
+                stored = _IotMqtt_StorePublish( pOperation, true );
+            }
+            else
+            {
+                EMPTY_ELSE_MARKER;
+            }
+
             /* If the operation should not be destroyed, transfer it from the
              * pending processing to the pending response list. */
-            if( destroyOperation == false )
+            if( ( destroyOperation == false ) && ( stored == false ) )
             {
                 if( IotLink_IsLinked( &( pOperation->link ) ) == true )
                 {
@@ -991,8 +1192,13 @@ void _IotMqtt_ProcessSend( IotTaskPool_t pTaskPool,
         EMPTY_ELSE_MARKER;
     }
 
-    /* Destroy the operation or notify of completion if necessary. */
-    if( destroyOperation == true )
+    /* Destroy the operation or notify of completion if necessary. A stored
+     * operation only releases its connection. */
+    if( stored == true )
+    {
+        _IotMqtt_DecrementConnectionReferences( pMqttConnection );
+    }
+    else if( destroyOperation == true )
     {
         _IotMqtt_DestroyOperation( pOperation );
     }
@@ -1066,6 +1272,7 @@ IotMqttError_t _IotMqtt_ScheduleOperation( _mqttOperation_t * pOperation,
 {
     IotMqttError_t status = IOT_MQTT_SUCCESS;
     IotTaskPoolError_t taskPoolStatus = IOT_TASKPOOL_SUCCESS;
+    uint32_t flags = 0;
 
     /* Check that job routine is valid. */
     IotMqtt_Assert( ( jobRoutine == _IotMqtt_ProcessSend ) ||
@@ -1078,11 +1285,26 @@ IotMqttError_t _IotMqtt_ScheduleOperation( _mqttOperation_t * pOperation,
                                             &( pOperation->jobStorage ),
                                             &( pOperation->job ) );
     IotMqtt_Assert( taskPoolStatus == IOT_TASKPOOL_SUCCESS );
- 
+
+    /* Only protocol bookkeeping goes to the time-critical lane: a PUBACK must
+     * not wait behind the callbacks of incoming PUBLISH messages, which may
+     * run for long. Completions run a user callback of their own, so they
+     * stay in the normal lane with the other callbacks. */
+    if( ( jobRoutine == _IotMqtt_ProcessSend ) &&
+        ( pOperation->u.operation.type == IOT_MQTT_PUBACK ) )
+    {
+        flags = IOT_TASKPOOL_JOB_TIME_CRITICAL;
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
     /* Schedule the new job with a delay. */
-    taskPoolStatus = IotTaskPool_ScheduleDeferred( IOT_SYSTEM_TASKPOOL,
-                                                   pOperation->job,
-                                                   delay );
+    taskPoolStatus = IotTaskPool_ScheduleDeferredWithFlags( IOT_SYSTEM_TASKPOOL,
+                                                            pOperation->job,
+                                                            delay,
+                                                            flags );
 
     if( taskPoolStatus != IOT_TASKPOOL_SUCCESS )
     {
@@ -1229,6 +1451,9 @@ void _IotMqtt_Notify( _mqttOperation_t * pOperation )
     /* Check if operation is waitable. */
     bool waitable = ( pOperation->u.operation.flags & IOT_MQTT_FLAG_WAITABLE ) == IOT_MQTT_FLAG_WAITABLE;
 
+    /* A completed PUBLISH no longer counts against the publish window. */
+    _IotMqtt_ReleasePublishCredit( pOperation );
+
     /* Remove any lingering subscriptions if a SUBSCRIBE failed. Rejected
      * subscriptions are removed by the deserializer, so not removed here. */
     if( pOperation->u.operation.type == IOT_MQTT_SUBSCRIBE )
@@ -164,6 +164,33 @@
     #endif /* ifndef AWS_IOT_METRICS_USERNAME */
 #endif /* if AWS_IOT_MQTT_ENABLE_METRICS == 1 || DOXYGEN == 1 */
 
+/**
+ * @brief Copy bytes into or out of a packet.
+ *
+ * The tests count the bytes copied, so that a serializer that starts copying
+ * more per packet fails them.
+ */
+#if IOT_BUILD_TESTS == 1
+    #define MQTT_SERIALIZE_COPY( pDestination, pSource, length ) \
+    do {                                                         \
+        ( void ) memcpy( pDestination, pSource, length );        \
+        _copiedBytes += ( size_t ) ( length );                   \
+    } while( 0 )
+#else
+    #define MQTT_SERIALIZE_COPY( pDestination, pSource, length ) \
+    ( ( void ) memcpy( pDestination, pSource, length ) )
+#endif
+
+/*-----------------------------------------------------------*/
+
+#if IOT_BUILD_TESTS == 1
+
+/**
+ * @brief Bytes copied by #MQTT_SERIALIZE_COPY.
+ */
+    static size_t _copiedBytes = 0;
+#endif
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -449,7 +476,7 @@ static uint8_t * _encodeString( uint8_t * pDestination,
     pDestination++;
 
     /* Copy the string into pDestination. */
-    ( void ) memcpy( pDestination, source, sourceLength );
+    MQTT_SERIALIZE_COPY( pDestination, source, sourceLength );
 
     /* Return the pointer to the end of the encoded string. */
     pDestination += sourceLength;
@@ -820,15 +847,15 @@ static void _serializeConnect( const IotMqttConnectInfo_t * pConnectInfo,
                     pBuffer += sizeof( uint16_t );
 
                     /* Write the identity portion of the username. */
-                    memcpy( pBuffer,
-                            pConnectInfo->pUserName,
-                            pConnectInfo->userNameLength );
+                    MQTT_SERIALIZE_COPY( pBuffer,
+                                         pConnectInfo->pUserName,
+                                         pConnectInfo->userNameLength );
                     pBuffer += pConnectInfo->userNameLength;
 
                     /* Write the metrics portion of the username. */
-                    memcpy( pBuffer,
-                            AWS_IOT_METRICS_USERNAME,
-                            AWS_IOT_METRICS_USERNAME_LENGTH );
+                    MQTT_SERIALIZE_COPY( pBuffer,
+                                         AWS_IOT_METRICS_USERNAME,
+                                         AWS_IOT_METRICS_USERNAME_LENGTH );
                     pBuffer += AWS_IOT_METRICS_USERNAME_LENGTH;
 
                     encodedUserName = true;
@@ -964,7 +991,7 @@ static void _serializePublish( const IotMqttPublishInfo_t * pPublishInfo,
     /* The payload is placed after the packet identifier. */
     if( pPublishInfo->payloadLength > 0 )
     {
-        ( void ) memcpy( pBuffer, pPublishInfo->pPayload, pPublishInfo->payloadLength );
+        MQTT_SERIALIZE_COPY( pBuffer, pPublishInfo->pPayload, pPublishInfo->payloadLength );
         pBuffer += pPublishInfo->payloadLength;
     }
     else
@@ -1340,6 +1367,16 @@ IotMqttError_t _IotMqtt_DeserializeConnack( _mqttPacket_t * pConnack )
                 &_logHideAll,
                 "CONNACK session present bit set." );
 
+        /* Record the flag in the connection, when there is one. */
+        if( pConnack->u.pMqttConnection != NULL )
+        {
+            pConnack->u.pMqttConnection->sessionPresent = true;
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+
         /* MQTT 3.1.1 specifies that the fourth byte in CONNACK must be 0 if the
          * "Session Present" bit is set. */
         if( pRemainingData[ 1 ] != 0 )
@@ -1921,10 +1958,15 @@ IotMqttError_t _IotMqtt_DeserializeSuback( _mqttPacket_t * pSuback )
                         &_logHideAll,
                         "Topic filter %lu refused.", ( unsigned long ) i );
 
-                /* Remove a rejected subscription from the subscription manager. */
-                _IotMqtt_RemoveSubscriptionByPacket( pSuback->u.pMqttConnection,
-                                                     pSuback->packetIdentifier,
-                                                     ( int32_t ) i );
+                /* Remove a rejected subscription from the subscription manager.
+                 * A SUBACK deserialized through the serializer API has no
+                 * connection, and so no subscriptions. */
+                if( pSuback->u.pMqttConnection != NULL )
+                {
+                    _IotMqtt_RemoveSubscriptionByPacket( pSuback->u.pMqttConnection,
+                                                         pSuback->packetIdentifier,
+                                                         ( int32_t ) i );
+                }
 
                 status = IOT_MQTT_SERVER_REFUSED;
 
@@ -2520,7 +2562,7 @@ IotMqttError_t IotMqtt_SerializeDisconnect( uint8_t * pBuffer,
      * Note: _IotMqtt_SerializeDisconnect always succeeds */
     _IotMqtt_SerializeDisconnect( &pDisconnectPacket, &remainingLength );
 
-    memcpy( pBuffer, pDisconnectPacket, MQTT_PACKET_DISCONNECT_SIZE );
+    MQTT_SERIALIZE_COPY( pBuffer, pDisconnectPacket, MQTT_PACKET_DISCONNECT_SIZE );
     IOT_FUNCTION_EXIT_NO_CLEANUP();
 }
 
@@ -2550,7 +2592,7 @@ IotMqttError_t IotMqtt_SerializePingreq( uint8_t * pBuffer,
      * static memory, there is no need to pass the buffer
      * Note: _IotMqtt_SerializePingReq always succeeds */
     _IotMqtt_SerializePingreq( &pPingreqPacket, &packetSize );
-    memcpy( pBuffer, pPingreqPacket, MQTT_PACKET_PINGREQ_SIZE );
+    MQTT_SERIALIZE_COPY( pBuffer, pPingreqPacket, MQTT_PACKET_PINGREQ_SIZE );
     IOT_FUNCTION_EXIT_NO_CLEANUP();
 }
 
@@ -2661,3 +2703,8 @@ IotMqttError_t IotMqtt_DeserializeResponse( IotMqttPacketInfo_t * pMqttPacket )
 }
 
 /*-----------------------------------------------------------*/
+
+/* Provide access to internal functions and variables if testing. */
+#if IOT_BUILD_TESTS == 1
+    #include "iot_test_access_mqtt_serialize.c"
+#endif
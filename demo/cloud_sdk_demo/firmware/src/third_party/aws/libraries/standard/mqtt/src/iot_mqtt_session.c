@@ -0,0 +1,486 @@
+/*
+ * IoT MQTT V2.1.0
+ * Copyright (C) 2018 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file iot_mqtt_session.c
+ * @brief Implements functions that keep unacknowledged PUBLISH messages across
+ * MQTT connections.
+ *
+ * A PUBLISH operation still waiting for its PUBACK when its connection is closed
+ * is detached from the connection and linked in the connection's session, with
+ * its packet and packet identifier untouched. The next connection established
+ * with the same session takes the operations back and sends them again.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <string.h>
+
+/* Error handling include. */
+#include "iot_error.h"
+
+/* MQTT internal include. */
+#include "private/iot_mqtt_internal.h"
+
+/* Platform layer includes. */
+#include "platform/iot_threads.h"
+
+/**
+ * @cond DOXYGEN_IGNORE
+ * Doxygen should ignore this section.
+ *
+ * Declaration of local MQTT serializer override selectors
+ */
+#if IOT_MQTT_ENABLE_SERIALIZER_OVERRIDES == 1
+    _SERIALIZER_OVERRIDE_SELECTOR( IotMqttPublishSetDup_t,
+                                   _getMqttPublishSetDupFunc,
+                                   _IotMqtt_PublishSetDup,
+                                   serialize.publishSetDup )
+    _SERIALIZER_OVERRIDE_SELECTOR( IotMqttFreePacket_t,
+                                   _getMqttFreePacketFunc,
+                                   _IotMqtt_FreePacket,
+                                   freePacket )
+#else  /* if IOT_MQTT_ENABLE_SERIALIZER_OVERRIDES == 1 */
+    #define _getMqttFreePacketFunc( pSerializer )       _IotMqtt_FreePacket
+    #define _getMqttPublishSetDupFunc( pSerializer )    _IotMqtt_PublishSetDup
+#endif /* if IOT_MQTT_ENABLE_SERIALIZER_OVERRIDES == 1 */
+/** @endcond */
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Check if an operation may be kept in its connection's session.
+ *
+ * @param[in] pOperation The operation to check.
+ *
+ * @return `true` for a pending QoS 1 PUBLISH that nobody waits on, on a
+ * connection with a session; `false` otherwise.
+ */
+static bool _publishStorable( const _mqttOperation_t * pOperation );
+
+/**
+ * @brief Order kept PUBLISH operations by packet identifier.
+ *
+ * Packet identifiers are handed out in sequence, so this is the order in which
+ * the messages were published. The identifiers in flight span much less than
+ * half the identifier space, which allows for wrap around.
+ *
+ * @param[in] pFirstLink Link of the first operation.
+ * @param[in] pSecondLink Link of the second operation.
+ *
+ * @return Less than 0 when the first operation was published before the second.
+ */
+static int32_t _publishCompare( const IotLink_t * const pFirstLink,
+                                const IotLink_t * const pSecondLink );
+
+/**
+ * @brief Move the unacknowledged PUBLISH operations of one list of a closed
+ * connection to its session.
+ *
+ * @param[in] pMqttConnection The closed MQTT connection.
+ * @param[in] pList Either list of operations of `pMqttConnection`.
+ * @param[in] sent Whether the operations of `pList` were sent at least once.
+ */
+static void _suspendList( _mqttConnection_t * pMqttConnection,
+                          IotListDouble_t * pList,
+                          bool sent );
+
+/*-----------------------------------------------------------*/
+
+static bool _publishStorable( const _mqttOperation_t * pOperation )
+{
+    bool status = false;
+
+    /* The operation union holds a PUBLISH to send unless it is incoming, and
+     * only QoS 1 and 2 PUBLISH messages have a packet identifier. */
+    if( ( pOperation->pMqttConnection->pSession != NULL ) &&
+        ( pOperation->incomingPublish == false ) )
+    {
+        status = ( pOperation->u.operation.type == IOT_MQTT_PUBLISH_TO_SERVER ) &&
+                 ( ( pOperation->u.operation.flags & IOT_MQTT_FLAG_WAITABLE ) == 0 ) &&
+                 ( pOperation->u.operation.status == IOT_MQTT_STATUS_PENDING ) &&
+                 ( pOperation->u.operation.packetIdentifier != 0 );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static int32_t _publishCompare( const IotLink_t * const pFirstLink,
+                                const IotLink_t * const pSecondLink )
+{
+    const _mqttOperation_t * pFirst = IotLink_Container( _mqttOperation_t, pFirstLink, link );
+    const _mqttOperation_t * pSecond = IotLink_Container( _mqttOperation_t, pSecondLink, link );
+
+    return ( int32_t ) ( int16_t ) ( pFirst->u.operation.packetIdentifier -
+                                     pSecond->u.operation.packetIdentifier );
+}
+
+/*-----------------------------------------------------------*/
+
+static void _suspendList( _mqttConnection_t * pMqttConnection,
+                          IotListDouble_t * pList,
+                          bool sent )
+{
+    IotLink_t * pLink = pList->pNext, * pNextLink = NULL;
+    _mqttOperation_t * pOperation = NULL;
+    IotTaskPoolError_t taskPoolStatus = IOT_TASKPOOL_SUCCESS;
+
+    while( pLink != pList )
+    {
+        /* Storing an operation unlinks it. */
+        pNextLink = pLink->pNext;
+        pOperation = IotLink_Container( _mqttOperation_t, pLink, link );
+
+        if( _publishStorable( pOperation ) == true )
+        {
+            taskPoolStatus = IotTaskPool_TryCancel( IOT_SYSTEM_TASKPOOL,
+                                                    pOperation->job,
+                                                    NULL );
+
+            /* A canceled job will not run. A PUBLISH without retry waiting for
+             * its PUBACK has a job that already returned. Any other job is
+             * executing and stores the operation itself. */
+            if( ( taskPoolStatus == IOT_TASKPOOL_SUCCESS ) ||
+                ( ( sent == true ) && ( pOperation->u.operation.periodic.retry.limit == 0 ) ) )
+            {
+                if( _IotMqtt_StorePublish( pOperation,
+                                           sent || ( pOperation->u.operation.periodic.retry.count > 0 ) ) == true )
+                {
+                    /* The caller still holds a reference, so the connection
+                     * is not destroyed here. */
+                    _IotMqtt_DecrementConnectionReferences( pMqttConnection );
+                }
+                else
+                {
+                    EMPTY_ELSE_MARKER;
+                }
+            }
+            else
+            {
+                EMPTY_ELSE_MARKER;
+            }
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+
+        pLink = pNextLink;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+bool _IotMqtt_StorePublish( _mqttOperation_t * pOperation,
+                            bool sent )
+{
+    bool status = false;
+    _mqttConnection_t * pMqttConnection = pOperation->pMqttConnection;
+    IotMqttSession_t * pSession = pMqttConnection->pSession;
+
+    if( _publishStorable( pOperation ) == true )
+    {
+        IotLogInfo( "(MQTT connection %p, PUBLISH operation %p) Keeping PUBLISH %hu "
+                    "for the next connection.",
+                    pMqttConnection,
+                    pOperation,
+                    pOperation->u.operation.packetIdentifier );
+
+        if( IotLink_IsLinked( &( pOperation->link ) ) == true )
+        {
+            IotListDouble_Remove( &( pOperation->link ) );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+
+        /* A PUBLISH sent before is a duplicate when sent again. */
+        if( sent == true )
+        {
+            _getMqttPublishSetDupFunc( pMqttConnection->pSerializer )( pOperation->u.operation.pMqttPacket,
+                                                                       NULL,
+                                                                       NULL );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+
+        /* The operation no longer belongs to any connection, nor to its
+         * publish window. */
+        _IotMqtt_ReleasePublishCredit( pOperation );
+        pOperation->pMqttConnection = NULL;
+
+        IotMutex_Lock( &( pSession->mutex ) );
+        pSession->pSerializer = pMqttConnection->pSerializer;
+        IotListDouble_InsertSorted( &( pSession->publishes ),
+                                    &( pOperation->link ),
+                                    _publishCompare );
+        ( pSession->stored )++;
+        ( pSession->pending )++;
+        IotMutex_Unlock( &( pSession->mutex ) );
+
+        status = true;
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+void _IotMqtt_SuspendSession( _mqttConnection_t * pMqttConnection )
+{
+    /* The connection must be closed so that no new operation is added. */
+    IotMqtt_Assert( pMqttConnection->disconnected == true );
+
+    if( pMqttConnection->pSession != NULL )
+    {
+        _suspendList( pMqttConnection, &( pMqttConnection->pendingProcessing ), false );
+        _suspendList( pMqttConnection, &( pMqttConnection->pendingResponse ), true );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void _IotMqtt_ResumeSession( _mqttConnection_t * pMqttConnection )
+{
+    IotMqttSession_t * pSession = pMqttConnection->pSession;
+    IotListDouble_t publishes = IOT_LIST_DOUBLE_INITIALIZER;
+    IotLink_t * pLink = NULL;
+    _mqttOperation_t * pOperation = NULL;
+    IotMqttError_t status = IOT_MQTT_SUCCESS;
+    uint32_t resent = 0;
+
+    /* Take the whole list, so that the session mutex is never held together
+     * with a references mutex in this order. */
+    IotListDouble_Create( &publishes );
+    IotMutex_Lock( &( pSession->mutex ) );
+
+    if( IotListDouble_IsEmpty( &( pSession->publishes ) ) == false )
+    {
+        publishes.pNext = pSession->publishes.pNext;
+        publishes.pPrevious = pSession->publishes.pPrevious;
+        publishes.pNext->pPrevious = &publishes;
+        publishes.pPrevious->pNext = &publishes;
+        IotListDouble_Create( &( pSession->publishes ) );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    IotMutex_Unlock( &( pSession->mutex ) );
+
+    /* Send the PUBLISH messages in the order they were first published. */
+    while( ( status == IOT_MQTT_SUCCESS ) &&
+           ( ( pLink = IotListDouble_RemoveHead( &publishes ) ) != NULL ) )
+    {
+        pOperation = IotLink_Container( _mqttOperation_t, pLink, link );
+
+        if( _IotMqtt_IncrementConnectionReferences( pMqttConnection ) == false )
+        {
+            /* Closed again already; wait for the next connection. */
+            IotListDouble_InsertHead( &publishes, pLink );
+            status = IOT_MQTT_NETWORK_ERROR;
+        }
+        else
+        {
+            pOperation->pMqttConnection = pMqttConnection;
+
+            /* Start over with the retries, round trip time and publish window
+             * of the new connection. A resent PUBLISH is not held back by a
+             * full window, but it takes a credit if there is one. */
+            pOperation->u.operation.periodic.retry.count = 0;
+            pOperation->u.operation.transmissions = 0;
+            pOperation->u.operation.windowCredit = ( pMqttConnection->publishWindow > 0 ) &&
+                                                   ( _IotMqtt_TakePublishCredit( pMqttConnection ) == true );
+
+            IotMutex_Lock( &( pMqttConnection->referencesMutex ) );
+
+            status = _IotMqtt_ScheduleOperation( pOperation,
+                                                 _IotMqtt_ProcessSend,
+                                                 0 );
+
+            if( status == IOT_MQTT_SUCCESS )
+            {
+                IotListDouble_InsertTail( &( pMqttConnection->pendingProcessing ),
+                                          &( pOperation->link ) );
+                resent++;
+            }
+            else
+            {
+                _IotMqtt_ReleasePublishCredit( pOperation );
+                pOperation->pMqttConnection = NULL;
+                IotListDouble_InsertHead( &publishes, pLink );
+            }
+
+            IotMutex_Unlock( &( pMqttConnection->referencesMutex ) );
+
+            if( status != IOT_MQTT_SUCCESS )
+            {
+                _IotMqtt_DecrementConnectionReferences( pMqttConnection );
+            }
+            else
+            {
+                EMPTY_ELSE_MARKER;
+            }
+        }
+    }
+
+    /* Give back whatever could not be sent, ahead of anything stored since. */
+    IotMutex_Lock( &( pSession->mutex ) );
+
+    while( ( pLink = IotListDouble_RemoveTail( &publishes ) ) != NULL )
+    {
+        IotListDouble_InsertHead( &( pSession->publishes ), pLink );
+    }
+
+    pSession->resent += resent;
+    pSession->pending -= resent;
+    IotMutex_Unlock( &( pSession->mutex ) );
+
+    if( resent > 0 )
+    {
+        IotLogInfo( "(MQTT connection %p) %lu PUBLISH messages of the session sent again.",
+                    pMqttConnection,
+                    ( unsigned long ) resent );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+IotMqttError_t IotMqtt_InitSession( IotMqttSession_t * pSession )
+{
+    IotMqttError_t status = IOT_MQTT_SUCCESS;
+
+    if( pSession == NULL )
+    {
+        IotLogError( "MQTT session must not be NULL." );
+
+        status = IOT_MQTT_BAD_PARAMETER;
+    }
+    else
+    {
+        ( void ) memset( pSession, 0x00, sizeof( IotMqttSession_t ) );
+
+        if( IotMutex_Create( &( pSession->mutex ), false ) == false )
+        {
+            IotLogError( "Failed to create MQTT session mutex." );
+
+            status = IOT_MQTT_NO_MEMORY;
+        }
+        else
+        {
+            IotListDouble_Create( &( pSession->publishes ) );
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMqtt_CleanupSession( IotMqttSession_t * pSession )
+{
+    IotLink_t * pLink = NULL;
+    _mqttOperation_t * pOperation = NULL;
+    IotMqttCallbackParam_t callbackParam = { 0 };
+
+    do
+    {
+        /* User callbacks are not invoked with the session mutex locked. */
+        IotMutex_Lock( &( pSession->mutex ) );
+        pLink = IotListDouble_RemoveHead( &( pSession->publishes ) );
+
+        if( pLink != NULL )
+        {
+            ( pSession->pending )--;
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+
+        IotMutex_Unlock( &( pSession->mutex ) );
+
+        if( pLink != NULL )
+        {
+            pOperation = IotLink_Container( _mqttOperation_t, pLink, link );
+
+            /* The callback of a PUBLISH given up is invoked like for a connection
+             * closed without a session. */
+            if( pOperation->u.operation.notify.callback.function != NULL )
+            {
+                callbackParam.mqttConnection = NULL;
+                callbackParam.u.operation.type = IOT_MQTT_PUBLISH_TO_SERVER;
+                callbackParam.u.operation.reference = pOperation;
+                callbackParam.u.operation.result = IOT_MQTT_NETWORK_ERROR;
+
+                pOperation->u.operation.notify.callback.function( pOperation->u.operation.notify.callback.pCallbackContext,
+                                                                  &callbackParam );
+            }
+            else
+            {
+                EMPTY_ELSE_MARKER;
+            }
+
+            _getMqttFreePacketFunc( pSession->pSerializer )( pOperation->u.operation.pMqttPacket );
+            IotMqtt_FreeOperation( pOperation );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+    } while( pLink != NULL );
+
+    IotMutex_Destroy( &( pSession->mutex ) );
+}
+
+/*-----------------------------------------------------------*/
+
+bool IotMqtt_SessionPresent( IotMqttConnection_t mqttConnection )
+{
+    return mqttConnection->sessionPresent;
+}
+
+/*-----------------------------------------------------------*/
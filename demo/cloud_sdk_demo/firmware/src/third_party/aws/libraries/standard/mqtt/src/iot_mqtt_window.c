@@ -0,0 +1,310 @@
+/*
+ * IoT MQTT V2.1.0
+ * Copyright (C) 2018 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/**
+ * @file iot_mqtt_window.c
+ * @brief Implements the publish window and the adaptive PUBLISH retry period.
+ *
+ * A connection with a publish window holds a counting semaphore with one credit
+ * per QoS 1 PUBLISH allowed to wait for its PUBACK. A PUBLISH takes a credit
+ * before its operation is created and gives it back once it stops waiting on the
+ * connection. The PUBACK round trip time of PUBLISH messages sent once is
+ * smoothed as TCP does (RFC 6298) into the retransmission timeout used as the
+ * first retry period of adaptive PUBLISH messages.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Error handling include. */
+#include "iot_error.h"
+
+/* MQTT internal include. */
+#include "private/iot_mqtt_internal.h"
+
+/* Platform layer includes. */
+#include "platform/iot_clock.h"
+#include "platform/iot_threads.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Operations of the static pool left for anything but outgoing PUBLISH
+ * messages.
+ */
+#define _POOL_RESERVED_OPERATIONS    ( 2 )
+
+/*-----------------------------------------------------------*/
+
+bool _IotMqtt_CreatePublishWindow( _mqttConnection_t * pMqttConnection,
+                                   uint16_t publishWindow )
+{
+    bool status = true;
+
+    #if IOT_STATIC_MEMORY_ONLY == 1
+        /* Without a limit, PUBLISH messages would take every operation of the
+         * pool and a PUBACK could not even be matched to an incoming PUBLISH. */
+        if( ( publishWindow == 0 ) ||
+            ( publishWindow > IOT_MQTT_MAX_IN_PROGRESS_OPERATIONS - _POOL_RESERVED_OPERATIONS ) )
+        {
+            publishWindow = IOT_MQTT_MAX_IN_PROGRESS_OPERATIONS - _POOL_RESERVED_OPERATIONS;
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+    #endif
+
+    pMqttConnection->publishWindow = publishWindow;
+    pMqttConnection->rttSamples = 0;
+    pMqttConnection->srttMs = 0;
+    pMqttConnection->rttVarMs = 0;
+    pMqttConnection->rtoMs = IOT_MQTT_ADAPTIVE_RETRY_INITIAL_MS;
+
+    if( publishWindow > 0 )
+    {
+        status = IotSemaphore_Create( &( pMqttConnection->publishCredits ),
+                                      publishWindow,
+                                      publishWindow );
+
+        if( status == false )
+        {
+            IotLogError( "Failed to create publish window for new connection." );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+void _IotMqtt_DestroyPublishWindow( _mqttConnection_t * pMqttConnection )
+{
+    if( pMqttConnection->publishWindow > 0 )
+    {
+        IotSemaphore_Destroy( &( pMqttConnection->publishCredits ) );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+bool _IotMqtt_TakePublishCredit( _mqttConnection_t * pMqttConnection )
+{
+    bool status = true;
+
+    if( pMqttConnection->publishWindow > 0 )
+    {
+        status = IotSemaphore_TryWait( &( pMqttConnection->publishCredits ) );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+void _IotMqtt_GivePublishCredit( _mqttConnection_t * pMqttConnection )
+{
+    if( pMqttConnection->publishWindow > 0 )
+    {
+        IotSemaphore_Post( &( pMqttConnection->publishCredits ) );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void _IotMqtt_ReleasePublishCredit( _mqttOperation_t * pOperation )
+{
+    _mqttConnection_t * pMqttConnection = pOperation->pMqttConnection;
+    bool release = false;
+
+    /* Incoming PUBLISH operations do not use the operation union. */
+    if( ( pMqttConnection != NULL ) && ( pOperation->incomingPublish == false ) )
+    {
+        /* The flag is cleared under the references mutex so that the credit is
+         * given back once, whichever of completion, destruction or the session
+         * gets here first. */
+        IotMutex_Lock( &( pMqttConnection->referencesMutex ) );
+        release = pOperation->u.operation.windowCredit;
+        pOperation->u.operation.windowCredit = false;
+        IotMutex_Unlock( &( pMqttConnection->referencesMutex ) );
+
+        if( release == true )
+        {
+            _IotMqtt_GivePublishCredit( pMqttConnection );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void _IotMqtt_SamplePublishRtt( const _mqttOperation_t * pOperation )
+{
+    _mqttConnection_t * pMqttConnection = pOperation->pMqttConnection;
+    uint64_t rtt = 0;
+    uint32_t rttMs = 0, deviationMs = 0, rtoMs = 0;
+
+    /* The PUBACK of a PUBLISH sent more than once may answer any of the copies
+     * (Karn's algorithm). */
+    if( pOperation->u.operation.transmissions == 1 )
+    {
+        rtt = IotClock_GetTimeMs() - pOperation->u.operation.sendTimeMs;
+        rttMs = ( rtt > IOT_MQTT_RETRY_MS_CEILING ) ? IOT_MQTT_RETRY_MS_CEILING : ( uint32_t ) rtt;
+
+        IotMutex_Lock( &( pMqttConnection->referencesMutex ) );
+
+        if( pMqttConnection->rttSamples == 0 )
+        {
+            pMqttConnection->srttMs = rttMs;
+            pMqttConnection->rttVarMs = rttMs / 2;
+        }
+        else
+        {
+            deviationMs = ( pMqttConnection->srttMs > rttMs ) ?
+                          ( pMqttConnection->srttMs - rttMs ) :
+                          ( rttMs - pMqttConnection->srttMs );
+
+            /* RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|, then SRTT = 7/8 SRTT + 1/8 R. */
+            pMqttConnection->rttVarMs = ( 3 * pMqttConnection->rttVarMs + deviationMs ) / 4;
+            pMqttConnection->srttMs = ( 7 * pMqttConnection->srttMs + rttMs ) / 8;
+        }
+
+        /* RTO = SRTT + max( G, 4 RTTVAR ), with a clock granularity G of 1 ms. */
+        rtoMs = pMqttConnection->srttMs +
+                ( ( pMqttConnection->rttVarMs > 0 ) ? 4 * pMqttConnection->rttVarMs : 1 );
+
+        if( rtoMs < IOT_MQTT_ADAPTIVE_RETRY_MIN_MS )
+        {
+            rtoMs = IOT_MQTT_ADAPTIVE_RETRY_MIN_MS;
+        }
+        else if( rtoMs > IOT_MQTT_RETRY_MS_CEILING )
+        {
+            rtoMs = IOT_MQTT_RETRY_MS_CEILING;
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+
+        pMqttConnection->rtoMs = rtoMs;
+        ( pMqttConnection->rttSamples )++;
+
+        IotMutex_Unlock( &( pMqttConnection->referencesMutex ) );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+bool IotMqtt_WaitPublishCredit( IotMqttConnection_t mqttConnection,
+                                uint32_t timeoutMs )
+{
+    bool status = true;
+
+    if( mqttConnection->publishWindow > 0 )
+    {
+        if( timeoutMs == 0 )
+        {
+            status = IotSemaphore_TryWait( &( mqttConnection->publishCredits ) );
+        }
+        else
+        {
+            status = IotSemaphore_TimedWait( &( mqttConnection->publishCredits ),
+                                             timeoutMs );
+        }
+
+        /* Leave the credit to the PUBLISH. */
+        if( status == true )
+        {
+            IotSemaphore_Post( &( mqttConnection->publishCredits ) );
+        }
+        else
+        {
+            EMPTY_ELSE_MARKER;
+        }
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMqtt_GetPublishStats( IotMqttConnection_t mqttConnection,
+                              IotMqttPublishStats_t * pStats )
+{
+    pStats->window = mqttConnection->publishWindow;
+    pStats->inFlight = 0;
+
+    if( mqttConnection->publishWindow > 0 )
+    {
+        pStats->inFlight = mqttConnection->publishWindow -
+                           IotSemaphore_GetCount( &( mqttConnection->publishCredits ) );
+    }
+    else
+    {
+        EMPTY_ELSE_MARKER;
+    }
+
+    IotMutex_Lock( &( mqttConnection->referencesMutex ) );
+    pStats->samples = mqttConnection->rttSamples;
+    pStats->srttMs = mqttConnection->srttMs;
+    pStats->rttVarMs = mqttConnection->rttVarMs;
+    pStats->retryMs = mqttConnection->rtoMs;
+    IotMutex_Unlock( &( mqttConnection->referencesMutex ) );
+}
+
+/*-----------------------------------------------------------*/
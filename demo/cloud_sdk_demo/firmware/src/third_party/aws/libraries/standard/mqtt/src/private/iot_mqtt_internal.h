@@ -83,6 +83,17 @@
 #if IOT_STATIC_MEMORY_ONLY == 1
     #include "iot_static_memory.h"
 
+/**
+ * @cond DOXYGEN_IGNORE
+ * Doxygen should ignore this section.
+ *
+ * Size of the static operation pool, which also bounds the publish window.
+ */
+    #ifndef IOT_MQTT_MAX_IN_PROGRESS_OPERATIONS
+        #define IOT_MQTT_MAX_IN_PROGRESS_OPERATIONS    ( 10 )
+    #endif
+/** @endcond */
+
 /**
  * @brief Allocate an #_mqttConnection_t. This function should have the same
  * signature as [malloc]
@@ -222,6 +233,18 @@
 #ifndef IOT_MQTT_RETRY_MS_CEILING
     #define IOT_MQTT_RETRY_MS_CEILING               ( 60000 )
 #endif
+#ifndef IOT_MQTT_ADAPTIVE_RETRY_INITIAL_MS
+    #define IOT_MQTT_ADAPTIVE_RETRY_INITIAL_MS      ( 1000 )
+#endif
+#ifndef IOT_MQTT_ADAPTIVE_RETRY_MIN_MS
+    #define IOT_MQTT_ADAPTIVE_RETRY_MIN_MS          ( 200 )
+#endif
+#ifndef IOT_MQTT_KEEP_ALIVE_MIN_MS
+    #define IOT_MQTT_KEEP_ALIVE_MIN_MS              ( 10000 )
+#endif
+#ifndef IOT_MQTT_KEEP_ALIVE_LIMIT_HOLD
+    #define IOT_MQTT_KEEP_ALIVE_LIMIT_HOLD          ( 32 )
+#endif
 /** @endcond */
 
 /**
@@ -310,6 +333,26 @@
 struct _mqttConnection;
 /** @endcond */
 
+/**
+ * @brief What the keep-alive job of a connection does next.
+ */
+typedef enum _mqttKeepAliveAction
+{
+    MQTT_KEEP_ALIVE_WAIT,  /**< @brief Run again later; nothing to send yet. */
+    MQTT_KEEP_ALIVE_SEND,  /**< @brief Send a PINGREQ and check for its PINGRESP. */
+    MQTT_KEEP_ALIVE_CLOSE  /**< @brief The connection is dead; close it. */
+} _mqttKeepAliveAction_t;
+
+/**
+ * @brief Per connection state of an adaptive keep-alive.
+ */
+typedef struct _mqttKeepAliveState
+{
+    bool waiting;    /**< @brief Whether a PINGREQ awaits its PINGRESP. */
+    bool probe;      /**< @brief Whether that PINGREQ follows a missed PINGRESP. */
+    uint32_t idleMs; /**< @brief Idle time of the connection when the first unanswered PINGREQ was sent. */
+} _mqttKeepAliveState_t;
+
 /**
  * @brief Internal structure representing a single MQTT operation, such as
  * CONNECT, SUBSCRIBE, PUBLISH, etc.
@@ -358,6 +401,7 @@ typedef struct _mqttOperation
                     uint32_t count;        /**< @brief Current number of retries. */
                     uint32_t limit;        /**< @brief Maximum number of retries allowed. */
                     uint32_t nextPeriodMs; /**< @brief Next retry period. */
+                    bool adaptive;         /**< @brief Whether the first retry period is the connection's retransmission timeout. */
                 } retry;                   /**< @brief Additional information for PUBLISH retry. */
 
                 struct
@@ -365,8 +409,16 @@ typedef struct _mqttOperation
                     uint32_t failure;      /**< @brief Flag tracking keep-alive status. */
                     uint32_t keepAliveMs;  /**< @brief Keep-alive interval in milliseconds. Its max value (per spec) is 65,535,000. */
                     uint32_t nextPeriodMs; /**< @brief Relative delay for next keep-alive job. */
+
+                    IotMqttKeepAlive_t * pAdaptive; /**< @brief #IotMqttConnectInfo_t.pKeepAlive; `NULL` for a fixed period. */
+                    _mqttKeepAliveState_t state;    /**< @brief Valid if pAdaptive is not `NULL`. */
                 } ping;                    /**< @brief Additional information for keep-alive pings. */
             } periodic;                    /**< @brief Additional information for periodic operations. */
+
+            /* Publish window and round trip time. */
+            bool windowCredit;     /**< @brief Whether this PUBLISH holds a credit of its connection's publish window. */
+            uint8_t transmissions; /**< @brief Times the packet was sent on this connection, up to UINT8_MAX. */
+            uint64_t sendTimeMs;   /**< @brief When the packet was first sent on this connection. */
         } operation;
 
         /* If incomingPublish is true, this struct is valid. */
@@ -391,6 +443,21 @@ typedef struct _mqttConnection
 
     const IotMqttSerializer_t * pSerializer;         /**< @brief MQTT packet serializer overrides. */
 
+    IotMqttSession_t * pSession;                     /**< @brief Keeps unacknowledged PUBLISH messages across connections. */
+    bool sessionPresent;                             /**< @brief Session present flag of the CONNACK. */
+
+    uint16_t publishWindow;                          /**< @brief Most QoS 1 PUBLISH awaiting a PUBACK; 0 for no limit. */
+    IotSemaphore_t publishCredits;                   /**< @brief Credits of the publish window; valid if publishWindow is not 0. */
+    uint32_t rttSamples;                             /**< @brief Number of PUBACK round trip times measured. */
+    uint32_t srttMs;                                 /**< @brief Smoothed PUBACK round trip time. */
+    uint32_t rttVarMs;                               /**< @brief PUBACK round trip time variation. */
+    uint32_t rtoMs;                                  /**< @brief Retransmission timeout for adaptive PUBLISH retry. */
+
+    /* Low 32 bits of IotClock_GetTimeMs(), so that they are read and written
+     * in one access from the network receive task and the task pool. */
+    uint32_t lastSendMs;                             /**< @brief When a packet was last sent. */
+    uint32_t lastReceiveMs;                          /**< @brief When a packet was last received. */
+
     bool disconnected;                               /**< @brief Tracks if this connection has been disconnected. */
     IotMutex_t referencesMutex;                      /**< @brief Recursive mutex. Grants access to connection state and operation lists. */
     int32_t references;                              /**< @brief Counts callbacks and operations using this connection. */
@@ -901,6 +968,145 @@ _mqttOperation_t * _IotMqtt_FindOperation( _mqttConnection_t * pMqttConnection,
  */
 void _IotMqtt_Notify( _mqttOperation_t * pOperation );
 
+/*------------------- MQTT publish window functions -------------------*/
+
+/**
+ * @brief Set up the publish window and round trip time estimate of a new
+ * connection.
+ *
+ * @param[in] pMqttConnection The new MQTT connection.
+ * @param[in] publishWindow #IotMqttConnectInfo_t.publishWindow.
+ *
+ * @return `true` on success; `false` if the credits could not be created.
+ */
+bool _IotMqtt_CreatePublishWindow( _mqttConnection_t * pMqttConnection,
+                                   uint16_t publishWindow );
+
+/**
+ * @brief Free the publish window of a connection being destroyed.
+ *
+ * @param[in] pMqttConnection The MQTT connection.
+ */
+void _IotMqtt_DestroyPublishWindow( _mqttConnection_t * pMqttConnection );
+
+/**
+ * @brief Take a credit of a connection's publish window for a new QoS 1 PUBLISH.
+ *
+ * @param[in] pMqttConnection The MQTT connection.
+ *
+ * @return `true` if a credit was taken or the window has no limit; `false` if
+ * the window is full.
+ */
+bool _IotMqtt_TakePublishCredit( _mqttConnection_t * pMqttConnection );
+
+/**
+ * @brief Give back a credit taken by #_IotMqtt_TakePublishCredit.
+ *
+ * @param[in] pMqttConnection The MQTT connection.
+ */
+void _IotMqtt_GivePublishCredit( _mqttConnection_t * pMqttConnection );
+
+/**
+ * @brief Give back the credit held by a PUBLISH operation, if any.
+ *
+ * Called wherever a PUBLISH stops waiting for a PUBACK on its connection: on
+ * completion, when destroyed and when kept in a session. Safe to call more than
+ * once.
+ *
+ * @param[in] pOperation The PUBLISH operation.
+ */
+void _IotMqtt_ReleasePublishCredit( _mqttOperation_t * pOperation );
+
+/**
+ * @brief Update the round trip time estimate of a connection with the PUBACK
+ * of a PUBLISH.
+ *
+ * PUBLISH messages sent more than once are ignored (Karn's algorithm).
+ *
+ * @param[in] pOperation The acknowledged PUBLISH operation.
+ */
+void _IotMqtt_SamplePublishRtt( const _mqttOperation_t * pOperation );
+
+/*--------------------- MQTT keep-alive functions --------------------*/
+
+/**
+ * @brief The idle time before a PINGREQ of an adaptive keep-alive, clamped to
+ * what the connection allows.
+ *
+ * @param[in] pKeepAlive #IotMqttConnectInfo_t.pKeepAlive.
+ * @param[in] keepAliveMs The keep-alive period accepted by the server.
+ *
+ * @return Between `IOT_MQTT_KEEP_ALIVE_MIN_MS` (or `keepAliveMs` if shorter)
+ * and `keepAliveMs`, and under #IotMqttKeepAlive_t.limitMs when set.
+ */
+uint32_t _IotMqtt_KeepAliveInterval( const IotMqttKeepAlive_t * pKeepAlive,
+                                     uint32_t keepAliveMs );
+
+/**
+ * @brief Run an adaptive keep-alive one step.
+ *
+ * Called by the keep-alive job each time it runs. Does no I/O, so that the
+ * policy can be exercised without a connection.
+ *
+ * @param[in,out] pKeepAlive #IotMqttConnectInfo_t.pKeepAlive, updated with
+ * the interval learned.
+ * @param[in,out] pState Keep-alive state of the connection.
+ * @param[in] keepAliveMs The keep-alive period accepted by the server.
+ * @param[in] idleMs Time since the connection last sent or received a packet,
+ * whichever is older.
+ * @param[in] pingrespReceived Whether the last PINGREQ was answered.
+ * @param[out] pNextPeriodMs When to run the keep-alive job again.
+ *
+ * @return What the keep-alive job must do.
+ */
+_mqttKeepAliveAction_t _IotMqtt_KeepAliveStep( IotMqttKeepAlive_t * pKeepAlive,
+                                               _mqttKeepAliveState_t * pState,
+                                               uint32_t keepAliveMs,
+                                               uint32_t idleMs,
+                                               bool pingrespReceived,
+                                               uint32_t * pNextPeriodMs );
+
+/*---------------------- MQTT session functions ----------------------*/
+
+/**
+ * @brief Move an unacknowledged PUBLISH from its connection to the connection's
+ * session.
+ *
+ * Only non-waitable PUBLISH operations with a packet identifier that are still
+ * pending are moved. The operation's job must not be scheduled. Must be called
+ * with the connection's references mutex locked; once it is unlocked, the caller
+ * must release the connection reference held by the operation with
+ * #_IotMqtt_DecrementConnectionReferences.
+ *
+ * @param[in] pOperation The PUBLISH operation to keep.
+ * @param[in] sent Whether the PUBLISH was sent at least once; if so, its DUP
+ * flag is set.
+ *
+ * @return `true` if the operation was moved to the session; `false` otherwise.
+ */
+bool _IotMqtt_StorePublish( _mqttOperation_t * pOperation,
+                            bool sent );
+
+/**
+ * @brief Move the unacknowledged PUBLISH operations of a closed connection to
+ * its session.
+ *
+ * Operations whose job is executing are left alone; #_IotMqtt_ProcessSend
+ * stores them. Must be called with the connection's references mutex locked
+ * and a connection reference held by the caller.
+ *
+ * @param[in] pMqttConnection The closed MQTT connection.
+ */
+void _IotMqtt_SuspendSession( _mqttConnection_t * pMqttConnection );
+
+/**
+ * @brief Send the PUBLISH operations kept in a session again over a new
+ * connection, with the DUP flag set.
+ *
+ * @param[in] pMqttConnection The newly established MQTT connection.
+ */
+void _IotMqtt_ResumeSession( _mqttConnection_t * pMqttConnection );
+
 /*----------------- MQTT subscription management functions ------------------*/
 
 /**
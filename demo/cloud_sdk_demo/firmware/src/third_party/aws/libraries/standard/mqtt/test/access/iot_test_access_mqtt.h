@@ -57,6 +57,13 @@ _mqttConnection_t * IotTestMqtt_createMqttConnection( bool awsIotMqttMode,
     ( uint16_t ) ( ( ( ( uint16_t ) ( *( ptr ) ) ) << 8 ) | \
                    ( ( uint16_t ) ( *( ptr + 1 ) ) ) )
 
+/**
+ * @brief Test access function for the bytes copied by #MQTT_SERIALIZE_COPY.
+ *
+ * @return The bytes copied into and out of packets so far.
+ */
+size_t IotTestMqtt_copiedBytes( void );
+
 /*----------------------- iot_mqtt_subscription.c -----------------------*/
 
 /* Internal data structures of iot_mqtt_subscription.c, redefined for the tests. */
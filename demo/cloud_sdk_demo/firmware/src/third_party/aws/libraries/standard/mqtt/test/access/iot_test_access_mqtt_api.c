@@ -39,7 +39,7 @@ _mqttConnection_t * IotTestMqtt_createMqttConnection( bool awsIotMqttMode,
                                                       const IotMqttNetworkInfo_t * pNetworkInfo,
                                                       uint16_t keepAliveSeconds )
 {
-    return _createMqttConnection( awsIotMqttMode, pNetworkInfo, keepAliveSeconds );
+    return _createMqttConnection( awsIotMqttMode, pNetworkInfo, keepAliveSeconds, 0 );
 }
 
 /*-----------------------------------------------------------*/
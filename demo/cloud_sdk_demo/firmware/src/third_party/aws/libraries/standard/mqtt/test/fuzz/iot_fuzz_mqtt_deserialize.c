@@ -0,0 +1,199 @@
+/*
+ * IoT MQTT V2.1.0
+ * Copyright (C) 2018 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file iot_fuzz_mqtt_deserialize.c
+ * @brief Fuzzing harness for the MQTT packet deserializers.
+ *
+ * Each input is read as one packet off the network. Its type and remaining
+ * length are decoded like the receive path does, and the rest of the packet is
+ * passed to the deserializer of its type in a buffer of exactly the remaining
+ * length, so that the sanitizers catch any read past the packet.
+ *
+ * The entry point builds as a libFuzzer target, or an AFL++ one with
+ * afl-clang-fast, from this file and the sources of the MQTT and common
+ * libraries:
+ *
+ *     clang -g -fsanitize=fuzzer,address,undefined -DIOT_BUILD_TESTS=1 \
+ *         <include paths> iot_fuzz_mqtt_deserialize.c <library sources>
+ *
+ * The tests of the MQTT_Unit_Serialize group run it over mutated packets.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <stdlib.h>
+#include <string.h>
+
+/* MQTT internal include. */
+#include "private/iot_mqtt_internal.h"
+
+/* MQTT serializer API include */
+#include "iot_mqtt_serialize.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The input being read as a packet.
+ */
+typedef struct _fuzzInput
+{
+    const uint8_t * pData; /**< @brief The input. */
+    size_t size;           /**< @brief Length of the input. */
+    size_t offset;         /**< @brief How much of the input was read. */
+} _fuzzInput_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Entry point of the harness, with the signature libFuzzer expects.
+ *
+ * @param[in] pData The input.
+ * @param[in] size Length of the input.
+ *
+ * @return Always `0`. A failure aborts.
+ */
+int LLVMFuzzerTestOneInput( const uint8_t * pData,
+                            size_t size );
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Network receive function that reads the input.
+ */
+static size_t _fuzzReceive( IotNetworkConnection_t pConnection,
+                            uint8_t * pBuffer,
+                            size_t bytesRequested )
+{
+    _fuzzInput_t * pInput = ( _fuzzInput_t * ) pConnection;
+    size_t bytesReceived = pInput->size - pInput->offset;
+
+    if( bytesReceived > bytesRequested )
+    {
+        bytesReceived = bytesRequested;
+    }
+
+    ( void ) memcpy( pBuffer, pInput->pData + pInput->offset, bytesReceived );
+    pInput->offset += bytesReceived;
+
+    return bytesReceived;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Next byte function of the generic remaining length decoder that reads the input.
+ */
+static IotMqttError_t _fuzzGetNextByte( void * pNetworkContext,
+                                        uint8_t * pNextByte )
+{
+    return ( _fuzzReceive( pNetworkContext, pNextByte, 1 ) == 1 ) ? IOT_MQTT_SUCCESS : IOT_MQTT_NETWORK_ERROR;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Check that a deserialized field lies in the packet.
+ */
+static bool _inPacket( const IotMqttPacketInfo_t * pPacket,
+                       const void * pField,
+                       size_t fieldLength )
+{
+    const uint8_t * pStart = ( const uint8_t * ) pField;
+
+    return ( fieldLength == 0 ) ||
+           ( ( pStart >= pPacket->pRemainingData ) &&
+             ( pStart + fieldLength <= pPacket->pRemainingData + pPacket->remainingLength ) );
+}
+
+/*-----------------------------------------------------------*/
+
+int LLVMFuzzerTestOneInput( const uint8_t * pData,
+                            size_t size )
+{
+    _fuzzInput_t input = { .pData = pData, .size = size, .offset = 0 };
+    IotNetworkInterface_t networkInterface;
+    IotMqttPacketInfo_t packet = IOT_MQTT_PACKET_INFO_INITIALIZER;
+    IotMqttError_t status = IOT_MQTT_STATUS_PENDING;
+    size_t remainingLength = 0, headerLength = 0;
+    uint8_t type = 0;
+
+    ( void ) memset( &networkInterface, 0x00, sizeof( IotNetworkInterface_t ) );
+    networkInterface.receive = _fuzzReceive;
+
+    /* Decode the fixed header like the receive path. */
+    type = _IotMqtt_GetPacketType( &input, &networkInterface );
+    remainingLength = _IotMqtt_GetRemainingLength( &input, &networkInterface );
+    headerLength = input.offset;
+
+    /* The decoder of the serializer API must agree. */
+    input.offset = ( size > 0 ) ? 1 : 0;
+
+    if( _IotMqtt_GetRemainingLength_Generic( &input, _fuzzGetNextByte ) != remainingLength )
+    {
+        abort();
+    }
+
+    /* The receive path drops a packet that is cut short. */
+    if( ( remainingLength == MQTT_REMAINING_LENGTH_INVALID ) ||
+        ( remainingLength > size - headerLength ) )
+    {
+        return 0;
+    }
+
+    /* A buffer of exactly the remaining length, and never NULL for the deserializers. */
+    packet.pRemainingData = malloc( ( remainingLength > 0 ) ? remainingLength : 1 );
+
+    if( packet.pRemainingData == NULL )
+    {
+        return 0;
+    }
+
+    ( void ) memcpy( packet.pRemainingData, pData + headerLength, remainingLength );
+    packet.remainingLength = remainingLength;
+    packet.type = type;
+
+    if( ( type & 0xf0 ) == MQTT_PACKET_TYPE_PUBLISH )
+    {
+        status = IotMqtt_DeserializePublish( &packet );
+
+        /* The topic name and payload of a PUBLISH point into the packet. */
+        if( ( status == IOT_MQTT_SUCCESS ) &&
+            ( ( _inPacket( &packet, packet.pubInfo.pTopicName, packet.pubInfo.topicNameLength ) == false ) ||
+              ( _inPacket( &packet, packet.pubInfo.pPayload, packet.pubInfo.payloadLength ) == false ) ) )
+        {
+            abort();
+        }
+    }
+    else
+    {
+        ( void ) IotMqtt_DeserializeResponse( &packet );
+    }
+
+    free( packet.pRemainingData );
+
+    return 0;
+}
+
+/*-----------------------------------------------------------*/
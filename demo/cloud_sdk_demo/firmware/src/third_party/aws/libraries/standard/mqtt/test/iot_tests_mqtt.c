@@ -46,8 +46,12 @@ void RunMqttTests( bool disableNetworkTests, bool disableLongTests )
 
     RUN_TEST_GROUP( MQTT_Unit_Subscription );
     RUN_TEST_GROUP( MQTT_Unit_Validate );
+    RUN_TEST_GROUP( MQTT_Unit_Serialize );
     RUN_TEST_GROUP( MQTT_Unit_Receive );
     RUN_TEST_GROUP( MQTT_Unit_API );
+    RUN_TEST_GROUP( MQTT_Unit_Session );
+    RUN_TEST_GROUP( MQTT_Unit_Window );
+    RUN_TEST_GROUP( MQTT_Unit_KeepAlive );
 
     if( disableNetworkTests == false )
     {
@@ -47,6 +47,9 @@
 /* Error handling include. */
 #include "iot_error.h"
 
+/* Atomics include. */
+#include "iot_atomic.h"
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -61,6 +64,11 @@
  */
 #define ACKNOWLEDGEMENT_PACKET_SIZE    ( 5 )
 
+/**
+ * @brief Answers of the mock broker that may be in flight at once.
+ */
+#define BROKER_ANSWERS                 ( 16 )
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -73,6 +81,15 @@ typedef struct _receiveContext
     size_t dataIndex;      /**< @brief Next byte of data to read. */
 } _receiveContext_t;
 
+/**
+ * @brief A packet of the mock broker, of up to 4 bytes.
+ */
+typedef struct _brokerPacket
+{
+    uint8_t pData[ 4 ];               /**< @brief The packet. */
+    _receiveContext_t receiveContext; /**< @brief Context to receive the packet. */
+} _brokerPacket_t;
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -107,6 +124,41 @@ static uint8_t _lastPacketType = 0;
  */
 static uint16_t _lastPacketIdentifier = 0;
 
+/**
+ * @brief Connection given to setReceiveCallback of the mock broker.
+ */
+static _mqttConnection_t * _pBrokerConnection = NULL;
+
+/**
+ * @brief Handler of the packets sent to the mock broker.
+ */
+static IotTestMqttBrokerHandler_t _brokerHandler = NULL;
+
+/**
+ * @brief Delay of the answers of the mock broker.
+ */
+static uint32_t _brokerAnswerDelayMs = 0;
+
+/**
+ * @brief "Session Present" flag of the CONNACK packets of the mock broker.
+ */
+static bool _brokerSessionPresent = false;
+
+/**
+ * @brief Answers of the mock broker in flight.
+ */
+static _brokerPacket_t _brokerAnswers[ BROKER_ANSWERS ];
+
+/**
+ * @brief Next free entry of #_brokerAnswers.
+ */
+static uint32_t _brokerNextAnswer = 0;
+
+/**
+ * @brief Posted for each answer of the mock broker processed.
+ */
+static IotSemaphore_t _brokerAnswerSem;
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -315,6 +367,126 @@ static size_t _receive( IotNetworkConnection_t pNetworkConnection,
 
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief Fill in a packet of the mock broker.
+ */
+static void _brokerSetPacket( _brokerPacket_t * pPacket,
+                              uint8_t type,
+                              uint8_t remainingLength,
+                              uint16_t variableHeader )
+{
+    IotTest_Assert( remainingLength <= 2 );
+
+    pPacket->pData[ 0 ] = type;
+    pPacket->pData[ 1 ] = remainingLength;
+    pPacket->pData[ 2 ] = UINT16_HIGH_BYTE( variableHeader );
+    pPacket->pData[ 3 ] = UINT16_LOW_BYTE( variableHeader );
+
+    pPacket->receiveContext.pData = pPacket->pData;
+    pPacket->receiveContext.dataLength = 2 + ( size_t ) remainingLength;
+    pPacket->receiveContext.dataIndex = 0;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A thread routine that delivers an answer of the mock broker.
+ */
+static void _brokerAnswerThread( void * pArgument )
+{
+    _brokerPacket_t * pPacket = ( _brokerPacket_t * ) pArgument;
+
+    IotClock_SleepMs( _brokerAnswerDelayMs );
+
+    IotMqtt_ReceiveCallback( ( IotNetworkConnection_t ) &( pPacket->receiveContext ),
+                             _pBrokerConnection );
+
+    IotSemaphore_Post( &_brokerAnswerSem );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Network send function of the mock broker.
+ */
+static size_t _brokerSend( IotNetworkConnection_t pNetworkConnection,
+                           const uint8_t * pMessage,
+                           size_t messageLength )
+{
+    size_t bytesSent = messageLength, index = 1;
+    uint16_t packetIdentifier = 0;
+
+    /* Ignore the network connection. */
+    ( void ) pNetworkConnection;
+
+    if( ( pMessage[ 0 ] & 0xf0 ) == MQTT_PACKET_TYPE_CONNECT )
+    {
+        /* The "Session Present" flag is the first byte after the remaining length. */
+        IotTest_MqttMockBrokerAnswer( MQTT_PACKET_TYPE_CONNACK,
+                                      2,
+                                      ( _brokerSessionPresent == true ) ? 0x0100 : 0x0000 );
+    }
+    else
+    {
+        /* A PUBLISH with QoS 1 or 2 has a packet identifier after the topic name. */
+        if( ( ( pMessage[ 0 ] & 0xf0 ) == MQTT_PACKET_TYPE_PUBLISH ) &&
+            ( ( pMessage[ 0 ] & 0x06 ) != 0 ) )
+        {
+            /* Skip the remaining length, then the topic name. */
+            while( ( pMessage[ index ] & 0x80 ) != 0 )
+            {
+                index++;
+            }
+
+            index++;
+            index += 2 + ( size_t ) UINT16_DECODE( pMessage + index );
+
+            packetIdentifier = UINT16_DECODE( pMessage + index );
+        }
+
+        if( _brokerHandler != NULL )
+        {
+            bytesSent = _brokerHandler( pMessage, messageLength, packetIdentifier );
+        }
+    }
+
+    return bytesSent;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Network function for setting the receive callback; records the MQTT
+ * connection for the mock broker.
+ */
+static IotNetworkError_t _brokerSetReceiveCallback( IotNetworkConnection_t pNetworkConnection,
+                                                    IotNetworkReceiveCallback_t receiveCallback,
+                                                    void * pReceiveContext )
+{
+    /* Silence warnings about unused parameters. */
+    ( void ) pNetworkConnection;
+    ( void ) receiveCallback;
+
+    _pBrokerConnection = ( _mqttConnection_t * ) pReceiveContext;
+
+    return IOT_NETWORK_SUCCESS;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A network close function of the mock broker that always succeeds.
+ */
+static IotNetworkError_t _brokerClose( IotNetworkConnection_t pNetworkConnection )
+{
+    /* Silence warnings about unused parameters. */
+    ( void ) pNetworkConnection;
+
+    return IOT_NETWORK_SUCCESS;
+}
+
+/*-----------------------------------------------------------*/
+
 bool IotTest_MqttMockInit( IotMqttConnection_t * pMqttConnection )
 {
     IOT_FUNCTION_ENTRY( bool, true );
@@ -407,3 +579,125 @@ void IotTest_MqttMockCleanup( void )
 }
 
 /*-----------------------------------------------------------*/
+
+bool IotTest_MqttMockReceivePublish( const char * pTopicName,
+                                     uint16_t topicNameLength,
+                                     const void * pPayload,
+                                     size_t payloadLength )
+{
+    IotMqttError_t status = IOT_MQTT_STATUS_PENDING;
+    IotMqttPublishInfo_t publishInfo = IOT_MQTT_PUBLISH_INFO_INITIALIZER;
+    uint8_t * pPacket = NULL;
+    size_t packetSize = 0;
+    uint16_t packetIdentifier = 0;
+    uint8_t * pPacketIdentifierHigh = NULL;
+    _receiveContext_t receiveContext = { 0 };
+
+    /* A QoS 0 PUBLISH needs no PUBACK, which the send function does not expect. */
+    publishInfo.qos = IOT_MQTT_QOS_0;
+    publishInfo.pTopicName = pTopicName;
+    publishInfo.topicNameLength = topicNameLength;
+    publishInfo.pPayload = pPayload;
+    publishInfo.payloadLength = payloadLength;
+
+    /* An incoming PUBLISH has the same format as an outgoing one. */
+    status = _IotMqtt_SerializePublish( &publishInfo,
+                                        &pPacket,
+                                        &packetSize,
+                                        &packetIdentifier,
+                                        &pPacketIdentifierHigh );
+
+    if( status == IOT_MQTT_SUCCESS )
+    {
+        receiveContext.pData = pPacket;
+        receiveContext.dataLength = packetSize;
+
+        IotMqtt_ReceiveCallback( ( IotNetworkConnection_t ) &receiveContext,
+                                 _pMqttConnection );
+
+        _IotMqtt_FreePacket( pPacket );
+    }
+
+    return( status == IOT_MQTT_SUCCESS );
+}
+
+/*-----------------------------------------------------------*/
+
+bool IotTest_MqttMockBrokerInit( IotMqttNetworkInfo_t * pNetworkInfo,
+                                 IotTestMqttBrokerHandler_t handler,
+                                 uint32_t answerDelayMs )
+{
+    /* Set the network interface functions of the mock broker. */
+    ( void ) memset( &_networkInterface, 0x00, sizeof( IotNetworkInterface_t ) );
+    _networkInterface.send = _brokerSend;
+    _networkInterface.receive = _receive;
+    _networkInterface.close = _brokerClose;
+    _networkInterface.setReceiveCallback = _brokerSetReceiveCallback;
+    pNetworkInfo->pNetworkInterface = &_networkInterface;
+
+    _pBrokerConnection = NULL;
+    _brokerHandler = handler;
+    _brokerAnswerDelayMs = answerDelayMs;
+    _brokerSessionPresent = false;
+    _brokerNextAnswer = 0;
+
+    return IotSemaphore_Create( &_brokerAnswerSem, 0, BROKER_ANSWERS );
+}
+
+/*-----------------------------------------------------------*/
+
+void IotTest_MqttMockBrokerCleanup( void )
+{
+    IotSemaphore_Destroy( &_brokerAnswerSem );
+
+    _pBrokerConnection = NULL;
+    _brokerHandler = NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+void IotTest_MqttMockBrokerSetSessionPresent( bool sessionPresent )
+{
+    _brokerSessionPresent = sessionPresent;
+}
+
+/*-----------------------------------------------------------*/
+
+void IotTest_MqttMockBrokerReceive( uint8_t type,
+                                    uint8_t remainingLength,
+                                    uint16_t variableHeader )
+{
+    _brokerPacket_t packet = { 0 };
+
+    _brokerSetPacket( &packet, type, remainingLength, variableHeader );
+
+    IotMqtt_ReceiveCallback( ( IotNetworkConnection_t ) &( packet.receiveContext ),
+                             _pBrokerConnection );
+}
+
+/*-----------------------------------------------------------*/
+
+void IotTest_MqttMockBrokerAnswer( uint8_t type,
+                                   uint8_t remainingLength,
+                                   uint16_t variableHeader )
+{
+    bool threadCreated = false;
+    _brokerPacket_t * pPacket = &( _brokerAnswers[ Atomic_Increment_u32( &_brokerNextAnswer ) % BROKER_ANSWERS ] );
+
+    _brokerSetPacket( pPacket, type, remainingLength, variableHeader );
+
+    threadCreated = Iot_CreateDetachedThread( _brokerAnswerThread,
+                                              pPacket,
+                                              IOT_THREAD_DEFAULT_PRIORITY,
+                                              IOT_THREAD_DEFAULT_STACK_SIZE );
+    IotTest_Assert( threadCreated == true );
+}
+
+/*-----------------------------------------------------------*/
+
+bool IotTest_MqttMockBrokerWaitAnswer( uint32_t timeoutMs )
+{
+    return IotSemaphore_TimedWait( &_brokerAnswerSem, timeoutMs );
+}
+
+/*-----------------------------------------------------------*/
@@ -60,4 +60,101 @@ bool IotTest_MqttMockInit( IotMqttConnection_t * pMqttConnection );
  */
 void IotTest_MqttMockCleanup( void );
 
+/**
+ * @brief Simulate a QoS 0 PUBLISH received from the server.
+ *
+ * The PUBLISH is passed to the receive callback of the mocked connection,
+ * which schedules the matching subscription callbacks.
+ *
+ * @param[in] pTopicName Topic name of the PUBLISH.
+ * @param[in] topicNameLength Length of `pTopicName`.
+ * @param[in] pPayload Payload of the PUBLISH.
+ * @param[in] payloadLength Length of `pPayload`.
+ *
+ * @return `true` if the PUBLISH was processed; `false` otherwise.
+ */
+bool IotTest_MqttMockReceivePublish( const char * pTopicName,
+                                     uint16_t topicNameLength,
+                                     const void * pPayload,
+                                     size_t payloadLength );
+
+/**
+ * @brief Handles a packet the MQTT library sent to the mock broker.
+ *
+ * The mock broker answers a CONNECT itself; every other packet is passed to
+ * the handler given to #IotTest_MqttMockBrokerInit.
+ *
+ * @param[in] pPacket The packet sent.
+ * @param[in] packetLength Length of `pPacket`.
+ * @param[in] packetIdentifier Packet identifier of a PUBLISH with QoS 1 or 2;
+ * `0` for any other packet.
+ *
+ * @return The number of bytes sent: `packetLength`, or `0` to simulate a
+ * network failure.
+ */
+typedef size_t ( * IotTestMqttBrokerHandler_t )( const uint8_t * pPacket,
+                                                 size_t packetLength,
+                                                 uint16_t packetIdentifier );
+
+/**
+ * @brief Set up a mock broker for the connections made with `pNetworkInfo`.
+ *
+ * Unlike #IotTest_MqttMockInit, the MQTT connections are made by the test with
+ * #IotMqtt_Connect; the mock broker answers each CONNECT with a CONNACK after
+ * `answerDelayMs`, and passes the other packets to `handler`.
+ *
+ * @param[out] pNetworkInfo Its network interface is set to the mock broker.
+ * @param[in] handler Called with the packets sent other than CONNECT.
+ * @param[in] answerDelayMs Delay of the answers of #IotTest_MqttMockBrokerAnswer.
+ *
+ * @return `true` if all initialization succeeded; `false` otherwise.
+ */
+bool IotTest_MqttMockBrokerInit( IotMqttNetworkInfo_t * pNetworkInfo,
+                                 IotTestMqttBrokerHandler_t handler,
+                                 uint32_t answerDelayMs );
+
+/**
+ * @brief Clean up the mock broker. Its answers must have been processed.
+ */
+void IotTest_MqttMockBrokerCleanup( void );
+
+/**
+ * @brief Set the "Session Present" flag of the next CONNACK packets.
+ */
+void IotTest_MqttMockBrokerSetSessionPresent( bool sessionPresent );
+
+/**
+ * @brief Pass a packet of the mock broker to the MQTT connection at once, from
+ * the calling thread.
+ *
+ * @param[in] type Type of the packet.
+ * @param[in] remainingLength Remaining length of the packet, `0` or `2`.
+ * @param[in] variableHeader The 2 bytes following the remaining length, e.g. a
+ * packet identifier.
+ */
+void IotTest_MqttMockBrokerReceive( uint8_t type,
+                                    uint8_t remainingLength,
+                                    uint16_t variableHeader );
+
+/**
+ * @brief Pass a packet of the mock broker to the MQTT connection from a thread
+ * of its own after the answer delay, as a network receive task would.
+ *
+ * The parameters are those of #IotTest_MqttMockBrokerReceive. Once the packet
+ * is processed, #IotTest_MqttMockBrokerWaitAnswer returns.
+ */
+void IotTest_MqttMockBrokerAnswer( uint8_t type,
+                                   uint8_t remainingLength,
+                                   uint16_t variableHeader );
+
+/**
+ * @brief Wait for an answer of the mock broker, including a CONNACK, to be
+ * processed.
+ *
+ * @param[in] timeoutMs How long to wait.
+ *
+ * @return `true` if an answer was processed; `false` on timeout.
+ */
+bool IotTest_MqttMockBrokerWaitAnswer( uint32_t timeoutMs );
+
 #endif /* ifndef IOT_TESTS_MQTT_MOCK_H_ */
@@ -0,0 +1,755 @@
+/*
+ * IoT MQTT V2.1.0
+ * Copyright (C) 2018 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file iot_tests_mqtt_keepalive.c
+ * @brief Tests for the adaptive keep-alive (#IotMqttConnectInfo_t.pKeepAlive).
+ *
+ * Besides the policy and a connection to a mock broker, a simulation runs the
+ * policy against a NAT gateway that drops idle mappings and prints the radio
+ * wakeups per hour of both the fixed and the adaptive keep-alive.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <string.h>
+
+/* SDK initialization include. */
+#include "iot_init.h"
+
+/* MQTT internal include. */
+#include "private/iot_mqtt_internal.h"
+
+/* Platform layer includes. */
+#include "platform/iot_clock.h"
+#include "platform/iot_threads.h"
+
+/* Atomics include. */
+#include "iot_atomic.h"
+
+/* MQTT mock include. */
+#include "iot_tests_mqtt_mock.h"
+
+/* Test framework includes. */
+#include "unity_fixture.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Timeout to use for the tests. This can be short, but should allow time
+ * for other threads to run.
+ */
+#define TIMEOUT_MS                  ( 400 )
+
+/**
+ * @brief Time taken by the mock broker to answer a packet.
+ */
+#define BROKER_DELAY_MS             ( 5 )
+
+/**
+ * @brief Period of the PUBLISH messages of #TEST_MQTT_Unit_KeepAlive_TrafficDefersPingreq.
+ */
+#define TRAFFIC_PERIOD_MS           ( 200 )
+
+/*
+ * Constants of the simulations of #TEST_MQTT_Unit_KeepAlive_Simulation and
+ * #TEST_MQTT_Unit_KeepAlive_TransientOutage.
+ */
+#define SIM_HOUR_MS                 ( 3600000U ) /**< @brief Length of the measured period. */
+#define SIM_WAKEUP_MERGE_MS         ( 100U )     /**< @brief Packets closer than this share a radio wakeup. */
+#define SIM_RECONNECT_WAKEUPS       ( 10U )      /**< @brief Radio wakeups of a TCP, TLS and MQTT reconnect. */
+#define SIM_BROKER_KEEP_ALIVE_MS    ( 1200000U ) /**< @brief Longest keep-alive accepted by the broker. */
+#define SIM_FIXED_KEEP_ALIVE_MS     ( 60000U )   /**< @brief Period of the fixed keep-alive, safe under most NAT timeouts. */
+#define SIM_TELEMETRY_OFFSET_MS     ( 500U )     /**< @brief First telemetry PUBLISH after a connect. */
+#define SIM_OUTAGE_MS               ( 60000U )   /**< @brief When the gateway restarts in #TEST_MQTT_Unit_KeepAlive_TransientOutage. */
+#define SIM_OUTAGE_HOURS            ( 8U )       /**< @brief Length of #TEST_MQTT_Unit_KeepAlive_TransientOutage. */
+
+/*
+ * Client identifier and length to use for the MQTT keep-alive tests.
+ */
+#define CLIENT_IDENTIFIER           ( "test" )                                           /**< @brief Client identifier. */
+#define CLIENT_IDENTIFIER_LENGTH    ( ( uint16_t ) ( sizeof( CLIENT_IDENTIFIER ) - 1 ) ) /**< @brief Length of client identifier. */
+
+/*
+ * Topic name and length to use for the MQTT keep-alive tests.
+ */
+#define TEST_TOPIC_NAME             ( "/test/topic" )                                  /**< @brief An arbitrary topic name. */
+#define TEST_TOPIC_NAME_LENGTH      ( ( uint16_t ) ( sizeof( TEST_TOPIC_NAME ) - 1 ) ) /**< @brief Length of topic name. */
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A network path through a NAT gateway, with a broker that answers at
+ * once, and the radio wakeups it costs.
+ */
+typedef struct _simNetwork
+{
+    uint32_t natTimeoutMs;   /**< @brief Idle time after which the gateway drops the mapping. */
+    uint32_t telemetryMs;    /**< @brief Period of the QoS 1 telemetry PUBLISH messages; 0 for none. */
+    uint64_t outageMs;       /**< @brief When the gateway restarts and drops every mapping; 0 for never. */
+    bool alive;              /**< @brief Whether the mapping of the connection exists. */
+    uint64_t lastSendMs;     /**< @brief When the client last sent a packet. */
+    uint64_t lastReceiveMs;  /**< @brief When the client last received a packet. */
+    uint64_t lastWakeupMs;   /**< @brief When the radio last woke up. */
+    uint64_t measureFromMs;  /**< @brief Wakeups before this time are not counted. */
+    uint32_t wakeups;        /**< @brief Radio wakeups counted. */
+    uint32_t reconnects;     /**< @brief Reconnects counted. */
+} _simNetwork_t;
+
+/**
+ * @brief A scenario of the simulation.
+ */
+typedef struct _simScenario
+{
+    const char * pName;    /**< @brief Printed with the results. */
+    uint32_t telemetryMs;  /**< @brief #_simNetwork_t.telemetryMs. */
+    uint32_t natTimeoutMs; /**< @brief #_simNetwork_t.natTimeoutMs. */
+} _simScenario_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Whether the mock broker answers PINGREQ packets.
+ */
+static bool _answerPingreq = true;
+
+/**
+ * @brief Number of PINGREQ packets sent to the mock broker.
+ */
+static uint32_t _pingreqCount = 0;
+
+/**
+ * @brief Posted when the disconnect callback is invoked.
+ */
+static IotSemaphore_t _disconnectSem;
+
+/**
+ * @brief Reason given to the last disconnect callback.
+ */
+static IotMqttDisconnectReason_t _disconnectReason;
+
+/**
+ * @brief An #IotMqttNetworkInfo_t to share among the tests.
+ */
+static IotMqttNetworkInfo_t _networkInfo = IOT_MQTT_NETWORK_INFO_INITIALIZER;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Handler of the packets sent to the mock broker; answers PUBLISH and,
+ * unless disabled, PINGREQ packets.
+ */
+static size_t _brokerHandler( const uint8_t * pPacket,
+                              size_t packetLength,
+                              uint16_t packetIdentifier )
+{
+    switch( pPacket[ 0 ] & 0xf0 )
+    {
+        case MQTT_PACKET_TYPE_PUBLISH:
+
+            /* Only QoS 1 PUBLISH messages are sent by the tests. */
+            IotTest_MqttMockBrokerAnswer( MQTT_PACKET_TYPE_PUBACK, 2, packetIdentifier );
+            break;
+
+        case MQTT_PACKET_TYPE_PINGREQ:
+            ( void ) Atomic_Increment_u32( &_pingreqCount );
+
+            if( _answerPingreq == true )
+            {
+                IotTest_MqttMockBrokerAnswer( MQTT_PACKET_TYPE_PINGRESP, 0, 0 );
+            }
+
+            break;
+
+        default:
+            break;
+    }
+
+    return packetLength;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief An MQTT disconnect callback that records its reason.
+ */
+static void _disconnectCallback( void * pCallbackContext,
+                                 IotMqttCallbackParam_t * pCallbackParam )
+{
+    /* Silence warnings about unused parameters. */
+    ( void ) pCallbackContext;
+
+    _disconnectReason = pCallbackParam->u.disconnectReason;
+    IotSemaphore_Post( &_disconnectSem );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Establish a connection with the mock broker, with a keep-alive of 1
+ * second; the adaptive interval is then always 1 second.
+ */
+static IotMqttConnection_t _connect( IotMqttKeepAlive_t * pKeepAlive )
+{
+    IotMqttConnection_t mqttConnection = IOT_MQTT_CONNECTION_INITIALIZER;
+    IotMqttConnectInfo_t connectInfo = IOT_MQTT_CONNECT_INFO_INITIALIZER;
+
+    connectInfo.pClientIdentifier = CLIENT_IDENTIFIER;
+    connectInfo.clientIdentifierLength = CLIENT_IDENTIFIER_LENGTH;
+    connectInfo.keepAliveSeconds = 1;
+    connectInfo.pKeepAlive = pKeepAlive;
+
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_Connect( &_networkInfo,
+                                                          &connectInfo,
+                                                          TIMEOUT_MS,
+                                                          &mqttConnection ) );
+
+    /* Let the mock broker thread return before going on. */
+    TEST_ASSERT_EQUAL_INT( true, IotTest_MqttMockBrokerWaitAnswer( TIMEOUT_MS ) );
+
+    return mqttConnection;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Record a packet sent by the client in a simulation; the broker
+ * answers at once if the mapping still exists.
+ *
+ * @return Whether the packet reached the broker.
+ */
+static bool _simSend( _simNetwork_t * pNetwork,
+                      uint64_t nowMs )
+{
+    uint64_t lastActivityMs = ( pNetwork->lastSendMs > pNetwork->lastReceiveMs ) ?
+                              pNetwork->lastSendMs : pNetwork->lastReceiveMs;
+
+    if( ( nowMs - pNetwork->lastWakeupMs >= SIM_WAKEUP_MERGE_MS ) &&
+        ( nowMs >= pNetwork->measureFromMs ) )
+    {
+        pNetwork->wakeups++;
+        pNetwork->lastWakeupMs = nowMs;
+    }
+
+    if( ( nowMs - lastActivityMs > pNetwork->natTimeoutMs ) ||
+        ( ( pNetwork->outageMs > lastActivityMs ) && ( pNetwork->outageMs <= nowMs ) ) )
+    {
+        pNetwork->alive = false;
+    }
+
+    pNetwork->lastSendMs = nowMs;
+
+    if( pNetwork->alive == true )
+    {
+        pNetwork->lastReceiveMs = nowMs;
+    }
+
+    return pNetwork->alive;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Reconnect in a simulation.
+ */
+static void _simReconnect( _simNetwork_t * pNetwork,
+                           uint64_t nowMs )
+{
+    if( nowMs >= pNetwork->measureFromMs )
+    {
+        pNetwork->wakeups += SIM_RECONNECT_WAKEUPS;
+        pNetwork->reconnects++;
+    }
+
+    pNetwork->alive = true;
+    pNetwork->lastSendMs = nowMs;
+    pNetwork->lastReceiveMs = nowMs;
+    pNetwork->lastWakeupMs = nowMs;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Run a connection over a simulated network path for some hours and
+ * count the radio wakeups of the last.
+ *
+ * @param[in] pNetwork The network path.
+ * @param[in,out] pKeepAlive The adaptive keep-alive; `NULL` for the fixed
+ * keep-alive of #SIM_FIXED_KEEP_ALIVE_MS, which sends a PINGREQ every period
+ * whatever the traffic, as the keep-alive job does without it.
+ * @param[in] hours How long to run.
+ */
+static void _simulate( _simNetwork_t * pNetwork,
+                       IotMqttKeepAlive_t * pKeepAlive,
+                       uint32_t hours )
+{
+    _mqttKeepAliveState_t state = { 0 };
+    _mqttKeepAliveAction_t action = MQTT_KEEP_ALIVE_WAIT;
+    uint64_t nowMs = 0, nextTelemetryMs = 0, nextKeepAliveMs = 0;
+    uint64_t endMs = ( uint64_t ) hours * SIM_HOUR_MS;
+    uint64_t oldestMs = 0;
+    uint32_t nextPeriodMs = 0;
+    bool answered = true, checking = false;
+
+    pNetwork->measureFromMs = endMs - SIM_HOUR_MS;
+    _simReconnect( pNetwork, 0 );
+    nextTelemetryMs = ( pNetwork->telemetryMs != 0 ) ? SIM_TELEMETRY_OFFSET_MS : UINT64_MAX;
+    nextKeepAliveMs = ( pKeepAlive != NULL ) ?
+                      _IotMqtt_KeepAliveInterval( pKeepAlive, SIM_BROKER_KEEP_ALIVE_MS ) :
+                      SIM_FIXED_KEEP_ALIVE_MS;
+
+    while( nowMs < endMs )
+    {
+        if( nextTelemetryMs <= nextKeepAliveMs )
+        {
+            nowMs = nextTelemetryMs;
+            ( void ) _simSend( pNetwork, nowMs );
+            nextTelemetryMs += pNetwork->telemetryMs;
+        }
+        else if( pKeepAlive != NULL )
+        {
+            nowMs = nextKeepAliveMs;
+            oldestMs = ( pNetwork->lastSendMs < pNetwork->lastReceiveMs ) ?
+                       pNetwork->lastSendMs : pNetwork->lastReceiveMs;
+            action = _IotMqtt_KeepAliveStep( pKeepAlive,
+                                             &state,
+                                             SIM_BROKER_KEEP_ALIVE_MS,
+                                             ( uint32_t ) ( nowMs - oldestMs ),
+                                             answered,
+                                             &nextPeriodMs );
+
+            if( action == MQTT_KEEP_ALIVE_SEND )
+            {
+                answered = _simSend( pNetwork, nowMs );
+            }
+            else if( action == MQTT_KEEP_ALIVE_CLOSE )
+            {
+                _simReconnect( pNetwork, nowMs );
+                answered = true;
+                nextPeriodMs = _IotMqtt_KeepAliveInterval( pKeepAlive, SIM_BROKER_KEEP_ALIVE_MS );
+                nextTelemetryMs = ( pNetwork->telemetryMs != 0 ) ? nowMs + SIM_TELEMETRY_OFFSET_MS : UINT64_MAX;
+            }
+
+            nextKeepAliveMs = nowMs + nextPeriodMs;
+        }
+        else
+        {
+            nowMs = nextKeepAliveMs;
+
+            if( checking == false )
+            {
+                answered = _simSend( pNetwork, nowMs );
+                checking = true;
+                nextKeepAliveMs = nowMs + IOT_MQTT_RESPONSE_WAIT_MS;
+            }
+            else
+            {
+                if( answered == false )
+                {
+                    _simReconnect( pNetwork, nowMs );
+                    nextTelemetryMs = ( pNetwork->telemetryMs != 0 ) ? nowMs + SIM_TELEMETRY_OFFSET_MS : UINT64_MAX;
+                }
+
+                checking = false;
+                nextKeepAliveMs = nowMs + SIM_FIXED_KEEP_ALIVE_MS;
+            }
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test group for MQTT keep-alive tests.
+ */
+TEST_GROUP( MQTT_Unit_KeepAlive );
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test setup for MQTT keep-alive tests.
+ */
+TEST_SETUP( MQTT_Unit_KeepAlive )
+{
+    _answerPingreq = true;
+    _pingreqCount = 0;
+
+    /* Reset the network info; its interface is the mock broker. */
+    ( void ) memset( &_networkInfo, 0x00, sizeof( IotMqttNetworkInfo_t ) );
+    _networkInfo.disconnectCallback.function = _disconnectCallback;
+
+    /* Initialize libraries. */
+    TEST_ASSERT_EQUAL_INT( true, IotSdk_Init() );
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_Init() );
+
+    TEST_ASSERT_EQUAL_INT( true, IotTest_MqttMockBrokerInit( &_networkInfo,
+                                                             _brokerHandler,
+                                                             BROKER_DELAY_MS ) );
+    TEST_ASSERT_EQUAL_INT( true, IotSemaphore_Create( &_disconnectSem, 0, 1 ) );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test tear down for MQTT keep-alive tests.
+ */
+TEST_TEAR_DOWN( MQTT_Unit_KeepAlive )
+{
+    IotSemaphore_Destroy( &_disconnectSem );
+    IotTest_MqttMockBrokerCleanup();
+
+    IotMqtt_Cleanup();
+    IotSdk_Cleanup();
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test group runner for MQTT keep-alive tests.
+ */
+TEST_GROUP_RUNNER( MQTT_Unit_KeepAlive )
+{
+    RUN_TEST_CASE( MQTT_Unit_KeepAlive, Policy );
+    RUN_TEST_CASE( MQTT_Unit_KeepAlive, TrafficDefersPingreq );
+    RUN_TEST_CASE( MQTT_Unit_KeepAlive, MissedPingresp );
+    RUN_TEST_CASE( MQTT_Unit_KeepAlive, LimitAging );
+    RUN_TEST_CASE( MQTT_Unit_KeepAlive, Simulation );
+    RUN_TEST_CASE( MQTT_Unit_KeepAlive, TransientOutage );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests how the interval grows, backs off and learns its limit.
+ */
+TEST( MQTT_Unit_KeepAlive, Policy )
+{
+    IotMqttKeepAlive_t keepAlive = { 0 };
+    _mqttKeepAliveState_t state = { 0 };
+    const uint32_t keepAliveMs = 60000;
+    uint32_t nextPeriodMs = 0;
+
+    /* Start from the shortest interval, and wait for the rest of it. */
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_WAIT, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 4000, true, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL_UINT32( IOT_MQTT_KEEP_ALIVE_MIN_MS, keepAlive.intervalMs );
+    TEST_ASSERT_EQUAL_UINT32( IOT_MQTT_KEEP_ALIVE_MIN_MS - 4000, nextPeriodMs );
+
+    /* Each PINGRESP grows the interval by half, up to the keep-alive. */
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_SEND, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 10000, false, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL_UINT32( IOT_MQTT_RESPONSE_WAIT_MS, nextPeriodMs );
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_WAIT, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 0, true, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL_UINT32( 15000, keepAlive.intervalMs );
+    TEST_ASSERT_EQUAL_UINT32( 15000, nextPeriodMs );
+
+    keepAlive.intervalMs = 50000;
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_SEND, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 50000, false, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_WAIT, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 0, true, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL_UINT32( keepAliveMs, keepAlive.intervalMs );
+    TEST_ASSERT_EQUAL_UINT32( 2, keepAlive.pingreqs );
+
+    /* A missed PINGRESP halves the interval and sends a probe at once; an
+     * answered probe does not grow it again. */
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_SEND, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 60000, false, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_SEND, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 1000, false, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL_UINT32( 30000, keepAlive.intervalMs );
+    TEST_ASSERT_EQUAL_UINT32( 1, keepAlive.missed );
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_WAIT, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 0, true, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL_UINT32( 30000, keepAlive.intervalMs );
+    TEST_ASSERT_EQUAL_UINT32( 0, keepAlive.limitMs );
+
+    /* A missed probe closes the connection and sets the limit to the idle
+     * time of the first PINGREQ. */
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_SEND, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 32000, false, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_SEND, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 1000, false, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_CLOSE, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 1000, false, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL_UINT32( 32000, keepAlive.limitMs );
+    TEST_ASSERT_EQUAL_UINT32( 3, keepAlive.missed );
+
+    /* From then on the interval stays an eighth under the limit. */
+    keepAlive.intervalMs = keepAliveMs;
+    TEST_ASSERT_EQUAL_UINT32( 28000, _IotMqtt_KeepAliveInterval( &keepAlive, keepAliveMs ) );
+
+    /* Never under the shortest interval, nor over a short keep-alive. */
+    keepAlive.limitMs = 1000;
+    TEST_ASSERT_EQUAL_UINT32( IOT_MQTT_KEEP_ALIVE_MIN_MS, _IotMqtt_KeepAliveInterval( &keepAlive, keepAliveMs ) );
+    TEST_ASSERT_EQUAL_UINT32( 5000, _IotMqtt_KeepAliveInterval( &keepAlive, 5000 ) );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests how the limit is raised again, and restored when the raise does
+ * not hold.
+ */
+TEST( MQTT_Unit_KeepAlive, LimitAging )
+{
+    IotMqttKeepAlive_t keepAlive = { 0 };
+    _mqttKeepAliveState_t state = { 0 };
+    const uint32_t keepAliveMs = 60000;
+    uint32_t nextPeriodMs = 0;
+
+    keepAlive.intervalMs = 28000;
+    keepAlive.limitMs = 32000;
+    keepAlive.limitHold = 2;
+
+    /* PINGREQs answered under the limit do not age it. */
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_SEND, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 28000, false, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_SEND, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 1000, false, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_WAIT, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 0, true, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_SEND, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 14000, false, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_WAIT, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 0, true, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL_UINT32( 0, keepAlive.limitAge );
+    TEST_ASSERT_EQUAL_UINT32( 21000, keepAlive.intervalMs );
+
+    /* The limit is raised by half after limitHold PINGREQs answered at it. */
+    keepAlive.intervalMs = 28000;
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_SEND, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 28000, false, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_WAIT, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 0, true, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL_UINT32( 1, keepAlive.limitAge );
+    TEST_ASSERT_EQUAL_UINT32( 28000, keepAlive.intervalMs );
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_SEND, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 28000, false, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_WAIT, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 0, true, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL_UINT32( 0, keepAlive.limitAge );
+    TEST_ASSERT_EQUAL_UINT32( 48000, keepAlive.limitMs );
+    TEST_ASSERT_EQUAL_UINT32( 32000, keepAlive.raisedFromMs );
+    TEST_ASSERT_EQUAL_UINT32( 42000, keepAlive.intervalMs );
+
+    /* A PINGREQ answered past the old limit confirms the raise. */
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_SEND, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 42000, false, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_WAIT, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 0, true, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL_UINT32( 0, keepAlive.raisedFromMs );
+    TEST_ASSERT_EQUAL_UINT32( 0, keepAlive.limitHold );
+    TEST_ASSERT_EQUAL_UINT32( 48000, keepAlive.limitMs );
+    TEST_ASSERT_EQUAL_UINT32( 42000, keepAlive.intervalMs );
+
+    /* A raise that does not hold restores the old limit, and the next raise
+     * waits twice as long. */
+    keepAlive.limitHold = 1;
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_SEND, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 42000, false, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_WAIT, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 0, true, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL_UINT32( 72000, keepAlive.limitMs );
+    TEST_ASSERT_EQUAL_UINT32( keepAliveMs, keepAlive.intervalMs );
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_SEND, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 60000, false, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_SEND, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 1000, false, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_CLOSE, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 1000, false, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL_UINT32( 48000, keepAlive.limitMs );
+    TEST_ASSERT_EQUAL_UINT32( 0, keepAlive.raisedFromMs );
+    TEST_ASSERT_EQUAL_UINT32( 2, keepAlive.limitHold );
+    TEST_ASSERT_EQUAL_UINT32( 30000, keepAlive.intervalMs );
+
+    /* A raise past the keep-alive drops the limit once it holds. */
+    keepAlive.limitHold = 1;
+    keepAlive.limitMs = 56000;
+    keepAlive.intervalMs = 49000;
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_SEND, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 49000, false, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_WAIT, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 0, true, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_SEND, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 60000, false, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL( MQTT_KEEP_ALIVE_WAIT, _IotMqtt_KeepAliveStep( &keepAlive, &state, keepAliveMs, 0, true, &nextPeriodMs ) );
+    TEST_ASSERT_EQUAL_UINT32( 0, keepAlive.limitMs );
+    TEST_ASSERT_EQUAL_UINT32( keepAliveMs, keepAlive.intervalMs );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that no PINGREQ is sent while PUBLISH messages flow, and that
+ * one is sent once the connection is idle.
+ */
+TEST( MQTT_Unit_KeepAlive, TrafficDefersPingreq )
+{
+    IotMqttConnection_t mqttConnection = IOT_MQTT_CONNECTION_INITIALIZER;
+    IotMqttKeepAlive_t keepAlive = { 0 };
+    IotMqttPublishInfo_t publishInfo = IOT_MQTT_PUBLISH_INFO_INITIALIZER;
+    IotMqttCallbackInfo_t callbackInfo = IOT_MQTT_CALLBACK_INFO_INITIALIZER;
+    IotMqttOperation_t publishOperation = IOT_MQTT_OPERATION_INITIALIZER;
+    int i = 0;
+
+    mqttConnection = _connect( &keepAlive );
+
+    publishInfo.qos = IOT_MQTT_QOS_1;
+    publishInfo.pTopicName = TEST_TOPIC_NAME;
+    publishInfo.topicNameLength = TEST_TOPIC_NAME_LENGTH;
+    publishInfo.pPayload = "";
+    publishInfo.retryMs = 1000;
+    publishInfo.retryLimit = 0;
+
+    /* Three seconds of PUBLISH and PUBACK, three times the keep-alive. */
+    for( i = 0; i < 3000 / TRAFFIC_PERIOD_MS; i++ )
+    {
+        TEST_ASSERT_EQUAL( IOT_MQTT_STATUS_PENDING, IotMqtt_PublishAsync( mqttConnection,
+                                                                         &publishInfo,
+                                                                         IOT_MQTT_FLAG_WAITABLE,
+                                                                         NULL,
+                                                                         &publishOperation ) );
+        TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_Wait( publishOperation, TIMEOUT_MS ) );
+        TEST_ASSERT_EQUAL_INT( true, IotTest_MqttMockBrokerWaitAnswer( TIMEOUT_MS ) );
+        IotClock_SleepMs( TRAFFIC_PERIOD_MS );
+    }
+
+    TEST_ASSERT_EQUAL_UINT32( 0, Atomic_Add_u32( &_pingreqCount, 0 ) );
+    TEST_ASSERT_EQUAL_UINT32( 0, keepAlive.pingreqs );
+
+    /* Idle for longer than the keep-alive. */
+    IotClock_SleepMs( 1000 + TIMEOUT_MS );
+    TEST_ASSERT_EQUAL_INT( true, IotTest_MqttMockBrokerWaitAnswer( TIMEOUT_MS ) );
+    TEST_ASSERT_EQUAL_UINT32( 1, Atomic_Add_u32( &_pingreqCount, 0 ) );
+    TEST_ASSERT_EQUAL_UINT32( 1, keepAlive.pingreqs );
+    TEST_ASSERT_EQUAL_UINT32( 0, keepAlive.missed );
+    TEST_ASSERT_EQUAL_UINT32( 1000, keepAlive.intervalMs );
+
+    IotMqtt_Disconnect( mqttConnection, 0 );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that a connection whose PINGREQ and probe are not answered is
+ * closed, and that its idle time is learned as the limit.
+ */
+TEST( MQTT_Unit_KeepAlive, MissedPingresp )
+{
+    IotMqttConnection_t mqttConnection = IOT_MQTT_CONNECTION_INITIALIZER;
+    IotMqttKeepAlive_t keepAlive = { 0 };
+
+    _answerPingreq = false;
+    mqttConnection = _connect( &keepAlive );
+
+    TEST_ASSERT_EQUAL_INT( true, IotSemaphore_TimedWait( &_disconnectSem,
+                                                         1000 + 2 * IOT_MQTT_RESPONSE_WAIT_MS + TIMEOUT_MS ) );
+    TEST_ASSERT_EQUAL( IOT_MQTT_KEEP_ALIVE_TIMEOUT, _disconnectReason );
+    TEST_ASSERT_EQUAL_UINT32( 2, Atomic_Add_u32( &_pingreqCount, 0 ) );
+    TEST_ASSERT_EQUAL_UINT32( 2, keepAlive.pingreqs );
+    TEST_ASSERT_EQUAL_UINT32( 2, keepAlive.missed );
+    TEST_ASSERT_UINT32_WITHIN( TIMEOUT_MS / 2, 1000 + TIMEOUT_MS / 2, keepAlive.limitMs );
+
+    IotMqtt_Disconnect( mqttConnection, IOT_MQTT_FLAG_CLEANUP_ONLY );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Simulates an hour of a connection behind a NAT gateway, after an hour
+ * to learn the interval, and prints the radio wakeups of the fixed and the
+ * adaptive keep-alive.
+ */
+TEST( MQTT_Unit_KeepAlive, Simulation )
+{
+    const _simScenario_t scenarios[] =
+    {
+        { "telemetry 1 s, NAT 300 s",  1000,  300000 },
+        { "telemetry 60 s, NAT 120 s", 60000, 120000 },
+        { "no telemetry, NAT 120 s",   0,     120000 },
+        { "no telemetry, NAT 30 s",    0,     30000  }
+    };
+    _simNetwork_t fixed = { 0 }, adaptive = { 0 };
+    IotMqttKeepAlive_t keepAlive = { 0 };
+    size_t i = 0;
+
+    for( i = 0; i < sizeof( scenarios ) / sizeof( scenarios[ 0 ] ); i++ )
+    {
+        ( void ) memset( &fixed, 0x00, sizeof( fixed ) );
+        ( void ) memset( &keepAlive, 0x00, sizeof( keepAlive ) );
+        fixed.telemetryMs = scenarios[ i ].telemetryMs;
+        fixed.natTimeoutMs = scenarios[ i ].natTimeoutMs;
+        adaptive = fixed;
+
+        _simulate( &fixed, NULL, 2 );
+        _simulate( &adaptive, &keepAlive, 2 );
+
+        UnityPrint( "Keep-alive, " );
+        UnityPrint( scenarios[ i ].pName );
+        UnityPrint( ": fixed " );
+        UnityPrintNumber( ( UNITY_INT ) fixed.wakeups );
+        UnityPrint( " wakeups/h (" );
+        UnityPrintNumber( ( UNITY_INT ) fixed.reconnects );
+        UnityPrint( " reconnects), adaptive " );
+        UnityPrintNumber( ( UNITY_INT ) adaptive.wakeups );
+        UnityPrint( " wakeups/h (" );
+        UnityPrintNumber( ( UNITY_INT ) adaptive.reconnects );
+        UnityPrint( " reconnects), interval " );
+        UnityPrintNumber( ( UNITY_INT ) ( keepAlive.intervalMs / 1000 ) );
+        UnityPrint( " s, limit " );
+        UnityPrintNumber( ( UNITY_INT ) ( keepAlive.limitMs / 1000 ) );
+        UnityPrint( " s." );
+        UNITY_PRINT_EOL();
+
+        /* Once learned, the interval stays under the NAT timeout and costs
+         * fewer wakeups. Raising a limit that is the NAT's costs a reconnect,
+         * and the next raise waits twice as long. */
+        TEST_ASSERT_LESS_THAN_UINT32( fixed.wakeups, adaptive.wakeups );
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32( 1, adaptive.reconnects );
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32( scenarios[ i ].natTimeoutMs, keepAlive.intervalMs );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Simulates a gateway restart a minute into a connection behind a NAT
+ * gateway with a long timeout, and prints the radio wakeups of the last of
+ * eight hours with and without raising the limit learned from it.
+ */
+TEST( MQTT_Unit_KeepAlive, TransientOutage )
+{
+    _simNetwork_t kept = { 0 }, raised = { 0 };
+    IotMqttKeepAlive_t keptKeepAlive = { 0 }, raisedKeepAlive = { 0 };
+    uint32_t outageLimitMs = 0;
+
+    kept.natTimeoutMs = 300000;
+    kept.outageMs = SIM_OUTAGE_MS;
+    raised = kept;
+
+    /* A hold that is never reached keeps the limit for ever. */
+    keptKeepAlive.limitHold = UINT32_MAX;
+
+    _simulate( &kept, &keptKeepAlive, SIM_OUTAGE_HOURS );
+    _simulate( &raised, &raisedKeepAlive, SIM_OUTAGE_HOURS );
+    outageLimitMs = keptKeepAlive.limitMs;
+
+    UnityPrint( "Keep-alive, gateway restart, NAT 300 s: limit kept " );
+    UnityPrintNumber( ( UNITY_INT ) kept.wakeups );
+    UnityPrint( " wakeups/h, interval " );
+    UnityPrintNumber( ( UNITY_INT ) ( keptKeepAlive.intervalMs / 1000 ) );
+    UnityPrint( " s; limit raised " );
+    UnityPrintNumber( ( UNITY_INT ) raised.wakeups );
+    UnityPrint( " wakeups/h (" );
+    UnityPrintNumber( ( UNITY_INT ) raised.reconnects );
+    UnityPrint( " reconnects), interval " );
+    UnityPrintNumber( ( UNITY_INT ) ( raisedKeepAlive.intervalMs / 1000 ) );
+    UnityPrint( " s, limit " );
+    UnityPrintNumber( ( UNITY_INT ) ( raisedKeepAlive.limitMs / 1000 ) );
+    UnityPrint( " s." );
+    UNITY_PRINT_EOL();
+
+    /* The restart teaches a limit far under the NAT timeout. */
+    TEST_ASSERT_NOT_EQUAL( 0, outageLimitMs );
+    TEST_ASSERT_LESS_THAN_UINT32( kept.natTimeoutMs / 4, outageLimitMs );
+
+    /* Raised again, the interval climbs back near the NAT timeout. */
+    TEST_ASSERT_GREATER_THAN_UINT32( outageLimitMs * 4, raisedKeepAlive.intervalMs );
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32( raised.natTimeoutMs, raisedKeepAlive.intervalMs );
+    TEST_ASSERT_LESS_THAN_UINT32( kept.wakeups, raised.wakeups );
+}
+
+/*-----------------------------------------------------------*/
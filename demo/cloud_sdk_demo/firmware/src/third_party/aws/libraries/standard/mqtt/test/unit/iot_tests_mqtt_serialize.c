@@ -0,0 +1,904 @@
+/*
+ * IoT MQTT V2.1.0
+ * Copyright (C) 2018 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file iot_tests_mqtt_serialize.c
+ * @brief Fuzzing and benchmark tests for the functions in iot_mqtt_serialize.c
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <string.h>
+
+/* SDK initialization include. */
+#include "iot_init.h"
+
+/* Platform layer includes. */
+#include "platform/iot_clock.h"
+
+/* MQTT internal include. */
+#include "private/iot_mqtt_internal.h"
+
+/* Test framework includes. */
+#include "unity_fixture.h"
+
+/* MQTT test access include. */
+#include "iot_test_access_mqtt.h"
+
+/* MQTT serializer API include */
+#include "iot_mqtt_serialize.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief How many mutated packets #TEST_MQTT_Unit_Serialize_DeserializeFuzz_
+ * passes to the fuzzing harness.
+ */
+#ifndef IOT_TEST_MQTT_FUZZ_ITERATIONS
+    #define IOT_TEST_MQTT_FUZZ_ITERATIONS    ( 20000 )
+#endif
+
+/**
+ * @brief How many times each case of #TEST_MQTT_Unit_Serialize_Benchmark_
+ * runs, and for how long.
+ */
+#ifndef IOT_TEST_MQTT_BENCHMARK_RUNS
+    #define IOT_TEST_MQTT_BENCHMARK_RUNS    ( 5 )
+#endif
+#ifndef IOT_TEST_MQTT_BENCHMARK_DURATION_MS
+    #define IOT_TEST_MQTT_BENCHMARK_DURATION_MS    ( 50 )
+#endif
+
+/**
+ * @brief Set to `1` to fail #TEST_MQTT_Unit_Serialize_Benchmark_ when the
+ * throughput of a case drops more than #IOT_TEST_MQTT_BENCHMARK_MAX_DROP_PERCENT
+ * below its baseline.
+ *
+ * The baselines in #_benchmarkCases are relative to a reference pass measured
+ * in the same run, so they hold on the machine running the test. Timing is
+ * still disturbed by a loaded machine, so this is off by default. The bytes
+ * copied are always checked.
+ */
+#ifndef IOT_TEST_MQTT_BENCHMARK_GATE
+    #define IOT_TEST_MQTT_BENCHMARK_GATE    ( 0 )
+#endif
+#ifndef IOT_TEST_MQTT_BENCHMARK_MAX_DROP_PERCENT
+    #define IOT_TEST_MQTT_BENCHMARK_MAX_DROP_PERCENT    ( 20 )
+#endif
+
+/**
+ * @brief How many packets the benchmark handles between reading the clock.
+ */
+#define BENCHMARK_BATCH          ( 64 )
+
+/**
+ * @brief Largest payload of the benchmark.
+ */
+#define BENCHMARK_MAX_PAYLOAD    ( 4096 )
+
+/**
+ * @brief Payload of the PUBLISH of the reference pass of the benchmark.
+ */
+#define BENCHMARK_REFERENCE_PAYLOAD    ( 64 )
+
+/**
+ * @brief Largest input passed to the fuzzing harness.
+ */
+#define FUZZ_MAX_INPUT           ( 512 )
+
+/**
+ * @brief The client identifier of the CONNECT packets.
+ */
+#define TEST_CLIENT_IDENTIFIER           "test"
+
+/**
+ * @brief Length of #TEST_CLIENT_IDENTIFIER.
+ */
+#define TEST_CLIENT_IDENTIFIER_LENGTH    ( ( uint16_t ) ( sizeof( TEST_CLIENT_IDENTIFIER ) - 1 ) )
+
+/**
+ * @brief The topic name and filter of the packets.
+ */
+#define TEST_TOPIC_NAME                  "/test/topic"
+
+/**
+ * @brief Length of #TEST_TOPIC_NAME.
+ */
+#define TEST_TOPIC_LENGTH                ( ( uint16_t ) ( sizeof( TEST_TOPIC_NAME ) - 1 ) )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Handles one packet in the benchmark.
+ *
+ * @param[in] payloadLength Payload of a PUBLISH.
+ * @param[in] pPacket The packet of a deserializer.
+ */
+typedef IotMqttError_t ( * _benchmarkOperation_t )( size_t payloadLength,
+                                                    IotMqttPacketInfo_t * pPacket );
+
+/**
+ * @brief A case of the benchmark.
+ */
+typedef struct _benchmarkCase
+{
+    const char * pName;                /**< @brief Printed with the results. */
+    _benchmarkOperation_t operation;   /**< @brief Handles one packet. */
+    uint8_t packetType;                /**< @brief Packet passed to a deserializer, `0` for a serializer. */
+    IotMqttQos_t qos;                  /**< @brief QoS of a PUBLISH. */
+    size_t payloadLength;              /**< @brief Payload of a PUBLISH. */
+    size_t maxCopiedBytes;             /**< @brief Most bytes copied per packet. */
+    uint32_t baselinePercent;          /**< @brief Lowest throughput of five runs of a host build with -O1, in percent of the reference pass. */
+} _benchmarkCase_t;
+
+/**
+ * @brief Reads a serialized packet for #_IotMqtt_GetRemainingLength_Generic.
+ */
+typedef struct _packetReader
+{
+    const uint8_t * pPacket; /**< @brief The packet. */
+    size_t size;             /**< @brief Length of the packet. */
+    size_t offset;           /**< @brief How much of the packet was read. */
+} _packetReader_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The fuzzing harness in iot_fuzz_mqtt_deserialize.c.
+ */
+int LLVMFuzzerTestOneInput( const uint8_t * pData,
+                            size_t size );
+
+/*-----------------------------------------------------------*/
+
+/* Responses received from the server. */
+static const uint8_t _connack[] = { MQTT_PACKET_TYPE_CONNACK, 0x02, 0x00, 0x00 };                        /**< @brief Accepted CONNACK. */
+static const uint8_t _puback[] = { MQTT_PACKET_TYPE_PUBACK, 0x02, 0x00, 0x01 };                          /**< @brief PUBACK. */
+static const uint8_t _suback[] = { MQTT_PACKET_TYPE_SUBACK, 0x04, 0x00, 0x01, 0x00, 0x01 };              /**< @brief SUBACK of one subscription. */
+static const uint8_t _subackRefused[] = { MQTT_PACKET_TYPE_SUBACK, 0x05, 0x00, 0x01, 0x01, 0x80, 0x00 }; /**< @brief SUBACK refusing a subscription. */
+static const uint8_t _unsuback[] = { MQTT_PACKET_TYPE_UNSUBACK, 0x02, 0x00, 0x01 };                      /**< @brief UNSUBACK. */
+static const uint8_t _pingresp[] = { MQTT_PACKET_TYPE_PINGRESP, 0x00 };                                  /**< @brief PINGRESP. */
+
+/**
+ * @brief Payload of the PUBLISH packets.
+ */
+static uint8_t _payload[ BENCHMARK_MAX_PAYLOAD ] = { 0 };
+
+/**
+ * @brief State of the pseudo-random mutations.
+ */
+static uint32_t _fuzzState = 0;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Next pseudo-random number of the mutations, so that a failing run
+ * repeats.
+ */
+static uint32_t _fuzzRandom( void )
+{
+    /* xorshift32. */
+    _fuzzState ^= _fuzzState << 13;
+    _fuzzState ^= _fuzzState >> 17;
+    _fuzzState ^= _fuzzState << 5;
+
+    return _fuzzState;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Next byte function of #_IotMqtt_GetRemainingLength_Generic that reads
+ * a #_packetReader_t.
+ */
+static IotMqttError_t _readNextByte( void * pNetworkContext,
+                                     uint8_t * pNextByte )
+{
+    IotMqttError_t status = IOT_MQTT_NETWORK_ERROR;
+    _packetReader_t * pReader = ( _packetReader_t * ) pNetworkContext;
+
+    if( pReader->offset < pReader->size )
+    {
+        *pNextByte = pReader->pPacket[ pReader->offset ];
+        pReader->offset++;
+        status = IOT_MQTT_SUCCESS;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Set a packet info from a serialized packet, like the receive path.
+ */
+static void _setPacketInfo( const uint8_t * pSerializedPacket,
+                            size_t packetSize,
+                            IotMqttPacketInfo_t * pPacket )
+{
+    _packetReader_t reader = { .pPacket = pSerializedPacket, .size = packetSize, .offset = 1 };
+
+    ( void ) memset( pPacket, 0x00, sizeof( IotMqttPacketInfo_t ) );
+    pPacket->type = pSerializedPacket[ 0 ];
+    pPacket->remainingLength = _IotMqtt_GetRemainingLength_Generic( &reader, _readNextByte );
+    pPacket->pRemainingData = ( uint8_t * ) pSerializedPacket + reader.offset;
+
+    TEST_ASSERT_EQUAL( packetSize, reader.offset + pPacket->remainingLength );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Serialize a PUBLISH with #_payload.
+ */
+static IotMqttError_t _serializePublish( IotMqttQos_t qos,
+                                         size_t payloadLength,
+                                         uint8_t ** pPublishPacket,
+                                         size_t * pPacketSize )
+{
+    IotMqttPublishInfo_t publishInfo = IOT_MQTT_PUBLISH_INFO_INITIALIZER;
+    uint16_t packetIdentifier = 0;
+    uint8_t * pPacketIdentifierHigh = NULL;
+
+    publishInfo.qos = qos;
+    publishInfo.pTopicName = TEST_TOPIC_NAME;
+    publishInfo.topicNameLength = TEST_TOPIC_LENGTH;
+    publishInfo.pPayload = _payload;
+    publishInfo.payloadLength = payloadLength;
+
+    return _IotMqtt_SerializePublish( &publishInfo,
+                                      pPublishPacket,
+                                      pPacketSize,
+                                      &packetIdentifier,
+                                      &pPacketIdentifierHigh );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Pass a packet of the corpus and mutations of it to the fuzzing harness.
+ */
+static void _fuzzPacket( const uint8_t * pPacket,
+                         size_t packetSize,
+                         uint32_t iterations )
+{
+    static const uint8_t boundaries[] = { 0x00, 0x7f, 0x80, 0xff };
+    uint8_t input[ FUZZ_MAX_INPUT ] = { 0 };
+    size_t inputSize = 0, offset = 0;
+    uint32_t iteration = 0, mutation = 0, mutationCount = 0;
+
+    TEST_ASSERT_LESS_OR_EQUAL( FUZZ_MAX_INPUT, packetSize );
+
+    /* The packet itself. */
+    ( void ) LLVMFuzzerTestOneInput( pPacket, packetSize );
+
+    for( iteration = 0; iteration < iterations; iteration++ )
+    {
+        ( void ) memcpy( input, pPacket, packetSize );
+        inputSize = packetSize;
+        mutationCount = 1 + _fuzzRandom() % 4;
+
+        for( mutation = 0; mutation < mutationCount; mutation++ )
+        {
+            /* Most mutations are in the fixed and variable headers. */
+            offset = _fuzzRandom() % ( ( inputSize < 8 ) ? inputSize + 1 : 8 );
+
+            if( ( _fuzzRandom() % 4 == 0 ) && ( inputSize > 0 ) )
+            {
+                offset = _fuzzRandom() % inputSize;
+            }
+
+            switch( _fuzzRandom() % 5 )
+            {
+                /* Flip a bit. */
+                case 0:
+
+                    if( offset < inputSize )
+                    {
+                        input[ offset ] ^= ( uint8_t ) ( 1 << ( _fuzzRandom() % 8 ) );
+                    }
+
+                    break;
+
+                /* Set a byte to a boundary of the remaining length and string length encodings. */
+                case 1:
+
+                    if( offset < inputSize )
+                    {
+                        input[ offset ] = boundaries[ _fuzzRandom() % sizeof( boundaries ) ];
+                    }
+
+                    break;
+
+                /* Truncate. */
+                case 2:
+                    inputSize = offset;
+                    break;
+
+                /* Extend with random bytes. */
+                case 3:
+
+                    while( ( inputSize < FUZZ_MAX_INPUT ) && ( _fuzzRandom() % 8 != 0 ) )
+                    {
+                        input[ inputSize ] = ( uint8_t ) _fuzzRandom();
+                        inputSize++;
+                    }
+
+                    break;
+
+                /* Change the packet type and flags. */
+                default:
+
+                    if( inputSize > 0 )
+                    {
+                        input[ 0 ] = ( uint8_t ) _fuzzRandom();
+                    }
+
+                    break;
+            }
+        }
+
+        ( void ) LLVMFuzzerTestOneInput( input, inputSize );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Benchmark operation that serializes a CONNECT.
+ */
+static IotMqttError_t _benchmarkConnect( size_t payloadLength,
+                                         IotMqttPacketInfo_t * pPacket )
+{
+    IotMqttError_t status = IOT_MQTT_STATUS_PENDING;
+    IotMqttConnectInfo_t connectInfo = IOT_MQTT_CONNECT_INFO_INITIALIZER;
+    uint8_t * pConnectPacket = NULL;
+    size_t packetSize = 0;
+
+    ( void ) payloadLength;
+    ( void ) pPacket;
+
+    /* No username, so that metrics do not change the bytes copied. */
+    connectInfo.awsIotMqttMode = false;
+    connectInfo.keepAliveSeconds = 60;
+    connectInfo.pClientIdentifier = TEST_CLIENT_IDENTIFIER;
+    connectInfo.clientIdentifierLength = TEST_CLIENT_IDENTIFIER_LENGTH;
+
+    status = _IotMqtt_SerializeConnect( &connectInfo, &pConnectPacket, &packetSize );
+
+    if( status == IOT_MQTT_SUCCESS )
+    {
+        _IotMqtt_FreePacket( pConnectPacket );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Benchmark operation that serializes a QoS 0 PUBLISH.
+ */
+static IotMqttError_t _benchmarkPublish0( size_t payloadLength,
+                                          IotMqttPacketInfo_t * pPacket )
+{
+    IotMqttError_t status = IOT_MQTT_STATUS_PENDING;
+    uint8_t * pPublishPacket = NULL;
+    size_t packetSize = 0;
+
+    ( void ) pPacket;
+
+    status = _serializePublish( IOT_MQTT_QOS_0, payloadLength, &pPublishPacket, &packetSize );
+
+    if( status == IOT_MQTT_SUCCESS )
+    {
+        _IotMqtt_FreePacket( pPublishPacket );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Benchmark operation that serializes a QoS 1 PUBLISH.
+ */
+static IotMqttError_t _benchmarkPublish1( size_t payloadLength,
+                                          IotMqttPacketInfo_t * pPacket )
+{
+    IotMqttError_t status = IOT_MQTT_STATUS_PENDING;
+    uint8_t * pPublishPacket = NULL;
+    size_t packetSize = 0;
+
+    ( void ) pPacket;
+
+    status = _serializePublish( IOT_MQTT_QOS_1, payloadLength, &pPublishPacket, &packetSize );
+
+    if( status == IOT_MQTT_SUCCESS )
+    {
+        _IotMqtt_FreePacket( pPublishPacket );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Benchmark operation that serializes a SUBSCRIBE of one topic filter.
+ */
+static IotMqttError_t _benchmarkSubscribe( size_t payloadLength,
+                                           IotMqttPacketInfo_t * pPacket )
+{
+    IotMqttError_t status = IOT_MQTT_STATUS_PENDING;
+    IotMqttSubscription_t subscription = IOT_MQTT_SUBSCRIPTION_INITIALIZER;
+    uint8_t * pSubscribePacket = NULL;
+    size_t packetSize = 0;
+    uint16_t packetIdentifier = 0;
+
+    ( void ) payloadLength;
+    ( void ) pPacket;
+
+    subscription.qos = IOT_MQTT_QOS_1;
+    subscription.pTopicFilter = TEST_TOPIC_NAME;
+    subscription.topicFilterLength = TEST_TOPIC_LENGTH;
+
+    status = _IotMqtt_SerializeSubscribe( &subscription, 1, &pSubscribePacket, &packetSize, &packetIdentifier );
+
+    if( status == IOT_MQTT_SUCCESS )
+    {
+        _IotMqtt_FreePacket( pSubscribePacket );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Benchmark operation that serializes an UNSUBSCRIBE of one topic filter.
+ */
+static IotMqttError_t _benchmarkUnsubscribe( size_t payloadLength,
+                                             IotMqttPacketInfo_t * pPacket )
+{
+    IotMqttError_t status = IOT_MQTT_STATUS_PENDING;
+    IotMqttSubscription_t subscription = IOT_MQTT_SUBSCRIPTION_INITIALIZER;
+    uint8_t * pUnsubscribePacket = NULL;
+    size_t packetSize = 0;
+    uint16_t packetIdentifier = 0;
+
+    ( void ) payloadLength;
+    ( void ) pPacket;
+
+    subscription.pTopicFilter = TEST_TOPIC_NAME;
+    subscription.topicFilterLength = TEST_TOPIC_LENGTH;
+
+    status = _IotMqtt_SerializeUnsubscribe( &subscription, 1, &pUnsubscribePacket, &packetSize, &packetIdentifier );
+
+    if( status == IOT_MQTT_SUCCESS )
+    {
+        _IotMqtt_FreePacket( pUnsubscribePacket );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Benchmark operation that serializes a PUBACK.
+ */
+static IotMqttError_t _benchmarkPuback( size_t payloadLength,
+                                        IotMqttPacketInfo_t * pPacket )
+{
+    IotMqttError_t status = IOT_MQTT_STATUS_PENDING;
+    uint8_t * pPubackPacket = NULL;
+    size_t packetSize = 0;
+
+    ( void ) payloadLength;
+    ( void ) pPacket;
+
+    status = _IotMqtt_SerializePuback( 1, &pPubackPacket, &packetSize );
+
+    if( status == IOT_MQTT_SUCCESS )
+    {
+        _IotMqtt_FreePacket( pPubackPacket );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Benchmark operation that serializes a PINGREQ into a buffer.
+ */
+static IotMqttError_t _benchmarkPingreq( size_t payloadLength,
+                                         IotMqttPacketInfo_t * pPacket )
+{
+    uint8_t pingreq[ 2 ] = { 0 };
+
+    ( void ) payloadLength;
+    ( void ) pPacket;
+
+    return IotMqtt_SerializePingreq( pingreq, sizeof( pingreq ) );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Benchmark operation that deserializes a PUBLISH.
+ */
+static IotMqttError_t _benchmarkDeserializePublish( size_t payloadLength,
+                                                    IotMqttPacketInfo_t * pPacket )
+{
+    ( void ) payloadLength;
+
+    return IotMqtt_DeserializePublish( pPacket );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Benchmark operation that deserializes a response from the server.
+ */
+static IotMqttError_t _benchmarkDeserializeResponse( size_t payloadLength,
+                                                     IotMqttPacketInfo_t * pPacket )
+{
+    ( void ) payloadLength;
+
+    return IotMqtt_DeserializeResponse( pPacket );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Reference operation of the benchmark; writes a QoS 0 PUBLISH by hand,
+ * with the allocator of the serializers.
+ *
+ * The baselines of #_benchmarkCases are relative to its throughput, measured
+ * in the same run, so that they do not depend on the machine.
+ */
+static IotMqttError_t _benchmarkReference( size_t payloadLength,
+                                           IotMqttPacketInfo_t * pPacket )
+{
+    static const uint8_t payload[ BENCHMARK_REFERENCE_PAYLOAD ] = { 0 };
+    const size_t remainingLength = 2 + TEST_TOPIC_LENGTH + payloadLength;
+    uint8_t * pPublishPacket = NULL;
+
+    ( void ) pPacket;
+
+    pPublishPacket = IotMqtt_MallocMessage( 2 + remainingLength );
+
+    if( pPublishPacket == NULL )
+    {
+        return IOT_MQTT_NO_MEMORY;
+    }
+
+    pPublishPacket[ 0 ] = MQTT_PACKET_TYPE_PUBLISH;
+    pPublishPacket[ 1 ] = ( uint8_t ) remainingLength;
+    pPublishPacket[ 2 ] = 0;
+    pPublishPacket[ 3 ] = ( uint8_t ) TEST_TOPIC_LENGTH;
+    ( void ) memcpy( pPublishPacket + 4, TEST_TOPIC_NAME, TEST_TOPIC_LENGTH );
+    ( void ) memcpy( pPublishPacket + 4 + TEST_TOPIC_LENGTH, payload, payloadLength );
+
+    IotMqtt_FreeMessage( pPublishPacket );
+
+    return IOT_MQTT_SUCCESS;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The cases of #TEST_MQTT_Unit_Serialize_Benchmark_.
+ *
+ * The serializers copy the protocol name "MQTT", the strings and the payload
+ * into the packet, and the deserializers point into the packet.
+ */
+static const _benchmarkCase_t _benchmarkCases[] =
+{
+    { "Serialize CONNECT",         _benchmarkConnect,             0,                         IOT_MQTT_QOS_0, 0,    4 + TEST_CLIENT_IDENTIFIER_LENGTH,  24 },
+    { "Serialize PUBLISH QoS 0",   _benchmarkPublish0,            0,                         IOT_MQTT_QOS_0, 0,    TEST_TOPIC_LENGTH,                  31 },
+    { "Serialize PUBLISH QoS 0",   _benchmarkPublish0,            0,                         IOT_MQTT_QOS_0, 64,   TEST_TOPIC_LENGTH + 64,             26 },
+    { "Serialize PUBLISH QoS 0",   _benchmarkPublish0,            0,                         IOT_MQTT_QOS_0, 1024, TEST_TOPIC_LENGTH + 1024,           19 },
+    { "Serialize PUBLISH QoS 0",   _benchmarkPublish0,            0,                         IOT_MQTT_QOS_0, 4096, TEST_TOPIC_LENGTH + 4096,           12 },
+    { "Serialize PUBLISH QoS 1",   _benchmarkPublish1,            0,                         IOT_MQTT_QOS_1, 64,   TEST_TOPIC_LENGTH + 64,             30 },
+    { "Serialize PUBLISH QoS 1",   _benchmarkPublish1,            0,                         IOT_MQTT_QOS_1, 1024, TEST_TOPIC_LENGTH + 1024,           17 },
+    { "Serialize SUBSCRIBE",       _benchmarkSubscribe,           0,                         IOT_MQTT_QOS_0, 0,    TEST_TOPIC_LENGTH,                  35 },
+    { "Serialize UNSUBSCRIBE",     _benchmarkUnsubscribe,         0,                         IOT_MQTT_QOS_0, 0,    TEST_TOPIC_LENGTH,                  34 },
+    { "Serialize PUBACK",          _benchmarkPuback,              0,                         IOT_MQTT_QOS_0, 0,    0,                                  65 },
+    { "Serialize PINGREQ",         _benchmarkPingreq,             0,                         IOT_MQTT_QOS_0, 0,    2,                                 423 },
+    { "Deserialize CONNACK",       _benchmarkDeserializeResponse, MQTT_PACKET_TYPE_CONNACK,  IOT_MQTT_QOS_0, 0,    0,                                 190 },
+    { "Deserialize PUBLISH QoS 0", _benchmarkDeserializePublish,  MQTT_PACKET_TYPE_PUBLISH,  IOT_MQTT_QOS_0, 64,   0,                                  47 },
+    { "Deserialize PUBLISH QoS 1", _benchmarkDeserializePublish,  MQTT_PACKET_TYPE_PUBLISH,  IOT_MQTT_QOS_1, 64,   0,                                  41 },
+    { "Deserialize PUBLISH QoS 1", _benchmarkDeserializePublish,  MQTT_PACKET_TYPE_PUBLISH,  IOT_MQTT_QOS_1, 1024, 0,                                  37 },
+    { "Deserialize PUBLISH QoS 1", _benchmarkDeserializePublish,  MQTT_PACKET_TYPE_PUBLISH,  IOT_MQTT_QOS_1, 4096, 0,                                  53 },
+    { "Deserialize PUBACK",        _benchmarkDeserializeResponse, MQTT_PACKET_TYPE_PUBACK,   IOT_MQTT_QOS_0, 0,    0,                                 205 },
+    { "Deserialize SUBACK",        _benchmarkDeserializeResponse, MQTT_PACKET_TYPE_SUBACK,   IOT_MQTT_QOS_0, 0,    0,                                 147 },
+    { "Deserialize UNSUBACK",      _benchmarkDeserializeResponse, MQTT_PACKET_TYPE_UNSUBACK, IOT_MQTT_QOS_0, 0,    0,                                 139 },
+    { "Deserialize PINGRESP",      _benchmarkDeserializeResponse, MQTT_PACKET_TYPE_PINGRESP, IOT_MQTT_QOS_0, 0,    0,                                 206 }
+};
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Measure the throughput of a benchmark operation, in packets per second.
+ */
+static uint64_t _measureBenchmark( _benchmarkOperation_t operation,
+                                   size_t payloadLength,
+                                   IotMqttPacketInfo_t * pPacket )
+{
+    uint64_t startMs = 0, elapsedMs = 0, packetCount = 0, packetsPerSecond = 0;
+    uint32_t i = 0, run = 0;
+
+    /* Keep the best run, as anything else running on the machine only slows
+     * a run down. */
+    for( run = 0; run < IOT_TEST_MQTT_BENCHMARK_RUNS; run++ )
+    {
+        packetCount = 0;
+        startMs = IotClock_GetTimeMs();
+
+        do
+        {
+            for( i = 0; i < BENCHMARK_BATCH; i++ )
+            {
+                TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, operation( payloadLength, pPacket ) );
+            }
+
+            packetCount += BENCHMARK_BATCH;
+            elapsedMs = IotClock_GetTimeMs() - startMs;
+        } while( elapsedMs < IOT_TEST_MQTT_BENCHMARK_DURATION_MS );
+
+        if( packetCount * 1000 / elapsedMs > packetsPerSecond )
+        {
+            packetsPerSecond = packetCount * 1000 / elapsedMs;
+        }
+    }
+
+    return packetsPerSecond;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Run a case of the benchmark, print its throughput and the bytes it
+ * copies per packet, and check them.
+ *
+ * The reference pass runs just before the case, so that both see the same
+ * state of the machine.
+ */
+static void _runBenchmarkCase( const _benchmarkCase_t * pCase )
+{
+    IotMqttPacketInfo_t packet = IOT_MQTT_PACKET_INFO_INITIALIZER;
+    uint8_t * pPublishPacket = NULL;
+    const uint8_t * pResponse = NULL;
+    size_t packetSize = 0, copiedBytes = 0;
+    uint64_t referencePacketsPerSecond = 0, packetsPerSecond = 0, percent = 0;
+    uint32_t i = 0;
+
+    /* Set the packet of a deserializer. */
+    switch( pCase->packetType )
+    {
+        case MQTT_PACKET_TYPE_PUBLISH:
+            TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS,
+                               _serializePublish( pCase->qos, pCase->payloadLength, &pPublishPacket, &packetSize ) );
+            pResponse = pPublishPacket;
+            break;
+
+        case MQTT_PACKET_TYPE_CONNACK:
+            pResponse = _connack;
+            packetSize = sizeof( _connack );
+            break;
+
+        case MQTT_PACKET_TYPE_PUBACK:
+            pResponse = _puback;
+            packetSize = sizeof( _puback );
+            break;
+
+        case MQTT_PACKET_TYPE_SUBACK:
+            pResponse = _suback;
+            packetSize = sizeof( _suback );
+            break;
+
+        case MQTT_PACKET_TYPE_UNSUBACK:
+            pResponse = _unsuback;
+            packetSize = sizeof( _unsuback );
+            break;
+
+        case MQTT_PACKET_TYPE_PINGRESP:
+            pResponse = _pingresp;
+            packetSize = sizeof( _pingresp );
+            break;
+
+        default:
+            break;
+    }
+
+    if( pResponse != NULL )
+    {
+        _setPacketInfo( pResponse, packetSize, &packet );
+    }
+
+    /* A first batch warms up the caches and measures the bytes copied. */
+    copiedBytes = IotTestMqtt_copiedBytes();
+
+    for( i = 0; i < BENCHMARK_BATCH; i++ )
+    {
+        TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, pCase->operation( pCase->payloadLength, &packet ) );
+    }
+
+    copiedBytes = ( IotTestMqtt_copiedBytes() - copiedBytes ) / BENCHMARK_BATCH;
+
+    referencePacketsPerSecond = _measureBenchmark( _benchmarkReference,
+                                                   BENCHMARK_REFERENCE_PAYLOAD,
+                                                   NULL );
+    TEST_ASSERT_GREATER_THAN( 0, referencePacketsPerSecond );
+
+    packetsPerSecond = _measureBenchmark( pCase->operation, pCase->payloadLength, &packet );
+    percent = packetsPerSecond * 100 / referencePacketsPerSecond;
+
+    if( pPublishPacket != NULL )
+    {
+        _IotMqtt_FreePacket( pPublishPacket );
+    }
+
+    UnityPrint( pCase->pName );
+    UnityPrint( ", payload " );
+    UnityPrintNumber( ( UNITY_INT ) pCase->payloadLength );
+    UnityPrint( ": " );
+    UnityPrintNumber( ( UNITY_INT ) packetsPerSecond );
+    UnityPrint( " packets/s (" );
+    UnityPrintNumber( ( UNITY_INT ) percent );
+    UnityPrint( "% of the reference), " );
+    UnityPrintNumber( ( UNITY_INT ) copiedBytes );
+    UnityPrint( " bytes copied per packet" );
+    UNITY_PRINT_EOL();
+
+    TEST_ASSERT_LESS_OR_EQUAL( pCase->maxCopiedBytes, copiedBytes );
+
+    #if IOT_TEST_MQTT_BENCHMARK_GATE == 1
+        TEST_ASSERT_GREATER_OR_EQUAL( ( uint64_t ) pCase->baselinePercent *
+                                      ( 100 - IOT_TEST_MQTT_BENCHMARK_MAX_DROP_PERCENT ) / 100,
+                                      percent );
+    #endif
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test group for MQTT serialize tests.
+ */
+TEST_GROUP( MQTT_Unit_Serialize );
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test setup for MQTT serialize tests.
+ */
+TEST_SETUP( MQTT_Unit_Serialize )
+{
+    TEST_ASSERT_EQUAL_INT( true, IotSdk_Init() );
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_Init() );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test tear down for MQTT serialize tests.
+ */
+TEST_TEAR_DOWN( MQTT_Unit_Serialize )
+{
+    IotMqtt_Cleanup();
+    IotSdk_Cleanup();
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test group runner for MQTT serialize tests.
+ */
+TEST_GROUP_RUNNER( MQTT_Unit_Serialize )
+{
+    RUN_TEST_CASE( MQTT_Unit_Serialize, DeserializeSubackRefused );
+    RUN_TEST_CASE( MQTT_Unit_Serialize, DeserializeFuzz );
+    RUN_TEST_CASE( MQTT_Unit_Serialize, Benchmark );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test that a SUBACK refusing a subscription is deserialized without a
+ * connection.
+ */
+TEST( MQTT_Unit_Serialize, DeserializeSubackRefused )
+{
+    IotMqttPacketInfo_t packet = IOT_MQTT_PACKET_INFO_INITIALIZER;
+
+    _setPacketInfo( _subackRefused, sizeof( _subackRefused ), &packet );
+
+    TEST_ASSERT_EQUAL( IOT_MQTT_SERVER_REFUSED, IotMqtt_DeserializeResponse( &packet ) );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Pass a corpus of valid packets and mutations of them to the fuzzing
+ * harness.
+ *
+ * A fuzzer finds more, but every build of the tests runs this.
+ */
+TEST( MQTT_Unit_Serialize, DeserializeFuzz )
+{
+    static const size_t payloadLengths[] = { 0, 16, 200 };
+    static const IotMqttQos_t qos[] = { IOT_MQTT_QOS_0, IOT_MQTT_QOS_1 };
+    const uint8_t * const pResponses[] = { _connack, _puback, _suback, _subackRefused, _unsuback, _pingresp };
+    const size_t responseSizes[] = { sizeof( _connack ), sizeof( _puback ), sizeof( _suback ),
+                                     sizeof( _subackRefused ), sizeof( _unsuback ), sizeof( _pingresp ) };
+    const uint32_t packetCount = sizeof( pResponses ) / sizeof( pResponses[ 0 ] ) +
+                                 ( sizeof( payloadLengths ) / sizeof( payloadLengths[ 0 ] ) ) *
+                                 ( sizeof( qos ) / sizeof( qos[ 0 ] ) );
+    uint8_t * pPublishPacket = NULL;
+    size_t packetSize = 0, i = 0, j = 0;
+
+    _fuzzState = 0x4d515454;
+
+    for( i = 0; i < sizeof( pResponses ) / sizeof( pResponses[ 0 ] ); i++ )
+    {
+        _fuzzPacket( pResponses[ i ], responseSizes[ i ], IOT_TEST_MQTT_FUZZ_ITERATIONS / packetCount );
+    }
+
+    for( i = 0; i < sizeof( payloadLengths ) / sizeof( payloadLengths[ 0 ] ); i++ )
+    {
+        for( j = 0; j < sizeof( qos ) / sizeof( qos[ 0 ] ); j++ )
+        {
+            TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, _serializePublish( qos[ j ], payloadLengths[ i ], &pPublishPacket, &packetSize ) );
+
+            _fuzzPacket( pPublishPacket, packetSize, IOT_TEST_MQTT_FUZZ_ITERATIONS / packetCount );
+
+            _IotMqtt_FreePacket( pPublishPacket );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Measure how many packets of each type and payload are serialized or
+ * deserialized per second, and the bytes copied per packet.
+ *
+ * Fails when a case copies more bytes than it did, or, with
+ * #IOT_TEST_MQTT_BENCHMARK_GATE, when its throughput relative to the reference
+ * pass drops below its baseline.
+ */
+TEST( MQTT_Unit_Serialize, Benchmark )
+{
+    size_t i = 0;
+
+    for( i = 0; i < sizeof( _benchmarkCases ) / sizeof( _benchmarkCases[ 0 ] ); i++ )
+    {
+        _runBenchmarkCase( &( _benchmarkCases[ i ] ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
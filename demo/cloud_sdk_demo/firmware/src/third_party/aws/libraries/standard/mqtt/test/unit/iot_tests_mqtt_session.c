@@ -0,0 +1,681 @@
+/*
+ * IoT MQTT V2.1.0
+ * Copyright (C) 2018 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file iot_tests_mqtt_session.c
+ * @brief Tests for persistent sessions (#IotMqttConnectInfo_t.pSession).
+ *
+ * The network interface is the mock broker of iot_tests_mqtt_mock.h: it answers
+ * CONNECT with a CONNACK carrying a scripted "Session Present" flag and records
+ * every PUBLISH sent, while the tests decide which PUBLISH messages are
+ * acknowledged and when the connection is dropped.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <string.h>
+
+/* SDK initialization include. */
+#include "iot_init.h"
+
+/* MQTT internal include. */
+#include "private/iot_mqtt_internal.h"
+
+/* Platform layer includes. */
+#include "platform/iot_clock.h"
+#include "platform/iot_threads.h"
+
+/* MQTT mock include. */
+#include "iot_tests_mqtt_mock.h"
+
+/* Test framework includes. */
+#include "unity_fixture.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Timeout to use for the tests. This can be short, but should allow time
+ * for other threads to run.
+ */
+#define TIMEOUT_MS                  ( 400 )
+
+/**
+ * @brief Time taken by the mock broker to answer a CONNECT.
+ */
+#define BROKER_DELAY_MS             ( 20 )
+
+/**
+ * @brief Most PUBLISH packets recorded by the mock broker in a test.
+ */
+#define BROKER_MAX_PUBLISH          ( 128 )
+
+/**
+ * @brief Most PUBLISH messages published by a test.
+ */
+#define MAX_MESSAGES                ( 32 )
+
+/*
+ * Constants that affect the behavior of #TEST_MQTT_Unit_Session_ScriptedDisconnects.
+ */
+#define SCRIPT_ROUNDS               ( 6 ) /**< @brief Connections dropped by the broker. */
+#define SCRIPT_MESSAGES_PER_ROUND   ( 4 ) /**< @brief PUBLISH messages sent on each connection. */
+
+/**
+ * @brief Retry period of the PUBLISH messages with retry. Long enough for the
+ * retries not to happen during the tests.
+ */
+#define RETRY_MS                    ( 5000 )
+
+/*
+ * Client identifier and length to use for the MQTT session tests.
+ */
+#define CLIENT_IDENTIFIER           ( "test" )                                           /**< @brief Client identifier. */
+#define CLIENT_IDENTIFIER_LENGTH    ( ( uint16_t ) ( sizeof( CLIENT_IDENTIFIER ) - 1 ) ) /**< @brief Length of client identifier. */
+
+/*
+ * Topic name and length to use for the MQTT session tests.
+ */
+#define TEST_TOPIC_NAME             ( "/test/topic" )                                  /**< @brief An arbitrary topic name. */
+#define TEST_TOPIC_NAME_LENGTH      ( ( uint16_t ) ( sizeof( TEST_TOPIC_NAME ) - 1 ) ) /**< @brief Length of topic name. */
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A PUBLISH packet seen by the mock broker.
+ */
+typedef struct _brokerPublish
+{
+    uint16_t packetIdentifier; /**< @brief Packet identifier of the PUBLISH. */
+    bool dup;                  /**< @brief Whether the DUP flag was set. */
+} _brokerPublish_t;
+
+/**
+ * @brief State of the mock broker.
+ */
+typedef struct _broker
+{
+    IotMutex_t mutex;                                 /**< @brief Protects the recorded PUBLISH packets. */
+    IotSemaphore_t publishSem;                        /**< @brief Posted for each PUBLISH sent. */
+    bool sendFails;                                   /**< @brief Whether sending PUBLISH packets fails. */
+    size_t subscribeCount;                            /**< @brief Number of SUBSCRIBE packets sent. */
+    size_t publishCount;                              /**< @brief Number of PUBLISH packets recorded. */
+    _brokerPublish_t publishes[ BROKER_MAX_PUBLISH ]; /**< @brief PUBLISH packets recorded. */
+} _broker_t;
+
+/**
+ * @brief A PUBLISH message published by a test.
+ */
+typedef struct _message
+{
+    uint16_t packetIdentifier; /**< @brief Packet identifier of the first send. */
+    uint32_t completions;      /**< @brief Number of times its callback was invoked. */
+    IotMqttError_t result;     /**< @brief Result given to the last callback. */
+} _message_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The mock broker shared by the tests.
+ */
+static _broker_t _broker = { 0 };
+
+/**
+ * @brief The PUBLISH messages of a test.
+ */
+static _message_t _messages[ MAX_MESSAGES ] = { 0 };
+
+/**
+ * @brief Posted for each PUBLISH callback invoked.
+ */
+static IotSemaphore_t _completeSem;
+
+/**
+ * @brief Time of the last PUBLISH callback invoked.
+ */
+static uint64_t _lastCompleteTime = 0;
+
+/**
+ * @brief The session shared by the tests.
+ */
+static IotMqttSession_t _session;
+
+/**
+ * @brief An #IotMqttNetworkInfo_t to share among the tests.
+ */
+static IotMqttNetworkInfo_t _networkInfo = IOT_MQTT_NETWORK_INFO_INITIALIZER;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Handler of the packets sent to the mock broker; records the PUBLISH
+ * packets.
+ */
+static size_t _brokerHandler( const uint8_t * pPacket,
+                              size_t packetLength,
+                              uint16_t packetIdentifier )
+{
+    size_t bytesSent = packetLength;
+    _brokerPublish_t * pPublish = NULL;
+
+    switch( pPacket[ 0 ] & 0xf0 )
+    {
+        case ( MQTT_PACKET_TYPE_SUBSCRIBE & 0xf0 ):
+            _broker.subscribeCount++;
+            break;
+
+        case MQTT_PACKET_TYPE_PUBLISH:
+
+            if( _broker.sendFails == true )
+            {
+                bytesSent = 0;
+            }
+            else
+            {
+                IotMutex_Lock( &( _broker.mutex ) );
+                TEST_ASSERT_LESS_THAN( BROKER_MAX_PUBLISH, _broker.publishCount );
+                pPublish = &( _broker.publishes[ _broker.publishCount ] );
+                pPublish->packetIdentifier = packetIdentifier;
+                pPublish->dup = ( pPacket[ 0 ] & 0x08 ) == 0x08;
+                _broker.publishCount++;
+                IotMutex_Unlock( &( _broker.mutex ) );
+
+                IotSemaphore_Post( &( _broker.publishSem ) );
+            }
+
+            break;
+
+        default:
+            break;
+    }
+
+    return bytesSent;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief PUBLISH completion callback; records the result in a #_message_t.
+ */
+static void _publishComplete( void * pCallbackContext,
+                              IotMqttCallbackParam_t * pCallbackParam )
+{
+    _message_t * pMessage = ( _message_t * ) pCallbackContext;
+
+    pMessage->completions++;
+    pMessage->result = pCallbackParam->u.operation.result;
+    _lastCompleteTime = IotClock_GetTimeMs();
+
+    IotSemaphore_Post( &_completeSem );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Establish a connection with the mock broker using the test session.
+ */
+static IotMqttConnection_t _connect( bool sessionPresent )
+{
+    IotMqttConnection_t mqttConnection = IOT_MQTT_CONNECTION_INITIALIZER;
+    IotMqttConnectInfo_t connectInfo = IOT_MQTT_CONNECT_INFO_INITIALIZER;
+
+    connectInfo.cleanSession = false;
+    connectInfo.pClientIdentifier = CLIENT_IDENTIFIER;
+    connectInfo.clientIdentifierLength = CLIENT_IDENTIFIER_LENGTH;
+    connectInfo.pSession = &_session;
+
+    IotTest_MqttMockBrokerSetSessionPresent( sessionPresent );
+
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_Connect( &_networkInfo,
+                                                          &connectInfo,
+                                                          TIMEOUT_MS,
+                                                          &mqttConnection ) );
+
+    /* Let the mock broker thread return before going on. */
+    TEST_ASSERT_EQUAL_INT( true, IotTest_MqttMockBrokerWaitAnswer( TIMEOUT_MS ) );
+
+    return mqttConnection;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Publish a QoS 1 message and wait for the mock broker to receive it.
+ */
+static void _publish( IotMqttConnection_t mqttConnection,
+                      _message_t * pMessage,
+                      uint32_t retryLimit )
+{
+    IotMqttPublishInfo_t publishInfo = IOT_MQTT_PUBLISH_INFO_INITIALIZER;
+    IotMqttCallbackInfo_t callbackInfo = IOT_MQTT_CALLBACK_INFO_INITIALIZER;
+    size_t publishCount = _broker.publishCount;
+
+    publishInfo.qos = IOT_MQTT_QOS_1;
+    publishInfo.pTopicName = TEST_TOPIC_NAME;
+    publishInfo.topicNameLength = TEST_TOPIC_NAME_LENGTH;
+    publishInfo.pPayload = "";
+    publishInfo.payloadLength = 0;
+    publishInfo.retryMs = RETRY_MS;
+    publishInfo.retryLimit = retryLimit;
+    callbackInfo.function = _publishComplete;
+    callbackInfo.pCallbackContext = pMessage;
+
+    TEST_ASSERT_EQUAL( IOT_MQTT_STATUS_PENDING, IotMqtt_PublishAsync( mqttConnection,
+                                                                      &publishInfo,
+                                                                      0,
+                                                                      &callbackInfo,
+                                                                      NULL ) );
+
+    if( _broker.sendFails == false )
+    {
+        TEST_ASSERT_EQUAL_INT( true, IotSemaphore_TimedWait( &( _broker.publishSem ), TIMEOUT_MS ) );
+        pMessage->packetIdentifier = _broker.publishes[ publishCount ].packetIdentifier;
+        TEST_ASSERT_EQUAL_INT( false, _broker.publishes[ publishCount ].dup );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Wait for the session to hold `count` PUBLISH messages.
+ *
+ * A PUBLISH whose send job runs while the connection is closed is kept by
+ * that job, shortly after @ref mqtt_function_disconnect returns.
+ */
+static void _waitPending( uint32_t count )
+{
+    uint64_t startTime = IotClock_GetTimeMs();
+
+    while( ( _session.pending != count ) &&
+           ( IotClock_GetTimeMs() - startTime < TIMEOUT_MS ) )
+    {
+        IotClock_SleepMs( 10 );
+    }
+
+    TEST_ASSERT_EQUAL_UINT32( count, _session.pending );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Wait for the mock broker to receive `count` PUBLISH packets sent again
+ * and acknowledge them in order, until every callback has been invoked.
+ *
+ * @return The number of PUBLISH packets received.
+ */
+static size_t _acknowledgeResent( size_t firstPublish,
+                                  size_t count )
+{
+    size_t i = 0;
+
+    for( i = 0; i < count; i++ )
+    {
+        TEST_ASSERT_EQUAL_INT( true, IotSemaphore_TimedWait( &( _broker.publishSem ), TIMEOUT_MS ) );
+
+        /* A PUBLISH sent again is a duplicate. */
+        TEST_ASSERT_EQUAL_INT( true, _broker.publishes[ firstPublish + i ].dup );
+    }
+
+    for( i = 0; i < count; i++ )
+    {
+        /* The PUBACK may arrive before the PUBLISH is waiting for it; send it
+         * again until its callback is invoked, as a broker would after a retry. */
+        do
+        {
+            IotTest_MqttMockBrokerReceive( MQTT_PACKET_TYPE_PUBACK,
+                                           2,
+                                           _broker.publishes[ firstPublish + i ].packetIdentifier );
+        } while( IotSemaphore_TimedWait( &_completeSem, 20 ) == false );
+    }
+
+    return count;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test group for MQTT session tests.
+ */
+TEST_GROUP( MQTT_Unit_Session );
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test setup for MQTT session tests.
+ */
+TEST_SETUP( MQTT_Unit_Session )
+{
+    /* Reset the mock broker and the messages. */
+    ( void ) memset( &_broker, 0x00, sizeof( _broker_t ) );
+    ( void ) memset( _messages, 0x00, sizeof( _messages ) );
+    _lastCompleteTime = 0;
+
+    /* Reset the network info; its interface is the mock broker. */
+    ( void ) memset( &_networkInfo, 0x00, sizeof( IotMqttNetworkInfo_t ) );
+
+    /* Initialize libraries. */
+    TEST_ASSERT_EQUAL_INT( true, IotSdk_Init() );
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_Init() );
+
+    TEST_ASSERT_EQUAL_INT( true, IotTest_MqttMockBrokerInit( &_networkInfo,
+                                                             _brokerHandler,
+                                                             BROKER_DELAY_MS ) );
+
+    TEST_ASSERT_EQUAL_INT( true, IotMutex_Create( &( _broker.mutex ), false ) );
+    TEST_ASSERT_EQUAL_INT( true, IotSemaphore_Create( &( _broker.publishSem ), 0, BROKER_MAX_PUBLISH ) );
+    TEST_ASSERT_EQUAL_INT( true, IotSemaphore_Create( &_completeSem, 0, MAX_MESSAGES ) );
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_InitSession( &_session ) );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test tear down for MQTT session tests.
+ */
+TEST_TEAR_DOWN( MQTT_Unit_Session )
+{
+    IotMqtt_CleanupSession( &_session );
+    IotSemaphore_Destroy( &_completeSem );
+    IotTest_MqttMockBrokerCleanup();
+    IotSemaphore_Destroy( &( _broker.publishSem ) );
+    IotMutex_Destroy( &( _broker.mutex ) );
+
+    IotMqtt_Cleanup();
+    IotSdk_Cleanup();
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test group runner for MQTT session tests.
+ */
+TEST_GROUP_RUNNER( MQTT_Unit_Session )
+{
+    RUN_TEST_CASE( MQTT_Unit_Session, SessionPresent );
+    RUN_TEST_CASE( MQTT_Unit_Session, SubscribeRestored );
+    RUN_TEST_CASE( MQTT_Unit_Session, PublishKeptAcrossDisconnect );
+    RUN_TEST_CASE( MQTT_Unit_Session, PublishKeptOnSendFailure );
+    RUN_TEST_CASE( MQTT_Unit_Session, CleanupNotifies );
+    RUN_TEST_CASE( MQTT_Unit_Session, ScriptedDisconnects );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that the "Session Present" flag of the CONNACK is reported by
+ * @ref mqtt_function_sessionpresent.
+ */
+TEST( MQTT_Unit_Session, SessionPresent )
+{
+    IotMqttConnection_t mqttConnection = IOT_MQTT_CONNECTION_INITIALIZER;
+
+    TEST_ASSERT_EQUAL( IOT_MQTT_BAD_PARAMETER, IotMqtt_InitSession( NULL ) );
+
+    mqttConnection = _connect( false );
+    TEST_ASSERT_EQUAL_INT( false, IotMqtt_SessionPresent( mqttConnection ) );
+    IotMqtt_Disconnect( mqttConnection, 0 );
+
+    mqttConnection = _connect( true );
+    TEST_ASSERT_EQUAL_INT( true, IotMqtt_SessionPresent( mqttConnection ) );
+    IotMqtt_Disconnect( mqttConnection, 0 );
+
+    /* Nothing was published, so nothing was kept. */
+    TEST_ASSERT_EQUAL_UINT32( 0, _session.stored );
+    TEST_ASSERT_EQUAL_UINT32( 0, _session.resent );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that #IOT_MQTT_FLAG_SESSION_RESTORE registers a subscription
+ * without SUBSCRIBE only when the session is present.
+ */
+TEST( MQTT_Unit_Session, SubscribeRestored )
+{
+    IotMqttConnection_t mqttConnection = IOT_MQTT_CONNECTION_INITIALIZER;
+    IotMqttSubscription_t subscription = IOT_MQTT_SUBSCRIPTION_INITIALIZER;
+
+    subscription.qos = IOT_MQTT_QOS_1;
+    subscription.pTopicFilter = TEST_TOPIC_NAME;
+    subscription.topicFilterLength = TEST_TOPIC_NAME_LENGTH;
+    subscription.callback.function = _publishComplete;
+
+    /* With the session present, the subscription is only added to the connection. */
+    mqttConnection = _connect( true );
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_SubscribeSync( mqttConnection,
+                                                                &subscription,
+                                                                1,
+                                                                IOT_MQTT_FLAG_SESSION_RESTORE,
+                                                                TIMEOUT_MS ) );
+    TEST_ASSERT_EQUAL( 0, _broker.subscribeCount );
+    TEST_ASSERT_EQUAL_INT( true, IotMqtt_IsSubscribed( mqttConnection,
+                                                       TEST_TOPIC_NAME,
+                                                       TEST_TOPIC_NAME_LENGTH,
+                                                       NULL ) );
+    IotMqtt_Disconnect( mqttConnection, 0 );
+
+    /* Without a session, SUBSCRIBE is sent. The mock broker sends no SUBACK. */
+    mqttConnection = _connect( false );
+    TEST_ASSERT_EQUAL( IOT_MQTT_TIMEOUT, IotMqtt_SubscribeSync( mqttConnection,
+                                                                &subscription,
+                                                                1,
+                                                                IOT_MQTT_FLAG_SESSION_RESTORE,
+                                                                BROKER_DELAY_MS ) );
+    TEST_ASSERT_EQUAL( 1, _broker.subscribeCount );
+    TEST_ASSERT_EQUAL_INT( false, IotMqtt_IsSubscribed( mqttConnection,
+                                                        TEST_TOPIC_NAME,
+                                                        TEST_TOPIC_NAME_LENGTH,
+                                                        NULL ) );
+    IotMqtt_Disconnect( mqttConnection, 0 );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that unacknowledged PUBLISH messages survive a disconnect and are
+ * sent again with the same packet identifier and the DUP flag set.
+ */
+TEST( MQTT_Unit_Session, PublishKeptAcrossDisconnect )
+{
+    IotMqttConnection_t mqttConnection = IOT_MQTT_CONNECTION_INITIALIZER;
+    size_t i = 0, firstPublish = 0;
+    const size_t messageCount = 4;
+
+    mqttConnection = _connect( false );
+
+    /* Alternate PUBLISH messages with and without retry. The broker acknowledges
+     * none of them before the connection is dropped. */
+    for( i = 0; i < messageCount; i++ )
+    {
+        _publish( mqttConnection, &( _messages[ i ] ), ( uint32_t ) ( i % 2 ) * 3 );
+    }
+
+    IotMqtt_Disconnect( mqttConnection, IOT_MQTT_FLAG_CLEANUP_ONLY );
+
+    /* No callback was invoked; every PUBLISH is kept. */
+    _waitPending( messageCount );
+    TEST_ASSERT_EQUAL_INT( false, IotSemaphore_TryWait( &_completeSem ) );
+    TEST_ASSERT_EQUAL_UINT32( messageCount, _session.stored );
+
+    /* Reconnect; the PUBLISH messages are sent again in order. */
+    firstPublish = _broker.publishCount;
+    mqttConnection = _connect( true );
+    ( void ) _acknowledgeResent( firstPublish, messageCount );
+
+    for( i = 0; i < messageCount; i++ )
+    {
+        TEST_ASSERT_EQUAL_UINT16( _messages[ i ].packetIdentifier,
+                                  _broker.publishes[ firstPublish + i ].packetIdentifier );
+        TEST_ASSERT_EQUAL_UINT32( 1, _messages[ i ].completions );
+        TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, _messages[ i ].result );
+    }
+
+    TEST_ASSERT_EQUAL_UINT32( messageCount, _session.resent );
+    TEST_ASSERT_EQUAL_UINT32( 0, _session.pending );
+
+    IotMqtt_Disconnect( mqttConnection, 0 );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that a PUBLISH that could not be sent is kept instead of failing.
+ */
+TEST( MQTT_Unit_Session, PublishKeptOnSendFailure )
+{
+    IotMqttConnection_t mqttConnection = IOT_MQTT_CONNECTION_INITIALIZER;
+
+    mqttConnection = _connect( false );
+
+    _broker.sendFails = true;
+    _publish( mqttConnection, &( _messages[ 0 ] ), 0 );
+
+    /* The send job runs in the task pool. */
+    _waitPending( 1 );
+    TEST_ASSERT_EQUAL_UINT32( 1, _session.stored );
+    TEST_ASSERT_EQUAL_UINT32( 0, _messages[ 0 ].completions );
+
+    IotMqtt_Disconnect( mqttConnection, IOT_MQTT_FLAG_CLEANUP_ONLY );
+
+    _broker.sendFails = false;
+    mqttConnection = _connect( true );
+    ( void ) _acknowledgeResent( 0, 1 );
+
+    TEST_ASSERT_EQUAL_UINT32( 1, _messages[ 0 ].completions );
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, _messages[ 0 ].result );
+
+    IotMqtt_Disconnect( mqttConnection, 0 );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that @ref mqtt_function_cleanupsession completes the PUBLISH
+ * messages still kept.
+ */
+TEST( MQTT_Unit_Session, CleanupNotifies )
+{
+    IotMqttConnection_t mqttConnection = IOT_MQTT_CONNECTION_INITIALIZER;
+
+    mqttConnection = _connect( false );
+    _publish( mqttConnection, &( _messages[ 0 ] ), 0 );
+    _publish( mqttConnection, &( _messages[ 1 ] ), 2 );
+    IotMqtt_Disconnect( mqttConnection, IOT_MQTT_FLAG_CLEANUP_ONLY );
+
+    _waitPending( 2 );
+
+    /* Clean up and initialize again for the test tear down. */
+    IotMqtt_CleanupSession( &_session );
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_InitSession( &_session ) );
+
+    TEST_ASSERT_EQUAL_UINT32( 1, _messages[ 0 ].completions );
+    TEST_ASSERT_EQUAL( IOT_MQTT_NETWORK_ERROR, _messages[ 0 ].result );
+    TEST_ASSERT_EQUAL_UINT32( 1, _messages[ 1 ].completions );
+    TEST_ASSERT_EQUAL( IOT_MQTT_NETWORK_ERROR, _messages[ 1 ].result );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Drops the connection several times with PUBLISH messages in flight
+ * and checks that every message is delivered exactly once. Prints the time from
+ * each reconnect to the first delivery.
+ */
+TEST( MQTT_Unit_Session, ScriptedDisconnects )
+{
+    IotMqttConnection_t mqttConnection = IOT_MQTT_CONNECTION_INITIALIZER;
+    size_t round = 0, i = 0, firstPublish = 0, published = 0;
+    size_t resent = 0, kept = 0;
+    uint64_t connectTime = 0, deliveryTime = 0, totalDeliveryTime = 0;
+
+    for( round = 0; round <= SCRIPT_ROUNDS; round++ )
+    {
+        /* Reconnect; whatever was kept is sent again first. */
+        firstPublish = _broker.publishCount;
+        connectTime = IotClock_GetTimeMs();
+        mqttConnection = _connect( round > 0 );
+
+        if( kept > 0 )
+        {
+            resent += _acknowledgeResent( firstPublish, kept );
+            deliveryTime = _lastCompleteTime - connectTime;
+            totalDeliveryTime += deliveryTime;
+
+            UnityPrint( "ScriptedDisconnects reconnect " );
+            UnityPrintNumber( ( UNITY_INT ) round );
+            UnityPrint( ": " );
+            UnityPrintNumber( ( UNITY_INT ) kept );
+            UnityPrint( " PUBLISH sent again, all delivered " );
+            UnityPrintNumber( ( UNITY_INT ) deliveryTime );
+            UnityPrint( " ms after CONNECT." );
+            UNITY_PRINT_EOL();
+        }
+
+        if( round == SCRIPT_ROUNDS )
+        {
+            break;
+        }
+
+        /* Publish new messages; the broker acknowledges only the first one
+         * before dropping the connection. */
+        for( i = 0; i < SCRIPT_MESSAGES_PER_ROUND; i++ )
+        {
+            _publish( mqttConnection, &( _messages[ published + i ] ), ( uint32_t ) ( i % 2 ) * 3 );
+        }
+
+        do
+        {
+            IotTest_MqttMockBrokerReceive( MQTT_PACKET_TYPE_PUBACK,
+                                           2,
+                                           _messages[ published ].packetIdentifier );
+        } while( IotSemaphore_TimedWait( &_completeSem, 20 ) == false );
+
+        published += SCRIPT_MESSAGES_PER_ROUND;
+        kept = SCRIPT_MESSAGES_PER_ROUND - 1;
+
+        IotMqtt_Disconnect( mqttConnection, IOT_MQTT_FLAG_CLEANUP_ONLY );
+        _waitPending( ( uint32_t ) kept );
+    }
+
+    IotMqtt_Disconnect( mqttConnection, 0 );
+
+    /* No message lost, none delivered twice. */
+    for( i = 0; i < published; i++ )
+    {
+        TEST_ASSERT_EQUAL_UINT32( 1, _messages[ i ].completions );
+        TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, _messages[ i ].result );
+    }
+
+    TEST_ASSERT_EQUAL_UINT32( resent, _session.resent );
+    TEST_ASSERT_EQUAL_UINT32( resent, _session.stored );
+    TEST_ASSERT_EQUAL_UINT32( 0, _session.pending );
+
+    UnityPrint( "ScriptedDisconnects: " );
+    UnityPrintNumber( ( UNITY_INT ) published );
+    UnityPrint( " PUBLISH, 0 lost, mean reconnect to delivery " );
+    UnityPrintNumber( ( UNITY_INT ) ( totalDeliveryTime / SCRIPT_ROUNDS ) );
+    UnityPrint( " ms." );
+    UNITY_PRINT_EOL();
+}
+
+/*-----------------------------------------------------------*/
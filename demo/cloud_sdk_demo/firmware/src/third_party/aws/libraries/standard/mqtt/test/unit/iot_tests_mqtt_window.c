@@ -0,0 +1,629 @@
+/*
+ * IoT MQTT V2.1.0
+ * Copyright (C) 2018 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file iot_tests_mqtt_window.c
+ * @brief Tests for the publish window (#IotMqttConnectInfo_t.publishWindow) and
+ * the adaptive PUBLISH retry period (#IOT_MQTT_RETRY_MS_ADAPTIVE).
+ *
+ * The network interface is the mock broker of iot_tests_mqtt_mock.h, which here
+ * acknowledges every PUBLISH after a fixed latency, from a thread of its own,
+ * so that several PUBLISH messages are in flight at once as over a real link.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <stdlib.h>
+#include <string.h>
+
+/* SDK initialization include. */
+#include "iot_init.h"
+
+/* MQTT internal include. */
+#include "private/iot_mqtt_internal.h"
+
+/* Platform layer includes. */
+#include "platform/iot_clock.h"
+#include "platform/iot_threads.h"
+
+/* MQTT mock include. */
+#include "iot_tests_mqtt_mock.h"
+
+/* Test framework includes. */
+#include "unity_fixture.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Timeout to use for the tests. This can be short, but should allow time
+ * for other threads to run.
+ */
+#define TIMEOUT_MS                  ( 400 )
+
+/**
+ * @brief Time taken by the mock broker to answer a CONNECT.
+ */
+#define BROKER_DELAY_MS             ( 20 )
+
+/**
+ * @brief Most PUBACK packets queued by the mock broker.
+ */
+#define BROKER_MAX_PUBACK           ( 32 )
+
+/**
+ * @brief Most PUBLISH messages published by a test.
+ */
+#define MAX_MESSAGES                ( 128 )
+
+/*
+ * Constants that affect the behavior of #TEST_MQTT_Unit_Window_Benchmark.
+ */
+#define BENCHMARK_MESSAGES          ( 100 ) /**< @brief PUBLISH messages sent with each window. */
+#define BENCHMARK_LATENCY_MS        ( 10 )  /**< @brief PUBACK latency of the mock broker. */
+
+/**
+ * @brief PUBACK latency of the mock broker in #TEST_MQTT_Unit_Window_AdaptiveRetry.
+ */
+#define ADAPTIVE_LATENCY_MS         ( 50 )
+
+/*
+ * Client identifier and length to use for the MQTT window tests.
+ */
+#define CLIENT_IDENTIFIER           ( "test" )                                           /**< @brief Client identifier. */
+#define CLIENT_IDENTIFIER_LENGTH    ( ( uint16_t ) ( sizeof( CLIENT_IDENTIFIER ) - 1 ) ) /**< @brief Length of client identifier. */
+
+/*
+ * Topic name and length to use for the MQTT window tests.
+ */
+#define TEST_TOPIC_NAME             ( "/test/topic" )                                  /**< @brief An arbitrary topic name. */
+#define TEST_TOPIC_NAME_LENGTH      ( ( uint16_t ) ( sizeof( TEST_TOPIC_NAME ) - 1 ) ) /**< @brief Length of topic name. */
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A PUBACK waiting to be sent by the mock broker.
+ */
+typedef struct _brokerPuback
+{
+    uint16_t packetIdentifier; /**< @brief Packet identifier of the acknowledged PUBLISH. */
+    uint64_t dueTimeMs;        /**< @brief When to send the PUBACK. */
+} _brokerPuback_t;
+
+/**
+ * @brief State of the mock broker.
+ */
+typedef struct _broker
+{
+    IotMutex_t mutex;                               /**< @brief Protects the PUBACK queue. */
+    IotSemaphore_t pubackSem;                       /**< @brief Posted for each PUBACK queued. */
+    IotSemaphore_t exitSem;                         /**< @brief Posted when the broker thread exits. */
+    volatile bool running;                          /**< @brief Cleared to stop the broker thread. */
+    uint32_t latencyMs;                             /**< @brief Time from a PUBLISH to its PUBACK. */
+    uint32_t dropCount;                             /**< @brief Number of PUBLISH packets to ignore. */
+    uint32_t publishCount;                          /**< @brief Number of PUBLISH packets received. */
+    size_t head;                                    /**< @brief Next PUBACK to send. */
+    size_t tail;                                    /**< @brief Next free slot of the queue. */
+    _brokerPuback_t pubacks[ BROKER_MAX_PUBACK ];   /**< @brief Queue of PUBACK packets to send. */
+} _broker_t;
+
+/**
+ * @brief A PUBLISH message published by a test.
+ */
+typedef struct _message
+{
+    uint64_t publishTimeMs;  /**< @brief When the message was published. */
+    uint64_t completeTimeMs; /**< @brief When its callback was invoked. */
+    uint32_t completions;    /**< @brief Number of times its callback was invoked. */
+    IotMqttError_t result;   /**< @brief Result given to the last callback. */
+} _message_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The mock broker shared by the tests.
+ */
+static _broker_t _broker = { 0 };
+
+/**
+ * @brief The PUBLISH messages of a test.
+ */
+static _message_t _messages[ MAX_MESSAGES ] = { 0 };
+
+/**
+ * @brief Posted for each PUBLISH callback invoked.
+ */
+static IotSemaphore_t _completeSem;
+
+/**
+ * @brief An #IotMqttNetworkInfo_t to share among the tests.
+ */
+static IotMqttNetworkInfo_t _networkInfo = IOT_MQTT_NETWORK_INFO_INITIALIZER;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The mock broker thread; sends the queued PUBACK packets when due.
+ *
+ * The latency is the same for every PUBLISH, so the queue is in due order.
+ */
+static void _brokerThread( void * pArgument )
+{
+    _brokerPuback_t puback = { 0 };
+    uint64_t now = 0;
+
+    /* Silence warnings about unused parameters. */
+    ( void ) pArgument;
+
+    while( _broker.running == true )
+    {
+        if( IotSemaphore_TimedWait( &( _broker.pubackSem ), 10 ) == true )
+        {
+            IotMutex_Lock( &( _broker.mutex ) );
+            puback = _broker.pubacks[ _broker.head ];
+            _broker.head = ( _broker.head + 1 ) % BROKER_MAX_PUBACK;
+            IotMutex_Unlock( &( _broker.mutex ) );
+
+            now = IotClock_GetTimeMs();
+
+            if( puback.dueTimeMs > now )
+            {
+                IotClock_SleepMs( ( uint32_t ) ( puback.dueTimeMs - now ) );
+            }
+
+            IotTest_MqttMockBrokerReceive( MQTT_PACKET_TYPE_PUBACK, 2, puback.packetIdentifier );
+        }
+    }
+
+    IotSemaphore_Post( &( _broker.exitSem ) );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Handler of the packets sent to the mock broker; queues a PUBACK for
+ * each PUBLISH with QoS 1.
+ */
+static size_t _brokerHandler( const uint8_t * pPacket,
+                              size_t packetLength,
+                              uint16_t packetIdentifier )
+{
+    bool drop = false;
+
+    if( ( pPacket[ 0 ] & 0xf0 ) == MQTT_PACKET_TYPE_PUBLISH )
+    {
+        IotMutex_Lock( &( _broker.mutex ) );
+        _broker.publishCount++;
+
+        if( packetIdentifier == 0 )
+        {
+            /* A QoS 0 PUBLISH is not acknowledged. */
+            drop = true;
+        }
+        else if( _broker.dropCount > 0 )
+        {
+            _broker.dropCount--;
+            drop = true;
+        }
+        else
+        {
+            TEST_ASSERT_NOT_EQUAL( _broker.head, ( _broker.tail + 1 ) % BROKER_MAX_PUBACK );
+            _broker.pubacks[ _broker.tail ].packetIdentifier = packetIdentifier;
+            _broker.pubacks[ _broker.tail ].dueTimeMs = IotClock_GetTimeMs() + _broker.latencyMs;
+            _broker.tail = ( _broker.tail + 1 ) % BROKER_MAX_PUBACK;
+        }
+
+        IotMutex_Unlock( &( _broker.mutex ) );
+
+        if( drop == false )
+        {
+            IotSemaphore_Post( &( _broker.pubackSem ) );
+        }
+    }
+
+    return packetLength;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief PUBLISH completion callback; records the result in a #_message_t.
+ */
+static void _publishComplete( void * pCallbackContext,
+                              IotMqttCallbackParam_t * pCallbackParam )
+{
+    _message_t * pMessage = ( _message_t * ) pCallbackContext;
+
+    pMessage->completions++;
+    pMessage->result = pCallbackParam->u.operation.result;
+    pMessage->completeTimeMs = IotClock_GetTimeMs();
+
+    IotSemaphore_Post( &_completeSem );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Establish a connection with the mock broker.
+ */
+static IotMqttConnection_t _connect( uint16_t publishWindow )
+{
+    IotMqttConnection_t mqttConnection = IOT_MQTT_CONNECTION_INITIALIZER;
+    IotMqttConnectInfo_t connectInfo = IOT_MQTT_CONNECT_INFO_INITIALIZER;
+
+    connectInfo.pClientIdentifier = CLIENT_IDENTIFIER;
+    connectInfo.clientIdentifierLength = CLIENT_IDENTIFIER_LENGTH;
+    connectInfo.publishWindow = publishWindow;
+
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_Connect( &_networkInfo,
+                                                          &connectInfo,
+                                                          TIMEOUT_MS,
+                                                          &mqttConnection ) );
+
+    /* Let the mock broker thread return before going on. */
+    TEST_ASSERT_EQUAL_INT( true, IotTest_MqttMockBrokerWaitAnswer( TIMEOUT_MS ) );
+
+    return mqttConnection;
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Publish a QoS 1 message with adaptive retry.
+ *
+ * @return The result of @ref mqtt_function_publishasync.
+ */
+static IotMqttError_t _publish( IotMqttConnection_t mqttConnection,
+                                _message_t * pMessage )
+{
+    IotMqttPublishInfo_t publishInfo = IOT_MQTT_PUBLISH_INFO_INITIALIZER;
+    IotMqttCallbackInfo_t callbackInfo = IOT_MQTT_CALLBACK_INFO_INITIALIZER;
+
+    publishInfo.qos = IOT_MQTT_QOS_1;
+    publishInfo.pTopicName = TEST_TOPIC_NAME;
+    publishInfo.topicNameLength = TEST_TOPIC_NAME_LENGTH;
+    publishInfo.pPayload = "";
+    publishInfo.payloadLength = 0;
+    publishInfo.retryMs = IOT_MQTT_RETRY_MS_ADAPTIVE;
+    publishInfo.retryLimit = 3;
+    callbackInfo.function = _publishComplete;
+    callbackInfo.pCallbackContext = pMessage;
+
+    pMessage->publishTimeMs = IotClock_GetTimeMs();
+
+    return IotMqtt_PublishAsync( mqttConnection,
+                                 &publishInfo,
+                                 0,
+                                 &callbackInfo,
+                                 NULL );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Publish `count` messages as fast as the publish window allows, waiting
+ * for a credit whenever it is full, then wait for every PUBACK.
+ */
+static void _publishAll( IotMqttConnection_t mqttConnection,
+                         size_t count )
+{
+    size_t i = 0;
+    IotMqttError_t status = IOT_MQTT_STATUS_PENDING;
+
+    for( i = 0; i < count; i++ )
+    {
+        do
+        {
+            status = _publish( mqttConnection, &( _messages[ i ] ) );
+
+            if( status == IOT_MQTT_WINDOW_FULL )
+            {
+                TEST_ASSERT_EQUAL_INT( true, IotMqtt_WaitPublishCredit( mqttConnection, TIMEOUT_MS ) );
+            }
+        } while( status == IOT_MQTT_WINDOW_FULL );
+
+        TEST_ASSERT_EQUAL( IOT_MQTT_STATUS_PENDING, status );
+    }
+
+    for( i = 0; i < count; i++ )
+    {
+        TEST_ASSERT_EQUAL_INT( true, IotSemaphore_TimedWait( &_completeSem, TIMEOUT_MS ) );
+    }
+
+    for( i = 0; i < count; i++ )
+    {
+        TEST_ASSERT_EQUAL_UINT32( 1, _messages[ i ].completions );
+        TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, _messages[ i ].result );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Compare two latencies for qsort.
+ */
+static int _compareLatency( const void * pFirst,
+                            const void * pSecond )
+{
+    uint64_t first = *( ( const uint64_t * ) pFirst );
+    uint64_t second = *( ( const uint64_t * ) pSecond );
+
+    return ( first > second ) - ( first < second );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test group for MQTT publish window tests.
+ */
+TEST_GROUP( MQTT_Unit_Window );
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test setup for MQTT publish window tests.
+ */
+TEST_SETUP( MQTT_Unit_Window )
+{
+    /* Reset the mock broker and the messages. */
+    ( void ) memset( &_broker, 0x00, sizeof( _broker_t ) );
+    ( void ) memset( _messages, 0x00, sizeof( _messages ) );
+
+    /* Reset the network info; its interface is the mock broker. */
+    ( void ) memset( &_networkInfo, 0x00, sizeof( IotMqttNetworkInfo_t ) );
+
+    /* Initialize libraries. */
+    TEST_ASSERT_EQUAL_INT( true, IotSdk_Init() );
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_Init() );
+
+    TEST_ASSERT_EQUAL_INT( true, IotTest_MqttMockBrokerInit( &_networkInfo,
+                                                             _brokerHandler,
+                                                             BROKER_DELAY_MS ) );
+
+    TEST_ASSERT_EQUAL_INT( true, IotMutex_Create( &( _broker.mutex ), false ) );
+    TEST_ASSERT_EQUAL_INT( true, IotSemaphore_Create( &( _broker.pubackSem ), 0, BROKER_MAX_PUBACK ) );
+    TEST_ASSERT_EQUAL_INT( true, IotSemaphore_Create( &( _broker.exitSem ), 0, 1 ) );
+    TEST_ASSERT_EQUAL_INT( true, IotSemaphore_Create( &_completeSem, 0, MAX_MESSAGES ) );
+
+    /* Start the mock broker thread. */
+    _broker.running = true;
+    TEST_ASSERT_EQUAL_INT( true, Iot_CreateDetachedThread( _brokerThread,
+                                                           NULL,
+                                                           IOT_THREAD_DEFAULT_PRIORITY,
+                                                           IOT_THREAD_DEFAULT_STACK_SIZE ) );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test tear down for MQTT publish window tests.
+ */
+TEST_TEAR_DOWN( MQTT_Unit_Window )
+{
+    /* Stop the mock broker thread. */
+    _broker.running = false;
+    TEST_ASSERT_EQUAL_INT( true, IotSemaphore_TimedWait( &( _broker.exitSem ), TIMEOUT_MS ) );
+
+    IotSemaphore_Destroy( &_completeSem );
+    IotSemaphore_Destroy( &( _broker.exitSem ) );
+    IotTest_MqttMockBrokerCleanup();
+    IotSemaphore_Destroy( &( _broker.pubackSem ) );
+    IotMutex_Destroy( &( _broker.mutex ) );
+
+    IotMqtt_Cleanup();
+    IotSdk_Cleanup();
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Test group runner for MQTT publish window tests.
+ */
+TEST_GROUP_RUNNER( MQTT_Unit_Window )
+{
+    RUN_TEST_CASE( MQTT_Unit_Window, WindowFull );
+    RUN_TEST_CASE( MQTT_Unit_Window, NoWindow );
+    RUN_TEST_CASE( MQTT_Unit_Window, AdaptiveRetry );
+    RUN_TEST_CASE( MQTT_Unit_Window, Benchmark );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that a QoS 1 PUBLISH over the window fails with
+ * #IOT_MQTT_WINDOW_FULL until a PUBACK frees a credit.
+ */
+TEST( MQTT_Unit_Window, WindowFull )
+{
+    IotMqttConnection_t mqttConnection = IOT_MQTT_CONNECTION_INITIALIZER;
+    IotMqttPublishStats_t stats = { 0 };
+    IotMqttPublishInfo_t publishInfo = IOT_MQTT_PUBLISH_INFO_INITIALIZER;
+
+    _broker.latencyMs = 100;
+    mqttConnection = _connect( 2 );
+
+    TEST_ASSERT_EQUAL_INT( true, IotMqtt_WaitPublishCredit( mqttConnection, 0 ) );
+    TEST_ASSERT_EQUAL( IOT_MQTT_STATUS_PENDING, _publish( mqttConnection, &( _messages[ 0 ] ) ) );
+    TEST_ASSERT_EQUAL( IOT_MQTT_STATUS_PENDING, _publish( mqttConnection, &( _messages[ 1 ] ) ) );
+
+    /* The window is full. */
+    TEST_ASSERT_EQUAL( IOT_MQTT_WINDOW_FULL, _publish( mqttConnection, &( _messages[ 2 ] ) ) );
+    TEST_ASSERT_EQUAL_INT( false, IotMqtt_WaitPublishCredit( mqttConnection, 0 ) );
+    TEST_ASSERT_EQUAL_STRING( "WINDOW FULL", IotMqtt_strerror( IOT_MQTT_WINDOW_FULL ) );
+
+    IotMqtt_GetPublishStats( mqttConnection, &stats );
+    TEST_ASSERT_EQUAL_UINT32( 2, stats.window );
+    TEST_ASSERT_EQUAL_UINT32( 2, stats.inFlight );
+
+    /* A QoS 0 PUBLISH is not limited. */
+    publishInfo.pTopicName = TEST_TOPIC_NAME;
+    publishInfo.topicNameLength = TEST_TOPIC_NAME_LENGTH;
+    publishInfo.pPayload = "";
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, IotMqtt_PublishAsync( mqttConnection, &publishInfo, 0, NULL, NULL ) );
+
+    /* The first PUBACK frees a credit. */
+    TEST_ASSERT_EQUAL_INT( true, IotMqtt_WaitPublishCredit( mqttConnection, TIMEOUT_MS ) );
+    TEST_ASSERT_EQUAL_INT( true, IotSemaphore_TimedWait( &_completeSem, TIMEOUT_MS ) );
+    TEST_ASSERT_EQUAL_UINT32( 1, _messages[ 0 ].completions );
+    TEST_ASSERT_EQUAL( IOT_MQTT_STATUS_PENDING, _publish( mqttConnection, &( _messages[ 2 ] ) ) );
+
+    /* Wait for the other two PUBACK packets; every credit is back. */
+    TEST_ASSERT_EQUAL_INT( true, IotSemaphore_TimedWait( &_completeSem, TIMEOUT_MS ) );
+    TEST_ASSERT_EQUAL_INT( true, IotSemaphore_TimedWait( &_completeSem, TIMEOUT_MS ) );
+
+    IotMqtt_GetPublishStats( mqttConnection, &stats );
+    TEST_ASSERT_EQUAL_UINT32( 0, stats.inFlight );
+    TEST_ASSERT_EQUAL_UINT32( 3, stats.samples );
+
+    IotMqtt_Disconnect( mqttConnection, 0 );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that a window of 0 does not limit PUBLISH messages.
+ */
+TEST( MQTT_Unit_Window, NoWindow )
+{
+    IotMqttConnection_t mqttConnection = IOT_MQTT_CONNECTION_INITIALIZER;
+    IotMqttPublishStats_t stats = { 0 };
+
+    _broker.latencyMs = 20;
+    mqttConnection = _connect( 0 );
+
+    IotMqtt_GetPublishStats( mqttConnection, &stats );
+
+    #if IOT_STATIC_MEMORY_ONLY == 1
+        TEST_ASSERT_EQUAL_UINT32( IOT_MQTT_MAX_IN_PROGRESS_OPERATIONS - 2, stats.window );
+    #else
+        TEST_ASSERT_EQUAL_UINT32( 0, stats.window );
+        TEST_ASSERT_EQUAL_INT( true, IotMqtt_WaitPublishCredit( mqttConnection, 0 ) );
+        _publishAll( mqttConnection, 16 );
+    #endif
+
+    IotMqtt_Disconnect( mqttConnection, 0 );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Tests that the retry period of adaptive PUBLISH messages follows the
+ * PUBACK round trip time, and that a PUBLISH sent twice is not measured.
+ */
+TEST( MQTT_Unit_Window, AdaptiveRetry )
+{
+    IotMqttConnection_t mqttConnection = IOT_MQTT_CONNECTION_INITIALIZER;
+    IotMqttPublishStats_t stats = { 0 };
+    const size_t messageCount = 16;
+    uint64_t retryTime = 0;
+
+    _broker.latencyMs = ADAPTIVE_LATENCY_MS;
+    mqttConnection = _connect( 4 );
+
+    /* Before any PUBACK, the initial retry period is used. */
+    IotMqtt_GetPublishStats( mqttConnection, &stats );
+    TEST_ASSERT_EQUAL_UINT32( 0, stats.samples );
+    TEST_ASSERT_EQUAL_UINT32( IOT_MQTT_ADAPTIVE_RETRY_INITIAL_MS, stats.retryMs );
+
+    _publishAll( mqttConnection, messageCount );
+
+    IotMqtt_GetPublishStats( mqttConnection, &stats );
+    TEST_ASSERT_EQUAL_UINT32( messageCount, stats.samples );
+    TEST_ASSERT_UINT32_WITHIN( ADAPTIVE_LATENCY_MS / 2, ADAPTIVE_LATENCY_MS + ADAPTIVE_LATENCY_MS / 2, stats.srttMs );
+    TEST_ASSERT_LESS_THAN_UINT32( IOT_MQTT_ADAPTIVE_RETRY_INITIAL_MS, stats.retryMs );
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32( IOT_MQTT_ADAPTIVE_RETRY_MIN_MS, stats.retryMs );
+
+    /* Lose the next PUBLISH; it is sent again after the adapted period. */
+    _broker.dropCount = 1;
+    TEST_ASSERT_EQUAL( IOT_MQTT_STATUS_PENDING, _publish( mqttConnection, &( _messages[ messageCount ] ) ) );
+    TEST_ASSERT_EQUAL_INT( true, IotSemaphore_TimedWait( &_completeSem, IOT_MQTT_ADAPTIVE_RETRY_INITIAL_MS ) );
+    TEST_ASSERT_EQUAL( IOT_MQTT_SUCCESS, _messages[ messageCount ].result );
+
+    retryTime = _messages[ messageCount ].completeTimeMs - _messages[ messageCount ].publishTimeMs;
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32( stats.retryMs, ( uint32_t ) retryTime );
+    TEST_ASSERT_LESS_THAN_UINT32( IOT_MQTT_ADAPTIVE_RETRY_INITIAL_MS, ( uint32_t ) retryTime );
+
+    /* Its PUBACK may answer either copy, so it was not measured. */
+    IotMqtt_GetPublishStats( mqttConnection, &stats );
+    TEST_ASSERT_EQUAL_UINT32( messageCount, stats.samples );
+
+    IotMqtt_Disconnect( mqttConnection, 0 );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Publishes through windows of 1, 4 and 8 PUBLISH messages to a broker
+ * with a fixed PUBACK latency, and prints the throughput and the publish to
+ * PUBACK latency percentiles of each.
+ */
+TEST( MQTT_Unit_Window, Benchmark )
+{
+    IotMqttConnection_t mqttConnection = IOT_MQTT_CONNECTION_INITIALIZER;
+    const uint16_t windows[] = { 1, 4, 8 };
+    uint64_t latencies[ BENCHMARK_MESSAGES ] = { 0 };
+    uint64_t startTime = 0, elapsed = 0;
+    uint32_t throughput = 0, lastThroughput = 0;
+    size_t w = 0, i = 0;
+
+    _broker.latencyMs = BENCHMARK_LATENCY_MS;
+
+    for( w = 0; w < sizeof( windows ) / sizeof( windows[ 0 ] ); w++ )
+    {
+        ( void ) memset( _messages, 0x00, sizeof( _messages ) );
+        mqttConnection = _connect( windows[ w ] );
+
+        startTime = IotClock_GetTimeMs();
+        _publishAll( mqttConnection, BENCHMARK_MESSAGES );
+        elapsed = IotClock_GetTimeMs() - startTime;
+
+        IotMqtt_Disconnect( mqttConnection, 0 );
+
+        for( i = 0; i < BENCHMARK_MESSAGES; i++ )
+        {
+            latencies[ i ] = _messages[ i ].completeTimeMs - _messages[ i ].publishTimeMs;
+        }
+
+        qsort( latencies, BENCHMARK_MESSAGES, sizeof( latencies[ 0 ] ), _compareLatency );
+        throughput = ( uint32_t ) ( ( BENCHMARK_MESSAGES * 1000 ) / ( ( elapsed > 0 ) ? elapsed : 1 ) );
+
+        UnityPrint( "Benchmark window " );
+        UnityPrintNumber( ( UNITY_INT ) windows[ w ] );
+        UnityPrint( ": " );
+        UnityPrintNumber( ( UNITY_INT ) throughput );
+        UnityPrint( " msg/s, PUBACK latency p50 " );
+        UnityPrintNumber( ( UNITY_INT ) latencies[ BENCHMARK_MESSAGES / 2 ] );
+        UnityPrint( " ms, p90 " );
+        UnityPrintNumber( ( UNITY_INT ) latencies[ ( BENCHMARK_MESSAGES * 90 ) / 100 ] );
+        UnityPrint( " ms, p99 " );
+        UnityPrintNumber( ( UNITY_INT ) latencies[ ( BENCHMARK_MESSAGES * 99 ) / 100 ] );
+        UnityPrint( " ms." );
+        UNITY_PRINT_EOL();
+
+        /* More PUBLISH messages in flight hide more of the latency. */
+        TEST_ASSERT_GREATER_THAN_UINT32( lastThroughput, throughput );
+        lastThroughput = throughput;
+    }
+}
+
+/*-----------------------------------------------------------*/
@@ -87,6 +87,85 @@
  */
 #define IOT_NETWORK_INTERFACE_WOLFSSL                  ( IotNetworkWolfSSL_GetInterface() )
 
+/**
+ * @brief Cache of resolved host addresses consulted before a DNS lookup.
+ *
+ * The application may register one with #IotNetworkWolfSSL_SetAddressCache so
+ * that a connection can be started without waiting for the resolver. Addresses
+ * are IPv4, in network byte order.
+ */
+typedef struct IotNetworkAddressCache
+{
+    /**
+     * @brief Get an address for `pHostName`. Return `false` if there is none,
+     * and a DNS lookup is made instead. An address past its TTL is still
+     * returned, with `pStale` set; the cache refreshes it meanwhile.
+     */
+    bool ( * get )( const char * pHostName,
+                    uint32_t * pAddress,
+                    bool * pStale );
+
+    /**
+     * @brief Called once the DNS client resolved `pHostName`.
+     */
+    void ( * store )( const char * pHostName );
+
+    /**
+     * @brief Called when `address`, returned by `get`, did not answer.
+     */
+    void ( * invalidate )( const char * pHostName,
+                           uint32_t address );
+
+    /**
+     * @brief TCP connect timeout, in seconds, used with a cached address.
+     */
+    uint32_t connectTimeout;
+} IotNetworkAddressCache_t;
+
+/**
+ * @brief Connection events reported to the application, e.g. for a trace.
+ *
+ * The application may register a set with #IotNetworkWolfSSL_SetEventHooks.
+ * Hooks are called from the task using the connection and must not block;
+ * any of them may be `NULL`.
+ */
+typedef struct IotNetworkEventHooks
+{
+    /**
+     * @brief A TCP socket to IPv4 `address` (network byte order) was opened.
+     */
+    void ( * socketOpen )( int socket,
+                           uint32_t address );
+
+    /**
+     * @brief The TCP connection to `port` is up.
+     */
+    void ( * socketConnected )( int socket,
+                                uint16_t port );
+
+    /**
+     * @brief The TLS handshake started.
+     */
+    void ( * tlsStart )( int socket );
+
+    /**
+     * @brief The TLS handshake ended, with a secure session or not.
+     */
+    void ( * tlsDone )( int socket,
+                        bool secure );
+
+    /**
+     * @brief The socket is being closed.
+     */
+    void ( * socketClose )( int socket );
+
+    /**
+     * @brief `bytesSent` bytes of `pMessage` were written to the connection.
+     */
+    void ( * sent )( const uint8_t * pMessage,
+                     int bytesSent );
+} IotNetworkEventHooks_t;
+
 /**
  * @brief Retrieve the network interface using the functions in this file.
  */
@@ -177,4 +256,16 @@ IotNetworkError_t IotNetworkWolfSSL_Destroy( IotNetworkConnection_t pConnection
  */
 int IotNetworkWolfSSL_GetSocket( IotNetworkConnection_t pConnection );
 
+/**
+ * @brief Register the cache of resolved addresses used by
+ * #IotNetworkWolfSSL_Create, or remove it with `NULL`.
+ */
+void IotNetworkWolfSSL_SetAddressCache( const IotNetworkAddressCache_t * pAddressCache );
+
+/**
+ * @brief Register the hooks called on connection events, or remove them with
+ * `NULL`.
+ */
+void IotNetworkWolfSSL_SetEventHooks( const IotNetworkEventHooks_t * pEventHooks );
+
 #endif /* ifndef IOT_NETWORK_OPENSSL_H_ */
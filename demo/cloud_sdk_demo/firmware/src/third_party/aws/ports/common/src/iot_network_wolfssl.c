@@ -46,6 +46,7 @@ typedef int socklen_t ;
 #include "iot_error.h"
 
 #define TCP_CLIENT_CONNECTION_TIMEOUT_PERIOD_s 	10
+#define DNS_RESOLVE_POLL_PERIOD_ms              50
 
 
 /* Configure logs for the functions in this file. */
@@ -87,6 +88,28 @@ typedef int socklen_t ;
 uint32_t sockConnTimeStamp;
 IP_MULTI_ADDRESS hostAddress;
 
+/**
+ * @brief Cache of resolved addresses registered by the application, if any.
+ */
+static const IotNetworkAddressCache_t * _pAddressCache = NULL;
+
+/**
+ * @brief Hooks on connection events registered by the application, if any.
+ */
+static const IotNetworkEventHooks_t * _pEventHooks = NULL;
+
+/**
+ * @brief Call `hook` of the registered event hooks, if there is one.
+ */
+#define _EVENT_HOOK( hook, ... )                                          \
+    do                                                                    \
+    {                                                                     \
+        if( ( _pEventHooks != NULL ) && ( _pEventHooks->hook != NULL ) ) \
+        {                                                                 \
+            _pEventHooks->hook( __VA_ARGS__ );                            \
+        }                                                                 \
+    } while( 0 )
+
 
 /*-----------------------------------------------------------*/
 
@@ -197,82 +220,6 @@ static void * _networkReceiveThread( void * pArgument )
 
 
 
-/*-----------------------------------------------------------*/
-
-/**
- * @brief Set up TLS on a TCP connection.
- *
- * @param[in] pConnection An established TCP connection.
- * @param[in] pServerName Remote host name, used for server name indication.
- * @param[in] pOpensslCredentials TLS setup parameters.
- *
- * @return #IOT_NETWORK_SUCCESS, #IOT_NETWORK_FAILURE, or #IOT_NETWORK_SYSTEM_ERROR.
- */
- #if 0
-static IotNetworkError_t _tlsSetup( _networkConnection_t * pConnection,
-                                    const char * pServerName,
-                                    const IotNetworkCredentials_t pOpensslCredentials )
-{
-    IOT_FUNCTION_ENTRY( IotNetworkError_t, IOT_NETWORK_SUCCESS );
-    
-
-    /* Set up ALPN if requested. */
-    if( pOpensslCredentials->pAlpnProtos != NULL )
-    {
-        IotLogDebug( "Setting ALPN protos." );
-
-        if( ( SSL_set_alpn_protos( pConnection->pSslContext,
-                                   ( const unsigned char * ) pOpensslCredentials->pAlpnProtos,
-                                   ( unsigned int ) strlen( pOpensslCredentials->pAlpnProtos ) ) != 0 ) )
-        {
-            IotLogError( "Failed to set ALPN protos." );
-
-            IOT_SET_AND_GOTO_CLEANUP( IOT_NETWORK_SYSTEM_ERROR );
-        }
-    }
-
-    /* Set TLS MFLN if requested. */
-    if( pOpensslCredentials->maxFragmentLength > 0 )
-    {
-        IotLogDebug( "Setting max send fragment length %lu.",
-                     ( unsigned long ) pOpensslCredentials->maxFragmentLength );
-
-        /* Set the maximum send fragment length. */
-        if( SSL_set_max_send_fragment( pConnection->pSslContext,
-                                       ( long ) pOpensslCredentials->maxFragmentLength ) != 1 )
-        {
-            IotLogError( "Failed to set max send fragment length %lu.",
-                         ( unsigned long ) pOpensslCredentials->maxFragmentLength );
-
-            IOT_SET_AND_GOTO_CLEANUP( IOT_NETWORK_SYSTEM_ERROR );
-        }
-
-
-    }
-
-    /* Enable SNI if requested. */
-    if( pOpensslCredentials->disableSni == false )
-    {
-        IotLogDebug( "Setting server name %s for SNI.", pServerName );
-
-        if( SSL_set_tlsext_host_name( pConnection->pSslContext,
-                                      pServerName ) != 1 )
-        {
-            IotLogError( "Failed to set server name %s for SNI.", pServerName );
-
-            IOT_SET_AND_GOTO_CLEANUP( IOT_NETWORK_SYSTEM_ERROR );
-        }
-    }
-
-
-
-    IOT_FUNCTION_CLEANUP_BEGIN();
-
-    IOT_FUNCTION_CLEANUP_END();
-}
-
-#endif
-
 /*-----------------------------------------------------------*/
 
 /**
@@ -292,6 +239,9 @@ static int _dnsLookupAndConnect( IotNetworkServerInfo_t pServerInfo, IotNetworkC
     struct addrinfo * pListHead = NULL, * pAddressInfo = NULL;
     struct sockaddr * pServer = NULL;
     socklen_t serverLength = 0;
+    bool cachedAddress = false;
+    bool staleAddress = false;
+    uint32_t connectTimeout = TCP_CLIENT_CONNECTION_TIMEOUT_PERIOD_s;
 
     /* Perform a DNS lookup of host name. */
     IotLogInfo( "Performing DNS lookup of %s, %d", pServerInfo->pHostName , strlen(pServerInfo->pHostName ));
@@ -302,6 +252,14 @@ static int _dnsLookupAndConnect( IotNetworkServerInfo_t pServerInfo, IotNetworkC
     	//string is already in IPv4 format
         IotLogDebug("Using IPv4 Address: %d.%d.%d.%d for host '%s'\r\n", hostAddress.v4Add.v[0], hostAddress.v4Add.v[1], hostAddress.v4Add.v[2], hostAddress.v4Add.v[3], pServerInfo->pHostName);
     }
+    else if ((_pAddressCache != NULL) && _pAddressCache->get( pServerInfo->pHostName, &hostAddress.v4Add.Val, &staleAddress))
+    {
+        // last known address, even past its TTL; the owner of the cache
+        // refreshes it and a dead one is caught by the short connect timeout
+        cachedAddress = true;
+        connectTimeout = _pAddressCache->connectTimeout;
+        IotLogDebug("Using %s IPv4 Address: %d.%d.%d.%d for host '%s'\r\n", staleAddress ? "stale cached" : "cached", hostAddress.v4Add.v[0], hostAddress.v4Add.v[1], hostAddress.v4Add.v[2], hostAddress.v4Add.v[3], pServerInfo->pHostName);
+    }
     else
     {
     	//perform DNS query
@@ -321,14 +279,17 @@ static int _dnsLookupAndConnect( IotNetworkServerInfo_t pServerInfo, IotNetworkC
 	            {
 	                case TCPIP_DNS_RES_PENDING:
 	                {
-						// wait a second, not optimum, todo, optimize this 
-						vTaskDelay(1000 / portTICK_PERIOD_MS);
+						vTaskDelay(DNS_RESOLVE_POLL_PERIOD_ms / portTICK_PERIOD_MS);
 	                    break;
 	                }
 	                
 	                case TCPIP_DNS_RES_OK:
 	                {
 	                    IotLogDebug("Using IPv4 Address: %d.%d.%d.%d for host '%s'\r\n", hostAddress.v4Add.v[0], hostAddress.v4Add.v[1], hostAddress.v4Add.v[2], hostAddress.v4Add.v[3], pServerInfo->pHostName);
+	                    if (_pAddressCache != NULL)
+	                    {
+	                        _pAddressCache->store(pServerInfo->pHostName);
+	                    }
 	                    break;
 	                }
 	                
@@ -367,37 +328,34 @@ static int _dnsLookupAndConnect( IotNetworkServerInfo_t pServerInfo, IotNetworkC
 	else
 	{
 		IotLogDebug("Starting connection\r\n");
+		_EVENT_HOOK(socketOpen, tcpSocket, hostAddress.v4Add.Val);
 		sockConnTimeStamp = SYS_TMR_TickCountGet();
 	}
 
     while( !NET_PRES_SocketIsConnected(tcpSocket))
         {
         	// while Socket not connected 
-           if (SYS_TMR_TickCountGet() - sockConnTimeStamp >= SYS_TMR_TickCounterFrequencyGet() * TCP_CLIENT_CONNECTION_TIMEOUT_PERIOD_s)
+           if (SYS_TMR_TickCountGet() - sockConnTimeStamp >= SYS_TMR_TickCounterFrequencyGet() * connectTimeout)
             {
                 IotLogError("Socket connect timeout!\r\n");
                 TCPIP_TCP_Close(tcpSocket);
+                if (cachedAddress)
+                {
+                    // stale entry: try the next cached address, then a fresh lookup
+                    _pAddressCache->invalidate(pServerInfo->pHostName, hostAddress.v4Add.Val);
+                }
 				IOT_SET_AND_GOTO_CLEANUP( -1 );
             }
 		   vTaskDelay(100 / portTICK_PERIOD_MS);
             
         }
+    _EVENT_HOOK(socketConnected, tcpSocket, netPort);
 
 
-	// socket connected, setup TLS
-	//TODO: add support for ALPN and SNI
-    /*if( pCredentialInfo != NULL )
-    {
-        IotLogInfo( "Setting up TLS." );
-
-
-
-       _tlsSetup( pNewNetworkConnection,
-                            pServerInfo->pHostName,
-                            pCredentialInfo );
-    }*/
-	
+	// socket connected, setup TLS. SNI and the max fragment length extension
+	// are configured by the net_pres wolfSSL provider when the session opens.
 		IotLogDebug("Connection Opened: Starting SSL Negotiation\r\n");
+		_EVENT_HOOK(tlsStart, tcpSocket);
         
 
 		if (!NET_PRES_SocketEncryptSocket(tcpSocket)) 
@@ -411,10 +369,16 @@ static int _dnsLookupAndConnect( IotNetworkServerInfo_t pServerInfo, IotNetworkC
     while( NET_PRES_SocketIsNegotiatingEncryption(tcpSocket))
 		vTaskDelay(10 / portTICK_PERIOD_MS);
 
+	_EVENT_HOOK(tlsDone, tcpSocket, NET_PRES_SocketIsSecure(tcpSocket));
 	if (!NET_PRES_SocketIsSecure(tcpSocket)) 
 	{
 		IotLogError("SSL Connection Negotiation Failed - Aborting\r\n");
 		TCPIP_TCP_Close(tcpSocket);
+		if (cachedAddress)
+		{
+			// the address may have been handed to some other service
+			_pAddressCache->invalidate(pServerInfo->pHostName, hostAddress.v4Add.Val);
+		}
 		IOT_SET_AND_GOTO_CLEANUP( -1 );
 	}
 
@@ -491,6 +455,7 @@ IotNetworkError_t IotNetworkWolfSSL_Create( IotNetworkServerInfo_t pServerInfo,
     {
         if( tcpSocket != -1 )
         {
+            _EVENT_HOOK(socketClose, tcpSocket);
             ( void ) NET_PRES_SocketClose( tcpSocket );
             tcpSocket = -1;
         }
@@ -585,6 +550,7 @@ size_t IotNetworkWolfSSL_Send( IotNetworkConnection_t pConnection,
 	if (NET_PRES_SocketWriteIsReady(pConnection->socket, messageLength, messageLength) ) 
     {
             bytesSent = NET_PRES_SocketWrite(pConnection->socket, pMessage, messageLength);
+            _EVENT_HOOK(sent, pMessage, bytesSent);
     }
     else
     {
@@ -688,6 +654,7 @@ IotNetworkError_t IotNetworkWolfSSL_Close( IotNetworkConnection_t pConnection )
     {
         IotLogInfo( "Connection (socket %d) shutting down.",
                     pConnection->socket );
+        _EVENT_HOOK(socketClose, pConnection->socket);
         NET_PRES_SocketClose(pConnection->socket);
         pConnection->socket = -1;
     }
@@ -723,3 +690,17 @@ int IotNetworkWolfSSL_GetSocket( IotNetworkConnection_t pConnection )
 }
 
 /*-----------------------------------------------------------*/
+
+void IotNetworkWolfSSL_SetAddressCache( const IotNetworkAddressCache_t * pAddressCache )
+{
+    _pAddressCache = pAddressCache;
+}
+
+/*-----------------------------------------------------------*/
+
+void IotNetworkWolfSSL_SetEventHooks( const IotNetworkEventHooks_t * pEventHooks )
+{
+    _pEventHooks = pEventHooks;
+}
+
+/*-----------------------------------------------------------*/
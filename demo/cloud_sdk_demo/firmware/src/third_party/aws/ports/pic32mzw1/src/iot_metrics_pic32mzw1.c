@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file iot_metrics_pic32mzw1.c
+ * @brief Implementation of the functions in iot_metrics.h on the Harmony
+ * TCP/IP stack.
+ *
+ * Sockets are read from the TCP and UDP socket tables. The WiFi MAC keeps no
+ * traffic counters, so bytes and packets are counted by the packet inspection
+ * hooks of the PIC32MZW1 driver, see configuration.h.
+ */
+
+/* The config header is always included first. */
+#include "iot_config.h"
+
+/* Standard includes. */
+#include <stdio.h>
+#include <string.h>
+
+/* Platform metrics include. */
+#include "platform/iot_metrics.h"
+
+/* Atomic include. */
+#include "iot_atomic.h"
+
+/* Configure logs for the functions in this file. */
+#ifdef IOT_LOG_LEVEL_PLATFORM
+    #define LIBRARY_LOG_LEVEL        IOT_LOG_LEVEL_PLATFORM
+#else
+    #ifdef IOT_LOG_LEVEL_GLOBAL
+        #define LIBRARY_LOG_LEVEL    IOT_LOG_LEVEL_GLOBAL
+    #else
+        #define LIBRARY_LOG_LEVEL    IOT_LOG_NONE
+    #endif
+#endif
+
+#define LIBRARY_LOG_NAME    ( "METRICS" )
+#include "iot_logging_setup.h"
+
+/*-----------------------------------------------------------*/
+
+/* Hooks called by the WiFi driver for every frame it sends or receives. */
+void IotMetrics_MacRxInspect( const TCPIP_MAC_PACKET * const ptrPacket );
+void IotMetrics_MacTxInspect( const TCPIP_MAC_PACKET * const ptrPacket );
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Lists handed to Defender. They are only read by the Defender publish job,
+ * one at a time, so they do not need to live on its stack.
+ */
+static IotMetricsTcpConnection_t _tcpConnections[ TCPIP_TCP_MAX_SOCKETS ];
+static IotMetricsListeningPort_t _listeningPorts[ TCPIP_TCP_MAX_SOCKETS > TCPIP_UDP_MAX_SOCKETS ?
+                                                  TCPIP_TCP_MAX_SOCKETS : TCPIP_UDP_MAX_SOCKETS ];
+
+/* Traffic counters, written from the TCP/IP and WiFi tasks. */
+static volatile uint32_t _bytesIn = 0;
+static volatile uint32_t _bytesOut = 0;
+static volatile uint32_t _packetsIn = 0;
+static volatile uint32_t _packetsOut = 0;
+
+/*-----------------------------------------------------------*/
+
+static bool _portListed( const IotListDouble_t * pList,
+                         uint16_t port )
+{
+    IotLink_t * pLink = NULL;
+
+    IotContainers_ForEach( pList, pLink )
+    {
+        if( IotLink_Container( IotMetricsListeningPort_t, pLink, link )->port == port )
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*-----------------------------------------------------------*/
+
+static void _listPort( IotListDouble_t * pList,
+                       size_t * pCount,
+                       uint16_t port )
+{
+    IotMetricsListeningPort_t * pPort = NULL;
+
+    /* Several sockets may share a port, such as the sockets of a server. */
+    if( ( port != 0 ) && ( _portListed( pList, port ) == false ) )
+    {
+        pPort = &_listeningPorts[ *pCount ];
+        pPort->port = port;
+        IotListDouble_InsertTail( pList, &( pPort->link ) );
+        ( *pCount )++;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t _frameLength( const TCPIP_MAC_PACKET * const ptrPacket )
+{
+    const TCPIP_MAC_DATA_SEGMENT * pDSeg = NULL;
+    size_t length = 0;
+
+    for( pDSeg = ptrPacket->pDSeg; pDSeg != NULL; pDSeg = pDSeg->next )
+    {
+        length += pDSeg->segLen;
+    }
+
+    return length;
+}
+
+/*-----------------------------------------------------------*/
+
+bool IotMetrics_Init( void )
+{
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMetrics_Cleanup( void )
+{
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMetrics_GetTcpConnections( void * pContext,
+                                   void ( * metricsCallback )( void *, const IotListDouble_t * ) )
+{
+    IotListDouble_t connections = IOT_LIST_DOUBLE_INITIALIZER;
+    IotMetricsTcpConnection_t * pConnection = NULL;
+    TCP_SOCKET_INFO info;
+    const uint8_t * pIp = NULL;
+    size_t count = 0;
+    int socket = 0, sockets = TCPIP_TCP_SocketsNumberGet();
+
+    IotListDouble_Create( &connections );
+
+    for( socket = 0; ( socket < sockets ) && ( count < TCPIP_TCP_MAX_SOCKETS ); socket++ )
+    {
+        if( ( TCPIP_TCP_SocketInfoGet( ( TCP_SOCKET ) socket, &info ) == false ) ||
+            ( info.state != TCPIP_TCP_STATE_ESTABLISHED ) ||
+            ( info.addressType != IP_ADDRESS_TYPE_IPV4 ) )
+        {
+            continue;
+        }
+
+        pConnection = &_tcpConnections[ count++ ];
+        pIp = info.remoteIPaddress.v4Add.v;
+        pConnection->pNetworkContext = NULL;
+        pConnection->addressLength = ( size_t ) snprintf( pConnection->pRemoteAddress,
+                                                          IOT_METRICS_IP_ADDRESS_LENGTH,
+                                                          "%u.%u.%u.%u:%u",
+                                                          pIp[ 0 ], pIp[ 1 ], pIp[ 2 ], pIp[ 3 ],
+                                                          info.remotePort );
+        IotListDouble_InsertTail( &connections, &( pConnection->link ) );
+    }
+
+    IotLogDebug( "%u established TCP connections.", ( unsigned ) count );
+
+    metricsCallback( pContext, &connections );
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMetrics_GetListeningTcpPorts( void * pContext,
+                                      void ( * metricsCallback )( void *, const IotListDouble_t * ) )
+{
+    IotListDouble_t ports = IOT_LIST_DOUBLE_INITIALIZER;
+    TCP_SOCKET_INFO info;
+    size_t count = 0;
+    int socket = 0, sockets = TCPIP_TCP_SocketsNumberGet();
+
+    IotListDouble_Create( &ports );
+
+    for( socket = 0; ( socket < sockets ) && ( count < TCPIP_TCP_MAX_SOCKETS ); socket++ )
+    {
+        if( ( TCPIP_TCP_SocketInfoGet( ( TCP_SOCKET ) socket, &info ) == true ) &&
+            ( info.state == TCPIP_TCP_STATE_LISTEN ) )
+        {
+            _listPort( &ports, &count, info.localPort );
+        }
+    }
+
+    metricsCallback( pContext, &ports );
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMetrics_GetListeningUdpPorts( void * pContext,
+                                      void ( * metricsCallback )( void *, const IotListDouble_t * ) )
+{
+    IotListDouble_t ports = IOT_LIST_DOUBLE_INITIALIZER;
+    UDP_SOCKET_INFO info;
+    size_t count = 0;
+    int socket = 0, sockets = TCPIP_UDP_SocketsNumberGet();
+
+    IotListDouble_Create( &ports );
+
+    /* Any open UDP socket takes datagrams sent to its local port. */
+    for( socket = 0; ( socket < sockets ) && ( count < TCPIP_UDP_MAX_SOCKETS ); socket++ )
+    {
+        if( TCPIP_UDP_SocketInfoGet( ( UDP_SOCKET ) socket, &info ) == true )
+        {
+            _listPort( &ports, &count, info.localPort );
+        }
+    }
+
+    metricsCallback( pContext, &ports );
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMetrics_GetNetworkStats( IotMetricsNetworkStats_t * pNetworkStats )
+{
+    pNetworkStats->bytesIn = _bytesIn;
+    pNetworkStats->bytesOut = _bytesOut;
+    pNetworkStats->packetsIn = _packetsIn;
+    pNetworkStats->packetsOut = _packetsOut;
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMetrics_MacRxInspect( const TCPIP_MAC_PACKET * const ptrPacket )
+{
+    /* The driver hands over received frames with the MAC header taken off. */
+    Atomic_Add_u32( &_bytesIn, _frameLength( ptrPacket ) + sizeof( TCPIP_MAC_ETHERNET_HEADER ) );
+    Atomic_Add_u32( &_packetsIn, 1 );
+}
+
+/*-----------------------------------------------------------*/
+
+void IotMetrics_MacTxInspect( const TCPIP_MAC_PACKET * const ptrPacket )
+{
+    Atomic_Add_u32( &_bytesOut, _frameLength( ptrPacket ) );
+    Atomic_Add_u32( &_packetsOut, 1 );
+}
+
+/*-----------------------------------------------------------*/
@@ -91,33 +91,91 @@ static wolfSSL_Mutex mSlotMutex;
 #endif
 static int ateccx08a_cfg_initialized = 0;
 static ATCAIfaceCfg cfg_ateccx08a_i2c_pi;
+
+#ifdef ATECC_RNG_POOL_SIZE
+/* Random bytes prefetched while the bus is idle, so seeding and nonces on
+ * the handshake path do not wait for the device */
+static byte mRngPool[ATECC_RNG_POOL_SIZE];
+static word32 mRngPoolCnt;
+/* The pool is topped up once it falls below this many bytes */
+#ifndef ATECC_RNG_POOL_LOW_WATER
+    #define ATECC_RNG_POOL_LOW_WATER (ATECC_RNG_POOL_SIZE / 2)
+#endif
+#ifndef SINGLE_THREADED
+static wolfSSL_Mutex mRngMutex;
+#endif
+#endif
 #endif /* WOLFSSL_ATECC508A */
 
 /**
- * \brief Generate random number to be used for hash.
+ * \brief Read count random bytes straight from the device. All the Random
+ *        commands needed are sent within a single wake cycle.
  */
-int atmel_get_random_number(uint32_t count, uint8_t* rand_out)
+static int atmel_read_random(uint32_t count, uint8_t* rand_out)
 {
 	int ret = 0;
 #if defined(WOLFSSL_ATECC508A) || defined(WOLFSSL_ATECC608A)
-	uint8_t i = 0;
+	uint32_t i = 0;
 	uint32_t copy_count = 0;
 	uint8_t rng_buffer[RANDOM_NUM_SIZE];
+	ATCADevice device = atcab_get_device();
 
-	if (rand_out == NULL) {
+	if (calib_execute_hold(device) != ATCA_SUCCESS) {
+		WOLFSSL_MSG("Failed to hold the device awake!");
 		return -1;
 	}
-
 	while (i < count) {
         ret = atcab_random(rng_buffer);
 		if (ret != ATCA_SUCCESS) {
 			WOLFSSL_MSG("Failed to create random number!");
-			return -1;
+			ret = -1;
+			break;
 		}
 		copy_count = (count - i > RANDOM_NUM_SIZE) ? RANDOM_NUM_SIZE : count - i;
 		XMEMCPY(&rand_out[i], rng_buffer, copy_count);
 		i += copy_count;
 	}
+	(void)calib_execute_release(device);
+	ForceZero(rng_buffer, sizeof(rng_buffer));
+#endif
+	return ret;
+}
+
+/**
+ * \brief Generate random number to be used for hash.
+ */
+int atmel_get_random_number(uint32_t count, uint8_t* rand_out)
+{
+	int ret = 0;
+#if defined(WOLFSSL_ATECC508A) || defined(WOLFSSL_ATECC608A)
+	if (rand_out == NULL) {
+		return -1;
+	}
+
+#ifdef ATECC_RNG_POOL_SIZE
+	/* Serve from the prefetched pool first; bytes are consumed once */
+	if (mAtcaInitDone) {
+		word32 take;
+	#ifndef SINGLE_THREADED
+		if (wc_LockMutex(&mRngMutex) == 0)
+	#endif
+		{
+			take = (count < mRngPoolCnt) ? count : mRngPoolCnt;
+			mRngPoolCnt -= take;
+			XMEMCPY(rand_out, &mRngPool[mRngPoolCnt], take);
+			ForceZero(&mRngPool[mRngPoolCnt], take);
+			rand_out += take;
+			count -= take;
+	#ifndef SINGLE_THREADED
+			wc_UnLockMutex(&mRngMutex);
+	#endif
+		}
+	}
+#endif
+
+	if (count > 0) {
+		ret = atmel_read_random(count, rand_out);
+	}
     #ifdef ATCAPRINTF
     atcab_printbin_label((const char*)"\r\nRandom Number", rand_out, count);
     #endif
@@ -127,6 +185,61 @@ int atmel_get_random_number(uint32_t count, uint8_t* rand_out)
 	return ret;
 }
 
+/**
+ * \brief Tell whether the random pool is below its low-water mark, so that
+ *        callers only refill it when it is worth a wake cycle.
+ *
+ * \return 1 when a refill is due, 0 otherwise.
+ */
+int atmel_rng_pool_low(void)
+{
+	int ret = 0;
+#if (defined(WOLFSSL_ATECC508A) || defined(WOLFSSL_ATECC608A)) && \
+    defined(ATECC_RNG_POOL_SIZE)
+	/* A stale count only moves the refill by one call */
+	ret = (mAtcaInitDone && mRngPoolCnt < ATECC_RNG_POOL_LOW_WATER) ? 1 : 0;
+#endif
+	return ret;
+}
+
+/**
+ * \brief Top up the random pool. Meant to be called from a task while no
+ *        other device command is in flight (e.g. between TLS handshakes).
+ *
+ * \return number of bytes added, 0 when already full, negative on error.
+ */
+int atmel_rng_pool_refill(void)
+{
+	int ret = 0;
+#if (defined(WOLFSSL_ATECC508A) || defined(WOLFSSL_ATECC608A)) && \
+    defined(ATECC_RNG_POOL_SIZE)
+	word32 need;
+
+	if (!mAtcaInitDone) {
+		return 0;
+	}
+#ifndef SINGLE_THREADED
+	if (wc_LockMutex(&mRngMutex) != 0) {
+		return BAD_MUTEX_E;
+	}
+#endif
+	need = ATECC_RNG_POOL_SIZE - mRngPoolCnt;
+	/* Refill in whole Random commands only */
+	if (need >= RANDOM_NUM_SIZE) {
+		need -= need % RANDOM_NUM_SIZE;
+		ret = atmel_read_random(need, &mRngPool[mRngPoolCnt]);
+		if (ret == 0) {
+			mRngPoolCnt += need;
+			ret = (int)need;
+		}
+	}
+#ifndef SINGLE_THREADED
+	wc_UnLockMutex(&mRngMutex);
+#endif
+#endif
+	return ret;
+}
+
 int atmel_get_random_block(unsigned char* output, unsigned int sz)
 {
 	return atmel_get_random_number((uint32_t)sz, (uint8_t*)output);
@@ -487,6 +600,12 @@ int atmel_init(void)
 
     #ifndef SINGLE_THREADED
         wc_InitMutex(&mSlotMutex);
+        #ifdef ATECC_RNG_POOL_SIZE
+        wc_InitMutex(&mRngMutex);
+        #endif
+    #endif
+    #ifdef ATECC_RNG_POOL_SIZE
+        mRngPoolCnt = 0;
     #endif
 
         /* Init the free slotId list */
@@ -564,6 +683,13 @@ void atmel_finish(void)
 
     #ifndef SINGLE_THREADED
         wc_FreeMutex(&mSlotMutex);
+        #ifdef ATECC_RNG_POOL_SIZE
+        wc_FreeMutex(&mRngMutex);
+        #endif
+    #endif
+    #ifdef ATECC_RNG_POOL_SIZE
+        ForceZero(mRngPool, sizeof(mRngPool));
+        mRngPoolCnt = 0;
     #endif
 
         mAtcaInitDone = 0;
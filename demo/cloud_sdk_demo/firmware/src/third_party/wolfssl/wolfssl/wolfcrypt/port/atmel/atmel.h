@@ -79,6 +79,8 @@ struct ecc_key;
 int  atmel_init(void);
 void atmel_finish(void);
 int  atmel_get_random_number(uint32_t count, uint8_t* rand_out);
+int  atmel_rng_pool_low(void);
+int  atmel_rng_pool_refill(void);
 #ifndef ATMEL_GET_RANDOM_BLOCK_DEFINED
     int  atmel_get_random_block(unsigned char* output, unsigned int sz);
     #define ATMEL_GET_RANDOM_BLOCK_DEFINED
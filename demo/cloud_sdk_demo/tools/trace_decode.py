@@ -0,0 +1,277 @@
+#!/usr/bin/env python3
+"""Decode the WFI32-IoT binary event trace.
+
+The input is either TRACE.BIN, copied from the board's MSD volume after a
+fault, or a UART1 capture of the "trace dump" console command. The events
+are printed as a timeline, followed by latency histograms of the socket
+connect, the TLS handshake, the time between MQTT packets and the time spent
+in each task state.
+
+    python3 trace_decode.py TRACE.BIN
+    python3 trace_decode.py --no-timeline uart1.log
+"""
+
+import argparse
+import collections
+import re
+import struct
+import sys
+
+FILE_MAGIC = 0x31435254  # "TRC1"
+FILE_HEADER = struct.Struct("<IHHIIIIII")
+RECORD = struct.Struct("<IHHII")
+
+# Keep in sync with APP_TRACE_EVENT in firmware/src/app_trace.h
+EVENTS = [
+    "NONE",
+    "SYNC",
+    "BOOT",
+    "FAULT",
+    "WLAN_STATE",
+    "AWS_STATE",
+    "SOCKET_OPEN",
+    "SOCKET_CONNECTED",
+    "SOCKET_CLOSE",
+    "TLS_START",
+    "TLS_DONE",
+    "MQTT_TX",
+    "USER",
+]
+
+# APP_TASK_WLAN_STATES in app.h and APP_TASK_AWS_CLOUD_STATES in app_aws.h
+STATES = {
+    "WLAN_STATE": [
+        "LEDS_START_UP_PATTERN", "INIT", "WDRV_INIT_READY", "WAIT_FOR_TCPIP_INIT",
+        "CHECK_CREDENTIALS", "CONFIG", "WAIT_FOR_SNTP_INIT", "IDLE", "RECONNECT",
+        "ROAM", "ROAM_WAIT_DISCONNECT", "ROAM_CONNECT", "DEINIT", "ERROR",
+    ],
+    "AWS_STATE": [
+        "SDK_INIT", "PENDING", "MQTT_CONNECT", "MQTT_PUBLISH_TO_TOPIC",
+        "MQTT_SUBSCRIBE_TO_TOPIC", "IDLE", "ERROR",
+    ],
+}
+
+MQTT_TYPES = {
+    1: "CONNECT", 3: "PUBLISH", 4: "PUBACK", 5: "PUBREC", 6: "PUBREL",
+    7: "PUBCOMP", 8: "SUBSCRIBE", 10: "UNSUBSCRIBE", 12: "PINGREQ",
+    14: "DISCONNECT",
+}
+
+EXCEPTIONS = {
+    4: "AdEL", 5: "AdES", 6: "IBE", 7: "DBE", 8: "Sys", 9: "Bp", 10: "RI",
+    11: "CpU", 12: "Overflow", 13: "Trap",
+}
+
+# Field order of APP_TRACE_RECORD
+Record = collections.namedtuple("Record", "ts event seq arg0 arg1")
+
+
+class Trace:
+    def __init__(self):
+        self.core_hz = 100000000
+        self.head = 0
+        self.boot_count = 0
+        self.fault = None
+        self.records = []
+
+
+def load_binary(data):
+    trace = Trace()
+    (magic, version, record_size, trace.core_hz, trace.head, count,
+     cause, address, trace.boot_count) = FILE_HEADER.unpack_from(data)
+    if magic != FILE_MAGIC or version != 1 or record_size != RECORD.size:
+        raise ValueError("not a version 1 trace file")
+    if cause or address:
+        trace.fault = (cause, address)
+    offset = FILE_HEADER.size
+    for _ in range(count):
+        trace.records.append(Record(*RECORD.unpack_from(data, offset)))
+        offset += RECORD.size
+    return trace
+
+
+def load_text(text):
+    """The last "trace dump" of a console capture."""
+    trace = None
+    for line in text.splitlines():
+        m = re.search(r"@TRACE (\d+) (\d+) (\d+) (\d+) (\d+)", line)
+        if m:
+            trace = Trace()
+            trace.core_hz = int(m.group(2))
+            trace.head = int(m.group(3))
+            trace.boot_count = int(m.group(5))
+            continue
+        m = re.search(r"@T ([0-9a-f]{4}) ([0-9a-f]{8}) ([0-9a-f]{4}) ([0-9a-f]{8}) ([0-9a-f]{8})", line)
+        if m and trace is not None:
+            seq, ts, event, arg0, arg1 = (int(g, 16) for g in m.groups())
+            trace.records.append(Record(ts, event, seq, arg0, arg1))
+    if trace is None:
+        raise ValueError("no @TRACE dump found")
+    return trace
+
+
+def check_sequence(trace):
+    """Records are consecutive unless the ring moved while it was read."""
+    gaps = 0
+    for prev, rec in zip(trace.records, trace.records[1:]):
+        if (prev.seq + 1) & 0xFFFF != rec.seq:
+            gaps += 1
+    if gaps:
+        print("warning: %d sequence gaps, some records were overwritten" % gaps, file=sys.stderr)
+
+
+def timestamps(trace):
+    """Milliseconds since boot of each record.
+
+    The core timer wraps every 2^32 ticks (~43 s at 100 MHz), so each record
+    is placed relative to the closest SYNC record before it, which carries the
+    uptime; the records before the first SYNC are placed back from it.
+    """
+    sync = EVENTS.index("SYNC")
+    first = next((r for r in trace.records if r.event == sync), trace.records[0])
+    anchor = (first.ts, float(first.arg0) if first.event == sync else 0.0)
+    times = []
+    for rec in trace.records:
+        if rec.event == sync:
+            anchor = (rec.ts, float(rec.arg0))
+        delta = (rec.ts - anchor[0]) & 0xFFFFFFFF
+        if delta & 0x80000000:
+            delta -= 1 << 32
+        times.append(anchor[1] + delta * 1000.0 / trace.core_hz)
+    return times
+
+
+def ipv4(value):
+    return ".".join(str((value >> shift) & 0xFF) for shift in (0, 8, 16, 24))
+
+
+def state_name(kind, value):
+    names = STATES[kind]
+    if value == 0xFFFFFFFF:
+        return "-"
+    return names[value] if value < len(names) else str(value)
+
+
+def describe(rec):
+    name = EVENTS[rec.event] if rec.event < len(EVENTS) else "EV_%d" % rec.event
+    if name in STATES:
+        text = "%s <- %s" % (state_name(name, rec.arg0), state_name(name, rec.arg1))
+    elif name == "SOCKET_OPEN":
+        text = "socket %d to %s" % (rec.arg0, ipv4(rec.arg1))
+    elif name == "SOCKET_CONNECTED":
+        text = "socket %d port %d" % (rec.arg0, rec.arg1)
+    elif name in ("SOCKET_CLOSE", "TLS_START"):
+        text = "socket %d" % rec.arg0
+    elif name == "TLS_DONE":
+        text = "socket %d %s" % (rec.arg0, "secure" if rec.arg1 else "FAILED")
+    elif name == "MQTT_TX":
+        text = "%s %d bytes" % (MQTT_TYPES.get(rec.arg0 >> 4, "type %d" % (rec.arg0 >> 4)), rec.arg1)
+    elif name == "FAULT":
+        text = "%s at 0x%08x" % (EXCEPTIONS.get(rec.arg0, "cause %d" % rec.arg0), rec.arg1)
+    elif name == "BOOT":
+        text = "RCON 0x%08x, boot %d" % (rec.arg0, rec.arg1)
+    elif name == "SYNC":
+        text = "uptime %d ms" % rec.arg0
+    else:
+        text = "0x%08x 0x%08x" % (rec.arg0, rec.arg1)
+    return name, text
+
+
+def print_timeline(trace, times):
+    print("%12s %10s  %-17s %s" % ("time(ms)", "delta(ms)", "event", ""))
+    prev = None
+    for rec, t in zip(trace.records, times):
+        name, text = describe(rec)
+        if name == "SYNC":
+            continue
+        delta = "" if prev is None else "%.3f" % (t - prev)
+        print("%12.3f %10s  %-17s %s" % (t, delta, name, text))
+        prev = t
+
+
+def latencies(trace, times):
+    """Samples in ms, by histogram title."""
+    samples = collections.OrderedDict()
+    pending = {}
+    last_tx = {}
+    entered = {}
+
+    def add(title, value):
+        samples.setdefault(title, []).append(value)
+
+    for rec, t in zip(trace.records, times):
+        name = EVENTS[rec.event] if rec.event < len(EVENTS) else None
+        if name in ("SOCKET_OPEN", "TLS_START"):
+            pending[(name, rec.arg0)] = t
+        elif name == "SOCKET_CONNECTED" and ("SOCKET_OPEN", rec.arg0) in pending:
+            add("socket connect", t - pending.pop(("SOCKET_OPEN", rec.arg0)))
+        elif name == "TLS_DONE" and ("TLS_START", rec.arg0) in pending:
+            add("TLS handshake", t - pending.pop(("TLS_START", rec.arg0)))
+        elif name == "MQTT_TX":
+            kind = MQTT_TYPES.get(rec.arg0 >> 4, "type %d" % (rec.arg0 >> 4))
+            if kind in last_tx:
+                add("between MQTT %s" % kind, t - last_tx[kind])
+            last_tx[kind] = t
+        elif name in STATES:
+            if name in entered:
+                state, since = entered[name]
+                add("%s %s" % (name.split("_")[0], state_name(name, state)), t - since)
+            entered[name] = (rec.arg0, t)
+    return samples
+
+
+def print_histogram(title, values):
+    """Power of 2 buckets in microseconds."""
+    values = sorted(values)
+    buckets = collections.Counter()
+    for v in values:
+        us = max(1, int(v * 1000))
+        buckets[us.bit_length() - 1] += 1
+    print()
+    print("%s: n=%d min=%.3f median=%.3f max=%.3f ms" % (
+        title, len(values), values[0], values[len(values) // 2], values[-1]))
+    width = max(buckets.values())
+    for b in range(min(buckets), max(buckets) + 1):
+        n = buckets.get(b, 0)
+        low = 1 << b
+        print("  %10s us %5d %s" % ("%d-%d" % (low, 2 * low - 1), n, "#" * ((40 * n + width - 1) // width)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", help="TRACE.BIN or a console capture of 'trace dump'")
+    parser.add_argument("--no-timeline", action="store_true", help="print the histograms only")
+    parser.add_argument("--no-histograms", action="store_true", help="print the timeline only")
+    args = parser.parse_args()
+
+    with open(args.input, "rb") as f:
+        data = f.read()
+    try:
+        if len(data) >= 4 and struct.unpack_from("<I", data)[0] == FILE_MAGIC:
+            trace = load_binary(data)
+        else:
+            trace = load_text(data.decode("latin-1"))
+    except (ValueError, struct.error) as e:
+        sys.exit("%s: %s" % (args.input, e))
+
+    faults = [r for r in trace.records if r.event == EVENTS.index("FAULT")]
+    if faults and not trace.fault:
+        trace.fault = (faults[-1].arg0, faults[-1].arg1)
+    print("%d records, %d written since boot %d, core timer %d Hz" % (
+        len(trace.records), trace.head, trace.boot_count, trace.core_hz))
+    if trace.fault:
+        print("Fault: %s at 0x%08x" % (EXCEPTIONS.get(trace.fault[0], "cause %d" % trace.fault[0]), trace.fault[1]))
+    if not trace.records:
+        return
+    check_sequence(trace)
+    times = timestamps(trace)
+    if not args.no_timeline:
+        print()
+        print_timeline(trace, times)
+    if not args.no_histograms:
+        for title, values in latencies(trace, times).items():
+            print_histogram(title, values)
+
+
+if __name__ == "__main__":
+    main()